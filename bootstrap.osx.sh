@@ -138,6 +138,7 @@ if [ ! -e ${GEN_DIR}/ELF_32_linux.S ]; then
 
   clang++-3.8 -m64 -std=gnu++11 -isysroot ${OSX_SDK} ${DIR}/mcsema/Arch/X86/Runtime/print_ELF_64_linux.cpp
   ./a.out > ${GEN_DIR}/ELF_64_linux.S
+  ./a.out --lazy-stack > ${GEN_DIR}/ELF_64_linux_lazy_stack.S
 
   clang++-3.8 -m32 -std=gnu++11 -isysroot ${OSX_SDK} ${DIR}/mcsema/Arch/X86/Runtime/print_PE_32_windows.cpp
   ./a.out > ${GEN_DIR}/PE_32_windows.asm
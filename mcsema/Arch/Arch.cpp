@@ -1,12 +1,25 @@
 /* Copyright 2017 Peter Goodman (peter@trailofbits.com), all rights reserved. */
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/Statistic.h>
+
+#include <llvm/IR/Metadata.h>
 
 #include <llvm/MC/MCContext.h>
 #include <llvm/MC/MCDisassembler.h>
+#include <llvm/MC/MCInstrInfo.h>
 
+#include <llvm/lib/Target/X86/MCTargetDesc/X86BaseInfo.h>
 #include <llvm/lib/Target/X86/X86RegisterInfo.h>
 #include <llvm/lib/Target/X86/X86InstrBuilder.h>
 #include <llvm/lib/Target/X86/X86MachineFunctionInfo.h>
@@ -21,6 +34,12 @@
 
 #include "mcsema/cfgToLLVM/TransExcn.h"
 
+#define DEBUG_TYPE "mcsema-decode"
+
+STATISTIC(NumDecodeLookups,
+          "Number of instructions looked up in the decode cache");
+STATISTIC(NumDecodeHits, "Number of instructions found in the decode cache");
+
 namespace {
 
 static std::string gDataLayout;
@@ -36,6 +55,23 @@ static llvm::Triple::OSType gOSType;
 
 static DispatchMap gDispatcher;
 
+// Inline assembly of entry/exit point stubs, keyed by stub name, that were
+// requested while lifting into a module shard.
+static std::mutex gDeferredStubsLock;
+static std::map<std::string, std::string> gDeferredStubs;
+static thread_local bool gDeferStubs = false;
+
+// Previously decoded instructions, keyed by their bytes. Only instructions
+// whose decoding doesn't depend on where they are, or on what they refer to,
+// are cached. Each thread has its own cache, so that CFGs can be read on
+// several threads at once.
+struct DecodedInst {
+  llvm::MCInst inst;
+  size_t size;
+};
+
+static thread_local std::unordered_map<std::string, DecodedInst> gDecodeCache;
+
 static bool InitInstructionDecoder(void) {
   std::string errstr;
   auto target = llvm::TargetRegistry::lookupTarget(gTriple, errstr);
@@ -64,11 +100,21 @@ MCSemaRegs X86RegisterNumber(const std::string &name);
 unsigned X86RegisterOffset(MCSemaRegs reg);
 MCSemaRegs X86RegisterParent(MCSemaRegs reg);
 void X86AllocRegisterVars(llvm::BasicBlock *);
+llvm::Value *X86GetRegisterVar(llvm::Function *, MCSemaRegs, bool);
+void X86SyncRegisterVars(llvm::BasicBlock *);
 unsigned X86RegisterSize(MCSemaRegs reg);
 llvm::StructType *X86RegStateStructType(void);
 llvm::Function *X86GetOrCreateRegStateTracer(llvm::Module *);
 InstTransResult X86LiftInstruction(
     TranslationContext &, llvm::BasicBlock *&, InstructionLifter *);
+template <int addr_width>
+InstructionLifter *X86GetFusedLifter(TranslationContext &);
+void X86PreProcessFunction(NativeModule *, NativeFunction *, llvm::Module *);
+bool X86AllocStackFrame(NativeFunction *, llvm::BasicBlock *);
+void X86FreeStackFrame(llvm::Function *);
+bool X86AccessesStackFrame(llvm::Function *, NativeInst *);
+void X86FitStackFrameAccess(llvm::BasicBlock *, llvm::Value *, unsigned);
+bool X86KeepsReturnAddressPrivate(NativeModule *, NativeFunction *);
 
 // Define the generic arch function pointers.
 const std::string &(*ArchRegisterName)(MCSemaRegs) = nullptr;
@@ -76,11 +122,24 @@ MCSemaRegs (*ArchRegisterNumber)(const std::string &) = nullptr;
 unsigned (*ArchRegisterOffset)(MCSemaRegs) = nullptr;
 MCSemaRegs (*ArchRegisterParent)(MCSemaRegs) = nullptr;
 void (*ArchAllocRegisterVars)(llvm::BasicBlock *) = nullptr;
+llvm::Value *(*ArchGetRegisterVar)(llvm::Function *, MCSemaRegs,
+                                   bool) = nullptr;
+void (*ArchSyncRegisterVars)(llvm::BasicBlock *) = nullptr;
 unsigned (*ArchRegisterSize)(MCSemaRegs) = nullptr;
 llvm::StructType *(*ArchRegStateStructType)(void) = nullptr;
 llvm::Function *(*ArchGetOrCreateRegStateTracer)(llvm::Module *) = nullptr;
 InstTransResult (*ArchLiftInstruction)(
     TranslationContext &, llvm::BasicBlock *&, InstructionLifter *) = nullptr;
+InstructionLifter *(*ArchGetFusedLifter)(TranslationContext &) = nullptr;
+void (*ArchPreProcessFunction)(
+    NativeModule *, NativeFunction *, llvm::Module *) = nullptr;
+bool (*ArchAllocStackFrame)(NativeFunction *, llvm::BasicBlock *) = nullptr;
+void (*ArchFreeStackFrame)(llvm::Function *) = nullptr;
+bool (*ArchAccessesStackFrame)(llvm::Function *, NativeInst *) = nullptr;
+void (*ArchFitStackFrameAccess)(llvm::BasicBlock *, llvm::Value *,
+                                unsigned) = nullptr;
+bool (*ArchKeepsReturnAddressPrivate)(
+    NativeModule *, NativeFunction *) = nullptr;
 
 bool ListArchSupportedInstructions(const std::string &triple, llvm::raw_ostream &s, bool ListSupported, bool ListUnsupported) {
   std::string errstr;
@@ -94,13 +153,16 @@ bool ListArchSupportedInstructions(const std::string &triple, llvm::raw_ostream
 
   if(ListSupported) {
     s << "SUPPORTED INSTRUCTIONS: \n";
-    for (auto i : gDispatcher) {
-      if (i.first < llvm::X86::INSTRUCTION_LIST_END) {
-        s << mii->getName(i.first) << "\n";
+    for (unsigned opcode = 0; opcode < gDispatcher.size(); ++opcode) {
+      if (!gDispatcher.find(opcode)) {
+        continue;
       }
-      if (i.first > llvm::X86::MCSEMA_OPCODE_LIST_BEGIN &&
-          i.first <= llvm::X86::MCSEMA_OPCODE_LIST_BEGIN + llvm::X86::gExtendedOpcodeNames.size()) {
-        s << llvm::X86::gExtendedOpcodeNames[i.first] << "\n";
+      if (opcode < llvm::X86::INSTRUCTION_LIST_END) {
+        s << mii->getName(opcode) << "\n";
+      }
+      if (opcode > llvm::X86::MCSEMA_OPCODE_LIST_BEGIN &&
+          opcode <= llvm::X86::MCSEMA_OPCODE_LIST_BEGIN + llvm::X86::gExtendedOpcodeNames.size()) {
+        s << llvm::X86::gExtendedOpcodeNames[opcode] << "\n";
       }
     }
   }
@@ -108,7 +170,7 @@ bool ListArchSupportedInstructions(const std::string &triple, llvm::raw_ostream
   if (ListUnsupported) {
     s << "UNSUPPORTED INSTRUCTIONS: \n";
     for (int i = llvm::X86::AAA; i < llvm::X86::INSTRUCTION_LIST_END; ++i) {
-      if (gDispatcher.end() == gDispatcher.find(i)) {
+      if (!gDispatcher.find(i)) {
         s << mii->getName(i) << "\n";
       }
     }
@@ -116,6 +178,121 @@ bool ListArchSupportedInstructions(const std::string &triple, llvm::raw_ostream
   return true;
 }
 
+// Returns the instruction info of the target, or `nullptr` if the target
+// isn't available.
+static const llvm::MCInstrInfo *GetInstrInfo(void) {
+  static std::unique_ptr<llvm::MCInstrInfo> mii;
+  static std::once_flag mii_once;
+  std::call_once(mii_once, [] {
+    std::string errstr;
+    if (auto target = llvm::TargetRegistry::lookupTarget(gTriple, errstr)) {
+      mii.reset(target->createMCInstrInfo());
+    }
+  });
+  return mii.get();
+}
+
+std::string ArchInstructionName(unsigned opcode) {
+  auto ext_name = llvm::X86::gExtendedOpcodeNames.find(opcode);
+  if (ext_name != llvm::X86::gExtendedOpcodeNames.end()) {
+    return ext_name->second;
+  }
+
+  auto mii = GetInstrInfo();
+  if (mii && opcode < mii->getNumOpcodes()) {
+    return mii->getName(opcode);
+  }
+  return std::to_string(opcode);
+}
+
+bool ArchInstructionObservesPC(unsigned opcode, bool may_fault) {
+  auto mii = GetInstrInfo();
+  if (!mii || opcode >= mii->getNumOpcodes()) {
+    return true;  // Extended opcodes, e.g. for prefixes.
+  }
+
+  const auto &desc = mii->get(opcode);
+  if (desc.isCall() || desc.isReturn() || desc.isIndirectBranch() ||
+      desc.isTrap() || desc.hasUnmodeledSideEffects()) {
+    return true;
+  }
+  return may_fault && (desc.mayLoad() || desc.mayStore());
+}
+
+bool ArchInstructionIsReturn(unsigned opcode) {
+  auto mii = GetInstrInfo();
+  return mii && opcode < mii->getNumOpcodes() && mii->get(opcode).isReturn();
+}
+
+bool ArchInstructionIsDirectJump(unsigned opcode) {
+  auto mii = GetInstrInfo();
+  if (!mii || opcode >= mii->getNumOpcodes()) {
+    return false;
+  }
+  const auto &desc = mii->get(opcode);
+  return desc.isUnconditionalBranch() && !desc.isIndirectBranch();
+}
+
+bool ArchInstructionFallsThrough(unsigned opcode) {
+  auto mii = GetInstrInfo();
+  if (!mii || opcode >= mii->getNumOpcodes()) {
+    return false;
+  }
+  const auto &desc = mii->get(opcode);
+  return !desc.isBranch() && !desc.isIndirectBranch() && !desc.isReturn() &&
+         !desc.isBarrier() && !desc.isTrap();
+}
+
+bool ArchInstructionRegisters(const llvm::MCInst &inst,
+                              std::vector<unsigned> &uses,
+                              std::vector<unsigned> &defs) {
+  auto mii = GetInstrInfo();
+  auto opcode = inst.getOpcode();
+  if (!mii || opcode >= mii->getNumOpcodes()) {
+    return false;
+  }
+
+  const auto &desc = mii->get(opcode);
+  for (unsigned i = 0; i < inst.getNumOperands(); ++i) {
+    const auto &op = inst.getOperand(i);
+    if (!op.isReg() || !op.getReg()) {
+      continue;
+    }
+    if (i < desc.getNumDefs()) {
+      defs.push_back(op.getReg());
+    } else {
+      uses.push_back(op.getReg());
+    }
+  }
+
+  if (auto implicit_uses = desc.getImplicitUses()) {
+    for (; *implicit_uses; ++implicit_uses) {
+      uses.push_back(*implicit_uses);
+    }
+  }
+  if (auto implicit_defs = desc.getImplicitDefs()) {
+    for (; *implicit_defs; ++implicit_defs) {
+      defs.push_back(*implicit_defs);
+    }
+  }
+  return true;
+}
+
+int ArchMemoryOperandIndex(const llvm::MCInst &inst) {
+  auto mii = GetInstrInfo();
+  auto opcode = inst.getOpcode();
+  if (!mii || opcode >= mii->getNumOpcodes()) {
+    return -1;
+  }
+
+  const auto &desc = mii->get(opcode);
+  auto index = llvm::X86II::getMemoryOperandNo(desc.TSFlags, opcode);
+  if (0 > index) {
+    return -1;
+  }
+  return index + static_cast<int>(llvm::X86II::getOperandBias(desc));
+}
+
 bool InitArch(llvm::LLVMContext *context, const std::string &os, const std::string &arch) {
 
   // Windows.
@@ -175,15 +352,29 @@ bool InitArch(llvm::LLVMContext *context, const std::string &os, const std::stri
   if (arch == "x86" || arch == "amd64") {
     X86InitRegisterState(context);
     X86InitInstructionDispatch(gDispatcher);
+    gDispatcher.seal();
     ArchRegisterName = X86RegisterName;
     ArchRegisterNumber = X86RegisterNumber;
     ArchRegisterOffset = X86RegisterOffset;
     ArchRegisterParent = X86RegisterParent;
     ArchRegisterSize = X86RegisterSize;
     ArchAllocRegisterVars = X86AllocRegisterVars;
+    ArchGetRegisterVar = X86GetRegisterVar;
+    ArchSyncRegisterVars = X86SyncRegisterVars;
     ArchRegStateStructType = X86RegStateStructType;
     ArchGetOrCreateRegStateTracer = X86GetOrCreateRegStateTracer;
     ArchLiftInstruction = X86LiftInstruction;
+    if (64 == gAddressSize) {
+      ArchGetFusedLifter = X86GetFusedLifter<64>;
+    } else {
+      ArchGetFusedLifter = X86GetFusedLifter<32>;
+    }
+    ArchPreProcessFunction = X86PreProcessFunction;
+    ArchAllocStackFrame = X86AllocStackFrame;
+    ArchFreeStackFrame = X86FreeStackFrame;
+    ArchAccessesStackFrame = X86AccessesStackFrame;
+    ArchFitStackFrameAccess = X86FitStackFrameAccess;
+    ArchKeepsReturnAddressPrivate = X86KeepsReturnAddressPrivate;
   } else {
     return false;
   }
@@ -191,8 +382,36 @@ bool InitArch(llvm::LLVMContext *context, const std::string &os, const std::stri
   return InitInstructionDecoder();
 }
 
+// Initialize the per-thread architecture state of a thread that will lift
+// code into `context`.
+void ArchInitContext(llvm::LLVMContext *context) {
+  X86InitRegisterState(context);
+}
+
 InstructionLifter *ArchGetInstructionLifter(const llvm::MCInst &inst) {
-  return gDispatcher[inst.getOpcode()];
+  return gDispatcher.dispatch(inst.getOpcode());
+}
+
+bool ArchHasInstructionLifter(unsigned opcode) {
+  return nullptr != gDispatcher.find(opcode);
+}
+
+const char *ArchGetInstructionFamily(const llvm::MCInst &inst) {
+  return gDispatcher.family_of(inst.getOpcode());
+}
+
+const std::vector<const char *> &ArchGetInstructionFamilies(void) {
+  return gDispatcher.family_names();
+}
+
+std::vector<std::pair<unsigned, uint64_t>> ArchGetInstructionLifterHits(void) {
+  std::vector<std::pair<unsigned, uint64_t>> hits;
+  for (unsigned opcode = 0; opcode < gDispatcher.size(); ++opcode) {
+    if (auto num_hits = gDispatcher.num_hits(opcode)) {
+      hits.emplace_back(opcode, num_hits);
+    }
+  }
+  return hits;
 }
 
 int ArchAddressSize(void) {
@@ -209,9 +428,29 @@ const std::string &ArchDataLayout(void) {
 
 namespace {
 
+// Returns the bit that represents the prefix `op_code` in a prefix mask, or
+// zero if `op_code` is not a prefix.
+static uint32_t PrefixBit(unsigned op_code) {
+  switch (op_code) {
+    case llvm::X86::CS_PREFIX: return 1U << 0;
+    case llvm::X86::DATA16_PREFIX: return 1U << 1;
+    case llvm::X86::DS_PREFIX: return 1U << 2;
+    case llvm::X86::ES_PREFIX: return 1U << 3;
+    case llvm::X86::FS_PREFIX: return 1U << 4;
+    case llvm::X86::GS_PREFIX: return 1U << 5;
+    case llvm::X86::LOCK_PREFIX: return 1U << 6;
+    case llvm::X86::REPNE_PREFIX: return 1U << 7;
+    case llvm::X86::REP_PREFIX: return 1U << 8;
+    case llvm::X86::REX64_PREFIX: return 1U << 9;
+    case llvm::X86::SS_PREFIX: return 1U << 10;
+    case llvm::X86::XACQUIRE_PREFIX: return 1U << 11;
+    case llvm::X86::XRELEASE_PREFIX: return 1U << 12;
+    default: return 0;
+  }
+}
+
 // Some instructions should be combined with their prefixes. We do this here.
-static void FixupInstruction(
-    llvm::MCInst &inst, const std::unordered_set<unsigned> &prefixes) {
+static void FixupInstruction(llvm::MCInst &inst, uint32_t prefixes) {
   static const unsigned fixups[][4] = {
     {llvm::X86::MOVSB, llvm::X86::REP_PREFIX,
         llvm::X86::REP_MOVSB_32, llvm::X86::REP_MOVSB_64},
@@ -265,7 +504,7 @@ static void FixupInstruction(
   };
 
   for (const auto &fixup : fixups) {
-    if (inst.getOpcode() == fixup[0] && prefixes.count(fixup[1])) {
+    if (inst.getOpcode() == fixup[0] && (prefixes & PrefixBit(fixup[1]))) {
       if (32 == gAddressSize) {
         inst.setOpcode(fixup[2]);
       } else {
@@ -275,17 +514,39 @@ static void FixupInstruction(
   }
 }
 
+// Returns true if `inst` has a RIP-relative operand.
+static bool IsRIPRelative(const llvm::MCInst &inst) {
+  for (const auto &op : inst) {
+    if (op.isReg() && llvm::X86::RIP == op.getReg()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 // Decodes the instruction, and returns the number of bytes decoded.
 size_t ArchDecodeInstruction(const uint8_t *bytes, const uint8_t *bytes_end,
-                             uintptr_t va, llvm::MCInst &inst) {
-
+                             uintptr_t va, llvm::MCInst &inst,
+                             bool cacheable) {
 
   size_t total_size = 0;
   size_t max_size = static_cast<size_t>(bytes_end - bytes);
 
-  std::unordered_set<unsigned> prefixes;
+  std::string key;
+  if (cacheable) {
+    ++NumDecodeLookups;
+    key.assign(reinterpret_cast<const char *>(bytes), max_size);
+    auto cached_it = gDecodeCache.find(key);
+    if (cached_it != gDecodeCache.end()) {
+      ++NumDecodeHits;
+      inst = cached_it->second.inst;
+      return cached_it->second.size;
+    }
+  }
+
+  uint32_t prefixes = 0;
 
   for (; total_size < max_size; ) {
     llvm::ArrayRef<uint8_t> bytes_to_decode(
@@ -301,30 +562,19 @@ size_t ArchDecodeInstruction(const uint8_t *bytes, const uint8_t *bytes_end,
 
     total_size += size;
 
-    switch (auto op_code = inst.getOpcode()) {
-      case llvm::X86::CS_PREFIX:
-      case llvm::X86::DATA16_PREFIX:
-      case llvm::X86::DS_PREFIX:
-      case llvm::X86::ES_PREFIX:
-      case llvm::X86::FS_PREFIX:
-      case llvm::X86::GS_PREFIX:
-      case llvm::X86::LOCK_PREFIX:
-      case llvm::X86::REPNE_PREFIX:
-      case llvm::X86::REP_PREFIX:
-      case llvm::X86::REX64_PREFIX:
-      case llvm::X86::SS_PREFIX:
-      case llvm::X86::XACQUIRE_PREFIX:
-      case llvm::X86::XRELEASE_PREFIX:
-        prefixes.insert(op_code);
-        break;
-      default:
-        max_size = 0;  // Stop decoding.
-        break;
+    if (auto prefix_bit = PrefixBit(inst.getOpcode())) {
+      prefixes |= prefix_bit;
+    } else {
+      max_size = 0;  // Stop decoding.
     }
   }
 
   FixupInstruction(inst, prefixes);
 
+  if (cacheable && !IsRIPRelative(inst)) {
+    gDecodeCache[key] = {inst, total_size};
+  }
+
   return total_size;
 }
 
@@ -375,6 +625,8 @@ void ArchInitAttachDetach(llvm::Module *M) {
       InitADFeatues(M, "__mcsema_detach_call", EPTy);
       InitADFeatues(M, "__mcsema_detach_call_value", EPTy);
       InitADFeatues(M, "__mcsema_detach_ret", EPTy);
+      InitADFeatues(M, "__mcsema_detach_call_lean", EPTy);
+      InitADFeatues(M, "__mcsema_attach_ret_lean", EPTy);
 
     } else {
       InitADFeatues(M, "__mcsema_attach_call_cdecl", EPTy);
@@ -414,6 +666,71 @@ void ArchInitAttachDetach(llvm::Module *M) {
   }
 }
 
+void ArchDeferStubs(bool defer) {
+  gDeferStubs = defer;
+}
+
+void ArchAddDeferredStubs(llvm::Module *M) {
+
+  // Skip the stubs that `M` already defines, e.g. callback drivers that were
+  // added while inserting the data sections.
+  std::unordered_set<std::string> defined_stubs;
+  std::stringstream as(M->getModuleInlineAsm());
+  for (std::string line; std::getline(as, line); ) {
+    if (!line.empty() && ':' == line.back()) {
+      defined_stubs.insert(line.substr(0, line.size() - 1));
+    }
+  }
+
+  std::lock_guard<std::mutex> locker(gDeferredStubsLock);
+  for (const auto &stub : gDeferredStubs) {
+    if (!defined_stubs.count(stub.first)) {
+      M->appendModuleInlineAsm(stub.second);
+    }
+  }
+  gDeferredStubs.clear();
+}
+
+static const char * const kDeferredStubsMetadata = "mcsema.deferred_stubs";
+
+void ArchSaveDeferredStubs(llvm::Module *M) {
+  auto &C = M->getContext();
+  auto md = M->getOrInsertNamedMetadata(kDeferredStubsMetadata);
+
+  std::lock_guard<std::mutex> locker(gDeferredStubsLock);
+  for (const auto &stub : gDeferredStubs) {
+    llvm::Metadata *ops[] = {llvm::MDString::get(C, stub.first),
+                             llvm::MDString::get(C, stub.second)};
+    md->addOperand(llvm::MDTuple::get(C, ops));
+  }
+  gDeferredStubs.clear();
+}
+
+void ArchLoadDeferredStubs(llvm::Module *M) {
+  auto md = M->getNamedMetadata(kDeferredStubsMetadata);
+  if (!md) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> locker(gDeferredStubsLock);
+  for (auto op : md->operands()) {
+    auto name = llvm::cast<llvm::MDString>(op->getOperand(0))->getString();
+    auto as = llvm::cast<llvm::MDString>(op->getOperand(1))->getString();
+    gDeferredStubs[name.str()] = as.str();
+  }
+  M->eraseNamedMetadata(md);
+}
+
+static void AddStubInlineAsm(llvm::Module *M, const std::string &stub_name,
+                             const std::string &as) {
+  if (gDeferStubs) {
+    std::lock_guard<std::mutex> locker(gDeferredStubsLock);
+    gDeferredStubs[stub_name] = as;
+  } else {
+    M->appendModuleInlineAsm(as);
+  }
+}
+
 void ArchSetCallingConv(llvm::Module *M, llvm::CallInst *ci) {
   ci->setCallingConv(ArchGetCallingConv(M));
 }
@@ -448,7 +765,7 @@ static void LinuxAddPushJumpStub(llvm::Module *M, llvm::Function *F,
   as << "  .size " << stub_name << ",0b-" << stub_name << ";\n";
   as << "  .cfi_endproc;\n";
 
-  M->appendModuleInlineAsm(as.str());
+  AddStubInlineAsm(M, stub_name, as.str());
 }
 
 std::string ArchNameMcSemaCall(const std::string &name) {
@@ -519,7 +836,7 @@ static void WindowsAddPushJumpStub(bool decorateStub, llvm::Module *M,
   as << "  jmp " << stub_handler << ";\n";
   as << "  .cfi_endproc;\n";
 
-  M->appendModuleInlineAsm(as.str());
+  AddStubInlineAsm(M, stub_name, as.str());
 }
 
 // Add a function that can be used to transition from native code into lifted
@@ -579,6 +896,27 @@ llvm::Function *ArchAddEntryPointDriver(llvm::Module *M,
   return W;
 }
 
+static const char * const kLeanTransitionAttr = "mcsema-lean-transition";
+
+bool ArchUseLeanTransition(llvm::Function *F) {
+  auto M = F->getParent();
+  if (llvm::Triple::Linux != SystemOS(M) || _X86_64_ != SystemArch(M)) {
+    return false;
+  }
+  F->addFnAttr(kLeanTransitionAttr);
+  return true;
+}
+
+static const char * const kDirectCallAttr = "mcsema-direct-call";
+
+void ArchUseDirectCall(llvm::Function *F) {
+  F->addFnAttr(kDirectCallAttr);
+}
+
+bool ArchIsDirectCall(const llvm::Function *F) {
+  return F->hasFnAttribute(kDirectCallAttr);
+}
+
 // Wrap `F` in a function that will transition from lifted code into native
 // code, where `F` is an external reference to a native function.
 llvm::Function *ArchAddExitPointDriver(llvm::Function *F) {
@@ -608,7 +946,11 @@ llvm::Function *ArchAddExitPointDriver(llvm::Function *F) {
 
   if (llvm::Triple::Linux == OS) {
     if (_X86_64_ == Arch) {
-      LinuxAddPushJumpStub(M, F, W, "__mcsema_detach_call");
+      if (F->hasFnAttribute(kLeanTransitionAttr)) {
+        LinuxAddPushJumpStub(M, F, W, "__mcsema_detach_call_lean");
+      } else {
+        LinuxAddPushJumpStub(M, F, W, "__mcsema_detach_call");
+      }
     } else {
       switch (F->getCallingConv()) {
         case llvm::CallingConv::C:
@@ -700,6 +1042,17 @@ llvm::Value *doSubtractImageBase(llvm::Value *original,
   llvm::Type *intWidthTy = llvm::Type::getIntNTy(C, width);
   llvm::Type *ptrWidthTy = llvm::PointerType::get(intWidthTy, 0);
 
+  // References to data are constants; keep the result constant too, so that
+  // it can be folded.
+  if (auto original_const = llvm::dyn_cast<llvm::Constant>(original)) {
+    auto int64_ty = llvm::Type::getInt64Ty(C);
+    auto data_v = llvm::ConstantExpr::getSub(
+        llvm::ConstantExpr::getPtrToInt(original_const, int64_ty),
+        llvm::ConstantExpr::getPtrToInt(
+            llvm::cast<llvm::Constant>(ImageBase), int64_ty));
+    return llvm::ConstantExpr::getIntToPtr(data_v, ptrWidthTy);
+  }
+
   // TODO(artem): Why use `64` below??
 
   // convert original value pointer to int
@@ -4,6 +4,7 @@
 #define MC_SEMA_ARCH_ARCH_H_
 
 #include <string>
+#include <vector>
 
 #include <llvm/ADT/Triple.h>
 #include <llvm/IR/CallingConv.h>
@@ -130,18 +131,57 @@ enum PointerSize {
 
 bool ListArchSupportedInstructions(const std::string &triple, llvm::raw_ostream &s, bool ListSupported, bool ListUnsupported);
 
+// Returns the name of the instruction opcode `opcode`.
+std::string ArchInstructionName(unsigned opcode);
+
+// Returns true if code outside of the lifted function can observe the
+// program counter while `opcode` executes, i.e. if it is a call, return,
+// indirect branch, trap, or has other side effects. If `may_fault` is true,
+// instructions that access memory are treated as observable as well.
+bool ArchInstructionObservesPC(unsigned opcode, bool may_fault);
+
+// Returns true if `opcode` is a return instruction.
+bool ArchInstructionIsReturn(unsigned opcode);
+
+// Returns true if `opcode` is an unconditional jump to a fixed target.
+bool ArchInstructionIsDirectJump(unsigned opcode);
+
+// Returns true if execution always continues at the next instruction after
+// `opcode`, i.e. if it isn't a branch, return or trap. Calls continue at the
+// next instruction.
+bool ArchInstructionFallsThrough(unsigned opcode);
+
+// Collects the registers that `inst` reads into `uses`, and the registers
+// that it writes into `defs`, including its implicit operands. Returns false
+// if they aren't known, e.g. for extended opcodes.
+bool ArchInstructionRegisters(const llvm::MCInst &inst,
+                              std::vector<unsigned> &uses,
+                              std::vector<unsigned> &defs);
+
+// Returns the index of the first operand of the memory operand of `inst`, or
+// -1 if it has none. Memory operands span `llvm::X86::AddrNumOperands`
+// operands.
+int ArchMemoryOperandIndex(const llvm::MCInst &inst);
+
 bool InitArch(llvm::LLVMContext *context,
               const std::string &os,
               const std::string &arch);
 
+// Initialize the per-thread architecture state of a thread that will lift
+// code into `context`. `InitArch` does this for the calling thread.
+void ArchInitContext(llvm::LLVMContext *context);
+
 int ArchAddressSize(void);
 
 const std::string &ArchTriple(void);
 const std::string &ArchDataLayout(void);
 
-// Decodes the instruction, and returns the number of bytes decoded.
+// Decodes the instruction, and returns the number of bytes decoded. If
+// `cacheable` is true, then the decoded instruction may come from, or be
+// added to, a cache of instructions keyed by their bytes.
 size_t ArchDecodeInstruction(const uint8_t *bytes, const uint8_t *bytes_end,
-                             uintptr_t va, llvm::MCInst &inst);
+                             uintptr_t va, llvm::MCInst &inst,
+                             bool cacheable);
 
 // Return the default calling convention for code on this architecture.
 llvm::CallingConv::ID ArchCallingConv(void);
@@ -158,11 +198,45 @@ llvm::Triple::OSType OSType(void);
 
 void ArchInitAttachDetach(llvm::Module *M);
 
+// When `defer` is true, the inline assembly of the entry and exit point stubs
+// created by the calling thread is held back instead of being added to the
+// module. This is used when lifting into module shards, which would otherwise
+// each define the same stubs.
+void ArchDeferStubs(bool defer);
+
+// Add the inline assembly of all deferred stubs to `M`.
+void ArchAddDeferredStubs(llvm::Module *M);
+
+// Move the deferred stubs into named metadata of `M`, so that they can be
+// added once, by `ArchLoadDeferredStubs` and `ArchAddDeferredStubs`, after
+// partial modules lifted by different processes are linked together.
+void ArchSaveDeferredStubs(llvm::Module *M);
+
+// Take the stubs saved by `ArchSaveDeferredStubs` out of the metadata of `M`,
+// and defer them again.
+void ArchLoadDeferredStubs(llvm::Module *M);
+
 llvm::Function *ArchAddEntryPointDriver(
     llvm::Module *M, const std::string &name, VA entry);
 
 llvm::Function *ArchAddExitPointDriver(llvm::Function *F);
 
+// Mark the external function `F` so that its exit point driver only
+// marshals the registers that its calling convention uses, rather than the
+// whole register state. Only valid if the signature of `F` is known exactly.
+// Returns false if the target has no such transition.
+bool ArchUseLeanTransition(llvm::Function *F);
+
+// Mark the external function `F` so that lifted code calls it directly, with
+// its arguments taken from the register state and its return value written
+// back into it, instead of through an exit point driver. Only valid if `F`
+// follows its calling convention and never calls back into lifted code.
+void ArchUseDirectCall(llvm::Function *F);
+
+// Returns true if lifted code should call the external function `F`
+// directly.
+bool ArchIsDirectCall(const llvm::Function *F);
+
 llvm::Function *ArchAddCallbackDriver(llvm::Module *M, VA local_target);
 
 void ArchSetCallingConv(llvm::Module *M, llvm::CallInst *ci);
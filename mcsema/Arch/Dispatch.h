@@ -3,13 +3,20 @@
 #ifndef MC_SEMA_ARCH_DISPATCH_H_
 #define MC_SEMA_ARCH_DISPATCH_H_
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "mcsema/Arch/Arch.h"
 
 namespace llvm {
 class BasicBlock;
 class Function;
+class IntegerType;
 class MCInst;
 class Module;
 }  // namespace llvm
@@ -18,15 +25,34 @@ class NativeModule;
 class NativeFunction;
 class NativeBlock;
 class NativeInst;
+class RegisterLiveness;
+struct RegisterTable;
 
 struct TranslationContext {
   NativeModule *natM;
   NativeFunction *natF;
   NativeBlock *natB;
   NativeInst *natI;
+
+  // The instruction of `natB` that was lifted right before `natI`, or
+  // `nullptr` if `natI` starts the block.
+  NativeInst *prevI;
+
   llvm::Module *M;
   llvm::Function *F;
-  std::map<VA, llvm::BasicBlock *> va_to_bb;
+  RegisterTable *regs;
+  std::unordered_map<VA, llvm::BasicBlock *> va_to_bb;
+
+  // The integer type of an address, so that it isn't looked up again for
+  // every instruction.
+  llvm::IntegerType *addr_ty;
+
+  // The registers that are dead after each instruction of `natF`, or
+  // `nullptr` if dead register stores aren't being eliminated.
+  const RegisterLiveness *liveness;
+
+  // Blocks whose last instructions haven't been annotated yet.
+  std::vector<llvm::BasicBlock *> unannotated_blocks;
 };
 
 enum InstTransResult : int {
@@ -40,11 +66,129 @@ enum InstTransResult : int {
 typedef InstTransResult (InstructionLifter)(
     TranslationContext &, llvm::BasicBlock *&);
 
-class DispatchMap : public std::map<unsigned, InstructionLifter *> {};
+// Instruction lifters, indexed by opcode. Opcodes are dense, so this is a
+// flat table. Every lookup through `dispatch` is counted.
+class DispatchMap {
+ public:
+  DispatchMap(void)
+      : family(nullptr) {}
+
+  // Name the semantics family, e.g. "SSE", whose lifters are about to be
+  // added to the table.
+  void set_family(const char *family_) {
+    family = family_;
+    families.push_back(family_);
+  }
+
+  // Returns the lifter slot of `opcode`. Only used while the table is being
+  // populated, i.e. before `seal` is called.
+  InstructionLifter *&operator[](unsigned opcode) {
+    if (opcode >= lifters.size()) {
+      lifters.resize(opcode + 1, nullptr);
+      opcode_families.resize(opcode + 1, nullptr);
+    }
+    opcode_families[opcode] = family;
+    return lifters[opcode];
+  }
+
+  // Allocate the hit counters once every lifter is registered.
+  void seal(void) {
+    hits.reset(new std::atomic<uint64_t>[lifters.size()]());
+  }
+
+  // Returns the number of opcode slots in the table.
+  unsigned size(void) const {
+    return static_cast<unsigned>(lifters.size());
+  }
+
+  // Returns the lifter for `opcode`, or `nullptr` if there is none.
+  InstructionLifter *find(unsigned opcode) const {
+    return opcode < lifters.size() ? lifters[opcode] : nullptr;
+  }
+
+  // Like `find`, but counts a hit on the lifter of `opcode`.
+  InstructionLifter *dispatch(unsigned opcode) {
+    auto lifter = find(opcode);
+    if (lifter) {
+      hits[opcode].fetch_add(1, std::memory_order_relaxed);
+    }
+    return lifter;
+  }
+
+  // Returns the semantics family of the lifter for `opcode`, or `nullptr`.
+  const char *family_of(unsigned opcode) const {
+    return opcode < opcode_families.size() ? opcode_families[opcode] : nullptr;
+  }
+
+  // Returns the names of all semantics families in the table.
+  const std::vector<const char *> &family_names(void) const {
+    return families;
+  }
+
+  // Returns how many times the lifter of `opcode` was dispatched to.
+  uint64_t num_hits(unsigned opcode) const {
+    return opcode < lifters.size() && hits ?
+           hits[opcode].load(std::memory_order_relaxed) : 0;
+  }
+
+ private:
+  std::vector<InstructionLifter *> lifters;
+  std::vector<const char *> opcode_families;
+  std::vector<const char *> families;
+  const char *family;
+  std::unique_ptr<std::atomic<uint64_t>[]> hits;
+};
 
 InstructionLifter *ArchGetInstructionLifter(const llvm::MCInst &inst);
 
+// Returns true if instructions with opcode `opcode` have a lifter. Unlike
+// `ArchGetInstructionLifter`, this doesn't count as a hit on the lifter.
+bool ArchHasInstructionLifter(unsigned opcode);
+
+// Returns the semantics family of the lifter for `inst`, or `nullptr` if
+// `inst` has no lifter.
+const char *ArchGetInstructionFamily(const llvm::MCInst &inst);
+
+// Returns the names of the semantics families of this architecture.
+const std::vector<const char *> &ArchGetInstructionFamilies(void);
+
+// Returns the opcodes whose lifters were used, along with how many
+// instructions each one lifted.
+std::vector<std::pair<unsigned, uint64_t>> ArchGetInstructionLifterHits(void);
+
+// Returns a lifter that lifts `ctx.natI` as part of an idiom, usually
+// together with `ctx.prevI`, or `nullptr` if there is no such idiom. The
+// fused lifter leaves the same state behind as the normal one.
+extern InstructionLifter *(*ArchGetFusedLifter)(TranslationContext &ctx);
+
 extern InstTransResult (*ArchLiftInstruction)(
     TranslationContext &, llvm::BasicBlock *&, InstructionLifter *);
 
+// Pre-process the instructions of a function before it is lifted.
+extern void (*ArchPreProcessFunction)(
+    NativeModule *, NativeFunction *, llvm::Module *);
+
+// Map the fixed stack frame of a function onto an `alloca` in `entry`, the
+// entry block of its lifted function. Returns false, and does nothing, if the
+// function has no such frame, or if the frame's address may escape.
+extern bool (*ArchAllocStackFrame)(NativeFunction *, llvm::BasicBlock *entry);
+
+// Forget the stack frame of a lifted function once it has been lifted.
+extern void (*ArchFreeStackFrame)(llvm::Function *);
+
+// Returns true if the instruction accesses the stack frame that was mapped
+// onto an `alloca` of the lifted function.
+extern bool (*ArchAccessesStackFrame)(llvm::Function *, NativeInst *);
+
+// Checks the `size`-byte access at `addr`. If `addr` points into a mapped
+// stack frame, but the access doesn't fit in the frame, then the whole frame
+// is put back on the native stack when the function is finished.
+extern void (*ArchFitStackFrameAccess)(llvm::BasicBlock *, llvm::Value *addr,
+                                       unsigned size);
+
+// Returns true if the function only reads its return address to return
+// through it, and only leaves the function by returning, so that direct calls
+// to it don't need to write the return address.
+extern bool (*ArchKeepsReturnAddressPrivate)(NativeModule *, NativeFunction *);
+
 #endif  // MC_SEMA_ARCH_DISPATCH_H_
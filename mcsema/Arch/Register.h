@@ -4,6 +4,7 @@
 #define MC_SEMA_ARCH_REGISTER_H_
 
 #include <string>
+#include <vector>
 
 #include <llvm/lib/Target/X86/MCTargetDesc/X86MCTargetDesc.h>
 
@@ -11,8 +12,11 @@ namespace llvm {
 
 class BasicBlock;
 class Function;
+class Instruction;
+class MDNode;
 class Module;
 class StructType;
+class Value;
 
 namespace X86 {
 
@@ -85,11 +89,39 @@ enum : unsigned {
 
 using MCSemaRegs = unsigned;
 
+// Pointers to the read and write variables of the registers in a lifted
+// function, indexed by `MCSemaRegs`. The table is created by
+// `ArchAllocRegisterVars`, and the variables of a register are created by
+// `ArchGetRegisterVar` the first time that it is used, so entries of unused
+// registers are null.
+struct RegisterTable {
+  std::vector<llvm::Value *> read;
+  std::vector<llvm::Value *> write;
+
+  // The register variables are put at the start of `entry`, in the order
+  // that they are created. `last_var` is the last one so far.
+  llvm::BasicBlock *entry = nullptr;
+  llvm::Instruction *last_var = nullptr;
+
+  // The ST register that holds each slot of the x87 stack, while lifting a
+  // run of x87 instructions. Pushes, pops and exchanges only update this
+  // mapping; `ArchSyncRegisterVars` puts the registers back in stack order.
+  unsigned fpu_stack[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+  // TBAA tags of the register variables, indexed by `MCSemaRegs`, and of
+  // guest memory. Filled in as they are needed.
+  std::vector<llvm::MDNode *> tbaa;
+  llvm::MDNode *memory_tbaa = nullptr;
+};
+
 extern const std::string &(*ArchRegisterName)(MCSemaRegs);
 extern MCSemaRegs (*ArchRegisterNumber)(const std::string &);
 extern unsigned (*ArchRegisterOffset)(MCSemaRegs);
 extern MCSemaRegs (*ArchRegisterParent)(MCSemaRegs);
 extern void (*ArchAllocRegisterVars)(llvm::BasicBlock *);
+extern llvm::Value *(*ArchGetRegisterVar)(llvm::Function *, MCSemaRegs,
+                                          bool is_write);
+extern void (*ArchSyncRegisterVars)(llvm::BasicBlock *);
 extern unsigned (*ArchRegisterSize)(MCSemaRegs);
 extern llvm::StructType *(*ArchRegStateStructType)(void);
 extern llvm::Function *(*ArchGetOrCreateRegStateTracer)(llvm::Module *);
@@ -1,5 +1,6 @@
 /* Copyright 2017 Peter Goodman (peter@trailofbits.com), all rights reserved. */
 
+#include "mcsema/Arch/Arch.h"
 #include "mcsema/Arch/Dispatch.h"
 
 #include "mcsema/Arch/X86/Semantics/fpu.h"
@@ -21,23 +22,52 @@
 #include "mcsema/Arch/X86/Semantics/SETcc.h"
 #include "mcsema/Arch/X86/Semantics/SSE.h"
 
+// The lifters are specialized for the address width of the code, so that
+// they don't test it while lifting.
+template <int addr_width>
+static void InitInstructionDispatch(DispatchMap &dispatcher) {
+  dispatcher.set_family("FPU");
+  FPU_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("MOV");
+  MOV_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("CMOV");
+  CMOV_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("Jcc");
+  Jcc_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("MULDIV");
+  MULDIV_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("CMPTEST");
+  CMPTEST_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("ADD");
+  ADD_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("Misc");
+  Misc_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("SUB");
+  SUB_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("Bitops");
+  Bitops_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("ShiftRoll");
+  ShiftRoll_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("Exchanges");
+  Exchanges_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("INCDECNEG");
+  INCDECNEG_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("Stack");
+  Stack_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("String");
+  String_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("Branches");
+  Branches_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("SETcc");
+  SETcc_populateDispatchMap<addr_width>(dispatcher);
+  dispatcher.set_family("SSE");
+  SSE_populateDispatchMap<addr_width>(dispatcher);
+}
+
 void X86InitInstructionDispatch(DispatchMap &dispatcher) {
-  FPU_populateDispatchMap(dispatcher);
-  MOV_populateDispatchMap(dispatcher);
-  CMOV_populateDispatchMap(dispatcher);
-  Jcc_populateDispatchMap(dispatcher);
-  MULDIV_populateDispatchMap(dispatcher);
-  CMPTEST_populateDispatchMap(dispatcher);
-  ADD_populateDispatchMap(dispatcher);
-  Misc_populateDispatchMap(dispatcher);
-  SUB_populateDispatchMap(dispatcher);
-  Bitops_populateDispatchMap(dispatcher);
-  ShiftRoll_populateDispatchMap(dispatcher);
-  Exchanges_populateDispatchMap(dispatcher);
-  INCDECNEG_populateDispatchMap(dispatcher);
-  Stack_populateDispatchMap(dispatcher);
-  String_populateDispatchMap(dispatcher);
-  Branches_populateDispatchMap(dispatcher);
-  SETcc_populateDispatchMap(dispatcher);
-  SSE_populateDispatchMap(dispatcher);
+  if (64 == ArchAddressSize()) {
+    InitInstructionDispatch<64>(dispatcher);
+  } else {
+    InitInstructionDispatch<32>(dispatcher);
+  }
 }
@@ -0,0 +1,909 @@
+/*
+ Copyright (c) 2013, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/Analysis/ValueTracking.h>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+
+#include <llvm/MC/MCInst.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/Arch/Register.h"
+#include "mcsema/Arch/X86/Frame.h"
+#include "mcsema/CFG/CFG.h"
+#include "mcsema/CFG/Externals.h"
+
+namespace {
+
+// Frames bigger than this are left on the native stack.
+static const int64_t kMaxFrameSize = 1 << 16;
+
+// The fixed part of a function's stack frame, i.e. the `size` bytes below
+// the saved frame pointer, kept in an `alloca`.
+struct StackFrame {
+  llvm::AllocaInst *alloca;
+  int64_t size;
+
+  // Set if the frame has to go back to the native stack.
+  bool is_native;
+};
+
+static thread_local std::unordered_map<llvm::Function *, StackFrame> gFrames;
+
+static bool IsFramePointer(unsigned reg) {
+  return llvm::X86::RBP == reg || llvm::X86::EBP == reg ||
+         llvm::X86::BP == reg || llvm::X86::BPL == reg;
+}
+
+static bool IsStackPointer(unsigned reg) {
+  return llvm::X86::RSP == reg || llvm::X86::ESP == reg ||
+         llvm::X86::SP == reg || llvm::X86::SPL == reg;
+}
+
+static bool IsReg(const llvm::MCInst &inst, unsigned i, unsigned reg) {
+  return i < inst.getNumOperands() && inst.getOperand(i).isReg() &&
+         reg == inst.getOperand(i).getReg();
+}
+
+// Returns the size of the frame set up by a `push rbp; mov rbp, rsp;
+// sub rsp, N` prologue at the beginning of `insts`, or 0 if there isn't one.
+static int64_t GetFrameSize(const std::vector<NativeInstPtr> &insts,
+                            bool is_64) {
+  if (3 > insts.size()) {
+    return 0;
+  }
+
+  auto fp = is_64 ? llvm::X86::RBP : llvm::X86::EBP;
+  auto sp = is_64 ? llvm::X86::RSP : llvm::X86::ESP;
+
+  const auto &push = insts[0]->get_inst();
+  if ((is_64 ? llvm::X86::PUSH64r : llvm::X86::PUSH32r) != push.getOpcode() ||
+      !IsReg(push, 0, fp)) {
+    return 0;
+  }
+
+  const auto &mov = insts[1]->get_inst();
+  switch (mov.getOpcode()) {
+    case llvm::X86::MOV64rr:
+    case llvm::X86::MOV64rr_REV:
+      if (!is_64) {
+        return 0;
+      }
+      break;
+    case llvm::X86::MOV32rr:
+    case llvm::X86::MOV32rr_REV:
+      if (is_64) {
+        return 0;
+      }
+      break;
+    default:
+      return 0;
+  }
+  if (!IsReg(mov, 0, fp) || !IsReg(mov, 1, sp)) {
+    return 0;
+  }
+
+  const auto &sub = insts[2]->get_inst();
+  switch (sub.getOpcode()) {
+    case llvm::X86::SUB64ri8:
+    case llvm::X86::SUB64ri32:
+      if (!is_64) {
+        return 0;
+      }
+      break;
+    case llvm::X86::SUB32ri8:
+    case llvm::X86::SUB32ri:
+      if (is_64) {
+        return 0;
+      }
+      break;
+    default:
+      return 0;
+  }
+  if (!IsReg(sub, 0, sp) || 3 > sub.getNumOperands() ||
+      !sub.getOperand(2).isImm()) {
+    return 0;
+  }
+
+  auto size = sub.getOperand(2).getImm();
+  if (0 >= size || kMaxFrameSize < size) {
+    return 0;
+  }
+  return size;
+}
+
+// Returns true if `inst` tears down the frame, i.e. it is one of `leave`,
+// `pop rbp` or `mov rsp, rbp`.
+static bool IsEpilogue(const llvm::MCInst &inst) {
+  switch (inst.getOpcode()) {
+    case llvm::X86::LEAVE:
+    case llvm::X86::LEAVE64:
+      return true;
+    case llvm::X86::POP64r:
+    case llvm::X86::POP32r:
+      return IsReg(inst, 0, llvm::X86::RBP) || IsReg(inst, 0, llvm::X86::EBP);
+    case llvm::X86::MOV64rr:
+    case llvm::X86::MOV64rr_REV:
+    case llvm::X86::MOV32rr:
+    case llvm::X86::MOV32rr_REV:
+      return IsStackPointer(inst.getOperand(0).getReg()) &&
+             IsFramePointer(inst.getOperand(1).getReg());
+    default:
+      return false;
+  }
+}
+
+// Returns true if `inst` is `add rsp, N` or `sub rsp, N`.
+static bool IsStackAdjustment(const llvm::MCInst &inst) {
+  switch (inst.getOpcode()) {
+    case llvm::X86::ADD64ri8:
+    case llvm::X86::ADD64ri32:
+    case llvm::X86::ADD32ri8:
+    case llvm::X86::ADD32ri:
+    case llvm::X86::SUB64ri8:
+    case llvm::X86::SUB64ri32:
+    case llvm::X86::SUB32ri8:
+    case llvm::X86::SUB32ri:
+      return IsStackPointer(inst.getOperand(0).getReg());
+    default:
+      return false;
+  }
+}
+
+// The instructions that may use the stack pointer implicitly.
+static const char *kStackOpcodes[] = {"PUSH", "POP", "CALL", "RET"};
+
+static bool IsStackOperation(const llvm::MCInst &inst) {
+  auto name = ArchInstructionName(inst.getOpcode());
+  for (auto prefix : kStackOpcodes) {
+    if (!name.compare(0, strlen(prefix), prefix)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if `inst` can't leak the address of the frame, leave it
+// reachable through anything but the frame pointer, or change the frame
+// pointer. The frame pointer may only be used as the base of a memory
+// operand. The stack pointer may only be used implicitly, by pushes, pops,
+// calls and returns, or be adjusted by a constant or restored from the frame
+// pointer; e.g. `lea rdi, [rsp + 8]` and `mov rdi, rsp` leak the frame.
+static bool KeepsFrameLocal(const llvm::MCInst &inst) {
+  std::vector<unsigned> uses;
+  std::vector<unsigned> defs;
+  if (!ArchInstructionRegisters(inst, uses, defs)) {
+    return false;
+  }
+
+  if (IsEpilogue(inst) || IsStackAdjustment(inst)) {
+    return true;
+  }
+
+  for (unsigned i = 0; i < inst.getNumOperands(); ++i) {
+    const auto &op = inst.getOperand(i);
+    if (op.isReg() && IsStackPointer(op.getReg())) {
+      return false;
+    }
+  }
+
+  auto is_stack_op = IsStackOperation(inst);
+  for (auto reg : defs) {
+    if (IsFramePointer(reg) || (IsStackPointer(reg) && !is_stack_op)) {
+      return false;
+    }
+  }
+
+  auto num_fp_uses = 0U;
+  for (auto reg : uses) {
+    if (IsStackPointer(reg) && !is_stack_op) {
+      return false;
+    } else if (IsFramePointer(reg)) {
+      ++num_fp_uses;
+    }
+  }
+
+  auto mem = ArchMemoryOperandIndex(inst);
+  if (0 > mem) {
+    return !num_fp_uses;
+  }
+
+  switch (inst.getOpcode()) {
+    case llvm::X86::LEA16r:
+    case llvm::X86::LEA32r:
+    case llvm::X86::LEA64r:
+    case llvm::X86::LEA64_32r:
+      return !num_fp_uses;
+    default:
+      break;
+  }
+
+  const auto &base = inst.getOperand(mem + llvm::X86::AddrBaseReg);
+  const auto &index = inst.getOperand(mem + llvm::X86::AddrIndexReg);
+  if (IsFramePointer(index.getReg())) {
+    return false;
+  }
+
+  // The only use of the frame pointer is as the base register.
+  return num_fp_uses == (IsFramePointer(base.getReg()) ? 1U : 0U);
+}
+
+// Where the stack pointer or frame pointer points, relative to the stack
+// pointer on entry to the function, i.e. to the return address.
+enum StackPtrKind {
+  kNotStackPtr,
+  kKnownStackPtr,
+  kUnknownStackPtr
+};
+
+struct StackPtr {
+  StackPtrKind kind;
+  int64_t offset;
+
+  bool operator==(const StackPtr &that) const {
+    return kind == that.kind &&
+           (kKnownStackPtr != kind || offset == that.offset);
+  }
+
+  bool operator!=(const StackPtr &that) const {
+    return !(*this == that);
+  }
+
+  bool IsStack(void) const {
+    return kNotStackPtr != kind;
+  }
+};
+
+static const StackPtr kNoStack = {kNotStackPtr, 0};
+static const StackPtr kUnknownStack = {kUnknownStackPtr, 0};
+
+static StackPtr Known(int64_t offset) {
+  return {kKnownStackPtr, offset};
+}
+
+static StackPtr Offset(StackPtr ptr, int64_t delta) {
+  if (kKnownStackPtr == ptr.kind) {
+    ptr.offset += delta;
+  }
+  return ptr;
+}
+
+static StackPtr Merge(StackPtr a, StackPtr b) {
+  return a == b ? a : kUnknownStack;
+}
+
+struct StackState {
+  StackPtr sp;
+  StackPtr fp;
+};
+
+// Accesses of unknown size are assumed to be no bigger than this. The
+// instructions that save or restore the FPU or extended state are bigger.
+static const int64_t kMaxAccessSize = 16;
+static const int64_t kMaxStateSize = 4096;
+
+static const char *kStateSaveOpcodes[] = {
+    "FXSAVE", "FXRSTOR", "XSAVE", "XRSTOR", "FSAVE", "FRSTOR", "FLDENV",
+    "FSTENV"
+};
+
+static int64_t AccessSize(const llvm::MCInst &inst) {
+  auto name = ArchInstructionName(inst.getOpcode());
+  for (auto prefix : kStateSaveOpcodes) {
+    if (!name.compare(0, strlen(prefix), prefix)) {
+      return kMaxStateSize;
+    }
+  }
+  return kMaxAccessSize;
+}
+
+// Checks whether a function reads its return address, other than through
+// the `ret` that returns through it, by tracking the stack and frame
+// pointers through its blocks.
+class ReturnAddressChecker {
+ public:
+  ReturnAddressChecker(NativeModule *mod_, NativeFunction *func_)
+      : mod(mod_),
+        func(func_),
+        is_64(Pointer64 == ArchAddressSize()),
+        ptr_size(is_64 ? 8 : 4) {}
+
+  bool KeepsReturnAddressPrivate(void);
+
+ private:
+  StackPtr Pointer(const StackState &state, unsigned reg) const;
+  bool IsSafeAccess(const StackState &state, const llvm::MCInst &inst,
+                    int mem, int64_t size) const;
+  bool CallKeepsStack(NativeInstPtr inst) const;
+  bool Step(NativeInstPtr inst, StackState &state) const;
+  bool StepGeneric(const llvm::MCInst &inst, int mem,
+                   StackState &state) const;
+
+  NativeModule *mod;
+  NativeFunction *func;
+  bool is_64;
+  int64_t ptr_size;
+};
+
+StackPtr ReturnAddressChecker::Pointer(const StackState &state,
+                                       unsigned reg) const {
+  if (IsStackPointer(reg)) {
+    return state.sp;
+  } else if (IsFramePointer(reg)) {
+    return state.fp;
+  } else {
+    return kNoStack;
+  }
+}
+
+// Returns true if the memory operand of `inst`, accessing `size` bytes,
+// can't overlap the return address.
+bool ReturnAddressChecker::IsSafeAccess(const StackState &state,
+                                        const llvm::MCInst &inst, int mem,
+                                        int64_t size) const {
+  const auto &base = inst.getOperand(mem + llvm::X86::AddrBaseReg);
+  const auto &index = inst.getOperand(mem + llvm::X86::AddrIndexReg);
+  const auto &disp = inst.getOperand(mem + llvm::X86::AddrDisp);
+  if (Pointer(state, index.getReg()).IsStack()) {
+    return false;
+  }
+
+  auto ptr = Pointer(state, base.getReg());
+  if (!ptr.IsStack()) {
+    return true;
+  }
+  if (kKnownStackPtr != ptr.kind || !disp.isImm()) {
+    return false;
+  }
+
+  auto addr = ptr.offset + disp.getImm();
+  return addr + size <= 0 || addr >= ptr_size;
+}
+
+// Returns true if the stack pointer is the same before and after the call.
+// Only 32-bit code has callees that pop their arguments.
+bool ReturnAddressChecker::CallKeepsStack(NativeInstPtr inst) const {
+  if (is_64) {
+    return true;
+  }
+
+  if (inst->has_ext_call_target()) {
+    return ExternalCodeRef::CallerCleanup ==
+           inst->get_ext_call_target()->getCallingConvention();
+  }
+
+  const auto &mcinst = inst->get_inst();
+  VA target = 0;
+  if (inst->has_code_ref()) {
+    target = inst->get_reference(NativeInst::MEMRef);
+  } else if (llvm::X86::CALLpcrel32 == mcinst.getOpcode()) {
+    target = inst->get_loc() + inst->get_len() + mcinst.getOperand(0).getImm();
+  } else {
+    return false;
+  }
+
+  const auto &funcs = mod->get_funcs();
+  auto func_it = funcs.find(target);
+  if (func_it == funcs.end()) {
+    return false;
+  }
+
+  // The callee pops its arguments if it returns with `ret N`.
+  for (const auto &block : func_it->second->get_blocks()) {
+    for (auto callee_inst : block.second->get_insts()) {
+      const auto &ret = callee_inst->get_inst();
+      if (ArchInstructionIsReturn(ret.getOpcode()) &&
+          ret.getNumOperands() && ret.getOperand(0).isImm() &&
+          ret.getOperand(0).getImm()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Track the stack and frame pointers through `inst`. Returns false if the
+// instruction may read the return address, leak a pointer to it, or leave
+// the function other than by returning.
+bool ReturnAddressChecker::Step(NativeInstPtr inst,
+                                StackState &state) const {
+  const auto &mcinst = inst->get_inst();
+  auto opcode = mcinst.getOpcode();
+  auto mem = ArchMemoryOperandIndex(mcinst);
+
+  auto is_lea = llvm::X86::LEA16r == opcode || llvm::X86::LEA32r == opcode ||
+                llvm::X86::LEA64r == opcode || llvm::X86::LEA64_32r == opcode;
+  if (0 <= mem && !is_lea &&
+      !IsSafeAccess(state, mcinst, mem, AccessSize(mcinst))) {
+    return false;
+  }
+
+  auto reg0 = mcinst.getNumOperands() && mcinst.getOperand(0).isReg() ?
+              mcinst.getOperand(0).getReg() : 0U;
+  auto reg1 = 1 < mcinst.getNumOperands() && mcinst.getOperand(1).isReg() ?
+              mcinst.getOperand(1).getReg() : 0U;
+
+  switch (opcode) {
+    case llvm::X86::PUSH64r:
+    case llvm::X86::PUSH64rmr:
+    case llvm::X86::PUSH32r:
+    case llvm::X86::PUSH32rmr:
+      if (Pointer(state, reg0).IsStack()) {
+        return false;
+      }
+      state.sp = Offset(state.sp, -ptr_size);
+      return true;
+
+    case llvm::X86::PUSH64i8:
+    case llvm::X86::PUSH64i32:
+    case llvm::X86::PUSH64rmm:
+    case llvm::X86::PUSHi32:
+    case llvm::X86::PUSH32i8:
+    case llvm::X86::PUSH32rmm:
+    case llvm::X86::PUSHF64:
+    case llvm::X86::PUSHF32:
+      state.sp = Offset(state.sp, -ptr_size);
+      return true;
+
+    case llvm::X86::POP64r:
+    case llvm::X86::POP64rmr:
+    case llvm::X86::POP32r:
+    case llvm::X86::POP32rmr:
+      if (IsStackPointer(reg0)) {
+        return false;
+      } else if (IsFramePointer(reg0)) {
+        state.fp = kNoStack;
+      }
+      state.sp = Offset(state.sp, ptr_size);
+      return true;
+
+    // The address of the destination is computed after the pop.
+    case llvm::X86::POP64rmm:
+    case llvm::X86::POP32rmm:
+      if (Pointer(state, mcinst.getOperand(
+              mem + llvm::X86::AddrBaseReg).getReg()).IsStack()) {
+        return false;
+      }
+      state.sp = Offset(state.sp, ptr_size);
+      return true;
+
+    case llvm::X86::POPF64:
+    case llvm::X86::POPF32:
+      state.sp = Offset(state.sp, ptr_size);
+      return true;
+
+    case llvm::X86::CALLpcrel32:
+    case llvm::X86::CALL64pcrel32:
+    case llvm::X86::CALL32r:
+    case llvm::X86::CALL64r:
+    case llvm::X86::CALL32m:
+    case llvm::X86::CALL64m:
+      if (Pointer(state, reg0).IsStack()) {
+        return false;
+      }
+      if (!CallKeepsStack(inst)) {
+        state.sp = kUnknownStack;
+      }
+      return true;
+
+    // Jumps must stay within the function.
+    case llvm::X86::JMP_1:
+    case llvm::X86::JMP_2:
+    case llvm::X86::JMP_4:
+      return 0 != func->get_blocks().count(inst->get_tr());
+
+    case llvm::X86::JMP32r:
+    case llvm::X86::JMP64r:
+    case llvm::X86::JMP32m:
+    case llvm::X86::JMP64m:
+      return !inst->has_ext_call_target() &&
+             (inst->has_jump_table() ||
+              static_cast<VA>(-1) != inst->offset_table);
+
+    case llvm::X86::LEAVE:
+    case llvm::X86::LEAVE64:
+      if (kKnownStackPtr != state.fp.kind ||
+          (state.fp.offset + ptr_size > 0 && state.fp.offset < ptr_size)) {
+        return false;
+      }
+      state.sp = Offset(state.fp, ptr_size);
+      state.fp = kNoStack;
+      return true;
+
+    case llvm::X86::MOV64rr:
+    case llvm::X86::MOV64rr_REV:
+    case llvm::X86::MOV32rr:
+    case llvm::X86::MOV32rr_REV: {
+      auto is_ptr_move = is_64 == (llvm::X86::MOV64rr == opcode ||
+                                   llvm::X86::MOV64rr_REV == opcode);
+      auto src = Pointer(state, reg1);
+      if (IsStackPointer(reg0)) {
+        state.sp = is_ptr_move && src.IsStack() ? src : kUnknownStack;
+        return true;
+      } else if (IsFramePointer(reg0)) {
+        state.fp = !src.IsStack() ? kNoStack :
+                   is_ptr_move ? src : kUnknownStack;
+        return true;
+      } else {
+        return !src.IsStack();
+      }
+    }
+
+    case llvm::X86::LEA16r:
+    case llvm::X86::LEA32r:
+    case llvm::X86::LEA64r:
+    case llvm::X86::LEA64_32r: {
+      const auto &base = mcinst.getOperand(mem + llvm::X86::AddrBaseReg);
+      const auto &index = mcinst.getOperand(mem + llvm::X86::AddrIndexReg);
+      const auto &disp = mcinst.getOperand(mem + llvm::X86::AddrDisp);
+      auto is_ptr_lea = (is_64 ? llvm::X86::LEA64r : llvm::X86::LEA32r) ==
+                        opcode;
+      auto addr = Pointer(state, base.getReg());
+      if (Pointer(state, index.getReg()).IsStack()) {
+        return false;
+      } else if (!is_ptr_lea || index.getReg() || !disp.isImm()) {
+        if (addr.IsStack()) {
+          addr = kUnknownStack;
+        }
+      } else {
+        addr = Offset(addr, disp.getImm());
+      }
+
+      if (IsStackPointer(reg0)) {
+        state.sp = addr.IsStack() ? addr : kUnknownStack;
+        return true;
+      } else if (IsFramePointer(reg0)) {
+        state.fp = addr;
+        return true;
+      } else {
+        return !addr.IsStack();
+      }
+    }
+
+    case llvm::X86::ADD64ri8:
+    case llvm::X86::ADD64ri32:
+    case llvm::X86::ADD32ri8:
+    case llvm::X86::ADD32ri:
+    case llvm::X86::SUB64ri8:
+    case llvm::X86::SUB64ri32:
+    case llvm::X86::SUB32ri8:
+    case llvm::X86::SUB32ri: {
+      auto is_add = llvm::X86::ADD64ri8 == opcode ||
+                    llvm::X86::ADD64ri32 == opcode ||
+                    llvm::X86::ADD32ri8 == opcode ||
+                    llvm::X86::ADD32ri == opcode;
+      auto is_ptr_op = is_64 == (llvm::X86::ADD64ri8 == opcode ||
+                                 llvm::X86::ADD64ri32 == opcode ||
+                                 llvm::X86::SUB64ri8 == opcode ||
+                                 llvm::X86::SUB64ri32 == opcode);
+      const auto &imm = mcinst.getOperand(2);
+      if (!is_ptr_op || !imm.isImm()) {
+        break;
+      }
+      auto delta = is_add ? imm.getImm() : -imm.getImm();
+      if (IsStackPointer(reg0)) {
+        state.sp = Offset(state.sp, delta);
+        return true;
+      } else if (IsFramePointer(reg0) && state.fp.IsStack()) {
+        state.fp = Offset(state.fp, delta);
+        return true;
+      }
+      break;
+    }
+
+    default:
+      if (ArchInstructionIsReturn(opcode)) {
+        return state.sp == Known(0);
+      }
+      break;
+  }
+
+  return StepGeneric(mcinst, mem, state);
+}
+
+// Any other instruction may only use the stack and frame pointers to
+// address memory, or to update themselves.
+bool ReturnAddressChecker::StepGeneric(const llvm::MCInst &inst, int mem,
+                                       StackState &state) const {
+  std::vector<unsigned> uses;
+  std::vector<unsigned> defs;
+  if (!ArchInstructionRegisters(inst, uses, defs)) {
+    return false;
+  }
+
+  unsigned base = 0;
+  unsigned index = 0;
+  if (0 <= mem) {
+    base = inst.getOperand(mem + llvm::X86::AddrBaseReg).getReg();
+    index = inst.getOperand(mem + llvm::X86::AddrIndexReg).getReg();
+  }
+
+  auto defs_sp = false;
+  auto defs_fp = false;
+  auto defs_other = false;
+  for (auto reg : defs) {
+    if (IsStackPointer(reg)) {
+      defs_sp = true;
+    } else if (IsFramePointer(reg)) {
+      defs_fp = true;
+    } else if (llvm::X86::EFLAGS != reg) {
+      defs_other = true;
+    }
+  }
+
+  auto uses_sp = false;
+  auto uses_fp = false;
+  for (auto reg : uses) {
+    auto ptr = Pointer(state, reg);
+    if (!ptr.IsStack()) {
+      continue;
+    }
+
+    // Used as the base of the memory operand, which has been checked.
+    if (reg == base) {
+      base = 0;
+      continue;
+    }
+    if (reg == index) {
+      return false;
+    }
+
+    if (IsStackPointer(reg)) {
+      uses_sp = true;
+    } else {
+      uses_fp = true;
+    }
+  }
+
+  // The value of a stack or frame pointer may only flow into itself, as the
+  // destination operand, e.g. `and rsp, -16`. Instructions that use the
+  // stack pointer implicitly, e.g. `pusha`, are rejected.
+  auto reg0 = inst.getNumOperands() && inst.getOperand(0).isReg() ?
+              inst.getOperand(0).getReg() : 0U;
+  if (uses_sp && (defs_fp || defs_other || !IsStackPointer(reg0))) {
+    return false;
+  }
+  if (uses_fp && (defs_sp || defs_other || !IsFramePointer(reg0))) {
+    return false;
+  }
+
+  if (defs_sp) {
+    state.sp = kUnknownStack;
+  }
+  if (defs_fp) {
+    state.fp = uses_fp ? kUnknownStack : kNoStack;
+  }
+  return true;
+}
+
+bool ReturnAddressChecker::KeepsReturnAddressPrivate(void) {
+  const auto &blocks = func->get_blocks();
+  if (!blocks.count(func->get_start())) {
+    return false;
+  }
+
+  std::map<VA, StackState> entry_states;
+  std::vector<VA> work_list;
+  entry_states[func->get_start()] = {Known(0), kNoStack};
+  work_list.push_back(func->get_start());
+
+  while (true) {
+    while (!work_list.empty()) {
+      auto block_it = blocks.find(work_list.back());
+      work_list.pop_back();
+      if (block_it == blocks.end()) {
+        return false;
+      }
+
+      auto state = entry_states[block_it->first];
+      for (auto inst : block_it->second->get_insts()) {
+        if (!Step(inst, state)) {
+          return false;
+        }
+      }
+
+      for (auto succ_va : block_it->second->get_follows()) {
+        auto state_it = entry_states.find(succ_va);
+        if (state_it == entry_states.end()) {
+          entry_states[succ_va] = state;
+          work_list.push_back(succ_va);
+          continue;
+        }
+        StackState merged = {Merge(state_it->second.sp, state.sp),
+                             Merge(state_it->second.fp, state.fp)};
+        if (merged.sp != state_it->second.sp ||
+            merged.fp != state_it->second.fp) {
+          state_it->second = merged;
+          work_list.push_back(succ_va);
+        }
+      }
+    }
+
+    // Blocks that can't be reached from the entry block are lifted too, so
+    // they start with nothing known.
+    for (const auto &block_info : blocks) {
+      if (!entry_states.count(block_info.first)) {
+        entry_states[block_info.first] = {kUnknownStack, kUnknownStack};
+        work_list.push_back(block_info.first);
+        break;
+      }
+    }
+    if (work_list.empty()) {
+      return true;
+    }
+  }
+}
+
+}  // namespace
+
+bool X86AllocStackFrame(NativeFunction *func, llvm::BasicBlock *entry) {
+  auto F = entry->getParent();
+  gFrames.erase(F);
+
+  const auto &blocks = func->get_blocks();
+  auto entry_it = blocks.find(func->get_start());
+  if (entry_it == blocks.end()) {
+    return false;
+  }
+
+  auto is_64 = Pointer64 == ArchPointerSize(F->getParent());
+  auto size = GetFrameSize(entry_it->second->get_insts(), is_64);
+  if (!size) {
+    return false;
+  }
+
+  for (const auto &block : blocks) {
+    const auto &insts = block.second->get_insts();
+    for (size_t i = 0; i < insts.size(); ++i) {
+
+      // Skip the prologue.
+      if (block.first == func->get_start() && 3 > i) {
+        continue;
+      }
+      if (!KeepsFrameLocal(insts[i]->get_inst())) {
+        return false;
+      }
+    }
+  }
+
+  auto &C = F->getContext();
+  auto frame_type = llvm::ArrayType::get(llvm::Type::getInt8Ty(C), size);
+  auto alloca = new llvm::AllocaInst(frame_type, "stack_frame", entry);
+  alloca->setAlignment(16);
+  gFrames[F] = {alloca, size, false};
+  return true;
+}
+
+void X86FreeStackFrame(llvm::Function *F) {
+  auto it = gFrames.find(F);
+  if (it == gFrames.end()) {
+    return;
+  }
+
+  // The frame starts `size` bytes below the saved frame pointer, which is
+  // pushed right below the return address. Nothing has changed the stack
+  // pointer in the state structure by the end of the entry block, even if the
+  // register variables have been promoted.
+  const auto &frame = it->second;
+  if (frame.is_native) {
+    auto &entry = F->getEntryBlock();
+    auto state_ptr = &*F->arg_begin();
+    auto is_64 = Pointer64 == ArchPointerSize(F->getParent());
+    auto sp_reg = is_64 ? llvm::X86::RSP : llvm::X86::ESP;
+
+    llvm::IRBuilder<> ir(entry.getTerminator());
+    auto sp = ir.CreateLoad(ir.CreateConstInBoundsGEP2_32(
+        nullptr, state_ptr, 0,
+        ArchRegisterOffset(ArchRegisterParent(sp_reg))));
+    auto frame_addr = ir.CreateSub(
+        sp, llvm::ConstantInt::get(sp->getType(),
+                                   frame.size + (is_64 ? 8 : 4)));
+    frame.alloca->replaceAllUsesWith(
+        ir.CreateIntToPtr(frame_addr, frame.alloca->getType()));
+    frame.alloca->eraseFromParent();
+  }
+  gFrames.erase(it);
+}
+
+bool X86AccessesStackFrame(llvm::Function *F, NativeInst *inst) {
+  if (!gFrames.count(F)) {
+    return false;
+  }
+  const auto &mcinst = inst->get_inst();
+  auto mem = ArchMemoryOperandIndex(mcinst);
+  if (0 > mem) {
+    return false;
+  }
+  const auto &base = mcinst.getOperand(mem + llvm::X86::AddrBaseReg);
+  return IsFramePointer(base.getReg());
+}
+
+llvm::Value *X86GetStackFrameAddress(llvm::BasicBlock *b, llvm::Type *ptr_ty,
+                                     unsigned base_reg, unsigned index_reg,
+                                     unsigned seg_reg, int64_t disp) {
+  if (!IsFramePointer(base_reg) || llvm::X86::NoRegister != index_reg ||
+      (llvm::X86::NoRegister != seg_reg && llvm::X86::SS != seg_reg)) {
+    return nullptr;
+  }
+
+  auto it = gFrames.find(b->getParent());
+  if (it == gFrames.end()) {
+    return nullptr;
+  }
+
+  // Slots at or above the frame pointer (the saved frame pointer, the return
+  // address and the arguments) are shared with the caller, and stay on the
+  // native stack.
+  const auto &frame = it->second;
+  if (0 <= disp || -frame.size > disp) {
+    return nullptr;
+  }
+
+  llvm::IRBuilder<> ir(b);
+  auto slot = ir.CreateConstInBoundsGEP2_32(
+      nullptr, frame.alloca, 0, static_cast<unsigned>(frame.size + disp));
+  return ir.CreatePointerCast(slot, ptr_ty);
+}
+
+void X86FitStackFrameAccess(llvm::BasicBlock *b, llvm::Value *addr,
+                            unsigned size) {
+  auto it = gFrames.find(b->getParent());
+  if (it == gFrames.end() || !addr->getType()->isPointerTy()) {
+    return;
+  }
+
+  // An access that reaches above the frame, into the saved frame pointer,
+  // has to go to the native stack, like any access at or above the frame
+  // pointer. The other accesses to the frame may overlap it, so they have to
+  // go there too.
+  auto &frame = it->second;
+  int64_t offset = 0;
+  auto base = llvm::GetPointerBaseWithConstantOffset(
+      addr, offset, b->getParent()->getParent()->getDataLayout());
+  if (base == frame.alloca && offset + size > frame.size) {
+    frame.is_native = true;
+  }
+}
+
+bool X86KeepsReturnAddressPrivate(NativeModule *mod, NativeFunction *func) {
+  return ReturnAddressChecker(mod, func).KeepsReturnAddressPrivate();
+}
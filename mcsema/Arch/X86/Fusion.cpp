@@ -0,0 +1,462 @@
+/*
+ Copyright (c) 2013, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <initializer_list>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/MC/MCInst.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/Arch/Register.h"
+
+#include "mcsema/Arch/X86/Util.h"
+
+#include "mcsema/BC/Util.h"
+
+#include "mcsema/CFG/CFG.h"
+
+// Idiom fusion lifts an instruction together with the instruction that was
+// lifted right before it in the same native block, when the pair is a common
+// idiom whose meaning is simpler than the sum of its parts.
+//
+// The first instruction of a pair is always lifted normally, so the register
+// state and flags at every instruction boundary are the same as without
+// fusion. The fused lifter of the second instruction just doesn't go through
+// the state that the first one left behind. E.g. for `cmp eax, ebx; jl L`,
+// the `jl` branches on `icmp slt eax, ebx` instead of rebuilding the condition
+// from `SF` and `OF`. The flag stores of the `cmp` stay in place for whoever
+// reads them later, and are removed with the other dead flag stores if nobody
+// does.
+
+namespace {
+
+enum Condition {
+  kCondInvalid,
+  kCondE,
+  kCondNE,
+  kCondB,
+  kCondAE,
+  kCondBE,
+  kCondA,
+  kCondL,
+  kCondGE,
+  kCondLE,
+  kCondG,
+  kCondS,
+  kCondNS
+};
+
+// A `CMP` or `TEST` of a register against a register or an immediate.
+struct Comparison {
+  bool is_test;
+  unsigned width;
+  MCSemaRegs lhs;
+  MCSemaRegs rhs;  // `0` if the right-hand side is `imm`.
+  int64_t imm;
+};
+
+}  // namespace
+
+static bool GetComparison(NativeInstPtr ip, Comparison &cmp) {
+  if (ip->has_mem_reference || ip->has_imm_reference ||
+      ip->has_external_ref()) {
+    return false;
+  }
+
+  auto &inst = ip->get_inst();
+  cmp.lhs = 0;
+  cmp.rhs = 0;
+  cmp.imm = 0;
+
+  switch (inst.getOpcode()) {
+#define REG_REG(op, test, w) \
+    case llvm::X86::op: \
+      cmp.is_test = test; \
+      cmp.width = w; \
+      cmp.lhs = OP(0).getReg(); \
+      cmp.rhs = OP(1).getReg(); \
+      return true;
+
+#define REG_IMM(op, test, w) \
+    case llvm::X86::op: \
+      cmp.is_test = test; \
+      cmp.width = w; \
+      cmp.lhs = OP(0).getReg(); \
+      cmp.imm = OP(1).getImm(); \
+      return true;
+
+#define ACC_IMM(op, test, w, acc) \
+    case llvm::X86::op: \
+      cmp.is_test = test; \
+      cmp.width = w; \
+      cmp.lhs = llvm::X86::acc; \
+      cmp.imm = OP(0).getImm(); \
+      return true;
+
+    REG_REG(CMP8rr, false, 8)
+    REG_REG(CMP8rr_REV, false, 8)
+    REG_REG(CMP16rr, false, 16)
+    REG_REG(CMP16rr_REV, false, 16)
+    REG_REG(CMP32rr, false, 32)
+    REG_REG(CMP32rr_REV, false, 32)
+    REG_REG(CMP64rr, false, 64)
+    REG_REG(CMP64rr_REV, false, 64)
+    REG_IMM(CMP8ri, false, 8)
+    REG_IMM(CMP16ri, false, 16)
+    REG_IMM(CMP16ri8, false, 16)
+    REG_IMM(CMP32ri, false, 32)
+    REG_IMM(CMP32ri8, false, 32)
+    REG_IMM(CMP64ri8, false, 64)
+    REG_IMM(CMP64ri32, false, 64)
+    ACC_IMM(CMP8i8, false, 8, AL)
+    ACC_IMM(CMP16i16, false, 16, AX)
+    ACC_IMM(CMP32i32, false, 32, EAX)
+    ACC_IMM(CMP64i32, false, 64, RAX)
+    REG_REG(TEST8rr, true, 8)
+    REG_REG(TEST16rr, true, 16)
+    REG_REG(TEST32rr, true, 32)
+    REG_REG(TEST64rr, true, 64)
+    REG_IMM(TEST8ri, true, 8)
+    REG_IMM(TEST8ri_NOREX, true, 8)
+    REG_IMM(TEST16ri, true, 16)
+    REG_IMM(TEST32ri, true, 32)
+    REG_IMM(TEST64ri32, true, 64)
+    ACC_IMM(TEST8i8, true, 8, AL)
+    ACC_IMM(TEST16i16, true, 16, AX)
+    ACC_IMM(TEST32i32, true, 32, EAX)
+    ACC_IMM(TEST64i32, true, 64, RAX)
+
+#undef REG_REG
+#undef REG_IMM
+#undef ACC_IMM
+
+    default:
+      return false;
+  }
+}
+
+// Returns the condition tested by a conditional jump, `SETcc` of a register,
+// or register-to-register `CMOVcc`. `cmov_width` is set to the operand size
+// of the latter.
+static Condition GetCondition(unsigned opcode, unsigned &cmov_width) {
+  cmov_width = 0;
+  switch (opcode) {
+#define JCC(cc, cond) \
+    case llvm::X86::J ## cc ## _1: \
+    case llvm::X86::J ## cc ## _4: \
+    case llvm::X86::SET ## cc ## r: \
+      return cond; \
+    case llvm::X86::CMOV ## cc ## 16rr: \
+      cmov_width = 16; \
+      return cond; \
+    case llvm::X86::CMOV ## cc ## 32rr: \
+      cmov_width = 32; \
+      return cond; \
+    case llvm::X86::CMOV ## cc ## 64rr: \
+      cmov_width = 64; \
+      return cond;
+
+    JCC(E, kCondE)
+    JCC(NE, kCondNE)
+    JCC(B, kCondB)
+    JCC(AE, kCondAE)
+    JCC(BE, kCondBE)
+    JCC(A, kCondA)
+    JCC(L, kCondL)
+    JCC(GE, kCondGE)
+    JCC(LE, kCondLE)
+    JCC(G, kCondG)
+    JCC(S, kCondS)
+    JCC(NS, kCondNS)
+
+#undef JCC
+
+    default:
+      return kCondInvalid;
+  }
+}
+
+// `TEST` always clears `CF`, so the carry conditions are constant. They're
+// left to the normal lifters, which fold just as well.
+static bool CanFuse(const Comparison &cmp, Condition cond) {
+  if (kCondInvalid == cond) {
+    return false;
+  }
+  return !cmp.is_test || (kCondB != cond && kCondAE != cond);
+}
+
+// Compute the condition `cond` straight from the operands of `cmp`. Neither
+// `CMP` nor `TEST` writes its operands, so they still hold the compared
+// values.
+static llvm::Value *EmitCondition(llvm::BasicBlock *b, const Comparison &cmp,
+                                  Condition cond) {
+  auto lhs = GENERIC_MC_READREG(b, cmp.lhs, cmp.width);
+  llvm::Value *rhs = nullptr;
+  if (cmp.rhs) {
+    rhs = GENERIC_MC_READREG(b, cmp.rhs, cmp.width);
+  } else {
+    rhs = CONST_V(b, cmp.width, static_cast<uint64_t>(cmp.imm));
+  }
+
+  auto zero = CONST_V(b, cmp.width, 0);
+  if (cmp.is_test) {
+    lhs = llvm::BinaryOperator::CreateAnd(lhs, rhs, "", b);
+    rhs = zero;
+  } else if (kCondS == cond || kCondNS == cond) {
+    lhs = llvm::BinaryOperator::CreateSub(lhs, rhs, "", b);
+    rhs = zero;
+  }
+
+  // With `TEST`, `CF` and `OF` are clear, so `SF != OF` is just `SF`, and
+  // `CF | ZF` is just `ZF`.
+  llvm::CmpInst::Predicate pred = llvm::CmpInst::ICMP_EQ;
+  switch (cond) {
+    case kCondE: pred = llvm::CmpInst::ICMP_EQ; break;
+    case kCondNE: pred = llvm::CmpInst::ICMP_NE; break;
+    case kCondB: pred = llvm::CmpInst::ICMP_ULT; break;
+    case kCondAE: pred = llvm::CmpInst::ICMP_UGE; break;
+    case kCondBE:
+      pred = cmp.is_test ? llvm::CmpInst::ICMP_EQ : llvm::CmpInst::ICMP_ULE;
+      break;
+    case kCondA:
+      pred = cmp.is_test ? llvm::CmpInst::ICMP_NE : llvm::CmpInst::ICMP_UGT;
+      break;
+    case kCondL: pred = llvm::CmpInst::ICMP_SLT; break;
+    case kCondGE: pred = llvm::CmpInst::ICMP_SGE; break;
+    case kCondLE: pred = llvm::CmpInst::ICMP_SLE; break;
+    case kCondG: pred = llvm::CmpInst::ICMP_SGT; break;
+    case kCondS: pred = llvm::CmpInst::ICMP_SLT; break;
+    case kCondNS: pred = llvm::CmpInst::ICMP_SGE; break;
+    case kCondInvalid:
+      throw TErr(__LINE__, __FILE__, "Can't fuse an unconditional instruction");
+  }
+  return new llvm::ICmpInst(*b, pred, lhs, rhs);
+}
+
+static llvm::Value *EmitFusedCondition(TranslationContext &ctx,
+                                       llvm::BasicBlock *b,
+                                       unsigned &cmov_width) {
+  Comparison cmp;
+  auto cond = GetCondition(ctx.natI->get_inst().getOpcode(), cmov_width);
+  auto is_cmp = GetComparison(ctx.prevI, cmp);
+  TASSERT(is_cmp && CanFuse(cmp, cond),
+          "Instruction can't be fused with the previous one");
+  return EmitCondition(b, cmp, cond);
+}
+
+static InstTransResult LiftFusedJcc(TranslationContext &ctx,
+                                    llvm::BasicBlock *&block) {
+  unsigned cmov_width = 0;
+  auto ip = ctx.natI;
+  auto cond = EmitFusedCondition(ctx, block, cmov_width);
+  auto if_true = ctx.va_to_bb[ip->get_tr()];
+  auto if_false = ctx.va_to_bb[ip->get_fa()];
+  TASSERT(if_true && if_false, "Conditional branch without targets");
+  llvm::BranchInst::Create(if_true, if_false, cond, block);
+  return EndBlock;
+}
+
+static InstTransResult LiftFusedSETcc(TranslationContext &ctx,
+                                      llvm::BasicBlock *&block) {
+  unsigned cmov_width = 0;
+  auto &inst = ctx.natI->get_inst();
+  auto cond = EmitFusedCondition(ctx, block, cmov_width);
+  auto val = new llvm::ZExtInst(cond, llvm::Type::getInt8Ty(block->getContext()),
+                                "", block);
+  R_WRITE<8>(block, OP(0).getReg(), val);
+  return ContinueBlock;
+}
+
+static InstTransResult LiftFusedCMOV(TranslationContext &ctx,
+                                     llvm::BasicBlock *&block) {
+  unsigned width = 0;
+  auto &inst = ctx.natI->get_inst();
+  auto cond = EmitFusedCondition(ctx, block, width);
+  auto dst = OP(0).getReg();
+  auto orig = GENERIC_MC_READREG(block, dst, width);
+  auto src = GENERIC_MC_READREG(block, OP(2).getReg(), width);
+  GENERIC_MC_WRITEREG(block, dst,
+                      llvm::SelectInst::Create(cond, src, orig, "", block));
+  return ContinueBlock;
+}
+
+// Returns the operand size of `xor r, r`, or `0` if `inst` isn't one.
+static unsigned GetZeroingXorWidth(const llvm::MCInst &inst) {
+  unsigned width = 0;
+  switch (inst.getOpcode()) {
+    case llvm::X86::XOR8rr:
+    case llvm::X86::XOR8rr_REV:
+      width = 8;
+      break;
+    case llvm::X86::XOR16rr:
+    case llvm::X86::XOR16rr_REV:
+      width = 16;
+      break;
+    case llvm::X86::XOR32rr:
+    case llvm::X86::XOR32rr_REV:
+      width = 32;
+      break;
+    case llvm::X86::XOR64rr:
+    case llvm::X86::XOR64rr_REV:
+      width = 64;
+      break;
+    default:
+      return 0;
+  }
+  return OP(1).getReg() == OP(2).getReg() ? width : 0;
+}
+
+// `xor r, r` doesn't depend on the old value of `r`, and always produces the
+// same flags.
+static InstTransResult LiftZeroingXor(TranslationContext &ctx,
+                                      llvm::BasicBlock *&block) {
+  auto &inst = ctx.natI->get_inst();
+  auto width = GetZeroingXorWidth(inst);
+  GENERIC_MC_WRITEREG(block, OP(0).getReg(), CONST_V(block, width, 0));
+  F_CLEAR(block, llvm::X86::CF);
+  F_CLEAR(block, llvm::X86::OF);
+  F_CLEAR(block, llvm::X86::SF);
+  F_SET(block, llvm::X86::ZF);
+  F_SET(block, llvm::X86::PF);
+  F_ZAP(block, llvm::X86::AF);
+  return ContinueBlock;
+}
+
+// Returns the operand size of a `push r1; pop r2` pair, or `0` if `push_ip`
+// and `pop_ip` aren't one. Pairs that involve the stack pointer itself are
+// left alone.
+static unsigned GetPushPopWidth(NativeInstPtr push_ip, NativeInstPtr pop_ip) {
+  auto &push = push_ip->get_inst();
+  auto &pop = pop_ip->get_inst();
+  unsigned width = 0;
+  if (llvm::X86::PUSH64r == push.getOpcode() &&
+      llvm::X86::POP64r == pop.getOpcode()) {
+    width = 64;
+  } else if (llvm::X86::PUSH32r == push.getOpcode() &&
+             llvm::X86::POP32r == pop.getOpcode()) {
+    width = 32;
+  } else {
+    return 0;
+  }
+
+  for (auto reg : {push.getOperand(0).getReg(), pop.getOperand(0).getReg()}) {
+    if (llvm::X86::RSP == reg || llvm::X86::ESP == reg) {
+      return 0;
+    }
+  }
+  return width;
+}
+
+// The `push` has already stored `r1` to the stack, so the `pop` can take its
+// value from `r1` instead of loading it back.
+template <int addr_width>
+static InstTransResult LiftForwardedPop(TranslationContext &ctx,
+                                        llvm::BasicBlock *&block) {
+  auto width = GetPushPopWidth(ctx.prevI, ctx.natI);
+  auto &push = ctx.prevI->get_inst();
+  auto &pop = ctx.natI->get_inst();
+  auto val = GENERIC_MC_READREG(block, push.getOperand(0).getReg(), width);
+  GENERIC_MC_WRITEREG(block, pop.getOperand(0).getReg(), val);
+
+  auto xsp = 32 == addr_width ? llvm::X86::ESP : llvm::X86::RSP;
+  auto sp = R_READ<addr_width>(block, xsp);
+  R_WRITE<addr_width>(
+      block, xsp,
+      llvm::BinaryOperator::CreateAdd(
+          sp, CONST_V<addr_width>(block, width / 8), "", block));
+  return ContinueBlock;
+}
+
+// Like the lifters in the dispatch map, the fused lifters are specialized for
+// the address width of the code.
+template <int addr_width>
+InstructionLifter *X86GetFusedLifter(TranslationContext &ctx) {
+  auto &inst = ctx.natI->get_inst();
+  if (GetZeroingXorWidth(inst)) {
+    return LiftZeroingXor;
+  }
+
+  if (!ctx.prevI) {
+    return nullptr;
+  }
+
+  if (GetPushPopWidth(ctx.prevI, ctx.natI)) {
+    return LiftForwardedPop<addr_width>;
+  }
+
+  Comparison cmp;
+  unsigned cmov_width = 0;
+  auto cond = GetCondition(inst.getOpcode(), cmov_width);
+  if (kCondInvalid == cond || !GetComparison(ctx.prevI, cmp) ||
+      !CanFuse(cmp, cond)) {
+    return nullptr;
+  }
+
+  switch (inst.getOpcode()) {
+#define FUSED(cc) \
+    case llvm::X86::J ## cc ## _1: \
+    case llvm::X86::J ## cc ## _4: \
+      return LiftFusedJcc; \
+    case llvm::X86::SET ## cc ## r: \
+      return LiftFusedSETcc; \
+    case llvm::X86::CMOV ## cc ## 16rr: \
+    case llvm::X86::CMOV ## cc ## 32rr: \
+    case llvm::X86::CMOV ## cc ## 64rr: \
+      return LiftFusedCMOV;
+
+    FUSED(E)
+    FUSED(NE)
+    FUSED(B)
+    FUSED(AE)
+    FUSED(BE)
+    FUSED(A)
+    FUSED(L)
+    FUSED(GE)
+    FUSED(LE)
+    FUSED(G)
+    FUSED(S)
+    FUSED(NS)
+
+#undef FUSED
+
+    default:
+      return nullptr;
+  }
+}
+
+template InstructionLifter *X86GetFusedLifter<32>(TranslationContext &);
+template InstructionLifter *X86GetFusedLifter<64>(TranslationContext &);
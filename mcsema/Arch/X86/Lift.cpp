@@ -28,6 +28,8 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstring>
+
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Intrinsics.h>
@@ -48,8 +50,8 @@
 // currently used to turn non-conforming jump talbles
 // into data sections
 //
-static void PreProcessInst(TranslationContext &ctx, llvm::BasicBlock *&block) {
-  auto ip = ctx.natI;
+static void PreProcessInst(NativeModulePtr natM, llvm::Module *M,
+                           NativeInstPtr ip) {
   auto &inst = ip->get_inst();
   // only add data sections for non-conformant jump tables
   //
@@ -64,7 +66,7 @@ static void PreProcessInst(TranslationContext &ctx, llvm::BasicBlock *&block) {
       VA tbl_va = 0;
       auto jmptbl = ip->get_jump_table();
 
-      bool ok = addJumpTableDataSection(ctx, tbl_va, *jmptbl);
+      bool ok = addJumpTableDataSection(natM, M, tbl_va, *jmptbl);
 
       TASSERT(ok, "Could not add jump table data section!\n");
 
@@ -82,7 +84,7 @@ static void PreProcessInst(TranslationContext &ctx, llvm::BasicBlock *&block) {
     VA idx_va = 0;
     JumpIndexTablePtr idxtbl = ip->get_jump_index_table();
 
-    bool ok = addJumpIndexTableDataSection(ctx, idx_va, *idxtbl);
+    bool ok = addJumpIndexTableDataSection(natM, M, idx_va, *idxtbl);
 
     TASSERT(ok, "Could not add jump index table data section!\n");
 
@@ -94,10 +96,31 @@ static void PreProcessInst(TranslationContext &ctx, llvm::BasicBlock *&block) {
   }
 }
 
+// Pre-process every instruction of a function before it is lifted. This adds
+// the jump table data sections up front, so that lifting itself never changes
+// the module's list of data sections.
+void X86PreProcessFunction(NativeModulePtr natM, NativeFunctionPtr func,
+                           llvm::Module *M) {
+  for (auto &block_info : func->get_blocks()) {
+    for (auto inst : block_info.second->get_insts()) {
+      PreProcessInst(natM, M, inst);
+    }
+  }
+}
+
+void X86SyncRegisterVars(llvm::BasicBlock *block) {
+  FPU_SyncStack(block);
+}
+
 InstTransResult X86LiftInstruction(
     TranslationContext &ctx, llvm::BasicBlock *&block,
     InstructionLifter *lifter) {
 
-  PreProcessInst(ctx, block);
+  // Only the x87 lifters know about the renamed x87 stack, so everything
+  // else sees the ST registers in stack order.
+  auto family = ArchGetInstructionFamily(ctx.natI->get_inst());
+  if (!family || strcmp(family, "FPU")) {
+    FPU_SyncStack(block);
+  }
   return lifter(ctx, block);
 }
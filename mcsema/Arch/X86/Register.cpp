@@ -31,18 +31,52 @@
 #include <inttypes.h>
 #include <iostream>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instruction.h>
+#include <llvm/IR/Instructions.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Type.h>
 
+#include <llvm/Support/CommandLine.h>
+
 #include "mcsema/Arch/Arch.h"
 #include "mcsema/Arch/Register.h"
+#include "mcsema/Arch/X86/Runtime/Trace.h"
 #include "mcsema/BC/Util.h"
 
+enum RegTracerFormat {
+  kRegTracerText,
+  kRegTracerBinary
+};
+
+static llvm::cl::opt<RegTracerFormat> TracerFormat(
+    "reg-tracer-format",
+    llvm::cl::desc("How -add-reg-tracer records the register state:"),
+    llvm::cl::values(
+        clEnumValN(kRegTracerText, "text",
+                   "Print every register state with printf"),
+        clEnumValN(kRegTracerBinary, "binary",
+                   "Pass fixed-size records to __mcsema_trace_record, which "
+                   "tools/regtrace/RingTracer.c implements"),
+        clEnumValEnd),
+    llvm::cl::init(kRegTracerText));
+
+static llvm::cl::opt<bool> RegTracerFlags(
+    "reg-tracer-flags",
+    llvm::cl::desc("Include the flags in binary register trace records."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> RegTracerXMM(
+    "reg-tracer-xmm",
+    llvm::cl::desc("Include the XMM registers in binary register trace "
+                   "records."),
+    llvm::cl::init(false));
+
 namespace {
 
 struct RegInfo {
@@ -58,16 +92,18 @@ struct RegInfo {
 
 static const std::string gBadReg = "MISSING_REG";
 
-static std::unordered_map<MCSemaRegs, RegInfo> gRegInfo;
-static std::vector<RegInfo> gOrderedRegInfo;
-static std::unordered_map<std::string, MCSemaRegs> gRegNum;
+// The register tables are per-thread, because the types in them belong to
+// the `llvm::LLVMContext` that the thread is lifting into.
+static thread_local std::unordered_map<MCSemaRegs, RegInfo> gRegInfo;
+static thread_local std::vector<RegInfo> gOrderedRegInfo;
+static thread_local std::unordered_map<std::string, MCSemaRegs> gRegNum;
 
-static std::vector<llvm::Type *> gRegFields;
+static thread_local std::vector<llvm::Type *> gRegFields;
 
-static llvm::StructType *gRegStateStruct = nullptr;
+static thread_local llvm::StructType *gRegStateStruct = nullptr;
 
-static MCSemaRegs gLastAddedReg = llvm::X86::NoRegister;
-static unsigned gNumRegs = 0;
+static thread_local MCSemaRegs gLastAddedReg = llvm::X86::NoRegister;
+static thread_local unsigned gNumRegs = 0;
 
 static void AddPadding(llvm::Type *type, int num_elements) {
   gNumRegs++;
@@ -297,48 +333,93 @@ MCSemaRegs X86RegisterParent(MCSemaRegs reg) {
   }
 }
 
+// The register variables are only created when they are first used, so
+// this just sets up the table.
 void X86AllocRegisterVars(llvm::BasicBlock *b) {
-  auto func = b->getParent();
-  llvm::Argument *state_ptr = &*func->arg_begin();
-  auto state_ptr_type = llvm::dyn_cast<llvm::PointerType>(state_ptr->getType());
-  auto state_type = state_ptr_type->getElementType();
-  llvm::IRBuilder<> ir(b);
-
-  std::unordered_map<MCSemaRegs, llvm::Value *> regs;
-
-  for (const auto &info : gOrderedRegInfo) {
-    auto write_var_name = info.name + "_write";
-    auto read_var_name = info.name + "_read";
-
-    // Add in the write reg version.
-    llvm::Value *write_reg = nullptr;
-    if (info.reg == info.parent_reg) {
-      write_reg = ir.CreateConstInBoundsGEP2_32(
-          state_type, state_ptr, 0, info.state_offset, write_var_name);
-
-    } else if (!info.parent_offset) {
-      write_reg = llvm::CastInst::Create(
-          llvm::Instruction::BitCast,
-          regs[info.parent_reg],
-          llvm::PointerType::get(info.write_type, 0),
-          write_var_name, b);
-
-    } else {
-      auto parent_reg = ir.CreateBitCast(
-          regs[info.parent_reg], llvm::PointerType::get(info.write_type, 0), "");
-      write_reg = ir.CreateConstInBoundsGEP1_32(
-          info.write_type, parent_reg, info.parent_offset, write_var_name);
-    }
+  auto table = CreateRegisterTable(b->getParent());
+  table->entry = b;
+}
+
+// Add `var` after the register variables that already exist, so that the
+// variables stay at the start of the entry block, where they dominate every
+// use.
+static llvm::Instruction *InsertRegisterVar(RegisterTable *table,
+                                            llvm::Instruction *var) {
+  auto entry = table->entry;
+  if (table->last_var) {
+    var->insertAfter(table->last_var);
+  } else if (entry->empty()) {
+    entry->getInstList().push_back(var);
+  } else {
+    var->insertBefore(&entry->front());
+  }
+  table->last_var = var;
+  return var;
+}
+
+llvm::Value *X86GetRegisterVar(llvm::Function *func, MCSemaRegs reg,
+                               bool is_write) {
+  auto table = GetRegisterTable(func);
+  if (!table || reg >= table->read.size()) {
+    return nullptr;
+  }
+
+  auto &var = is_write ? table->write[reg] : table->read[reg];
+  if (var) {
+    return var;
+  }
+
+  const auto it = gRegInfo.find(reg);
+  if (it == gRegInfo.end()) {
+    return nullptr;
+  }
+  const auto &info = it->second;
+  auto write_var_name = info.name + "_write";
+  auto read_var_name = info.name + "_read";
+  auto write_ptr_type = llvm::PointerType::get(info.write_type, 0);
+
+  // Add in the write reg version. Sub-registers are derived from their
+  // parent's read variable.
+  llvm::Instruction *write_reg = nullptr;
+  if (info.reg == info.parent_reg) {
+    llvm::Argument *state_ptr = &*func->arg_begin();
+    auto state_ptr_type = llvm::dyn_cast<llvm::PointerType>(
+        state_ptr->getType());
+    auto &C = func->getContext();
+    llvm::Value *indices[] = {
+        llvm::ConstantInt::get(llvm::Type::getInt32Ty(C), 0),
+        llvm::ConstantInt::get(llvm::Type::getInt32Ty(C), info.state_offset)};
+    write_reg = llvm::GetElementPtrInst::CreateInBounds(
+        state_ptr_type->getElementType(), state_ptr, indices, write_var_name);
+
+  } else if (!info.parent_offset) {
+    write_reg = llvm::CastInst::Create(
+        llvm::Instruction::BitCast,
+        X86GetRegisterVar(func, info.parent_reg, false),
+        write_ptr_type, write_var_name);
 
-    // Add in the read register version.
-    regs[info.reg] = llvm::CastInst::Create(
+  } else {
+    auto parent_reg = InsertRegisterVar(table, llvm::CastInst::Create(
         llvm::Instruction::BitCast,
-        write_reg,
-        llvm::PointerType::get(info.read_type, 0),
-        read_var_name, b);
+        X86GetRegisterVar(func, info.parent_reg, false),
+        write_ptr_type, ""));
+    write_reg = llvm::GetElementPtrInst::CreateInBounds(
+        info.write_type, parent_reg,
+        llvm::ConstantInt::get(llvm::Type::getInt32Ty(func->getContext()),
+                               info.parent_offset),
+        write_var_name);
   }
-//  b->dump();
-//  exit(0);
+
+  table->write[reg] = InsertRegisterVar(table, write_reg);
+
+  // Add in the read register version.
+  table->read[reg] = InsertRegisterVar(table, llvm::CastInst::Create(
+      llvm::Instruction::BitCast,
+      write_reg,
+      llvm::PointerType::get(info.read_type, 0),
+      read_var_name));
+
+  return var;
 }
 
 unsigned X86RegisterSize(MCSemaRegs reg) {
@@ -377,6 +458,110 @@ static llvm::Function *GetPrintf(llvm::Module *M) {
   return F;
 }
 
+// Declares `void __mcsema_trace_record(const uint64_t *words,
+// uint32_t layout)`.
+static llvm::Function *GetTraceRecord(llvm::Module *M) {
+  auto F = M->getFunction("__mcsema_trace_record");
+  if (F) {
+    return F;
+  }
+
+  auto &C = M->getContext();
+  auto FTy = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(C),
+      {llvm::Type::getInt64PtrTy(C, 0), llvm::Type::getInt32Ty(C)},
+      false);
+
+  F = llvm::Function::Create(
+      FTy, llvm::GlobalValue::ExternalLinkage, "__mcsema_trace_record", M);
+  F->addFnAttr(llvm::Attribute::NoUnwind);
+  return F;
+}
+
+// Fill in a binary trace record (see `Runtime/Trace.h`) with the register
+// state, and pass it to the ring buffer tracer.
+static void AddBinaryTraceRecord(llvm::Module *M, llvm::BasicBlock *B) {
+  static const MCSemaRegs kGprs64[] = {
+      llvm::X86::RIP, llvm::X86::RAX, llvm::X86::RBX, llvm::X86::RCX,
+      llvm::X86::RDX, llvm::X86::RSI, llvm::X86::RDI, llvm::X86::RSP,
+      llvm::X86::RBP, llvm::X86::R8, llvm::X86::R9, llvm::X86::R10,
+      llvm::X86::R11, llvm::X86::R12, llvm::X86::R13, llvm::X86::R14,
+      llvm::X86::R15};
+
+  static const MCSemaRegs kGprs32[] = {
+      llvm::X86::EIP, llvm::X86::EAX, llvm::X86::EBX, llvm::X86::ECX,
+      llvm::X86::EDX, llvm::X86::ESI, llvm::X86::EDI, llvm::X86::ESP,
+      llvm::X86::EBP};
+
+  static const std::pair<MCSemaRegs, unsigned> kFlags[] = {
+      {llvm::X86::CF, MCSEMA_TRACE_CF_BIT},
+      {llvm::X86::PF, MCSEMA_TRACE_PF_BIT},
+      {llvm::X86::AF, MCSEMA_TRACE_AF_BIT},
+      {llvm::X86::ZF, MCSEMA_TRACE_ZF_BIT},
+      {llvm::X86::SF, MCSEMA_TRACE_SF_BIT},
+      {llvm::X86::DF, MCSEMA_TRACE_DF_BIT},
+      {llvm::X86::OF, MCSEMA_TRACE_OF_BIT}};
+
+  static const MCSemaRegs kXMMs[] = {
+      llvm::X86::XMM0, llvm::X86::XMM1, llvm::X86::XMM2, llvm::X86::XMM3,
+      llvm::X86::XMM4, llvm::X86::XMM5, llvm::X86::XMM6, llvm::X86::XMM7,
+      llvm::X86::XMM8, llvm::X86::XMM9, llvm::X86::XMM10, llvm::X86::XMM11,
+      llvm::X86::XMM12, llvm::X86::XMM13, llvm::X86::XMM14, llvm::X86::XMM15};
+
+  auto &C = M->getContext();
+  auto i64_ty = llvm::Type::getInt64Ty(C);
+  llvm::IRBuilder<> ir(B);
+
+  std::vector<llvm::Value *> words;
+  uint32_t layout = 0;
+  size_t num_xmms = 8;
+
+  if (Pointer64 == ArchAddressSize()) {
+    layout |= MCSEMA_TRACE_64BIT;
+    num_xmms = 16;
+    for (auto reg : kGprs64) {
+      words.push_back(R_READ<64>(B, reg));
+    }
+  } else {
+    for (auto reg : kGprs32) {
+      words.push_back(ir.CreateZExt(R_READ<32>(B, reg), i64_ty));
+    }
+  }
+
+  if (RegTracerFlags) {
+    layout |= MCSEMA_TRACE_FLAGS;
+    llvm::Value *flags = llvm::ConstantInt::get(i64_ty, 0);
+    for (const auto &flag : kFlags) {
+      auto bit = ir.CreateZExt(F_READ(B, flag.first), i64_ty);
+      flags = ir.CreateOr(flags, ir.CreateShl(bit, flag.second));
+    }
+    words.push_back(flags);
+  }
+
+  if (RegTracerXMM) {
+    layout |= MCSEMA_TRACE_XMM;
+    for (size_t i = 0; i < num_xmms; ++i) {
+      auto xmm = R_READ<128>(B, kXMMs[i]);
+      words.push_back(ir.CreateTrunc(xmm, i64_ty));
+      words.push_back(ir.CreateTrunc(ir.CreateLShr(xmm, 64), i64_ty));
+    }
+  }
+
+  layout |= static_cast<uint32_t>(words.size()) << MCSEMA_TRACE_NUM_WORDS_SHIFT;
+
+  auto record_ty = llvm::ArrayType::get(i64_ty, words.size());
+  auto record = ir.CreateAlloca(record_ty);
+  for (size_t i = 0; i < words.size(); ++i) {
+    ir.CreateStore(words[i], ir.CreateConstInBoundsGEP2_32(
+        record_ty, record, 0, static_cast<unsigned>(i)));
+  }
+
+  ir.CreateCall(
+      GetTraceRecord(M),
+      {ir.CreateConstInBoundsGEP2_32(record_ty, record, 0, 0),
+       llvm::ConstantInt::get(llvm::Type::getInt32Ty(C), layout)});
+}
+
 llvm::Function *X86GetOrCreateRegStateTracer(llvm::Module *M) {
   auto F = M->getFunction("__mcsema_trace_regs");
   if (F) {
@@ -392,6 +577,13 @@ llvm::Function *X86GetOrCreateRegStateTracer(llvm::Module *M) {
   auto B = llvm::BasicBlock::Create(C, "", F);
   X86AllocRegisterVars(B);
 
+  if (kRegTracerBinary == TracerFormat) {
+    AddBinaryTraceRecord(M, B);
+    llvm::ReturnInst::Create(C, B);
+    FreeRegisterTable(F);
+    return F;
+  }
+
   const char *format = nullptr;
   if (Pointer64 == ArchAddressSize()) {
     format = "RIP=%" PRIx64 " RAX=%" PRIx64 " RBX=%" PRIx64
@@ -459,5 +651,6 @@ llvm::Function *X86GetOrCreateRegStateTracer(llvm::Module *M) {
   llvm::IRBuilder<> ir(B);
   ir.CreateCall(GetPrintf(M), args);
   ir.CreateRetVoid();
+  FreeRegisterTable(F);
   return F;
 }
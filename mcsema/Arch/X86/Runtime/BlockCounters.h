@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Per-block execution counters, added by `-add-block-counters`.
+//
+// Every lifted block that comes from a native block has one `BlockCounter`,
+// which the block atomically increments when it starts. All of the counters
+// are put into the `MCSEMA_BLOCK_COUNTERS_SECTION` section, so that the
+// runtime can find them through the `__start_` and `__stop_` symbols of the
+// section.
+
+#define MCSEMA_BLOCK_COUNTERS_SECTION "mcsema_block_counters"
+
+struct BlockCounter {
+  uint64_t va;
+  uint64_t count;
+};
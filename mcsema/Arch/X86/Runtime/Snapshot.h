@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+
+// Cheap snapshots of the lifted state of one thread, for running lifted code
+// many times in one process, e.g. in a persistent-mode fuzzer.
+//
+// A snapshot holds the thread's `RegState` and the used part of its lifted
+// stack, which is everything between the lifted `RSP` and the top of the
+// stack. Restoring it is two `memcpy`s. Snapshots must be taken and restored
+// while the thread is running native code, i.e. outside of lifted code, and
+// only on the thread that took them.
+//
+// The runtime is in `tools/snapshot/Snapshot.cc`, and needs the stack helpers
+// of the 64-bit Linux assembly stubs.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct McsemaSnapshot;
+
+// Save the lifted state of the current thread. Returns `NULL` if the thread
+// has not entered lifted code yet.
+struct McsemaSnapshot *__mcsema_snapshot_create(void);
+
+// Put the lifted state of the current thread back to what it was when
+// `snapshot` was taken.
+void __mcsema_snapshot_restore(const struct McsemaSnapshot *snapshot);
+
+// Returns the number of stack bytes saved in `snapshot`.
+size_t __mcsema_snapshot_stack_size(const struct McsemaSnapshot *snapshot);
+
+void __mcsema_snapshot_free(struct McsemaSnapshot *snapshot);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
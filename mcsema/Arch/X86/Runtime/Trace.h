@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary register trace format, written by the ring buffer tracer that
+// backs `-add-reg-tracer -reg-tracer-format=binary`.
+//
+// A trace file starts with a `TraceHeader`, followed by fixed-size records.
+// Every record is an array of little-endian 64-bit words: the program
+// counter and the general purpose registers, in the order of the text
+// tracer's output, then optionally the packed flags, then optionally the
+// low and high halves of each XMM register.
+//
+// In a trace whose layout has `MCSEMA_TRACE_DELTA` set, records only hold
+// the words that changed since the previous record. Such a record starts
+// with a word whose bit `i` is set if word `i` of the full record changed,
+// followed by the changed words in order. The first record of a thread has
+// every bit set.
+
+#define MCSEMA_TRACE_MAGIC "MCSTRACE"
+#define MCSEMA_TRACE_VERSION 1
+
+// Bits of `TraceHeader::layout` and of the layout passed to
+// `__mcsema_trace_record`.
+#define MCSEMA_TRACE_64BIT 0x1U
+#define MCSEMA_TRACE_FLAGS 0x2U
+#define MCSEMA_TRACE_XMM 0x4U
+#define MCSEMA_TRACE_DELTA 0x8U
+
+// Delta encoding uses a 64-bit mask, so full records can't be longer.
+#define MCSEMA_TRACE_MAX_WORDS 64U
+
+// The number of words in a record is stored above the layout bits.
+#define MCSEMA_TRACE_NUM_WORDS_SHIFT 8U
+#define MCSEMA_TRACE_NUM_WORDS(layout) \
+    ((layout) >> MCSEMA_TRACE_NUM_WORDS_SHIFT)
+
+// Positions of the flags in the packed flags word. These match EFLAGS.
+#define MCSEMA_TRACE_CF_BIT 0
+#define MCSEMA_TRACE_PF_BIT 2
+#define MCSEMA_TRACE_AF_BIT 4
+#define MCSEMA_TRACE_ZF_BIT 6
+#define MCSEMA_TRACE_SF_BIT 7
+#define MCSEMA_TRACE_DF_BIT 10
+#define MCSEMA_TRACE_OF_BIT 11
+
+struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t layout;
+  uint64_t thread_id;
+};
@@ -1,6 +1,7 @@
 /* Copyright 2016 Peter Goodman (peter@trailofbits.com), all rights reserved. */
 
 #include <cstdio>
+#include <cstring>
 
 #ifdef _WIN32
 #include <stddef.h>
@@ -11,8 +12,152 @@
 #include "State.h"
 
 static const unsigned long kStackSize = 1UL << 20UL;
+static const unsigned long kPageSize = 4096UL;
+
+// Print the functions that give each thread its own `mmap`ed lifted stack,
+// which is allocated the first time that the thread enters lifted code.
+// Stacks of exited threads are kept in a pool and reused.
+//
+// The usable part of a stack starts one page above the base of the mapping,
+// and the page below it is a guard page. While a stack is in the pool, its
+// lowest usable word links to the next pooled stack.
+static void PrintLazyStack(void) {
+
+  // Size of each stack. This is a weak definition, so the size can be changed
+  // by defining `__mcsema_stack_size` in the program.
+  printf("  .data\n");
+  printf("  .weak __mcsema_stack_size\n");
+  printf("  .type __mcsema_stack_size,@object\n");
+  printf("  .p2align 3\n");
+  printf("__mcsema_stack_size:\n");
+  printf("  .quad %lu\n", kStackSize);
+  printf("  .size __mcsema_stack_size, 8\n");
+  printf("\n");
+
+  printf("  .local __mcsema_stack_pool\n");
+  printf("  .comm __mcsema_stack_pool,8,8\n");
+  printf("  .local __mcsema_stack_pool_lock\n");
+  printf("  .comm __mcsema_stack_pool_lock,4,4\n");
+  printf("  .local __mcsema_stack_key\n");
+  printf("  .comm __mcsema_stack_key,4,4\n");
+  printf("  .local __mcsema_stack_key_created\n");
+  printf("  .comm __mcsema_stack_key_created,4,4\n");
+  printf("\n");
+
+  printf("  .text\n");
+  printf("\n");
+
+  // Implements `__mcsema_free_stack`. This is the thread-specific data
+  // destructor of `__mcsema_stack_key`, and returns the stack whose usable
+  // part starts at `rdi` to the pool.
+  printf("  .type __mcsema_free_stack,@function\n");
+  printf("__mcsema_free_stack:\n");
+  printf("  .cfi_startproc\n");
+  printf(".Lfree_stack_lock:\n");
+  printf("  mov eax, 1\n");
+  printf("  xchg eax, DWORD PTR [rip + __mcsema_stack_pool_lock]\n");
+  printf("  test eax, eax\n");
+  printf("  jz .Lfree_stack_locked\n");
+  printf("  pause\n");
+  printf("  jmp .Lfree_stack_lock\n");
+  printf(".Lfree_stack_locked:\n");
+  printf("  mov rax, [rip + __mcsema_stack_pool]\n");
+  printf("  mov [rdi], rax\n");
+  printf("  mov [rip + __mcsema_stack_pool], rdi\n");
+  printf("  mov DWORD PTR [rip + __mcsema_stack_pool_lock], 0\n");
+  printf("  ret\n");
+  printf(".Lfunc_end_free_stack:\n");
+  printf("  .size __mcsema_free_stack,.Lfunc_end_free_stack-__mcsema_free_stack\n");
+  printf("  .cfi_endproc\n");
+  printf("\n");
+
+  // Implements `__mcsema_alloc_stack`. This takes a stack from the pool, or
+  // maps a new one, and returns the address of its top in `rax`. This is
+  // called on the native stack, and follows the SysV calling convention.
+  printf("  .type __mcsema_alloc_stack,@function\n");
+  printf("__mcsema_alloc_stack:\n");
+  printf("  .cfi_startproc\n");
+  printf("  push rbx\n");
+  printf("  .cfi_def_cfa_offset 16\n");
+  printf(".Lalloc_stack_lock:\n");
+  printf("  mov eax, 1\n");
+  printf("  xchg eax, DWORD PTR [rip + __mcsema_stack_pool_lock]\n");
+  printf("  test eax, eax\n");
+  printf("  jz .Lalloc_stack_locked\n");
+  printf("  pause\n");
+  printf("  jmp .Lalloc_stack_lock\n");
+  printf(".Lalloc_stack_locked:\n");
+
+  // The first thread to enter lifted code creates the key that returns
+  // stacks to the pool when threads exit.
+  printf("  cmp DWORD PTR [rip + __mcsema_stack_key_created], 0\n");
+  printf("  jnz .Lalloc_stack_have_key\n");
+  printf("  lea rdi, [rip + __mcsema_stack_key]\n");
+  printf("  lea rsi, [rip + __mcsema_free_stack]\n");
+  printf("  call pthread_key_create@PLT\n");
+  printf("  mov DWORD PTR [rip + __mcsema_stack_key_created], 1\n");
+  printf(".Lalloc_stack_have_key:\n");
+
+  // Try to reuse a pooled stack.
+  printf("  mov rbx, [rip + __mcsema_stack_pool]\n");
+  printf("  test rbx, rbx\n");
+  printf("  jz .Lalloc_stack_unlock\n");
+  printf("  mov rax, [rbx]\n");
+  printf("  mov [rip + __mcsema_stack_pool], rax\n");
+  printf(".Lalloc_stack_unlock:\n");
+  printf("  mov DWORD PTR [rip + __mcsema_stack_pool_lock], 0\n");
+  printf("  test rbx, rbx\n");
+  printf("  jnz .Lalloc_stack_done\n");
+
+  // `mmap(NULL, size + guard, PROT_READ | PROT_WRITE,
+  //       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)`.
+  printf("  mov rsi, [rip + __mcsema_stack_size@GOTPCREL]\n");
+  printf("  mov rsi, [rsi]\n");
+  printf("  add rsi, %lu\n", 2 * kPageSize - 1);
+  printf("  and rsi, -%lu\n", kPageSize);
+  printf("  xor edi, edi\n");
+  printf("  mov edx, 3\n");
+  printf("  mov r10d, 0x4022\n");
+  printf("  mov r8, -1\n");
+  printf("  xor r9d, r9d\n");
+  printf("  mov eax, 9\n");
+  printf("  syscall\n");
+  printf("  cmp rax, -%lu\n", kPageSize);
+  printf("  ja .Lalloc_stack_failed\n");
+  printf("  lea rbx, [rax + %lu]\n", kPageSize);
+
+  // `mprotect(base, guard, PROT_NONE)`.
+  printf("  mov rdi, rax\n");
+  printf("  mov esi, %lu\n", kPageSize);
+  printf("  xor edx, edx\n");
+  printf("  mov eax, 10\n");
+  printf("  syscall\n");
+
+  // Remember the stack, so that it is pooled when this thread exits.
+  printf(".Lalloc_stack_done:\n");
+  printf("  mov edi, DWORD PTR [rip + __mcsema_stack_key]\n");
+  printf("  mov rsi, rbx\n");
+  printf("  call pthread_setspecific@PLT\n");
+  printf("  mov rax, [rip + __mcsema_stack_size@GOTPCREL]\n");
+  printf("  mov rax, [rax]\n");
+  printf("  add rax, %lu\n", kPageSize - 1);
+  printf("  and rax, -%lu\n", kPageSize);
+  printf("  add rax, rbx\n");
+  printf("  pop rbx\n");
+  printf("  .cfi_def_cfa_offset 8\n");
+  printf("  ret\n");
+  printf(".Lalloc_stack_failed:\n");
+  printf("  call abort@PLT\n");
+  printf(".Lfunc_end_alloc_stack:\n");
+  printf("  .size __mcsema_alloc_stack,.Lfunc_end_alloc_stack-__mcsema_alloc_stack\n");
+  printf("  .cfi_endproc\n");
+  printf("\n");
+}
 
-int main(void) {
+// Pass `--lazy-stack` to give each thread an `mmap`ed lifted stack that is
+// allocated on demand, instead of a fixed-size thread-local stack.
+int main(int argc, char *argv[]) {
+  bool lazy_stack = 1 < argc && !strcmp(argv[1], "--lazy-stack");
 
   printf("/* Auto-generated file! Don't modify! */\n\n");
   printf("  .file __FILE__\n");
@@ -27,14 +172,18 @@ int main(void) {
   printf("  .size __mcsema_reg_state, 100\n");
   printf("\n");
 
-  // Thread-local stack structure, named by `__mcsema_stack`.
-  printf("  .type __mcsema_stack,@object\n");
-  printf("  .section .tbss,\"awT\",@nobits\n");
-  printf("__mcsema_stack:\n");
-  printf("  .zero %lu\n", kStackSize);  // 1 MiB.
-  printf("  .size __mcsema_stack, 100\n");
-  printf("\n");
+  if (lazy_stack) {
+    PrintLazyStack();
 
+  } else {
+    // Thread-local stack structure, named by `__mcsema_stack`.
+    printf("  .type __mcsema_stack,@object\n");
+    printf("  .section .tbss,\"awT\",@nobits\n");
+    printf("__mcsema_stack:\n");
+    printf("  .zero %lu\n", kStackSize);  // 1 MiB.
+    printf("  .size __mcsema_stack, 100\n");
+    printf("\n");
+  }
 
   printf("  .text\n");
   printf("\n");
@@ -94,8 +243,17 @@ int main(void) {
   // If `RSP` is null then we need to initialize it to our new stack.
   printf("  cmp rsp, 0\n");
   printf("  jnz .Lhave_stack\n");
-  printf("  mov rsp, fs:[0]\n");
-  printf("  lea rsp, [rsp + __mcsema_stack@TPOFF + %lu]\n", kStackSize);
+  if (lazy_stack) {
+    // Every native register is saved by now, so allocate the stack on the
+    // native stack.
+    printf("  mov rsp, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, RSP));
+    printf("  and rsp, -16\n");
+    printf("  call __mcsema_alloc_stack\n");
+    printf("  mov rsp, rax\n");
+  } else {
+    printf("  mov rsp, fs:[0]\n");
+    printf("  lea rsp, [rsp + __mcsema_stack@TPOFF + %lu]\n", kStackSize);
+  }
   printf(".Lhave_stack:\n");
 
   // `rsp` holds the address of the mcsema stack.
@@ -334,6 +492,77 @@ int main(void) {
   printf("  .cfi_endproc\n");
   printf("\n");
 
+  // Implements `__mcsema_detach_call_lean`. This is like `__mcsema_detach_call`,
+  // but is only used to call externals whose signatures are known, and that
+  // return nothing or an integer. The native callee preserves the callee-saved
+  // registers, so they still match `RegState` when it returns, and the lifted
+  // code takes the return value from `rax` itself. That means that nothing
+  // needs to be copied back into `RegState` by `__mcsema_attach_ret_lean`.
+  printf("  .globl __mcsema_detach_call_lean\n");
+  printf("  .type __mcsema_detach_call_lean,@function\n");
+  printf("__mcsema_detach_call_lean:\n");
+  printf("  .cfi_startproc\n");
+
+  printf("  pop QWORD PTR fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, RIP));
+
+  // Stash the callee-saved registers.
+  printf("  push rbx\n");
+  printf("  push rbp\n");
+  printf("  push r12\n");
+  printf("  push r13\n");
+  printf("  push r14\n");
+  printf("  push r15\n");
+
+  // Marshal the callee-saved registers (of the emulated code) into the native
+  // state, in case the callee calls back into lifted code. We don't touch the
+  // argument registers.
+  printf("  mov rbx, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, RBX));
+  printf("  mov rbp, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, RBP));
+  printf("  mov r12, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, R12));
+  printf("  mov r13, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, R13));
+  printf("  mov r14, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, R14));
+  printf("  mov r15, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, R15));
+
+  // Swap onto the native stack.
+  printf("  xchg fs:[__mcsema_reg_state@TPOFF + %lu], rsp\n", __builtin_offsetof(RegState, RSP));
+
+  // Set up a re-attach return address. `r11` is neither an argument nor a
+  // callee-saved register.
+  printf("  lea r11, [rip + __mcsema_attach_ret_lean]\n");
+  printf("  mov [rsp], r11\n");
+
+  printf("  jmp fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, RIP));
+
+  printf(".Lfunc_end_detach_call_lean:\n");
+  printf("  .size __mcsema_detach_call_lean,.Lfunc_end_detach_call_lean-__mcsema_detach_call_lean\n");
+  printf("  .cfi_endproc\n");
+  printf("\n");
+
+  // Implements `__mcsema_attach_ret_lean`. This is the "opposite" of
+  // `__mcsema_detach_call_lean`.
+  printf("  .globl __mcsema_attach_ret_lean\n");
+  printf("  .type __mcsema_attach_ret_lean,@function\n");
+  printf("__mcsema_attach_ret_lean:\n");
+  printf("  .cfi_startproc\n");
+
+  // Swap into the mcsema stack.
+  printf("  xchg rsp, fs:[__mcsema_reg_state@TPOFF + %lu]\n", __builtin_offsetof(RegState, RSP));
+
+  // Unstash the callee-saved registers.
+  printf("  pop r15\n");
+  printf("  pop r14\n");
+  printf("  pop r13\n");
+  printf("  pop r12\n");
+  printf("  pop rbp\n");
+  printf("  pop rbx\n");
+
+  printf("  ret\n");
+
+  printf(".Lfunc_end_attach_ret_lean:\n");
+  printf("  .size __mcsema_attach_ret_lean,.Lfunc_end_attach_ret_lean-__mcsema_attach_ret_lean\n");
+  printf("  .cfi_endproc\n");
+  printf("\n");
+
   // Implements `__mcsema_detach_call_value`. This is a thin wrapper around
   // `__mcsema_detach_call`.
   printf("  .globl __mcsema_detach_call_value\n");
@@ -419,6 +648,42 @@ int main(void) {
   printf("  .size __mcsema_debug_get_reg_state,.Lfunc_end6-__mcsema_debug_get_reg_state\n");
   printf("  .cfi_endproc\n");
   printf("\n");
+
+  // Implements `__mcsema_get_stack_top`. This returns the address just past
+  // the end of this thread's lifted stack, or zero if the thread doesn't have
+  // one yet. It is used by the snapshot runtime to find the used part of the
+  // stack, which is between `RegState::RSP` and the top.
+  printf("  .globl __mcsema_get_stack_top\n");
+  printf("  .type __mcsema_get_stack_top,@function\n");
+  printf("__mcsema_get_stack_top:\n");
+  printf("  .cfi_startproc\n");
+  if (lazy_stack) {
+    printf("  xor eax, eax\n");
+    printf("  cmp DWORD PTR [rip + __mcsema_stack_key_created], 0\n");
+    printf("  jz .Lget_stack_top_done\n");
+    printf("  sub rsp, 8\n");
+    printf("  .cfi_def_cfa_offset 16\n");
+    printf("  mov edi, DWORD PTR [rip + __mcsema_stack_key]\n");
+    printf("  call pthread_getspecific@PLT\n");
+    printf("  add rsp, 8\n");
+    printf("  .cfi_def_cfa_offset 8\n");
+    printf("  test rax, rax\n");
+    printf("  jz .Lget_stack_top_done\n");
+    printf("  mov rdx, [rip + __mcsema_stack_size@GOTPCREL]\n");
+    printf("  mov rdx, [rdx]\n");
+    printf("  add rdx, %lu\n", kPageSize - 1);
+    printf("  and rdx, -%lu\n", kPageSize);
+    printf("  add rax, rdx\n");
+    printf(".Lget_stack_top_done:\n");
+  } else {
+    printf("  mov rax, fs:[0]\n");
+    printf("  lea rax, [rax + __mcsema_stack@TPOFF + %lu]\n", kStackSize);
+  }
+  printf("  ret\n");
+  printf(".Lfunc_end7:\n");
+  printf("  .size __mcsema_get_stack_top,.Lfunc_end7-__mcsema_get_stack_top\n");
+  printf("  .cfi_endproc\n");
+  printf("\n");
   return 0;
 }
 
@@ -502,14 +502,14 @@ GENERIC_TRANSLATION_REF(
 GENERIC_TRANSLATION_REF(
     ADD64i32,
     doAddRI<64>(ip, block, MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX), OP(0)),
-    doAddRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip),
+    doAddRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip),
                 MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX)))
 
 GENERIC_TRANSLATION_MI(
     ADD32mi, doAddMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doAddMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doAddMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doAddMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doAddMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doAddMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(ADD32mi8, doAddMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doAddMI<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -520,8 +520,8 @@ GENERIC_TRANSLATION_REF(ADD64mi8, doAddMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
 GENERIC_TRANSLATION_MI(
     ADD64mi32, doAddMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
     doAddMI<64>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doAddMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doAddMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doAddMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doAddMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(ADD32mr, doAddMR<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doAddMR<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -531,10 +531,10 @@ GENERIC_TRANSLATION_REF(ADD64mr, doAddMR<64>(ip, block, ADDR_NOREF(0), OP(5)),
 
 GENERIC_TRANSLATION_REF(
     ADD32ri, doAddRI<32>(ip, block, OP(0), OP(1), OP(2)),
-    doAddRV<32>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doAddRV<32>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 GENERIC_TRANSLATION_REF(
     ADD32ri_DB, doAddRI<32>(ip, block, OP(0), OP(1), OP(2)),
-    doAddRV<32>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doAddRV<32>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 
 GENERIC_TRANSLATION(ADD32ri8, doAddRI<32>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION(ADD32ri8_DB, doAddRI<32>(ip, block, OP(0), OP(1), OP(2)))
@@ -543,7 +543,7 @@ GENERIC_TRANSLATION(ADD64ri8, doAddRI<64>(ip, block, OP(0), OP(1), OP(2)))
 
 GENERIC_TRANSLATION_REF(
     ADD64ri32, doAddRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doAddRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doAddRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 
 GENERIC_TRANSLATION_REF(ADD32rm,
                         doAddRM<32>(ip, block, ADDR_NOREF(2), OP(0), OP(1)),
@@ -605,8 +605,8 @@ GENERIC_TRANSLATION_REF(
 GENERIC_TRANSLATION_MI(
     ADC32mi, doAdcMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doAdcMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doAdcMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doAdcMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doAdcMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doAdcMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(ADC32mi8, doAdcMI8<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doAdcMI8<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -616,7 +616,7 @@ GENERIC_TRANSLATION_REF(ADC32mr, doAdcMR<32>(ip, block, ADDR_NOREF(0), OP(5)),
 
 GENERIC_TRANSLATION_REF(
     ADC64ri32, doAdcRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doAdcRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doAdcRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 
 GENERIC_TRANSLATION(ADC32ri, doAdcRI<32>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION(ADC32ri8, doAdcRI8<32>(ip, block, OP(0), OP(1), OP(2)))
@@ -646,82 +646,86 @@ GENERIC_TRANSLATION_REF(ADC8rm,
 GENERIC_TRANSLATION(ADC8rr, doAdcRR<8>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION(ADC8rr_REV, doAdcRR<8>(ip, block, OP(0), OP(1), OP(2)))
 
+template <int addr_width>
 void ADD_populateDispatchMap(DispatchMap &m) {
-  m[X86::ADD16i16] = translate_ADD16i16;
-  m[X86::ADD16mi] = translate_ADD16mi;
-  m[X86::ADD16mi8] = translate_ADD16mi8;
-  m[X86::ADD16mr] = translate_ADD16mr;
-  m[X86::ADD16ri] = translate_ADD16ri;
-  m[X86::ADD16ri8] = translate_ADD16ri8;
-  m[X86::ADD16ri8_DB] = translate_ADD16ri8_DB;
-  m[X86::ADD16ri_DB] = translate_ADD16ri_DB;
-  m[X86::ADD16rm] = translate_ADD16rm;
-  m[X86::ADD16rr] = translate_ADD16rr;
-  m[X86::ADD16rr_DB] = translate_ADD16rr_DB;
-  m[X86::ADD16rr_REV] = translate_ADD16rr_REV;
-  m[X86::ADD32i32] = translate_ADD32i32;
-  m[X86::ADD32ri] = translate_ADD32ri;
-  m[X86::ADD32ri8] = translate_ADD32ri8;
-  m[X86::ADD32ri8_DB] = translate_ADD32ri8_DB;
-  m[X86::ADD32ri_DB] = translate_ADD32ri_DB;
-  m[X86::ADD32mi] = translate_ADD32mi;
-  m[X86::ADD32mi8] = translate_ADD32mi8;
-  m[X86::ADD32mr] = translate_ADD32mr;
-  m[X86::ADD32rm] = translate_ADD32rm;
-  m[X86::ADD32rr] = translate_ADD32rr;
-  m[X86::ADD32rr_DB] = translate_ADD32rr_DB;
-  m[X86::ADD32rr_REV] = translate_ADD32rr_REV;
-  m[X86::ADD8i8] = translate_ADD8i8;
-  m[X86::ADD8mi] = translate_ADD8mi;
-  m[X86::ADD8mr] = translate_ADD8mr;
-  m[X86::ADD8ri] = translate_ADD8ri;
-  m[X86::ADD8rm] = translate_ADD8rm;
-  m[X86::ADD8rr] = translate_ADD8rr;
-  m[X86::ADD8rr_REV] = translate_ADD8rr_REV;
-
-  m[X86::ADD64ri8] = translate_ADD64ri8;
-  m[X86::ADD64ri8_DB] = translate_ADD64ri8;
-  m[X86::ADD64ri32] = translate_ADD64ri32;
-  m[X86::ADD64ri32_DB] = translate_ADD64ri32;
-  m[X86::ADD64i32] = translate_ADD64i32;
-  m[X86::ADD64mi8] = translate_ADD64mi8;
+  m[X86::ADD16i16] = translate_ADD16i16<addr_width>;
+  m[X86::ADD16mi] = translate_ADD16mi<addr_width>;
+  m[X86::ADD16mi8] = translate_ADD16mi8<addr_width>;
+  m[X86::ADD16mr] = translate_ADD16mr<addr_width>;
+  m[X86::ADD16ri] = translate_ADD16ri<addr_width>;
+  m[X86::ADD16ri8] = translate_ADD16ri8<addr_width>;
+  m[X86::ADD16ri8_DB] = translate_ADD16ri8_DB<addr_width>;
+  m[X86::ADD16ri_DB] = translate_ADD16ri_DB<addr_width>;
+  m[X86::ADD16rm] = translate_ADD16rm<addr_width>;
+  m[X86::ADD16rr] = translate_ADD16rr<addr_width>;
+  m[X86::ADD16rr_DB] = translate_ADD16rr_DB<addr_width>;
+  m[X86::ADD16rr_REV] = translate_ADD16rr_REV<addr_width>;
+  m[X86::ADD32i32] = translate_ADD32i32<addr_width>;
+  m[X86::ADD32ri] = translate_ADD32ri<addr_width>;
+  m[X86::ADD32ri8] = translate_ADD32ri8<addr_width>;
+  m[X86::ADD32ri8_DB] = translate_ADD32ri8_DB<addr_width>;
+  m[X86::ADD32ri_DB] = translate_ADD32ri_DB<addr_width>;
+  m[X86::ADD32mi] = translate_ADD32mi<addr_width>;
+  m[X86::ADD32mi8] = translate_ADD32mi8<addr_width>;
+  m[X86::ADD32mr] = translate_ADD32mr<addr_width>;
+  m[X86::ADD32rm] = translate_ADD32rm<addr_width>;
+  m[X86::ADD32rr] = translate_ADD32rr<addr_width>;
+  m[X86::ADD32rr_DB] = translate_ADD32rr_DB<addr_width>;
+  m[X86::ADD32rr_REV] = translate_ADD32rr_REV<addr_width>;
+  m[X86::ADD8i8] = translate_ADD8i8<addr_width>;
+  m[X86::ADD8mi] = translate_ADD8mi<addr_width>;
+  m[X86::ADD8mr] = translate_ADD8mr<addr_width>;
+  m[X86::ADD8ri] = translate_ADD8ri<addr_width>;
+  m[X86::ADD8rm] = translate_ADD8rm<addr_width>;
+  m[X86::ADD8rr] = translate_ADD8rr<addr_width>;
+  m[X86::ADD8rr_REV] = translate_ADD8rr_REV<addr_width>;
+
+  m[X86::ADD64ri8] = translate_ADD64ri8<addr_width>;
+  m[X86::ADD64ri8_DB] = translate_ADD64ri8<addr_width>;
+  m[X86::ADD64ri32] = translate_ADD64ri32<addr_width>;
+  m[X86::ADD64ri32_DB] = translate_ADD64ri32<addr_width>;
+  m[X86::ADD64i32] = translate_ADD64i32<addr_width>;
+  m[X86::ADD64mi8] = translate_ADD64mi8<addr_width>;
   ;
-  m[X86::ADD64mi32] = translate_ADD64mi32;
-
-  m[X86::ADD64rr_DB] = translate_ADD64rr;
-  m[X86::ADD64rr] = translate_ADD64rr;
-  m[X86::ADD64rr_REV] = translate_ADD64rr;
-  m[X86::ADD64rm] = translate_ADD64rm;
-  m[X86::ADD64mr] = translate_ADD64mr;
-
-  m[X86::ADC16i16] = translate_ADC16i16;
-  m[X86::ADC16mi] = translate_ADC16mi;
-  m[X86::ADC16mi8] = translate_ADC16mi8;
-  m[X86::ADC16mr] = translate_ADC16mr;
-  m[X86::ADC16ri] = translate_ADC16ri;
-  m[X86::ADC16ri8] = translate_ADC16ri8;
-  m[X86::ADC16rm] = translate_ADC16rm;
-  m[X86::ADC16rr] = translate_ADC16rr;
-  m[X86::ADC16rr_REV] = translate_ADC16rr_REV;
-  m[X86::ADC32i32] = translate_ADC32i32;
-  m[X86::ADC32mi] = translate_ADC32mi;
-  m[X86::ADC32mi8] = translate_ADC32mi8;
-  m[X86::ADC32mr] = translate_ADC32mr;
-  m[X86::ADC32ri] = translate_ADC32ri;
-  m[X86::ADC32ri8] = translate_ADC32ri8;
-  m[X86::ADC64ri8] = translate_ADC64ri8;
-  m[X86::ADC32rm] = translate_ADC32rm;
-  m[X86::ADC32rr] = translate_ADC32rr;
-  m[X86::ADC32rr_REV] = translate_ADC32rr_REV;
-  m[X86::ADC8i8] = translate_ADC8i8;
-  m[X86::ADC8mi] = translate_ADC8mi;
-  m[X86::ADC8mr] = translate_ADC8mr;
-  m[X86::ADC8ri] = translate_ADC8ri;
-  m[X86::ADC8rm] = translate_ADC8rm;
-  m[X86::ADC8rr] = translate_ADC8rr;
-  m[X86::ADC8rr_REV] = translate_ADC8rr_REV;
-
-  m[X86::ADC64i32] = translate_ADC64i32;
-  m[X86::ADC64ri32] = translate_ADC64ri32;
-  m[X86::ADC64rr] = translate_ADC64rr;
+  m[X86::ADD64mi32] = translate_ADD64mi32<addr_width>;
+
+  m[X86::ADD64rr_DB] = translate_ADD64rr<addr_width>;
+  m[X86::ADD64rr] = translate_ADD64rr<addr_width>;
+  m[X86::ADD64rr_REV] = translate_ADD64rr<addr_width>;
+  m[X86::ADD64rm] = translate_ADD64rm<addr_width>;
+  m[X86::ADD64mr] = translate_ADD64mr<addr_width>;
+
+  m[X86::ADC16i16] = translate_ADC16i16<addr_width>;
+  m[X86::ADC16mi] = translate_ADC16mi<addr_width>;
+  m[X86::ADC16mi8] = translate_ADC16mi8<addr_width>;
+  m[X86::ADC16mr] = translate_ADC16mr<addr_width>;
+  m[X86::ADC16ri] = translate_ADC16ri<addr_width>;
+  m[X86::ADC16ri8] = translate_ADC16ri8<addr_width>;
+  m[X86::ADC16rm] = translate_ADC16rm<addr_width>;
+  m[X86::ADC16rr] = translate_ADC16rr<addr_width>;
+  m[X86::ADC16rr_REV] = translate_ADC16rr_REV<addr_width>;
+  m[X86::ADC32i32] = translate_ADC32i32<addr_width>;
+  m[X86::ADC32mi] = translate_ADC32mi<addr_width>;
+  m[X86::ADC32mi8] = translate_ADC32mi8<addr_width>;
+  m[X86::ADC32mr] = translate_ADC32mr<addr_width>;
+  m[X86::ADC32ri] = translate_ADC32ri<addr_width>;
+  m[X86::ADC32ri8] = translate_ADC32ri8<addr_width>;
+  m[X86::ADC64ri8] = translate_ADC64ri8<addr_width>;
+  m[X86::ADC32rm] = translate_ADC32rm<addr_width>;
+  m[X86::ADC32rr] = translate_ADC32rr<addr_width>;
+  m[X86::ADC32rr_REV] = translate_ADC32rr_REV<addr_width>;
+  m[X86::ADC8i8] = translate_ADC8i8<addr_width>;
+  m[X86::ADC8mi] = translate_ADC8mi<addr_width>;
+  m[X86::ADC8mr] = translate_ADC8mr<addr_width>;
+  m[X86::ADC8ri] = translate_ADC8ri<addr_width>;
+  m[X86::ADC8rm] = translate_ADC8rm<addr_width>;
+  m[X86::ADC8rr] = translate_ADC8rr<addr_width>;
+  m[X86::ADC8rr_REV] = translate_ADC8rr_REV<addr_width>;
+
+  m[X86::ADC64i32] = translate_ADC64i32<addr_width>;
+  m[X86::ADC64ri32] = translate_ADC64ri32<addr_width>;
+  m[X86::ADC64rr] = translate_ADC64rr<addr_width>;
 }
+
+template void ADD_populateDispatchMap<32>(DispatchMap &m);
+template void ADD_populateDispatchMap<64>(DispatchMap &m);
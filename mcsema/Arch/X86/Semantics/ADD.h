@@ -29,4 +29,5 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 
+template <int addr_width>
 void ADD_populateDispatchMap(DispatchMap &m);
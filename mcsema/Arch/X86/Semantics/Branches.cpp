@@ -52,6 +52,7 @@
 #include "mcsema/Arch/X86/Semantics/Branches.h"
 
 #include "mcsema/CFG/Externals.h"
+#include "mcsema/BC/Lookup.h"
 #include "mcsema/BC/Util.h"
 #include "mcsema/cfgToLLVM/JumpTables.h"
 
@@ -236,39 +237,6 @@ static InstTransResult doLoopNEIMPL(llvm::BasicBlock *&b, llvm::BasicBlock *T,
   return EndBlock;
 }
 
-static InstTransResult doLoop(llvm::BasicBlock *&b, llvm::BasicBlock *T,
-                              llvm::BasicBlock *F) {
-  auto M = b->getParent()->getParent();
-
-  if (ArchPointerSize(M) == Pointer32) {
-    return doLoopIMPL<32>(b, T, F);
-  } else {
-    return doLoopIMPL<64>(b, T, F);
-  }
-}
-
-static InstTransResult doLoopE(llvm::BasicBlock *&b, llvm::BasicBlock *T,
-                               llvm::BasicBlock *F) {
-  auto M = b->getParent()->getParent();
-
-  if (ArchPointerSize(M) == Pointer32) {
-    return doLoopEIMPL<32>(b, T, F);
-  } else {
-    return doLoopEIMPL<64>(b, T, F);
-  }
-}
-
-static InstTransResult doLoopNE(llvm::BasicBlock *&b, llvm::BasicBlock *T,
-                                llvm::BasicBlock *F) {
-  auto M = b->getParent()->getParent();
-
-  if (ArchPointerSize(M) == Pointer32) {
-    return doLoopNEIMPL<32>(b, T, F);
-  } else {
-    return doLoopNEIMPL<64>(b, T, F);
-  }
-}
-
 template<int width>
 static void writeReturnAddr(llvm::BasicBlock *B, VA ret_addr) {
   auto xsp = 32 == width ? llvm::X86::ESP : llvm::X86::RSP;
@@ -280,6 +248,16 @@ static void writeReturnAddr(llvm::BasicBlock *B, VA ret_addr) {
   R_WRITE<width>(B, xsp, espSub);
 }
 
+template<int width>
+static void reserveReturnAddr(llvm::BasicBlock *B) {
+  auto xsp = 32 == width ? llvm::X86::ESP : llvm::X86::RSP;
+  auto espOld = R_READ<width>(B, xsp);
+  auto espSub = llvm::BinaryOperator::CreateSub(espOld,
+                                                CONST_V<width>(B, width / 8),
+                                                "", B);
+  R_WRITE<width>(B, xsp, espSub);
+}
+
 template<int width>
 static void writeDetachReturnAddr(llvm::BasicBlock *B) {
   auto xsp = 32 == width ? llvm::X86::ESP : llvm::X86::RSP;
@@ -292,42 +270,71 @@ static void writeDetachReturnAddr(llvm::BasicBlock *B) {
   R_WRITE<width>(B, xsp, espSub);
 }
 
+template<int width>
 static void doCallV(llvm::BasicBlock *&block, NativeInstPtr ip,
                     llvm::Value *call_addr, bool is_jump) {
 
   auto F = block->getParent();
   auto M = F->getParent();
   auto &C = M->getContext();
-  uint32_t bitWidth = ArchPointerSize(M);
 
-  if (_X86_64_ == SystemArch(M)) {
-    R_WRITE<64>(block, llvm::X86::RIP, call_addr);
-    if ( !is_jump) {
-      writeDetachReturnAddr<64>(block);
+  // If the target is a lifted function, then call it directly, and only
+  // leave lifted code if it isn't.
+  llvm::BasicBlock *cont_block = nullptr;
+  if (LookupTableEnabled()) {
+    auto lifted_func = llvm::CallInst::Create(
+        GetLookupFunction(M), call_addr, "", block);
+    auto is_lifted = new llvm::ICmpInst(
+        *block, llvm::ICmpInst::ICMP_NE, lifted_func,
+        llvm::ConstantPointerNull::get(
+            llvm::cast<llvm::PointerType>(lifted_func->getType())));
+
+    auto lifted_block = llvm::BasicBlock::Create(C, "", F);
+    auto native_block = llvm::BasicBlock::Create(C, "", F);
+    cont_block = llvm::BasicBlock::Create(C, "", F);
+    llvm::BranchInst::Create(lifted_block, native_block, is_lifted, block);
+
+    if (!is_jump) {
+      writeReturnAddr<width>(lifted_block, ip->get_loc() + ip->get_len());
     }
-  } else {
-    R_WRITE<32>(block, llvm::X86::EIP, call_addr);
-    if ( !is_jump) {
-      writeDetachReturnAddr<32>(block);
+    std::vector<llvm::Value *> args;
+    for (auto &arg : F->args()) {
+      args.push_back(&arg);
     }
+    auto call_lifted = llvm::CallInst::Create(lifted_func, args, "",
+                                              lifted_block);
+    ArchSetCallingConv(M, call_lifted);
+    llvm::BranchInst::Create(cont_block, lifted_block);
+
+    block = native_block;
+  }
+
+  R_WRITE<width>(block, 32 == width ? llvm::X86::EIP : llvm::X86::RIP,
+                 call_addr);
+  if (!is_jump) {
+    writeDetachReturnAddr<width>(block);
   }
 
   auto detach = M->getFunction("__mcsema_detach_call_value");
   auto call_detach = llvm::CallInst::Create(detach, "", block);
   call_detach->setCallingConv(llvm::CallingConv::C);
+
+  if (cont_block) {
+    llvm::BranchInst::Create(cont_block, block);
+    block = cont_block;
+  }
 }
 
 template<int width>
 static void doCallM(llvm::BasicBlock *&block, NativeInstPtr ip,
                     llvm::Value *mem_addr, bool is_jump) {
   auto call_addr = M_READ<width>(ip, block, mem_addr);
-  return doCallV(block, ip, call_addr, is_jump);
+  return doCallV<width>(block, ip, call_addr, is_jump);
 }
 
-template<int width>
-static llvm::CallInst *emitInternalCall(llvm::BasicBlock *&b, llvm::Module *M,
-                                        const std::string &target_fn,
-                                        VA ret_addr, bool is_jmp) {
+// emit: call target_fn(regstate);
+static llvm::CallInst *emitLiftedCall(llvm::BasicBlock *&b, llvm::Module *M,
+                                      const std::string &target_fn) {
   // we need the parent function to get the regstate argument
   auto ourF = b->getParent();
   TASSERT(ourF->arg_size() == 1, "");
@@ -337,12 +344,6 @@ static llvm::CallInst *emitInternalCall(llvm::BasicBlock *&b, llvm::Module *M,
 
   TASSERT(targetF != nullptr, "Could not find target function: " + target_fn);
 
-  // do we need to push a ret addr?
-  if (!is_jmp) {
-    writeReturnAddr<width>(b, ret_addr);
-  }
-
-  // emit: call target_fn(regstate);
   std::vector<llvm::Value *> subArgs;
   for (auto &arg : ourF->args()) {
     subArgs.push_back(&arg);
@@ -355,8 +356,33 @@ static llvm::CallInst *emitInternalCall(llvm::BasicBlock *&b, llvm::Module *M,
 }
 
 template<int width>
-static InstTransResult doCallPC(NativeInstPtr ip, llvm::BasicBlock *&b,
-                                VA tgtAddr, bool is_jump) {
+static llvm::CallInst *emitInternalCall(llvm::BasicBlock *&b, llvm::Module *M,
+                                        const std::string &target_fn,
+                                        VA ret_addr, bool is_jmp) {
+  // do we need to push a ret addr?
+  if (!is_jmp) {
+    writeReturnAddr<width>(b, ret_addr);
+  }
+
+  return emitLiftedCall(b, M, target_fn);
+}
+
+// A jump into another lifted function becomes a guaranteed tail call, so
+// that chains of tail-jumps (e.g. thunks) don't grow the native stack. The
+// callee has the same prototype and calling convention, and returns to our
+// caller.
+static InstTransResult emitTailCall(llvm::BasicBlock *&b, llvm::Module *M,
+                                    const std::string &target_fn) {
+  auto c = emitLiftedCall(b, M, target_fn);
+  c->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  llvm::ReturnInst::Create(b->getContext(), b);
+  return EndBlock;
+}
+
+template<int width>
+static InstTransResult doCallPC(NativeModulePtr natM, NativeInstPtr ip,
+                                llvm::BasicBlock *&b, VA tgtAddr,
+                                bool is_jump) {
   auto M = b->getParent()->getParent();
 
   //We should be able to look it up in our module.
@@ -367,8 +393,17 @@ static InstTransResult doCallPC(NativeInstPtr ip, llvm::BasicBlock *&b,
   ss << "sub_" << std::hex << tgtAddr;
   std::string fname = ss.str();
 
+  // The callee never reads its return address, so only make room for it,
+  // to keep the callee's stack arguments where it expects them.
+  auto func_it = natM->get_funcs().find(tgtAddr);
+  auto elide_ret_addr = !is_jump && func_it != natM->get_funcs().end() &&
+                        func_it->second->return_address_is_private();
+  if (elide_ret_addr) {
+    reserveReturnAddr<width>(b);
+  }
+
   auto c = emitInternalCall<width>(
-      b, M, fname, ip->get_loc() + ip->get_len(), is_jump);
+      b, M, fname, ip->get_loc() + ip->get_len(), is_jump || elide_ret_addr);
   auto F = c->getCalledFunction();
 
   if (ip->has_local_noreturn() || F->doesNotReturn()) {
@@ -381,8 +416,15 @@ static InstTransResult doCallPC(NativeInstPtr ip, llvm::BasicBlock *&b,
     auto unreachable = new llvm::UnreachableInst(b->getContext(), b);
     return EndBlock;
   }
-  //and we can continue to run the old code
 
+  // The callee's return took the PC from the slot that we didn't write, so
+  // set it to the return address here.
+  if (elide_ret_addr) {
+    R_WRITE<width>(b, 32 == width ? llvm::X86::EIP : llvm::X86::RIP,
+                   CONST_V<width>(b, ip->get_loc() + ip->get_len()));
+  }
+
+  //and we can continue to run the old code
   return ContinueBlock;
 }
 
@@ -412,7 +454,14 @@ static InstTransResult doCallPCExtern(llvm::BasicBlock *&b, std::string target,
   // only need to adjust stack if there are more than two args
   //
 
-  auto exit_point = ArchAddExitPointDriver(externFunction);
+  // Direct externals are called in place, on the current stack. Tail calls
+  // still go through the exit point driver, which also returns from the
+  // lifted function on the callee's behalf.
+  auto is_direct = !is_jump && ArchIsDirectCall(externFunction);
+  auto exit_point = externFunction;
+  if (!is_direct) {
+    exit_point = ArchAddExitPointDriver(externFunction);
+  }
 
   if (externFunction->getCallingConv() == llvm::CallingConv::X86_FastCall) {
 
@@ -458,6 +507,7 @@ static InstTransResult doCallPCExtern(llvm::BasicBlock *&b, std::string target,
     }
   }
 
+  auto num_stack_args = paramCount;
   for (int i = 0; i < paramCount; i++) {
     auto vFromStack = M_READ_0<32>(b, baseEspVal);
 
@@ -469,7 +519,7 @@ static InstTransResult doCallPCExtern(llvm::BasicBlock *&b, std::string target,
     }
   }
 
-  if ( !is_jump) {
+  if ( !is_jump && !is_direct) {
     writeDetachReturnAddr<32>(b);
   }
   auto callR = llvm::CallInst::Create(exit_point, arguments, "", b);
@@ -492,6 +542,19 @@ static InstTransResult doCallPCExtern(llvm::BasicBlock *&b, std::string target,
   //
   F_CLEAR(b, llvm::X86::DF);
 
+  // The exit point driver pops the stack arguments of callee-cleanup
+  // functions; a direct call didn't use the lifted stack, so pop them here.
+  auto conv = externFunction->getCallingConv();
+  if (is_direct && num_stack_args &&
+      (llvm::CallingConv::X86_StdCall == conv ||
+       llvm::CallingConv::X86_FastCall == conv)) {
+    auto esp = x86::R_READ<32>(b, llvm::X86::ESP);
+    x86::R_WRITE<32>(
+        b, llvm::X86::ESP,
+        llvm::BinaryOperator::CreateAdd(
+            esp, CONST_V<32>(b, 4 * num_stack_args), "", b));
+  }
+
   //if our convention says to keep the call result alive then do it
   //really, we could always keep the call result alive...
   if (rType == llvm::Type::getInt32Ty(M->getContext())) {
@@ -717,12 +780,20 @@ static InstTransResult doCallPCExtern(llvm::BasicBlock *&b, std::string target,
     }
   }
 
-  if ( !is_jump) {
+  // Direct externals are called in place, on the current stack. Tail calls
+  // still go through the exit point driver, which also returns from the
+  // lifted function on the callee's behalf.
+  auto is_direct = !is_jump && ArchIsDirectCall(externFunction);
+  auto callee = externFunction;
+  if (!is_direct) {
+    callee = ArchAddExitPointDriver(externFunction);
+  }
+
+  if ( !is_jump && !is_direct) {
     writeDetachReturnAddr<64>(b);
   }
 
-  auto callR = llvm::CallInst::Create(ArchAddExitPointDriver(externFunction),
-                                      arguments, "", b);
+  auto callR = llvm::CallInst::Create(callee, arguments, "", b);
   ArchSetCallingConv(M, callR);
 
   if (externFunction->doesNotReturn()) {
@@ -765,10 +836,7 @@ static InstTransResult translate_JMPm(TranslationContext &ctx,
     if (ip->get_ext_call_target()->getCallingConvention()
         == ExternalCodeRef::McsemaCall) {
       auto M = block->getParent()->getParent();
-      std::string target_fn = ArchNameMcSemaCall(s);
-      emitInternalCall<width>(
-          block, M, target_fn, ip->get_loc() + ip->get_len(), true);
-      return ContinueBlock;
+      return emitTailCall(block, M, ArchNameMcSemaCall(s));
     }
 
     if (64 == width) {
@@ -904,7 +972,7 @@ static InstTransResult translate_JMPr(TranslationContext &ctx,
     doJumpTableViaSwitchReg(ctx, block, minus_base, defaultb, width);
     TASSERT(defaultb != nullptr, "Default block has to exit");
     // fallback to doing do_call_value
-    doCallV(defaultb, ip, fromReg, true);
+    doCallV<width>(defaultb, ip, fromReg, true);
     llvm::ReturnInst::Create(defaultb->getContext(), defaultb);
     return EndCFG;
 
@@ -914,7 +982,7 @@ static InstTransResult translate_JMPr(TranslationContext &ctx,
         << __FUNCTION__ << ": regular jump via register: "
         << std::hex << ip->get_loc() << std::endl;
 
-    doCallV(block, ip, fromReg, true);
+    doCallV<width>(block, ip, fromReg, true);
     llvm::ReturnInst::Create(block->getContext(), block);
     return EndCFG;
   }
@@ -948,11 +1016,11 @@ static InstTransResult translate_CALLpcrel32(TranslationContext &ctx,
     }
   } else if (ip->has_code_ref()) {
     VA off = ip->get_reference(NativeInst::MEMRef);
-    ret = doCallPC<width>(ip, block, off, false);
+    ret = doCallPC<width>(natM, ip, block, off, false);
   } else {
     VA off = OP(0).getImm();
-    ret = doCallPC<width>(ip, block, ip->get_loc() + ip->get_len() + off,
-                          false);
+    ret = doCallPC<width>(natM, ip, block,
+                          ip->get_loc() + ip->get_len() + off, false);
   }
 
   return ret;
@@ -990,7 +1058,8 @@ static InstTransResult translate_CALLm(TranslationContext &ctx,
     // not external call, but some weird way of calling local function?
   } else if (ip->has_code_ref()) {
     std::cout << __FUNCTION__ << ":" << __LINE__ << ": doing call" << std::endl;
-    doCallPC<width>(ip, block, ip->get_reference(NativeInst::MEMRef), false);
+    doCallPC<width>(natM, ip, block, ip->get_reference(NativeInst::MEMRef),
+                    false);
   }
   // is this referencing global data?
   else if (ip->has_mem_reference) {
@@ -1022,11 +1091,29 @@ static InstTransResult translate_CALLr(TranslationContext &ctx,
 
   //read the register
   auto fromReg = R_READ<width>(block, tgtOp.getReg());
-  doCallV(block, ip, fromReg, false);
+  doCallV<width>(block, ip, fromReg, false);
   return ContinueBlock;
 }
 
-#define BLOCKNAMES_TRANSLATION(NAME, THECALL) static InstTransResult translate_ ## NAME (TranslationContext &ctx, llvm::BasicBlock *&block) {\
+// A direct jump either branches to a block of this function, or tail-calls
+// the function that starts at its target.
+static InstTransResult translate_JMP(TranslationContext &ctx,
+                                     llvm::BasicBlock *&block) {
+  auto ip = ctx.natI;
+  auto bb_it = ctx.va_to_bb.find(ip->get_tr());
+  if (bb_it != ctx.va_to_bb.end()) {
+    return doNonCondBranch(block, bb_it->second);
+  }
+
+  std::stringstream ss;
+  ss << "sub_" << std::hex << ip->get_tr();
+  return emitTailCall(block, ctx.M, ss.str());
+}
+
+#define BLOCKNAMES_TRANSLATION(NAME, THECALL) \
+    template <int addr_width> \
+    static InstTransResult translate_ ## NAME ( \
+        TranslationContext &ctx, llvm::BasicBlock *&block) {\
     auto F = block->getParent(); \
     auto ip = ctx.natI; \
     auto ifTrue = ctx.va_to_bb[ip->get_tr()]; \
@@ -1036,9 +1123,12 @@ static InstTransResult translate_CALLr(TranslationContext &ctx,
     return ret ;\
 }
 
-BLOCKNAMES_TRANSLATION(LOOP, doLoop(block, ifTrue, ifFalse))
-BLOCKNAMES_TRANSLATION(LOOPE, doLoopE(block, ifTrue, ifFalse))
-BLOCKNAMES_TRANSLATION(LOOPNE, doLoopNE(block, ifTrue, ifFalse))
+BLOCKNAMES_TRANSLATION(LOOP,
+                       doLoopIMPL<addr_width>(block, ifTrue, ifFalse))
+BLOCKNAMES_TRANSLATION(LOOPE,
+                       doLoopEIMPL<addr_width>(block, ifTrue, ifFalse))
+BLOCKNAMES_TRANSLATION(LOOPNE,
+                       doLoopNEIMPL<addr_width>(block, ifTrue, ifFalse))
 GENERIC_TRANSLATION(RET, doRet<32>(block))
 GENERIC_TRANSLATION(RETI, doRetI<32>(block, OP(0)))
 GENERIC_TRANSLATION(RETIW, doRetI<16>(block, OP(0)))
@@ -1047,19 +1137,17 @@ GENERIC_TRANSLATION(RETIQ, doRetI<64>(block, OP(0)))
 
 GENERIC_TRANSLATION(LRET, doLRet<32>(block))
 
-BLOCKNAMES_TRANSLATION(JMP_4, doNonCondBranch(block, ifTrue))
-BLOCKNAMES_TRANSLATION(JMP_2, doNonCondBranch(block, ifTrue))
-BLOCKNAMES_TRANSLATION(JMP_1, doNonCondBranch(block, ifTrue))
 
+template <int addr_width>
 void Branches_populateDispatchMap(DispatchMap &m) {
   m[llvm::X86::JMP32r] = translate_JMPr<32>;
   m[llvm::X86::JMP32m] = translate_JMPm<32>;
   m[llvm::X86::JMP64r] = translate_JMPr<64>;
   m[llvm::X86::JMP64m] = translate_JMPm<64>;
 
-  m[llvm::X86::JMP_4] = translate_JMP_4;
-  m[llvm::X86::JMP_2] = translate_JMP_2;
-  m[llvm::X86::JMP_1] = translate_JMP_1;
+  m[llvm::X86::JMP_4] = translate_JMP;
+  m[llvm::X86::JMP_2] = translate_JMP;
+  m[llvm::X86::JMP_1] = translate_JMP;
 
   m[llvm::X86::CALLpcrel32] = (translate_CALLpcrel32<32> );
   m[llvm::X86::CALL64pcrel32] = (translate_CALLpcrel32<64> );
@@ -1068,14 +1156,17 @@ void Branches_populateDispatchMap(DispatchMap &m) {
   m[llvm::X86::CALL32r] = translate_CALLr<32>;
   m[llvm::X86::CALL64r] = translate_CALLr<64>;
 
-  m[llvm::X86::LOOP] = translate_LOOP;
-  m[llvm::X86::LOOPE] = translate_LOOPE;
-  m[llvm::X86::LOOPNE] = translate_LOOPNE;
-  m[llvm::X86::RETL] = translate_RET;
-  m[llvm::X86::RETIL] = translate_RETI;
-  m[llvm::X86::RETQ] = translate_RETQ;
-  m[llvm::X86::RETIQ] = translate_RETIQ;
-  m[llvm::X86::RETIW] = translate_RETIW;
+  m[llvm::X86::LOOP] = translate_LOOP<addr_width>;
+  m[llvm::X86::LOOPE] = translate_LOOPE<addr_width>;
+  m[llvm::X86::LOOPNE] = translate_LOOPNE<addr_width>;
+  m[llvm::X86::RETL] = translate_RET<addr_width>;
+  m[llvm::X86::RETIL] = translate_RETI<addr_width>;
+  m[llvm::X86::RETQ] = translate_RETQ<addr_width>;
+  m[llvm::X86::RETIQ] = translate_RETIQ<addr_width>;
+  m[llvm::X86::RETIW] = translate_RETIW<addr_width>;
 
-  m[llvm::X86::LRETL] = translate_LRET;
+  m[llvm::X86::LRETL] = translate_LRET<addr_width>;
 }
+
+template void Branches_populateDispatchMap<32>(DispatchMap &m);
+template void Branches_populateDispatchMap<64>(DispatchMap &m);
@@ -134,6 +134,7 @@ static InstTransResult doCMOV(BasicBlock *b, MCOperand &dst, Value *condition,
         m[which ## 64rm] = EMIT_CMOV_RM(64, condition);\
         m[which ## 64rr] = EMIT_CMOV_RR(64, condition);
 
+template <int addr_width>
 void CMOV_populateDispatchMap(DispatchMap &m) {
   EMIT_CMOV(X86::CMOVA, AND(b, NOT(b, llvm::X86::CF), NOT(b, llvm::X86::ZF)));
   EMIT_CMOV(X86::CMOVAE, NOT(b, llvm::X86::CF));
@@ -156,3 +157,6 @@ void CMOV_populateDispatchMap(DispatchMap &m) {
   EMIT_CMOV(X86::CMOVP, F_READ(b, llvm::X86::PF));
   EMIT_CMOV(X86::CMOVS, F_READ(b, llvm::X86::SF));
 }
+
+template void CMOV_populateDispatchMap<32>(DispatchMap &m);
+template void CMOV_populateDispatchMap<64>(DispatchMap &m);
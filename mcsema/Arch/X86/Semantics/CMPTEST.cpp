@@ -50,6 +50,7 @@
 #include "mcsema/Arch/X86/Semantics/CMPTEST.h"
 #include "mcsema/Arch/X86/Semantics/flagops.h"
 
+#include "mcsema/BC/Fuzz.h"
 #include "mcsema/BC/Util.h"
 
 #define NASSERT(cond) TASSERT(cond, "")
@@ -135,6 +136,7 @@ template<int width>
 static void doTestVV(NativeInstPtr ip, llvm::BasicBlock *&b, llvm::Value *lhs,
                      llvm::Value *rhs) {
 
+  AddFuzzCmpHook(b, lhs, rhs);
   auto temp = llvm::BinaryOperator::CreateAnd(lhs, rhs, "", b);
 
   //test to see if temp is 0
@@ -242,7 +244,7 @@ GENERIC_TRANSLATION_REF(
     CMP64i32,
     doCmpRI<64>(ip, block, llvm::MCOperand::createReg(llvm::X86::RAX), OP(0)),
     doCmpRV<64>(ip, block, llvm::MCOperand::createReg(llvm::X86::RAX),
-                IMM_AS_DATA_REF(block, natM, ip)));
+                IMM_AS_DATA_REF<addr_width>(block, natM, ip)));
 
 GENERIC_TRANSLATION(
     CMP16i16,
@@ -265,7 +267,7 @@ GENERIC_TRANSLATION(CMP32ri8, doCmpRI<32>(ip, block, OP(0), OP(1)))
 //GENERIC_TRANSLATION(CMP64ri32, doCmpRI<64>(ip, block, OP(0), OP(1)))
 GENERIC_TRANSLATION_REF(
     CMP64ri32, doCmpRI<64>(ip, block, OP(0), OP(1)),
-    doCmpRV<64>(ip, block, OP(0), IMM_AS_DATA_REF(block, natM, ip)));
+    doCmpRV<64>(ip, block, OP(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)));
 
 GENERIC_TRANSLATION(CMP64ri8, doCmpRI<64>(ip, block, OP(0), OP(1)))
 GENERIC_TRANSLATION_REF(CMP64mi8, doCmpMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
@@ -318,7 +320,7 @@ GENERIC_TRANSLATION_REF(
     TEST64i32,
     doTestRI<64>(ip, block, llvm::MCOperand::createReg(llvm::X86::RAX), OP(0)),
     doTestRV<64>(ip, block, llvm::MCOperand::createReg(llvm::X86::RAX),
-                 IMM_AS_DATA_REF(block, natM, ip)));
+                 IMM_AS_DATA_REF<addr_width>(block, natM, ip)));
 
 //GENERIC_TRANSLATION(TEST32i32, doTestRI<32>(ip,  block, MCOperand::createReg(X86::EAX), OP(0)))
 GENERIC_TRANSLATION_REF(
@@ -330,7 +332,7 @@ GENERIC_TRANSLATION_REF(
 //GENERIC_TRANSLATION(TEST64ri32, doTestRI<64>(ip,  block, OP(0), OP(1)))
 GENERIC_TRANSLATION_REF(
     TEST64ri32, doTestRI<64>(ip, block, OP(0), OP(1)),
-    doTestRV<64>(ip, block, OP(0), IMM_AS_DATA_REF(block, natM, ip)));
+    doTestRV<64>(ip, block, OP(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)));
 
 GENERIC_TRANSLATION(TEST32ri, doTestRI<32>(ip, block, OP(0), OP(1)))
 GENERIC_TRANSLATION(
@@ -373,65 +375,69 @@ GENERIC_TRANSLATION_REF(TEST8rm, doTestRM<8>(ip, block, OP(0), ADDR_NOREF(1)),
                         doTestRM<8>(ip, block, OP(0), MEM_REFERENCE(1)))
 GENERIC_TRANSLATION(TEST8rr, doTestRR<8>(ip, block, OP(0), OP(1)))
 
+template <int addr_width>
 void CMPTEST_populateDispatchMap(DispatchMap &m) {
 
-  m[llvm::X86::CMP8rr] = translate_CMP8rr;
-  m[llvm::X86::CMP8rr_REV] = translate_CMP8rr_REV;
-  m[llvm::X86::CMP16rr] = translate_CMP16rr;
-  m[llvm::X86::CMP16rr_REV] = translate_CMP16rr_REV;
-  m[llvm::X86::CMP32rr_REV] = translate_CMP32rr_REV;
-  m[llvm::X86::CMP32rr] = translate_CMP32rr;
-  m[llvm::X86::CMP64rr] = translate_CMP64rr;
-  m[llvm::X86::CMP64rr_REV] = translate_CMP64rr_REV;
-
-  m[llvm::X86::CMP8ri] = translate_CMP8ri;
-  m[llvm::X86::CMP8i8] = translate_CMP8i8;
-  m[llvm::X86::CMP16ri] = translate_CMP16ri;
-  m[llvm::X86::CMP16ri8] = translate_CMP16ri8;
-  m[llvm::X86::CMP16i16] = translate_CMP16i16;
-  m[llvm::X86::CMP32i32] = translate_CMP32i32;
-  m[llvm::X86::CMP32ri] = translate_CMP32ri;
-  m[llvm::X86::CMP32ri8] = translate_CMP32ri8;
-  m[llvm::X86::CMP64ri32] = translate_CMP64ri32;
-  m[llvm::X86::CMP64ri8] = translate_CMP64ri8;
-  m[llvm::X86::CMP64i32] = translate_CMP64i32;
-
-  m[llvm::X86::CMP32mi8] = translate_CMP32mi8;
-  m[llvm::X86::CMP8mi] = translate_CMP8mi;
-  m[llvm::X86::CMP16mi] = translate_CMP16mi;
-  m[llvm::X86::CMP32mi] = translate_CMP32mi;
-  m[llvm::X86::CMP8rm] = translate_CMP8rm;
-  m[llvm::X86::CMP16rm] = translate_CMP16rm;
-  m[llvm::X86::CMP32rm] = translate_CMP32rm;
-  m[llvm::X86::CMP8mr] = translate_CMP8mr;
-  m[llvm::X86::CMP16mr] = translate_CMP16mr;
-  m[llvm::X86::CMP32mr] = translate_CMP32mr;
-  m[llvm::X86::CMP16mi8] = translate_CMP16mi8;
-
-  m[llvm::X86::CMP64mi8] = translate_CMP64mi8;
-  m[llvm::X86::CMP64mi32] = translate_CMP64mi32;
-  m[llvm::X86::CMP64rm] = translate_CMP64rm;
-  m[llvm::X86::CMP64mr] = translate_CMP64mr;
-
-  m[llvm::X86::TEST64ri32] = translate_TEST64ri32;
-  m[llvm::X86::TEST64i32] = translate_TEST64i32;
-  m[llvm::X86::TEST64mi32] = translate_TEST64mi32;
-  m[llvm::X86::TEST64rm] = translate_TEST64rm;
-  m[llvm::X86::TEST64rr] = translate_TEST64rr;
-  m[llvm::X86::TEST32rr] = translate_TEST32rr;
-  m[llvm::X86::TEST32i32] = translate_TEST32i32;
-  m[llvm::X86::TEST32ri] = translate_TEST32ri;
-  m[llvm::X86::TEST16i16] = translate_TEST16i16;
-  m[llvm::X86::TEST16mi] = translate_TEST16mi;
-  m[llvm::X86::TEST16ri] = translate_TEST16ri;
-  m[llvm::X86::TEST16rm] = translate_TEST16rm;
-  m[llvm::X86::TEST16rr] = translate_TEST16rr;
-  m[llvm::X86::TEST32mi] = translate_TEST32mi;
-  m[llvm::X86::TEST32rm] = translate_TEST32rm;
-  m[llvm::X86::TEST8i8] = translate_TEST8i8;
-  m[llvm::X86::TEST8mi] = translate_TEST8mi;
-  m[llvm::X86::TEST8ri] = translate_TEST8ri;
-  m[llvm::X86::TEST8ri_NOREX] = translate_TEST8ri_NOREX;
-  m[llvm::X86::TEST8rm] = translate_TEST8rm;
-  m[llvm::X86::TEST8rr] = translate_TEST8rr;
+  m[llvm::X86::CMP8rr] = translate_CMP8rr<addr_width>;
+  m[llvm::X86::CMP8rr_REV] = translate_CMP8rr_REV<addr_width>;
+  m[llvm::X86::CMP16rr] = translate_CMP16rr<addr_width>;
+  m[llvm::X86::CMP16rr_REV] = translate_CMP16rr_REV<addr_width>;
+  m[llvm::X86::CMP32rr_REV] = translate_CMP32rr_REV<addr_width>;
+  m[llvm::X86::CMP32rr] = translate_CMP32rr<addr_width>;
+  m[llvm::X86::CMP64rr] = translate_CMP64rr<addr_width>;
+  m[llvm::X86::CMP64rr_REV] = translate_CMP64rr_REV<addr_width>;
+
+  m[llvm::X86::CMP8ri] = translate_CMP8ri<addr_width>;
+  m[llvm::X86::CMP8i8] = translate_CMP8i8<addr_width>;
+  m[llvm::X86::CMP16ri] = translate_CMP16ri<addr_width>;
+  m[llvm::X86::CMP16ri8] = translate_CMP16ri8<addr_width>;
+  m[llvm::X86::CMP16i16] = translate_CMP16i16<addr_width>;
+  m[llvm::X86::CMP32i32] = translate_CMP32i32<addr_width>;
+  m[llvm::X86::CMP32ri] = translate_CMP32ri<addr_width>;
+  m[llvm::X86::CMP32ri8] = translate_CMP32ri8<addr_width>;
+  m[llvm::X86::CMP64ri32] = translate_CMP64ri32<addr_width>;
+  m[llvm::X86::CMP64ri8] = translate_CMP64ri8<addr_width>;
+  m[llvm::X86::CMP64i32] = translate_CMP64i32<addr_width>;
+
+  m[llvm::X86::CMP32mi8] = translate_CMP32mi8<addr_width>;
+  m[llvm::X86::CMP8mi] = translate_CMP8mi<addr_width>;
+  m[llvm::X86::CMP16mi] = translate_CMP16mi<addr_width>;
+  m[llvm::X86::CMP32mi] = translate_CMP32mi<addr_width>;
+  m[llvm::X86::CMP8rm] = translate_CMP8rm<addr_width>;
+  m[llvm::X86::CMP16rm] = translate_CMP16rm<addr_width>;
+  m[llvm::X86::CMP32rm] = translate_CMP32rm<addr_width>;
+  m[llvm::X86::CMP8mr] = translate_CMP8mr<addr_width>;
+  m[llvm::X86::CMP16mr] = translate_CMP16mr<addr_width>;
+  m[llvm::X86::CMP32mr] = translate_CMP32mr<addr_width>;
+  m[llvm::X86::CMP16mi8] = translate_CMP16mi8<addr_width>;
+
+  m[llvm::X86::CMP64mi8] = translate_CMP64mi8<addr_width>;
+  m[llvm::X86::CMP64mi32] = translate_CMP64mi32<addr_width>;
+  m[llvm::X86::CMP64rm] = translate_CMP64rm<addr_width>;
+  m[llvm::X86::CMP64mr] = translate_CMP64mr<addr_width>;
+
+  m[llvm::X86::TEST64ri32] = translate_TEST64ri32<addr_width>;
+  m[llvm::X86::TEST64i32] = translate_TEST64i32<addr_width>;
+  m[llvm::X86::TEST64mi32] = translate_TEST64mi32<addr_width>;
+  m[llvm::X86::TEST64rm] = translate_TEST64rm<addr_width>;
+  m[llvm::X86::TEST64rr] = translate_TEST64rr<addr_width>;
+  m[llvm::X86::TEST32rr] = translate_TEST32rr<addr_width>;
+  m[llvm::X86::TEST32i32] = translate_TEST32i32<addr_width>;
+  m[llvm::X86::TEST32ri] = translate_TEST32ri<addr_width>;
+  m[llvm::X86::TEST16i16] = translate_TEST16i16<addr_width>;
+  m[llvm::X86::TEST16mi] = translate_TEST16mi<addr_width>;
+  m[llvm::X86::TEST16ri] = translate_TEST16ri<addr_width>;
+  m[llvm::X86::TEST16rm] = translate_TEST16rm<addr_width>;
+  m[llvm::X86::TEST16rr] = translate_TEST16rr<addr_width>;
+  m[llvm::X86::TEST32mi] = translate_TEST32mi<addr_width>;
+  m[llvm::X86::TEST32rm] = translate_TEST32rm<addr_width>;
+  m[llvm::X86::TEST8i8] = translate_TEST8i8<addr_width>;
+  m[llvm::X86::TEST8mi] = translate_TEST8mi<addr_width>;
+  m[llvm::X86::TEST8ri] = translate_TEST8ri<addr_width>;
+  m[llvm::X86::TEST8ri_NOREX] = translate_TEST8ri_NOREX<addr_width>;
+  m[llvm::X86::TEST8rm] = translate_TEST8rm<addr_width>;
+  m[llvm::X86::TEST8rr] = translate_TEST8rr<addr_width>;
 }
+
+template void CMPTEST_populateDispatchMap<32>(DispatchMap &m);
+template void CMPTEST_populateDispatchMap<64>(DispatchMap &m);
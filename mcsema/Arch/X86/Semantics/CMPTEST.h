@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "mcsema/Arch/X86/Semantics/flagops.h"
 
+#include "mcsema/BC/Fuzz.h"
 #include "mcsema/BC/Util.h"
 
 class DispatchMap;
@@ -39,6 +40,7 @@ class DispatchMap;
 template<int width>
 static void doCmpVV(NativeInstPtr ip, llvm::BasicBlock *b, llvm::Value *lhs,
                     llvm::Value *rhs) {
+  AddFuzzCmpHook(b, lhs, rhs);
   auto subRes = llvm::BinaryOperator::Create(llvm::Instruction::Sub, lhs, rhs,
                                              "", b);
 
@@ -51,4 +53,5 @@ static void doCmpVV(NativeInstPtr ip, llvm::BasicBlock *b, llvm::Value *lhs,
   WriteOFSub<width>(b, subRes, lhs, rhs);
 }
 
+template <int addr_width>
 void CMPTEST_populateDispatchMap(DispatchMap &m);
@@ -347,33 +347,37 @@ GENERIC_TRANSLATION_REF(XCHG8rm, doXchgRM<8>(ip, block, OP(0), ADDR_NOREF(2)),
                         doXchgRM<8>(ip, block, OP(0), MEM_REFERENCE(2)))
 GENERIC_TRANSLATION(XCHG8rr, doXchgRR<8>(ip, block, OP(1), OP(2)))
 
+template <int addr_width>
 void Exchanges_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::CMPXCHG16rm] = translate_CMPXCHG16rm;
-  m[llvm::X86::CMPXCHG16rr] = translate_CMPXCHG16rr;
-  m[llvm::X86::CMPXCHG32rm] = translate_CMPXCHG32rm;
-  m[llvm::X86::CMPXCHG64rm] = translate_CMPXCHG64rm;
-  m[llvm::X86::CMPXCHG32rr] = translate_CMPXCHG32rr;
-  m[llvm::X86::CMPXCHG64rr] = translate_CMPXCHG64rr;
-  m[llvm::X86::CMPXCHG8rm] = translate_CMPXCHG8rm;
-  m[llvm::X86::CMPXCHG8rr] = translate_CMPXCHG8rr;
-  m[llvm::X86::XADD16rm] = translate_XADD16rm;
-  m[llvm::X86::XADD16rr] = translate_XADD16rr;
-  m[llvm::X86::XADD32rm] = translate_XADD32rm;
-  m[llvm::X86::XADD64rm] = translate_XADD64rm;
-  m[llvm::X86::XADD32rr] = translate_XADD32rr;
-  m[llvm::X86::XADD64rr] = translate_XADD64rr;
-  m[llvm::X86::XADD8rm] = translate_XADD8rm;
-  m[llvm::X86::XADD8rr] = translate_XADD8rr;
-  m[llvm::X86::XCHG16ar] = translate_XCHG16ar;
-  m[llvm::X86::XCHG16rm] = translate_XCHG16rm;
-  m[llvm::X86::XCHG16rr] = translate_XCHG16rr;
-  m[llvm::X86::XCHG32ar] = translate_XCHG32ar;
-  m[llvm::X86::XCHG32ar64] = translate_XCHG32ar64;
-  m[llvm::X86::XCHG64ar] = translate_XCHG64ar;
-  m[llvm::X86::XCHG32rm] = translate_XCHG32rm;
-  m[llvm::X86::XCHG64rr] = translate_XCHG64rr;
-  m[llvm::X86::XCHG64rm] = translate_XCHG64rm;
-  m[llvm::X86::XCHG32rr] = translate_XCHG32rr;
-  m[llvm::X86::XCHG8rm] = translate_XCHG8rm;
-  m[llvm::X86::XCHG8rr] = translate_XCHG8rr;
+  m[llvm::X86::CMPXCHG16rm] = translate_CMPXCHG16rm<addr_width>;
+  m[llvm::X86::CMPXCHG16rr] = translate_CMPXCHG16rr<addr_width>;
+  m[llvm::X86::CMPXCHG32rm] = translate_CMPXCHG32rm<addr_width>;
+  m[llvm::X86::CMPXCHG64rm] = translate_CMPXCHG64rm<addr_width>;
+  m[llvm::X86::CMPXCHG32rr] = translate_CMPXCHG32rr<addr_width>;
+  m[llvm::X86::CMPXCHG64rr] = translate_CMPXCHG64rr<addr_width>;
+  m[llvm::X86::CMPXCHG8rm] = translate_CMPXCHG8rm<addr_width>;
+  m[llvm::X86::CMPXCHG8rr] = translate_CMPXCHG8rr<addr_width>;
+  m[llvm::X86::XADD16rm] = translate_XADD16rm<addr_width>;
+  m[llvm::X86::XADD16rr] = translate_XADD16rr<addr_width>;
+  m[llvm::X86::XADD32rm] = translate_XADD32rm<addr_width>;
+  m[llvm::X86::XADD64rm] = translate_XADD64rm<addr_width>;
+  m[llvm::X86::XADD32rr] = translate_XADD32rr<addr_width>;
+  m[llvm::X86::XADD64rr] = translate_XADD64rr<addr_width>;
+  m[llvm::X86::XADD8rm] = translate_XADD8rm<addr_width>;
+  m[llvm::X86::XADD8rr] = translate_XADD8rr<addr_width>;
+  m[llvm::X86::XCHG16ar] = translate_XCHG16ar<addr_width>;
+  m[llvm::X86::XCHG16rm] = translate_XCHG16rm<addr_width>;
+  m[llvm::X86::XCHG16rr] = translate_XCHG16rr<addr_width>;
+  m[llvm::X86::XCHG32ar] = translate_XCHG32ar<addr_width>;
+  m[llvm::X86::XCHG32ar64] = translate_XCHG32ar64<addr_width>;
+  m[llvm::X86::XCHG64ar] = translate_XCHG64ar<addr_width>;
+  m[llvm::X86::XCHG32rm] = translate_XCHG32rm<addr_width>;
+  m[llvm::X86::XCHG64rr] = translate_XCHG64rr<addr_width>;
+  m[llvm::X86::XCHG64rm] = translate_XCHG64rm<addr_width>;
+  m[llvm::X86::XCHG32rr] = translate_XCHG32rr<addr_width>;
+  m[llvm::X86::XCHG8rm] = translate_XCHG8rm<addr_width>;
+  m[llvm::X86::XCHG8rr] = translate_XCHG8rr<addr_width>;
 }
+
+template void Exchanges_populateDispatchMap<32>(DispatchMap &m);
+template void Exchanges_populateDispatchMap<64>(DispatchMap &m);
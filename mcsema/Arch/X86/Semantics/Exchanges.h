@@ -30,5 +30,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 class DispatchMap;
 
+template <int addr_width>
 void Exchanges_populateDispatchMap(DispatchMap &m);
 
@@ -83,15 +83,13 @@ static InstTransResult doNegM(NativeInstPtr ip, llvm::BasicBlock *&b, llvm::Valu
   return EndBlock;
 }
 
-template<int width>
+template<int width, int regWidth>
 static InstTransResult doNegR(NativeInstPtr ip, llvm::BasicBlock *&b,
                               const llvm::MCOperand &dst) {
   NASSERT(dst.isReg());
-  auto M = b->getParent()->getParent();
-  uint32_t regWidth = ArchPointerSize(M);
 
   // Cache a full width read of the register.
-  auto reg_f_v = GENERIC_MC_READREG(b, dst.getReg(), regWidth);
+  auto reg_f_v = R_READ<regWidth>(b, dst.getReg());
 
   // Do a read of the register.
   auto reg_v = R_READ<width>(b, dst.getReg());
@@ -102,12 +100,8 @@ static InstTransResult doNegR(NativeInstPtr ip, llvm::BasicBlock *&b,
   R_WRITE<width>(b, dst.getReg(), result);
 
   // Update AF with the result from the register.
-  if (regWidth == Pointer32)
-    WriteAF2<32>(b, reg_f_v, x86::R_READ<32>(b, dst.getReg()),
-                 CONST_V<32>(b, 1));
-  else
-    WriteAF2<64>(b, reg_f_v, x86_64::R_READ<64>(b, dst.getReg()),
-                 CONST_V<64>(b, 1));
+  WriteAF2<regWidth>(b, reg_f_v, R_READ<regWidth>(b, dst.getReg()),
+                     CONST_V<regWidth>(b, 1));
 
   return ContinueBlock;
 }
@@ -262,61 +256,65 @@ GENERIC_TRANSLATION(INC64r, (doIncR<64,64>(ip, block, OP(0))))
 
 GENERIC_TRANSLATION_REF(NEG16m, doNegM<16>(ip, block, ADDR_NOREF(0)),
                         doNegM<16>(ip, block, MEM_REFERENCE(0)))
-GENERIC_TRANSLATION(NEG16r, doNegR<16>(ip, block, OP(0)))
+GENERIC_TRANSLATION(NEG16r, (doNegR<16, addr_width>(ip, block, OP(0))))
 GENERIC_TRANSLATION_REF(NEG32m, doNegM<32>(ip, block, ADDR_NOREF(0)),
                         doNegM<32>(ip, block, MEM_REFERENCE(0)))
-GENERIC_TRANSLATION(NEG32r, doNegR<32>(ip, block, OP(0)))
+GENERIC_TRANSLATION(NEG32r, (doNegR<32, addr_width>(ip, block, OP(0))))
 GENERIC_TRANSLATION_REF(NEG64m, doNegM<64>(ip, block, ADDR_NOREF(0)),
                         doNegM<64>(ip, block, MEM_REFERENCE(0)))
-GENERIC_TRANSLATION(NEG64r, doNegR<64>(ip, block, OP(0)))
+GENERIC_TRANSLATION(NEG64r, (doNegR<64, addr_width>(ip, block, OP(0))))
 GENERIC_TRANSLATION_REF(NEG8m, doNegM<8>(ip, block, ADDR_NOREF(0)),
                         doNegM<8>(ip, block, MEM_REFERENCE(0)))
-GENERIC_TRANSLATION(NEG8r, doNegR<8>(ip, block, OP(0)))
+GENERIC_TRANSLATION(NEG8r, (doNegR<8, addr_width>(ip, block, OP(0))))
 
+template <int addr_width>
 void INCDECNEG_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::DEC16r] = translate_DEC16r;
-  m[llvm::X86::DEC8r] = translate_DEC8r;
-  m[llvm::X86::DEC16m] = translate_DEC16m;
-  m[llvm::X86::DEC32m] = translate_DEC32m;
-  m[llvm::X86::DEC64m] = translate_DEC64m;
-  m[llvm::X86::DEC8m] = translate_DEC8m;
-  m[llvm::X86::DEC32r] = translate_DEC32r;
-  m[llvm::X86::DEC32r_alt] = translate_DEC32r;
-
-//  m[llvm::X86::DEC64_16r] = translate_DEC64_16r;
-//  m[llvm::X86::DEC64_32r] = translate_DEC64_32r;
-//  m[llvm::X86::DEC64_32m] = translate_DEC64_32m;
-//  m[llvm::X86::DEC64_16m] = translate_DEC64_16m;
-  m[llvm::X86::DEC64r] = translate_DEC64r;
-
-  m[llvm::X86::INC16m] = translate_INC16m;
-  m[llvm::X86::INC32m] = translate_INC32m;
+  m[llvm::X86::DEC16r] = translate_DEC16r<addr_width>;
+  m[llvm::X86::DEC8r] = translate_DEC8r<addr_width>;
+  m[llvm::X86::DEC16m] = translate_DEC16m<addr_width>;
+  m[llvm::X86::DEC32m] = translate_DEC32m<addr_width>;
+  m[llvm::X86::DEC64m] = translate_DEC64m<addr_width>;
+  m[llvm::X86::DEC8m] = translate_DEC8m<addr_width>;
+  m[llvm::X86::DEC32r] = translate_DEC32r<addr_width>;
+  m[llvm::X86::DEC32r_alt] = translate_DEC32r<addr_width>;
+
+//  m[llvm::X86::DEC64_16r] = translate_DEC64_16r<addr_width>;
+//  m[llvm::X86::DEC64_32r] = translate_DEC64_32r<addr_width>;
+//  m[llvm::X86::DEC64_32m] = translate_DEC64_32m<addr_width>;
+//  m[llvm::X86::DEC64_16m] = translate_DEC64_16m<addr_width>;
+  m[llvm::X86::DEC64r] = translate_DEC64r<addr_width>;
+
+  m[llvm::X86::INC16m] = translate_INC16m<addr_width>;
+  m[llvm::X86::INC32m] = translate_INC32m<addr_width>;
 
   // On 64bit r/m8 can't be encoded if REX prefix is used
-  m[llvm::X86::INC8m] = translate_INC8m;
-  m[llvm::X86::INC8r] = translate_INC8r;
+  m[llvm::X86::INC8m] = translate_INC8m<addr_width>;
+  m[llvm::X86::INC8r] = translate_INC8r<addr_width>;
 
   // On 64bit INC16r/INC32r can't be encoded
-  m[llvm::X86::INC16r] = translate_INC16r;
-  m[llvm::X86::INC32r] = translate_INC32r;
-  m[llvm::X86::INC32r_alt] = translate_INC32r;
+  m[llvm::X86::INC16r] = translate_INC16r<addr_width>;
+  m[llvm::X86::INC32r] = translate_INC32r<addr_width>;
+  m[llvm::X86::INC32r_alt] = translate_INC32r<addr_width>;
 
   // Is it required to have check for REX prefix to check register premissions?
   // uses check for REX.W for 64 bit access.
-  m[llvm::X86::INC64r] = translate_INC64r;
-//  m[llvm::X86::INC64_32r] = translate_INC64_32r;
-//  m[llvm::X86::INC64_16r] = translate_INC64_16r;
-
-  m[llvm::X86::INC64m] = translate_INC64m;
-//  m[llvm::X86::INC64_32m] = translate_INC32m;
-//  m[llvm::X86::INC64_16m] = translate_INC16m;
-
-  m[llvm::X86::NEG16m] = translate_NEG16m;
-  m[llvm::X86::NEG16r] = translate_NEG16r;
-  m[llvm::X86::NEG32m] = translate_NEG32m;
-  m[llvm::X86::NEG32r] = translate_NEG32r;
-  m[llvm::X86::NEG64m] = translate_NEG64m;
-  m[llvm::X86::NEG64r] = translate_NEG64r;
-  m[llvm::X86::NEG8m] = translate_NEG8m;
-  m[llvm::X86::NEG8r] = translate_NEG8r;
+  m[llvm::X86::INC64r] = translate_INC64r<addr_width>;
+//  m[llvm::X86::INC64_32r] = translate_INC64_32r<addr_width>;
+//  m[llvm::X86::INC64_16r] = translate_INC64_16r<addr_width>;
+
+  m[llvm::X86::INC64m] = translate_INC64m<addr_width>;
+//  m[llvm::X86::INC64_32m] = translate_INC32m<addr_width>;
+//  m[llvm::X86::INC64_16m] = translate_INC16m<addr_width>;
+
+  m[llvm::X86::NEG16m] = translate_NEG16m<addr_width>;
+  m[llvm::X86::NEG16r] = translate_NEG16r<addr_width>;
+  m[llvm::X86::NEG32m] = translate_NEG32m<addr_width>;
+  m[llvm::X86::NEG32r] = translate_NEG32r<addr_width>;
+  m[llvm::X86::NEG64m] = translate_NEG64m<addr_width>;
+  m[llvm::X86::NEG64r] = translate_NEG64r<addr_width>;
+  m[llvm::X86::NEG8m] = translate_NEG8m<addr_width>;
+  m[llvm::X86::NEG8r] = translate_NEG8r<addr_width>;
 }
+
+template void INCDECNEG_populateDispatchMap<32>(DispatchMap &m);
+template void INCDECNEG_populateDispatchMap<64>(DispatchMap &m);
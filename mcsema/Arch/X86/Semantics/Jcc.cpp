@@ -239,6 +239,7 @@ static InstTransResult translate_Jcc(TranslationContext &ctx,
 
 }
 
+template <int addr_width>
 void Jcc_populateDispatchMap(DispatchMap &m) {
 
   //for conditional instructions, get the "true" and "false" targets
@@ -279,3 +280,6 @@ void Jcc_populateDispatchMap(DispatchMap &m) {
   m[llvm::X86::JE_4] = translate_Jcc;
   m[llvm::X86::JE_1] = translate_Jcc;
 }
+
+template void Jcc_populateDispatchMap<32>(DispatchMap &m);
+template void Jcc_populateDispatchMap<64>(DispatchMap &m);
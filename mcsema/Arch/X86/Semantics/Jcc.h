@@ -30,4 +30,5 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 class DispatchMap;
 
+template <int addr_width>
 void Jcc_populateDispatchMap(DispatchMap &m);
@@ -593,9 +593,10 @@ GENERIC_TRANSLATION_REF(MOV16mi, doMIMov<16>(ip, block, ADDR_NOREF(0), OP(5)),
 //GENERIC_TRANSLATION_32MI(MOV32mi,
 //	doMIMov<32>(ip,   block, ADDR_NOREF(0), OP(5)),
 //	doMIMov<32>(ip,   block, MEM_REFERENCE(0), OP(5)),
-//    doMIMovV<32>(ip,  block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip))
+//    doMIMovV<32>(ip,  block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip))
 //    )
 //
+template <int addr_width>
 static InstTransResult translate_MOV32mi(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -651,6 +652,7 @@ static InstTransResult translate_MOV32mi(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_MOV64mi32(TranslationContext &ctx,
                                            llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -661,7 +663,7 @@ static InstTransResult translate_MOV64mi32(TranslationContext &ctx,
   auto &inst = ip->get_inst();
 
   if (ip->has_code_ref()) {
-    llvm::Value *addrInt = IMM_AS_DATA_REF(block, natM, ip);
+    llvm::Value *addrInt = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
     if (ip->has_mem_reference) {
       ret = doMIMovV<64>(ip, block, MEM_REFERENCE(0), addrInt);
     } else {
@@ -669,14 +671,14 @@ static InstTransResult translate_MOV64mi32(TranslationContext &ctx,
     }
   } else {
     if (ip->has_mem_reference && ip->has_imm_reference) {
-      llvm::Value *data_v = IMM_AS_DATA_REF(block, natM, ip);
+      llvm::Value *data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
       if (shouldSubtractImageBase(M)) {
         data_v = doSubtractImageBase<64>(data_v, block);
       }
       doMIMovV<64>(ip, block, MEM_REFERENCE(0), data_v);
 
     } else if (ip->has_imm_reference) {
-      llvm::Value *data_v = IMM_AS_DATA_REF(block, natM, ip);
+      llvm::Value *data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
       if (shouldSubtractImageBase(M)) {
         data_v = doSubtractImageBase<64>(data_v, block);
       }
@@ -705,7 +707,7 @@ static InstTransResult translate_MOV_NaoM(
 
   llvm::Value *addr = nullptr;
   if (ctx.natI->has_imm_reference) {
-    addr = IMM_AS_DATA_REF(block, ctx.natM, ctx.natI);
+    addr = IMM_AS_DATA_REF<addr_width>(block, ctx.natM, ctx.natI);
   } else {
     addr = ADDR_TO_POINTER<dest_width>(block, CONST_V<addr_width>(block, imm_addr_op.getImm()));
   }
@@ -727,7 +729,7 @@ static InstTransResult translate_MOV_NoaM(
 
   llvm::Value *addr = nullptr;
   if (ctx.natI->has_imm_reference) {
-    addr = IMM_AS_DATA_REF(block, ctx.natM, ctx.natI);
+    addr = IMM_AS_DATA_REF<addr_width>(block, ctx.natM, ctx.natI);
   } else {
     addr = ADDR_TO_POINTER<dest_width>(block, CONST_V<addr_width>(block, imm_addr_op.getImm()));
   }
@@ -852,6 +854,7 @@ static InstTransResult translate_MOV32ri(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_MOV64ri(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -862,10 +865,10 @@ static InstTransResult translate_MOV64ri(TranslationContext &ctx,
   auto &inst = ip->get_inst();
 
   if (ip->has_code_ref()) {
-    llvm::Value *addrInt = IMM_AS_DATA_REF(block, natM, ip);
+    llvm::Value *addrInt = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
     ret = doRIMovV<64>(ip, block, addrInt, OP(0));
   } else if (ip->has_imm_reference) {
-    llvm::Value *data_v = IMM_AS_DATA_REF(block, natM, ip);
+    llvm::Value *data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
     if (shouldSubtractImageBase(M)) {
       // if we're here, then
       // * archGetImageBase is defined
@@ -882,7 +885,7 @@ static InstTransResult translate_MOV64ri(TranslationContext &ctx,
 }
 
 //write to memory
-template<int width>
+template <int addr_width, int width>
 static InstTransResult translate_MOVao(TranslationContext &ctx,
                                        llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -910,10 +913,10 @@ static InstTransResult translate_MOVao(TranslationContext &ctx,
       // * archGetImageBase is defined
       // * we are on win64
 
-      data_v = IMM_AS_DATA_REF(block, natM, ip);
+      data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
       data_v = doSubtractImageBase<32>(data_v, block);
     } else {
-      data_v = IMM_AS_DATA_REF(block, natM, ip);
+      data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
     }
     ret = doMRMov<width>(ip, block, data_v,
                          llvm::MCOperand::createReg(GET_XAX<width>()));
@@ -926,7 +929,7 @@ static InstTransResult translate_MOVao(TranslationContext &ctx,
 }
 
 //write to EAX
-template<int width>
+template <int addr_width, int width>
 static InstTransResult translate_MOVoa(TranslationContext &ctx,
                                        llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -956,7 +959,7 @@ static InstTransResult translate_MOVoa(TranslationContext &ctx,
   }
 
   if (ip->has_code_ref()) {
-    llvm::Value *addrInt = IMM_AS_DATA_REF(block, natM, ip);
+    llvm::Value *addrInt = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
     ret = doRMMov<width>(ip, block, addrInt,
                          llvm::MCOperand::createReg(eaxReg));
   } else {
@@ -967,10 +970,10 @@ static InstTransResult translate_MOVoa(TranslationContext &ctx,
         // * archGetImageBase is defined
         // * we are on win64
 
-        data_v = IMM_AS_DATA_REF(block, natM, ip);
+        data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
         data_v = doSubtractImageBase<32>(data_v, block);
       } else {
-        data_v = IMM_AS_DATA_REF(block, natM, ip);
+        data_v = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
       }
       ret = doRMMov<width>(ip, block, data_v,
                            llvm::MCOperand::createReg(eaxReg));
@@ -983,6 +986,7 @@ static InstTransResult translate_MOVoa(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_MOV32rm(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
 
@@ -1006,10 +1010,10 @@ static InstTransResult translate_MOV32rm(TranslationContext &ctx,
       // * archGetImageBase is defined
       // * we are on win64
 
-      data_v = MEM_AS_DATA_REF(block, natM, inst, ip, 1);
+      data_v = MEM_REFERENCE(1);
       data_v = doSubtractImageBase<32>(data_v, block);
     } else {
-      data_v = MEM_AS_DATA_REF(block, natM, inst, ip, 1);
+      data_v = MEM_REFERENCE(1);
     }
 
     ret = doRMMov<32>(ip, block, data_v, OP(0));
@@ -1019,6 +1023,7 @@ static InstTransResult translate_MOV32rm(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_MOV32mr(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -1033,7 +1038,7 @@ static InstTransResult translate_MOV32mr(TranslationContext &ctx,
     TASSERT(addrInt != NULL, "Could not get address for external");
     return doMRMov<32>(ip, block, addrInt, OP(5));
   } else if (ip->has_mem_reference) {
-    ret = doMRMov<32>(ip, block, MEM_AS_DATA_REF(block, natM, inst, ip, 0),
+    ret = doMRMov<32>(ip, block, MEM_REFERENCE(0),
                       OP(5));
   } else {
     ret = doMRMov<32>(ip, block, ADDR_NOREF(0), OP(5));
@@ -1041,6 +1046,7 @@ static InstTransResult translate_MOV32mr(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_MOV64rm(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -1062,10 +1068,10 @@ static InstTransResult translate_MOV64rm(TranslationContext &ctx,
       // * archGetImageBase is defined
       // * we are on win64
 
-      data_v = MEM_AS_DATA_REF(block, natM, inst, ip, 1);
+      data_v = MEM_REFERENCE(1);
       data_v = doSubtractImageBase<64>(data_v, block);
     } else {
-      data_v = MEM_AS_DATA_REF(block, natM, inst, ip, 1);
+      data_v = MEM_REFERENCE(1);
     }
     ret = doRMMov<64>(ip, block, data_v, OP(0));
   } else {
@@ -1074,6 +1080,7 @@ static InstTransResult translate_MOV64rm(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_MOV64mr(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -1088,7 +1095,7 @@ static InstTransResult translate_MOV64mr(TranslationContext &ctx,
     TASSERT(addrInt != NULL, "Could not get address for external");
     return doMRMov<64>(ip, block, addrInt, OP(5));
   } else if (ip->has_mem_reference) {
-    ret = doMRMov<64>(ip, block, MEM_AS_DATA_REF(block, natM, inst, ip, 0),
+    ret = doMRMov<64>(ip, block, MEM_REFERENCE(0),
                       OP(5));
   } else {
     ret = doMRMov<64>(ip, block, ADDR_NOREF(0), OP(5));
@@ -1113,36 +1120,37 @@ static InstTransResult translate_CDQE(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 void MOV_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::MOV8rr] = translate_MOV8rr;
-  m[llvm::X86::MOV8rr_REV] = translate_MOV8rr_REV;
-  m[llvm::X86::MOV16rr] = translate_MOV16rr;
-  m[llvm::X86::MOV16rr_REV] = translate_MOV16rr_REV;
-  m[llvm::X86::MOV32rr] = translate_MOV32rr;
-  m[llvm::X86::MOV32rr_REV] = translate_MOV32rr_REV;
-  m[llvm::X86::MOV64rr] = translate_MOV64rr;
-  m[llvm::X86::MOV64rr_REV] = translate_MOV64rr_REV;
-
-  m[llvm::X86::MOV8ri] = translate_MOV8ri;
-  m[llvm::X86::MOV16ri] = translate_MOV16ri;
-  m[llvm::X86::MOV32ao32] = translate_MOVao<32>;
-  m[llvm::X86::MOV16ao16] = translate_MOVao<16>;
-//  m[llvm::X86::MOV8ao8] = translate_MOVao<8>;
-  m[llvm::X86::MOV32o32a] = translate_MOVoa<32>;
-  m[llvm::X86::MOV16o16a] = translate_MOVoa<16>;
-//  m[llvm::X86::MOV8o8a] = translate_MOVoa<8>;
+  m[llvm::X86::MOV8rr] = translate_MOV8rr<addr_width>;
+  m[llvm::X86::MOV8rr_REV] = translate_MOV8rr_REV<addr_width>;
+  m[llvm::X86::MOV16rr] = translate_MOV16rr<addr_width>;
+  m[llvm::X86::MOV16rr_REV] = translate_MOV16rr_REV<addr_width>;
+  m[llvm::X86::MOV32rr] = translate_MOV32rr<addr_width>;
+  m[llvm::X86::MOV32rr_REV] = translate_MOV32rr_REV<addr_width>;
+  m[llvm::X86::MOV64rr] = translate_MOV64rr<addr_width>;
+  m[llvm::X86::MOV64rr_REV] = translate_MOV64rr_REV<addr_width>;
+
+  m[llvm::X86::MOV8ri] = translate_MOV8ri<addr_width>;
+  m[llvm::X86::MOV16ri] = translate_MOV16ri<addr_width>;
+  m[llvm::X86::MOV32ao32] = translate_MOVao<addr_width, 32>;
+  m[llvm::X86::MOV16ao16] = translate_MOVao<addr_width, 16>;
+//  m[llvm::X86::MOV8ao8] = translate_MOVao<addr_width, 8>;
+  m[llvm::X86::MOV32o32a] = translate_MOVoa<addr_width, 32>;
+  m[llvm::X86::MOV16o16a] = translate_MOVoa<addr_width, 16>;
+//  m[llvm::X86::MOV8o8a] = translate_MOVoa<addr_width, 8>;
   m[llvm::X86::MOV32ri] = translate_MOV32ri;
   m[llvm::X86::MOV32ri_alt] = translate_MOV32ri;
-  m[llvm::X86::MOV64ri] = translate_MOV64ri;
-  m[llvm::X86::MOV64ri32] = translate_MOV64ri;
+  m[llvm::X86::MOV64ri] = translate_MOV64ri<addr_width>;
+  m[llvm::X86::MOV64ri32] = translate_MOV64ri<addr_width>;
 
-  m[llvm::X86::MOV8mi] = translate_MOV8mi;
-  m[llvm::X86::MOV16mi] = translate_MOV16mi;
-  m[llvm::X86::MOV32mi] = translate_MOV32mi;
-  m[llvm::X86::MOV64mi32] = translate_MOV64mi32;
+  m[llvm::X86::MOV8mi] = translate_MOV8mi<addr_width>;
+  m[llvm::X86::MOV16mi] = translate_MOV16mi<addr_width>;
+  m[llvm::X86::MOV32mi] = translate_MOV32mi<addr_width>;
+  m[llvm::X86::MOV64mi32] = translate_MOV64mi32<addr_width>;
 
-  m[llvm::X86::MOV8mr] = translate_MOV8mr;
-  m[llvm::X86::MOV16mr] = translate_MOV16mr;
+  m[llvm::X86::MOV8mr] = translate_MOV8mr<addr_width>;
+  m[llvm::X86::MOV16mr] = translate_MOV16mr<addr_width>;
 
   m[llvm::X86::MOV8o32a] = translate_MOV_NoaM<8, 32>;
   m[llvm::X86::MOV8ao32] = translate_MOV_NaoM<8, 32>;
@@ -1150,61 +1158,63 @@ void MOV_populateDispatchMap(DispatchMap &m) {
   m[llvm::X86::MOV16o32a] = translate_MOV_NoaM<16, 32>;
   m[llvm::X86::MOV16ao32] = translate_MOV_NaoM<16, 32>;
 
-  m[llvm::X86::MOV32mr] = translate_MOV32mr;
-  m[llvm::X86::MOV64mr] = translate_MOV64mr;
+  m[llvm::X86::MOV32mr] = translate_MOV32mr<addr_width>;
+  m[llvm::X86::MOV64mr] = translate_MOV64mr<addr_width>;
 
-  m[llvm::X86::MOV8rm] = translate_MOV8rm;
-  m[llvm::X86::MOV16rm] = translate_MOV16rm;
-  m[llvm::X86::MOV32rm] = translate_MOV32rm;
-  m[llvm::X86::MOV64rm] = translate_MOV64rm;
+  m[llvm::X86::MOV8rm] = translate_MOV8rm<addr_width>;
+  m[llvm::X86::MOV16rm] = translate_MOV16rm<addr_width>;
+  m[llvm::X86::MOV32rm] = translate_MOV32rm<addr_width>;
+  m[llvm::X86::MOV64rm] = translate_MOV64rm<addr_width>;
 
-  m[llvm::X86::MOVZX16rr8] = translate_MOVZX16rr8;
-  m[llvm::X86::MOVZX32rr8] = translate_MOVZX32rr8;
-  m[llvm::X86::MOVZX32rr16] = translate_MOVZX32rr16;
+  m[llvm::X86::MOVZX16rr8] = translate_MOVZX16rr8<addr_width>;
+  m[llvm::X86::MOVZX32rr8] = translate_MOVZX32rr8<addr_width>;
+  m[llvm::X86::MOVZX32rr16] = translate_MOVZX32rr16<addr_width>;
 
-  m[llvm::X86::MOVZX16rm8] = translate_MOVZX16rm8;
-  m[llvm::X86::MOVZX32rm8] = translate_MOVZX32rm8;
-  m[llvm::X86::MOVZX32rm16] = translate_MOVZX32rm16;
+  m[llvm::X86::MOVZX16rm8] = translate_MOVZX16rm8<addr_width>;
+  m[llvm::X86::MOVZX32rm8] = translate_MOVZX32rm8<addr_width>;
+  m[llvm::X86::MOVZX32rm16] = translate_MOVZX32rm16<addr_width>;
 
-  m[llvm::X86::MOVSX16rr8] = translate_MOVSX16rr8;
-  m[llvm::X86::MOVSX32rr16] = translate_MOVSX32rr16;
-  m[llvm::X86::MOVSX32rr8] = translate_MOVSX32rr8;
-  m[llvm::X86::MOVSX64rr8] = translate_MOVSX32rr8;
-  m[llvm::X86::MOVSX64rr16] = translate_MOVSX32rr8;
-  m[llvm::X86::MOVSX64rr32] = translate_MOVSX64rr32;
+  m[llvm::X86::MOVSX16rr8] = translate_MOVSX16rr8<addr_width>;
+  m[llvm::X86::MOVSX32rr16] = translate_MOVSX32rr16<addr_width>;
+  m[llvm::X86::MOVSX32rr8] = translate_MOVSX32rr8<addr_width>;
+  m[llvm::X86::MOVSX64rr8] = translate_MOVSX32rr8<addr_width>;
+  m[llvm::X86::MOVSX64rr16] = translate_MOVSX32rr8<addr_width>;
+  m[llvm::X86::MOVSX64rr32] = translate_MOVSX64rr32<addr_width>;
 
-  m[llvm::X86::MOVSX16rm8] = translate_MOVSX16rm8;
-  m[llvm::X86::MOVSX32rm8] = translate_MOVSX32rm8;
-  m[llvm::X86::MOVSX32rm16] = translate_MOVSX32rm16;
-  m[llvm::X86::MOVSX64rm8] = translate_MOVSX64rm8;
-  m[llvm::X86::MOVSX64rm16] = translate_MOVSX64rm16;
-  m[llvm::X86::MOVSX64rm32] = translate_MOVSX64rm32;
+  m[llvm::X86::MOVSX16rm8] = translate_MOVSX16rm8<addr_width>;
+  m[llvm::X86::MOVSX32rm8] = translate_MOVSX32rm8<addr_width>;
+  m[llvm::X86::MOVSX32rm16] = translate_MOVSX32rm16<addr_width>;
+  m[llvm::X86::MOVSX64rm8] = translate_MOVSX64rm8<addr_width>;
+  m[llvm::X86::MOVSX64rm16] = translate_MOVSX64rm16<addr_width>;
+  m[llvm::X86::MOVSX64rm32] = translate_MOVSX64rm32<addr_width>;
 
-  m[llvm::X86::MOV16rs] = translate_MOV16rs;
-  m[llvm::X86::MOV32rs] = translate_MOV32rs;
-  m[llvm::X86::MOV64rs] = translate_MOV64rs;
+  m[llvm::X86::MOV16rs] = translate_MOV16rs<addr_width>;
+  m[llvm::X86::MOV32rs] = translate_MOV32rs<addr_width>;
+  m[llvm::X86::MOV64rs] = translate_MOV64rs<addr_width>;
 
-  m[llvm::X86::MOV16ms] = translate_MOV16ms;
-  m[llvm::X86::MOV32ms] = translate_MOV32ms;
-  m[llvm::X86::MOV64ms] = translate_MOV64ms;
+  m[llvm::X86::MOV16ms] = translate_MOV16ms<addr_width>;
+  m[llvm::X86::MOV32ms] = translate_MOV32ms<addr_width>;
+  m[llvm::X86::MOV64ms] = translate_MOV64ms<addr_width>;
 
-  m[llvm::X86::MOV16sr] = translate_MOV32rs;
-  m[llvm::X86::MOV32sr] = translate_MOV32rs;
-  m[llvm::X86::MOV64sr] = translate_MOV32rs;
+  m[llvm::X86::MOV16sr] = translate_MOV32rs<addr_width>;
+  m[llvm::X86::MOV32sr] = translate_MOV32rs<addr_width>;
+  m[llvm::X86::MOV64sr] = translate_MOV32rs<addr_width>;
 
   //m[llvm::X86::MOV16sm] = translate_MOV16sm;
   // m[llvm::X86::MOV32sm] = translate_MOV32sm;
-  // m[llvm::X86::MOV64sm] = translate_MOV64sm;
+  // m[llvm::X86::MOV64sm] = translate_MOV64sm<addr_width>;
 
-  m[llvm::X86::MOVBE16rm] = translate_MOVBE16rm;
-  m[llvm::X86::MOVBE32rm] = translate_MOVBE32rm;
-  m[llvm::X86::MOVBE64rm] = translate_MOVBE64rm;
+  m[llvm::X86::MOVBE16rm] = translate_MOVBE16rm<addr_width>;
+  m[llvm::X86::MOVBE32rm] = translate_MOVBE32rm<addr_width>;
+  m[llvm::X86::MOVBE64rm] = translate_MOVBE64rm<addr_width>;
 
-  m[llvm::X86::MOVBE16mr] = translate_MOVBE16mr;
-  m[llvm::X86::MOVBE32mr] = translate_MOVBE32mr;
-  m[llvm::X86::MOVBE64mr] = translate_MOVBE64mr;
+  m[llvm::X86::MOVBE16mr] = translate_MOVBE16mr<addr_width>;
+  m[llvm::X86::MOVBE32mr] = translate_MOVBE32mr<addr_width>;
+  m[llvm::X86::MOVBE64mr] = translate_MOVBE64mr<addr_width>;
 
   m[llvm::X86::CDQE] = translate_CDQE;
 
 }
 
+template void MOV_populateDispatchMap<32>(DispatchMap &m);
+template void MOV_populateDispatchMap<64>(DispatchMap &m);
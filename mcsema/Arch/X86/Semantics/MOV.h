@@ -67,4 +67,5 @@ static InstTransResult doRRMov(NativeInstPtr ip, llvm::BasicBlock *b,
   return ContinueBlock;
 }
 
+template <int addr_width>
 void MOV_populateDispatchMap(DispatchMap &m);
@@ -618,13 +618,13 @@ GENERIC_TRANSLATION(IMUL32rri8, doIMulRRI<32>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION(IMUL64rri8, doIMulRRI<64>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION_REF(
     IMUL64rri32, doIMulRRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doIMulRRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doIMulRRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 GENERIC_TRANSLATION_MI(
     IMUL64rmi32,
     doIMulRMI<64>(ip, block, OP(0), ADDR_NOREF(1), OP(2)),
     doIMulRMI<64>(ip, block, OP(0), MEM_REFERENCE(1), OP(2)),
-    doIMulRMV<64>(ip, block, OP(0), ADDR_NOREF(1), IMM_AS_DATA_REF(block, natM, ip)),
-    doIMulRMV<64>(ip, block, OP(0), MEM_REFERENCE(1), IMM_AS_DATA_REF(block, natM, ip)))
+    doIMulRMV<64>(ip, block, OP(0), ADDR_NOREF(1), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doIMulRMV<64>(ip, block, OP(0), MEM_REFERENCE(1), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 GENERIC_TRANSLATION(IDIV8r, doIDivR<8>(ip, block, OP(0)))
 GENERIC_TRANSLATION(IDIV16r, doIDivR<16>(ip, block, OP(0)))
 GENERIC_TRANSLATION(IDIV32r, doIDivR<32>(ip, block, OP(0)))
@@ -651,56 +651,60 @@ GENERIC_TRANSLATION_REF(DIV32m, doDivM<32>(ip, block, ADDR_NOREF(0)),
 GENERIC_TRANSLATION_REF(DIV64m, doDivM<64>(ip, block, ADDR_NOREF(0)),
                         doDivM<64>(ip, block, MEM_REFERENCE(0)))
 
+template <int addr_width>
 void MULDIV_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::IMUL32rm] = translate_IMUL32rm;
-  m[llvm::X86::IMUL64rm] = translate_IMUL64rm;
-  m[llvm::X86::IMUL16rm] = translate_IMUL16rm;
-  m[llvm::X86::IMUL8r] = translate_IMUL8r;
-  m[llvm::X86::IMUL8m] = translate_IMUL8m;
-  m[llvm::X86::IMUL16r] = translate_IMUL16r;
-  m[llvm::X86::IMUL16m] = translate_IMUL16m;
-  m[llvm::X86::MUL32r] = translate_MUL32r;
-  m[llvm::X86::MUL64r] = translate_MUL64r;
-  m[llvm::X86::MUL32m] = translate_MUL32m;
-  m[llvm::X86::MUL64m] = translate_MUL64m;
-  m[llvm::X86::MUL16r] = translate_MUL16r;
-  m[llvm::X86::MUL16m] = translate_MUL16m;
-  m[llvm::X86::MUL8r] = translate_MUL8r;
-  m[llvm::X86::MUL8m] = translate_MUL8m;
-  m[llvm::X86::IMUL32r] = translate_IMUL32r;
-  m[llvm::X86::IMUL32m] = translate_IMUL32m;
-  m[llvm::X86::IMUL64m] = translate_IMUL64m;
-  m[llvm::X86::IMUL32rr] = translate_IMUL32rr;
-  m[llvm::X86::IMUL16rr] = translate_IMUL16rr;
-  m[llvm::X86::IMUL16rmi] = translate_IMUL16rmi;
-  m[llvm::X86::IMUL16rmi8] = translate_IMUL16rmi8;
-  m[llvm::X86::IMUL16rri] = translate_IMUL16rri;
-  m[llvm::X86::IMUL16rri8] = translate_IMUL16rri8;
-  m[llvm::X86::IMUL32rmi] = translate_IMUL32rmi;
-  m[llvm::X86::IMUL32rmi8] = translate_IMUL32rmi8;
-  m[llvm::X86::IMUL64rmi8] = translate_IMUL64rmi8;
-  m[llvm::X86::IMUL32rri] = translate_IMUL32rri;
-  m[llvm::X86::IMUL32rri8] = translate_IMUL32rri8;
-  m[llvm::X86::IMUL64rri8] = translate_IMUL64rri8;
-  m[llvm::X86::IMUL64rri32] = translate_IMUL64rri32;
-  m[llvm::X86::IMUL64rmi32] = translate_IMUL64rmi32;
-  m[llvm::X86::IMUL64rr] = translate_IMUL64rr;
-  m[llvm::X86::IMUL64r] = translate_IMUL64r;
-
-  m[llvm::X86::IDIV8r] = translate_IDIV8r;
-  m[llvm::X86::IDIV16r] = translate_IDIV16r;
-  m[llvm::X86::IDIV32r] = translate_IDIV32r;
-  m[llvm::X86::IDIV64r] = translate_IDIV64r;
-  m[llvm::X86::IDIV8m] = translate_IDIV8m;
-  m[llvm::X86::IDIV16m] = translate_IDIV16m;
-  m[llvm::X86::IDIV32m] = translate_IDIV32m;
-  m[llvm::X86::IDIV64m] = translate_IDIV64m;
-  m[llvm::X86::DIV8r] = translate_DIV8r;
-  m[llvm::X86::DIV16r] = translate_DIV16r;
-  m[llvm::X86::DIV32r] = translate_DIV32r;
-  m[llvm::X86::DIV64r] = translate_DIV64r;
-  m[llvm::X86::DIV8m] = translate_DIV8m;
-  m[llvm::X86::DIV16m] = translate_DIV16m;
-  m[llvm::X86::DIV32m] = translate_DIV32m;
-  m[llvm::X86::DIV64m] = translate_DIV64m;
+  m[llvm::X86::IMUL32rm] = translate_IMUL32rm<addr_width>;
+  m[llvm::X86::IMUL64rm] = translate_IMUL64rm<addr_width>;
+  m[llvm::X86::IMUL16rm] = translate_IMUL16rm<addr_width>;
+  m[llvm::X86::IMUL8r] = translate_IMUL8r<addr_width>;
+  m[llvm::X86::IMUL8m] = translate_IMUL8m<addr_width>;
+  m[llvm::X86::IMUL16r] = translate_IMUL16r<addr_width>;
+  m[llvm::X86::IMUL16m] = translate_IMUL16m<addr_width>;
+  m[llvm::X86::MUL32r] = translate_MUL32r<addr_width>;
+  m[llvm::X86::MUL64r] = translate_MUL64r<addr_width>;
+  m[llvm::X86::MUL32m] = translate_MUL32m<addr_width>;
+  m[llvm::X86::MUL64m] = translate_MUL64m<addr_width>;
+  m[llvm::X86::MUL16r] = translate_MUL16r<addr_width>;
+  m[llvm::X86::MUL16m] = translate_MUL16m<addr_width>;
+  m[llvm::X86::MUL8r] = translate_MUL8r<addr_width>;
+  m[llvm::X86::MUL8m] = translate_MUL8m<addr_width>;
+  m[llvm::X86::IMUL32r] = translate_IMUL32r<addr_width>;
+  m[llvm::X86::IMUL32m] = translate_IMUL32m<addr_width>;
+  m[llvm::X86::IMUL64m] = translate_IMUL64m<addr_width>;
+  m[llvm::X86::IMUL32rr] = translate_IMUL32rr<addr_width>;
+  m[llvm::X86::IMUL16rr] = translate_IMUL16rr<addr_width>;
+  m[llvm::X86::IMUL16rmi] = translate_IMUL16rmi<addr_width>;
+  m[llvm::X86::IMUL16rmi8] = translate_IMUL16rmi8<addr_width>;
+  m[llvm::X86::IMUL16rri] = translate_IMUL16rri<addr_width>;
+  m[llvm::X86::IMUL16rri8] = translate_IMUL16rri8<addr_width>;
+  m[llvm::X86::IMUL32rmi] = translate_IMUL32rmi<addr_width>;
+  m[llvm::X86::IMUL32rmi8] = translate_IMUL32rmi8<addr_width>;
+  m[llvm::X86::IMUL64rmi8] = translate_IMUL64rmi8<addr_width>;
+  m[llvm::X86::IMUL32rri] = translate_IMUL32rri<addr_width>;
+  m[llvm::X86::IMUL32rri8] = translate_IMUL32rri8<addr_width>;
+  m[llvm::X86::IMUL64rri8] = translate_IMUL64rri8<addr_width>;
+  m[llvm::X86::IMUL64rri32] = translate_IMUL64rri32<addr_width>;
+  m[llvm::X86::IMUL64rmi32] = translate_IMUL64rmi32<addr_width>;
+  m[llvm::X86::IMUL64rr] = translate_IMUL64rr<addr_width>;
+  m[llvm::X86::IMUL64r] = translate_IMUL64r<addr_width>;
+
+  m[llvm::X86::IDIV8r] = translate_IDIV8r<addr_width>;
+  m[llvm::X86::IDIV16r] = translate_IDIV16r<addr_width>;
+  m[llvm::X86::IDIV32r] = translate_IDIV32r<addr_width>;
+  m[llvm::X86::IDIV64r] = translate_IDIV64r<addr_width>;
+  m[llvm::X86::IDIV8m] = translate_IDIV8m<addr_width>;
+  m[llvm::X86::IDIV16m] = translate_IDIV16m<addr_width>;
+  m[llvm::X86::IDIV32m] = translate_IDIV32m<addr_width>;
+  m[llvm::X86::IDIV64m] = translate_IDIV64m<addr_width>;
+  m[llvm::X86::DIV8r] = translate_DIV8r<addr_width>;
+  m[llvm::X86::DIV16r] = translate_DIV16r<addr_width>;
+  m[llvm::X86::DIV32r] = translate_DIV32r<addr_width>;
+  m[llvm::X86::DIV64r] = translate_DIV64r<addr_width>;
+  m[llvm::X86::DIV8m] = translate_DIV8m<addr_width>;
+  m[llvm::X86::DIV16m] = translate_DIV16m<addr_width>;
+  m[llvm::X86::DIV32m] = translate_DIV32m<addr_width>;
+  m[llvm::X86::DIV64m] = translate_DIV64m<addr_width>;
 }
+
+template void MULDIV_populateDispatchMap<32>(DispatchMap &m);
+template void MULDIV_populateDispatchMap<64>(DispatchMap &m);
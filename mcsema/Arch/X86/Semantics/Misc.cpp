@@ -31,11 +31,13 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <llvm/IR/Argument.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/InlineAsm.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Intrinsics.h>
@@ -86,7 +88,150 @@ static InstTransResult doTrap(llvm::BasicBlock *b) {
   return ContinueBlock;
 }
 
-static InstTransResult doInt(llvm::BasicBlock *&b, const llvm::MCOperand &o) {
+// How many arguments the common Linux system calls take. The other system
+// calls are given all of the argument registers.
+static const std::unordered_map<int, unsigned> kNumSyscallArgs64 = {
+  {0, 3} /* read */, {1, 3} /* write */, {2, 3} /* open */,
+  {3, 1} /* close */, {4, 2} /* stat */, {5, 2} /* fstat */,
+  {6, 2} /* lstat */, {7, 3} /* poll */, {8, 3} /* lseek */,
+  {9, 6} /* mmap */, {10, 3} /* mprotect */, {11, 2} /* munmap */,
+  {12, 1} /* brk */, {13, 4} /* rt_sigaction */,
+  {14, 4} /* rt_sigprocmask */, {16, 3} /* ioctl */, {17, 4} /* pread64 */,
+  {18, 4} /* pwrite64 */, {19, 3} /* readv */, {20, 3} /* writev */,
+  {21, 2} /* access */, {22, 1} /* pipe */, {23, 5} /* select */,
+  {24, 0} /* sched_yield */, {25, 5} /* mremap */, {26, 3} /* msync */,
+  {27, 3} /* mincore */, {28, 3} /* madvise */, {32, 1} /* dup */,
+  {33, 2} /* dup2 */, {34, 0} /* pause */, {35, 2} /* nanosleep */,
+  {39, 0} /* getpid */, {41, 3} /* socket */, {42, 3} /* connect */,
+  {43, 3} /* accept */, {44, 6} /* sendto */, {45, 6} /* recvfrom */,
+  {46, 3} /* sendmsg */, {47, 3} /* recvmsg */, {48, 2} /* shutdown */,
+  {49, 3} /* bind */, {50, 2} /* listen */, {51, 3} /* getsockname */,
+  {52, 3} /* getpeername */, {53, 4} /* socketpair */,
+  {54, 5} /* setsockopt */, {55, 5} /* getsockopt */, {57, 0} /* fork */,
+  {59, 3} /* execve */, {60, 1} /* exit */, {61, 4} /* wait4 */,
+  {62, 2} /* kill */, {63, 1} /* uname */, {72, 3} /* fcntl */,
+  {74, 1} /* fsync */, {77, 2} /* ftruncate */, {78, 3} /* getdents */,
+  {79, 2} /* getcwd */, {80, 1} /* chdir */, {82, 2} /* rename */,
+  {83, 2} /* mkdir */, {84, 1} /* rmdir */, {87, 1} /* unlink */,
+  {89, 3} /* readlink */, {96, 2} /* gettimeofday */, {102, 0} /* getuid */,
+  {104, 0} /* getgid */, {107, 0} /* geteuid */, {108, 0} /* getegid */,
+  {110, 0} /* getppid */, {186, 0} /* gettid */, {201, 1} /* time */,
+  {202, 6} /* futex */, {228, 2} /* clock_gettime */,
+  {231, 1} /* exit_group */, {232, 4} /* epoll_wait */,
+  {233, 4} /* epoll_ctl */, {257, 4} /* openat */, {262, 4} /* newfstatat */,
+  {288, 4} /* accept4 */, {291, 1} /* epoll_create1 */, {293, 2} /* pipe2 */,
+  {318, 3} /* getrandom */,
+};
+
+static const std::unordered_map<int, unsigned> kNumSyscallArgs32 = {
+  {1, 1} /* exit */, {2, 0} /* fork */, {3, 3} /* read */,
+  {4, 3} /* write */, {5, 3} /* open */, {6, 1} /* close */,
+  {7, 3} /* waitpid */, {10, 1} /* unlink */, {11, 3} /* execve */,
+  {12, 1} /* chdir */, {13, 1} /* time */, {19, 3} /* lseek */,
+  {20, 0} /* getpid */, {37, 2} /* kill */, {39, 2} /* mkdir */,
+  {40, 1} /* rmdir */, {41, 1} /* dup */, {42, 1} /* pipe */,
+  {45, 1} /* brk */, {54, 3} /* ioctl */, {63, 2} /* dup2 */,
+  {64, 0} /* getppid */, {78, 2} /* gettimeofday */, {85, 3} /* readlink */,
+  {90, 1} /* mmap */, {91, 2} /* munmap */, {102, 2} /* socketcall */,
+  {114, 4} /* wait4 */, {122, 1} /* uname */, {125, 3} /* mprotect */,
+  {140, 5} /* _llseek */, {141, 3} /* getdents */, {142, 5} /* _newselect */,
+  {145, 3} /* readv */, {146, 3} /* writev */, {162, 2} /* nanosleep */,
+  {168, 3} /* poll */, {174, 4} /* rt_sigaction */,
+  {175, 4} /* rt_sigprocmask */, {180, 5} /* pread64 */,
+  {181, 5} /* pwrite64 */, {183, 2} /* getcwd */, {192, 6} /* mmap2 */,
+  {195, 2} /* stat64 */, {196, 2} /* lstat64 */, {197, 2} /* fstat64 */,
+  {199, 0} /* getuid32 */, {224, 0} /* gettid */, {240, 6} /* futex */,
+  {252, 1} /* exit_group */, {265, 2} /* clock_gettime */,
+  {295, 4} /* openat */,
+};
+
+// How a Linux system call instruction passes its number, arguments, and
+// result, and which other registers it clobbers.
+struct SyscallABI {
+  const char *insn;
+  MCSemaRegs num_reg;
+  const char *num_name;
+  MCSemaRegs arg_regs[6];
+  const char *arg_names[6];
+  const char *clobbers;
+};
+
+static const SyscallABI kSyscall64 = {
+  "syscall", llvm::X86::RAX, "rax",
+  {llvm::X86::RDI, llvm::X86::RSI, llvm::X86::RDX, llvm::X86::R10,
+   llvm::X86::R8, llvm::X86::R9},
+  {"rdi", "rsi", "rdx", "r10", "r8", "r9"},
+  "~{rcx},~{r11},"
+};
+
+static const SyscallABI kInt80 = {
+  "int $$0x80", llvm::X86::EAX, "eax",
+  {llvm::X86::EBX, llvm::X86::ECX, llvm::X86::EDX, llvm::X86::ESI,
+   llvm::X86::EDI, llvm::X86::EBP},
+  {"ebx", "ecx", "edx", "esi", "edi", "ebp"},
+  ""
+};
+
+template<int addr_width>
+static unsigned NumSyscallArgs(NativeInstPtr ip) {
+  if (!ip->has_system_call_number()) {
+    return 6;
+  }
+  const auto &num_args = 64 == addr_width ? kNumSyscallArgs64
+                                          : kNumSyscallArgs32;
+  auto it = num_args.find(ip->get_system_call_number());
+  return it == num_args.end() ? 6 : it->second;
+}
+
+// Lower a system call to the same instruction in inline assembly, which only
+// binds the argument registers that the system call reads. A system call
+// number from the CFG is used as a constant.
+template<int width>
+static void doInlineSyscall(NativeInstPtr ip, llvm::BasicBlock *b,
+                            const SyscallABI &abi, unsigned num_args) {
+  auto ty = llvm::Type::getIntNTy(b->getContext(), width);
+  std::vector<llvm::Value *> args;
+  if (ip->has_system_call_number()) {
+    args.push_back(CONST_V<width>(b, ip->get_system_call_number()));
+  } else {
+    args.push_back(R_READ<width>(b, abi.num_reg));
+  }
+
+  std::stringstream constraints;
+  constraints << "={" << abi.num_name << "},{" << abi.num_name << "}";
+  for (unsigned i = 0; i < num_args; ++i) {
+    args.push_back(R_READ<width>(b, abi.arg_regs[i]));
+    constraints << ",{" << abi.arg_names[i] << "}";
+  }
+  constraints << "," << abi.clobbers << "~{memory},~{dirflag},~{fpsr},"
+              << "~{flags}";
+
+  std::vector<llvm::Type *> arg_tys(args.size(), ty);
+  auto asm_ty = llvm::FunctionType::get(ty, arg_tys, false);
+  auto syscall = llvm::InlineAsm::get(asm_ty, abi.insn, constraints.str(),
+                                      true /* hasSideEffects */);
+  auto ret = llvm::CallInst::Create(syscall, args, "", b);
+  R_WRITE<width>(b, abi.num_reg, ret);
+}
+
+template<int addr_width>
+static InstTransResult doSyscall(NativeInstPtr ip, llvm::BasicBlock *&b) {
+  auto M = b->getParent()->getParent();
+  TASSERT(llvm::Triple::Linux == SystemOS(M) && 64 == addr_width,
+          "syscall is only supported on 64-bit Linux");
+
+  doInlineSyscall<64>(ip, b, kSyscall64, NumSyscallArgs<64>(ip));
+
+  // The kernel returns through RCX. It also saves RFLAGS into R11, which
+  // isn't modeled.
+  R_WRITE<64>(b, llvm::X86::RCX,
+              CONST_V<64>(b, ip->get_loc() + ip->get_len()));
+  return ContinueBlock;
+}
+
+template<int addr_width>
+static InstTransResult doInt(NativeInstPtr ip, llvm::BasicBlock *&b,
+                             const llvm::MCOperand &o) {
   TASSERT(o.isImm(), "Operand not immediate");
   auto F = b->getParent();
   auto M = F->getParent();
@@ -99,8 +244,17 @@ static InstTransResult doInt(llvm::BasicBlock *&b, const llvm::MCOperand &o) {
   }
 
   if (0x80 == interrupt_val && llvm::Triple::Linux == os) {
-    TASSERT(32 == ArchAddressSize(),
+    TASSERT(32 == addr_width,
             "int 0x80 syscall not supported on 64-bit.");
+
+    // Binding EBP in inline assembly can run out of registers, so system
+    // calls with six arguments go through libc.
+    auto num_args = NumSyscallArgs<32>(ip);
+    if (ip->has_system_call_number() && 6 > num_args) {
+      doInlineSyscall<32>(ip, b, kInt80, num_args);
+      return ContinueBlock;
+    }
+
     llvm::Type *arg_tys[] = {llvm::Type::getInt32Ty(C)};
     auto syscall_func_ty = llvm::FunctionType::get(
         llvm::Type::getInt32Ty(C), arg_tys, true /* IsVarArg */);
@@ -870,7 +1024,8 @@ static InstTransResult doBsfr(llvm::BasicBlock *&b, const llvm::MCOperand &dst,
 
 GENERIC_TRANSLATION(CDQ, doCdq(block))
 GENERIC_TRANSLATION(INT3, doInt3(block))
-GENERIC_TRANSLATION(INT, doInt(block, OP(0)))
+GENERIC_TRANSLATION(INT, doInt<addr_width>(ip, block, OP(0)))
+GENERIC_TRANSLATION(SYSCALL, doSyscall<addr_width>(ip, block))
 GENERIC_TRANSLATION(TRAP, doTrap(block))
 GENERIC_TRANSLATION(NOOP, doNoop(block))
 GENERIC_TRANSLATION(HLT, doHlt(block))
@@ -886,7 +1041,7 @@ GENERIC_TRANSLATION(CLC, doClc(block))
 GENERIC_TRANSLATION_REF(LEA16r, doLea<16>(ip, block, ADDR_NOREF(1), OP(0)),
                         doLea<16>(ip, block, MEM_REFERENCE(1), OP(0)))
 
-template<int width>
+template <int addr_width, int width>
 static InstTransResult doLeaRef(TranslationContext &ctx,
                                 llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -924,17 +1079,17 @@ static InstTransResult doLeaRef(TranslationContext &ctx,
 
 static InstTransResult translate_LEA32r(TranslationContext &ctx,
                                         llvm::BasicBlock *&block) {
-  return doLeaRef<32>(ctx, block);
+  return doLeaRef<addr_width, 32>(ctx, block);
 }
 
 static InstTransResult translate_LEA64r(TranslationContext &ctx,
                                         llvm::BasicBlock *&block) {
-  return doLeaRef<64>(ctx, block);
+  return doLeaRef<addr_width, 64>(ctx, block);
 }
 
 static InstTransResult translate_LEA64_32r(TranslationContext &ctx,
                                            llvm::BasicBlock *&block) {
-  return doLeaRef<32>(ctx, block);
+  return doLeaRef<addr_width, 32>(ctx, block);
 }
 
 static InstTransResult translate_CPUID32(TranslationContext &ctx,
@@ -1141,65 +1296,70 @@ GENERIC_TRANSLATION_REF(BSF32rm, (doBsfrm<32>(ip, block, OP(0), ADDR_NOREF(1))),
                         (doBsfrm<32>(ip, block, OP(0), MEM_REFERENCE(1))))
 GENERIC_TRANSLATION(BSF16rr, doBsfr<16>(block, OP(0), OP(1)))
 
+template <int addr_width>
 void Misc_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::AAA] = translate_AAA;
-  m[llvm::X86::AAS] = translate_AAS;
-  m[llvm::X86::AAM8i8] = translate_AAM8i8;
-  m[llvm::X86::AAD8i8] = translate_AAD8i8;
-  m[llvm::X86::LEA16r] = translate_LEA16r;
+  m[llvm::X86::AAA] = translate_AAA<addr_width>;
+  m[llvm::X86::AAS] = translate_AAS<addr_width>;
+  m[llvm::X86::AAM8i8] = translate_AAM8i8<addr_width>;
+  m[llvm::X86::AAD8i8] = translate_AAD8i8<addr_width>;
+  m[llvm::X86::LEA16r] = translate_LEA16r<addr_width>;
   m[llvm::X86::LEA32r] = translate_LEA32r;
   m[llvm::X86::LEA64_32r] = translate_LEA64_32r;
   m[llvm::X86::LEA64r] = translate_LEA64r;
-  m[llvm::X86::LAHF] = translate_LAHF;
-  m[llvm::X86::STD] = translate_STD;
-  m[llvm::X86::CLD] = translate_CLD;
-  m[llvm::X86::STC] = translate_STC;
-  m[llvm::X86::CLC] = translate_CLC;
-  m[llvm::X86::BSWAP32r] = translate_BSWAP32r;
-  m[llvm::X86::CDQ] = translate_CDQ;
-  m[llvm::X86::INT3] = translate_INT3;
-  m[llvm::X86::INT] = translate_INT;
-  m[llvm::X86::MFENCE] = translate_NOOP;
-  m[llvm::X86::NOOP] = translate_NOOP;
-  m[llvm::X86::NOOPW] = translate_NOOP;
-  m[llvm::X86::NOOPL] = translate_NOOP;
-  m[llvm::X86::HLT] = translate_HLT;
-  m[llvm::X86::LOCK_PREFIX] = translate_NOOP;
-  m[llvm::X86::REP_PREFIX] = translate_NOOP;
-  m[llvm::X86::REPNE_PREFIX] = translate_NOOP;
-  m[llvm::X86::PAUSE] = translate_NOOP;
-  m[llvm::X86::RDTSC] = translate_RDTSC;
-  m[llvm::X86::CWD] = translate_CWD;
-  m[llvm::X86::CWDE] = translate_CWDE;
-  m[llvm::X86::CQO] = translate_CQO;
-  m[llvm::X86::CDQ] = translate_CDQ;
+  m[llvm::X86::LAHF] = translate_LAHF<addr_width>;
+  m[llvm::X86::STD] = translate_STD<addr_width>;
+  m[llvm::X86::CLD] = translate_CLD<addr_width>;
+  m[llvm::X86::STC] = translate_STC<addr_width>;
+  m[llvm::X86::CLC] = translate_CLC<addr_width>;
+  m[llvm::X86::BSWAP32r] = translate_BSWAP32r<addr_width>;
+  m[llvm::X86::CDQ] = translate_CDQ<addr_width>;
+  m[llvm::X86::INT3] = translate_INT3<addr_width>;
+  m[llvm::X86::INT] = translate_INT<addr_width>;
+  m[llvm::X86::SYSCALL] = translate_SYSCALL<addr_width>;
+  m[llvm::X86::MFENCE] = translate_NOOP<addr_width>;
+  m[llvm::X86::NOOP] = translate_NOOP<addr_width>;
+  m[llvm::X86::NOOPW] = translate_NOOP<addr_width>;
+  m[llvm::X86::NOOPL] = translate_NOOP<addr_width>;
+  m[llvm::X86::HLT] = translate_HLT<addr_width>;
+  m[llvm::X86::LOCK_PREFIX] = translate_NOOP<addr_width>;
+  m[llvm::X86::REP_PREFIX] = translate_NOOP<addr_width>;
+  m[llvm::X86::REPNE_PREFIX] = translate_NOOP<addr_width>;
+  m[llvm::X86::PAUSE] = translate_NOOP<addr_width>;
+  m[llvm::X86::RDTSC] = translate_RDTSC<addr_width>;
+  m[llvm::X86::CWD] = translate_CWD<addr_width>;
+  m[llvm::X86::CWDE] = translate_CWDE<addr_width>;
+  m[llvm::X86::CQO] = translate_CQO<addr_width>;
+  m[llvm::X86::CDQ] = translate_CDQ<addr_width>;
   m[llvm::X86::SAHF] = translate_SAHF;
-  m[llvm::X86::BT64rr] = translate_BT64rr;
-  m[llvm::X86::BT32rr] = translate_BT32rr;
-  m[llvm::X86::BT16rr] = translate_BT16rr;
-  m[llvm::X86::BT64ri8] = translate_BT64ri8;
-  m[llvm::X86::BT32ri8] = translate_BT32ri8;
-  m[llvm::X86::BT16ri8] = translate_BT16ri8;
-  m[llvm::X86::BT64mi8] = translate_BT64mi8;
-  m[llvm::X86::BT32mr] = translate_BT32mr;
-  m[llvm::X86::BT64mr] = translate_BT64mr;
-  m[llvm::X86::BTS32mr] = translate_BTS32mr;
-  m[llvm::X86::BTS64mr] = translate_BTS64mr;
-  m[llvm::X86::BTS64mi8] = translate_BTS64mi8;
-  m[llvm::X86::BTS64ri8] = translate_BTS64ri8;
-  m[llvm::X86::BTR64mi8] = translate_BTR64mi8;
-  m[llvm::X86::BTR32mr] = translate_BTR32mr;
-  m[llvm::X86::BTR64mr] = translate_BTR64mr;
-  m[llvm::X86::BT32mi8] = translate_BT32mi8;
-  m[llvm::X86::BTS32mi8] = translate_BTS32mi8;
-  m[llvm::X86::BTS32ri8] = translate_BTS32ri8;
-  m[llvm::X86::BTR32mi8] = translate_BTR32mi8;
-  m[llvm::X86::BSR64rr] = translate_BSR64rr;
-  m[llvm::X86::BSR32rr] = translate_BSR32rr;
-  m[llvm::X86::BSR16rr] = translate_BSR16rr;
-  m[llvm::X86::BSF32rr] = translate_BSF32rr;
-  m[llvm::X86::BSF32rm] = translate_BSF32rm;
-  m[llvm::X86::BSF16rr] = translate_BSF16rr;
-  m[llvm::X86::TRAP] = translate_TRAP;
+  m[llvm::X86::BT64rr] = translate_BT64rr<addr_width>;
+  m[llvm::X86::BT32rr] = translate_BT32rr<addr_width>;
+  m[llvm::X86::BT16rr] = translate_BT16rr<addr_width>;
+  m[llvm::X86::BT64ri8] = translate_BT64ri8<addr_width>;
+  m[llvm::X86::BT32ri8] = translate_BT32ri8<addr_width>;
+  m[llvm::X86::BT16ri8] = translate_BT16ri8<addr_width>;
+  m[llvm::X86::BT64mi8] = translate_BT64mi8<addr_width>;
+  m[llvm::X86::BT32mr] = translate_BT32mr<addr_width>;
+  m[llvm::X86::BT64mr] = translate_BT64mr<addr_width>;
+  m[llvm::X86::BTS32mr] = translate_BTS32mr<addr_width>;
+  m[llvm::X86::BTS64mr] = translate_BTS64mr<addr_width>;
+  m[llvm::X86::BTS64mi8] = translate_BTS64mi8<addr_width>;
+  m[llvm::X86::BTS64ri8] = translate_BTS64ri8<addr_width>;
+  m[llvm::X86::BTR64mi8] = translate_BTR64mi8<addr_width>;
+  m[llvm::X86::BTR32mr] = translate_BTR32mr<addr_width>;
+  m[llvm::X86::BTR64mr] = translate_BTR64mr<addr_width>;
+  m[llvm::X86::BT32mi8] = translate_BT32mi8<addr_width>;
+  m[llvm::X86::BTS32mi8] = translate_BTS32mi8<addr_width>;
+  m[llvm::X86::BTS32ri8] = translate_BTS32ri8<addr_width>;
+  m[llvm::X86::BTR32mi8] = translate_BTR32mi8<addr_width>;
+  m[llvm::X86::BSR64rr] = translate_BSR64rr<addr_width>;
+  m[llvm::X86::BSR32rr] = translate_BSR32rr<addr_width>;
+  m[llvm::X86::BSR16rr] = translate_BSR16rr<addr_width>;
+  m[llvm::X86::BSF32rr] = translate_BSF32rr<addr_width>;
+  m[llvm::X86::BSF32rm] = translate_BSF32rm<addr_width>;
+  m[llvm::X86::BSF16rr] = translate_BSF16rr<addr_width>;
+  m[llvm::X86::TRAP] = translate_TRAP<addr_width>;
   m[llvm::X86::CPUID] = translate_CPUID32;
 }
+
+template void Misc_populateDispatchMap<32>(DispatchMap &m);
+template void Misc_populateDispatchMap<64>(DispatchMap &m);
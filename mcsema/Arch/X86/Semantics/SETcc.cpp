@@ -343,33 +343,37 @@ GENERIC_TRANSLATION(SETPr, doSetpR(ip, block, OP(0)))
 GENERIC_TRANSLATION_REF(SETPm, doSetpM(ip, block, ADDR_NOREF(0)),
                         doSetpM(ip, block, MEM_REFERENCE(0)))
 
+template <int addr_width>
 void SETcc_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::SETAm] = translate_SETAm;
-  m[llvm::X86::SETAr] = translate_SETAr;
-  m[llvm::X86::SETBm] = translate_SETBm;
-  m[llvm::X86::SETBr] = translate_SETBr;
-  m[llvm::X86::SETNEr] = translate_SETNEr;
-  m[llvm::X86::SETNEm] = translate_SETNEm;
-  m[llvm::X86::SETEr] = translate_SETEr;
-  m[llvm::X86::SETEm] = translate_SETEm;
-  m[llvm::X86::SETGEr] = translate_SETGEr;
-  m[llvm::X86::SETGEm] = translate_SETGEm;
-  m[llvm::X86::SETLr] = translate_SETLr;
-  m[llvm::X86::SETLm] = translate_SETLm;
-  m[llvm::X86::SETLEr] = translate_SETLEr;
-  m[llvm::X86::SETLEm] = translate_SETLEm;
-  m[llvm::X86::SETGr] = translate_SETGr;
-  m[llvm::X86::SETGm] = translate_SETGm;
-  m[llvm::X86::SETSr] = translate_SETSr;
-  m[llvm::X86::SETSm] = translate_SETSm;
-  m[llvm::X86::SETAEr] = translate_SETAEr;
-  m[llvm::X86::SETAEm] = translate_SETAEm;
-  m[llvm::X86::SETBEr] = translate_SETBEr;
-  m[llvm::X86::SETBEm] = translate_SETBEm;
-  m[llvm::X86::SETNPr] = translate_SETNPr;
-  m[llvm::X86::SETNPm] = translate_SETNPm;
-  m[llvm::X86::SETPr] = translate_SETPr;
-  m[llvm::X86::SETPm] = translate_SETPm;
-  m[llvm::X86::SETNSr] = translate_SETNSr;
-  m[llvm::X86::SETNSm] = translate_SETNSm;
+  m[llvm::X86::SETAm] = translate_SETAm<addr_width>;
+  m[llvm::X86::SETAr] = translate_SETAr<addr_width>;
+  m[llvm::X86::SETBm] = translate_SETBm<addr_width>;
+  m[llvm::X86::SETBr] = translate_SETBr<addr_width>;
+  m[llvm::X86::SETNEr] = translate_SETNEr<addr_width>;
+  m[llvm::X86::SETNEm] = translate_SETNEm<addr_width>;
+  m[llvm::X86::SETEr] = translate_SETEr<addr_width>;
+  m[llvm::X86::SETEm] = translate_SETEm<addr_width>;
+  m[llvm::X86::SETGEr] = translate_SETGEr<addr_width>;
+  m[llvm::X86::SETGEm] = translate_SETGEm<addr_width>;
+  m[llvm::X86::SETLr] = translate_SETLr<addr_width>;
+  m[llvm::X86::SETLm] = translate_SETLm<addr_width>;
+  m[llvm::X86::SETLEr] = translate_SETLEr<addr_width>;
+  m[llvm::X86::SETLEm] = translate_SETLEm<addr_width>;
+  m[llvm::X86::SETGr] = translate_SETGr<addr_width>;
+  m[llvm::X86::SETGm] = translate_SETGm<addr_width>;
+  m[llvm::X86::SETSr] = translate_SETSr<addr_width>;
+  m[llvm::X86::SETSm] = translate_SETSm<addr_width>;
+  m[llvm::X86::SETAEr] = translate_SETAEr<addr_width>;
+  m[llvm::X86::SETAEm] = translate_SETAEm<addr_width>;
+  m[llvm::X86::SETBEr] = translate_SETBEr<addr_width>;
+  m[llvm::X86::SETBEm] = translate_SETBEm<addr_width>;
+  m[llvm::X86::SETNPr] = translate_SETNPr<addr_width>;
+  m[llvm::X86::SETNPm] = translate_SETNPm<addr_width>;
+  m[llvm::X86::SETPr] = translate_SETPr<addr_width>;
+  m[llvm::X86::SETPm] = translate_SETPm<addr_width>;
+  m[llvm::X86::SETNSr] = translate_SETNSr<addr_width>;
+  m[llvm::X86::SETNSm] = translate_SETNSm<addr_width>;
 }
+
+template void SETcc_populateDispatchMap<32>(DispatchMap &m);
+template void SETcc_populateDispatchMap<64>(DispatchMap &m);
@@ -185,7 +185,7 @@ static InstTransResult MOVAndZextRM(NativeInstPtr ip, llvm::BasicBlock *& block,
   return MOVAndZextRV<width>(block, dst, src_val);
 }
 
-template<int width>
+template <int addr_width, int width>
 static InstTransResult doMOVSrm(TranslationContext &ctx,
                                 llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -205,7 +205,7 @@ static InstTransResult doMOVSrm(TranslationContext &ctx,
     ret = doRMMov<width>(ip, block, addrInt, OP(0));
     return ContinueBlock;
   } else if (ip->has_mem_reference) {
-    ret = doRMMov<width>(ip, block, MEM_AS_DATA_REF(block, natM, inst, ip, 1),
+    ret = doRMMov<width>(ip, block, MEM_REFERENCE(1),
                          OP(0));
   } else {
     ret = doRMMov<width>(ip, block, ADDR_NOREF(1), OP(0));
@@ -214,7 +214,7 @@ static InstTransResult doMOVSrm(TranslationContext &ctx,
 
 }
 
-template<int width>
+template <int addr_width, int width>
 static InstTransResult doMOVSmr(TranslationContext &ctx,
                                 llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -227,7 +227,7 @@ static InstTransResult doMOVSmr(TranslationContext &ctx,
     TASSERT(addrInt != nullptr, "Could not get address for external");
     return doMRMov<width>(ip, block, addrInt, OP(5));
   } else if (ip->has_mem_reference) {
-    ret = doMRMov<width>(ip, block, MEM_AS_DATA_REF(block, natM, inst, ip, 0),
+    ret = doMRMov<width>(ip, block, MEM_REFERENCE(0),
                          OP(5));
   } else {
     ret = doMRMov<width>(ip, block, ADDR_NOREF(0), OP(5));
@@ -309,7 +309,7 @@ static InstTransResult translate_CVTSI2SDrr(TranslationContext &ctx,
   return doCVTSI2SrV<64>(natM, block, ip, inst, rval, dst);
 }
 
-template<int width>
+template <int addr_width, int width>
 static InstTransResult translate_CVTSI2SDrm(TranslationContext &ctx,
                                             llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -357,6 +357,7 @@ static InstTransResult doCVTSD2SSrV(NativeModulePtr natM,
 
 // read 64-bits from memory, convert to single precision fpu value, 
 // write the 32-bit value into register dst
+template <int addr_width>
 static InstTransResult translate_CVTSD2SSrm(TranslationContext &ctx,
                                             llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -419,6 +420,7 @@ static InstTransResult doCVTSS2SDrV(NativeModulePtr natM,
 // Convert Scalar Single-Precision FP llvm::Value to Scalar Double-Precision FP llvm::Value
 // read 32-bits from memory, convert to double precision fpu value,
 // write the 64-bit value into register dst
+template <int addr_width>
 static InstTransResult translate_CVTSS2SDrm(TranslationContext &ctx,
                                             llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -454,11 +456,32 @@ static InstTransResult translate_CVTSS2SDrr(TranslationContext &ctx,
   return doCVTSS2SDrV<64>(natM, block, ip, inst, rval, dst);
 }
 
+// Full XMM bitwise operations are done on `<16 x i8>` vectors. As `i128`
+// operations, they get legalized into pairs of 64-bit GPR operations.
+template<int width>
+static llvm::Value *INT_AS_BITWISE_VECTOR(llvm::BasicBlock *b,
+                                          llvm::Value *input) {
+  if (128 != width) {
+    return input;
+  }
+  return INT_AS_VECTOR<width, 8>(b, input);
+}
+
 template<int width, llvm::Instruction::BinaryOps bin_op>
 static InstTransResult do_SSE_INT_VV(unsigned reg, llvm::BasicBlock *& block,
-                                     llvm::Value *o1, llvm::Value *o2) {
-  llvm::Value *xoredVal = llvm::BinaryOperator::Create(bin_op, o1, o2, "",
+                                     llvm::Value *o1, llvm::Value *o2,
+                                     bool invert_o1 = false) {
+  llvm::Value *vec1 = INT_AS_BITWISE_VECTOR<width>(block, o1);
+  llvm::Value *vec2 = INT_AS_BITWISE_VECTOR<width>(block, o2);
+  if (invert_o1) {
+    vec1 = llvm::BinaryOperator::CreateNot(vec1, "", block);
+  }
+
+  llvm::Value *xoredVal = llvm::BinaryOperator::Create(bin_op, vec1, vec2, "",
                                                        block);
+  if (xoredVal->getType()->isVectorTy()) {
+    xoredVal = VECTOR_AS_INT<width>(block, xoredVal);
+  }
   R_WRITE<width>(block, reg, xoredVal);
 
   return ContinueBlock;
@@ -509,6 +532,7 @@ static InstTransResult translate_CVTSI2SSrr(TranslationContext &ctx,
 }
 
 // convert signed integer (memory) to single precision float (xmm register)
+template <int addr_width>
 static InstTransResult translate_CVTSI2SSrm(TranslationContext &ctx,
                                             llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -543,6 +567,7 @@ static InstTransResult translate_CVTSI2SS64rr(TranslationContext &ctx,
 }
 
 // convert signed integer (memory) to single precision float (xmm register)
+template <int addr_width>
 static InstTransResult translate_CVTSI2SS64rm(TranslationContext &ctx,
                                               llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -577,7 +602,7 @@ static InstTransResult doCVTTS2SIrV(NativeModulePtr natM,
 }
 
 // convert w/ truncation scalar single-precision fp value to dword integer
-template<int fpwidth, int regwidth>
+template <int addr_width, int fpwidth, int regwidth>
 static InstTransResult doCVTT_to_SI_rm(TranslationContext &ctx,
                                        llvm::BasicBlock *&block) {
   auto natM = ctx.natM;
@@ -914,10 +939,12 @@ static llvm::Value* doDoubleShuffle(llvm::BasicBlock *&b, llvm::Value *input1,
   llvm::Type *elem_ty = nullptr;
   llvm::VectorType *vt = nullptr;
 
-  std::tie(vt, elem_ty) = getIntVectorTypes(b, elemwidth, elem_count);
+  std::tie(vt, elem_ty) = getFPVectorTypes(b, elemwidth, elem_count);
 
-  llvm::Value *vecInput1 = INT_AS_VECTOR<width, elemwidth>(b, input1);
-  llvm::Value *vecInput2 = INT_AS_VECTOR<width, elemwidth>(b, input2);
+  // SHUFPS and SHUFPD shuffle `<4 x float>` and `<2 x double>` vectors, so
+  // that the backend keeps the result in the floating point domain.
+  llvm::Value *vecInput1 = INT_AS_FPVECTOR<width, elemwidth>(b, input1);
+  llvm::Value *vecInput2 = INT_AS_FPVECTOR<width, elemwidth>(b, input2);
 
   llvm::Value *vecShuffle;
   if (32 == elemwidth) {
@@ -1002,54 +1029,14 @@ static llvm::Value* doBlendVV(llvm::BasicBlock *&b, llvm::Value *input1,
 
   llvm::Value *vecOrder = INT_AS_VECTOR<width, elemwidth>(b, order);
 
-  llvm::Value *resultAlloc = new llvm::AllocaInst(vt, nullptr, "", b);
-  llvm::Value *vecResult = noAliasMCSemaScope(
-      new llvm::LoadInst(resultAlloc, "", b));
+  // elements whose high bit is set in the order come from the second input,
+  // the rest keep the one from the first input
+  llvm::Value *highBitSet = new llvm::ICmpInst(
+      *b, llvm::CmpInst::ICMP_SLT, vecOrder,
+      llvm::Constant::getNullValue(vt));
 
-  for (int i = 0; i < elem_count; i++) {
-    // get input value
-    llvm::Value *toTest = llvm::ExtractElementInst::Create(vecOrder,
-                                                           CONST_V<32>(b, i),
-                                                           "", b);
-
-    // check if high bit is set
-    llvm::Value *highBitSet = llvm::BinaryOperator::CreateAnd(
-        toTest, CONST_V<elemwidth>(b, 1 << (elemwidth - 1)), "", b);
-
-    int mask = 0xF;
-    switch (width) {
-      case 128:
-        mask = 0xF;
-        break;
-      case 64:
-        mask = 0x7;
-        break;
-      default:
-        TASSERT(false, "UNSUPPORTED BIT WIDTH FOR BLEND")
-        ;
-    }
-
-    llvm::Value *origPiece = llvm::ExtractElementInst::Create(vecInput1,
-                                                              CONST_V<32>(b, i),
-                                                              "", b);
-    llvm::Value *newPiece = llvm::ExtractElementInst::Create(vecInput2,
-                                                             CONST_V<32>(b, i),
-                                                             "", b);
-
-    // check if high bit was not set
-    llvm::Value *isZero = new llvm::ICmpInst( *b, llvm::CmpInst::ICMP_EQ,
-                                             highBitSet,
-                                             CONST_V<elemwidth>(b, 0));
-
-    // pick either other byte position, or zero
-    llvm::Value *whichValue = llvm::SelectInst::Create(isZero,  // if highBit is zero (aka not set), we keep old piece
-        origPiece,  // use dst version
-        newPiece,  // use src version (high bit is 1)
-        "", b);
-
-    vecResult = llvm::InsertElementInst::Create(vecResult, whichValue,
-                                                CONST_V<32>(b, i), "", b);
-  }
+  llvm::Value *vecResult = llvm::SelectInst::Create(highBitSet, vecInput2,
+                                                    vecInput1, "", b);
 
   // convert the output back to an integer
   llvm::Value *intOutput = llvm::CastInst::Create(
@@ -1739,11 +1726,10 @@ static InstTransResult do_PANDNrr(NativeInstPtr ip, llvm::BasicBlock *& block,
   NASSERT(o2.isReg());
 
   llvm::Value *opVal1 = R_READ<width>(block, o1.getReg());
-  llvm::Value *notVal1 = llvm::BinaryOperator::CreateNot(opVal1, "", block);
   llvm::Value *opVal2 = R_READ<width>(block, o2.getReg());
 
   return do_SSE_INT_VV<width, llvm::Instruction::And>(o1.getReg(), block,
-                                                      notVal1, opVal2);
+                                                      opVal1, opVal2, true);
 }
 
 template<int width>
@@ -1753,11 +1739,10 @@ static InstTransResult do_PANDNrm(NativeInstPtr ip, llvm::BasicBlock *& block,
   NASSERT(o1.isReg());
 
   llvm::Value *opVal1 = R_READ<width>(block, o1.getReg());
-  llvm::Value *notVal1 = llvm::BinaryOperator::CreateNot(opVal1, "", block);
   llvm::Value *opVal2 = M_READ<width>(ip, block, addr);
 
   return do_SSE_INT_VV<width, llvm::Instruction::And>(o1.getReg(), block,
-                                                      notVal1, opVal2);
+                                                      opVal1, opVal2, true);
 }
 
 enum ExtendOp {
@@ -3280,363 +3265,367 @@ GENERIC_TRANSLATION_REF(MOVQI2PQIrm,
                         (MOVAndZextRM<64>(ip, block, OP(0), MEM_REFERENCE(1))))
 GENERIC_TRANSLATION(MOVDDUPrr, (doMOVDDUPrr(block, OP(0), OP(1))))
 
+template <int addr_width>
 void SSE_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::MOVSDrm] = doMOVSrm<64>;
-  m[llvm::X86::MOVSDmr] = doMOVSmr<64>;
+  m[llvm::X86::MOVSDrm] = doMOVSrm<addr_width, 64>;
+  m[llvm::X86::MOVSDmr] = doMOVSmr<addr_width, 64>;
 
   m[llvm::X86::CVTSI2SDrr] = translate_CVTSI2SDrr<32>;
-  m[llvm::X86::CVTSI2SDrm] = translate_CVTSI2SDrm<32>;
+  m[llvm::X86::CVTSI2SDrm] = translate_CVTSI2SDrm<addr_width, 32>;
   m[llvm::X86::CVTSI2SD64rr] = translate_CVTSI2SDrr<64>;
-  m[llvm::X86::CVTSI2SD64rm] = translate_CVTSI2SDrm<64>;
+  m[llvm::X86::CVTSI2SD64rm] = translate_CVTSI2SDrm<addr_width, 64>;
 
-  m[llvm::X86::CVTSD2SSrm] = translate_CVTSD2SSrm;
+  m[llvm::X86::CVTSD2SSrm] = translate_CVTSD2SSrm<addr_width>;
   m[llvm::X86::CVTSD2SSrr] = translate_CVTSD2SSrr;
-  m[llvm::X86::CVTSS2SDrm] = translate_CVTSS2SDrm;
+  m[llvm::X86::CVTSS2SDrm] = translate_CVTSS2SDrm<addr_width>;
   m[llvm::X86::CVTSS2SDrr] = translate_CVTSS2SDrr;
-  m[llvm::X86::MOVSSrm] = (doMOVSrm<32> );
-  m[llvm::X86::MOVSSmr] = (doMOVSmr<32> );
-  m[llvm::X86::XORPSrr] = translate_XORPSrr;
-  m[llvm::X86::XORPSrm] = translate_XORPSrm;
+  m[llvm::X86::MOVSSrm] = (doMOVSrm<addr_width, 32> );
+  m[llvm::X86::MOVSSmr] = (doMOVSmr<addr_width, 32> );
+  m[llvm::X86::XORPSrr] = translate_XORPSrr<addr_width>;
+  m[llvm::X86::XORPSrm] = translate_XORPSrm<addr_width>;
   // XORPD = XORPS = PXOR, for the purposes of translation
   // it just operates on different bitwidth and changes internal register type
   // which is not exposed to outside world but affects performance
-  m[llvm::X86::XORPDrr] = translate_XORPSrr;
-  m[llvm::X86::XORPDrm] = translate_XORPSrm;
-  m[llvm::X86::PXORrr] = translate_XORPSrr;
-  m[llvm::X86::PXORrm] = translate_XORPSrm;
+  m[llvm::X86::XORPDrr] = translate_XORPSrr<addr_width>;
+  m[llvm::X86::XORPDrm] = translate_XORPSrm<addr_width>;
+  m[llvm::X86::PXORrr] = translate_XORPSrr<addr_width>;
+  m[llvm::X86::PXORrm] = translate_XORPSrm<addr_width>;
 
   // these should be identical
-  m[llvm::X86::ORPDrr] = translate_PORrr;
-  m[llvm::X86::ORPDrm] = translate_PORrm;
-  m[llvm::X86::ORPSrr] = translate_PORrr;
-  m[llvm::X86::ORPSrm] = translate_PORrm;
+  m[llvm::X86::ORPDrr] = translate_PORrr<addr_width>;
+  m[llvm::X86::ORPDrm] = translate_PORrm<addr_width>;
+  m[llvm::X86::ORPSrr] = translate_PORrr<addr_width>;
+  m[llvm::X86::ORPSrm] = translate_PORrm<addr_width>;
 
   m[llvm::X86::CVTSI2SSrr] = translate_CVTSI2SSrr;
-  m[llvm::X86::CVTSI2SSrm] = translate_CVTSI2SSrm;
+  m[llvm::X86::CVTSI2SSrm] = translate_CVTSI2SSrm<addr_width>;
 
   m[llvm::X86::CVTSI2SS64rr] = translate_CVTSI2SS64rr;
-  m[llvm::X86::CVTSI2SS64rm] = translate_CVTSI2SS64rm;
+  m[llvm::X86::CVTSI2SS64rm] = translate_CVTSI2SS64rm<addr_width>;
 
-  m[llvm::X86::CVTTSD2SIrm] = doCVTT_to_SI_rm<64, 32>;
+  m[llvm::X86::CVTTSD2SIrm] = doCVTT_to_SI_rm<addr_width, 64, 32>;
   m[llvm::X86::CVTTSD2SIrr] = doCVTT_to_SI_rr<64, 32>;
-  m[llvm::X86::CVTTSS2SIrm] = doCVTT_to_SI_rm<32, 32>;
+  m[llvm::X86::CVTTSS2SIrm] = doCVTT_to_SI_rm<addr_width, 32, 32>;
   m[llvm::X86::CVTTSS2SIrr] = doCVTT_to_SI_rr<32, 32>;
 
-  m[llvm::X86::CVTTSD2SI64rm] = doCVTT_to_SI_rm<64, 64>;
+  m[llvm::X86::CVTTSD2SI64rm] = doCVTT_to_SI_rm<addr_width, 64, 64>;
   m[llvm::X86::CVTTSD2SI64rr] = doCVTT_to_SI_rr<64, 64>;
-  m[llvm::X86::CVTTSS2SI64rm] = doCVTT_to_SI_rm<32, 64>;
+  m[llvm::X86::CVTTSS2SI64rm] = doCVTT_to_SI_rm<addr_width, 32, 64>;
   m[llvm::X86::CVTTSS2SI64rr] = doCVTT_to_SI_rr<32, 64>;
 
-  m[llvm::X86::ADDSDrr] = translate_ADDSDrr;
-  m[llvm::X86::ADDSDrm] = translate_ADDSDrm;
-  m[llvm::X86::ADDSSrr] = translate_ADDSSrr;
-  m[llvm::X86::ADDSSrm] = translate_ADDSSrm;
-  m[llvm::X86::SUBSDrr] = translate_SUBSDrr;
-  m[llvm::X86::SUBSDrm] = translate_SUBSDrm;
-  m[llvm::X86::SUBSSrr] = translate_SUBSSrr;
-  m[llvm::X86::SUBSSrm] = translate_SUBSSrm;
-  m[llvm::X86::DIVSDrr] = translate_DIVSDrr;
-  m[llvm::X86::DIVSDrm] = translate_DIVSDrm;
-  m[llvm::X86::DIVSSrr] = translate_DIVSSrr;
-  m[llvm::X86::DIVSSrm] = translate_DIVSSrm;
-  m[llvm::X86::MULSDrr] = translate_MULSDrr;
-  m[llvm::X86::MULSDrm] = translate_MULSDrm;
-  m[llvm::X86::MULSSrr] = translate_MULSSrr;
-  m[llvm::X86::MULSSrm] = translate_MULSSrm;
-  m[llvm::X86::PORrr] = translate_PORrr;
-  m[llvm::X86::PORrm] = translate_PORrm;
-
-  m[llvm::X86::MOVDQUrm] = doMOVSrm<128>;
-  m[llvm::X86::MOVDQUmr] = doMOVSmr<128>;
+  m[llvm::X86::ADDSDrr] = translate_ADDSDrr<addr_width>;
+  m[llvm::X86::ADDSDrm] = translate_ADDSDrm<addr_width>;
+  m[llvm::X86::ADDSSrr] = translate_ADDSSrr<addr_width>;
+  m[llvm::X86::ADDSSrm] = translate_ADDSSrm<addr_width>;
+  m[llvm::X86::SUBSDrr] = translate_SUBSDrr<addr_width>;
+  m[llvm::X86::SUBSDrm] = translate_SUBSDrm<addr_width>;
+  m[llvm::X86::SUBSSrr] = translate_SUBSSrr<addr_width>;
+  m[llvm::X86::SUBSSrm] = translate_SUBSSrm<addr_width>;
+  m[llvm::X86::DIVSDrr] = translate_DIVSDrr<addr_width>;
+  m[llvm::X86::DIVSDrm] = translate_DIVSDrm<addr_width>;
+  m[llvm::X86::DIVSSrr] = translate_DIVSSrr<addr_width>;
+  m[llvm::X86::DIVSSrm] = translate_DIVSSrm<addr_width>;
+  m[llvm::X86::MULSDrr] = translate_MULSDrr<addr_width>;
+  m[llvm::X86::MULSDrm] = translate_MULSDrm<addr_width>;
+  m[llvm::X86::MULSSrr] = translate_MULSSrr<addr_width>;
+  m[llvm::X86::MULSSrm] = translate_MULSSrm<addr_width>;
+  m[llvm::X86::PORrr] = translate_PORrr<addr_width>;
+  m[llvm::X86::PORrm] = translate_PORrm<addr_width>;
+
+  m[llvm::X86::MOVDQUrm] = doMOVSrm<addr_width, 128>;
+  m[llvm::X86::MOVDQUmr] = doMOVSmr<addr_width, 128>;
   m[llvm::X86::MOVDQUrr] = doMOVSrr<128, 0, 1>;
   m[llvm::X86::MOVDQUrr_REV] = doMOVSrr<128, 0, 1>;
 
-  m[llvm::X86::MOVDQArm] = doMOVSrm<128>;
-  m[llvm::X86::MOVDQAmr] = doMOVSmr<128>;
+  m[llvm::X86::MOVDQArm] = doMOVSrm<addr_width, 128>;
+  m[llvm::X86::MOVDQAmr] = doMOVSmr<addr_width, 128>;
   m[llvm::X86::MOVDQArr] = doMOVSrr<128, 0, 1>;
   m[llvm::X86::MOVDQArr_REV] = doMOVSrr<128, 0, 1>;
 
-  m[llvm::X86::MOVUPDrm] = doMOVSrm<128>;
-  m[llvm::X86::MOVUPDmr] = doMOVSmr<128>;
+  m[llvm::X86::MOVUPDrm] = doMOVSrm<addr_width, 128>;
+  m[llvm::X86::MOVUPDmr] = doMOVSmr<addr_width, 128>;
 
-  m[llvm::X86::MOVUPSrm] = doMOVSrm<128>;
-  m[llvm::X86::MOVUPSmr] = doMOVSmr<128>;
+  m[llvm::X86::MOVUPSrm] = doMOVSrm<addr_width, 128>;
+  m[llvm::X86::MOVUPSmr] = doMOVSmr<addr_width, 128>;
   m[llvm::X86::MOVUPSrr] = doMOVSrr<128, 0, 1>;
   m[llvm::X86::MOVUPSrr_REV] = doMOVSrr<128, 0, 1>;
 
-  m[llvm::X86::MOVAPSrm] = doMOVSrm<128>;
-  m[llvm::X86::MOVAPSmr] = doMOVSmr<128>;
+  m[llvm::X86::MOVAPSrm] = doMOVSrm<addr_width, 128>;
+  m[llvm::X86::MOVAPSmr] = doMOVSmr<addr_width, 128>;
   m[llvm::X86::MOVAPSrr] = doMOVSrr<128, 0, 1>;
   m[llvm::X86::MOVAPSrr_REV] = doMOVSrr<128, 0, 1>;
 
-  m[llvm::X86::MOVAPDrm] = doMOVSrm<128>;
-  m[llvm::X86::MOVAPDmr] = doMOVSmr<128>;
+  m[llvm::X86::MOVAPDrm] = doMOVSrm<addr_width, 128>;
+  m[llvm::X86::MOVAPDmr] = doMOVSmr<addr_width, 128>;
   m[llvm::X86::MOVAPDrr] = doMOVSrr<128, 0, 1>;
   m[llvm::X86::MOVAPDrr_REV] = doMOVSrr<128, 0, 1>;
 
   m[llvm::X86::MOVSDrr] = doMOVSrr<64, 1, 2>;
   m[llvm::X86::MOVSSrr] = doMOVSrr<32, 1, 2>;
 
-  m[llvm::X86::MOVDI2PDIrr] = translate_MOVDI2PDIrr;
-  m[llvm::X86::MOVDI2PDIrm] = translate_MOVDI2PDIrm;
+  m[llvm::X86::MOVDI2PDIrr] = translate_MOVDI2PDIrr<addr_width>;
+  m[llvm::X86::MOVDI2PDIrm] = translate_MOVDI2PDIrm<addr_width>;
 
   m[llvm::X86::MOVPDI2DIrr] = doMOVSrr<32, 0, 1>;
-  m[llvm::X86::MOVPDI2DImr] = doMOVSmr<32>;
-
-  m[llvm::X86::MOVSS2DIrr] = translate_MOVSS2DIrr;
-  m[llvm::X86::MOVSS2DImr] = doMOVSmr<32>;
-
-  m[llvm::X86::UCOMISSrr] = translate_UCOMISSrr;
-  m[llvm::X86::UCOMISSrm] = translate_UCOMISSrm;
-  m[llvm::X86::UCOMISDrr] = translate_UCOMISDrr;
-  m[llvm::X86::UCOMISDrm] = translate_UCOMISDrm;
-
-  m[llvm::X86::PSRAWrr] = translate_PSRAWrr;
-  m[llvm::X86::PSRAWrm] = translate_PSRAWrm;
-  m[llvm::X86::PSRAWri] = translate_PSRAWri;
-  m[llvm::X86::PSRADrr] = translate_PSRADrr;
-  m[llvm::X86::PSRADrm] = translate_PSRADrm;
-  m[llvm::X86::PSRADri] = translate_PSRADri;
-
-  m[llvm::X86::PSLLWrr] = translate_PSLLWrr;
-  m[llvm::X86::PSLLWrm] = translate_PSLLWrm;
-  m[llvm::X86::PSLLWri] = translate_PSLLWri;
-
-  m[llvm::X86::PSLLDrr] = translate_PSLLDrr;
-  m[llvm::X86::PSLLDrm] = translate_PSLLDrm;
-  m[llvm::X86::PSLLDri] = translate_PSLLDri;
-
-  m[llvm::X86::PSLLQrr] = translate_PSLLQrr;
-  m[llvm::X86::PSLLQrm] = translate_PSLLQrm;
-  m[llvm::X86::PSLLQri] = translate_PSLLQri;
-
-  m[llvm::X86::PSLLDQri] = translate_PSLLDQri;
-
-  m[llvm::X86::PSRLWrr] = translate_PSRLWrr;
-  m[llvm::X86::PSRLWrm] = translate_PSRLWrm;
-  m[llvm::X86::PSRLWri] = translate_PSRLWri;
-
-  m[llvm::X86::PSRLDrr] = translate_PSRLDrr;
-  m[llvm::X86::PSRLDrm] = translate_PSRLDrm;
-  m[llvm::X86::PSRLDri] = translate_PSRLDri;
-
-  m[llvm::X86::PSRLQrr] = translate_PSRLQrr;
-  m[llvm::X86::PSRLQrm] = translate_PSRLQrm;
-  m[llvm::X86::PSRLQri] = translate_PSRLQri;
-
-  m[llvm::X86::PSHUFDri] = translate_PSHUFDri;
-  m[llvm::X86::PSHUFDmi] = translate_PSHUFDmi;
-
-  m[llvm::X86::PSHUFBrr] = translate_PSHUFBrr;
-  m[llvm::X86::PSHUFBrm] = translate_PSHUFBrm;
-
-  m[llvm::X86::PINSRWrri] = translate_PINSRWrri;
-  m[llvm::X86::PINSRWrmi] = translate_PINSRWrmi;
-
-  m[llvm::X86::PEXTRWri] = translate_PEXTRWri;
-  m[llvm::X86::PEXTRWmr] = translate_PEXTRWmr;
-
-  m[llvm::X86::PUNPCKLBWrr] = translate_PUNPCKLBWrr;
-  m[llvm::X86::PUNPCKLBWrm] = translate_PUNPCKLBWrm;
-  m[llvm::X86::PUNPCKLWDrr] = translate_PUNPCKLWDrr;
-  m[llvm::X86::PUNPCKLWDrm] = translate_PUNPCKLWDrm;
-  m[llvm::X86::PUNPCKLDQrr] = translate_PUNPCKLDQrr;
-  m[llvm::X86::PUNPCKLDQrm] = translate_PUNPCKLDQrm;
-  m[llvm::X86::PUNPCKLQDQrr] = translate_PUNPCKLQDQrr;
-  m[llvm::X86::PUNPCKLQDQrm] = translate_PUNPCKLQDQrm;
-
-  m[llvm::X86::PUNPCKHBWrr] = translate_PUNPCKHBWrr;
-  m[llvm::X86::PUNPCKHBWrm] = translate_PUNPCKHBWrm;
-  m[llvm::X86::PUNPCKHWDrr] = translate_PUNPCKHWDrr;
-  m[llvm::X86::PUNPCKHWDrm] = translate_PUNPCKHWDrm;
-  m[llvm::X86::PUNPCKHDQrr] = translate_PUNPCKHDQrr;
-  m[llvm::X86::PUNPCKHDQrm] = translate_PUNPCKHDQrm;
-  m[llvm::X86::PUNPCKHQDQrr] = translate_PUNPCKHQDQrr;
-  m[llvm::X86::PUNPCKHQDQrm] = translate_PUNPCKHQDQrm;
-
-  m[llvm::X86::PADDBrr] = translate_PADDBrr;
-  m[llvm::X86::PADDBrm] = translate_PADDBrm;
-  m[llvm::X86::PADDWrr] = translate_PADDWrr;
-  m[llvm::X86::PADDWrm] = translate_PADDWrm;
-  m[llvm::X86::PADDDrr] = translate_PADDDrr;
-  m[llvm::X86::PADDDrm] = translate_PADDDrm;
-  m[llvm::X86::PADDQrr] = translate_PADDQrr;
-  m[llvm::X86::PADDQrm] = translate_PADDQrm;
-
-  m[llvm::X86::PSUBUSBrr] = translate_PSUBUSBrr;
-  m[llvm::X86::PSUBUSBrm] = translate_PSUBUSBrm;
-
-  m[llvm::X86::PSUBUSWrr] = translate_PSUBUSWrr;
-  m[llvm::X86::PSUBUSWrm] = translate_PSUBUSWrm;
-
-  m[llvm::X86::PSUBBrr] = translate_PSUBBrr;
-  m[llvm::X86::PSUBBrm] = translate_PSUBBrm;
-  m[llvm::X86::PSUBWrr] = translate_PSUBWrr;
-  m[llvm::X86::PSUBWrm] = translate_PSUBWrm;
-  m[llvm::X86::PSUBDrr] = translate_PSUBDrr;
-  m[llvm::X86::PSUBDrm] = translate_PSUBDrm;
-  m[llvm::X86::PSUBQrr] = translate_PSUBQrr;
-  m[llvm::X86::PSUBQrm] = translate_PSUBQrm;
-
-  m[llvm::X86::MAXPSrr] = translate_MAXPSrr;
-  m[llvm::X86::MAXPSrm] = translate_MAXPSrm;
-  m[llvm::X86::MAXPDrr] = translate_MAXPDrr;
-  m[llvm::X86::MAXPDrm] = translate_MAXPDrm;
-  m[llvm::X86::MAXSSrr] = translate_MAXSSrr;
-  m[llvm::X86::MAXSSrm] = translate_MAXSSrm;
-  m[llvm::X86::MAXSDrr] = translate_MAXSDrr;
-  m[llvm::X86::MAXSDrm] = translate_MAXSDrm;
-
-  m[llvm::X86::MINPSrr] = translate_MINPSrr;
-  m[llvm::X86::MINPSrm] = translate_MINPSrm;
-  m[llvm::X86::MINPDrr] = translate_MINPDrr;
-  m[llvm::X86::MINPDrm] = translate_MINPDrm;
-  m[llvm::X86::MINSSrr] = translate_MINSSrr;
-  m[llvm::X86::MINSSrm] = translate_MINSSrm;
-  m[llvm::X86::MINSDrr] = translate_MINSDrr;
-  m[llvm::X86::MINSDrm] = translate_MINSDrm;
+  m[llvm::X86::MOVPDI2DImr] = doMOVSmr<addr_width, 32>;
+
+  m[llvm::X86::MOVSS2DIrr] = translate_MOVSS2DIrr<addr_width>;
+  m[llvm::X86::MOVSS2DImr] = doMOVSmr<addr_width, 32>;
+
+  m[llvm::X86::UCOMISSrr] = translate_UCOMISSrr<addr_width>;
+  m[llvm::X86::UCOMISSrm] = translate_UCOMISSrm<addr_width>;
+  m[llvm::X86::UCOMISDrr] = translate_UCOMISDrr<addr_width>;
+  m[llvm::X86::UCOMISDrm] = translate_UCOMISDrm<addr_width>;
+
+  m[llvm::X86::PSRAWrr] = translate_PSRAWrr<addr_width>;
+  m[llvm::X86::PSRAWrm] = translate_PSRAWrm<addr_width>;
+  m[llvm::X86::PSRAWri] = translate_PSRAWri<addr_width>;
+  m[llvm::X86::PSRADrr] = translate_PSRADrr<addr_width>;
+  m[llvm::X86::PSRADrm] = translate_PSRADrm<addr_width>;
+  m[llvm::X86::PSRADri] = translate_PSRADri<addr_width>;
+
+  m[llvm::X86::PSLLWrr] = translate_PSLLWrr<addr_width>;
+  m[llvm::X86::PSLLWrm] = translate_PSLLWrm<addr_width>;
+  m[llvm::X86::PSLLWri] = translate_PSLLWri<addr_width>;
+
+  m[llvm::X86::PSLLDrr] = translate_PSLLDrr<addr_width>;
+  m[llvm::X86::PSLLDrm] = translate_PSLLDrm<addr_width>;
+  m[llvm::X86::PSLLDri] = translate_PSLLDri<addr_width>;
+
+  m[llvm::X86::PSLLQrr] = translate_PSLLQrr<addr_width>;
+  m[llvm::X86::PSLLQrm] = translate_PSLLQrm<addr_width>;
+  m[llvm::X86::PSLLQri] = translate_PSLLQri<addr_width>;
+
+  m[llvm::X86::PSLLDQri] = translate_PSLLDQri<addr_width>;
+
+  m[llvm::X86::PSRLWrr] = translate_PSRLWrr<addr_width>;
+  m[llvm::X86::PSRLWrm] = translate_PSRLWrm<addr_width>;
+  m[llvm::X86::PSRLWri] = translate_PSRLWri<addr_width>;
+
+  m[llvm::X86::PSRLDrr] = translate_PSRLDrr<addr_width>;
+  m[llvm::X86::PSRLDrm] = translate_PSRLDrm<addr_width>;
+  m[llvm::X86::PSRLDri] = translate_PSRLDri<addr_width>;
+
+  m[llvm::X86::PSRLQrr] = translate_PSRLQrr<addr_width>;
+  m[llvm::X86::PSRLQrm] = translate_PSRLQrm<addr_width>;
+  m[llvm::X86::PSRLQri] = translate_PSRLQri<addr_width>;
+
+  m[llvm::X86::PSHUFDri] = translate_PSHUFDri<addr_width>;
+  m[llvm::X86::PSHUFDmi] = translate_PSHUFDmi<addr_width>;
+
+  m[llvm::X86::PSHUFBrr] = translate_PSHUFBrr<addr_width>;
+  m[llvm::X86::PSHUFBrm] = translate_PSHUFBrm<addr_width>;
+
+  m[llvm::X86::PINSRWrri] = translate_PINSRWrri<addr_width>;
+  m[llvm::X86::PINSRWrmi] = translate_PINSRWrmi<addr_width>;
+
+  m[llvm::X86::PEXTRWri] = translate_PEXTRWri<addr_width>;
+  m[llvm::X86::PEXTRWmr] = translate_PEXTRWmr<addr_width>;
+
+  m[llvm::X86::PUNPCKLBWrr] = translate_PUNPCKLBWrr<addr_width>;
+  m[llvm::X86::PUNPCKLBWrm] = translate_PUNPCKLBWrm<addr_width>;
+  m[llvm::X86::PUNPCKLWDrr] = translate_PUNPCKLWDrr<addr_width>;
+  m[llvm::X86::PUNPCKLWDrm] = translate_PUNPCKLWDrm<addr_width>;
+  m[llvm::X86::PUNPCKLDQrr] = translate_PUNPCKLDQrr<addr_width>;
+  m[llvm::X86::PUNPCKLDQrm] = translate_PUNPCKLDQrm<addr_width>;
+  m[llvm::X86::PUNPCKLQDQrr] = translate_PUNPCKLQDQrr<addr_width>;
+  m[llvm::X86::PUNPCKLQDQrm] = translate_PUNPCKLQDQrm<addr_width>;
+
+  m[llvm::X86::PUNPCKHBWrr] = translate_PUNPCKHBWrr<addr_width>;
+  m[llvm::X86::PUNPCKHBWrm] = translate_PUNPCKHBWrm<addr_width>;
+  m[llvm::X86::PUNPCKHWDrr] = translate_PUNPCKHWDrr<addr_width>;
+  m[llvm::X86::PUNPCKHWDrm] = translate_PUNPCKHWDrm<addr_width>;
+  m[llvm::X86::PUNPCKHDQrr] = translate_PUNPCKHDQrr<addr_width>;
+  m[llvm::X86::PUNPCKHDQrm] = translate_PUNPCKHDQrm<addr_width>;
+  m[llvm::X86::PUNPCKHQDQrr] = translate_PUNPCKHQDQrr<addr_width>;
+  m[llvm::X86::PUNPCKHQDQrm] = translate_PUNPCKHQDQrm<addr_width>;
+
+  m[llvm::X86::PADDBrr] = translate_PADDBrr<addr_width>;
+  m[llvm::X86::PADDBrm] = translate_PADDBrm<addr_width>;
+  m[llvm::X86::PADDWrr] = translate_PADDWrr<addr_width>;
+  m[llvm::X86::PADDWrm] = translate_PADDWrm<addr_width>;
+  m[llvm::X86::PADDDrr] = translate_PADDDrr<addr_width>;
+  m[llvm::X86::PADDDrm] = translate_PADDDrm<addr_width>;
+  m[llvm::X86::PADDQrr] = translate_PADDQrr<addr_width>;
+  m[llvm::X86::PADDQrm] = translate_PADDQrm<addr_width>;
+
+  m[llvm::X86::PSUBUSBrr] = translate_PSUBUSBrr<addr_width>;
+  m[llvm::X86::PSUBUSBrm] = translate_PSUBUSBrm<addr_width>;
+
+  m[llvm::X86::PSUBUSWrr] = translate_PSUBUSWrr<addr_width>;
+  m[llvm::X86::PSUBUSWrm] = translate_PSUBUSWrm<addr_width>;
+
+  m[llvm::X86::PSUBBrr] = translate_PSUBBrr<addr_width>;
+  m[llvm::X86::PSUBBrm] = translate_PSUBBrm<addr_width>;
+  m[llvm::X86::PSUBWrr] = translate_PSUBWrr<addr_width>;
+  m[llvm::X86::PSUBWrm] = translate_PSUBWrm<addr_width>;
+  m[llvm::X86::PSUBDrr] = translate_PSUBDrr<addr_width>;
+  m[llvm::X86::PSUBDrm] = translate_PSUBDrm<addr_width>;
+  m[llvm::X86::PSUBQrr] = translate_PSUBQrr<addr_width>;
+  m[llvm::X86::PSUBQrm] = translate_PSUBQrm<addr_width>;
+
+  m[llvm::X86::MAXPSrr] = translate_MAXPSrr<addr_width>;
+  m[llvm::X86::MAXPSrm] = translate_MAXPSrm<addr_width>;
+  m[llvm::X86::MAXPDrr] = translate_MAXPDrr<addr_width>;
+  m[llvm::X86::MAXPDrm] = translate_MAXPDrm<addr_width>;
+  m[llvm::X86::MAXSSrr] = translate_MAXSSrr<addr_width>;
+  m[llvm::X86::MAXSSrm] = translate_MAXSSrm<addr_width>;
+  m[llvm::X86::MAXSDrr] = translate_MAXSDrr<addr_width>;
+  m[llvm::X86::MAXSDrm] = translate_MAXSDrm<addr_width>;
+
+  m[llvm::X86::MINPSrr] = translate_MINPSrr<addr_width>;
+  m[llvm::X86::MINPSrm] = translate_MINPSrm<addr_width>;
+  m[llvm::X86::MINPDrr] = translate_MINPDrr<addr_width>;
+  m[llvm::X86::MINPDrm] = translate_MINPDrm<addr_width>;
+  m[llvm::X86::MINSSrr] = translate_MINSSrr<addr_width>;
+  m[llvm::X86::MINSSrm] = translate_MINSSrm<addr_width>;
+  m[llvm::X86::MINSDrr] = translate_MINSDrr<addr_width>;
+  m[llvm::X86::MINSDrm] = translate_MINSDrm<addr_width>;
 
   // all the same AND op
-  m[llvm::X86::PANDrr] = translate_PANDrr;
-  m[llvm::X86::PANDrm] = translate_PANDrm;
-  m[llvm::X86::ANDPDrr] = translate_PANDrr;
-  m[llvm::X86::ANDPDrm] = translate_PANDrm;
-  m[llvm::X86::ANDPSrr] = translate_PANDrr;
-  m[llvm::X86::ANDPSrm] = translate_PANDrm;
+  m[llvm::X86::PANDrr] = translate_PANDrr<addr_width>;
+  m[llvm::X86::PANDrm] = translate_PANDrm<addr_width>;
+  m[llvm::X86::ANDPDrr] = translate_PANDrr<addr_width>;
+  m[llvm::X86::ANDPDrm] = translate_PANDrm<addr_width>;
+  m[llvm::X86::ANDPSrr] = translate_PANDrr<addr_width>;
+  m[llvm::X86::ANDPSrm] = translate_PANDrm<addr_width>;
 
   // all the same NAND op
-  m[llvm::X86::PANDNrr] = translate_PANDNrr;
-  m[llvm::X86::PANDNrm] = translate_PANDNrm;
-  m[llvm::X86::ANDNPDrr] = translate_PANDNrr;
-  m[llvm::X86::ANDNPDrm] = translate_PANDNrm;
-  m[llvm::X86::ANDNPSrr] = translate_PANDNrr;
-  m[llvm::X86::ANDNPSrm] = translate_PANDNrm;
+  m[llvm::X86::PANDNrr] = translate_PANDNrr<addr_width>;
+  m[llvm::X86::PANDNrm] = translate_PANDNrm<addr_width>;
+  m[llvm::X86::ANDNPDrr] = translate_PANDNrr<addr_width>;
+  m[llvm::X86::ANDNPDrm] = translate_PANDNrm<addr_width>;
+  m[llvm::X86::ANDNPSrr] = translate_PANDNrr<addr_width>;
+  m[llvm::X86::ANDNPSrm] = translate_PANDNrm<addr_width>;
 
   // compares
-  m[llvm::X86::PCMPGTBrr] = translate_PCMPGTBrr;
-  m[llvm::X86::PCMPGTBrm] = translate_PCMPGTBrm;
-  m[llvm::X86::PCMPGTWrr] = translate_PCMPGTWrr;
-  m[llvm::X86::PCMPGTWrm] = translate_PCMPGTWrm;
-  m[llvm::X86::PCMPGTDrr] = translate_PCMPGTDrr;
-  m[llvm::X86::PCMPGTDrm] = translate_PCMPGTDrm;
-  m[llvm::X86::PCMPGTQrr] = translate_PCMPGTQrr;
-  m[llvm::X86::PCMPGTQrm] = translate_PCMPGTQrm;
-
-  m[llvm::X86::PCMPEQBrr] = translate_PCMPEQBrr;
-  m[llvm::X86::PCMPEQBrm] = translate_PCMPEQBrm;
-  m[llvm::X86::PCMPEQWrr] = translate_PCMPEQWrr;
-  m[llvm::X86::PCMPEQWrm] = translate_PCMPEQWrm;
-  m[llvm::X86::PCMPEQDrr] = translate_PCMPEQDrr;
-  m[llvm::X86::PCMPEQDrm] = translate_PCMPEQDrm;
-  m[llvm::X86::PCMPEQQrr] = translate_PCMPEQQrr;
-  m[llvm::X86::PCMPEQQrm] = translate_PCMPEQQrm;
-
-  m[llvm::X86::PMOVSXBWrr] = translate_PMOVSXBWrr;
-  m[llvm::X86::PMOVSXBWrm] = translate_PMOVSXBWrm;
-  m[llvm::X86::PMOVSXBDrr] = translate_PMOVSXBDrr;
-  m[llvm::X86::PMOVSXBDrm] = translate_PMOVSXBDrm;
-  m[llvm::X86::PMOVSXBQrr] = translate_PMOVSXBQrr;
-  m[llvm::X86::PMOVSXBQrm] = translate_PMOVSXBQrm;
-  m[llvm::X86::PMOVSXWDrr] = translate_PMOVSXWDrr;
-  m[llvm::X86::PMOVSXWDrm] = translate_PMOVSXWDrm;
-  m[llvm::X86::PMOVSXWQrr] = translate_PMOVSXWQrr;
-  m[llvm::X86::PMOVSXWQrm] = translate_PMOVSXWQrm;
-  m[llvm::X86::PMOVSXDQrr] = translate_PMOVSXDQrr;
-  m[llvm::X86::PMOVSXDQrm] = translate_PMOVSXDQrm;
-
-  m[llvm::X86::PMOVZXBWrr] = translate_PMOVZXBWrr;
-  m[llvm::X86::PMOVZXBWrm] = translate_PMOVZXBWrm;
-  m[llvm::X86::PMOVZXBDrr] = translate_PMOVZXBDrr;
-  m[llvm::X86::PMOVZXBDrm] = translate_PMOVZXBDrm;
-  m[llvm::X86::PMOVZXBQrr] = translate_PMOVZXBQrr;
-  m[llvm::X86::PMOVZXBQrm] = translate_PMOVZXBQrm;
-  m[llvm::X86::PMOVZXWDrr] = translate_PMOVZXWDrr;
-  m[llvm::X86::PMOVZXWDrm] = translate_PMOVZXWDrm;
-  m[llvm::X86::PMOVZXWQrr] = translate_PMOVZXWQrr;
-  m[llvm::X86::PMOVZXWQrm] = translate_PMOVZXWQrm;
-  m[llvm::X86::PMOVZXDQrr] = translate_PMOVZXDQrr;
-  m[llvm::X86::PMOVZXDQrm] = translate_PMOVZXDQrm;
-
-  m[llvm::X86::PBLENDVBrr0] = translate_PBLENDVBrr0;
-  m[llvm::X86::PBLENDVBrm0] = translate_PBLENDVBrm0;
-
-  m[llvm::X86::MOVHLPSrr] = translate_MOVHLPSrr;
-  m[llvm::X86::MOVLHPSrr] = translate_MOVLHPSrr;
-
-  m[llvm::X86::PMULUDQrr] = translate_PMULUDQrr;
-  m[llvm::X86::PMULUDQrm] = translate_PMULUDQrm;
-
-  m[llvm::X86::CVTTPS2DQrr] = translate_CVTTPS2DQrr;
-  m[llvm::X86::CVTTPS2DQrm] = translate_CVTTPS2DQrm;
-
-  m[llvm::X86::MOVHPDrm] = translate_MOVHPDrm;
-  m[llvm::X86::MOVHPDmr] = translate_MOVHPDmr;
-
-  m[llvm::X86::MOVLPDrm] = translate_MOVLPDrm;
-  m[llvm::X86::MOVLPDmr] = doMOVSmr<64>;
+  m[llvm::X86::PCMPGTBrr] = translate_PCMPGTBrr<addr_width>;
+  m[llvm::X86::PCMPGTBrm] = translate_PCMPGTBrm<addr_width>;
+  m[llvm::X86::PCMPGTWrr] = translate_PCMPGTWrr<addr_width>;
+  m[llvm::X86::PCMPGTWrm] = translate_PCMPGTWrm<addr_width>;
+  m[llvm::X86::PCMPGTDrr] = translate_PCMPGTDrr<addr_width>;
+  m[llvm::X86::PCMPGTDrm] = translate_PCMPGTDrm<addr_width>;
+  m[llvm::X86::PCMPGTQrr] = translate_PCMPGTQrr<addr_width>;
+  m[llvm::X86::PCMPGTQrm] = translate_PCMPGTQrm<addr_width>;
+
+  m[llvm::X86::PCMPEQBrr] = translate_PCMPEQBrr<addr_width>;
+  m[llvm::X86::PCMPEQBrm] = translate_PCMPEQBrm<addr_width>;
+  m[llvm::X86::PCMPEQWrr] = translate_PCMPEQWrr<addr_width>;
+  m[llvm::X86::PCMPEQWrm] = translate_PCMPEQWrm<addr_width>;
+  m[llvm::X86::PCMPEQDrr] = translate_PCMPEQDrr<addr_width>;
+  m[llvm::X86::PCMPEQDrm] = translate_PCMPEQDrm<addr_width>;
+  m[llvm::X86::PCMPEQQrr] = translate_PCMPEQQrr<addr_width>;
+  m[llvm::X86::PCMPEQQrm] = translate_PCMPEQQrm<addr_width>;
+
+  m[llvm::X86::PMOVSXBWrr] = translate_PMOVSXBWrr<addr_width>;
+  m[llvm::X86::PMOVSXBWrm] = translate_PMOVSXBWrm<addr_width>;
+  m[llvm::X86::PMOVSXBDrr] = translate_PMOVSXBDrr<addr_width>;
+  m[llvm::X86::PMOVSXBDrm] = translate_PMOVSXBDrm<addr_width>;
+  m[llvm::X86::PMOVSXBQrr] = translate_PMOVSXBQrr<addr_width>;
+  m[llvm::X86::PMOVSXBQrm] = translate_PMOVSXBQrm<addr_width>;
+  m[llvm::X86::PMOVSXWDrr] = translate_PMOVSXWDrr<addr_width>;
+  m[llvm::X86::PMOVSXWDrm] = translate_PMOVSXWDrm<addr_width>;
+  m[llvm::X86::PMOVSXWQrr] = translate_PMOVSXWQrr<addr_width>;
+  m[llvm::X86::PMOVSXWQrm] = translate_PMOVSXWQrm<addr_width>;
+  m[llvm::X86::PMOVSXDQrr] = translate_PMOVSXDQrr<addr_width>;
+  m[llvm::X86::PMOVSXDQrm] = translate_PMOVSXDQrm<addr_width>;
+
+  m[llvm::X86::PMOVZXBWrr] = translate_PMOVZXBWrr<addr_width>;
+  m[llvm::X86::PMOVZXBWrm] = translate_PMOVZXBWrm<addr_width>;
+  m[llvm::X86::PMOVZXBDrr] = translate_PMOVZXBDrr<addr_width>;
+  m[llvm::X86::PMOVZXBDrm] = translate_PMOVZXBDrm<addr_width>;
+  m[llvm::X86::PMOVZXBQrr] = translate_PMOVZXBQrr<addr_width>;
+  m[llvm::X86::PMOVZXBQrm] = translate_PMOVZXBQrm<addr_width>;
+  m[llvm::X86::PMOVZXWDrr] = translate_PMOVZXWDrr<addr_width>;
+  m[llvm::X86::PMOVZXWDrm] = translate_PMOVZXWDrm<addr_width>;
+  m[llvm::X86::PMOVZXWQrr] = translate_PMOVZXWQrr<addr_width>;
+  m[llvm::X86::PMOVZXWQrm] = translate_PMOVZXWQrm<addr_width>;
+  m[llvm::X86::PMOVZXDQrr] = translate_PMOVZXDQrr<addr_width>;
+  m[llvm::X86::PMOVZXDQrm] = translate_PMOVZXDQrm<addr_width>;
+
+  m[llvm::X86::PBLENDVBrr0] = translate_PBLENDVBrr0<addr_width>;
+  m[llvm::X86::PBLENDVBrm0] = translate_PBLENDVBrm0<addr_width>;
+
+  m[llvm::X86::MOVHLPSrr] = translate_MOVHLPSrr<addr_width>;
+  m[llvm::X86::MOVLHPSrr] = translate_MOVLHPSrr<addr_width>;
+
+  m[llvm::X86::PMULUDQrr] = translate_PMULUDQrr<addr_width>;
+  m[llvm::X86::PMULUDQrm] = translate_PMULUDQrm<addr_width>;
+
+  m[llvm::X86::CVTTPS2DQrr] = translate_CVTTPS2DQrr<addr_width>;
+  m[llvm::X86::CVTTPS2DQrm] = translate_CVTTPS2DQrm<addr_width>;
+
+  m[llvm::X86::MOVHPDrm] = translate_MOVHPDrm<addr_width>;
+  m[llvm::X86::MOVHPDmr] = translate_MOVHPDmr<addr_width>;
+
+  m[llvm::X86::MOVLPDrm] = translate_MOVLPDrm<addr_width>;
+  m[llvm::X86::MOVLPDmr] = doMOVSmr<addr_width, 64>;
 
   // we don't care if its moving two single precision floats
   // or a double precision float. 64 bits are 64 bits
-  m[llvm::X86::MOVLPSrm] = translate_MOVLPDrm;
-  m[llvm::X86::MOVLPSmr] = doMOVSmr<64>;
+  m[llvm::X86::MOVLPSrm] = translate_MOVLPDrm<addr_width>;
+  m[llvm::X86::MOVLPSmr] = doMOVSmr<addr_width, 64>;
 
-  m[llvm::X86::SHUFPSrri] = translate_SHUFPSrri;
-  m[llvm::X86::SHUFPSrmi] = translate_SHUFPSrmi;
-  m[llvm::X86::SHUFPDrri] = translate_SHUFPDrri;
-  m[llvm::X86::SHUFPDrmi] = translate_SHUFPDrmi;
+  m[llvm::X86::SHUFPSrri] = translate_SHUFPSrri<addr_width>;
+  m[llvm::X86::SHUFPSrmi] = translate_SHUFPSrmi<addr_width>;
+  m[llvm::X86::SHUFPDrri] = translate_SHUFPDrri<addr_width>;
+  m[llvm::X86::SHUFPDrmi] = translate_SHUFPDrmi<addr_width>;
 
-  m[llvm::X86::PSHUFHWri] = translate_PSHUFHWri;
-  m[llvm::X86::PSHUFHWmi] = translate_PSHUFHWmi;
-  m[llvm::X86::PSHUFLWri] = translate_PSHUFLWri;
-  m[llvm::X86::PSHUFLWmi] = translate_PSHUFLWmi;
+  m[llvm::X86::PSHUFHWri] = translate_PSHUFHWri<addr_width>;
+  m[llvm::X86::PSHUFHWmi] = translate_PSHUFHWmi<addr_width>;
+  m[llvm::X86::PSHUFLWri] = translate_PSHUFLWri<addr_width>;
+  m[llvm::X86::PSHUFLWmi] = translate_PSHUFLWmi<addr_width>;
 
-  m[llvm::X86::UNPCKLPSrm] = translate_UNPCKLPSrm;
-  m[llvm::X86::UNPCKLPSrr] = translate_UNPCKLPSrr;
-  m[llvm::X86::UNPCKLPDrm] = translate_UNPCKLPDrm;
-  m[llvm::X86::UNPCKLPDrr] = translate_UNPCKLPDrr;
+  m[llvm::X86::UNPCKLPSrm] = translate_UNPCKLPSrm<addr_width>;
+  m[llvm::X86::UNPCKLPSrr] = translate_UNPCKLPSrr<addr_width>;
+  m[llvm::X86::UNPCKLPDrm] = translate_UNPCKLPDrm<addr_width>;
+  m[llvm::X86::UNPCKLPDrr] = translate_UNPCKLPDrr<addr_width>;
 
-  m[llvm::X86::UNPCKHPDrr] = translate_UNPCKHPDrr;
+  m[llvm::X86::UNPCKHPDrr] = translate_UNPCKHPDrr<addr_width>;
 
-  m[llvm::X86::CVTPS2PDrm] = translate_CVTPS2PDrm;
-  m[llvm::X86::CVTPS2PDrr] = translate_CVTPS2PDrr;
+  m[llvm::X86::CVTPS2PDrm] = translate_CVTPS2PDrm<addr_width>;
+  m[llvm::X86::CVTPS2PDrr] = translate_CVTPS2PDrr<addr_width>;
 
-  m[llvm::X86::CVTDQ2PSrr] = translate_CVTDQ2PSrr;
+  m[llvm::X86::CVTDQ2PSrr] = translate_CVTDQ2PSrr<addr_width>;
 
-  m[llvm::X86::CVTPD2PSrm] = translate_CVTPD2PSrm;
-  m[llvm::X86::CVTPD2PSrr] = translate_CVTPD2PSrr;
+  m[llvm::X86::CVTPD2PSrm] = translate_CVTPD2PSrm<addr_width>;
+  m[llvm::X86::CVTPD2PSrr] = translate_CVTPD2PSrr<addr_width>;
 
-  m[llvm::X86::MOV64toPQIrr] = translate_MOV64toPQIrr;
+  m[llvm::X86::MOV64toPQIrr] = translate_MOV64toPQIrr<addr_width>;
   m[llvm::X86::MOVPQIto64rr] = doMOVSrr<64, 0, 1>;
-  m[llvm::X86::MOV64toSDrm] = translate_MOV64toSDrm;
-  m[llvm::X86::MOVQI2PQIrm] = translate_MOVQI2PQIrm;
-  m[llvm::X86::MOVPQI2QImr] = doMOVSmr<64>;
+  m[llvm::X86::MOV64toSDrm] = translate_MOV64toSDrm<addr_width>;
+  m[llvm::X86::MOVQI2PQIrm] = translate_MOVQI2PQIrm<addr_width>;
+  m[llvm::X86::MOVPQI2QImr] = doMOVSmr<addr_width, 64>;
 
-  m[llvm::X86::MOVDDUPrr] = translate_MOVDDUPrr;
+  m[llvm::X86::MOVDDUPrr] = translate_MOVDDUPrr<addr_width>;
 
-  m[llvm::X86::SUBPDrr] = translate_SUBPDrr;
-  m[llvm::X86::SUBPDrm] = translate_SUBPDrm;
+  m[llvm::X86::SUBPDrr] = translate_SUBPDrr<addr_width>;
+  m[llvm::X86::SUBPDrm] = translate_SUBPDrm<addr_width>;
 
-  m[llvm::X86::SUBPSrr] = translate_SUBPSrr;
-  m[llvm::X86::SUBPSrm] = translate_SUBPSrm;
+  m[llvm::X86::SUBPSrr] = translate_SUBPSrr<addr_width>;
+  m[llvm::X86::SUBPSrm] = translate_SUBPSrm<addr_width>;
 
-  m[llvm::X86::ADDPDrr] = translate_ADDPDrr;
-  m[llvm::X86::ADDPDrm] = translate_ADDPDrm;
+  m[llvm::X86::ADDPDrr] = translate_ADDPDrr<addr_width>;
+  m[llvm::X86::ADDPDrm] = translate_ADDPDrm<addr_width>;
 
-  m[llvm::X86::ADDPSrr] = translate_ADDPSrr;
-  m[llvm::X86::ADDPSrm] = translate_ADDPSrm;
+  m[llvm::X86::ADDPSrr] = translate_ADDPSrr<addr_width>;
+  m[llvm::X86::ADDPSrm] = translate_ADDPSrm<addr_width>;
 
-  m[llvm::X86::MULPDrr] = translate_MULPDrr;
-  m[llvm::X86::MULPDrm] = translate_MULPDrm;
+  m[llvm::X86::MULPDrr] = translate_MULPDrr<addr_width>;
+  m[llvm::X86::MULPDrm] = translate_MULPDrm<addr_width>;
 
-  m[llvm::X86::MULPSrr] = translate_MULPSrr;
-  m[llvm::X86::MULPSrm] = translate_MULPSrm;
+  m[llvm::X86::MULPSrr] = translate_MULPSrr<addr_width>;
+  m[llvm::X86::MULPSrm] = translate_MULPSrm<addr_width>;
 
-  m[llvm::X86::DIVPSrr] = translate_DIVPSrr;
-  m[llvm::X86::DIVPSrm] = translate_DIVPSrm;
+  m[llvm::X86::DIVPSrr] = translate_DIVPSrr<addr_width>;
+  m[llvm::X86::DIVPSrm] = translate_DIVPSrm<addr_width>;
 
-  m[llvm::X86::DIVPDrr] = translate_DIVPDrr;
-  m[llvm::X86::DIVPDrm] = translate_DIVPDrm;
+  m[llvm::X86::DIVPDrr] = translate_DIVPDrr<addr_width>;
+  m[llvm::X86::DIVPDrm] = translate_DIVPDrm<addr_width>;
 
-  m[llvm::X86::MMX_PORirr] = translate_MMX_PORirr;
-  m[llvm::X86::MMX_PORirm] = translate_MMX_PORirm;
+  m[llvm::X86::MMX_PORirr] = translate_MMX_PORirr<addr_width>;
+  m[llvm::X86::MMX_PORirm] = translate_MMX_PORirm<addr_width>;
 }
+
+template void SSE_populateDispatchMap<32>(DispatchMap &m);
+template void SSE_populateDispatchMap<64>(DispatchMap &m);
@@ -50,6 +50,7 @@
 #include "mcsema/Arch/X86/Semantics/flagops.h"
 #include "mcsema/Arch/X86/Semantics/SUB.h"
 
+#include "mcsema/BC/Fuzz.h"
 #include "mcsema/BC/Util.h"
 
 #define NASSERT(cond) TASSERT(cond, "")
@@ -57,6 +58,7 @@
 template<int width>
 static llvm::Value *doSubVV(NativeInstPtr ip, llvm::BasicBlock *&b,
                             llvm::Value *lhs, llvm::Value *rhs) {
+  AddFuzzCmpHook(b, lhs, rhs);
   auto subRes = llvm::BinaryOperator::CreateSub(lhs, rhs, "", b);
 
   // Write the flag updates.
@@ -335,8 +337,8 @@ GENERIC_TRANSLATION_REF(
 GENERIC_TRANSLATION_MI(
     SUB32mi, doSubMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doSubMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doSubMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doSubMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doSubMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doSubMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(SUB32mi8, doSubMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doSubMI<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -355,12 +357,12 @@ GENERIC_TRANSLATION(SUB32ri8, doSubRI<32>(ip, block, OP(0), OP(1), OP(2)))
 //GENERIC_TRANSLATION(SUB64ri32, doSubRI<64>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION_REF(
     SUB64ri32, doSubRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doSubRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doSubRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 
 GENERIC_TRANSLATION_REF(
     SUB64i32,
     doSubRI<64>(ip, block, llvm::MCOperand::createReg(llvm::X86::RAX), llvm::MCOperand::createReg(llvm::X86::RAX), OP(0)),
-    doSubRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip),
+    doSubRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip),
                 llvm::MCOperand::createReg(llvm::X86::RAX),
                 llvm::MCOperand::createReg(llvm::X86::RAX)))
 
@@ -417,8 +419,8 @@ GENERIC_TRANSLATION(SBB64ri8, doSbbRI<64>(ip, block, OP(1), OP(2), OP(0)))
 GENERIC_TRANSLATION_MI(
     SBB32mi, doSbbMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doSbbMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doSbbMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doSbbMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doSbbMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doSbbMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(SBB32mi8, doSbbMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doSbbMI<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -463,80 +465,84 @@ static InstTransResult translate_SUB64ri8(TranslationContext &ctx,
   return ret;
 }
 
+template <int addr_width>
 void SUB_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::SUB16i16] = translate_SUB16i16;
-  m[llvm::X86::SUB16mi] = translate_SUB16mi;
-  m[llvm::X86::SUB16mi8] = translate_SUB16mi8;
-  m[llvm::X86::SUB16mr] = translate_SUB16mr;
-  m[llvm::X86::SUB16ri] = translate_SUB16ri;
-  m[llvm::X86::SUB16ri8] = translate_SUB16ri8;
-  m[llvm::X86::SUB16rm] = translate_SUB16rm;
-  m[llvm::X86::SUB16rr] = translate_SUB16rr;
-  m[llvm::X86::SUB16rr_REV] = translate_SUB16rr_REV;
-  m[llvm::X86::SUB32i32] = translate_SUB32i32;
-  m[llvm::X86::SUB32mi] = translate_SUB32mi;
-  m[llvm::X86::SUB32mi8] = translate_SUB32mi8;
-  m[llvm::X86::SUB32mr] = translate_SUB32mr;
-
-  m[llvm::X86::SUB64mi8] = translate_SUB64mi8;
-  m[llvm::X86::SUB64mr] = translate_SUB64mr;
-
-  m[llvm::X86::SUB32ri] = translate_SUB32ri;
-  m[llvm::X86::SUB32ri8] = translate_SUB32ri8;
-  m[llvm::X86::SUB32rm] = translate_SUB32rm;
-  m[llvm::X86::SUB32rr] = translate_SUB32rr;
-  m[llvm::X86::SUB32rr_REV] = translate_SUB32rr_REV;
-
-  m[llvm::X86::SUB64rm] = translate_SUB64rm;
-  m[llvm::X86::SUB64rr] = translate_SUB64rr;
-  m[llvm::X86::SUB64rr_REV] = translate_SUB64rr_REV;
-
-  m[llvm::X86::SUB8i8] = translate_SUB8i8;
-  m[llvm::X86::SUB8mi] = translate_SUB8mi;
-  m[llvm::X86::SUB8mr] = translate_SUB8mr;
-  m[llvm::X86::SUB8ri] = translate_SUB8ri;
-  m[llvm::X86::SUB8rm] = translate_SUB8rm;
-  m[llvm::X86::SUB8rr] = translate_SUB8rr;
-  m[llvm::X86::SUB8rr_REV] = translate_SUB8rr_REV;
-  m[llvm::X86::SBB16i16] = translate_SBB16i16;
-  m[llvm::X86::SBB16mi] = translate_SBB16mi;
-  m[llvm::X86::SBB16mi8] = translate_SBB16mi8;
-  m[llvm::X86::SBB16mr] = translate_SBB16mr;
-  m[llvm::X86::SBB16ri] = translate_SBB16ri;
-  m[llvm::X86::SBB16ri8] = translate_SBB16ri8;
-  m[llvm::X86::SBB16rm] = translate_SBB16rm;
-  m[llvm::X86::SBB16rr] = translate_SBB16rr;
-  m[llvm::X86::SBB16rr_REV] = translate_SBB16rr_REV;
-  m[llvm::X86::SBB32i32] = translate_SBB32i32;
-  m[llvm::X86::SBB32mi] = translate_SBB32mi;
-  m[llvm::X86::SBB32mi8] = translate_SBB32mi8;
-  m[llvm::X86::SBB64mi8] = translate_SBB64mi8;
-
-  m[llvm::X86::SBB32mr] = translate_SBB32mr;
-  m[llvm::X86::SBB64mr] = translate_SBB64mr;
-
-  m[llvm::X86::SBB32ri] = translate_SBB32ri;
-  m[llvm::X86::SBB32ri8] = translate_SBB32ri8;
-
-  m[llvm::X86::SBB64ri8] = translate_SBB64ri8;
-
-  m[llvm::X86::SBB32rm] = translate_SBB32rm;
-  m[llvm::X86::SBB32rr] = translate_SBB32rr;
-  m[llvm::X86::SBB32rr_REV] = translate_SBB32rr_REV;
-
-  m[llvm::X86::SBB64rm] = translate_SBB64rm;
-  m[llvm::X86::SBB64rr] = translate_SBB64rr;
-  m[llvm::X86::SBB64rr_REV] = translate_SBB64rr_REV;
-
-  m[llvm::X86::SBB8i8] = translate_SBB8i8;
-  m[llvm::X86::SBB8mi] = translate_SBB8mi;
-  m[llvm::X86::SBB8mr] = translate_SBB8mr;
-  m[llvm::X86::SBB8ri] = translate_SBB8ri;
-  m[llvm::X86::SBB8rm] = translate_SBB8rm;
-  m[llvm::X86::SBB8rr] = translate_SBB8rr;
-  m[llvm::X86::SBB8rr_REV] = translate_SBB8rr_REV;
+  m[llvm::X86::SUB16i16] = translate_SUB16i16<addr_width>;
+  m[llvm::X86::SUB16mi] = translate_SUB16mi<addr_width>;
+  m[llvm::X86::SUB16mi8] = translate_SUB16mi8<addr_width>;
+  m[llvm::X86::SUB16mr] = translate_SUB16mr<addr_width>;
+  m[llvm::X86::SUB16ri] = translate_SUB16ri<addr_width>;
+  m[llvm::X86::SUB16ri8] = translate_SUB16ri8<addr_width>;
+  m[llvm::X86::SUB16rm] = translate_SUB16rm<addr_width>;
+  m[llvm::X86::SUB16rr] = translate_SUB16rr<addr_width>;
+  m[llvm::X86::SUB16rr_REV] = translate_SUB16rr_REV<addr_width>;
+  m[llvm::X86::SUB32i32] = translate_SUB32i32<addr_width>;
+  m[llvm::X86::SUB32mi] = translate_SUB32mi<addr_width>;
+  m[llvm::X86::SUB32mi8] = translate_SUB32mi8<addr_width>;
+  m[llvm::X86::SUB32mr] = translate_SUB32mr<addr_width>;
+
+  m[llvm::X86::SUB64mi8] = translate_SUB64mi8<addr_width>;
+  m[llvm::X86::SUB64mr] = translate_SUB64mr<addr_width>;
+
+  m[llvm::X86::SUB32ri] = translate_SUB32ri<addr_width>;
+  m[llvm::X86::SUB32ri8] = translate_SUB32ri8<addr_width>;
+  m[llvm::X86::SUB32rm] = translate_SUB32rm<addr_width>;
+  m[llvm::X86::SUB32rr] = translate_SUB32rr<addr_width>;
+  m[llvm::X86::SUB32rr_REV] = translate_SUB32rr_REV<addr_width>;
+
+  m[llvm::X86::SUB64rm] = translate_SUB64rm<addr_width>;
+  m[llvm::X86::SUB64rr] = translate_SUB64rr<addr_width>;
+  m[llvm::X86::SUB64rr_REV] = translate_SUB64rr_REV<addr_width>;
+
+  m[llvm::X86::SUB8i8] = translate_SUB8i8<addr_width>;
+  m[llvm::X86::SUB8mi] = translate_SUB8mi<addr_width>;
+  m[llvm::X86::SUB8mr] = translate_SUB8mr<addr_width>;
+  m[llvm::X86::SUB8ri] = translate_SUB8ri<addr_width>;
+  m[llvm::X86::SUB8rm] = translate_SUB8rm<addr_width>;
+  m[llvm::X86::SUB8rr] = translate_SUB8rr<addr_width>;
+  m[llvm::X86::SUB8rr_REV] = translate_SUB8rr_REV<addr_width>;
+  m[llvm::X86::SBB16i16] = translate_SBB16i16<addr_width>;
+  m[llvm::X86::SBB16mi] = translate_SBB16mi<addr_width>;
+  m[llvm::X86::SBB16mi8] = translate_SBB16mi8<addr_width>;
+  m[llvm::X86::SBB16mr] = translate_SBB16mr<addr_width>;
+  m[llvm::X86::SBB16ri] = translate_SBB16ri<addr_width>;
+  m[llvm::X86::SBB16ri8] = translate_SBB16ri8<addr_width>;
+  m[llvm::X86::SBB16rm] = translate_SBB16rm<addr_width>;
+  m[llvm::X86::SBB16rr] = translate_SBB16rr<addr_width>;
+  m[llvm::X86::SBB16rr_REV] = translate_SBB16rr_REV<addr_width>;
+  m[llvm::X86::SBB32i32] = translate_SBB32i32<addr_width>;
+  m[llvm::X86::SBB32mi] = translate_SBB32mi<addr_width>;
+  m[llvm::X86::SBB32mi8] = translate_SBB32mi8<addr_width>;
+  m[llvm::X86::SBB64mi8] = translate_SBB64mi8<addr_width>;
+
+  m[llvm::X86::SBB32mr] = translate_SBB32mr<addr_width>;
+  m[llvm::X86::SBB64mr] = translate_SBB64mr<addr_width>;
+
+  m[llvm::X86::SBB32ri] = translate_SBB32ri<addr_width>;
+  m[llvm::X86::SBB32ri8] = translate_SBB32ri8<addr_width>;
+
+  m[llvm::X86::SBB64ri8] = translate_SBB64ri8<addr_width>;
+
+  m[llvm::X86::SBB32rm] = translate_SBB32rm<addr_width>;
+  m[llvm::X86::SBB32rr] = translate_SBB32rr<addr_width>;
+  m[llvm::X86::SBB32rr_REV] = translate_SBB32rr_REV<addr_width>;
+
+  m[llvm::X86::SBB64rm] = translate_SBB64rm<addr_width>;
+  m[llvm::X86::SBB64rr] = translate_SBB64rr<addr_width>;
+  m[llvm::X86::SBB64rr_REV] = translate_SBB64rr_REV<addr_width>;
+
+  m[llvm::X86::SBB8i8] = translate_SBB8i8<addr_width>;
+  m[llvm::X86::SBB8mi] = translate_SBB8mi<addr_width>;
+  m[llvm::X86::SBB8mr] = translate_SBB8mr<addr_width>;
+  m[llvm::X86::SBB8ri] = translate_SBB8ri<addr_width>;
+  m[llvm::X86::SBB8rm] = translate_SBB8rm<addr_width>;
+  m[llvm::X86::SBB8rr] = translate_SBB8rr<addr_width>;
+  m[llvm::X86::SBB8rr_REV] = translate_SBB8rr_REV<addr_width>;
 
   m[llvm::X86::SUB64ri8] = translate_SUB64ri8;
-  m[llvm::X86::SUB64ri32] = translate_SUB64ri32;
-  m[llvm::X86::SUB64i32] = translate_SUB64i32;
+  m[llvm::X86::SUB64ri32] = translate_SUB64ri32<addr_width>;
+  m[llvm::X86::SUB64i32] = translate_SUB64i32<addr_width>;
 }
+
+template void SUB_populateDispatchMap<32>(DispatchMap &m);
+template void SUB_populateDispatchMap<64>(DispatchMap &m);
@@ -2002,162 +2002,166 @@ GENERIC_TRANSLATION_REF(SHLD32mrCL,
                         doShldMCL<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doShldMCL<32>(ip, block, MEM_REFERENCE(0), OP(5)))
 
+template <int addr_width>
 void ShiftRoll_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::RCL8m1] = translate_RCL8m1;
-  m[llvm::X86::RCL8mCL] = translate_RCL8mCL;
-  m[llvm::X86::RCL8mi] = translate_RCL8mi;
-  m[llvm::X86::RCL8r1] = translate_RCL8r1;
-  m[llvm::X86::RCL8rCL] = translate_RCL8rCL;
-  m[llvm::X86::RCL8ri] = translate_RCL8ri;
-  m[llvm::X86::RCL16m1] = translate_RCL16m1;
-  m[llvm::X86::RCL16mCL] = translate_RCL16mCL;
-  m[llvm::X86::RCL16mi] = translate_RCL16mi;
-  m[llvm::X86::RCL16r1] = translate_RCL16r1;
-  m[llvm::X86::RCL16rCL] = translate_RCL16rCL;
-  m[llvm::X86::RCL16ri] = translate_RCL16ri;
-  m[llvm::X86::RCL32m1] = translate_RCL32m1;
-  m[llvm::X86::RCL32mCL] = translate_RCL32mCL;
-  m[llvm::X86::RCL32mi] = translate_RCL32mi;
-  m[llvm::X86::RCL32r1] = translate_RCL32r1;
-  m[llvm::X86::RCL32rCL] = translate_RCL32rCL;
-  m[llvm::X86::RCL32ri] = translate_RCL32ri;
-  m[llvm::X86::RCR8m1] = translate_RCR8m1;
-  m[llvm::X86::RCR8mCL] = translate_RCR8mCL;
-  m[llvm::X86::RCR8mi] = translate_RCR8mi;
-  m[llvm::X86::RCR8r1] = translate_RCR8r1;
-  m[llvm::X86::RCR8rCL] = translate_RCR8rCL;
-  m[llvm::X86::RCR8ri] = translate_RCR8ri;
-  m[llvm::X86::RCR16m1] = translate_RCR16m1;
-  m[llvm::X86::RCR16mCL] = translate_RCR16mCL;
-  m[llvm::X86::RCR16mi] = translate_RCR16mi;
-  m[llvm::X86::RCR16r1] = translate_RCR16r1;
-  m[llvm::X86::RCR16rCL] = translate_RCR16rCL;
-  m[llvm::X86::RCR16ri] = translate_RCR16ri;
-  m[llvm::X86::RCR32m1] = translate_RCR32m1;
-  m[llvm::X86::RCR32mCL] = translate_RCR32mCL;
-  m[llvm::X86::RCR32mi] = translate_RCR32mi;
-  m[llvm::X86::RCR32r1] = translate_RCR32r1;
-  m[llvm::X86::RCR32rCL] = translate_RCR32rCL;
-  m[llvm::X86::RCR32ri] = translate_RCR32ri;
-  m[llvm::X86::ROL8m1] = translate_ROL8m1;
-  m[llvm::X86::ROL8mCL] = translate_ROL8mCL;
-  m[llvm::X86::ROL8mi] = translate_ROL8mi;
-  m[llvm::X86::ROL8r1] = translate_ROL8r1;
-  m[llvm::X86::ROL8rCL] = translate_ROL8rCL;
-  m[llvm::X86::ROL8ri] = translate_ROL8ri;
-  m[llvm::X86::ROL16m1] = translate_ROL16m1;
-  m[llvm::X86::ROL16mCL] = translate_ROL16mCL;
-  m[llvm::X86::ROL16mi] = translate_ROL16mi;
-  m[llvm::X86::ROL16r1] = translate_ROL16r1;
-  m[llvm::X86::ROL16rCL] = translate_ROL16rCL;
-  m[llvm::X86::ROL32rCL] = translate_ROL32rCL;
-  m[llvm::X86::ROL64rCL] = translate_ROL64rCL;
-  m[llvm::X86::ROL16ri] = translate_ROL16ri;
-  m[llvm::X86::ROL32m1] = translate_ROL32m1;
-  m[llvm::X86::ROL32mCL] = translate_ROL32mCL;
-  m[llvm::X86::ROL32mi] = translate_ROL32mi;
-  m[llvm::X86::ROL32r1] = translate_ROL32r1;
-  m[llvm::X86::ROL32ri] = translate_ROL32ri;
-  m[llvm::X86::ROL64ri] = translate_ROL64ri;
-  m[llvm::X86::ROR8m1] = translate_ROR8m1;
-  m[llvm::X86::ROR8mCL] = translate_ROR8mCL;
-  m[llvm::X86::ROR8mi] = translate_ROR8mi;
-  m[llvm::X86::ROR8r1] = translate_ROR8r1;
-  m[llvm::X86::ROR8rCL] = translate_ROR8rCL;
-  m[llvm::X86::ROR8ri] = translate_ROR8ri;
-  m[llvm::X86::ROR16m1] = translate_ROR16m1;
-  m[llvm::X86::ROR16mCL] = translate_ROR16mCL;
-  m[llvm::X86::ROR16mi] = translate_ROR16mi;
-  m[llvm::X86::ROR16r1] = translate_ROR16r1;
-  m[llvm::X86::ROR16rCL] = translate_ROR16rCL;
-  m[llvm::X86::ROR16ri] = translate_ROR16ri;
-  m[llvm::X86::ROR32m1] = translate_ROR32m1;
-  m[llvm::X86::ROR32mCL] = translate_ROR32mCL;
-  m[llvm::X86::ROR32mi] = translate_ROR32mi;
-  m[llvm::X86::ROR32r1] = translate_ROR32r1;
-  m[llvm::X86::ROR32rCL] = translate_ROR32rCL;
-  m[llvm::X86::ROR32ri] = translate_ROR32ri;
-  m[llvm::X86::ROR64ri] = translate_ROR64ri;
-  m[llvm::X86::SAR16m1] = translate_SAR16m1;
-  m[llvm::X86::SAR16mCL] = translate_SAR16mCL;
-  m[llvm::X86::SAR16mi] = translate_SAR16mi;
-  m[llvm::X86::SAR16r1] = translate_SAR16r1;
-  m[llvm::X86::SAR16rCL] = translate_SAR16rCL;
-  m[llvm::X86::SAR16ri] = translate_SAR16ri;
-  m[llvm::X86::SAR32m1] = translate_SAR32m1;
-  m[llvm::X86::SAR32mCL] = translate_SAR32mCL;
-  m[llvm::X86::SAR32mi] = translate_SAR32mi;
-  m[llvm::X86::SAR32r1] = translate_SAR32r1;
-  m[llvm::X86::SAR32rCL] = translate_SAR32rCL;
-  m[llvm::X86::SAR32ri] = translate_SAR32ri;
-
-  m[llvm::X86::SAR64m1] = translate_SAR64m1;
-  m[llvm::X86::SAR64mCL] = translate_SAR64mCL;
-  m[llvm::X86::SAR64mi] = translate_SAR64mi;
-  m[llvm::X86::SAR64r1] = translate_SAR64r1;
-  m[llvm::X86::SAR64rCL] = translate_SAR64rCL;
-  m[llvm::X86::SAR64ri] = translate_SAR64ri;
-
-  m[llvm::X86::SAR8m1] = translate_SAR8m1;
-  m[llvm::X86::SAR8mCL] = translate_SAR8mCL;
-  m[llvm::X86::SAR8mi] = translate_SAR8mi;
-  m[llvm::X86::SAR8r1] = translate_SAR8r1;
-  m[llvm::X86::SAR8rCL] = translate_SAR8rCL;
-  m[llvm::X86::SAR8ri] = translate_SAR8ri;
-  m[llvm::X86::SHL16m1] = translate_SHL16m1;
-  m[llvm::X86::SHL16mCL] = translate_SHL16mCL;
-  m[llvm::X86::SHL16mi] = translate_SHL16mi;
-  m[llvm::X86::SHL16r1] = translate_SHL16r1;
-  m[llvm::X86::SHL16rCL] = translate_SHL16rCL;
-  m[llvm::X86::SHL16ri] = translate_SHL16ri;
-  m[llvm::X86::SHL32m1] = translate_SHL32m1;
-  m[llvm::X86::SHL64m1] = translate_SHL64m1;
-  m[llvm::X86::SHL32mCL] = translate_SHL32mCL;
-  m[llvm::X86::SHL32mi] = translate_SHL32mi;
-  m[llvm::X86::SHL64mi] = translate_SHL64mi;
-  m[llvm::X86::SHL32r1] = translate_SHL32r1;
-  m[llvm::X86::SHL64r1] = translate_SHL64r1;
-  m[llvm::X86::SHL32rCL] = translate_SHL32rCL;
-  m[llvm::X86::SHL64rCL] = translate_SHL64rCL;
-  m[llvm::X86::SHL32ri] = translate_SHL32ri;
-  m[llvm::X86::SHL64ri] = translate_SHL64ri;
-
-  m[llvm::X86::SHL8m1] = translate_SHL8m1;
-  m[llvm::X86::SHL8mCL] = translate_SHL8mCL;
-  m[llvm::X86::SHL8mi] = translate_SHL8mi;
-  m[llvm::X86::SHL8r1] = translate_SHL8r1;
-  m[llvm::X86::SHL8rCL] = translate_SHL8rCL;
-  m[llvm::X86::SHL8ri] = translate_SHL8ri;
-  m[llvm::X86::SHR16m1] = translate_SHR16m1;
-  m[llvm::X86::SHR16mCL] = translate_SHR16mCL;
-  m[llvm::X86::SHR16mi] = translate_SHR16mi;
-  m[llvm::X86::SHR16r1] = translate_SHR16r1;
-  m[llvm::X86::SHR16rCL] = translate_SHR16rCL;
-  m[llvm::X86::SHR16ri] = translate_SHR16ri;
-  m[llvm::X86::SHR32m1] = translate_SHR32m1;
-  m[llvm::X86::SHR64m1] = translate_SHR64m1;
-  m[llvm::X86::SHR32mCL] = translate_SHR32mCL;
-  m[llvm::X86::SHR32mi] = translate_SHR32mi;
-  m[llvm::X86::SHR64mi] = translate_SHR64mi;
-  m[llvm::X86::SHR32r1] = translate_SHR32r1;
-  m[llvm::X86::SHR32rCL] = translate_SHR32rCL;
-  m[llvm::X86::SHR64rCL] = translate_SHR64rCL;
-  m[llvm::X86::SHR32ri] = translate_SHR32ri;
-  m[llvm::X86::SHR8m1] = translate_SHR8m1;
-  m[llvm::X86::SHR8mCL] = translate_SHR8mCL;
-  m[llvm::X86::SHR8mi] = translate_SHR8mi;
-  m[llvm::X86::SHR8r1] = translate_SHR8r1;
-  m[llvm::X86::SHR8rCL] = translate_SHR8rCL;
-  m[llvm::X86::SHR8ri] = translate_SHR8ri;
-  m[llvm::X86::SHRD32rri8] = translate_SHRD32rri8;
-  m[llvm::X86::SHRD32rrCL] = translate_SHRD32rrCL;
-  m[llvm::X86::SHLD32rrCL] = translate_SHLD32rrCL;
-  m[llvm::X86::SHLD32mrCL] = translate_SHLD32mrCL;
-  m[llvm::X86::SHLD32rri8] = translate_SHLD32rri8;
-  m[llvm::X86::SHLD64rri8] = translate_SHLD64rri8;
-  m[llvm::X86::SHRD64rri8] = translate_SHRD64rri8;
-
-  m[llvm::X86::SHR64ri] = translate_SHR64ri;
-  m[llvm::X86::SHR64r1] = translate_SHR64r1;
-  m[llvm::X86::SHR64rCL] = translate_SHR64rCL;
-}
+  m[llvm::X86::RCL8m1] = translate_RCL8m1<addr_width>;
+  m[llvm::X86::RCL8mCL] = translate_RCL8mCL<addr_width>;
+  m[llvm::X86::RCL8mi] = translate_RCL8mi<addr_width>;
+  m[llvm::X86::RCL8r1] = translate_RCL8r1<addr_width>;
+  m[llvm::X86::RCL8rCL] = translate_RCL8rCL<addr_width>;
+  m[llvm::X86::RCL8ri] = translate_RCL8ri<addr_width>;
+  m[llvm::X86::RCL16m1] = translate_RCL16m1<addr_width>;
+  m[llvm::X86::RCL16mCL] = translate_RCL16mCL<addr_width>;
+  m[llvm::X86::RCL16mi] = translate_RCL16mi<addr_width>;
+  m[llvm::X86::RCL16r1] = translate_RCL16r1<addr_width>;
+  m[llvm::X86::RCL16rCL] = translate_RCL16rCL<addr_width>;
+  m[llvm::X86::RCL16ri] = translate_RCL16ri<addr_width>;
+  m[llvm::X86::RCL32m1] = translate_RCL32m1<addr_width>;
+  m[llvm::X86::RCL32mCL] = translate_RCL32mCL<addr_width>;
+  m[llvm::X86::RCL32mi] = translate_RCL32mi<addr_width>;
+  m[llvm::X86::RCL32r1] = translate_RCL32r1<addr_width>;
+  m[llvm::X86::RCL32rCL] = translate_RCL32rCL<addr_width>;
+  m[llvm::X86::RCL32ri] = translate_RCL32ri<addr_width>;
+  m[llvm::X86::RCR8m1] = translate_RCR8m1<addr_width>;
+  m[llvm::X86::RCR8mCL] = translate_RCR8mCL<addr_width>;
+  m[llvm::X86::RCR8mi] = translate_RCR8mi<addr_width>;
+  m[llvm::X86::RCR8r1] = translate_RCR8r1<addr_width>;
+  m[llvm::X86::RCR8rCL] = translate_RCR8rCL<addr_width>;
+  m[llvm::X86::RCR8ri] = translate_RCR8ri<addr_width>;
+  m[llvm::X86::RCR16m1] = translate_RCR16m1<addr_width>;
+  m[llvm::X86::RCR16mCL] = translate_RCR16mCL<addr_width>;
+  m[llvm::X86::RCR16mi] = translate_RCR16mi<addr_width>;
+  m[llvm::X86::RCR16r1] = translate_RCR16r1<addr_width>;
+  m[llvm::X86::RCR16rCL] = translate_RCR16rCL<addr_width>;
+  m[llvm::X86::RCR16ri] = translate_RCR16ri<addr_width>;
+  m[llvm::X86::RCR32m1] = translate_RCR32m1<addr_width>;
+  m[llvm::X86::RCR32mCL] = translate_RCR32mCL<addr_width>;
+  m[llvm::X86::RCR32mi] = translate_RCR32mi<addr_width>;
+  m[llvm::X86::RCR32r1] = translate_RCR32r1<addr_width>;
+  m[llvm::X86::RCR32rCL] = translate_RCR32rCL<addr_width>;
+  m[llvm::X86::RCR32ri] = translate_RCR32ri<addr_width>;
+  m[llvm::X86::ROL8m1] = translate_ROL8m1<addr_width>;
+  m[llvm::X86::ROL8mCL] = translate_ROL8mCL<addr_width>;
+  m[llvm::X86::ROL8mi] = translate_ROL8mi<addr_width>;
+  m[llvm::X86::ROL8r1] = translate_ROL8r1<addr_width>;
+  m[llvm::X86::ROL8rCL] = translate_ROL8rCL<addr_width>;
+  m[llvm::X86::ROL8ri] = translate_ROL8ri<addr_width>;
+  m[llvm::X86::ROL16m1] = translate_ROL16m1<addr_width>;
+  m[llvm::X86::ROL16mCL] = translate_ROL16mCL<addr_width>;
+  m[llvm::X86::ROL16mi] = translate_ROL16mi<addr_width>;
+  m[llvm::X86::ROL16r1] = translate_ROL16r1<addr_width>;
+  m[llvm::X86::ROL16rCL] = translate_ROL16rCL<addr_width>;
+  m[llvm::X86::ROL32rCL] = translate_ROL32rCL<addr_width>;
+  m[llvm::X86::ROL64rCL] = translate_ROL64rCL<addr_width>;
+  m[llvm::X86::ROL16ri] = translate_ROL16ri<addr_width>;
+  m[llvm::X86::ROL32m1] = translate_ROL32m1<addr_width>;
+  m[llvm::X86::ROL32mCL] = translate_ROL32mCL<addr_width>;
+  m[llvm::X86::ROL32mi] = translate_ROL32mi<addr_width>;
+  m[llvm::X86::ROL32r1] = translate_ROL32r1<addr_width>;
+  m[llvm::X86::ROL32ri] = translate_ROL32ri<addr_width>;
+  m[llvm::X86::ROL64ri] = translate_ROL64ri<addr_width>;
+  m[llvm::X86::ROR8m1] = translate_ROR8m1<addr_width>;
+  m[llvm::X86::ROR8mCL] = translate_ROR8mCL<addr_width>;
+  m[llvm::X86::ROR8mi] = translate_ROR8mi<addr_width>;
+  m[llvm::X86::ROR8r1] = translate_ROR8r1<addr_width>;
+  m[llvm::X86::ROR8rCL] = translate_ROR8rCL<addr_width>;
+  m[llvm::X86::ROR8ri] = translate_ROR8ri<addr_width>;
+  m[llvm::X86::ROR16m1] = translate_ROR16m1<addr_width>;
+  m[llvm::X86::ROR16mCL] = translate_ROR16mCL<addr_width>;
+  m[llvm::X86::ROR16mi] = translate_ROR16mi<addr_width>;
+  m[llvm::X86::ROR16r1] = translate_ROR16r1<addr_width>;
+  m[llvm::X86::ROR16rCL] = translate_ROR16rCL<addr_width>;
+  m[llvm::X86::ROR16ri] = translate_ROR16ri<addr_width>;
+  m[llvm::X86::ROR32m1] = translate_ROR32m1<addr_width>;
+  m[llvm::X86::ROR32mCL] = translate_ROR32mCL<addr_width>;
+  m[llvm::X86::ROR32mi] = translate_ROR32mi<addr_width>;
+  m[llvm::X86::ROR32r1] = translate_ROR32r1<addr_width>;
+  m[llvm::X86::ROR32rCL] = translate_ROR32rCL<addr_width>;
+  m[llvm::X86::ROR32ri] = translate_ROR32ri<addr_width>;
+  m[llvm::X86::ROR64ri] = translate_ROR64ri<addr_width>;
+  m[llvm::X86::SAR16m1] = translate_SAR16m1<addr_width>;
+  m[llvm::X86::SAR16mCL] = translate_SAR16mCL<addr_width>;
+  m[llvm::X86::SAR16mi] = translate_SAR16mi<addr_width>;
+  m[llvm::X86::SAR16r1] = translate_SAR16r1<addr_width>;
+  m[llvm::X86::SAR16rCL] = translate_SAR16rCL<addr_width>;
+  m[llvm::X86::SAR16ri] = translate_SAR16ri<addr_width>;
+  m[llvm::X86::SAR32m1] = translate_SAR32m1<addr_width>;
+  m[llvm::X86::SAR32mCL] = translate_SAR32mCL<addr_width>;
+  m[llvm::X86::SAR32mi] = translate_SAR32mi<addr_width>;
+  m[llvm::X86::SAR32r1] = translate_SAR32r1<addr_width>;
+  m[llvm::X86::SAR32rCL] = translate_SAR32rCL<addr_width>;
+  m[llvm::X86::SAR32ri] = translate_SAR32ri<addr_width>;
+
+  m[llvm::X86::SAR64m1] = translate_SAR64m1<addr_width>;
+  m[llvm::X86::SAR64mCL] = translate_SAR64mCL<addr_width>;
+  m[llvm::X86::SAR64mi] = translate_SAR64mi<addr_width>;
+  m[llvm::X86::SAR64r1] = translate_SAR64r1<addr_width>;
+  m[llvm::X86::SAR64rCL] = translate_SAR64rCL<addr_width>;
+  m[llvm::X86::SAR64ri] = translate_SAR64ri<addr_width>;
+
+  m[llvm::X86::SAR8m1] = translate_SAR8m1<addr_width>;
+  m[llvm::X86::SAR8mCL] = translate_SAR8mCL<addr_width>;
+  m[llvm::X86::SAR8mi] = translate_SAR8mi<addr_width>;
+  m[llvm::X86::SAR8r1] = translate_SAR8r1<addr_width>;
+  m[llvm::X86::SAR8rCL] = translate_SAR8rCL<addr_width>;
+  m[llvm::X86::SAR8ri] = translate_SAR8ri<addr_width>;
+  m[llvm::X86::SHL16m1] = translate_SHL16m1<addr_width>;
+  m[llvm::X86::SHL16mCL] = translate_SHL16mCL<addr_width>;
+  m[llvm::X86::SHL16mi] = translate_SHL16mi<addr_width>;
+  m[llvm::X86::SHL16r1] = translate_SHL16r1<addr_width>;
+  m[llvm::X86::SHL16rCL] = translate_SHL16rCL<addr_width>;
+  m[llvm::X86::SHL16ri] = translate_SHL16ri<addr_width>;
+  m[llvm::X86::SHL32m1] = translate_SHL32m1<addr_width>;
+  m[llvm::X86::SHL64m1] = translate_SHL64m1<addr_width>;
+  m[llvm::X86::SHL32mCL] = translate_SHL32mCL<addr_width>;
+  m[llvm::X86::SHL32mi] = translate_SHL32mi<addr_width>;
+  m[llvm::X86::SHL64mi] = translate_SHL64mi<addr_width>;
+  m[llvm::X86::SHL32r1] = translate_SHL32r1<addr_width>;
+  m[llvm::X86::SHL64r1] = translate_SHL64r1<addr_width>;
+  m[llvm::X86::SHL32rCL] = translate_SHL32rCL<addr_width>;
+  m[llvm::X86::SHL64rCL] = translate_SHL64rCL<addr_width>;
+  m[llvm::X86::SHL32ri] = translate_SHL32ri<addr_width>;
+  m[llvm::X86::SHL64ri] = translate_SHL64ri<addr_width>;
+
+  m[llvm::X86::SHL8m1] = translate_SHL8m1<addr_width>;
+  m[llvm::X86::SHL8mCL] = translate_SHL8mCL<addr_width>;
+  m[llvm::X86::SHL8mi] = translate_SHL8mi<addr_width>;
+  m[llvm::X86::SHL8r1] = translate_SHL8r1<addr_width>;
+  m[llvm::X86::SHL8rCL] = translate_SHL8rCL<addr_width>;
+  m[llvm::X86::SHL8ri] = translate_SHL8ri<addr_width>;
+  m[llvm::X86::SHR16m1] = translate_SHR16m1<addr_width>;
+  m[llvm::X86::SHR16mCL] = translate_SHR16mCL<addr_width>;
+  m[llvm::X86::SHR16mi] = translate_SHR16mi<addr_width>;
+  m[llvm::X86::SHR16r1] = translate_SHR16r1<addr_width>;
+  m[llvm::X86::SHR16rCL] = translate_SHR16rCL<addr_width>;
+  m[llvm::X86::SHR16ri] = translate_SHR16ri<addr_width>;
+  m[llvm::X86::SHR32m1] = translate_SHR32m1<addr_width>;
+  m[llvm::X86::SHR64m1] = translate_SHR64m1<addr_width>;
+  m[llvm::X86::SHR32mCL] = translate_SHR32mCL<addr_width>;
+  m[llvm::X86::SHR32mi] = translate_SHR32mi<addr_width>;
+  m[llvm::X86::SHR64mi] = translate_SHR64mi<addr_width>;
+  m[llvm::X86::SHR32r1] = translate_SHR32r1<addr_width>;
+  m[llvm::X86::SHR32rCL] = translate_SHR32rCL<addr_width>;
+  m[llvm::X86::SHR64rCL] = translate_SHR64rCL<addr_width>;
+  m[llvm::X86::SHR32ri] = translate_SHR32ri<addr_width>;
+  m[llvm::X86::SHR8m1] = translate_SHR8m1<addr_width>;
+  m[llvm::X86::SHR8mCL] = translate_SHR8mCL<addr_width>;
+  m[llvm::X86::SHR8mi] = translate_SHR8mi<addr_width>;
+  m[llvm::X86::SHR8r1] = translate_SHR8r1<addr_width>;
+  m[llvm::X86::SHR8rCL] = translate_SHR8rCL<addr_width>;
+  m[llvm::X86::SHR8ri] = translate_SHR8ri<addr_width>;
+  m[llvm::X86::SHRD32rri8] = translate_SHRD32rri8<addr_width>;
+  m[llvm::X86::SHRD32rrCL] = translate_SHRD32rrCL<addr_width>;
+  m[llvm::X86::SHLD32rrCL] = translate_SHLD32rrCL<addr_width>;
+  m[llvm::X86::SHLD32mrCL] = translate_SHLD32mrCL<addr_width>;
+  m[llvm::X86::SHLD32rri8] = translate_SHLD32rri8<addr_width>;
+  m[llvm::X86::SHLD64rri8] = translate_SHLD64rri8<addr_width>;
+  m[llvm::X86::SHRD64rri8] = translate_SHRD64rri8<addr_width>;
+
+  m[llvm::X86::SHR64ri] = translate_SHR64ri<addr_width>;
+  m[llvm::X86::SHR64r1] = translate_SHR64r1<addr_width>;
+  m[llvm::X86::SHR64rCL] = translate_SHR64rCL<addr_width>;
+}
+
+template void ShiftRoll_populateDispatchMap<32>(DispatchMap &m);
+template void ShiftRoll_populateDispatchMap<64>(DispatchMap &m);
@@ -35,6 +35,7 @@ class Value;
 
 class DispatchMap;
 
+template <int addr_width>
 void ShiftRoll_populateDispatchMap(DispatchMap &m);
 llvm::Value *ShrdVV32(llvm::BasicBlock *&b, unsigned dstReg, unsigned srcReg1,
                       llvm::Value *shiftBy);
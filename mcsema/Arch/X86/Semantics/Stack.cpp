@@ -60,57 +60,26 @@
 
 #define NASSERT(cond) TASSERT(cond, "")
 
-template<int width>
-static void doPushVT(NativeInstPtr ip, llvm::BasicBlock *&b, llvm::Value *v) {
+// Push `v`, a `width`-bit value, onto the stack of `addr_width`-bit code.
+template<int width, int addr_width>
+static void doPushV(NativeInstPtr ip, llvm::BasicBlock *&b, llvm::Value *v) {
   //ESP <- ESP - 4
   //Memory[ESP] = v
-  if (ArchPointerSize(b->getParent()->getParent())) {
-    auto oldESP = R_READ<32>(b, llvm::X86::ESP);
-    auto newESP = llvm::BinaryOperator::CreateSub(oldESP,
-                                                  CONST_V<32>(b, (width / 8)),
-                                                  "", b);
-
-    auto intVal = llvm::CastInst::CreatePointerCast(
-        v, llvm::Type::getInt32Ty(b->getContext()), "", b);
-
-    M_WRITE_0<width>(b, newESP, intVal);
-    R_WRITE<32>(b, llvm::X86::ESP, newESP);
+  auto xsp = 32 == addr_width ? llvm::X86::ESP : llvm::X86::RSP;
+  auto oldESP = R_READ<addr_width>(b, xsp);
+  auto newESP = llvm::BinaryOperator::CreateSub(
+      oldESP, CONST_V<addr_width>(b, (width / 8)), "", b);
 
-  } else {
-    auto oldESP = R_READ<64>(b, llvm::X86::RSP);
-    auto newESP = llvm::BinaryOperator::CreateSub(oldESP,
-                                                  CONST_V<64>(b, (width / 8)),
-                                                  "", b);
-    auto intVal = llvm::CastInst::CreatePointerCast(
-        v, llvm::Type::getInt64Ty(b->getContext()), "", b);
-
-    M_WRITE_0<width>(b, newESP, intVal);
-    R_WRITE<64>(b, llvm::X86::RSP, newESP);
-  }
+  M_WRITE_0<width>(b, newESP, v);
+  R_WRITE<addr_width>(b, xsp, newESP);
 }
 
-template<int width>
-static void doPushV(NativeInstPtr ip, llvm::BasicBlock *&b, llvm::Value *v) {
-  //ESP <- ESP - 4
-  //Memory[ESP] = v
-  auto M = b->getParent()->getParent();
-  if (ArchPointerSize(M) == Pointer32) {
-    auto oldESP = x86::R_READ<32>(b, llvm::X86::ESP);
-    auto newESP = llvm::BinaryOperator::CreateSub(oldESP,
-                                                  CONST_V<32>(b, (width / 8)),
-                                                  "", b);
-
-    M_WRITE_0<width>(b, newESP, v);
-    x86::R_WRITE<32>(b, llvm::X86::ESP, newESP);
-  } else {
-    auto oldRSP = x86_64::R_READ<64>(b, llvm::X86::RSP);
-    auto newRSP = llvm::BinaryOperator::CreateSub(oldRSP,
-                                                  CONST_V<64>(b, (width / 8)),
-                                                  "", b);
-
-    M_WRITE_0<width>(b, newRSP, v);
-    x86_64::R_WRITE<64>(b, llvm::X86::RSP, newRSP);
-  }
+// Like `doPushV`, but `v` is a pointer, e.g. to a function.
+template<int width, int addr_width>
+static void doPushVT(NativeInstPtr ip, llvm::BasicBlock *&b, llvm::Value *v) {
+  auto intVal = llvm::CastInst::CreatePointerCast(
+      v, llvm::Type::getIntNTy(b->getContext(), width), "", b);
+  doPushV<width, addr_width>(ip, b, intVal);
 }
 
 template<int width>
@@ -126,14 +95,14 @@ static InstTransResult doPushAV(NativeInstPtr ip, llvm::BasicBlock *b) {
   // Push(EDI);
   auto Temp = R_READ<width>(b, llvm::X86::ESP);
 
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::EAX));
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::ECX));
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::EDX));
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::EBX));
-  doPushV<width>(ip, b, Temp);
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::EBP));
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::ESI));
-  doPushV<width>(ip, b, R_READ<width>(b, llvm::X86::EDI));
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::EAX));
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::ECX));
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::EDX));
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::EBX));
+  doPushV<width, width>(ip, b, Temp);
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::EBP));
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::ESI));
+  doPushV<width, width>(ip, b, R_READ<width>(b, llvm::X86::EDI));
 
   return ContinueBlock;
 }
@@ -150,7 +119,7 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
   auto vNestingLevel = CONST_V<32>(b, nestingLevel.getImm());
 
   //Push EBP
-  doPushV<32>(ip, b, x86::R_READ<32>(b, llvm::X86::EBP));
+  doPushV<32, 32>(ip, b, x86::R_READ<32>(b, llvm::X86::EBP));
 
   //set FrameTemp equal to the current value in ESP
   auto frameTemp = x86::R_READ<32>(b, llvm::X86::ESP);
@@ -195,7 +164,7 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
   auto nEBP = llvm::BinaryOperator::CreateSub(oEBP, CONST_V<32>(loopBody, 4),
                                               "", loopBody);
   x86::R_WRITE<32>(loopBody, llvm::X86::EBP, nEBP);
-  doPushV<32>(ip, loopBody, nEBP);
+  doPushV<32, 32>(ip, loopBody, nEBP);
 
   //add to the counter
   auto i_inc = llvm::BinaryOperator::CreateAdd(i, CONST_V<32>(loopBody, 1), "",
@@ -204,7 +173,7 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
   llvm::BranchInst::Create(loopHeader, loopBody);
 
   //now at the end of the loop, push the frame temp
-  doPushV<32>(ip, loopEnd, frameTemp);
+  doPushV<32, 32>(ip, loopEnd, frameTemp);
   llvm::BranchInst::Create(cont, loopEnd);
 
   //write the frame temp into EBP
@@ -234,7 +203,7 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
   auto vNestingLevel = CONST_V<64>(b, nestingLevel.getImm());
 
   //Push EBP
-  doPushV<64>(ip, b, R_READ<64>(b, llvm::X86::RBP));
+  doPushV<64, 64>(ip, b, R_READ<64>(b, llvm::X86::RBP));
 
   //set FrameTemp equal to the current value in ESP
   auto frameTemp = R_READ<64>(b, llvm::X86::RSP);
@@ -280,7 +249,7 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
   auto nEBP = llvm::BinaryOperator::CreateSub(oEBP, CONST_V<64>(loopBody, 8),
                                               "", loopBody);
   R_WRITE<64>(loopBody, llvm::X86::RBP, nEBP);
-  doPushV<64>(ip, loopBody, nEBP);
+  doPushV<64, 64>(ip, loopBody, nEBP);
 
   //add to the counter
   auto i_inc = llvm::BinaryOperator::CreateAdd(i, CONST_V<64>(loopBody, 1), "",
@@ -289,7 +258,7 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
   llvm::BranchInst::Create(loopHeader, loopBody);
 
   //now at the end of the loop, push the frame temp
-  doPushV<64>(ip, loopEnd, frameTemp);
+  doPushV<64, 64>(ip, loopEnd, frameTemp);
   llvm::BranchInst::Create(cont, loopEnd);
 
   //write the frame temp into EBP
@@ -306,46 +275,35 @@ static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
 }
 }
 
+template<int addr_width>
 static InstTransResult doEnter(NativeInstPtr ip, llvm::BasicBlock *&b,
                                const llvm::MCOperand &frameSize,
                                const llvm::MCOperand &nestingLevel) {
-  auto M = b->getParent()->getParent();
-  if (ArchPointerSize(M) == Pointer32) {
+  if (32 == addr_width) {
     return x86::doEnter(ip, b, frameSize, nestingLevel);
   } else {
     return x86_64::doEnter(ip, b, frameSize, nestingLevel);
   }
 }
 
+template<int addr_width>
 static InstTransResult doLeave(NativeInstPtr ip, llvm::BasicBlock *b) {
   // LEAVE
-  auto M = b->getParent()->getParent();
-
-  if (ArchPointerSize(M) == Pointer32) {
-    // read EBP
-    auto link_pointer = x86::R_READ<32>(b, llvm::X86::EBP);
-    auto base_pointer = M_READ<32>(ip, b, link_pointer);
-    R_WRITE<32>(b, llvm::X86::EBP, base_pointer);
-
-    //write this to ESP
-    R_WRITE<32>(
-        b,
-        llvm::X86::ESP,
-        llvm::BinaryOperator::Create(llvm::Instruction::Add, link_pointer,
-                                     CONST_V<32>(b, 4), "", b));
-
-  } else {
-    auto link_pointer = x86::R_READ<64>(b, llvm::X86::RBP);
-    auto base_pointer = M_READ<64>(ip, b, link_pointer);
-    R_WRITE<64>(b, llvm::X86::RBP, base_pointer);
-
-    //write this to ESP
-    R_WRITE<64>(
-        b,
-        llvm::X86::RSP,
-        llvm::BinaryOperator::Create(llvm::Instruction::Add, link_pointer,
-                                     CONST_V<64>(b, 8), "", b));
-  }
+  auto xbp = 32 == addr_width ? llvm::X86::EBP : llvm::X86::RBP;
+  auto xsp = 32 == addr_width ? llvm::X86::ESP : llvm::X86::RSP;
+
+  // read EBP
+  auto link_pointer = R_READ<addr_width>(b, xbp);
+  auto base_pointer = M_READ<addr_width>(ip, b, link_pointer);
+  R_WRITE<addr_width>(b, xbp, base_pointer);
+
+  //write this to ESP
+  R_WRITE<addr_width>(
+      b,
+      xsp,
+      llvm::BinaryOperator::Create(llvm::Instruction::Add, link_pointer,
+                                   CONST_V<addr_width>(b, addr_width / 8), "",
+                                   b));
 
   return ContinueBlock;
 }
@@ -374,20 +332,14 @@ static InstTransResult doLeave64(NativeInstPtr ip, llvm::BasicBlock *b) {
   return ContinueBlock;
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doPopR(NativeInstPtr ip, llvm::BasicBlock *&b,
                               const llvm::MCOperand &dst) {
   NASSERT(dst.isReg());
-  auto M = b->getParent()->getParent();
 
   //read the stack pointer
-  llvm::Value *oldRSP = nullptr;
-
-  if (ArchPointerSize(M) == Pointer32) {
-    oldRSP = x86::R_READ<32>(b, llvm::X86::ESP);
-  } else {
-    oldRSP = x86_64::R_READ<64>(b, llvm::X86::RSP);
-  }
+  auto xsp = 32 == addr_width ? llvm::X86::ESP : llvm::X86::RSP;
+  auto oldRSP = R_READ<addr_width>(b, xsp);
 
   //read the value from the memory at the stack pointer address
   auto m = M_READ_0<width>(b, oldRSP);
@@ -396,21 +348,11 @@ static InstTransResult doPopR(NativeInstPtr ip, llvm::BasicBlock *&b,
   R_WRITE<width>(b, dst.getReg(), m);
 
   //add to the stack pointer
-  if (ArchPointerSize(M) == Pointer32) {
-    auto newESP = llvm::BinaryOperator::CreateAdd(oldRSP,
-                                                  CONST_V<32>(b, (width / 8)),
-                                                  "", b);
-
-    //update the stack pointer register
-    x86::R_WRITE<32>(b, llvm::X86::ESP, newESP);
-  } else {
-    auto newRSP = llvm::BinaryOperator::CreateAdd(oldRSP,
-                                                  CONST_V<64>(b, (width / 8)),
-                                                  "", b);
+  auto newRSP = llvm::BinaryOperator::CreateAdd(
+      oldRSP, CONST_V<addr_width>(b, (width / 8)), "", b);
 
-    //update the stack pointer register
-    x86_64::R_WRITE<64>(b, llvm::X86::RSP, newRSP);
-  }
+  //update the stack pointer register
+  R_WRITE<addr_width>(b, xsp, newRSP);
 
   return ContinueBlock;
 }
@@ -448,19 +390,19 @@ static InstTransResult doPopAV(NativeInstPtr ip, llvm::BasicBlock *b) {
   // ECX := Pop();
   // EAX := Pop();
 
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EDI));
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::ESI));
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EBP));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EDI));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::ESI));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EBP));
   doPopV<width>(b);
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EBX));
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EDX));
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::ECX));
-  doPopR<width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EAX));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EBX));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EDX));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::ECX));
+  doPopR<width, width>(ip, b, llvm::MCOperand::createReg(llvm::X86::EAX));
 
   return ContinueBlock;
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doPushR(NativeInstPtr ip, llvm::BasicBlock *&b,
                                const llvm::MCOperand &src) {
   //PUSH <r>
@@ -469,12 +411,12 @@ static InstTransResult doPushR(NativeInstPtr ip, llvm::BasicBlock *&b,
   //first, read from <r> into a temp
   auto TMP = R_READ<width>(b, src.getReg());
 
-  doPushV<width>(ip, b, TMP);
+  doPushV<width, addr_width>(ip, b, TMP);
 
   return ContinueBlock;
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doPushI(NativeInstPtr ip, llvm::BasicBlock *&b,
                                const llvm::MCOperand &src) {
   // PUSH <imm>
@@ -490,16 +432,16 @@ static InstTransResult doPushI(NativeInstPtr ip, llvm::BasicBlock *&b,
     SExt_Val = new llvm::SExtInst(OrigIMM,
                                   llvm::Type::getInt32Ty(b->getContext()), "",
                                   b);
-    doPushV<32>(ip, b, SExt_Val);
+    doPushV<32, addr_width>(ip, b, SExt_Val);
   } else {
     if (width == 32 && ip->has_ext_call_target()) {
       std::string target = ip->get_ext_call_target()->getSymbolName();
       auto M = b->getParent()->getParent();
       auto externFunction = M->getFunction(target);
       NASSERT(externFunction != nullptr);
-      doPushVT<width>(ip, b, externFunction);
+      doPushVT<width, addr_width>(ip, b, externFunction);
     } else {
-      doPushV<width>(ip, b, SExt_Val);
+      doPushV<width, addr_width>(ip, b, SExt_Val);
     }
   }
 
@@ -532,17 +474,18 @@ static InstTransResult doPopM(NativeInstPtr ip, llvm::BasicBlock *&b,
   return ContinueBlock;
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doPushRMM(NativeInstPtr ip, llvm::BasicBlock *&b,
                                  llvm::Value *addr) {
   NASSERT(addr != nullptr);
 
   auto fromMem = M_READ<width>(ip, b, addr);
-  doPushV<width>(ip, b, fromMem);
+  doPushV<width, addr_width>(ip, b, fromMem);
 
   return ContinueBlock;
 }
 
+template <int addr_width>
 static InstTransResult translate_PUSH32rmm(TranslationContext &ctx,
                                            llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -554,16 +497,17 @@ static InstTransResult translate_PUSH32rmm(TranslationContext &ctx,
   if (ip->has_external_ref()) {
     auto addrInt = getValueForExternal<32>(F->getParent(), ip, block);
     TASSERT(addrInt != nullptr, "Could not get address for external");
-    doPushV<32>(ip, block, addrInt);
+    doPushV<32, addr_width>(ip, block, addrInt);
     return ContinueBlock;
   } else if (ip->has_mem_reference) {
-    ret = doPushRMM<32>(ip, block, MEM_AS_DATA_REF(block, natM, inst, ip, 0));
+    ret = doPushRMM<32, addr_width>(ip, block, MEM_REFERENCE(0));
   } else {
-    ret = doPushRMM<32>(ip, block, ADDR_NOREF(0));
+    ret = doPushRMM<32, addr_width>(ip, block, ADDR_NOREF(0));
   }
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_PUSH64rmm(TranslationContext &ctx,
                                            llvm::BasicBlock *&block) {
   InstTransResult ret;
@@ -575,46 +519,45 @@ static InstTransResult translate_PUSH64rmm(TranslationContext &ctx,
   if (ip->has_external_ref()) {
     auto addrInt = getValueForExternal<64>(F->getParent(), ip, block);
     TASSERT(addrInt != nullptr, "Could not get address for external");
-    doPushV<64>(ip, block, addrInt);
+    doPushV<64, addr_width>(ip, block, addrInt);
     return ContinueBlock;
   } else if (ip->has_mem_reference) {
-    ret = doPushRMM<64>(ip, block, MEM_AS_DATA_REF(block, natM, inst, ip, 0));
+    ret = doPushRMM<64, addr_width>(ip, block, MEM_REFERENCE(0));
   } else {
-    ret = doPushRMM<64>(ip, block, ADDR_NOREF(0));
+    ret = doPushRMM<64, addr_width>(ip, block, ADDR_NOREF(0));
   }
   return ret;
 }
 
+template <int addr_width>
 static InstTransResult translate_PUSHi32(TranslationContext &ctx,
                                          llvm::BasicBlock *&block) {
   InstTransResult ret;
   auto natM = ctx.natM;
   auto ip = ctx.natI;
   auto &inst = ip->get_inst();
-  auto F = block->getParent();
   if (ip->has_code_ref()) {
     auto callback_fn = ArchAddCallbackDriver(
         block->getParent()->getParent(), ip->get_reference(NativeInst::IMMRef));
     auto addrInt = new llvm::PtrToIntInst(
         callback_fn, llvm::Type::getInt32Ty(block->getContext()), "", block);
-    doPushV<32>(ip, block, addrInt);
+    doPushV<32, addr_width>(ip, block, addrInt);
     ret = ContinueBlock;
   } else if (ip->has_imm_reference) {
-    auto M = F->getParent();
-    auto ref = IMM_AS_DATA_REF(block, natM, ip);
+    auto ref = IMM_AS_DATA_REF<addr_width>(block, natM, ip);
 
     // this may fail catastrophically, but we can only push those 32-bits
     // or we break the stack
-    if (Pointer64 == ArchPointerSize(M)) {
+    if (64 == addr_width) {
       ref = new llvm::TruncInst(ref,
                                 llvm::Type::getInt32Ty(block->getContext()), "",
                                 block);
     }
 
-    doPushV<32>(ip, block, ref);
+    doPushV<32, addr_width>(ip, block, ref);
     ret = ContinueBlock;
   } else {
-    ret = doPushI<32>(ip, block, OP(0));
+    ret = doPushI<32, addr_width>(ip, block, OP(0));
   }
   return ret;
 }
@@ -667,7 +610,7 @@ static InstTransResult doPopF(NativeInstPtr ip, llvm::BasicBlock *b) {
 
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doPushF(NativeInstPtr ip, llvm::BasicBlock *b) {
 
   // put eflags into one value.
@@ -706,67 +649,71 @@ static InstTransResult doPushF(NativeInstPtr ip, llvm::BasicBlock *b) {
   // rest set to 0
   //
   // push on stack
-  doPushV<width>(ip, b, cur_flags);
+  doPushV<width, addr_width>(ip, b, cur_flags);
 
   return ContinueBlock;
 }
 
-GENERIC_TRANSLATION(PUSHF64, doPushF<64>(ip, block))
-GENERIC_TRANSLATION(PUSHF32, doPushF<32>(ip, block))
+GENERIC_TRANSLATION(PUSHF64, (doPushF<64, addr_width>(ip, block)))
+GENERIC_TRANSLATION(PUSHF32, (doPushF<32, addr_width>(ip, block)))
 GENERIC_TRANSLATION(POPF64, doPopF<64>(ip, block))
 GENERIC_TRANSLATION(POPF32, doPopF<32>(ip, block))
 //GENERIC_TRANSLATION(PUSHF16, doPushF<16>(ip, block))
-GENERIC_TRANSLATION(ENTER, doEnter(ip, block, OP(0), OP(1)))
-GENERIC_TRANSLATION(LEAVE, doLeave(ip, block))
+GENERIC_TRANSLATION(ENTER, doEnter<addr_width>(ip, block, OP(0), OP(1)))
+GENERIC_TRANSLATION(LEAVE, doLeave<addr_width>(ip, block))
 GENERIC_TRANSLATION(LEAVE64, doLeave64(ip, block))
-GENERIC_TRANSLATION(POP16r, doPopR<16>(ip, block, OP(0)))
-GENERIC_TRANSLATION(POP32r, doPopR<32>(ip, block, OP(0)))
+GENERIC_TRANSLATION(POP16r, (doPopR<16, addr_width>(ip, block, OP(0))))
+GENERIC_TRANSLATION(POP32r, (doPopR<32, addr_width>(ip, block, OP(0))))
 
-GENERIC_TRANSLATION(POP64r, doPopR<64>(ip, block, OP(0)))
+GENERIC_TRANSLATION(POP64r, (doPopR<64, addr_width>(ip, block, OP(0))))
 
-GENERIC_TRANSLATION(PUSH16r, doPushR<16>(ip, block, OP(0)))
-GENERIC_TRANSLATION(PUSH32r, doPushR<32>(ip, block, OP(0)))
-GENERIC_TRANSLATION(PUSH64r, doPushR<64>(ip, block, OP(0)))
+GENERIC_TRANSLATION(PUSH16r, (doPushR<16, addr_width>(ip, block, OP(0))))
+GENERIC_TRANSLATION(PUSH32r, (doPushR<32, addr_width>(ip, block, OP(0))))
+GENERIC_TRANSLATION(PUSH64r, (doPushR<64, addr_width>(ip, block, OP(0))))
 GENERIC_TRANSLATION(POPA32, doPopAV<32>(ip, block));
 GENERIC_TRANSLATION(PUSHA32, doPushAV<32>(ip, block));
 //GENERIC_TRANSLATION_REF(PUSH32rmm,
 //        doPushRMM<32>(ip, block, ADDR_NOREF(0)),
 //        doPushRMM<32>(ip, block, MEM_REFERENCE(0)));
-GENERIC_TRANSLATION_REF(PUSHi8, doPushI<8>(ip, block, OP(0)),
-                        doPushV<8>(ip, block, MEM_REFERENCE(0) ))
-GENERIC_TRANSLATION_REF(PUSHi16, doPushI<16>(ip, block, OP(0)),
-                        doPushV<16>(ip, block, MEM_REFERENCE(0) ))
+GENERIC_TRANSLATION_REF(PUSHi8, (doPushI<8, addr_width>(ip, block, OP(0))),
+                        (doPushV<8, addr_width>(ip, block, MEM_REFERENCE(0))))
+GENERIC_TRANSLATION_REF(PUSHi16, (doPushI<16, addr_width>(ip, block, OP(0))),
+                        (doPushV<16, addr_width>(ip, block, MEM_REFERENCE(0))))
 GENERIC_TRANSLATION_REF(POP32rmm, doPopM<32>(ip, block, ADDR_NOREF(0)),
                         doPopM<32>(ip, block, MEM_REFERENCE(0)));
 GENERIC_TRANSLATION_REF(POP64rmm, doPopM<64>(ip, block, ADDR_NOREF(0)),
                         doPopM<32>(ip, block, MEM_REFERENCE(0)));
 
+template <int addr_width>
 void Stack_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::ENTER] = translate_ENTER;
-  m[llvm::X86::LEAVE] = translate_LEAVE;
-  m[llvm::X86::LEAVE64] = translate_LEAVE64;
-  m[llvm::X86::POP16r] = translate_POP16r;
-  m[llvm::X86::POP32r] = translate_POP32r;
-  m[llvm::X86::PUSH16r] = translate_PUSH16r;
-  m[llvm::X86::PUSH32r] = translate_PUSH32r;
-  m[llvm::X86::PUSH32i8] = translate_PUSHi8;
-  m[llvm::X86::PUSHi16] = translate_PUSHi16;
-  m[llvm::X86::PUSHi32] = translate_PUSHi32;
-  m[llvm::X86::PUSH32rmm] = translate_PUSH32rmm;
-  m[llvm::X86::POPA32] = translate_POPA32;
-  m[llvm::X86::PUSHA32] = translate_PUSHA32;
-  m[llvm::X86::PUSHF32] = translate_PUSHF32;
-  m[llvm::X86::PUSHF64] = translate_PUSHF64;
-  m[llvm::X86::POP32rmm] = translate_POP32rmm;
-
-  m[llvm::X86::PUSH64r] = translate_PUSH64r;
-  m[llvm::X86::PUSH64rmr] = translate_PUSH64r;  // TODO(pag): Is this right??
-  m[llvm::X86::PUSH64rmm] = translate_PUSH64rmm;
-  m[llvm::X86::PUSH64i8] = translate_PUSHi8;
-  m[llvm::X86::PUSH64i32] = translate_PUSHi32;
-
-  m[llvm::X86::POP64r] = translate_POP64r;
-  m[llvm::X86::POP64rmm] = translate_POP64rmm;
-  m[llvm::X86::POPF64] = translate_POPF64;
-  m[llvm::X86::POPF32] = translate_POPF32;
+  m[llvm::X86::ENTER] = translate_ENTER<addr_width>;
+  m[llvm::X86::LEAVE] = translate_LEAVE<addr_width>;
+  m[llvm::X86::LEAVE64] = translate_LEAVE64<addr_width>;
+  m[llvm::X86::POP16r] = translate_POP16r<addr_width>;
+  m[llvm::X86::POP32r] = translate_POP32r<addr_width>;
+  m[llvm::X86::PUSH16r] = translate_PUSH16r<addr_width>;
+  m[llvm::X86::PUSH32r] = translate_PUSH32r<addr_width>;
+  m[llvm::X86::PUSH32i8] = translate_PUSHi8<addr_width>;
+  m[llvm::X86::PUSHi16] = translate_PUSHi16<addr_width>;
+  m[llvm::X86::PUSHi32] = translate_PUSHi32<addr_width>;
+  m[llvm::X86::PUSH32rmm] = translate_PUSH32rmm<addr_width>;
+  m[llvm::X86::POPA32] = translate_POPA32<addr_width>;
+  m[llvm::X86::PUSHA32] = translate_PUSHA32<addr_width>;
+  m[llvm::X86::PUSHF32] = translate_PUSHF32<addr_width>;
+  m[llvm::X86::PUSHF64] = translate_PUSHF64<addr_width>;
+  m[llvm::X86::POP32rmm] = translate_POP32rmm<addr_width>;
+
+  m[llvm::X86::PUSH64r] = translate_PUSH64r<addr_width>;
+  m[llvm::X86::PUSH64rmr] = translate_PUSH64r<addr_width>;  // TODO(pag): Is this right??
+  m[llvm::X86::PUSH64rmm] = translate_PUSH64rmm<addr_width>;
+  m[llvm::X86::PUSH64i8] = translate_PUSHi8<addr_width>;
+  m[llvm::X86::PUSH64i32] = translate_PUSHi32<addr_width>;
+
+  m[llvm::X86::POP64r] = translate_POP64r<addr_width>;
+  m[llvm::X86::POP64rmm] = translate_POP64rmm<addr_width>;
+  m[llvm::X86::POPF64] = translate_POPF64<addr_width>;
+  m[llvm::X86::POPF32] = translate_POPF32<addr_width>;
 }
+
+template void Stack_populateDispatchMap<32>(DispatchMap &m);
+template void Stack_populateDispatchMap<64>(DispatchMap &m);
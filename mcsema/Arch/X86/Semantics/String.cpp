@@ -129,17 +129,6 @@ static llvm::BasicBlock *doCmpsV(llvm::BasicBlock *pred) {
   return block_post_write;
 }
 
-template<int width>
-static llvm::BasicBlock *doCmps(llvm::BasicBlock *b) {
-  auto M = b->getParent()->getParent();
-  auto bitWidth = ArchPointerSize(M);
-  if (Pointer32 == bitWidth) {
-    return doCmpsV<width, 32>(b);
-  } else {
-    return doCmpsV<width, 64>(b);
-  }
-}
-
 template<int opSize, int regWidth>
 static llvm::BasicBlock *doStosV(llvm::BasicBlock *pred) {
   //write EAX to [EDI]
@@ -354,34 +343,13 @@ static llvm::BasicBlock *doScasV(llvm::BasicBlock *pred) {
   return doWrite;
 }
 
-template<int width>
-static llvm::BasicBlock *doScas(llvm::BasicBlock *B) {
-  auto M = B->getParent()->getParent();
-  const auto bitWidth = ArchPointerSize(M);
-  if (bitWidth == Pointer32) {
-    return doScasV<width, 32>(B);
-  } else {
-    return doScasV<width, 64>(B);
-  }
-}
-
 // Uses RDI & RSI registers 
-template<int width>
+template<int width, int bitWidth>
 static llvm::BasicBlock *doMovsV(llvm::BasicBlock *pred) {
   auto F = pred->getParent();
-  auto M = F->getParent();
-  auto &C = M->getContext();
-  uint32_t bitWidth = ArchPointerSize(M);
-  llvm::Value *dstRegVal = nullptr;
-  llvm::Value *srcRegVal = nullptr;
-
-  if (bitWidth == 32) {
-    dstRegVal = x86::R_READ<32>(pred, llvm::X86::EDI);
-    srcRegVal = x86::R_READ<32>(pred, llvm::X86::ESI);
-  } else {
-    dstRegVal = x86_64::R_READ<64>(pred, llvm::X86::RDI);
-    srcRegVal = x86_64::R_READ<64>(pred, llvm::X86::RSI);
-  }
+  auto &C = F->getContext();
+  auto dstRegVal = R_READ<bitWidth>(pred, llvm::X86::RDI);
+  auto srcRegVal = R_READ<bitWidth>(pred, llvm::X86::RSI);
 
   //do the actual move
   M_WRITE_0<width>(pred, dstRegVal, M_READ_0<width>(pred, srcRegVal));
@@ -545,81 +513,156 @@ static llvm::BasicBlock *doRepNe(llvm::BasicBlock *b, llvm::BasicBlock *bodyB,
 }
 
 #define DO_REP_CALL(CALL, NAME) \
-    template <int opSize> \
+    template <int opSize, int addr_width> \
     static InstTransResult doRep ## NAME (llvm::BasicBlock *&b) {\
       llvm::BasicBlock *bodyBegin =  \
           llvm::BasicBlock::Create(b->getContext(), "", b->getParent()); \
       llvm::BasicBlock  *bodyEnd = (CALL); \
-      llvm::Module *M = b->getParent()->getParent();\
-      if (ArchPointerSize(M) == Pointer32) {\
-        b = doRepN<opSize,32>(b, bodyBegin, bodyEnd); \
-      } else {\
-        b = doRepN<opSize,64>(b, bodyBegin, bodyEnd); \
-      }\
+      b = doRepN<opSize, addr_width>(b, bodyBegin, bodyEnd); \
       return ContinueBlock; \
     }
 
 #define DO_REPE_CALL(CALL, NAME) \
-    template <int opSize> \
+    template <int opSize, int addr_width> \
     static InstTransResult doRepe ## NAME (llvm::BasicBlock *&b) {\
       llvm::BasicBlock *bodyBegin =  \
           llvm::BasicBlock::Create(b->getContext(), "", b->getParent()); \
       llvm::BasicBlock  *bodyEnd = (CALL); \
-      llvm::Module *M = b->getParent()->getParent();\
-      if (ArchPointerSize(M) == Pointer32) {\
-        b = doRepe<opSize,32>(b, bodyBegin, bodyEnd); \
-      } else {\
-        b = doRepe<opSize,64>(b, bodyBegin, bodyEnd); \
-      }\
+      b = doRepe<opSize, addr_width>(b, bodyBegin, bodyEnd); \
       return ContinueBlock; \
     }
 
 #define DO_REPNE_CALL(CALL, NAME) \
-    template <int opSize> \
+    template <int opSize, int addr_width> \
     static InstTransResult doRepNe ## NAME (llvm::BasicBlock *&b) {\
       llvm::BasicBlock *bodyBegin =  \
           llvm::BasicBlock::Create(b->getContext(), "", b->getParent()); \
       llvm::BasicBlock  *bodyEnd = (CALL); \
-      llvm::Module *M = b->getParent()->getParent();\
-      if (ArchPointerSize(M) == Pointer32) {\
-        b = doRepNe<opSize,32>(b, bodyBegin, bodyEnd); \
-      } else {\
-        b = doRepNe<opSize,64>(b, bodyBegin, bodyEnd); \
-      }\
+      b = doRepNe<opSize, addr_width>(b, bodyBegin, bodyEnd); \
       return ContinueBlock; \
     }
 
-DO_REPE_CALL(doCmps<opSize>(bodyBegin), Cmps)
-DO_REPNE_CALL(doCmps<opSize>(bodyBegin), Cmps)
-DO_REPNE_CALL(doScas<opSize>(bodyBegin), Scas)
+DO_REPE_CALL((doCmpsV<opSize, addr_width>(bodyBegin)), Cmps)
+DO_REPNE_CALL((doCmpsV<opSize, addr_width>(bodyBegin)), Cmps)
+DO_REPNE_CALL((doScasV<opSize, addr_width>(bodyBegin)), Scas)
 
+// Splits a REP-prefixed string instruction into a closed-form path and the
+// element-at-a-time loop. The closed-form path is only entered when the count
+// register is non-zero and DF is clear; `fast` is the block in which to emit
+// it, and it must branch to the returned join block (or to `slow`, if it
+// finds that it can't handle this particular execution).
 template<int opSize, int bitWidth>
-static InstTransResult doRepMovs(llvm::BasicBlock *&b) {
+static llvm::BasicBlock *doRepSplit(llvm::BasicBlock *b,
+                                    llvm::BasicBlock *bodyB,
+                                    llvm::BasicBlock *bodyE,
+                                    llvm::BasicBlock *&fast,
+                                    llvm::BasicBlock *&slow) {
+  auto F = b->getParent();
+  auto &C = F->getContext();
+  auto dfCheck = llvm::BasicBlock::Create(C, "", F);
+  auto rest = llvm::BasicBlock::Create(C, "", F);
+  fast = llvm::BasicBlock::Create(C, "", F);
+  slow = llvm::BasicBlock::Create(C, "", F);
 
-  auto bodyBegin = llvm::BasicBlock::Create(b->getContext(), "",
-                                            b->getParent());
-  auto bodyEnd = doMovsV<opSize>(bodyBegin);
+  auto xcx = 32 == bitWidth ? llvm::X86::ECX : llvm::X86::RCX;
+  auto count = R_READ<bitWidth>(b, xcx);
+  auto isEmpty = new llvm::ICmpInst( *b, llvm::CmpInst::ICMP_EQ, count,
+                                    CONST_V<bitWidth>(b, 0));
+  llvm::BranchInst::Create(rest, dfCheck, isEmpty, b);
+
+  auto dfClear = new llvm::ICmpInst( *dfCheck, llvm::CmpInst::ICMP_EQ,
+                                    F_READ(dfCheck, llvm::X86::DF),
+                                    CONST_V<1>(dfCheck, 0));
+  llvm::BranchInst::Create(fast, slow, dfClear, dfCheck);
+
+  // DF is set; go through the original loop.
+  auto loopRest = doRepN<opSize, bitWidth>(slow, bodyB, bodyE);
+  llvm::BranchInst::Create(rest, loopRest);
+
+  return rest;
+}
+
+// Returns the number of bytes covered by `count` elements of `opSize` bits.
+template<int opSize, int bitWidth>
+static llvm::Value *doRepByteCount(llvm::BasicBlock *b, llvm::Value *count) {
+  if (8 == opSize) {
+    return count;
+  }
+  return llvm::BinaryOperator::CreateMul(
+      count, CONST_V<bitWidth>(b, opSize / 8), "", b);
+}
 
-  b = doRepN<opSize, bitWidth>(b, bodyBegin, bodyEnd);
+// Advances a string register by `bytes` and clears the count register, the
+// way that the loop leaves them once it finishes with DF == 0.
+template<int bitWidth>
+static void doRepAdvance(llvm::BasicBlock *b, MCSemaRegs reg,
+                         llvm::Value *regVal, llvm::Value *bytes) {
+  R_WRITE<bitWidth>(b, reg,
+                    llvm::BinaryOperator::CreateAdd(regVal, bytes, "", b));
+}
 
+template<int bitWidth>
+static void doRepClearCount(llvm::BasicBlock *b) {
+  auto xcx = 32 == bitWidth ? llvm::X86::ECX : llvm::X86::RCX;
+  R_WRITE<bitWidth>(b, xcx, CONST_V<bitWidth>(b, 0));
+}
+
+template<int opSize, int bitWidth>
+static InstTransResult doRepMovs(llvm::BasicBlock *&b) {
+  auto &C = b->getContext();
+  auto F = b->getParent();
+  auto M = F->getParent();
+  auto bodyBegin = llvm::BasicBlock::Create(C, "", F);
+  auto bodyEnd = doMovsV<opSize, bitWidth>(bodyBegin);
+
+  llvm::BasicBlock *fast = nullptr;
+  llvm::BasicBlock *slow = nullptr;
+  auto rest = doRepSplit<opSize, bitWidth>(b, bodyBegin, bodyEnd, fast, slow);
+
+  auto xcx = 32 == bitWidth ? llvm::X86::ECX : llvm::X86::RCX;
+  auto count = R_READ<bitWidth>(fast, xcx);
+  auto srcRegVal = R_READ<bitWidth>(fast, llvm::X86::RSI);
+  auto dstRegVal = R_READ<bitWidth>(fast, llvm::X86::RDI);
+  auto bytes = doRepByteCount<opSize, bitWidth>(fast, count);
+
+  // A forward element-at-a-time copy into a destination that starts inside
+  // of the source replicates the leading elements, which `memmove` won't do.
+  // Every other layout (including a destination below an overlapping source)
+  // behaves exactly like `memmove`.
+  auto distance = llvm::BinaryOperator::CreateSub(dstRegVal, srcRegVal, "",
+                                                  fast);
+  auto canMove = new llvm::ICmpInst( *fast, llvm::CmpInst::ICMP_UGE, distance,
+                                    bytes);
+  auto doMove = llvm::BasicBlock::Create(C, "", F);
+  llvm::BranchInst::Create(doMove, slow, canMove, fast);
+
+  llvm::Type *Tys[] = {llvm::Type::getInt8PtrTy(C), llvm::Type::getInt8PtrTy(C),
+      bytes->getType()};
+  auto memMove = llvm::Intrinsic::getDeclaration(M, llvm::Intrinsic::memmove,
+                                                 Tys);
+  llvm::Value *moveArgs[] = {ADDR_TO_POINTER<8>(doMove, dstRegVal),
+      ADDR_TO_POINTER<8>(doMove, srcRegVal), bytes, CONST_V<32>(doMove, 1),
+      CONST_V<1>(doMove, 0)};
+  llvm::CallInst::Create(memMove, moveArgs, "", doMove);
+
+  doRepAdvance<bitWidth>(doMove, llvm::X86::RSI, srcRegVal, bytes);
+  doRepAdvance<bitWidth>(doMove, llvm::X86::RDI, dstRegVal, bytes);
+  doRepClearCount<bitWidth>(doMove);
+  llvm::BranchInst::Create(rest, doMove);
+
+  b = rest;
   return ContinueBlock;
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doMovs(llvm::BasicBlock *&b, NativeInstPtr ip) {
   //we will just kind of paste a new block into the end
   //here so that we have less duplicated logic
-  llvm::Module *M = b->getParent()->getParent();
-  int bitWidth = ArchPointerSize(M);
   NativeInst::Prefix pfx = ip->get_prefix();
   if (pfx == NativeInst::RepPrefix) {
-    if (bitWidth == Pointer32) {
-      doRepMovs<width, 32>(b);
-    } else {
-      doRepMovs<width, 64>(b);
-    }
+    doRepMovs<width, addr_width>(b);
   } else {
-    b = doMovsV<width>(b);
+    b = doMovsV<width, addr_width>(b);
   }
 
   return ContinueBlock;
@@ -627,10 +670,59 @@ static InstTransResult doMovs(llvm::BasicBlock *&b, NativeInstPtr ip) {
 
 template<int opSize, int bitWidth>
 static InstTransResult doRepStos(llvm::BasicBlock *&b) {
-  auto bodyBegin = llvm::BasicBlock::Create(b->getContext(), "",
-                                            b->getParent());
+  auto &C = b->getContext();
+  auto F = b->getParent();
+  auto M = F->getParent();
+  auto bodyBegin = llvm::BasicBlock::Create(C, "", F);
   auto bodyEnd = doStosV<opSize, bitWidth>(bodyBegin);
-  b = doRepN<opSize, bitWidth>(b, bodyBegin, bodyEnd);
+
+  llvm::BasicBlock *fast = nullptr;
+  llvm::BasicBlock *slow = nullptr;
+  auto rest = doRepSplit<opSize, bitWidth>(b, bodyBegin, bodyEnd, fast, slow);
+
+  auto xcx = 32 == bitWidth ? llvm::X86::ECX : llvm::X86::RCX;
+  auto count = R_READ<bitWidth>(fast, xcx);
+  auto dstRegVal = R_READ<bitWidth>(fast, llvm::X86::RDI);
+  auto fromEax = R_READ<opSize>(fast, llvm::X86::RAX);
+  auto bytes = doRepByteCount<opSize, bitWidth>(fast, count);
+  auto fillEnd = fast;
+
+  if (8 == opSize) {
+    llvm::Type *Tys[] = {llvm::Type::getInt8PtrTy(C), bytes->getType()};
+    auto memSet = llvm::Intrinsic::getDeclaration(M, llvm::Intrinsic::memset,
+                                                  Tys);
+    llvm::Value *setArgs[] = {ADDR_TO_POINTER<8>(fast, dstRegVal), fromEax,
+        bytes, CONST_V<32>(fast, 1), CONST_V<1>(fast, 0)};
+    llvm::CallInst::Create(memSet, setArgs, "", fast);
+
+  // There is no pattern `memset`, so fill wider elements with a plain loop
+  // that keeps the index in SSA form; the loop idiom recognizer and the
+  // vectorizer can take it from there.
+  } else {
+    auto fill = llvm::BasicBlock::Create(C, "", F);
+    fillEnd = llvm::BasicBlock::Create(C, "", F);
+    auto elemPtrTy = llvm::Type::getIntNPtrTy(C, opSize);
+    auto basePtr = ADDR_TO_POINTER_V(fast, dstRegVal, elemPtrTy);
+    llvm::BranchInst::Create(fill, fast);
+
+    auto index = llvm::PHINode::Create(count->getType(), 2, "", fill);
+    index->addIncoming(CONST_V<bitWidth>(fast, 0), fast);
+    auto elemPtr = llvm::GetElementPtrInst::Create(
+        llvm::Type::getIntNTy(C, opSize), basePtr, index, "", fill);
+    (void) new llvm::StoreInst(fromEax, elemPtr, fill);
+    auto nextIndex = llvm::BinaryOperator::CreateAdd(
+        index, CONST_V<bitWidth>(fill, 1), "", fill);
+    index->addIncoming(nextIndex, fill);
+    auto isDone = new llvm::ICmpInst( *fill, llvm::CmpInst::ICMP_EQ,
+                                     nextIndex, count);
+    llvm::BranchInst::Create(fillEnd, fill, isDone, fill);
+  }
+
+  doRepAdvance<bitWidth>(fillEnd, llvm::X86::RDI, dstRegVal, bytes);
+  doRepClearCount<bitWidth>(fillEnd);
+  llvm::BranchInst::Create(rest, fillEnd);
+
+  b = rest;
   return ContinueBlock;
 }
 
@@ -640,49 +732,49 @@ static InstTransResult doRepLods(llvm::BasicBlock *&b) {
   auto bodyBegin = llvm::BasicBlock::Create(b->getContext(), "",
                                             b->getParent());
   auto bodyEnd = doLodsV<opSize, bitWidth>(bodyBegin);
-  b = doRepN<opSize, bitWidth>(b, bodyBegin, bodyEnd);
+
+  llvm::BasicBlock *fast = nullptr;
+  llvm::BasicBlock *slow = nullptr;
+  auto rest = doRepSplit<opSize, bitWidth>(b, bodyBegin, bodyEnd, fast, slow);
+
+  // Only the last element loaded survives in EAX.
+  auto xcx = 32 == bitWidth ? llvm::X86::ECX : llvm::X86::RCX;
+  auto count = R_READ<bitWidth>(fast, xcx);
+  auto srcRegVal = R_READ<bitWidth>(fast, llvm::X86::RSI);
+  auto bytes = doRepByteCount<opSize, bitWidth>(fast, count);
+  auto lastAddr = llvm::BinaryOperator::CreateAdd(
+      srcRegVal, llvm::BinaryOperator::CreateSub(
+          bytes, CONST_V<bitWidth>(fast, opSize / 8), "", fast),
+      "", fast);
+  R_WRITE<opSize>(fast, llvm::X86::RAX, M_READ_0<opSize>(fast, lastAddr));
+
+  doRepAdvance<bitWidth>(fast, llvm::X86::RSI, srcRegVal, bytes);
+  doRepClearCount<bitWidth>(fast);
+  llvm::BranchInst::Create(rest, fast);
+
+  b = rest;
   return ContinueBlock;
 }
 
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doStos(llvm::BasicBlock *&b, NativeInstPtr ip) {
-  auto M = b->getParent()->getParent();
-  auto bitWidth = ArchPointerSize(M);
   NativeInst::Prefix pfx = ip->get_prefix();
-  if (bitWidth == Pointer32) {
-    if (pfx == NativeInst::RepPrefix) {
-      doRepStos<width, 32>(b);
-    } else {
-      b = doStosV<width, 32>(b);
-    }
+  if (pfx == NativeInst::RepPrefix) {
+    doRepStos<width, addr_width>(b);
   } else {
-    if (pfx == NativeInst::RepPrefix) {
-      doRepStos<width, 64>(b);
-    } else {
-      b = doStosV<width, 64>(b);
-    }
+    b = doStosV<width, addr_width>(b);
   }
   return ContinueBlock;
 }
 
-template<int width>
+template<int width, int addr_width>
 static InstTransResult doLods(llvm::BasicBlock *&b, NativeInstPtr ip) {
-  auto M = b->getParent()->getParent();
-  auto bitWidth = ArchPointerSize(M);
   NativeInst::Prefix pfx = ip->get_prefix();
-  if (bitWidth == Pointer32) {
-    if (pfx == NativeInst::RepPrefix) {
-      doRepLods<width, 32>(b);
-    } else {
-      b = doLodsV<width, 32>(b);
-    }
+  if (pfx == NativeInst::RepPrefix) {
+    doRepLods<width, addr_width>(b);
   } else {
-    if (pfx == NativeInst::RepPrefix) {
-      doRepLods<width, 64>(b);
-    } else {
-      b = doLodsV<width, 64>(b);
-    }
+    b = doLodsV<width, addr_width>(b);
   }
   return ContinueBlock;
 }
@@ -696,28 +788,28 @@ static InstTransResult translate_REP_prefix(
   return ContinueBlock;
 }
 
-GENERIC_TRANSLATION(MOVSD, doMovs<32>(block, ip))
+GENERIC_TRANSLATION(MOVSD, (doMovs<32, addr_width>(block, ip)))
 GENERIC_TRANSLATION(REP_MOVSD_32, (doRepMovs<32, 32>(block)))
-GENERIC_TRANSLATION(MOVSW, doMovs<16>(block, ip))
+GENERIC_TRANSLATION(MOVSW, (doMovs<16, addr_width>(block, ip)))
 GENERIC_TRANSLATION(REP_MOVSW_32, (doRepMovs<16, 32>(block)))
-GENERIC_TRANSLATION(MOVSB, doMovs<8>(block, ip))
+GENERIC_TRANSLATION(MOVSB, (doMovs<8, addr_width>(block, ip)))
 GENERIC_TRANSLATION(REP_MOVSB_32, (doRepMovs<8, 32>(block)))
 
-GENERIC_TRANSLATION(MOVSQ, doMovs<64>(block, ip))
+GENERIC_TRANSLATION(MOVSQ, (doMovs<64, addr_width>(block, ip)))
 GENERIC_TRANSLATION(REP_MOVSB_64, (doRepMovs<8, 64>(block)))
 GENERIC_TRANSLATION(REP_MOVSW_64, (doRepMovs<16, 64>(block)))
 GENERIC_TRANSLATION(REP_MOVSD_64, (doRepMovs<32, 64>(block)))
 GENERIC_TRANSLATION(REP_MOVSQ_64, (doRepMovs<64, 64>(block)))
 
-GENERIC_TRANSLATION(STOSQ, doStos<64>(block, ip))
-GENERIC_TRANSLATION(STOSD, doStos<32>(block, ip))
-GENERIC_TRANSLATION(STOSW, doStos<16>(block, ip))
-GENERIC_TRANSLATION(STOSB, doStos<8>(block, ip))
+GENERIC_TRANSLATION(STOSQ, (doStos<64, addr_width>(block, ip)))
+GENERIC_TRANSLATION(STOSD, (doStos<32, addr_width>(block, ip)))
+GENERIC_TRANSLATION(STOSW, (doStos<16, addr_width>(block, ip)))
+GENERIC_TRANSLATION(STOSB, (doStos<8, addr_width>(block, ip)))
 
-GENERIC_TRANSLATION(LODSQ, doLods<64>(block, ip))
-GENERIC_TRANSLATION(LODSD, doLods<32>(block, ip))
-GENERIC_TRANSLATION(LODSW, doLods<16>(block, ip))
-GENERIC_TRANSLATION(LODSB, doLods<8>(block, ip))
+GENERIC_TRANSLATION(LODSQ, (doLods<64, addr_width>(block, ip)))
+GENERIC_TRANSLATION(LODSD, (doLods<32, addr_width>(block, ip)))
+GENERIC_TRANSLATION(LODSW, (doLods<16, addr_width>(block, ip)))
+GENERIC_TRANSLATION(LODSB, (doLods<8, addr_width>(block, ip)))
 
 GENERIC_TRANSLATION(REP_STOSB_64, (doRepStos<8, 64>(block)))
 GENERIC_TRANSLATION(REP_STOSW_64, (doRepStos<16, 64>(block)))
@@ -729,6 +821,7 @@ GENERIC_TRANSLATION(REP_STOSW_32, (doRepStos<16, 32>(block)))
 GENERIC_TRANSLATION(REP_STOSD_32, (doRepStos<32, 32>(block)))
 
 #define SCAS_TRANSLATION(NAME, WIDTH) \
+    template <int addr_width> \
     static InstTransResult translate_ ## NAME ( \
         TranslationContext &ctx, llvm::BasicBlock *&block) {\
     auto natM = ctx.natM; \
@@ -738,14 +831,14 @@ GENERIC_TRANSLATION(REP_STOSD_32, (doRepStos<32, 32>(block)))
     NativeInst::Prefix pfx = ip->get_prefix();\
     switch (pfx) { \
       case NativeInst::NoPrefix: \
-        block = doScas<WIDTH>(block); \
+        block = doScasV<WIDTH, addr_width>(block); \
         return ContinueBlock; \
         break; \
       case NativeInst::RepPrefix: \
         throw TErr(__LINE__, __FILE__, "NIY"); \
         break; \
       case NativeInst::RepNePrefix: \
-        ret = doRepNeScas<WIDTH>(block); \
+        ret = doRepNeScas<WIDTH, addr_width>(block); \
         break; \
       default: \
         throw TErr(__LINE__, __FILE__, "NIY"); \
@@ -756,6 +849,7 @@ GENERIC_TRANSLATION(REP_STOSD_32, (doRepStos<32, 32>(block)))
 
 
 #define CMPS_TRANSLATION(NAME, WIDTH) \
+    template <int addr_width> \
     static InstTransResult translate_ ## NAME ( \
         TranslationContext &ctx, llvm::BasicBlock *&block) {\
     auto natM = ctx.natM; \
@@ -765,14 +859,14 @@ GENERIC_TRANSLATION(REP_STOSD_32, (doRepStos<32, 32>(block)))
     NativeInst::Prefix pfx = ip->get_prefix();\
     switch(pfx) { \
       case NativeInst::NoPrefix: \
-        block = doCmps<WIDTH>(block); \
+        block = doCmpsV<WIDTH, addr_width>(block); \
         ret = ContinueBlock; \
         break; \
       case NativeInst::RepPrefix: \
-        ret = doRepeCmps<WIDTH>(block); \
+        ret = doRepeCmps<WIDTH, addr_width>(block); \
         break; \
       case NativeInst::RepNePrefix: \
-        ret = doRepNeCmps<WIDTH>(block); \
+        ret = doRepNeCmps<WIDTH, addr_width>(block); \
         break; \
       default: \
         throw TErr(__LINE__, __FILE__, "NIY"); \
@@ -790,86 +884,90 @@ CMPS_TRANSLATION(CMPS16, 16)
 CMPS_TRANSLATION(CMPS32, 32)
 CMPS_TRANSLATION(CMPS64, 64)
 
+template <int addr_width>
 void String_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::MOVSL] = translate_MOVSD;
-  m[llvm::X86::MOVSW] = translate_MOVSW;
-  m[llvm::X86::MOVSB] = translate_MOVSB;
-  m[llvm::X86::REP_MOVSD_32] = translate_REP_MOVSD_32;
-  m[llvm::X86::REP_MOVSW_32] = translate_REP_MOVSW_32;
-  m[llvm::X86::REP_MOVSB_32] = translate_REP_MOVSB_32;
-
-  m[llvm::X86::MOVSQ] = translate_MOVSQ;
-  m[llvm::X86::REP_MOVSB_64] = translate_REP_MOVSB_64;
-  m[llvm::X86::REP_MOVSW_64] = translate_REP_MOVSW_64;
-  m[llvm::X86::REP_MOVSD_64] = translate_REP_MOVSD_64;
-  m[llvm::X86::REP_MOVSQ_64] = translate_REP_MOVSQ_64;
-
-  m[llvm::X86::STOSL] = translate_STOSD;
-  m[llvm::X86::STOSW] = translate_STOSW;
-  m[llvm::X86::STOSB] = translate_STOSB;
-  m[llvm::X86::STOSQ] = translate_STOSQ;
-
-
-  m[llvm::X86::LODSL] = translate_LODSD;
-  m[llvm::X86::LODSW] = translate_LODSW;
-  m[llvm::X86::LODSB] = translate_LODSB;
-  m[llvm::X86::LODSQ] = translate_LODSQ;
-
-  m[llvm::X86::REP_STOSB_32] = translate_REP_STOSB_32;
-  m[llvm::X86::REP_STOSW_32] = translate_REP_STOSW_32;
-  m[llvm::X86::REP_STOSD_32] = translate_REP_STOSD_32;
-
-  m[llvm::X86::REP_STOSB_64] = translate_REP_STOSB_64;
-  m[llvm::X86::REP_STOSW_64] = translate_REP_STOSW_64;
-  m[llvm::X86::REP_STOSD_64] = translate_REP_STOSD_64;
-  m[llvm::X86::REP_STOSQ_64] = translate_REP_STOSQ_64;
-
-  m[llvm::X86::SCASW] = translate_SCAS16;
-  m[llvm::X86::SCASL] = translate_SCAS32;
-  m[llvm::X86::SCASB] = translate_SCAS8;
-  m[llvm::X86::SCASQ] = translate_SCAS64;
-
-  m[llvm::X86::REPE_SCASB_32] = translate_SCAS8;
-  m[llvm::X86::REPE_SCASW_32] = translate_SCAS16;
-  m[llvm::X86::REPE_SCASD_32] = translate_SCAS32;
-
-  m[llvm::X86::REPE_SCASB_64] = translate_SCAS8;
-  m[llvm::X86::REPE_SCASW_64] = translate_SCAS16;
-  m[llvm::X86::REPE_SCASD_64] = translate_SCAS32;
-  m[llvm::X86::REPE_SCASQ_64] = translate_SCAS64;
-
-  m[llvm::X86::REPNE_SCASB_32] = translate_SCAS8;
-  m[llvm::X86::REPNE_SCASW_32] = translate_SCAS16;
-  m[llvm::X86::REPNE_SCASD_32] = translate_SCAS32;
-
-  m[llvm::X86::REPNE_SCASB_64] = translate_SCAS8;
-  m[llvm::X86::REPNE_SCASW_64] = translate_SCAS16;
-  m[llvm::X86::REPNE_SCASD_64] = translate_SCAS32;
-  m[llvm::X86::REPNE_SCASQ_64] = translate_SCAS64;
-
-  m[llvm::X86::CMPSB] = translate_CMPS8;
-  m[llvm::X86::CMPSW] = translate_CMPS16;
-  m[llvm::X86::CMPSL] = translate_CMPS32;
-  m[llvm::X86::CMPSQ] = translate_CMPS64;
-
-  m[llvm::X86::REPE_CMPSB_32] = translate_CMPS8;
-  m[llvm::X86::REPE_CMPSW_32] = translate_CMPS16;
-  m[llvm::X86::REPE_CMPSD_32] = translate_CMPS32;
-
-  m[llvm::X86::REPE_CMPSB_64] = translate_CMPS8;
-  m[llvm::X86::REPE_CMPSW_64] = translate_CMPS16;
-  m[llvm::X86::REPE_CMPSD_64] = translate_CMPS32;
-  m[llvm::X86::REPE_CMPSQ_64] = translate_CMPS64;
-
-  m[llvm::X86::REPNE_CMPSB_32] = translate_CMPS8;
-  m[llvm::X86::REPNE_CMPSW_32] = translate_CMPS16;
-  m[llvm::X86::REPNE_CMPSD_32] = translate_CMPS32;
-
-  m[llvm::X86::REPNE_CMPSB_64] = translate_CMPS8;
-  m[llvm::X86::REPNE_CMPSW_64] = translate_CMPS16;
-  m[llvm::X86::REPNE_CMPSD_64] = translate_CMPS32;
-  m[llvm::X86::REPNE_CMPSQ_64] = translate_CMPS64;
+  m[llvm::X86::MOVSL] = translate_MOVSD<addr_width>;
+  m[llvm::X86::MOVSW] = translate_MOVSW<addr_width>;
+  m[llvm::X86::MOVSB] = translate_MOVSB<addr_width>;
+  m[llvm::X86::REP_MOVSD_32] = translate_REP_MOVSD_32<addr_width>;
+  m[llvm::X86::REP_MOVSW_32] = translate_REP_MOVSW_32<addr_width>;
+  m[llvm::X86::REP_MOVSB_32] = translate_REP_MOVSB_32<addr_width>;
+
+  m[llvm::X86::MOVSQ] = translate_MOVSQ<addr_width>;
+  m[llvm::X86::REP_MOVSB_64] = translate_REP_MOVSB_64<addr_width>;
+  m[llvm::X86::REP_MOVSW_64] = translate_REP_MOVSW_64<addr_width>;
+  m[llvm::X86::REP_MOVSD_64] = translate_REP_MOVSD_64<addr_width>;
+  m[llvm::X86::REP_MOVSQ_64] = translate_REP_MOVSQ_64<addr_width>;
+
+  m[llvm::X86::STOSL] = translate_STOSD<addr_width>;
+  m[llvm::X86::STOSW] = translate_STOSW<addr_width>;
+  m[llvm::X86::STOSB] = translate_STOSB<addr_width>;
+  m[llvm::X86::STOSQ] = translate_STOSQ<addr_width>;
+
+
+  m[llvm::X86::LODSL] = translate_LODSD<addr_width>;
+  m[llvm::X86::LODSW] = translate_LODSW<addr_width>;
+  m[llvm::X86::LODSB] = translate_LODSB<addr_width>;
+  m[llvm::X86::LODSQ] = translate_LODSQ<addr_width>;
+
+  m[llvm::X86::REP_STOSB_32] = translate_REP_STOSB_32<addr_width>;
+  m[llvm::X86::REP_STOSW_32] = translate_REP_STOSW_32<addr_width>;
+  m[llvm::X86::REP_STOSD_32] = translate_REP_STOSD_32<addr_width>;
+
+  m[llvm::X86::REP_STOSB_64] = translate_REP_STOSB_64<addr_width>;
+  m[llvm::X86::REP_STOSW_64] = translate_REP_STOSW_64<addr_width>;
+  m[llvm::X86::REP_STOSD_64] = translate_REP_STOSD_64<addr_width>;
+  m[llvm::X86::REP_STOSQ_64] = translate_REP_STOSQ_64<addr_width>;
+
+  m[llvm::X86::SCASW] = translate_SCAS16<addr_width>;
+  m[llvm::X86::SCASL] = translate_SCAS32<addr_width>;
+  m[llvm::X86::SCASB] = translate_SCAS8<addr_width>;
+  m[llvm::X86::SCASQ] = translate_SCAS64<addr_width>;
+
+  m[llvm::X86::REPE_SCASB_32] = translate_SCAS8<addr_width>;
+  m[llvm::X86::REPE_SCASW_32] = translate_SCAS16<addr_width>;
+  m[llvm::X86::REPE_SCASD_32] = translate_SCAS32<addr_width>;
+
+  m[llvm::X86::REPE_SCASB_64] = translate_SCAS8<addr_width>;
+  m[llvm::X86::REPE_SCASW_64] = translate_SCAS16<addr_width>;
+  m[llvm::X86::REPE_SCASD_64] = translate_SCAS32<addr_width>;
+  m[llvm::X86::REPE_SCASQ_64] = translate_SCAS64<addr_width>;
+
+  m[llvm::X86::REPNE_SCASB_32] = translate_SCAS8<addr_width>;
+  m[llvm::X86::REPNE_SCASW_32] = translate_SCAS16<addr_width>;
+  m[llvm::X86::REPNE_SCASD_32] = translate_SCAS32<addr_width>;
+
+  m[llvm::X86::REPNE_SCASB_64] = translate_SCAS8<addr_width>;
+  m[llvm::X86::REPNE_SCASW_64] = translate_SCAS16<addr_width>;
+  m[llvm::X86::REPNE_SCASD_64] = translate_SCAS32<addr_width>;
+  m[llvm::X86::REPNE_SCASQ_64] = translate_SCAS64<addr_width>;
+
+  m[llvm::X86::CMPSB] = translate_CMPS8<addr_width>;
+  m[llvm::X86::CMPSW] = translate_CMPS16<addr_width>;
+  m[llvm::X86::CMPSL] = translate_CMPS32<addr_width>;
+  m[llvm::X86::CMPSQ] = translate_CMPS64<addr_width>;
+
+  m[llvm::X86::REPE_CMPSB_32] = translate_CMPS8<addr_width>;
+  m[llvm::X86::REPE_CMPSW_32] = translate_CMPS16<addr_width>;
+  m[llvm::X86::REPE_CMPSD_32] = translate_CMPS32<addr_width>;
+
+  m[llvm::X86::REPE_CMPSB_64] = translate_CMPS8<addr_width>;
+  m[llvm::X86::REPE_CMPSW_64] = translate_CMPS16<addr_width>;
+  m[llvm::X86::REPE_CMPSD_64] = translate_CMPS32<addr_width>;
+  m[llvm::X86::REPE_CMPSQ_64] = translate_CMPS64<addr_width>;
+
+  m[llvm::X86::REPNE_CMPSB_32] = translate_CMPS8<addr_width>;
+  m[llvm::X86::REPNE_CMPSW_32] = translate_CMPS16<addr_width>;
+  m[llvm::X86::REPNE_CMPSD_32] = translate_CMPS32<addr_width>;
+
+  m[llvm::X86::REPNE_CMPSB_64] = translate_CMPS8<addr_width>;
+  m[llvm::X86::REPNE_CMPSW_64] = translate_CMPS16<addr_width>;
+  m[llvm::X86::REPNE_CMPSD_64] = translate_CMPS32<addr_width>;
+  m[llvm::X86::REPNE_CMPSQ_64] = translate_CMPS64<addr_width>;
 
   m[llvm::X86::REP_PREFIX] = translate_REP_prefix;
   m[llvm::X86::REPNE_PREFIX] = translate_REP_prefix;
 }
+
+template void String_populateDispatchMap<32>(DispatchMap &m);
+template void String_populateDispatchMap<64>(DispatchMap &m);
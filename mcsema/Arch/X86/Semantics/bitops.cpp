@@ -510,16 +510,16 @@ GENERIC_TRANSLATION_REF(
 GENERIC_TRANSLATION_MI(
     AND32mi, doAndMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doAndMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doAndMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doAndMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doAndMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doAndMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(AND64mi8, doAndMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
                         doAndMI<64>(ip, block, MEM_REFERENCE(0), OP(5)))
 GENERIC_TRANSLATION_MI(
     AND64mi32, doAndMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
     doAndMI<64>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doAndMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doAndMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doAndMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doAndMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(AND32mi8, doAndMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doAndMI<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -534,12 +534,12 @@ GENERIC_TRANSLATION(AND64ri8, doAndRI<64>(ip, block, OP(0), OP(1), OP(2)))
 //GENERIC_TRANSLATION(AND64ri32, doAndRI<64>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION_REF(
     AND64ri32, doAndRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doAndRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doAndRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 //GENERIC_TRANSLATION(AND64i32, doAndRI<64>(ip, block, MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX), OP(0)))
 GENERIC_TRANSLATION_REF(
     AND64i32,
     doAndRI<64>(ip, block, MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX), OP(0)),
-    doAndRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip),
+    doAndRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip),
                 MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX)))
 
 GENERIC_TRANSLATION_REF(AND32rm,
@@ -603,17 +603,17 @@ GENERIC_TRANSLATION_REF(
 GENERIC_TRANSLATION_REF(
     OR64i32,
     doOrRI<64>(ip, block, MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX), OP(0)),
-    doOrRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip),
+    doOrRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip),
                MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX)))
 GENERIC_TRANSLATION_REF(
     OR64ri32, doOrRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doOrRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doOrRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 
 GENERIC_TRANSLATION_MI(
     OR32mi, doOrMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doOrMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doOrMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doOrMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doOrMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doOrMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(OR32mi8, doOrMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doOrMI<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -639,8 +639,8 @@ GENERIC_TRANSLATION_REF(OR64mi8, doOrMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
 GENERIC_TRANSLATION_MI(
     OR64mi32, doOrMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
     doOrMI<64>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doOrMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doOrMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doOrMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doOrMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION(
     OR8i8,
@@ -674,8 +674,8 @@ GENERIC_TRANSLATION(XOR16rr_REV, doXorRR<16>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION_MI(
     XOR32mi, doXorMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
     doXorMI<32>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doXorMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doXorMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doXorMV<32>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doXorMV<32>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION_REF(XOR32mi8, doXorMI<32>(ip, block, ADDR_NOREF(0), OP(5)),
                         doXorMI<32>(ip, block, MEM_REFERENCE(0), OP(5)))
@@ -694,11 +694,11 @@ GENERIC_TRANSLATION_REF(
 GENERIC_TRANSLATION_REF(
     XOR64i32,
     doXorRI<64>(ip, block, MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX), OP(0)),
-    doXorRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip),
+    doXorRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip),
                 MCOperand::createReg(X86::RAX), MCOperand::createReg(X86::RAX)))
 GENERIC_TRANSLATION_REF(
     XOR64ri32, doXorRI<64>(ip, block, OP(0), OP(1), OP(2)),
-    doXorRV<64>(ip, block, IMM_AS_DATA_REF(block, natM, ip), OP(0), OP(1)))
+    doXorRV<64>(ip, block, IMM_AS_DATA_REF<addr_width>(block, natM, ip), OP(0), OP(1)))
 
 GENERIC_TRANSLATION_REF(XOR32rm,
                         doXorRM<32>(ip, block, OP(0), OP(1), ADDR_NOREF(2)),
@@ -716,8 +716,8 @@ GENERIC_TRANSLATION_REF(XOR64mi8, doXorMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
 GENERIC_TRANSLATION_MI(
     XOR64mi32, doXorMI<64>(ip, block, ADDR_NOREF(0), OP(5)),
     doXorMI<64>(ip, block, MEM_REFERENCE(0), OP(5)),
-    doXorMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF(block, natM, ip)),
-    doXorMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF(block, natM, ip)))
+    doXorMV<64>(ip, block, ADDR_NOREF(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)),
+    doXorMV<64>(ip, block, MEM_REFERENCE(0), IMM_AS_DATA_REF<addr_width>(block, natM, ip)))
 
 GENERIC_TRANSLATION(
     XOR8i8,
@@ -733,119 +733,123 @@ GENERIC_TRANSLATION_REF(XOR8rm,
 GENERIC_TRANSLATION(XOR8rr, doXorRR<8>(ip, block, OP(0), OP(1), OP(2)))
 GENERIC_TRANSLATION(XOR8rr_REV, doXorRR<8>(ip, block, OP(0), OP(1), OP(2)))
 
+template <int addr_width>
 void Bitops_populateDispatchMap(DispatchMap &m) {
-  m[X86::AND16i16] = translate_AND16i16;
-  m[X86::AND16mi] = translate_AND16mi;
-  m[X86::AND16mi8] = translate_AND16mi8;
-  m[X86::AND16mr] = translate_AND16mr;
-  m[X86::AND16ri] = translate_AND16ri;
-  m[X86::AND16ri8] = translate_AND16ri8;
-  m[X86::AND16rm] = translate_AND16rm;
-  m[X86::AND16rr] = translate_AND16rr;
-  m[X86::AND16rr_REV] = translate_AND16rr_REV;
-  m[X86::AND32i32] = translate_AND32i32;
-  m[X86::AND32mi] = translate_AND32mi;
-  m[X86::AND32mi8] = translate_AND32mi8;
-  m[X86::AND32mr] = translate_AND32mr;
-  m[X86::AND32ri] = translate_AND32ri;
-  m[X86::AND32ri8] = translate_AND32ri8;
-  m[X86::AND32rm] = translate_AND32rm;
-  m[X86::AND32rr] = translate_AND32rr;
-  m[X86::AND32rr_REV] = translate_AND32rr_REV;
-  m[X86::AND8i8] = translate_AND8i8;
-  m[X86::AND8mi] = translate_AND8mi;
-  m[X86::AND8mr] = translate_AND8mr;
-  m[X86::AND8ri] = translate_AND8ri;
-  m[X86::AND8rm] = translate_AND8rm;
-  m[X86::AND8rr] = translate_AND8rr;
-  m[X86::AND8rr_REV] = translate_AND8rr_REV;
-  m[X86::AND64ri32] = translate_AND64ri32;
-  m[X86::AND64rr] = translate_AND64rr;
-  m[X86::AND64rr_REV] = translate_AND64rr;
-  m[X86::AND64rm] = translate_AND64rm;
-  m[X86::AND64ri8] = translate_AND64ri8;
-  m[X86::AND64i32] = translate_AND64i32;
-  m[X86::AND64mr] = translate_AND64mr;
-  m[X86::AND64mi8] = translate_AND64mi8;
-  m[X86::AND64mi32] = translate_AND64mi32;
-
-  m[X86::NOT16m] = translate_NOT16m;
-  m[X86::NOT16r] = translate_NOT16r;
-  m[X86::NOT32m] = translate_NOT32m;
-  m[X86::NOT32r] = translate_NOT32r;
-  m[X86::NOT8m] = translate_NOT8m;
-  m[X86::NOT8r] = translate_NOT8r;
-  m[X86::NOT64r] = translate_NOT64r;
-  m[X86::NOT64m] = translate_NOT64m;
-
-  m[X86::OR16i16] = translate_OR16i16;
-  m[X86::OR16mi] = translate_OR16mi;
-  m[X86::OR16mi8] = translate_OR16mi8;
-  m[X86::OR16mr] = translate_OR16mr;
-  m[X86::OR16ri] = translate_OR16ri;
-  m[X86::OR16ri8] = translate_OR16ri8;
-  m[X86::OR16rm] = translate_OR16rm;
-  m[X86::OR16rr] = translate_OR16rr;
-  m[X86::OR16rr_REV] = translate_OR16rr_REV;
-  m[X86::OR32i32] = translate_OR32i32;
-  m[X86::OR64i32] = translate_OR64i32;
-  m[X86::OR64ri32] = translate_OR64ri32;
-  m[X86::OR32mi] = translate_OR32mi;
-  m[X86::OR32mi8] = translate_OR32mi8;
-  m[X86::OR32mr] = translate_OR32mr;
-  m[X86::OR64mr] = translate_OR64mr;
-  m[X86::OR32ri] = translate_OR32ri;
-  m[X86::OR32ri8] = translate_OR32ri8;
-  m[X86::OR32rm] = translate_OR32rm;
-  m[X86::OR32rr] = translate_OR32rr;
-  m[X86::OR32rr_REV] = translate_OR32rr_REV;
-  m[X86::OR64mi32] = translate_OR64mi32;
-
-  m[X86::OR64ri8] = translate_OR64ri8;
-  m[X86::OR64rm] = translate_OR64rm;
-  m[X86::OR64mr] = translate_OR64mr;
-  m[X86::OR64rr] = translate_OR64rr;
-  m[X86::OR64mi8] = translate_OR64mi8;
-
-  m[X86::OR8i8] = translate_OR8i8;
-  m[X86::OR8mi] = translate_OR8mi;
-  m[X86::OR8mr] = translate_OR8mr;
-  m[X86::OR8ri] = translate_OR8ri;
-  m[X86::OR8rm] = translate_OR8rm;
-  m[X86::OR8rr] = translate_OR8rr;
-  m[X86::OR8rr_REV] = translate_OR8rr_REV;
-  m[X86::XOR16i16] = translate_XOR16i16;
-  m[X86::XOR16mi] = translate_XOR16mi;
-  m[X86::XOR16mi8] = translate_XOR16mi8;
-  m[X86::XOR16mr] = translate_XOR16mr;
-  m[X86::XOR16ri] = translate_XOR16ri;
-  m[X86::XOR16ri8] = translate_XOR16ri8;
-  m[X86::XOR16rm] = translate_XOR16rm;
-  m[X86::XOR16rr] = translate_XOR16rr;
-  m[X86::XOR16rr_REV] = translate_XOR16rr_REV;
-  m[X86::XOR32i32] = translate_XOR32i32;
-  m[X86::XOR32mi] = translate_XOR32mi;
-  m[X86::XOR32mi8] = translate_XOR32mi8;
-  m[X86::XOR32mr] = translate_XOR32mr;
-  m[X86::XOR64mr] = translate_XOR64mr;
-  m[X86::XOR32ri] = translate_XOR32ri;
-  m[X86::XOR32ri8] = translate_XOR32ri8;
-  m[X86::XOR64ri8] = translate_XOR64ri8;
-  m[X86::XOR64ri32] = translate_XOR64ri32;
-  m[X86::XOR32rm] = translate_XOR32rm;
-  m[X86::XOR32rr] = translate_XOR32rr;
-  m[X86::XOR32rr_REV] = translate_XOR32rr_REV;
-  m[X86::XOR64rm] = translate_XOR64rm;
-  m[X86::XOR64rr] = translate_XOR64rr;
-  m[X86::XOR64rr_REV] = translate_XOR64rr_REV;
-  m[X86::XOR8i8] = translate_XOR8i8;
-  m[X86::XOR8mi] = translate_XOR8mi;
-  m[X86::XOR8mr] = translate_XOR8mr;
-  m[X86::XOR8ri] = translate_XOR8ri;
-  m[X86::XOR8rm] = translate_XOR8rm;
-  m[X86::XOR8rr] = translate_XOR8rr;
-  m[X86::XOR8rr_REV] = translate_XOR8rr_REV;
-  m[X86::XOR64mi8] = translate_XOR64mi8;
-  m[X86::XOR64i32] = translate_XOR64i32;
-  m[X86::XOR64mi32] = translate_XOR64mi32;
+  m[X86::AND16i16] = translate_AND16i16<addr_width>;
+  m[X86::AND16mi] = translate_AND16mi<addr_width>;
+  m[X86::AND16mi8] = translate_AND16mi8<addr_width>;
+  m[X86::AND16mr] = translate_AND16mr<addr_width>;
+  m[X86::AND16ri] = translate_AND16ri<addr_width>;
+  m[X86::AND16ri8] = translate_AND16ri8<addr_width>;
+  m[X86::AND16rm] = translate_AND16rm<addr_width>;
+  m[X86::AND16rr] = translate_AND16rr<addr_width>;
+  m[X86::AND16rr_REV] = translate_AND16rr_REV<addr_width>;
+  m[X86::AND32i32] = translate_AND32i32<addr_width>;
+  m[X86::AND32mi] = translate_AND32mi<addr_width>;
+  m[X86::AND32mi8] = translate_AND32mi8<addr_width>;
+  m[X86::AND32mr] = translate_AND32mr<addr_width>;
+  m[X86::AND32ri] = translate_AND32ri<addr_width>;
+  m[X86::AND32ri8] = translate_AND32ri8<addr_width>;
+  m[X86::AND32rm] = translate_AND32rm<addr_width>;
+  m[X86::AND32rr] = translate_AND32rr<addr_width>;
+  m[X86::AND32rr_REV] = translate_AND32rr_REV<addr_width>;
+  m[X86::AND8i8] = translate_AND8i8<addr_width>;
+  m[X86::AND8mi] = translate_AND8mi<addr_width>;
+  m[X86::AND8mr] = translate_AND8mr<addr_width>;
+  m[X86::AND8ri] = translate_AND8ri<addr_width>;
+  m[X86::AND8rm] = translate_AND8rm<addr_width>;
+  m[X86::AND8rr] = translate_AND8rr<addr_width>;
+  m[X86::AND8rr_REV] = translate_AND8rr_REV<addr_width>;
+  m[X86::AND64ri32] = translate_AND64ri32<addr_width>;
+  m[X86::AND64rr] = translate_AND64rr<addr_width>;
+  m[X86::AND64rr_REV] = translate_AND64rr<addr_width>;
+  m[X86::AND64rm] = translate_AND64rm<addr_width>;
+  m[X86::AND64ri8] = translate_AND64ri8<addr_width>;
+  m[X86::AND64i32] = translate_AND64i32<addr_width>;
+  m[X86::AND64mr] = translate_AND64mr<addr_width>;
+  m[X86::AND64mi8] = translate_AND64mi8<addr_width>;
+  m[X86::AND64mi32] = translate_AND64mi32<addr_width>;
+
+  m[X86::NOT16m] = translate_NOT16m<addr_width>;
+  m[X86::NOT16r] = translate_NOT16r<addr_width>;
+  m[X86::NOT32m] = translate_NOT32m<addr_width>;
+  m[X86::NOT32r] = translate_NOT32r<addr_width>;
+  m[X86::NOT8m] = translate_NOT8m<addr_width>;
+  m[X86::NOT8r] = translate_NOT8r<addr_width>;
+  m[X86::NOT64r] = translate_NOT64r<addr_width>;
+  m[X86::NOT64m] = translate_NOT64m<addr_width>;
+
+  m[X86::OR16i16] = translate_OR16i16<addr_width>;
+  m[X86::OR16mi] = translate_OR16mi<addr_width>;
+  m[X86::OR16mi8] = translate_OR16mi8<addr_width>;
+  m[X86::OR16mr] = translate_OR16mr<addr_width>;
+  m[X86::OR16ri] = translate_OR16ri<addr_width>;
+  m[X86::OR16ri8] = translate_OR16ri8<addr_width>;
+  m[X86::OR16rm] = translate_OR16rm<addr_width>;
+  m[X86::OR16rr] = translate_OR16rr<addr_width>;
+  m[X86::OR16rr_REV] = translate_OR16rr_REV<addr_width>;
+  m[X86::OR32i32] = translate_OR32i32<addr_width>;
+  m[X86::OR64i32] = translate_OR64i32<addr_width>;
+  m[X86::OR64ri32] = translate_OR64ri32<addr_width>;
+  m[X86::OR32mi] = translate_OR32mi<addr_width>;
+  m[X86::OR32mi8] = translate_OR32mi8<addr_width>;
+  m[X86::OR32mr] = translate_OR32mr<addr_width>;
+  m[X86::OR64mr] = translate_OR64mr<addr_width>;
+  m[X86::OR32ri] = translate_OR32ri<addr_width>;
+  m[X86::OR32ri8] = translate_OR32ri8<addr_width>;
+  m[X86::OR32rm] = translate_OR32rm<addr_width>;
+  m[X86::OR32rr] = translate_OR32rr<addr_width>;
+  m[X86::OR32rr_REV] = translate_OR32rr_REV<addr_width>;
+  m[X86::OR64mi32] = translate_OR64mi32<addr_width>;
+
+  m[X86::OR64ri8] = translate_OR64ri8<addr_width>;
+  m[X86::OR64rm] = translate_OR64rm<addr_width>;
+  m[X86::OR64mr] = translate_OR64mr<addr_width>;
+  m[X86::OR64rr] = translate_OR64rr<addr_width>;
+  m[X86::OR64mi8] = translate_OR64mi8<addr_width>;
+
+  m[X86::OR8i8] = translate_OR8i8<addr_width>;
+  m[X86::OR8mi] = translate_OR8mi<addr_width>;
+  m[X86::OR8mr] = translate_OR8mr<addr_width>;
+  m[X86::OR8ri] = translate_OR8ri<addr_width>;
+  m[X86::OR8rm] = translate_OR8rm<addr_width>;
+  m[X86::OR8rr] = translate_OR8rr<addr_width>;
+  m[X86::OR8rr_REV] = translate_OR8rr_REV<addr_width>;
+  m[X86::XOR16i16] = translate_XOR16i16<addr_width>;
+  m[X86::XOR16mi] = translate_XOR16mi<addr_width>;
+  m[X86::XOR16mi8] = translate_XOR16mi8<addr_width>;
+  m[X86::XOR16mr] = translate_XOR16mr<addr_width>;
+  m[X86::XOR16ri] = translate_XOR16ri<addr_width>;
+  m[X86::XOR16ri8] = translate_XOR16ri8<addr_width>;
+  m[X86::XOR16rm] = translate_XOR16rm<addr_width>;
+  m[X86::XOR16rr] = translate_XOR16rr<addr_width>;
+  m[X86::XOR16rr_REV] = translate_XOR16rr_REV<addr_width>;
+  m[X86::XOR32i32] = translate_XOR32i32<addr_width>;
+  m[X86::XOR32mi] = translate_XOR32mi<addr_width>;
+  m[X86::XOR32mi8] = translate_XOR32mi8<addr_width>;
+  m[X86::XOR32mr] = translate_XOR32mr<addr_width>;
+  m[X86::XOR64mr] = translate_XOR64mr<addr_width>;
+  m[X86::XOR32ri] = translate_XOR32ri<addr_width>;
+  m[X86::XOR32ri8] = translate_XOR32ri8<addr_width>;
+  m[X86::XOR64ri8] = translate_XOR64ri8<addr_width>;
+  m[X86::XOR64ri32] = translate_XOR64ri32<addr_width>;
+  m[X86::XOR32rm] = translate_XOR32rm<addr_width>;
+  m[X86::XOR32rr] = translate_XOR32rr<addr_width>;
+  m[X86::XOR32rr_REV] = translate_XOR32rr_REV<addr_width>;
+  m[X86::XOR64rm] = translate_XOR64rm<addr_width>;
+  m[X86::XOR64rr] = translate_XOR64rr<addr_width>;
+  m[X86::XOR64rr_REV] = translate_XOR64rr_REV<addr_width>;
+  m[X86::XOR8i8] = translate_XOR8i8<addr_width>;
+  m[X86::XOR8mi] = translate_XOR8mi<addr_width>;
+  m[X86::XOR8mr] = translate_XOR8mr<addr_width>;
+  m[X86::XOR8ri] = translate_XOR8ri<addr_width>;
+  m[X86::XOR8rm] = translate_XOR8rm<addr_width>;
+  m[X86::XOR8rr] = translate_XOR8rr<addr_width>;
+  m[X86::XOR8rr_REV] = translate_XOR8rr_REV<addr_width>;
+  m[X86::XOR64mi8] = translate_XOR64mi8<addr_width>;
+  m[X86::XOR64i32] = translate_XOR64i32<addr_width>;
+  m[X86::XOR64mi32] = translate_XOR64mi32<addr_width>;
 }
+
+template void Bitops_populateDispatchMap<32>(DispatchMap &m);
+template void Bitops_populateDispatchMap<64>(DispatchMap &m);
@@ -35,5 +35,6 @@ class Value;
 
 class DispatchMap;
 
+template <int addr_width>
 void Bitops_populateDispatchMap(DispatchMap &m);
 llvm::Value *doAndVV32(llvm::BasicBlock *&b, llvm::Value *o1, llvm::Value *o2);
@@ -34,6 +34,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <llvm/IR/Argument.h>
@@ -98,40 +99,72 @@ static llvm::Value *CONSTFP_V(llvm::BasicBlock *&b, long double val) {
   return llvm::ConstantFP::get(bTy, val);
 }
 
+// Returns the x87 stack renaming of the function that contains `b`.
+static unsigned *FPU_STACK(llvm::BasicBlock *b) {
+  auto table = GetRegisterTable(b->getParent());
+  TASSERT(table != nullptr, "x87 code lifted without register variables");
+  return table->fpu_stack;
+}
+
+// Returns the ST register that currently holds the stack slot `fpreg`.
+static MCSemaRegs FPU_PHYSREG(llvm::BasicBlock *b, MCSemaRegs fpreg) {
+  TASSERT(llvm::X86::ST0 <= fpreg && fpreg <= llvm::X86::ST7,
+          "Not an x87 stack register");
+  return llvm::X86::ST0 + FPU_STACK(b)[fpreg - llvm::X86::ST0];
+}
+
 // Read the value of X86::STi as specified by fpreg.
 static llvm::Value *FPUR_READ(llvm::BasicBlock *&b, MCSemaRegs fpreg) {
-  return GENERIC_READREG(b, fpreg);
+  return GENERIC_READREG(b, FPU_PHYSREG(b, fpreg));
 }
 
 // Write val to X86::STi (specified by fpreg).
 static void FPUR_WRITE(llvm::BasicBlock *&b, MCSemaRegs fpreg, llvm::Value *val) {
-  GENERIC_WRITEREG(b, fpreg, val);
+  GENERIC_WRITEREG(b, FPU_PHYSREG(b, fpreg), val);
 }
 
 // Decrement Top, set ST(TOP) = fpuval.
+//
+// Like TOP on real hardware, the renaming means that nothing moves: the
+// register that held ST7 becomes ST0, and every other slot shifts down.
 static void FPU_PUSHV(llvm::BasicBlock *&b, llvm::Value *fpuval) {
-
-  // The FPUR_WRITEV will mark the currentTOP as valid in the tag registers.
-  FPUR_WRITE(b, llvm::X86::ST7, FPUR_READ(b, llvm::X86::ST6));
-  FPUR_WRITE(b, llvm::X86::ST6, FPUR_READ(b, llvm::X86::ST5));
-  FPUR_WRITE(b, llvm::X86::ST5, FPUR_READ(b, llvm::X86::ST4));
-  FPUR_WRITE(b, llvm::X86::ST4, FPUR_READ(b, llvm::X86::ST3));
-  FPUR_WRITE(b, llvm::X86::ST3, FPUR_READ(b, llvm::X86::ST2));
-  FPUR_WRITE(b, llvm::X86::ST2, FPUR_READ(b, llvm::X86::ST1));
-  FPUR_WRITE(b, llvm::X86::ST1, FPUR_READ(b, llvm::X86::ST0));
+  auto stack = FPU_STACK(b);
+  auto st7 = stack[7];
+  for (auto i = 7; i > 0; --i) {
+    stack[i] = stack[i - 1];
+  }
+  stack[0] = st7;
   FPUR_WRITE(b, llvm::X86::ST0, fpuval);
 }
 
 static void FPU_POP(llvm::BasicBlock *&b) {
-  auto st0 = FPUR_READ(b, llvm::X86::ST0);
-  FPUR_WRITE(b, llvm::X86::ST0, FPUR_READ(b, llvm::X86::ST1));
-  FPUR_WRITE(b, llvm::X86::ST1, FPUR_READ(b, llvm::X86::ST2));
-  FPUR_WRITE(b, llvm::X86::ST2, FPUR_READ(b, llvm::X86::ST3));
-  FPUR_WRITE(b, llvm::X86::ST3, FPUR_READ(b, llvm::X86::ST4));
-  FPUR_WRITE(b, llvm::X86::ST4, FPUR_READ(b, llvm::X86::ST5));
-  FPUR_WRITE(b, llvm::X86::ST5, FPUR_READ(b, llvm::X86::ST6));
-  FPUR_WRITE(b, llvm::X86::ST6, FPUR_READ(b, llvm::X86::ST7));
-  FPUR_WRITE(b, llvm::X86::ST7, st0);
+  auto stack = FPU_STACK(b);
+  auto st0 = stack[0];
+  for (auto i = 0; i < 7; ++i) {
+    stack[i] = stack[i + 1];
+  }
+  stack[7] = st0;
+}
+
+void FPU_SyncStack(llvm::BasicBlock *b) {
+  auto table = GetRegisterTable(b->getParent());
+  if (!table) {
+    return;
+  }
+
+  auto stack = table->fpu_stack;
+  llvm::Value *vals[NUM_FPU_REGS] = {};
+  for (auto i = 0; i < NUM_FPU_REGS; ++i) {
+    if (stack[i] != static_cast<unsigned>(i)) {
+      vals[i] = GENERIC_READREG(b, llvm::X86::ST0 + stack[i]);
+    }
+  }
+  for (auto i = 0; i < NUM_FPU_REGS; ++i) {
+    if (vals[i]) {
+      GENERIC_WRITEREG(b, llvm::X86::ST0 + i, vals[i]);
+    }
+    stack[i] = static_cast<unsigned>(i);
+  }
 }
 
 static llvm::Value *FPUM_READ(NativeInstPtr ip, int memwidth,
@@ -708,10 +741,9 @@ static InstTransResult doFxch(llvm::MCInst &inst, NativeInstPtr ip,
   if (inst.getNumOperands() > 0) {
     src_reg = inst.getOperand(0).getReg();
   }
-  auto src_val = FPUR_READ(b, src_reg);
-  auto st0_val = FPUR_READ(b, llvm::X86::ST0);
-  FPUR_WRITE(b, llvm::X86::ST0, src_val);
-  FPUR_WRITE(b, src_reg, st0_val);
+  TASSERT(llvm::X86::ST0 <= src_reg && src_reg <= llvm::X86::ST7,
+          "Not an x87 stack register");
+  std::swap(FPU_STACK(b)[0], FPU_STACK(b)[src_reg - llvm::X86::ST0]);
 
   return ContinueBlock;
 }
@@ -1036,8 +1068,9 @@ static InstTransResult doCHS(llvm::MCInst &inst, NativeInstPtr ip,
   return ContinueBlock;
 }
 
-//mem_src =  IMM_AS_DATA_REF(block, natM, ip);
+//mem_src =  IMM_AS_DATA_REF<addr_width>(block, natM, ip);
 #define FPU_TRANSLATION(NAME, SETPTR, SETDATA, SETFOPCODE, ACCESSMEM, THECALL) \
+    template <int addr_width> \
     static InstTransResult translate_ ## NAME (TranslationContext &ctx, \
                                                llvm::BasicBlock *&block) { \
       auto natM = ctx.natM; \
@@ -1528,118 +1561,121 @@ static InstTransResult translate_WAIT(TranslationContext &, llvm::BasicBlock *&)
   return ContinueBlock;
 }
 
+template <int addr_width>
 void FPU_populateDispatchMap(DispatchMap &m) {
-  m[llvm::X86::ADD_F32m] = translate_ADD_F32m;
-  m[llvm::X86::ADD_F64m] = translate_ADD_F64m;
-  m[llvm::X86::ADD_FI16m] = translate_ADD_FI16m;
-  m[llvm::X86::ADD_FI32m] = translate_ADD_FI32m;
-  m[llvm::X86::ADD_FPrST0] = translate_ADD_FPrST0;
-  m[llvm::X86::ADD_FST0r] = translate_ADD_FST0r;
-  m[llvm::X86::ADD_FrST0] = translate_ADD_FrST0;
-  m[llvm::X86::DIVR_F32m] = translate_DIVR_F32m;
-  m[llvm::X86::DIVR_F64m] = translate_DIVR_F64m;
-  m[llvm::X86::DIVR_FI16m] = translate_DIVR_FI16m;
-  m[llvm::X86::DIVR_FI32m] = translate_DIVR_FI32m;
-  m[llvm::X86::DIVR_FPrST0] = translate_DIVR_FPrST0;
-  m[llvm::X86::DIVR_FST0r] = translate_DIVR_FST0r;
-  m[llvm::X86::DIVR_FrST0] = translate_DIVR_FrST0;
-  m[llvm::X86::DIV_F32m] = translate_DIV_F32m;
-  m[llvm::X86::DIV_F64m] = translate_DIV_F64m;
-  m[llvm::X86::DIV_FI16m] = translate_DIV_FI16m;
-  m[llvm::X86::DIV_FI32m] = translate_DIV_FI32m;
-  m[llvm::X86::DIV_FPrST0] = translate_DIV_FPrST0;
-  m[llvm::X86::DIV_FST0r] = translate_DIV_FST0r;
-  m[llvm::X86::DIV_FrST0] = translate_DIV_FrST0;
-  m[llvm::X86::LD_F32m] = translate_LD_F32m;
-  m[llvm::X86::LD_F64m] = translate_LD_F64m;
-  m[llvm::X86::LD_F80m] = translate_LD_F80m;
-  m[llvm::X86::LD_Frr] = translate_LD_Frr;
-  m[llvm::X86::MUL_F32m] = translate_MUL_F32m;
-  m[llvm::X86::MUL_F64m] = translate_MUL_F64m;
-  m[llvm::X86::MUL_FI16m] = translate_MUL_FI16m;
-  m[llvm::X86::MUL_FI32m] = translate_MUL_FI32m;
-  m[llvm::X86::MUL_FPrST0] = translate_MUL_FPrST0;
-  m[llvm::X86::MUL_FST0r] = translate_MUL_FST0r;
-  m[llvm::X86::MUL_FrST0] = translate_MUL_FrST0;
-  m[llvm::X86::ST_F32m] = translate_ST_F32m;
-  m[llvm::X86::ST_F64m] = translate_ST_F64m;
-
-  m[llvm::X86::IST_FP32m] = translate_IST_FP32m;
-  m[llvm::X86::IST_FP64m] = translate_IST_FP64m;
-  m[llvm::X86::IST_F32m] = translate_IST_F32m;
-  m[llvm::X86::IST_F16m] = translate_IST_F16m;
-  m[llvm::X86::IST_FP16m] = translate_IST_FP16m;
-
-  m[llvm::X86::ISTT_FP64m] = translate_ISTT_FP64m;
-  m[llvm::X86::ISTT_FP32m] = translate_ISTT_FP32m;
-  m[llvm::X86::ISTT_FP16m] = translate_ISTT_FP16m;
-
-  m[llvm::X86::ST_FP32m] = translate_ST_FP32m;
-  m[llvm::X86::ST_FP64m] = translate_ST_FP64m;
-  m[llvm::X86::ST_FP80m] = translate_ST_FP80m;
-  m[llvm::X86::ST_FPrr] = translate_ST_FPrr;
-  m[llvm::X86::ST_Frr] = translate_ST_Frr;
-  m[llvm::X86::SUBR_F32m] = translate_SUBR_F32m;
-  m[llvm::X86::SUBR_F64m] = translate_SUBR_F64m;
-  m[llvm::X86::SUBR_FI16m] = translate_SUBR_FI16m;
-  m[llvm::X86::SUBR_FI32m] = translate_SUBR_FI32m;
-  m[llvm::X86::SUBR_FPrST0] = translate_SUBR_FPrST0;
-  m[llvm::X86::SUBR_FST0r] = translate_SUBR_FST0r;
-  m[llvm::X86::SUBR_FrST0] = translate_SUBR_FrST0;
-  m[llvm::X86::SUB_F32m] = translate_SUB_F32m;
-  m[llvm::X86::SUB_F64m] = translate_SUB_F64m;
-  m[llvm::X86::SUB_FI16m] = translate_SUB_FI16m;
-  m[llvm::X86::SUB_FI32m] = translate_SUB_FI32m;
-  m[llvm::X86::SUB_FPrST0] = translate_SUB_FPrST0;
-  m[llvm::X86::SUB_FST0r] = translate_SUB_FST0r;
-  m[llvm::X86::SUB_FrST0] = translate_SUB_FrST0;
+  m[llvm::X86::ADD_F32m] = translate_ADD_F32m<addr_width>;
+  m[llvm::X86::ADD_F64m] = translate_ADD_F64m<addr_width>;
+  m[llvm::X86::ADD_FI16m] = translate_ADD_FI16m<addr_width>;
+  m[llvm::X86::ADD_FI32m] = translate_ADD_FI32m<addr_width>;
+  m[llvm::X86::ADD_FPrST0] = translate_ADD_FPrST0<addr_width>;
+  m[llvm::X86::ADD_FST0r] = translate_ADD_FST0r<addr_width>;
+  m[llvm::X86::ADD_FrST0] = translate_ADD_FrST0<addr_width>;
+  m[llvm::X86::DIVR_F32m] = translate_DIVR_F32m<addr_width>;
+  m[llvm::X86::DIVR_F64m] = translate_DIVR_F64m<addr_width>;
+  m[llvm::X86::DIVR_FI16m] = translate_DIVR_FI16m<addr_width>;
+  m[llvm::X86::DIVR_FI32m] = translate_DIVR_FI32m<addr_width>;
+  m[llvm::X86::DIVR_FPrST0] = translate_DIVR_FPrST0<addr_width>;
+  m[llvm::X86::DIVR_FST0r] = translate_DIVR_FST0r<addr_width>;
+  m[llvm::X86::DIVR_FrST0] = translate_DIVR_FrST0<addr_width>;
+  m[llvm::X86::DIV_F32m] = translate_DIV_F32m<addr_width>;
+  m[llvm::X86::DIV_F64m] = translate_DIV_F64m<addr_width>;
+  m[llvm::X86::DIV_FI16m] = translate_DIV_FI16m<addr_width>;
+  m[llvm::X86::DIV_FI32m] = translate_DIV_FI32m<addr_width>;
+  m[llvm::X86::DIV_FPrST0] = translate_DIV_FPrST0<addr_width>;
+  m[llvm::X86::DIV_FST0r] = translate_DIV_FST0r<addr_width>;
+  m[llvm::X86::DIV_FrST0] = translate_DIV_FrST0<addr_width>;
+  m[llvm::X86::LD_F32m] = translate_LD_F32m<addr_width>;
+  m[llvm::X86::LD_F64m] = translate_LD_F64m<addr_width>;
+  m[llvm::X86::LD_F80m] = translate_LD_F80m<addr_width>;
+  m[llvm::X86::LD_Frr] = translate_LD_Frr<addr_width>;
+  m[llvm::X86::MUL_F32m] = translate_MUL_F32m<addr_width>;
+  m[llvm::X86::MUL_F64m] = translate_MUL_F64m<addr_width>;
+  m[llvm::X86::MUL_FI16m] = translate_MUL_FI16m<addr_width>;
+  m[llvm::X86::MUL_FI32m] = translate_MUL_FI32m<addr_width>;
+  m[llvm::X86::MUL_FPrST0] = translate_MUL_FPrST0<addr_width>;
+  m[llvm::X86::MUL_FST0r] = translate_MUL_FST0r<addr_width>;
+  m[llvm::X86::MUL_FrST0] = translate_MUL_FrST0<addr_width>;
+  m[llvm::X86::ST_F32m] = translate_ST_F32m<addr_width>;
+  m[llvm::X86::ST_F64m] = translate_ST_F64m<addr_width>;
+
+  m[llvm::X86::IST_FP32m] = translate_IST_FP32m<addr_width>;
+  m[llvm::X86::IST_FP64m] = translate_IST_FP64m<addr_width>;
+  m[llvm::X86::IST_F32m] = translate_IST_F32m<addr_width>;
+  m[llvm::X86::IST_F16m] = translate_IST_F16m<addr_width>;
+  m[llvm::X86::IST_FP16m] = translate_IST_FP16m<addr_width>;
+
+  m[llvm::X86::ISTT_FP64m] = translate_ISTT_FP64m<addr_width>;
+  m[llvm::X86::ISTT_FP32m] = translate_ISTT_FP32m<addr_width>;
+  m[llvm::X86::ISTT_FP16m] = translate_ISTT_FP16m<addr_width>;
+
+  m[llvm::X86::ST_FP32m] = translate_ST_FP32m<addr_width>;
+  m[llvm::X86::ST_FP64m] = translate_ST_FP64m<addr_width>;
+  m[llvm::X86::ST_FP80m] = translate_ST_FP80m<addr_width>;
+  m[llvm::X86::ST_FPrr] = translate_ST_FPrr<addr_width>;
+  m[llvm::X86::ST_Frr] = translate_ST_Frr<addr_width>;
+  m[llvm::X86::SUBR_F32m] = translate_SUBR_F32m<addr_width>;
+  m[llvm::X86::SUBR_F64m] = translate_SUBR_F64m<addr_width>;
+  m[llvm::X86::SUBR_FI16m] = translate_SUBR_FI16m<addr_width>;
+  m[llvm::X86::SUBR_FI32m] = translate_SUBR_FI32m<addr_width>;
+  m[llvm::X86::SUBR_FPrST0] = translate_SUBR_FPrST0<addr_width>;
+  m[llvm::X86::SUBR_FST0r] = translate_SUBR_FST0r<addr_width>;
+  m[llvm::X86::SUBR_FrST0] = translate_SUBR_FrST0<addr_width>;
+  m[llvm::X86::SUB_F32m] = translate_SUB_F32m<addr_width>;
+  m[llvm::X86::SUB_F64m] = translate_SUB_F64m<addr_width>;
+  m[llvm::X86::SUB_FI16m] = translate_SUB_FI16m<addr_width>;
+  m[llvm::X86::SUB_FI32m] = translate_SUB_FI32m<addr_width>;
+  m[llvm::X86::SUB_FPrST0] = translate_SUB_FPrST0<addr_width>;
+  m[llvm::X86::SUB_FST0r] = translate_SUB_FST0r<addr_width>;
+  m[llvm::X86::SUB_FrST0] = translate_SUB_FrST0<addr_width>;
 
   m[llvm::X86::WAIT] = translate_WAIT;
-  m[llvm::X86::SIN_F] = translate_SIN_F;
-  m[llvm::X86::LD_F0] = translate_LD_F0;
-  m[llvm::X86::LD_F1] = translate_LD_F1;
-  m[llvm::X86::FLDPI] = translate_FLDPI;
-  m[llvm::X86::FLDLN2] = translate_FLDLN2;
-  m[llvm::X86::FLDL2E] = translate_FLDL2E;
-  m[llvm::X86::FLDLG2] = translate_FLDLG2;
+  m[llvm::X86::SIN_F] = translate_SIN_F<addr_width>;
+  m[llvm::X86::LD_F0] = translate_LD_F0<addr_width>;
+  m[llvm::X86::LD_F1] = translate_LD_F1<addr_width>;
+  m[llvm::X86::FLDPI] = translate_FLDPI<addr_width>;
+  m[llvm::X86::FLDLN2] = translate_FLDLN2<addr_width>;
+  m[llvm::X86::FLDL2E] = translate_FLDL2E<addr_width>;
+  m[llvm::X86::FLDLG2] = translate_FLDLG2<addr_width>;
 
-  m[llvm::X86::ILD_F16m] = translate_ILD_F16m;
-  m[llvm::X86::ILD_F32m] = translate_ILD_F32m;
-  m[llvm::X86::ILD_F64m] = translate_ILD_F64m;
-  m[llvm::X86::FNSTCW16m] = translate_FNSTCW16m;
-  m[llvm::X86::FLDCW16m] = translate_FLDCW16m;
+  m[llvm::X86::ILD_F16m] = translate_ILD_F16m<addr_width>;
+  m[llvm::X86::ILD_F32m] = translate_ILD_F32m<addr_width>;
+  m[llvm::X86::ILD_F64m] = translate_ILD_F64m<addr_width>;
+  m[llvm::X86::FNSTCW16m] = translate_FNSTCW16m<addr_width>;
+  m[llvm::X86::FLDCW16m] = translate_FLDCW16m<addr_width>;
 
-  m[llvm::X86::XCH_F] = translate_XCH_F;
+  m[llvm::X86::XCH_F] = translate_XCH_F<addr_width>;
 
-  m[llvm::X86::FYL2X] = translate_FYL2X;
-  m[llvm::X86::FYL2XP1] = translate_FYL2XP1;
+  m[llvm::X86::FYL2X] = translate_FYL2X<addr_width>;
+  m[llvm::X86::FYL2XP1] = translate_FYL2XP1<addr_width>;
 
-  m[llvm::X86::UCOM_FPPr] = translate_UCOM_FPPr;
-  m[llvm::X86::UCOM_FPr] = translate_UCOM_FPr;
-  m[llvm::X86::UCOM_Fr] = translate_UCOM_Fr;
+  m[llvm::X86::UCOM_FPPr] = translate_UCOM_FPPr<addr_width>;
+  m[llvm::X86::UCOM_FPr] = translate_UCOM_FPr<addr_width>;
+  m[llvm::X86::UCOM_Fr] = translate_UCOM_Fr<addr_width>;
 
-  m[llvm::X86::UCOM_FIPr] = translate_UCOM_FIPr;
-  m[llvm::X86::UCOM_FIr] = translate_UCOM_FIr;
+  m[llvm::X86::UCOM_FIPr] = translate_UCOM_FIPr<addr_width>;
+  m[llvm::X86::UCOM_FIr] = translate_UCOM_FIr<addr_width>;
 
-  m[llvm::X86::FNSTSW16r] = translate_FNSTSW16r;
-  m[llvm::X86::FNSTSWm] = translate_FNSTSWm;
+  m[llvm::X86::FNSTSW16r] = translate_FNSTSW16r<addr_width>;
+  m[llvm::X86::FNSTSWm] = translate_FNSTSWm<addr_width>;
 
-  m[llvm::X86::FRNDINT] = translate_FRNDINT;
-  m[llvm::X86::F2XM1] = translate_F2XM1;
-  m[llvm::X86::FSCALE] = translate_FSCALE;
+  m[llvm::X86::FRNDINT] = translate_FRNDINT<addr_width>;
+  m[llvm::X86::F2XM1] = translate_F2XM1<addr_width>;
+  m[llvm::X86::FSCALE] = translate_FSCALE<addr_width>;
 
-  m[llvm::X86::ABS_F] = translate_FABS;
-  m[llvm::X86::SQRT_F] = translate_FSQRT;
-  m[llvm::X86::COS_F] = translate_FCOS;
-  m[llvm::X86::FPTAN] = translate_FPTAN;
-  m[llvm::X86::FSINCOS] = translate_FSINCOS;
+  m[llvm::X86::ABS_F] = translate_FABS<addr_width>;
+  m[llvm::X86::SQRT_F] = translate_FSQRT<addr_width>;
+  m[llvm::X86::COS_F] = translate_FCOS<addr_width>;
+  m[llvm::X86::FPTAN] = translate_FPTAN<addr_width>;
+  m[llvm::X86::FSINCOS] = translate_FSINCOS<addr_width>;
 
-  m[llvm::X86::FDECSTP] = translate_FDECSTP;
-  m[llvm::X86::FINCSTP] = translate_FINCSTP;
+  m[llvm::X86::FDECSTP] = translate_FDECSTP<addr_width>;
+  m[llvm::X86::FINCSTP] = translate_FINCSTP<addr_width>;
 
-  m[llvm::X86::FPREM] = translate_FPREM;
-  m[llvm::X86::FPREM1] = translate_FPREM1;
+  m[llvm::X86::FPREM] = translate_FPREM<addr_width>;
+  m[llvm::X86::FPREM1] = translate_FPREM1<addr_width>;
 
-  m[llvm::X86::CHS_F] = translate_CHS_F;
+  m[llvm::X86::CHS_F] = translate_CHS_F<addr_width>;
 }
 
+template void FPU_populateDispatchMap<32>(DispatchMap &m);
+template void FPU_populateDispatchMap<64>(DispatchMap &m);
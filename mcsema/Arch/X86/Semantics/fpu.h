@@ -38,4 +38,9 @@ enum fputag_vals {
     FPU_TAG_EMPTY = 3
 };
 
+template <int addr_width>
 void FPU_populateDispatchMap(DispatchMap &m);
+
+// Put the ST registers back in stack order at the end of `b`, undoing the
+// renaming done by the x87 pushes, pops and exchanges lifted so far.
+void FPU_SyncStack(llvm::BasicBlock *b);
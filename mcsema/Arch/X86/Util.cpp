@@ -29,11 +29,15 @@
  */
 
 #include <iostream>
+#include <vector>
 
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Intrinsics.h>
 #include <llvm/Support/CodeGen.h>
 
+#include "mcsema/Arch/X86/Frame.h"
 #include "mcsema/Arch/X86/Util.h"
 #include "mcsema/BC/Util.h"
 #include "mcsema/CFG/Externals.h"
@@ -51,25 +55,109 @@ bool addrIsInData(VA addr, NativeModulePtr m, VA &base, VA minAddr = 0x0) {
     return false;
   }
 
-  auto &sections = m->getData();
-  if (sections.empty()) {
+  if (m->getData().empty()) {
     std::cerr << __FUNCTION__ << ": WARNING: no data sections!" << std::endl;
     return false;
 
   }
-  for (auto &curSec : sections) {
-    VA low = curSec.getBase();
-    VA high = low + curSec.getSize();
 
-    if (addr >= low && addr < high) {
-      base = low;
-      return true;
-    }
+  if (auto ds = m->findDataSection(addr)) {
+    base = ds->getBase();
+    return true;
   }
 
   return false;
 }
 
+llvm::Constant *getDataSectionAddr(llvm::GlobalVariable *gData,
+                                   uint64_t offset) {
+  auto &C = gData->getContext();
+  llvm::DataLayout DL(gData->getParent());
+  auto i32_ty = llvm::Type::getInt32Ty(C);
+  auto i64_ty = llvm::Type::getInt64Ty(C);
+  auto section_ty = gData->getType()->getElementType();
+
+  // Descend into the section's structure for as long as `offset` is inside
+  // of an aggregate. Sections that are only declared (e.g. in a module
+  // shard) have an opaque type, and are addressed by byte offset.
+  std::vector<llvm::Constant *> indices = {llvm::ConstantInt::get(i32_ty, 0)};
+  auto ty = section_ty;
+  while (true) {
+    if (auto st = llvm::dyn_cast<llvm::StructType>(ty)) {
+      if (st->isOpaque() || !st->getNumElements()) {
+        break;
+      }
+      auto layout = DL.getStructLayout(st);
+      if (offset >= layout->getSizeInBytes()) {
+        break;
+      }
+      auto i = layout->getElementContainingOffset(offset);
+      indices.push_back(llvm::ConstantInt::get(i32_ty, i));
+      offset -= layout->getElementOffset(i);
+      ty = st->getElementType(i);
+
+    } else if (auto at = llvm::dyn_cast<llvm::ArrayType>(ty)) {
+      auto elem_size = DL.getTypeAllocSize(at->getElementType());
+      if (!elem_size || offset >= elem_size * at->getNumElements()) {
+        break;
+      }
+      indices.push_back(llvm::ConstantInt::get(i64_ty, offset / elem_size));
+      offset %= elem_size;
+      ty = at->getElementType();
+
+    } else {
+      break;
+    }
+  }
+
+  llvm::Constant *ptr = gData;
+  if (1 < indices.size()) {
+    ptr = llvm::ConstantExpr::getInBoundsGetElementPtr(section_ty, gData,
+                                                       indices);
+  }
+  if (offset) {
+    auto i8_ty = llvm::Type::getInt8Ty(C);
+    ptr = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        i8_ty, llvm::ConstantExpr::getBitCast(ptr, i8_ty->getPointerTo()),
+        llvm::ConstantInt::get(i64_ty, offset));
+  }
+  return ptr;
+}
+
+llvm::Constant *getDataPtrFromOriginalAddr(VA original_addr,
+                                           NativeModulePtr mod, VA addr_start,
+                                           llvm::BasicBlock *b) {
+  VA baseGlobal;
+  if (!addrIsInData(original_addr, mod, baseGlobal, addr_start)) {
+    return nullptr;
+  }
+
+  //we should be able to find a reference to this in global data
+  auto M = b->getParent()->getParent();
+  auto gData = mod->getDataSectionVar(baseGlobal, M);
+
+  //if we thought it was a global, we should be able to
+  //pin it to a global array we made during module setup
+  if (!gData) {
+    throw TErr(__LINE__, __FILE__, "Global variable not found");
+  }
+  return getDataSectionAddr(gData, original_addr - baseGlobal);
+}
+
+// Returns `data_ptr + offset` as a pointer of type `ptr_ty`, where `offset`
+// is the part of an address that comes from registers.
+static llvm::Value *getDataAddr(llvm::BasicBlock *b, llvm::Constant *data_ptr,
+                                llvm::Value *offset, llvm::Type *ptr_ty) {
+  if (!offset) {
+    return llvm::ConstantExpr::getPointerCast(data_ptr, ptr_ty);
+  }
+  auto i8_ty = llvm::Type::getInt8Ty(b->getContext());
+  auto byte_ptr = llvm::ConstantExpr::getPointerCast(
+      data_ptr, i8_ty->getPointerTo());
+  auto addr = llvm::GetElementPtrInst::Create(i8_ty, byte_ptr, offset, "", b);
+  return llvm::CastInst::CreatePointerCast(addr, ptr_ty, "", b);
+}
+
 // Compute a Value from a complex address expression
 // such as [0x123456+eax*4]
 // If the expression references global data, use
@@ -89,6 +177,15 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
   unsigned baseReg = Obase.getReg();
   int64_t disp = Odisp;
 
+  if (!dataOffset) {
+    auto frame_addr = X86GetStackFrameAddress(
+        b, llvm::Type::getInt32PtrTy(b->getContext()), baseReg,
+        Oindex.getReg(), Oseg.getReg(), disp);
+    if (frame_addr) {
+      return frame_addr;
+    }
+  }
+
   //first, we should ask, is disp an absolute reference to
   //some global symbol in the original source module?
   //if it is, we can replace its value with that of a pointer
@@ -97,20 +194,29 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
   //if the base register is the stack pointer or the frame
   //pointer, then skip this part
   llvm::Value *d = nullptr;
+  llvm::Constant *data_ptr = nullptr;
   auto iTy = llvm::IntegerType::getInt32Ty(b->getContext());
+  auto piTy = llvm::Type::getInt32PtrTy(b->getContext());
 
   if (dataOffset
       || (mod && disp && baseReg != llvm::X86::EBP &&
           baseReg != llvm::X86::ESP)) {
-    auto int_val = getGlobalFromOriginalAddr<32>(disp, mod,
-                                                 dataOffset ? 0 : 0x1000, b);
-    d = int_val;
+    data_ptr = getDataPtrFromOriginalAddr(disp, mod,
+                                          dataOffset ? 0 : 0x1000, b);
   } else {
     //there is no disp value, or its relative to esp/ebp in which case
     //we might not want to do anything
   }
 
-  if (nullptr == d) {
+  // References into a data section are GEPs off of the section, with the
+  // registers as the offset.
+  if (data_ptr) {
+    if (baseReg == llvm::X86::NoRegister &&
+        Oindex.getReg() == llvm::X86::NoRegister) {
+      return getDataAddr(b, data_ptr, nullptr, piTy);
+    }
+    d = CONST_V<32>(b, 0);
+  } else {
     //create a constant integer out of the raw displacement
     //we were unable to assign the displacement to an address
     d = llvm::ConstantInt::getSigned(iTy, disp);
@@ -143,12 +249,16 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
     dispComp = llvm::BinaryOperator::CreateAdd(dispComp, index, "", b);
   }
 
+  if (data_ptr) {
+    return getDataAddr(b, data_ptr, dispComp, piTy);
+  }
+
   //convert the resulting integer into a pointer type
-  auto piTy = llvm::Type::getInt32PtrTy(b->getContext());
   return new llvm::IntToPtrInst(dispComp, piTy, "", b);
 }
 }
 
+template <int addr_width>
 llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
                              const llvm::MCInst &inst, NativeInstPtr ip,
                              uint32_t which) {
@@ -169,20 +279,24 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
   bool has_ref = ip->has_reference(NativeInst::MEMRef);
   int64_t real_disp =
       has_ref ? ip->get_reference(NativeInst::MEMRef) : disp.getImm();
-  auto M = b->getParent()->getParent();
-
-  if (ArchPointerSize(M) == Pointer32) {
 
+  if (32 == addr_width) {
     return x86::getAddrFromExpr(b, mod, base, scale, index, real_disp, seg,
                                 has_ref);
-
   } else {
     return x86_64::getAddrFromExpr(b, mod, base, scale, index, real_disp, seg,
                                    has_ref);
   }
-
 }
 
+template llvm::Value *getAddrFromExpr<32>(
+    llvm::BasicBlock *b, NativeModulePtr mod, const llvm::MCInst &inst,
+    NativeInstPtr ip, uint32_t which);
+template llvm::Value *getAddrFromExpr<64>(
+    llvm::BasicBlock *b, NativeModulePtr mod, const llvm::MCInst &inst,
+    NativeInstPtr ip, uint32_t which);
+
+template <int addr_width>
 llvm::Value *MEM_AS_DATA_REF(llvm::BasicBlock *B, NativeModulePtr natM,
                              const llvm::MCInst &inst, NativeInstPtr ip,
                              uint32_t which) {
@@ -190,9 +304,16 @@ llvm::Value *MEM_AS_DATA_REF(llvm::BasicBlock *B, NativeModulePtr natM,
     throw TErr(__LINE__, __FILE__,
                "Want to use MEM as data ref but have no MEM reference");
   }
-  return getAddrFromExpr(B, natM, inst, ip, which);
+  return getAddrFromExpr<addr_width>(B, natM, inst, ip, which);
 }
 
+template llvm::Value *MEM_AS_DATA_REF<32>(
+    llvm::BasicBlock *B, NativeModulePtr natM, const llvm::MCInst &inst,
+    NativeInstPtr ip, uint32_t which);
+template llvm::Value *MEM_AS_DATA_REF<64>(
+    llvm::BasicBlock *B, NativeModulePtr natM, const llvm::MCInst &inst,
+    NativeInstPtr ip, uint32_t which);
+
 llvm::Instruction *callMemcpy(llvm::BasicBlock *B, llvm::Value *dest,
                               llvm::Value *src, uint32_t size, uint32_t align,
                               bool isVolatile) {
@@ -233,21 +354,38 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
   unsigned baseReg = Obase.getReg();
   int64_t disp = Odisp;
 
+  if (!dataOffset) {
+    auto frame_addr = X86GetStackFrameAddress(
+        b, llvm::Type::getInt64PtrTy(b->getContext()), baseReg,
+        Oindex.getReg(), Oseg.getReg(), disp);
+    if (frame_addr) {
+      return frame_addr;
+    }
+  }
+
   // specific function for 64 bit
   llvm::Value *d = nullptr;
+  llvm::Constant *data_ptr = nullptr;
   auto iTy = llvm::IntegerType::getInt64Ty(b->getContext());
+  auto piTy = llvm::Type::getInt64PtrTy(b->getContext());
 
   if (dataOffset
       || (mod && disp && baseReg != llvm::X86::RBP && baseReg != llvm::X86::RSP)) {
-    d = getGlobalFromOriginalAddr<64>(disp, mod,
-                                                   dataOffset ? 0 : 0x1000, b);
+    data_ptr = getDataPtrFromOriginalAddr(disp, mod,
+                                          dataOffset ? 0 : 0x1000, b);
   } else {
 
     //there is no disp value, or its relative to esp/ebp in which case
     //we might not want to do anything
   }
 
-  if (!d) {
+  if (data_ptr) {
+    if ((baseReg == llvm::X86::NoRegister || baseReg == llvm::X86::RIP) &&
+        Oindex.getReg() == llvm::X86::NoRegister) {
+      return getDataAddr(b, data_ptr, nullptr, piTy);
+    }
+    d = CONST_V<64>(b, 0);
+  } else {
     //create a constant integer out of the raw displacement
     //we were unable to assign the displacement to an address
     d = llvm::ConstantInt::getSigned(iTy, disp);
@@ -279,8 +417,11 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
 
   }
 
+  if (data_ptr) {
+    return getDataAddr(b, data_ptr, dispComp, piTy);
+  }
+
   //convert the resulting integer into a pointer type
-  auto piTy = llvm::Type::getInt64PtrTy(b->getContext());
   return new llvm::IntToPtrInst(dispComp, piTy, "", b);
 }
 
@@ -114,47 +114,39 @@ static llvm::Value *concatInts(llvm::BasicBlock *b, llvm::Value *a1,
 
 // Compute a complex address expression, such as
 // [0x1245678+eax*4] and return a Value that represents the computation
-// result
+// result. Instantiated for 32- and 64-bit addresses.
+template <int addr_width>
 llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
                              const llvm::MCInst &inst, NativeInstPtr ip,
                              uint32_t which);
 
 bool addrIsInData(VA addr, NativeModulePtr m, VA &base, VA minAddr);
 
+// Returns a constant pointer to the byte at `offset` in the data section
+// `gData`. The pointer is a GEP into the section's structure when the
+// section's type is known, so that loads from read-only sections can be
+// folded.
+llvm::Constant *getDataSectionAddr(llvm::GlobalVariable *gData,
+                                   uint64_t offset);
+
+// Returns a constant pointer to the data at `original_addr`, or `nullptr`
+// if the address isn't in a data section.
+llvm::Constant *getDataPtrFromOriginalAddr(VA original_addr,
+                                           NativeModulePtr mod, VA addr_start,
+                                           llvm::BasicBlock *b);
+
 template<int width>
 static llvm::Value* getGlobalFromOriginalAddr(VA original_addr,
                                               NativeModulePtr mod,
                                               VA addr_start,
                                               llvm::BasicBlock *b) {
-  VA baseGlobal;
-  if (addrIsInData(original_addr, mod, baseGlobal, addr_start)) {
-    //we should be able to find a reference to this in global data
-    llvm::Module *M = b->getParent()->getParent();
-
-    std::stringstream ss;
-    ss << "data_" << std::hex << baseGlobal;
-    std::string sn = ss.str();
-
-    llvm::GlobalVariable *gData = M->getNamedGlobal(sn);
-
-    //if we thought it was a global, we should be able to
-    //pin it to a global array we made during module setup
-    if (gData == nullptr)
-      throw TErr(__LINE__, __FILE__, "Global variable not found");
-
-    // since globals are now a structure
-    // we cannot simply slice into them.
-    // Need to get ptr and then add integer displacement to ptr
-    //
-    llvm::Type *int_ty = llvm::Type::getIntNTy(b->getContext(), width);
-    llvm::Value *intVal = new llvm::PtrToIntInst(gData, int_ty, "", b);
-    uint64_t addr_offset = original_addr - baseGlobal;
-    llvm::Value *int_adjusted = llvm::BinaryOperator::CreateAdd(
-        intVal, CONST_V<width>(b, addr_offset), "", b);
-    return int_adjusted;
-  } else {
+  auto data_ptr = getDataPtrFromOriginalAddr(original_addr, mod, addr_start,
+                                             b);
+  if (!data_ptr) {
     return nullptr;
   }
+  return llvm::ConstantExpr::getPtrToInt(
+      data_ptr, llvm::Type::getIntNTy(b->getContext(), width));
 }
 
 // same as the simpler form, see above
@@ -176,6 +168,7 @@ llvm::Value *getAddrFromExpr(llvm::BasicBlock *b, NativeModulePtr mod,
 
 // this is an alias for getAddressFromExpr, but used when
 // we expect the address computation to contain a data reference
+template <int addr_width>
 llvm::Value *MEM_AS_DATA_REF(llvm::BasicBlock *B, NativeModulePtr natM,
                              const llvm::MCInst &inst, NativeInstPtr ip,
                              uint32_t which);
@@ -213,13 +206,10 @@ static llvm::Value *IMM_AS_DATA_REF(llvm::BasicBlock *B, NativeModulePtr mod,
     return addrInt;
 
   } else if (addrIsInData(off, mod, baseGlobal, 0)) {
-    std::stringstream ss;
-    ss << "data_" << std::hex << baseGlobal;
     //we should be able to find a reference to this in global data
     auto M = B->getParent()->getParent();
-    std::string sn = ss.str();
     llvm::Value *int_adjusted = nullptr;
-    auto gData = M->getNamedGlobal(sn);
+    auto gData = mod->getDataSectionVar(baseGlobal, M);
 
     //if we thought it was a global, we should be able to
     //pin it to a global variable we made during module setup
@@ -227,15 +217,10 @@ static llvm::Value *IMM_AS_DATA_REF(llvm::BasicBlock *B, NativeModulePtr mod,
       throw TErr(__LINE__, __FILE__, "Global variable not found");
     }
 
-    // since globals are now a structure
-    // we cannot simply slice into them.
-    // Need to get ptr and then add integer displacement to ptr
-
     auto ty = llvm::Type::getIntNTy(C, width);
-    auto intVal = new llvm::PtrToIntInst(gData, ty, "", B);
     uint32_t addr_offset = off - baseGlobal;
-    int_adjusted = llvm::BinaryOperator::CreateAdd(
-        intVal, CONST_V<width>(B, addr_offset), "", B);
+    int_adjusted = llvm::ConstantExpr::getPtrToInt(
+        getDataSectionAddr(gData, addr_offset), ty);
     //then, assign this to the outer 'd' so that the rest of the
     //logic picks up on that address instead of another address
 
@@ -246,20 +231,6 @@ static llvm::Value *IMM_AS_DATA_REF(llvm::BasicBlock *B, NativeModulePtr mod,
   }
 }
 
-// Assume the instruction has a data reference, and
-// return a computed pointer to that data reference
-static llvm::Value* IMM_AS_DATA_REF(llvm::BasicBlock *b, NativeModulePtr mod,
-                                    NativeInstPtr ip) {
-
-  auto M = b->getParent()->getParent();
-  int regWidth = ArchPointerSize(M);
-  if (Pointer32 == regWidth) {
-    return IMM_AS_DATA_REF<32>(b, mod, ip);
-  } else {
-    return IMM_AS_DATA_REF<64>(b, mod, ip);
-  }
-}
-
 static inline llvm::PointerType *getVoidPtrType(llvm::LLVMContext & C) {
   auto Int8Type = llvm::IntegerType::getInt8Ty(C);
   return llvm::PointerType::getUnqual(Int8Type);
@@ -278,7 +249,7 @@ static llvm::Value *ADDR_NOREF_IMPL(NativeModulePtr natM, llvm::BasicBlock *b,
     return addrInt;
   }
 
-  if (ArchPointerSize(M) == Pointer32) {
+  if (32 == width) {
     return x86::getAddrFromExpr(b, natM, inst.getOperand(x + 0),
                                 inst.getOperand(x + 1), inst.getOperand(x + 2),
                                 inst.getOperand(x + 3).getImm(),
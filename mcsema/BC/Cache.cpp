@@ -0,0 +1,356 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+
+#include <llvm/Bitcode/ReaderWriter.h>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/Linker/Linker.h>
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/BC/Cache.h"
+#include "mcsema/BC/Outline.h"
+#include "mcsema/CFG/Externals.h"
+#include "mcsema/cfgToLLVM/TransExcn.h"
+
+namespace {
+
+// Bump this whenever the lifter changes the code that it emits, so that
+// functions lifted by older versions are not reused.
+static const char * const kLiftCacheVersion = "2";
+
+static std::string HashString(const std::string &str) {
+  llvm::MD5 hasher;
+  hasher.update(str);
+  llvm::MD5::MD5Result result;
+  hasher.final(result);
+  llvm::SmallString<32> hex;
+  llvm::MD5::stringifyResult(result, hex);
+  return hex.str();
+}
+
+// Declare the global `gv` in `M`. Breakpoint functions are defined instead,
+// because they aren't recreated when the cached function is loaded.
+static llvm::GlobalValue *DeclareGlobal(llvm::Module *M,
+                                        llvm::GlobalValue *gv) {
+  auto linkage = gv->hasExternalWeakLinkage() ?
+                 llvm::GlobalValue::ExternalWeakLinkage :
+                 llvm::GlobalValue::ExternalLinkage;
+
+  if (auto func = llvm::dyn_cast<llvm::Function>(gv)) {
+    auto decl = llvm::Function::Create(
+        func->getFunctionType(), linkage, func->getName(), M);
+    decl->copyAttributesFrom(func);
+
+    if (!func->isDeclaration() && func->getName().startswith("breakpoint_")) {
+      decl->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+      llvm::IRBuilder<> ir(llvm::BasicBlock::Create(M->getContext(), "", decl));
+      ir.CreateRetVoid();
+    }
+    return decl;
+
+  } else if (auto var = llvm::dyn_cast<llvm::GlobalVariable>(gv)) {
+    return new llvm::GlobalVariable(
+        *M, var->getType()->getElementType(), var->isConstant(), linkage,
+        nullptr, var->getName(), nullptr, var->getThreadLocalMode(),
+        var->getType()->getAddressSpace());
+
+  } else {
+    return nullptr;
+  }
+}
+
+// Copy `F` into a new module that declares everything `F` refers to.
+static std::unique_ptr<llvm::Module> ExtractFunction(llvm::Function *F) {
+  auto M = F->getParent();
+  std::unique_ptr<llvm::Module> FM(
+      new llvm::Module(F->getName(), M->getContext()));
+  FM->setTargetTriple(M->getTargetTriple());
+  FM->setDataLayout(M->getDataLayout());
+
+  auto NF = llvm::Function::Create(
+      F->getFunctionType(), llvm::GlobalValue::ExternalLinkage, F->getName(),
+      FM.get());
+  NF->copyAttributesFrom(F);
+
+  llvm::ValueToValueMapTy value_map;
+  value_map[F] = NF;
+  auto new_arg = NF->arg_begin();
+  for (auto &arg : F->args()) {
+    new_arg->setName(arg.getName());
+    value_map[&arg] = &*new_arg++;
+  }
+
+  std::vector<llvm::Value *> work_list;
+  for (auto &B : *F) {
+    for (auto &I : B) {
+      for (auto &op : I.operands()) {
+        work_list.push_back(op.get());
+      }
+    }
+  }
+
+  std::vector<std::pair<llvm::Function *, llvm::Function *>> helpers;
+  std::vector<std::pair<llvm::GlobalVariable *, llvm::GlobalVariable *>>
+      private_vars;
+  std::unordered_set<llvm::Value *> seen;
+  while (!work_list.empty()) {
+    auto val = work_list.back();
+    work_list.pop_back();
+    if (!seen.insert(val).second) {
+      continue;
+    }
+
+    if (auto gv = llvm::dyn_cast<llvm::GlobalValue>(val)) {
+      if (!value_map.count(gv)) {
+        auto decl = DeclareGlobal(FM.get(), gv);
+        if (!decl) {
+          return nullptr;
+        }
+        value_map[gv] = decl;
+
+        // Outlined semantics are copied along with the function, because
+        // the module that loads the function may not have lifted them.
+        // Private variables, e.g. jump tables of block addresses, belong to
+        // the function, and are copied once the function has been cloned.
+        auto var = llvm::dyn_cast<llvm::GlobalVariable>(gv);
+        if (var && var->hasPrivateLinkage() && var->hasInitializer()) {
+          auto new_var = llvm::cast<llvm::GlobalVariable>(decl);
+          new_var->setLinkage(llvm::GlobalValue::PrivateLinkage);
+          private_vars.push_back({var, new_var});
+          work_list.push_back(var->getInitializer());
+        }
+
+        auto func = llvm::dyn_cast<llvm::Function>(gv);
+        if (func && IsOutlinedSemantics(func)) {
+          auto helper = llvm::cast<llvm::Function>(decl);
+          helper->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+          auto helper_arg = helper->arg_begin();
+          for (auto &arg : func->args()) {
+            value_map[&arg] = &*helper_arg++;
+          }
+          helpers.push_back({func, helper});
+          for (auto &B : *func) {
+            for (auto &I : B) {
+              for (auto &op : I.operands()) {
+                work_list.push_back(op.get());
+              }
+            }
+          }
+        }
+      }
+    } else if (auto c = llvm::dyn_cast<llvm::Constant>(val)) {
+      for (auto &op : c->operands()) {
+        work_list.push_back(op.get());
+      }
+    }
+  }
+
+  llvm::SmallVector<llvm::ReturnInst *, 8> returns;
+  llvm::CloneFunctionInto(NF, F, value_map, true, returns);
+  for (const auto &helper : helpers) {
+    returns.clear();
+    llvm::CloneFunctionInto(helper.second, helper.first, value_map, true,
+                            returns);
+  }
+  for (const auto &var : private_vars) {
+    var.second->setInitializer(
+        llvm::MapValue(var.first->getInitializer(), value_map));
+  }
+  return FM;
+}
+
+}  // namespace
+
+std::string HashLiftContext(NativeModulePtr natMod,
+                            const std::string &options) {
+  std::stringstream ss;
+  ss << kLiftCacheVersion << ";" << ArchTriple() << ";" << options;
+
+  for (const auto &dt : natMod->getData()) {
+    ss << ";data:" << std::hex << dt.getBase() << "," << dt.getSize()
+       << "," << dt.isReadOnly();
+  }
+
+  // Dead register elimination depends on which functions are entry points.
+  for (const auto &ep : natMod->getEntryPoints()) {
+    ss << ";entry:" << std::hex << ep.getAddr();
+  }
+
+  for (auto e : natMod->getExtCalls()) {
+    ss << ";func:" << e->getSymbolName() << ","
+       << static_cast<int>(e->getNumArgs()) << ","
+       << e->getCallingConvention() << "," << e->getReturnType() << ","
+       << e->isWeak() << "," << e->getFunctionSignature() << ","
+       << e->isDirect();
+  }
+
+  for (auto e : natMod->getExtDataRefs()) {
+    ss << ";var:" << e->getSymbolName() << "," << e->getDataSize()
+       << "," << e->isWeak();
+  }
+
+  return HashString(ss.str());
+}
+
+std::string GetLiftCacheKey(const std::string &context,
+                            NativeFunctionPtr func) {
+  TASSERT(!func->get_fingerprint().empty(),
+          "Function " + func->get_name() + " has no fingerprint");
+  std::stringstream ss;
+  ss << context << ";" << func->get_name() << ";" << func->get_fingerprint();
+
+  // Tables that are lifted as data sections are placed after the other data
+  // sections when the module is lifted, so their addresses aren't part of
+  // the fingerprint.
+  for (const auto &block_info : func->get_blocks()) {
+    for (auto inst : block_info.second->get_insts()) {
+      if ((inst->has_jump_table() || inst->has_jump_index_table()) &&
+          inst->has_reference(NativeInst::MEMRef)) {
+        ss << ";table:" << std::hex << inst->get_loc() << ","
+           << inst->get_reference(NativeInst::MEMRef);
+      }
+    }
+  }
+  return HashString(ss.str());
+}
+
+bool LoadCachedFunction(const std::string &path, llvm::Module *M) {
+  auto buff = llvm::MemoryBuffer::getFile(path);
+  if (!buff) {
+    return false;
+  }
+
+  auto FM = llvm::parseBitcodeFile(buff.get()->getMemBufferRef(),
+                                   M->getContext());
+  if (!FM) {
+    std::cerr
+        << "WARNING: Ignoring unreadable cached function " << path << ": "
+        << FM.getError().message() << std::endl;
+    return false;
+  }
+
+  // Callback drivers are defined with module-level inline assembly, which
+  // isn't cached, so they are recreated in `M`.
+  for (auto &func : *FM.get()) {
+    auto name = func.getName();
+    if (func.isDeclaration() && name.startswith("callback_sub_")) {
+      auto addr = std::strtoull(name.substr(13).str().c_str(), nullptr, 16);
+      if (!ArchAddCallbackDriver(M, static_cast<VA>(addr))) {
+        throw TErr(__LINE__, __FILE__,
+                   "Could not recreate " + name.str() + " for " + path);
+      }
+    }
+  }
+
+  // The linker won't resolve references to internal globals, so the lifted
+  // functions and data sections that the cached function refers to are made
+  // external until it is linked in.
+  std::vector<std::pair<llvm::GlobalValue *,
+                        llvm::GlobalValue::LinkageTypes>> internal_globals;
+  auto externalize = [&] (llvm::GlobalValue &gv) {
+    auto dest_gv = M->getNamedValue(gv.getName());
+    if (dest_gv && dest_gv->hasLocalLinkage()) {
+      internal_globals.emplace_back(dest_gv, dest_gv->getLinkage());
+      dest_gv->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+  };
+  for (auto &func : *FM.get()) {
+    externalize(func);
+  }
+  for (auto &var : FM.get()->globals()) {
+    externalize(var);
+  }
+
+  if (llvm::Linker::linkModules(*M, std::move(FM.get()))) {
+    throw TErr(__LINE__, __FILE__, "Could not link cached function " + path);
+  }
+
+  for (auto &gv_linkage : internal_globals) {
+    gv_linkage.first->setLinkage(gv_linkage.second);
+  }
+  return true;
+}
+
+bool StoreCachedFunction(const std::string &path, llvm::Function *F) {
+  auto FM = ExtractFunction(F);
+  if (!FM) {
+    return false;
+  }
+
+  // Write to a temporary file first, so that concurrent runs sharing the
+  // cache never see a partially written function.
+  int fd = -1;
+  llvm::SmallString<128> tmp_path;
+  if (llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, tmp_path)) {
+    return false;
+  }
+
+  auto ok = true;
+  {
+    llvm::raw_fd_ostream os(fd, true);
+    llvm::WriteBitcodeToFile(FM.get(), os);
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      ok = false;
+    }
+  }
+
+  if (ok && !llvm::sys::fs::rename(tmp_path, path)) {
+    return true;
+  }
+
+  llvm::sys::fs::remove(tmp_path);
+  return false;
+}
@@ -0,0 +1,65 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_CACHE_H_
+#define MCSEMA_BC_CACHE_H_
+
+#include <string>
+
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class Function;
+class Module;
+
+}  // namespace llvm
+
+// Returns a hash of everything outside of a function that affects how the
+// function is lifted: the target, the lifting options in `options`, the
+// layout of the data sections, and the externals.
+std::string HashLiftContext(NativeModulePtr natMod, const std::string &options);
+
+// Returns the name under which the lifted form of `func` is cached. The
+// name is derived from the fingerprint of `func`, the addresses of the data
+// sections made from its jump tables, and from the lift context `context`.
+// The tables' data sections must already have been added, i.e. `func` must
+// have been pre-processed.
+std::string GetLiftCacheKey(const std::string &context, NativeFunctionPtr func);
+
+// Load the cached function at `path` and link it into `M`. Returns false if
+// there is no valid cached function at `path`.
+bool LoadCachedFunction(const std::string &path, llvm::Module *M);
+
+// Save the lifted function `F` into the cache file `path`, along with
+// declarations of everything that it refers to.
+bool StoreCachedFunction(const std::string &path, llvm::Function *F);
+
+#endif  // MCSEMA_BC_CACHE_H_
@@ -0,0 +1,222 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+
+#include <llvm/lib/Target/X86/X86RegisterInfo.h>
+
+#include <llvm/Transforms/Utils/Local.h>
+
+#include "mcsema/Arch/Register.h"
+#include "mcsema/BC/Flags.h"
+#include "mcsema/BC/Util.h"
+
+namespace {
+
+static const MCSemaRegs kFlagRegs[] = {
+  llvm::X86::CF,
+  llvm::X86::PF,
+  llvm::X86::AF,
+  llvm::X86::ZF,
+  llvm::X86::SF,
+  llvm::X86::OF,
+  llvm::X86::DF
+};
+
+// A load or store of one of the flags, represented as a bit in a flag mask.
+struct FlagAccess {
+  uint32_t flag;
+  bool is_store;
+};
+
+using FlagAccessMap = std::unordered_map<llvm::Instruction *, FlagAccess>;
+
+// Find the loads and stores of the flag whose register variable is `var`.
+// Returns false if the address of the flag escapes.
+static bool GetFlagAccesses(llvm::Value *var, uint32_t flag,
+                            FlagAccessMap &accesses) {
+  FlagAccessMap flag_accesses;
+  std::vector<llvm::Value *> work_list = {var};
+  while (!work_list.empty()) {
+    auto val = work_list.back();
+    work_list.pop_back();
+
+    for (auto user : val->users()) {
+      if (llvm::isa<llvm::BitCastInst>(user)) {
+        work_list.push_back(user);
+
+      } else if (auto load = llvm::dyn_cast<llvm::LoadInst>(user)) {
+        flag_accesses[load] = {flag, false};
+
+      } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+        if (store->getValueOperand() == val) {
+          return false;
+        }
+        // Volatile stores are treated like reads, so that neither they nor
+        // the stores before them are removed.
+        flag_accesses[store] = {flag, !store->isVolatile()};
+
+      } else {
+        return false;
+      }
+    }
+  }
+  accesses.insert(flag_accesses.begin(), flag_accesses.end());
+  return true;
+}
+
+// Returns true if the state structure is modified or observed by something
+// other than the accesses in `F`, in a way that breaks the analysis.
+static bool StateEscapes(llvm::Function *F, const RegisterTable *regs) {
+  auto state_ptr = &*F->arg_begin();
+  std::unordered_set<llvm::Value *> reg_vars(regs->write.begin(),
+                                             regs->write.end());
+  for (auto user : state_ptr->users()) {
+    if (reg_vars.count(user) || llvm::isa<llvm::CallInst>(user)) {
+      continue;
+    } else if (auto gep = llvm::dyn_cast<llvm::GetElementPtrInst>(user)) {
+      auto field = GetStateFieldIndex(gep);
+      if (0 > field) {
+        return true;
+      }
+      for (auto reg : kFlagRegs) {
+        auto flag_gep = llvm::dyn_cast_or_null<llvm::GetElementPtrInst>(
+            regs->write[reg]);
+        if (flag_gep && GetStateFieldIndex(flag_gep) == field) {
+          return true;
+        }
+      }
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Compute the flags that are live on entry to `B`, given the flags that are
+// live on entry to its successors. If `dead_stores` is non-null, then the
+// stores whose values are never read are added to it.
+static uint32_t LiveFlagsIn(
+    llvm::BasicBlock *B, uint32_t all_flags, const FlagAccessMap &accesses,
+    const std::unordered_map<llvm::BasicBlock *, uint32_t> &live_in,
+    std::vector<llvm::StoreInst *> *dead_stores) {
+
+  uint32_t live = 0;
+  auto term = B->getTerminator();
+  if (!term || !term->getNumSuccessors()) {
+    live = all_flags;
+  } else {
+    for (auto succ : llvm::successors(B)) {
+      auto live_it = live_in.find(succ);
+      if (live_it != live_in.end()) {
+        live |= live_it->second;
+      }
+    }
+  }
+
+  for (auto it = B->rbegin(); it != B->rend(); ++it) {
+    auto inst = &*it;
+    auto access_it = accesses.find(inst);
+    if (access_it != accesses.end()) {
+      const auto &access = access_it->second;
+      if (!access.is_store) {
+        live |= access.flag;
+      } else {
+        if (dead_stores && !(live & access.flag)) {
+          dead_stores->push_back(llvm::cast<llvm::StoreInst>(inst));
+        }
+        live &= ~access.flag;
+      }
+    } else if (auto call = llvm::dyn_cast<llvm::CallInst>(inst)) {
+      if (IsStateSyncPoint(call)) {
+        live = all_flags;
+      }
+    }
+  }
+  return live;
+}
+
+}  // namespace
+
+void RemoveDeadFlagStores(llvm::Function *F, const RegisterTable *regs) {
+  if (StateEscapes(F, regs)) {
+    return;
+  }
+
+  FlagAccessMap accesses;
+  uint32_t all_flags = 0;
+  uint32_t next_flag = 1;
+  for (auto reg : kFlagRegs) {
+    auto var = regs->write[reg];
+    if (var && GetFlagAccesses(var, next_flag, accesses)) {
+      all_flags |= next_flag;
+    }
+    next_flag <<= 1;
+  }
+
+  if (!all_flags) {
+    return;
+  }
+
+  // Iterate to a fixed point. Blocks are visited in reverse, which roughly
+  // follows the flow of liveness.
+  std::unordered_map<llvm::BasicBlock *, uint32_t> live_in;
+  for (auto changed = true; changed; ) {
+    changed = false;
+    for (auto it = F->getBasicBlockList().rbegin();
+         it != F->getBasicBlockList().rend(); ++it) {
+      auto B = &*it;
+      auto live = LiveFlagsIn(B, all_flags, accesses, live_in, nullptr);
+      auto &old_live = live_in[B];
+      if (live != old_live) {
+        old_live = live;
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<llvm::StoreInst *> dead_stores;
+  for (auto &B : *F) {
+    LiveFlagsIn(&B, all_flags, accesses, live_in, &dead_stores);
+  }
+
+  for (auto store : dead_stores) {
+    auto val = store->getValueOperand();
+    store->eraseFromParent();
+    llvm::RecursivelyDeleteTriviallyDeadInstructions(val);
+  }
+}
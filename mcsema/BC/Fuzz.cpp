@@ -0,0 +1,254 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include <llvm/Support/CommandLine.h>
+
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+#include "mcsema/BC/Fuzz.h"
+#include "mcsema/CFG/CFG.h"
+
+static llvm::cl::opt<bool> FuzzInstrument(
+    "fuzz-instrument",
+    llvm::cl::desc(
+        "Instrument the lifted code for coverage-guided fuzzing, e.g. with "
+        "libFuzzer. Edges between native blocks call "
+        "__sanitizer_cov_trace_pc_guard, and the operands of CMP, TEST and "
+        "SUB are passed to __sanitizer_cov_trace_cmp*. The lifted program "
+        "must be linked against a fuzzing runtime that defines them."),
+    llvm::cl::init(false));
+
+namespace {
+
+static const char * const kGuardsSection = "__sancov_guards";
+static const char * const kGuardInitName = "__mcsema_fuzz_guard_init";
+
+// The sanitizers use this priority for their own constructors.
+static const int kGuardInitPriority = 2;
+
+static llvm::Function *GetHook(llvm::Module *M, const char *name,
+                               llvm::ArrayRef<llvm::Type *> params) {
+  auto &C = M->getContext();
+  auto hook_ty = llvm::FunctionType::get(llvm::Type::getVoidTy(C), params,
+                                         false);
+  auto hook = llvm::cast<llvm::Function>(
+      M->getOrInsertFunction(name, hook_ty));
+  hook->addFnAttr(llvm::Attribute::NoUnwind);
+  return hook;
+}
+
+static llvm::GlobalVariable *GetGuardsBound(llvm::Module *M,
+                                            const char *name) {
+  auto var = M->getNamedGlobal(name);
+  if (!var) {
+    var = new llvm::GlobalVariable(
+        *M, llvm::Type::getInt32Ty(M->getContext()), false,
+        llvm::GlobalValue::ExternalWeakLinkage, nullptr, name);
+    var->setVisibility(llvm::GlobalValue::HiddenVisibility);
+  }
+  return var;
+}
+
+// Returns true if `a` and `b` are reads of the same register, e.g. the
+// operands of `test eax, eax`.
+static bool IsSameRegister(llvm::Value *a, llvm::Value *b) {
+  auto load_a = llvm::dyn_cast<llvm::LoadInst>(a);
+  auto load_b = llvm::dyn_cast<llvm::LoadInst>(b);
+  return a == b || (load_a && load_b &&
+                    load_a->getPointerOperand() == load_b->getPointerOperand());
+}
+
+// Moves the edges from `B` to `S` onto a new block between them.
+static llvm::BasicBlock *SplitNativeEdge(llvm::BasicBlock *B,
+                                         llvm::BasicBlock *S) {
+  auto E = llvm::BasicBlock::Create(B->getContext(), "edge_" + S->getName(),
+                                    B->getParent(), S);
+  llvm::BranchInst::Create(S, E);
+
+  auto term = B->getTerminator();
+  for (unsigned i = 0; i < term->getNumSuccessors(); ++i) {
+    if (term->getSuccessor(i) == S) {
+      term->setSuccessor(i, E);
+    }
+  }
+
+  // `S` is now reached from `B` along a single edge, through `E`.
+  for (auto &I : *S) {
+    auto phi = llvm::dyn_cast<llvm::PHINode>(&I);
+    if (!phi) {
+      break;
+    }
+    phi->setIncomingBlock(phi->getBasicBlockIndex(B), E);
+    while (0 <= phi->getBasicBlockIndex(B)) {
+      phi->removeIncomingValue(B, false);
+    }
+  }
+  return E;
+}
+
+}  // namespace
+
+bool FuzzInstrumentEnabled(void) {
+  return FuzzInstrument;
+}
+
+bool IsFuzzHook(llvm::Function *F) {
+  return F && F->getName().startswith("__sanitizer_cov_");
+}
+
+void AddFuzzCmpHook(llvm::BasicBlock *B, llvm::Value *lhs, llvm::Value *rhs) {
+  if (!FuzzInstrument || IsSameRegister(lhs, rhs) ||
+      (llvm::isa<llvm::Constant>(lhs) && llvm::isa<llvm::Constant>(rhs))) {
+    return;
+  }
+
+  const char *name = nullptr;
+  switch (lhs->getType()->getIntegerBitWidth()) {
+    case 8: name = "__sanitizer_cov_trace_cmp1"; break;
+    case 16: name = "__sanitizer_cov_trace_cmp2"; break;
+    case 32: name = "__sanitizer_cov_trace_cmp4"; break;
+    case 64: name = "__sanitizer_cov_trace_cmp8"; break;
+    default: return;
+  }
+
+  auto M = B->getParent()->getParent();
+  auto hook = GetHook(M, name, {lhs->getType(), lhs->getType()});
+  llvm::CallInst::Create(hook, {lhs, rhs}, "", B);
+}
+
+void AddFuzzEdgeGuards(llvm::Function *F,
+                       const std::unordered_map<VA, llvm::BasicBlock *> &va_to_bb) {
+  if (!FuzzInstrument) {
+    return;
+  }
+
+  std::unordered_set<llvm::BasicBlock *> native_blocks;
+  native_blocks.reserve(va_to_bb.size());
+  for (const auto &entry : va_to_bb) {
+    native_blocks.insert(entry.second);
+  }
+
+  // Blocks made by `SplitNativeEdge` aren't sources of native edges.
+  std::vector<llvm::BasicBlock *> sources;
+  for (auto &B : *F) {
+    sources.push_back(&B);
+  }
+
+  std::vector<llvm::Instruction *> guard_pts;
+  for (auto B : sources) {
+    auto term = B->getTerminator();
+    if (!term) {
+      continue;
+    }
+
+    std::vector<llvm::BasicBlock *> succs;
+    for (unsigned i = 0; i < term->getNumSuccessors(); ++i) {
+      auto S = term->getSuccessor(i);
+      if (std::find(succs.begin(), succs.end(), S) == succs.end()) {
+        succs.push_back(S);
+      }
+    }
+
+    for (auto S : succs) {
+      if (!native_blocks.count(S) || S->empty()) {
+        continue;
+      }
+      if (S->getSinglePredecessor() == B) {
+        guard_pts.push_back(&*S->getFirstInsertionPt());
+      } else if (1 == succs.size()) {
+        guard_pts.push_back(term);
+      } else {
+        guard_pts.push_back(SplitNativeEdge(B, S)->getTerminator());
+      }
+    }
+  }
+
+  if (guard_pts.empty()) {
+    return;
+  }
+
+  auto M = F->getParent();
+  auto int32_ty = llvm::Type::getInt32Ty(M->getContext());
+  auto guards_ty = llvm::ArrayType::get(int32_ty, guard_pts.size());
+  auto guards = new llvm::GlobalVariable(
+      *M, guards_ty, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantAggregateZero::get(guards_ty),
+      F->getName() + "_sancov_guards");
+  guards->setSection(kGuardsSection);
+  guards->setAlignment(4);
+
+  auto hook = GetHook(M, "__sanitizer_cov_trace_pc_guard",
+                      {llvm::PointerType::get(int32_ty, 0)});
+  for (unsigned i = 0; i < guard_pts.size(); ++i) {
+    llvm::IRBuilder<> ir(guard_pts[i]);
+    ir.CreateCall(hook, {ir.CreateConstInBoundsGEP2_32(guards_ty, guards, 0,
+                                                        i)});
+  }
+}
+
+void AddFuzzGuardInit(llvm::Module *M) {
+  if (!FuzzInstrument || M->getFunction(kGuardInitName)) {
+    return;
+  }
+
+  auto &C = M->getContext();
+  auto int32_ptr_ty = llvm::Type::getInt32PtrTy(C);
+  auto hook = GetHook(M, "__sanitizer_cov_trace_pc_guard_init",
+                      {int32_ptr_ty, int32_ptr_ty});
+
+  // The linker defines these around the guards of every lifted function.
+  auto start = GetGuardsBound(M, "__start___sancov_guards");
+  auto stop = GetGuardsBound(M, "__stop___sancov_guards");
+
+  auto init = llvm::Function::Create(
+      llvm::FunctionType::get(llvm::Type::getVoidTy(C), false),
+      llvm::GlobalValue::InternalLinkage, kGuardInitName, M);
+  auto B = llvm::BasicBlock::Create(C, "", init);
+  llvm::CallInst::Create(hook, {start, stop}, "", B);
+  llvm::ReturnInst::Create(C, B);
+  llvm::appendToGlobalCtors(*M, init, kGuardInitPriority);
+}
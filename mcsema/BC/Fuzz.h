@@ -0,0 +1,74 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_FUZZ_H_
+#define MCSEMA_BC_FUZZ_H_
+
+#include <unordered_map>
+
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class BasicBlock;
+class Function;
+class Module;
+class Value;
+
+}  // namespace llvm
+
+// Returns true if lifted code is instrumented for coverage-guided fuzzing
+// with `-fuzz-instrument`.
+bool FuzzInstrumentEnabled(void);
+
+// Returns true if `F` is one of the sanitizer coverage hooks. The hooks never
+// touch the register state structure.
+bool IsFuzzHook(llvm::Function *F);
+
+// Passes the operands of a lifted comparison to the matching
+// `__sanitizer_cov_trace_cmp*` hook, at the end of `B`. Nothing is added
+// without `-fuzz-instrument`, or if the operands are constants or the same
+// register.
+void AddFuzzCmpHook(llvm::BasicBlock *B, llvm::Value *lhs, llvm::Value *rhs);
+
+// Calls `__sanitizer_cov_trace_pc_guard` on every edge between the native
+// blocks `va_to_bb` of the lifted function `F`, and on the edge into its
+// entry block. A guard goes into the target block if the edge is its only
+// way in, into the source block if the edge is its only way out, and
+// otherwise into a new block on the edge. The guards of `F` are kept in the
+// `__sancov_guards` section.
+void AddFuzzEdgeGuards(llvm::Function *F,
+                       const std::unordered_map<VA, llvm::BasicBlock *> &va_to_bb);
+
+// Adds a constructor to `M` that registers the guards of the
+// `__sancov_guards` section with `__sanitizer_cov_trace_pc_guard_init`.
+void AddFuzzGuardInit(llvm::Module *M);
+
+#endif  // MCSEMA_BC_FUZZ_H_
@@ -26,6 +26,7 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/StringSwitch.h>
 
 #include <llvm/Bitcode/ReaderWriter.h>
@@ -33,6 +34,7 @@
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
@@ -40,14 +42,51 @@
 #include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
+#include <llvm/IR/Verifier.h>
 
-#include <llvm/Support/CommandLine.h>
+#include <llvm/Linker/Linker.h>
 
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Dwarf.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "mcsema/Arch/Arch.h"
 #include "mcsema/Arch/Dispatch.h"
+#include "mcsema/Arch/X86/Runtime/BlockCounters.h"
+#include "mcsema/BC/Cache.h"
+#include "mcsema/BC/Flags.h"
+#include "mcsema/BC/Fuzz.h"
 #include "mcsema/BC/Lift.h"
+#include "mcsema/BC/Liveness.h"
+#include "mcsema/BC/Lookup.h"
+#include "mcsema/BC/Memoize.h"
+#include "mcsema/BC/Outline.h"
+#include "mcsema/BC/Output.h"
+#include "mcsema/BC/Profile.h"
+#include "mcsema/BC/Promote.h"
+#include "mcsema/BC/Share.h"
+#include "mcsema/BC/Stats.h"
+#include "mcsema/BC/Superblock.h"
 #include "mcsema/BC/Util.h"
 #include "mcsema/CFG/CFG.h"
 
@@ -77,6 +116,283 @@ static llvm::cl::opt<bool> AddBreakpoints(
         "specific lifted instruction is executed."),
     llvm::cl::init(false));
 
+static llvm::cl::opt<bool> NameBlocks(
+    "name-blocks",
+    llvm::cl::desc(
+        "Name every lifted basic block after the native block that it comes "
+        "from, e.g. block_401000, to make the lifted code easier to read. "
+        "Blocks are unnamed by default, which is faster for big functions."),
+    llvm::cl::init(false));
+
+enum AddressMapMode {
+  kAddressMapMetadata,
+  kAddressMapLines
+};
+
+static llvm::cl::opt<AddressMapMode> AddressMap(
+    "address-map",
+    llvm::cl::desc("How lifted instructions are mapped back to their native "
+                   "addresses:"),
+    llvm::cl::values(
+        clEnumValN(kAddressMapMetadata, "metadata",
+                   "Attach a mcsema_real_eip metadata node to every lifted "
+                   "instruction"),
+        clEnumValN(kAddressMapLines, "lines",
+                   "Give every lifted instruction a debug location whose line "
+                   "is the low 32 bits of the native address. The line of "
+                   "each function's subprogram holds the high 32 bits of its "
+                   "entry address"),
+        clEnumValEnd),
+    llvm::cl::init(kAddressMapMetadata));
+
+enum BreakpointMode {
+  kBreakpointPerInstruction,
+  kBreakpointShared
+};
+
+static llvm::cl::opt<bool> AddBlockCounters(
+    "add-block-counters",
+    llvm::cl::desc(
+        "Count how many times each lifted block runs. The counters are kept "
+        "in the " MCSEMA_BLOCK_COUNTERS_SECTION " section; link "
+        "tools/blockcount/BlockCounters.c into the lifted program to write "
+        "them out in the format that -profile reads."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<BreakpointMode> BreakpointKind(
+    "breakpoint-mode",
+    llvm::cl::desc("How -add-breakpoints marks each lifted instruction:"),
+    llvm::cl::values(
+        clEnumValN(kBreakpointPerInstruction, "per-instruction",
+                   "Call a separate breakpoint_<pc> function"),
+        clEnumValN(kBreakpointShared, "shared",
+                   "Call __mcsema_breakpoint(state, pc), but only while "
+                   "__mcsema_breakpoints_enabled is non-zero"),
+        clEnumValEnd),
+    llvm::cl::init(kBreakpointPerInstruction));
+
+static llvm::cl::opt<unsigned> NumJobs(
+    "jobs",
+    llvm::cl::desc(
+        "Number of threads to use for lifting functions. Each thread lifts "
+        "into its own module, and the modules are linked together once all "
+        "functions are lifted."),
+    llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> NumDataJobs(
+    "data-jobs",
+    llvm::cl::desc(
+        "Number of threads to use for resolving the symbols of data "
+        "sections. The section contents are still created on the main "
+        "thread."),
+    llvm::cl::init(1));
+
+static llvm::cl::opt<bool> EliminateDeadFlags(
+    "eliminate-dead-flags",
+    llvm::cl::desc(
+        "Only compute the flags that may be read before they are "
+        "overwritten."),
+    llvm::cl::init(true));
+
+static llvm::cl::opt<bool> EliminateDeadRegs(
+    "eliminate-dead-regs",
+    llvm::cl::desc(
+        "Don't write general purpose registers back into the register state "
+        "when every path from the instruction overwrites them before they "
+        "are read. Calls, indirect branches and returns are treated as "
+        "reading every register, except that the returns of the module's "
+        "entry symbols only read the return and callee-saved registers."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> PromoteRegisters(
+    "promote-registers",
+    llvm::cl::desc(
+        "Keep registers in local variables within each lifted function, and "
+        "only synchronize them with the register state structure around "
+        "calls and returns."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> LeanTransitions(
+    "lean-transitions",
+    llvm::cl::desc(
+        "When calling an external whose return type is known, only marshal "
+        "the argument, return and callee-saved registers between the native "
+        "and lifted states, instead of the whole register state."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> LazyPC(
+    "lazy-pc",
+    llvm::cl::desc(
+        "Only write the program counter into the register state before "
+        "instructions where it can be observed: calls, returns, indirect "
+        "branches, native transitions and instructions with side effects. "
+        "The -address-map still maps every lifted instruction back to its "
+        "native address."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> PrecisePC(
+    "precise-pc",
+    llvm::cl::desc(
+        "With -lazy-pc, also write the program counter before instructions "
+        "that access memory, so that it is exact when they fault."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir",
+    llvm::cl::desc(
+        "Directory in which to cache lifted functions. Functions that are "
+        "unchanged since a previous lift with the same options are loaded "
+        "from the cache instead of being lifted again."),
+    llvm::cl::init(""));
+
+static llvm::cl::list<std::string> OutlineSemantics(
+    "outline-semantics",
+    llvm::cl::desc(
+        "Comma-separated list of instruction families (e.g. FPU,SSE) whose "
+        "semantics are lifted into helper functions that are shared by every "
+        "instance of the same instruction, instead of being lifted inline."),
+    llvm::cl::value_desc("<families>"), llvm::cl::CommaSeparated);
+
+static llvm::cl::opt<bool> MemoizeInsts(
+    "memoize-insts",
+    llvm::cl::desc(
+        "Lift each distinct instruction (same opcode, prefix and operands) "
+        "once per module, and clone its IR into the blocks of later "
+        "instances instead of lifting them again."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> FuseIdioms(
+    "fuse-idioms",
+    llvm::cl::desc(
+        "Lift common instruction idioms within a block as a unit: a CMP or "
+        "TEST followed by a Jcc, SETcc or CMOVcc tests the compared values "
+        "directly instead of going through the flags, xor r, r writes zero, "
+        "and a pop right after a push takes the pushed register instead of "
+        "reloading it. The flags are still written for later readers."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> RecoverStackFrames(
+    "recover-stack-frames",
+    llvm::cl::desc(
+        "Keep the fixed stack frame of functions with a frame pointer "
+        "prologue (push rbp; mov rbp, rsp; sub rsp, N) in a local variable "
+        "of the lifted function, as long as the frame's address can't "
+        "escape. Other functions keep their frames on the native stack."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> AllowInlining(
+    "allow-inlining",
+    llvm::cl::desc(
+        "Let the optimizer inline lifted functions into each other. By "
+        "default they are marked noinline, so that the lifted and native "
+        "call graphs are one-to-one. Inlined instructions keep their native "
+        "address annotations."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> ElideReturnAddresses(
+    "elide-return-addresses",
+    llvm::cl::desc(
+        "Don't write the native return address onto the stack for direct "
+        "calls to functions that only read it to return through it, and "
+        "only leave by returning. The stack pointer still makes room for "
+        "it. Backtraces through such calls don't see the return address."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> ShareBlocks(
+    "share-blocks",
+    llvm::cl::desc(
+        "Lift the blocks that several functions share, e.g. common "
+        "epilogues, only once, into internal functions that the functions "
+        "tail-call. Only blocks whose successors are all shared too are "
+        "shared."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> FormSuperblocks(
+    "form-superblocks",
+    llvm::cl::desc(
+        "With a -profile, keep lifting hot blocks that fall through or jump "
+        "to a single successor into the successor, instead of branching to "
+        "it. Successors without other predecessors are merged, and short hot "
+        "successors are duplicated. Registers stay in SSA form across the "
+        "merged blocks with -promote-registers."),
+    llvm::cl::init(false));
+
+static llvm::cl::list<std::string> LiftFunctionsOpt(
+    "lift-functions",
+    llvm::cl::desc(
+        "Only lift the functions at these native addresses, given as hex "
+        "addresses or <begin>-<end> ranges (end exclusive), and only declare "
+        "the others. This produces a partial module; the partial modules of "
+        "one lift, lifted by different processes, are combined with -merge."),
+    llvm::cl::value_desc("<va | begin-end>"), llvm::cl::CommaSeparated);
+
+static llvm::cl::opt<bool> LiftData(
+    "lift-data",
+    llvm::cl::desc(
+        "With -lift-functions, also define the data sections, and the lookup "
+        "table if it is enabled, in this partial module. Exactly one partial "
+        "module of a lift should be lifted with this."),
+    llvm::cl::init(false));
+
+enum VerifyMode {
+  VerifyNothing,
+  VerifyEachFunction,
+  VerifyWholeModule
+};
+
+static llvm::cl::opt<VerifyMode> Verify(
+    "verify",
+    llvm::cl::desc("What to verify in the lifted module:"),
+    llvm::cl::values(
+        clEnumValN(VerifyNothing, "none", "Verify nothing"),
+        clEnumValN(VerifyEachFunction, "functions",
+                   "Verify each function as soon as it is lifted"),
+        clEnumValN(VerifyWholeModule, "module",
+                   "Verify the whole module once everything is lifted"),
+        clEnumValEnd),
+    llvm::cl::init(VerifyWholeModule));
+
+// Hash of the lifting context that keys the lift cache. Empty if the cache
+// isn't being used. These are per-thread because batch jobs lift different
+// modules on different threads.
+static thread_local std::string gLiftCacheContext;
+static thread_local unsigned gLiftCacheHits = 0;
+static thread_local unsigned gLiftCacheMisses = 0;
+
+// Lower-case names of the instruction families whose semantics are outlined.
+static std::set<std::string> gOutlinedFamilies;
+static std::once_flag gOutlinedFamiliesOnce;
+
+// True if the current thread is lifting into a module shard.
+static thread_local bool gLiftingIntoShard = false;
+
+// The native address ranges selected by `-lift-functions`, as
+// `[begin, end)` pairs.
+static std::vector<std::pair<VA, VA>> gLiftRanges;
+
+// The blocks that are lifted into shared tails, with `-share-blocks`. Set by
+// a `SharedBlocksGuard` on every thread that lifts into the module, because
+// batch jobs lift different modules at the same time.
+static thread_local const SharedBlocks *gSharedBlocks = nullptr;
+
+// Makes `shared` the shared blocks of the current thread while it lives.
+class SharedBlocksGuard {
+ public:
+  explicit SharedBlocksGuard(const SharedBlocks *shared)
+      : prev(gSharedBlocks) {
+    gSharedBlocks = shared;
+  }
+
+  ~SharedBlocksGuard(void) {
+    gSharedBlocks = prev;
+  }
+
+ private:
+  SharedBlocksGuard(const SharedBlocksGuard &) = delete;
+
+  const SharedBlocks *prev;
+};
+
 llvm::CallingConv::ID getLLVMCC(ExternalCodeRef::CallingConvention cc) {
   switch (cc) {
     case ExternalCodeRef::CallerCleanup:
@@ -102,6 +418,82 @@ llvm::CallingConv::ID getLLVMCC(ExternalCodeRef::CallingConvention cc) {
 //
 
 
+// Returns the shared breakpoint hook, `void __mcsema_breakpoint(state, pc)`.
+// The default body does nothing; a debugger can set a breakpoint on it (with
+// a condition on `pc`), or the runtime can provide its own definition.
+static llvm::Function *GetSharedBreakpoint(llvm::Module *M) {
+  static const char *kHookName = "__mcsema_breakpoint";
+  auto hook = M->getFunction(kHookName);
+  if (hook) {
+    return hook;
+  }
+
+  auto &C = M->getContext();
+  auto state_ptr_ty = LiftedFunctionType()->getParamType(0);
+  auto pc_ty = llvm::Type::getIntNTy(C, ArchAddressSize());
+  auto hook_ty = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(C), {state_ptr_ty, pc_ty}, false);
+
+  hook = llvm::Function::Create(hook_ty, llvm::GlobalValue::WeakAnyLinkage,
+                                kHookName, M);
+  hook->addFnAttr(llvm::Attribute::OptimizeNone);
+  hook->addFnAttr(llvm::Attribute::NoInline);
+  hook->addFnAttr(llvm::Attribute::Cold);
+
+  llvm::IRBuilder<> ir(llvm::BasicBlock::Create(C, "", hook));
+  ir.CreateRetVoid();
+  return hook;
+}
+
+// Returns `__mcsema_breakpoints_enabled`. It starts out as zero, and is
+// meant to be patched at runtime (e.g. from a debugger) to turn on the
+// shared breakpoint hook.
+static llvm::GlobalVariable *GetBreakpointsEnabled(llvm::Module *M) {
+  static const char *kFlagName = "__mcsema_breakpoints_enabled";
+  auto flag = M->getGlobalVariable(kFlagName);
+  if (flag) {
+    return flag;
+  }
+
+  auto i8_ty = llvm::Type::getInt8Ty(M->getContext());
+  return new llvm::GlobalVariable(
+      *M, i8_ty, false, llvm::GlobalValue::WeakAnyLinkage,
+      llvm::ConstantInt::get(i8_ty, 0), kFlagName);
+}
+
+// Calls the shared breakpoint hook if `__mcsema_breakpoints_enabled` is set.
+// This splits `B`, and updates it to point to the block where lifting should
+// continue.
+static void CreateSharedBreakpoint(llvm::BasicBlock *&B, VA pc) {
+  auto F = B->getParent();
+  auto M = F->getParent();
+  auto &C = M->getContext();
+
+  auto hook = GetSharedBreakpoint(M);
+  auto flag = GetBreakpointsEnabled(M);
+
+  auto call_block = llvm::BasicBlock::Create(C, "", F);
+  auto cont_block = llvm::BasicBlock::Create(C, "", F);
+
+  // The flag can change at any time, so it must be re-read every time.
+  auto enabled = new llvm::LoadInst(flag, "", true, B);
+  auto is_enabled = new llvm::ICmpInst(
+      *B, llvm::ICmpInst::ICMP_NE, enabled,
+      llvm::ConstantInt::get(enabled->getType(), 0));
+
+  llvm::MDBuilder md(C);
+  auto br = llvm::BranchInst::Create(call_block, cont_block, is_enabled, B);
+  br->setMetadata(llvm::LLVMContext::MD_prof, md.createBranchWeights(1, 2000));
+
+  auto state_ptr = &*F->arg_begin();
+  auto pc_ty = llvm::Type::getIntNTy(C, ArchAddressSize());
+  llvm::CallInst::Create(
+      hook, {state_ptr, llvm::ConstantInt::get(pc_ty, pc)}, "", call_block);
+  llvm::BranchInst::Create(cont_block, call_block);
+
+  B = cont_block;
+}
+
 static void CreateInstrBreakpoint(llvm::BasicBlock *B, VA pc) {
   auto F = B->getParent();
   auto M = F->getParent();
@@ -113,8 +505,12 @@ static void CreateInstrBreakpoint(llvm::BasicBlock *B, VA pc) {
   auto IFT = M->getFunction(instr_func_name);
   if (!IFT) {
 
+    // The same instruction can appear in functions lifted into different
+    // shards, so let the linker merge the copies.
     IFT = llvm::Function::Create(
-        LiftedFunctionType(), llvm::GlobalValue::ExternalLinkage,
+        LiftedFunctionType(),
+        (gLiftingIntoShard ? llvm::GlobalValue::LinkOnceODRLinkage :
+                             llvm::GlobalValue::ExternalLinkage),
         instr_func_name, M);
 
     IFT->addFnAttr(llvm::Attribute::OptimizeNone);
@@ -138,32 +534,190 @@ static void AddRegStateTracer(llvm::BasicBlock *B) {
   llvm::CallInst::Create(IFT, {state_ptr}, "", B);
 }
 
+// Add a relaxed atomic increment of the execution counter of the native block
+// at `va` to `B`.
+static void AddBlockCounter(llvm::BasicBlock *B, VA va) {
+  auto M = B->getParent()->getParent();
+  auto &C = M->getContext();
+  auto int64_ty = llvm::Type::getInt64Ty(C);
+  auto counter_ty = llvm::StructType::get(C, {int64_ty, int64_ty});
+
+  std::stringstream ss;
+  ss << "__mcsema_block_counter_" << std::hex << va;
+  auto counter = M->getNamedGlobal(ss.str());
+  if (!counter) {
+    counter = new llvm::GlobalVariable(
+        *M, counter_ty, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantStruct::get(
+            counter_ty, {llvm::ConstantInt::get(int64_ty, va),
+                         llvm::ConstantInt::get(int64_ty, 0)}),
+        ss.str());
+    counter->setSection(MCSEMA_BLOCK_COUNTERS_SECTION);
+    counter->setAlignment(8);
+  }
+
+  llvm::IRBuilder<> ir(B);
+  ir.CreateAtomicRMW(llvm::AtomicRMWInst::Add,
+                     ir.CreateConstInBoundsGEP2_32(counter_ty, counter, 0, 1),
+                     llvm::ConstantInt::get(int64_ty, 1), llvm::Monotonic);
+}
+
+// Adds the block counters of `M` to `llvm.used`, so that they are kept even
+// though only the runtime reads them.
+static void KeepBlockCounters(llvm::Module *M) {
+  if (!AddBlockCounters) {
+    return;
+  }
+
+  std::vector<llvm::Constant *> used;
+  auto i8_ptr_ty = llvm::Type::getInt8PtrTy(M->getContext());
+  if (auto old_used = M->getNamedGlobal("llvm.used")) {
+    if (old_used->hasInitializer()) {
+      auto init = old_used->getInitializer();
+      for (unsigned i = 0; i < init->getNumOperands(); ++i) {
+        used.push_back(llvm::cast<llvm::Constant>(init->getOperand(i)));
+      }
+    }
+    old_used->eraseFromParent();
+  }
+
+  for (auto &var : M->globals()) {
+    if (var.hasSection() &&
+        var.getSection() == MCSEMA_BLOCK_COUNTERS_SECTION) {
+      used.push_back(llvm::ConstantExpr::getPointerCast(&var, i8_ptr_ty));
+    }
+  }
+  if (used.empty()) {
+    return;
+  }
+
+  std::sort(used.begin(), used.end());
+  used.erase(std::unique(used.begin(), used.end()), used.end());
+  auto used_ty = llvm::ArrayType::get(i8_ptr_ty, used.size());
+  auto used_var = new llvm::GlobalVariable(
+      *M, used_ty, false, llvm::GlobalValue::AppendingLinkage,
+      llvm::ConstantArray::get(used_ty, used), "llvm.used");
+  used_var->setSection("llvm.metadata");
+}
+
 static const char * const kRealEIPAnnotation = "mcsema_real_eip";
 
-// Create the node for a `mcsema_real_eip` annotation.
+// The line table debug info of a module, with `-address-map=lines`.
+struct AddressLineMap {
+  std::unique_ptr<llvm::DIBuilder> builder;
+  llvm::DIFile *file;
+  llvm::DISubroutineType *func_type;
+};
+
+// Shards are lifted into their own modules, on their own threads.
+static std::mutex gAddressLineMapsLock;
+static std::unordered_map<llvm::Module *, AddressLineMap> gAddressLineMaps;
+
+static AddressLineMap &GetAddressLineMap(llvm::Module *M) {
+  std::lock_guard<std::mutex> locker(gAddressLineMapsLock);
+  auto &map = gAddressLineMaps[M];
+  if (!map.builder) {
+    const auto &name = M->getModuleIdentifier();
+    map.builder.reset(new llvm::DIBuilder(*M));
+    map.builder->createCompileUnit(
+        llvm::dwarf::DW_LANG_C, name, "", "mcsema-lift", true, "", 0, "",
+        llvm::DIBuilder::LineTablesOnly);
+    map.file = map.builder->createFile(name, "");
+    map.func_type = map.builder->createSubroutineType(
+        map.builder->getOrCreateTypeArray({}));
+
+    // Without this, the debug info is stripped when the bitcode is read.
+    if (!M->getModuleFlag("Debug Info Version")) {
+      M->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                       llvm::DEBUG_METADATA_VERSION);
+    }
+  }
+  return map;
+}
+
+// Give the lifted function `F` of the native function at `entry` the
+// subprogram that scopes its debug locations.
+static void CreateAddressLineScope(llvm::Function *F, VA entry) {
+  auto &map = GetAddressLineMap(F->getParent());
+  auto line = static_cast<unsigned>(static_cast<uint64_t>(entry) >> 32);
+  auto SP = map.builder->createFunction(
+      map.file, F->getName(), F->getName(), map.file, line, map.func_type,
+      false, true, line, 0, true);
+  F->setSubprogram(SP);
+}
+
+// Finish the debug info of `M`, if it has any. Nothing more can be lifted
+// into `M` afterwards.
+static void FinishAddressLineMap(llvm::Module *M) {
+  std::lock_guard<std::mutex> locker(gAddressLineMapsLock);
+  auto it = gAddressLineMaps.find(M);
+  if (it != gAddressLineMaps.end()) {
+    it->second.builder->finalize();
+    gAddressLineMaps.erase(it);
+  }
+}
+
+// Create the node for a `mcsema_real_eip` annotation, or the debug location
+// of `addr` with `-address-map=lines`.
 static llvm::MDNode *CreateInstAnnotation(llvm::Function *F, VA addr) {
   auto &C = F->getContext();
+  if (kAddressMapLines == AddressMap) {
+    return llvm::DILocation::get(
+        C, static_cast<unsigned>(static_cast<uint64_t>(addr)), 0,
+        F->getSubprogram());
+  }
   auto addr_val = llvm::ConstantInt::get(llvm::Type::getInt64Ty(C), addr);
   auto addr_md = llvm::ValueAsMetadata::get(addr_val);
   return llvm::MDNode::get(C, addr_md);
 }
 
+static bool IsAnnotated(llvm::Instruction *inst) {
+  if (kAddressMapLines == AddressMap) {
+    return !!inst->getDebugLoc();
+  }
+  return nullptr != inst->getMetadata(kRealEIPAnnotation);
+}
+
 // Annotate and instruction with the `mcsema_real_eip` annotation if that
 // instruction is unannotated.
 static void AnnotateInst(llvm::Instruction *inst, llvm::MDNode *annot) {
-  if (!inst->getMetadata(kRealEIPAnnotation)) {
+  if (IsAnnotated(inst)) {
+    return;
+  }
+  if (kAddressMapLines == AddressMap) {
+    inst->setDebugLoc(llvm::DebugLoc(llvm::cast<llvm::DILocation>(annot)));
+  } else {
     inst->setMetadata(kRealEIPAnnotation, annot);
   }
 }
 
-// Create a `mcsema_real_eip` annotation, and annotate every unannotated
-// instruction with this new annotation.
-static void AnnotateInsts(llvm::Function *F, VA pc) {
-  auto annot = CreateInstAnnotation(F, pc);
-  for (llvm::BasicBlock &B : *F) {
-    for (llvm::Instruction &I : B) {
-      AnnotateInst(&I, annot);
+// Annotate the unannotated instructions at the end of `B`. Instructions are
+// only ever appended to blocks while lifting, so everything before the last
+// annotated instruction is already annotated.
+static void AnnotateBlockTail(llvm::BasicBlock *B, llvm::MDNode *annot) {
+  for (auto it = B->rbegin(); it != B->rend(); ++it) {
+    if (IsAnnotated(&*it)) {
+      break;
     }
+    AnnotateInst(&*it, annot);
+  }
+}
+
+// Create a `mcsema_real_eip` annotation, and annotate every unannotated
+// instruction with this new annotation. The unannotated instructions are at
+// the ends of `ctx.unannotated_blocks`, or in the blocks that come after
+// `last_block`.
+static void AnnotateInsts(TranslationContext &ctx, llvm::BasicBlock *last_block,
+                          VA pc) {
+  auto annot = CreateInstAnnotation(ctx.F, pc);
+  for (auto B : ctx.unannotated_blocks) {
+    AnnotateBlockTail(B, annot);
+  }
+  ctx.unannotated_blocks.clear();
+
+  auto end = ctx.F->end();
+  for (auto it = ++llvm::Function::iterator(last_block); it != end; ++it) {
+    AnnotateBlockTail(&*it, annot);
   }
 }
 
@@ -194,6 +748,20 @@ static void AnnotateInsts(llvm::Function *F, VA pc) {
 //
 //     The innermost is where most of the intelligent decisions happen.
 //
+static std::string LowerCase(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+  return str;
+}
+
+// Returns true if the semantics of `inst` should be outlined.
+static bool IsOutlinedFamily(const llvm::MCInst &inst) {
+  if (gOutlinedFamilies.empty()) {
+    return false;
+  }
+  auto family = ArchGetInstructionFamily(inst);
+  return family && gOutlinedFamilies.count(LowerCase(family));
+}
+
 static InstTransResult LiftInstIntoBlockImpl(TranslationContext &ctx,
                                       llvm::BasicBlock *&block) {
   InstTransResult itr = ContinueBlock;
@@ -205,8 +773,34 @@ static InstTransResult LiftInstIntoBlockImpl(TranslationContext &ctx,
 
   auto &inst = ctx.natI->get_inst();
 
-  if (auto lifter = ArchGetInstructionLifter(inst)) {
-    itr = ArchLiftInstruction(ctx, block, lifter);
+  // Fused lifters depend on the previous instruction, so they are neither
+  // memoized nor outlined.
+  auto fused = FuseIdioms ? ArchGetFusedLifter(ctx) : nullptr;
+  if (auto lifter = fused ? fused : ArchGetInstructionLifter(inst)) {
+    auto start = LiftStatsNow();
+    auto in_frame = ArchAccessesStackFrame(ctx.F, ctx.natI);
+    auto memoize = MemoizeInsts && !fused && !in_frame &&
+                   CanMemoizeInstruction(ctx.natI);
+    if (!memoize || !CloneMemoizedInstruction(ctx, block)) {
+      llvm::Instruction *prev = nullptr;
+      auto orig_block = block;
+      auto last_block = &ctx.F->back();
+      if (memoize) {
+        ArchSyncRegisterVars(block);
+        prev = block->empty() ? nullptr : &block->back();
+      }
+
+      if (fused || in_frame || !IsOutlinedFamily(inst) ||
+          !LiftOutlinedInstruction(ctx, block, lifter)) {
+        itr = ArchLiftInstruction(ctx, block, lifter);
+      }
+
+      if (memoize && ContinueBlock == itr && orig_block == block &&
+          last_block == &ctx.F->back()) {
+        MemoizeInstruction(ctx, block, prev);
+      }
+    }
+    RecordOpcodeLift(inst.getOpcode(), start);
 
     if (TranslateError == itr || TranslateErrorUnsupported == itr) {
       std::cerr << "Error translating instruction at " << std::hex
@@ -224,142 +818,611 @@ static InstTransResult LiftInstIntoBlockImpl(TranslationContext &ctx,
   return itr;
 }
 
+// Returns true if the program counter needs to be written into the register
+// state before `inst` is lifted.
+static bool PCIsObservable(NativeInstPtr inst) {
+  if (!LazyPC || AddTracer || AddBreakpoints) {
+    return true;
+  }
+  return inst->has_call_tgt() || inst->has_ext_call_target() ||
+         inst->has_jump_table() || inst->has_system_call_number() ||
+         ArchInstructionObservesPC(inst->get_inst().getOpcode(), PrecisePC);
+}
+
 static InstTransResult LiftInstIntoBlock(TranslationContext &ctx,
                                          llvm::BasicBlock *&block,
                                          bool doAnnotation) {
   auto pc = ctx.natI->get_loc();
 
+  // Any blocks that the lifter creates will come after this one.
+  auto last_block = &ctx.F->back();
+  ctx.unannotated_blocks.push_back(block);
+
   // Update the program counter.
-  auto pc_ty = llvm::Type::getIntNTy(block->getContext(), ArchAddressSize());
-  GENERIC_MC_WRITEREG(
-      block,
-      llvm::X86::EIP,
-      llvm::ConstantInt::get(pc_ty, pc));
+  if (PCIsObservable(ctx.natI)) {
+    GENERIC_MC_WRITEREG(
+        block,
+        llvm::X86::EIP,
+        llvm::ConstantInt::get(ctx.addr_ty, pc));
+  }
+
+  // Breakpoints and the tracer look at the register state, so it has to be
+  // in its canonical form, e.g. with the ST registers in stack order.
+  if (AddBreakpoints || AddTracer) {
+    ArchSyncRegisterVars(block);
+  }
 
   // At the beginning of the block, make a call to a dummy function with the
   // same name as the block. This function call cannot be optimized away, and
   // so it serves as a useful marker for where we are.
   if (AddBreakpoints) {
-    CreateInstrBreakpoint(block, pc);
+    if (kBreakpointShared == BreakpointKind) {
+      CreateSharedBreakpoint(block, pc);
+    } else {
+      CreateInstrBreakpoint(block, pc);
+    }
   }
 
   if (AddTracer) {
     AddRegStateTracer(block);
   }
 
+  auto orig_block = block;
+  auto prev = block->empty() ? nullptr : &block->back();
   auto lift_status = LiftInstIntoBlockImpl(ctx, block);
 
-  // we need to loop over this function and find any un-annotated instructions.
-  // then we annotate each instruction
+  if (ctx.liveness && orig_block == block && last_block == &ctx.F->back() &&
+      (ContinueBlock == lift_status || EndBlock == lift_status)) {
+    RemoveDeadRegisterStores(ctx, block, prev);
+  }
+
+  // we need to find any un-annotated instructions emitted for this
+  // instruction. then we annotate each instruction
   if (doAnnotation) {
-    AnnotateInsts(ctx.F, pc);
+    AnnotateInsts(ctx, last_block, pc);
+  } else {
+    auto end = ctx.F->end();
+    for (auto it = ++llvm::Function::iterator(last_block); it != end; ++it) {
+      ctx.unannotated_blocks.push_back(&*it);
+    }
   }
 
   return lift_status;
 }
 
-static bool LiftBlockIntoFunction(TranslationContext &ctx) {
+static bool LiftBlockIntoFunction(TranslationContext &ctx,
+                                  const SuperblockPlan *superblocks) {
   auto didError = false;
 
   //first, either create or look up the LLVM basic block for this native
   //block. we are either creating it for the first time, or, we are
   //going to look up a blank block
-  auto block_name = ctx.natB->get_name();
   auto curLLVMBlock = ctx.va_to_bb[ctx.natB->get_base()];
 
-  //then, create a basic block for every follow of this block, if we do not
-  //already have that basic block in our LLVM CFG
-  const auto &follows = ctx.natB->get_follows();
-  for (auto succ_block_va : follows) {
-    if (!ctx.va_to_bb.count(succ_block_va)) {
-      throw TErr(__LINE__, __FILE__, "Missing successor block!");
+  // The native blocks lifted into `curLLVMBlock` so far, when it's the head
+  // of a superblock.
+  std::vector<VA> trace;
+
+  for (NativeBlockPtr next = nullptr; ; ctx.natB = next) {
+    trace.push_back(ctx.natB->get_base());
+
+    //then, create a basic block for every follow of this block, if we do not
+    //already have that basic block in our LLVM CFG
+    const auto &follows = ctx.natB->get_follows();
+    for (auto succ_block_va : follows) {
+      if (!ctx.va_to_bb.count(succ_block_va) &&
+          !(superblocks && superblocks->is_absorbed(succ_block_va))) {
+        throw TErr(__LINE__, __FILE__, "Missing successor block!");
+      }
+    }
+
+    if (AddBlockCounters) {
+      AddBlockCounter(curLLVMBlock, ctx.natB->get_base());
     }
-  }
 
-  //now, go through each statement and translate it into LLVM IR
-  //statements that branch SHOULD be the last statement in a block
-  for (auto inst : ctx.natB->get_insts()) {
-    ctx.natI = inst;
-    switch (LiftInstIntoBlock(ctx, curLLVMBlock, true)) {
-      case ContinueBlock:
+    next = superblocks ? superblocks->get_next(ctx.natB, trace) : nullptr;
+
+    //now, go through each statement and translate it into LLVM IR
+    //statements that branch SHOULD be the last statement in a block
+    ctx.prevI = nullptr;
+    auto ended_early = false;
+    const auto &insts = ctx.natB->get_insts();
+    for (auto inst : insts) {
+
+      // The superblock goes on at the jump's target instead.
+      if (next && inst == insts.back() &&
+          ArchInstructionIsDirectJump(inst->get_inst().getOpcode())) {
         break;
-      case EndBlock:
-      case EndCFG:
-        goto done;
-      case TranslateErrorUnsupported:
-        didError = !IgnoreUnsupportedInsts;
-        goto done;
-      case TranslateError:
-        didError = true;
-        goto done;
+      }
+
+      ctx.natI = inst;
+      switch (LiftInstIntoBlock(ctx, curLLVMBlock, true)) {
+        case ContinueBlock:
+          ctx.prevI = inst;
+          continue;
+        case EndBlock:
+        case EndCFG:
+          break;
+        case TranslateErrorUnsupported:
+          didError = didError || !IgnoreUnsupportedInsts;
+          break;
+        case TranslateError:
+          didError = true;
+          break;
+      }
+
+      // The rest of the native block isn't lifted.
+      ended_early = true;
+      break;
+    }
+
+    if (!next || curLLVMBlock->getTerminator()) {
+      break;
+    }
+
+    // A native block that ends early falls through to its only successor,
+    // which may only be lifted as part of this superblock. The rest of the
+    // superblock goes into a new block, so that it starts from the canonical
+    // register state.
+    if (ended_early) {
+      if (1 != follows.size()) {
+        break;
+      }
+      ArchSyncRegisterVars(curLLVMBlock);
+      auto nextLLVMBlock = llvm::BasicBlock::Create(
+          curLLVMBlock->getContext(), NameBlocks ? next->get_name() : "",
+          ctx.F);
+      llvm::BranchInst::Create(nextLLVMBlock, curLLVMBlock);
+      ctx.unannotated_blocks.push_back(curLLVMBlock);
+      curLLVMBlock = nextLLVMBlock;
     }
   }
-done:
 
   if (curLLVMBlock->getTerminator()) {
     return didError;
   }
 
+  // Successor blocks start from the canonical register state.
+  ArchSyncRegisterVars(curLLVMBlock);
+
   // we may need to insert a branch inst to the successor
   // if the block ended on a non-terminator (this happens since we
   // may split blocks in cfg recovery to avoid code duplication)
+  const auto &follows = ctx.natB->get_follows();
   if (follows.size() == 1) {
-    llvm::BranchInst::Create(ctx.va_to_bb[follows.front()], curLLVMBlock);
+    auto succ_it = ctx.va_to_bb.find(follows.front());
+    TASSERT(succ_it != ctx.va_to_bb.end() && succ_it->second,
+            "Missing successor block of " + ctx.natB->get_name());
+    llvm::BranchInst::Create(succ_it->second, curLLVMBlock);
   } else {
     new llvm::UnreachableInst(curLLVMBlock->getContext(), curLLVMBlock);
   }
+  ctx.unannotated_blocks.push_back(curLLVMBlock);
 
   return didError;
 }
 
-static bool InsertFunctionIntoModule(NativeModulePtr mod,
-                                     NativeFunctionPtr func, llvm::Module *M) {
-  auto &C = M->getContext();
-  auto F = M->getFunction(func->get_name());
-  if (!F) {
-    throw TErr(__LINE__, __FILE__, "Could not get func " + func->get_name());
+// A branch to the head of a shared tail becomes a tail call to the tail's
+// function. Branches leave from the canonical register state, so the call
+// sees the same state as the tail's head block would have.
+static llvm::BasicBlock *CreateSharedTailCall(TranslationContext &ctx,
+                                              const SharedTail *tail) {
+  auto &C = ctx.M->getContext();
+  auto B = llvm::BasicBlock::Create(C, "call_" + tail->name, ctx.F);
+  auto target = ctx.M->getFunction(tail->name);
+  TASSERT(target != nullptr, "Could not find shared tail " + tail->name);
+
+  std::vector<llvm::Value *> args;
+  for (auto &arg : ctx.F->args()) {
+    args.push_back(&arg);
   }
+  auto c = llvm::CallInst::Create(target, args, "", B);
+  ArchSetCallingConv(ctx.M, c);
+  c->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  llvm::ReturnInst::Create(C, B);
+  ctx.unannotated_blocks.push_back(B);
+  return B;
+}
 
-  if (!F->empty()) {
-    std::cout << "WARNING: Asking to re-insert function: " << func->get_name()
-              << std::endl << "\tReturning current function instead"
-              << std::endl;
-    return true;
+// Returns true if `func` is one of the entry symbols of `mod`. These are
+// called from outside of the module, so they must follow the calling
+// convention; internal functions, such as `__x86.get_pc_thunk.bx`, may return
+// values in any register.
+static bool IsModuleEntryPoint(NativeModulePtr mod, NativeFunctionPtr func) {
+  for (const auto &ep : mod->getEntryPoints()) {
+    if (ep.getAddr() == func->get_start()) {
+      return true;
+    }
   }
+  return false;
+}
+
+// Lift `blocks`, which all come from `func`, into `F`, starting at the block
+// at `entry_va`.
+static bool InsertBlocksIntoFunction(NativeModulePtr mod,
+                                     NativeFunctionPtr func, llvm::Function *F,
+                                     VA entry_va,
+                                     const std::vector<NativeBlockPtr> &blocks) {
+  auto M = F->getParent();
+  auto &C = M->getContext();
+  auto name = F->getName().str();
 
+  auto start = LiftStatsNow();
   auto entryBlock = llvm::BasicBlock::Create(F->getContext(), "entry", F);
+  if (kAddressMapLines == AddressMap) {
+    CreateAddressLineScope(F, entry_va);
+  }
   ArchAllocRegisterVars(entryBlock);
+  if (RecoverStackFrames) {
+    ArchAllocStackFrame(func, entryBlock);
+  }
 
   TranslationContext ctx;
   ctx.natM = mod;
   ctx.natF = func;
   ctx.M = M;
   ctx.F = F;
+  ctx.regs = GetRegisterTable(F);
+  ctx.addr_ty = llvm::Type::getIntNTy(C, ArchAddressSize());
+
+  // The tracer reads every register before each instruction.
+  std::unique_ptr<RegisterLiveness> liveness;
+  if (EliminateDeadRegs && !AddTracer) {
+    liveness.reset(new RegisterLiveness(func, IsModuleEntryPoint(mod, func)));
+  }
+  ctx.liveness = liveness.get();
+
+  // Breakpoints and the tracer need every native instruction, including
+  // the jumps between the blocks of a superblock.
+  std::unique_ptr<SuperblockPlan> superblocks;
+  if (FormSuperblocks && ProfileEnabled() && !AddBreakpoints && !AddTracer) {
+    superblocks.reset(new SuperblockPlan(func, entry_va, blocks));
+  }
 
   // Create basic blocks for each basic block in the original function.
-  for (auto block_info : func->get_blocks()) {
-    ctx.va_to_bb[block_info.first] = llvm::BasicBlock::Create(
-        C, block_info.second->get_name(), F);
+  ctx.va_to_bb.reserve(blocks.size());
+  for (auto block : blocks) {
+    if (!superblocks || !superblocks->is_absorbed(block->get_base())) {
+      ctx.va_to_bb[block->get_base()] = llvm::BasicBlock::Create(
+          C, NameBlocks ? block->get_name() : "", F);
+    }
+  }
+
+  // The successors that aren't lifted here are the heads of shared tails.
+  for (auto block : blocks) {
+    for (auto succ_va : block->get_follows()) {
+      if (ctx.va_to_bb.count(succ_va) || !gSharedBlocks) {
+        continue;
+      }
+      if (auto tail = gSharedBlocks->get_tail(succ_va)) {
+        ctx.va_to_bb[succ_va] = CreateSharedTailCall(ctx, tail);
+      }
+    }
   }
 
   // Create a branch from the end of the entry block to the first block
-  llvm::BranchInst::Create(ctx.va_to_bb[func->get_start()], entryBlock);
+  llvm::BranchInst::Create(ctx.va_to_bb[entry_va], entryBlock);
+  ctx.unannotated_blocks.push_back(entryBlock);
 
   // Lift every basic block into the functions.
   auto error = false;
-  for (auto block_info : func->get_blocks()) {
-    ctx.natB = block_info.second;
-    error = LiftBlockIntoFunction(ctx) || error;
+  for (auto block : blocks) {
+    if (!superblocks || !superblocks->is_absorbed(block->get_base())) {
+      ctx.natB = block;
+      error = LiftBlockIntoFunction(ctx, superblocks.get()) || error;
+    }
   }
 
   // For ease of debugging generated code, don't allow lifted functions to
   // be inlined. This will make lifted and native call graphs one-to-one.
-  F->addFnAttr(llvm::Attribute::NoInline);
+  if (!AllowInlining) {
+    F->addFnAttr(llvm::Attribute::NoInline);
+  }
+
+  AddFuzzEdgeGuards(F, ctx.va_to_bb);
+  ApplyProfile(func, F, ctx.va_to_bb);
+
+  if (EliminateDeadFlags && !error) {
+    RemoveDeadFlagStores(F, ctx.regs);
+  }
+
+  if (PromoteRegisters && !error) {
+    PromoteRegisterVars(F, ctx.regs);
+  }
+
+  // The register variables are only looked up while lifting.
+  FreeRegisterTable(F);
+  ArchFreeStackFrame(F);
+
+  if (VerifyEachFunction == Verify && !error) {
+    std::string errors;
+    llvm::raw_string_ostream os(errors);
+    if (llvm::verifyFunction(*F, &os)) {
+      os.flush();
+      std::stringstream ss;
+      ss << "Could not verify " << name << " (native address "
+         << std::hex << entry_va << "):" << std::endl << errors;
+      std::cerr << ss.str();
+      error = true;
+    }
+  }
+
+  if (LiftStatsEnabled()) {
+    size_t num_insts = 0;
+    for (auto &B : *F) {
+      num_insts += B.size();
+    }
+    size_t num_blocks = F->size();
+    RecordFunctionLift(name, start, num_insts, num_blocks);
+  }
+
+  CheckMemoryLimit("lifting function " + name);
 
   //we should be done, having inserted every block into the module
   return !error;
 }
 
+static bool InsertFunctionIntoModule(NativeModulePtr mod,
+                                     NativeFunctionPtr func, llvm::Module *M) {
+  auto F = M->getFunction(func->get_name());
+  if (!F) {
+    throw TErr(__LINE__, __FILE__, "Could not get func " + func->get_name());
+  }
+
+  if (!F->empty()) {
+    std::cout << "WARNING: Asking to re-insert function: " << func->get_name()
+              << std::endl << "\tReturning current function instead"
+              << std::endl;
+    return true;
+  }
+
+  // Shared blocks are lifted once, into their shared tails.
+  std::vector<NativeBlockPtr> blocks;
+  for (const auto &block_info : func->get_blocks()) {
+    if (!gSharedBlocks || !gSharedBlocks->is_shared(block_info.first)) {
+      blocks.push_back(block_info.second);
+    }
+  }
+  return InsertBlocksIntoFunction(mod, func, F, func->get_start(), blocks);
+}
+
+bool ShouldVerifyModule(void) {
+  return VerifyWholeModule == Verify;
+}
+
+// Cached functions only declare the globals that they use, so the block
+// counters of a cached function would never be defined.
+bool LiftCacheEnabled(void) {
+  if (!CacheDir.empty() && AddBlockCounters) {
+    static std::once_flag warn_once;
+    std::call_once(warn_once, [] {
+      std::cerr << "WARNING: The lift cache is not used with "
+                << "-add-block-counters" << std::endl;
+    });
+    return false;
+  }
+
+  // The guards of a function are globals of its own.
+  if (!CacheDir.empty() && FuzzInstrumentEnabled()) {
+    static std::once_flag warn_once;
+    std::call_once(warn_once, [] {
+      std::cerr << "WARNING: The lift cache is not used with "
+                << "-fuzz-instrument" << std::endl;
+    });
+    return false;
+  }
+
+  // Cached functions are extracted without the debug info of the module.
+  if (!CacheDir.empty() && kAddressMapLines == AddressMap) {
+    static std::once_flag warn_once;
+    std::call_once(warn_once, [] {
+      std::cerr << "WARNING: The lift cache is not used with "
+                << "-address-map=lines" << std::endl;
+    });
+    return false;
+  }
+
+  // The lifted form of a call depends on the callee, but the cache key only
+  // covers the caller.
+  if (!CacheDir.empty() && ElideReturnAddresses) {
+    static std::once_flag warn_once;
+    std::call_once(warn_once, [] {
+      std::cerr << "WARNING: The lift cache is not used with "
+                << "-elide-return-addresses" << std::endl;
+    });
+    return false;
+  }
+
+  // Whether a block is lifted into a function depends on the other
+  // functions that contain it.
+  if (!CacheDir.empty() && ShareBlocks) {
+    static std::once_flag warn_once;
+    std::call_once(warn_once, [] {
+      std::cerr << "WARNING: The lift cache is not used with "
+                << "-share-blocks" << std::endl;
+    });
+    return false;
+  }
+  return !CacheDir.empty();
+}
+
+// Work out which functions don't need direct callers to write their return
+// address. This is done for every function up front, so that all partial
+// modules of a lift, and all jobs, agree on it.
+static void FindPrivateReturnAddresses(NativeModulePtr natMod) {
+  if (!ElideReturnAddresses) {
+    return;
+  }
+
+  if (natMod->is_streamed()) {
+    std::cerr << "WARNING: Return addresses are not elided in streamed CFGs"
+              << std::endl;
+    return;
+  }
+
+  PhaseTimer timer("find_private_return_addresses");
+  for (auto &func_info : natMod->get_funcs()) {
+    auto func = func_info.second;
+    func->set_return_address_private(
+        ArchKeepsReturnAddressPrivate(natMod, func));
+  }
+}
+
+// Find the blocks that more than one function contains, so that they are
+// lifted once, into shared tails. The tails reach into the native stack
+// frames of the functions that tail-call them, so recovered stack frames
+// can't be shared. Returns `nullptr` if no blocks are shared.
+static std::unique_ptr<SharedBlocks> FindSharedBlocks(NativeModulePtr natMod) {
+  std::unique_ptr<SharedBlocks> shared;
+  if (!ShareBlocks) {
+    return shared;
+  }
+
+  if (natMod->is_streamed() || IsPartialLift() || RecoverStackFrames) {
+    std::cerr << "WARNING: Blocks are not shared in streamed CFGs, partial "
+              << "lifts, or with -recover-stack-frames" << std::endl;
+    return shared;
+  }
+
+  PhaseTimer timer("find_shared_blocks");
+  shared.reset(new SharedBlocks(natMod));
+
+  size_t num_blocks = 0;
+  for (const auto &tail : shared->get_tails()) {
+    num_blocks += tail.blocks.size();
+  }
+  std::cerr << "Sharing " << num_blocks << " blocks in "
+            << shared->get_tails().size() << " shared tails; "
+            << shared->get_num_duplicate_insts()
+            << " duplicate instructions are not lifted" << std::endl;
+  return shared;
+}
+
+// Declare the functions of the shared tails in `M`.
+static void InitSharedTails(llvm::Module *M,
+                            llvm::GlobalValue::LinkageTypes linkage) {
+  if (!gSharedBlocks) {
+    return;
+  }
+  for (const auto &tail : gSharedBlocks->get_tails()) {
+    auto F = llvm::dyn_cast<llvm::Function>(
+        M->getOrInsertFunction(tail.name, LiftedFunctionType()));
+    TASSERT(F != nullptr, "Could not insert shared tail into module");
+    ArchSetCallingConv(M, F);
+    F->setLinkage(linkage);
+  }
+}
+
+// Lift the shared tails into `M`. This has to happen before any of the
+// donors of the tails are lifted, because lifting a function frees its
+// blocks.
+static bool LiftSharedTails(NativeModulePtr natMod, llvm::Module *M) {
+  if (!gSharedBlocks) {
+    return true;
+  }
+
+  PhaseTimer timer("lift_shared_tails");
+  for (const auto &tail : gSharedBlocks->get_tails()) {
+    auto F = M->getFunction(tail.name);
+    if (!InsertBlocksIntoFunction(natMod, tail.donor, F, tail.head,
+                                  tail.blocks)) {
+      std::cerr << "Could not insert shared tail: " << tail.name
+                << " into the LLVM module" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Check the families named by `-outline-semantics`.
+static void InitOutlinedFamiliesOnce(void) {
+  std::set<std::string> known;
+  for (auto family : ArchGetInstructionFamilies()) {
+    known.insert(LowerCase(family));
+  }
+
+  for (const auto &family : OutlineSemantics) {
+    auto name = LowerCase(family);
+    if (!known.count(name)) {
+      throw TErr(__LINE__, __FILE__,
+                 "Unknown instruction family " + family +
+                 " in -outline-semantics");
+    }
+    gOutlinedFamilies.insert(name);
+  }
+}
+
+static void InitOutlinedFamilies(void) {
+  std::call_once(gOutlinedFamiliesOnce, InitOutlinedFamiliesOnce);
+}
+
+static void InitLiftCache(NativeModulePtr natMod, llvm::Module *M) {
+  auto ec = llvm::sys::fs::create_directories(CacheDir);
+  if (ec) {
+    throw TErr(__LINE__, __FILE__,
+               "Could not create cache directory " + CacheDir + ": " +
+               ec.message());
+  }
+
+  std::stringstream options;
+  options << IgnoreUnsupportedInsts << "," << AddTracer << ","
+          << AddBreakpoints << "," << BreakpointKind << ","
+          << EliminateDeadFlags << "," << PromoteRegisters << ","
+          << LeanTransitions << "," << LazyPC << "," << PrecisePC << ","
+          << EliminateDeadRegs << "," << RecoverStackFrames << ","
+          << FuseIdioms << "," << AddressMap << "," << AllowInlining << ","
+          << FormSuperblocks << "," << NameBlocks << ","
+          << LookupTableEnabled() << "," << AliasMetadataEnabled();
+  options << ";profile:" << ProfileDigest();
+  for (const auto &family : gOutlinedFamilies) {
+    options << ";outline:" << family;
+  }
+  gLiftCacheContext = HashLiftContext(natMod, options.str());
+
+  // Cached functions only declare the tracer, so make sure it's defined.
+  if (AddTracer) {
+    ArchGetOrCreateRegStateTracer(M);
+  }
+}
+
+// Lift `func` into `M`, or load its lifted form from the lift cache.
+static bool LiftFunctionImpl(NativeModulePtr natMod, NativeFunctionPtr func,
+                             llvm::Module *M) {
+  if (gLiftCacheContext.empty()) {
+    return InsertFunctionIntoModule(natMod, func, M);
+  }
+
+  llvm::SmallString<128> path(CacheDir.getValue());
+  llvm::sys::path::append(
+      path, GetLiftCacheKey(gLiftCacheContext, func) + ".bc");
+
+  if (LoadCachedFunction(path.str(), M)) {
+    ++gLiftCacheHits;
+    return true;
+  }
+
+  ++gLiftCacheMisses;
+  if (!InsertFunctionIntoModule(natMod, func, M)) {
+    return false;
+  }
+
+  if (!StoreCachedFunction(path.str(), M->getFunction(func->get_name()))) {
+    std::cerr << "WARNING: Could not cache lifted function "
+              << func->get_name() << std::endl;
+  }
+  return true;
+}
+
+// Lift `func` into `M`, then free its blocks and instructions. Only the
+// entry address and names of a function are used once it has been lifted, so
+// peak memory depends on the biggest function rather than on the whole CFG.
+static bool LiftFunction(NativeModulePtr natMod, NativeFunctionPtr func,
+                         llvm::Module *M) {
+  auto lifted = LiftFunctionImpl(natMod, func, M);
+  func->release_blocks();
+  return lifted;
+}
+
 struct DataSectionVar {
   const DataSection *section;
   llvm::StructType *opaque_type;
@@ -395,11 +1458,43 @@ static bool InsertDataSections(NativeModulePtr natMod, llvm::Module *M) {
         *M, st_opaque, dt.isReadOnly(),
         llvm::GlobalVariable::InternalLinkage,
         nullptr, bufferName);
+    natMod->setDataSectionVar(dt.getBase(), g);
     gvars.push_back({&dt, st_opaque, g});
   }
 
+  // Resolve the entries of every section. This only reads `natMod` and `M`,
+  // and every section variable now exists, so the sections are independent.
+  std::vector<std::vector<DataSectionItem>> items(gvars.size());
+  std::vector<std::exception_ptr> errors(gvars.size());
+  std::atomic<size_t> next(0);
+
+  auto resolve = [&] (void) {
+    for (auto i = next++; i < gvars.size(); i = next++) {
+      try {
+        resolveDataSectionItems(natMod, *gvars[i].section, M, items[i]);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  auto num_threads = std::min<size_t>(
+      gvars.size(), std::max(1U, NumDataJobs.getValue()));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(resolve);
+  }
+  resolve();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
   // actually populate the data sections
-  for (auto &var : gvars) {
+  for (size_t i = 0; i < gvars.size(); ++i) {
+    auto &var = gvars[i];
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
 
     //data we use to create LLVM values for this section
     // secContents is the actual values we will be inserting
@@ -408,8 +1503,9 @@ static bool InsertDataSections(NativeModulePtr natMod, llvm::Module *M) {
     // the global variable
     std::vector<llvm::Type *> data_section_types;
 
-    dataSectionToTypesContents(globaldata, *var.section, M, secContents,
-                               data_section_types, true);
+    dataSectionItemsToTypesContents(M, items[i], secContents,
+                                    data_section_types, true);
+    std::vector<DataSectionItem>().swap(items[i]);
 
     // fill in the opaqure structure with actual members
     var.opaque_type->setBody(data_section_types, true);
@@ -421,6 +1517,9 @@ static bool InsertDataSections(NativeModulePtr natMod, llvm::Module *M) {
     var.var->setAlignment(ArchPointerSize(M));
     var.var->setInitializer(cst);
 
+    RecordDataSection(var.section->getName(), var.section->getSize(),
+                      secContents.size());
+    CheckMemoryLimit("lifting data section " + var.section->getName());
   }
   return true;
 }
@@ -447,7 +1546,48 @@ void RenameLiftedFunctions(NativeModulePtr natMod, llvm::Module *M,
   }
 }
 
-static void InitLiftedFunctions(NativeModulePtr natMod, llvm::Module *M) {
+bool WriteSymbolMap(NativeModulePtr natMod, llvm::Module *M,
+                    const std::string &path) {
+  std::vector<NativeFunctionPtr> funcs;
+  for (auto &f : natMod->get_funcs()) {
+    funcs.push_back(f.second);
+  }
+  std::sort(funcs.begin(), funcs.end(),
+            [] (NativeFunctionPtr a, NativeFunctionPtr b) {
+              return a->get_start() < b->get_start();
+            });
+
+  std::error_code ec;
+  llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::F_Text);
+  if (ec) {
+    std::cerr << "Could not open symbol map " << path << ": "
+              << ec.message() << std::endl;
+    return false;
+  }
+
+  out << "# native_va lifted_name native_symbol\n";
+  for (auto native_func : funcs) {
+    auto sub_name = native_func->get_name();
+    auto F = M->getFunction(sub_name);
+
+    // Renamed functions are found through their symbol name.
+    auto &sym_name = native_func->get_symbol_name();
+    if (!F && !sym_name.empty()) {
+      F = M->getFunction(sym_name);
+    }
+    if (!F) {
+      continue;
+    }
+
+    out << llvm::format_hex_no_prefix(native_func->get_start(), 1) << " "
+        << F->getName() << " " << (sym_name.empty() ? sub_name : sym_name)
+        << "\n";
+  }
+  return true;
+}
+
+static void InitLiftedFunctions(NativeModulePtr natMod, llvm::Module *M,
+                                llvm::GlobalValue::LinkageTypes linkage) {
   for (auto &f : natMod->get_funcs()) {
     NativeFunctionPtr native_func = f.second;
     auto fname = native_func->get_name();
@@ -461,7 +1601,7 @@ static void InitLiftedFunctions(NativeModulePtr natMod, llvm::Module *M) {
 
       ArchSetCallingConv(M, F);
       // make local functions 'static'
-      F->setLinkage(llvm::GlobalValue::InternalLinkage);
+      F->setLinkage(linkage);
       std::cout << "Inserted function: " << fname << std::endl;
     } else {
       std::cout << "Already inserted function: " << fname << ", skipping."
@@ -578,6 +1718,17 @@ static void InitExternalCode(NativeModulePtr natMod, llvm::Module *M) {
       F->setDoesNotReturn();
     }
 
+    // The lifted code reads the arguments out of the register state and
+    // writes back the integer return value itself, so externals with known
+    // return types don't need the rest of the state to be marshalled.
+    if (LeanTransitions && ExternalCodeRef::Unknown != e->getReturnType()) {
+      ArchUseLeanTransition(F);
+    }
+
+    if (e->isDirect()) {
+      ArchUseDirectCall(F);
+    }
+
     //set calling convention
     if (natMod->is64Bit()) {
       ArchSetCallingConv(M, F);
@@ -591,7 +1742,7 @@ static bool LiftFunctionsIntoModule(NativeModulePtr natMod, llvm::Module *M) {
   // populate functions
   for (auto &func_info : natMod->get_funcs()) {
     NativeFunctionPtr f = func_info.second;
-    if (!InsertFunctionIntoModule(natMod, f, M)) {
+    if (!LiftFunction(natMod, f, M)) {
       std::string fname = f->get_name();
       std::cerr << "Could not insert function: " << fname
                 << " into the LLVM module" << std::endl;
@@ -601,10 +1752,432 @@ static bool LiftFunctionsIntoModule(NativeModulePtr natMod, llvm::Module *M) {
   return true;
 }
 
+// Declare the data sections of `natMod` in a module shard. The sections are
+// defined by the main module, and the shard's references to them are resolved
+// when the shard is linked into it.
+static void DeclareDataSections(NativeModulePtr natMod, llvm::Module *M) {
+  for (auto &dt : natMod->getData()) {
+    std::stringstream ss;
+    ss << "data_" << std::hex << dt.getBase();
+    (void) new llvm::GlobalVariable(
+        *M, llvm::StructType::create(M->getContext()), dt.isReadOnly(),
+        llvm::GlobalVariable::ExternalLinkage, nullptr, ss.str());
+  }
+}
+
+// Changes the linkage of the lifted functions and data sections of `M`.
+// Functions that are reachable through a callback driver stay external.
+static void SetLiftedLinkage(NativeModulePtr natMod, llvm::Module *M,
+                             llvm::GlobalValue::LinkageTypes linkage) {
+  for (auto &func_info : natMod->get_funcs()) {
+    auto sub_name = func_info.second->get_name();
+    auto F = M->getFunction(sub_name);
+
+    // A merged lift may leave some functions unlifted, i.e. only declared.
+    if (F && !F->isDeclaration() && !M->getFunction("callback_" + sub_name)) {
+      F->setLinkage(linkage);
+    }
+  }
+  if (gSharedBlocks) {
+    for (const auto &tail : gSharedBlocks->get_tails()) {
+      auto F = M->getFunction(tail.name);
+      if (F && !F->isDeclaration()) {
+        F->setLinkage(linkage);
+      }
+    }
+  }
+  for (auto &dt : natMod->getData()) {
+    natMod->getDataSectionVar(dt.getBase(), M)->setLinkage(linkage);
+  }
+}
+
+bool LiftsFunctionsInParallel(void) {
+  return 1 < NumJobs;
+}
+
+bool IsPartialLift(void) {
+  return !LiftFunctionsOpt.empty();
+}
+
+// Parse the ranges named by `-lift-functions`.
+static void InitLiftRanges(void) {
+  for (const auto &spec : LiftFunctionsOpt) {
+    auto dash = spec.find('-');
+    auto begin_str = spec.substr(0, dash);
+    auto end_str = std::string::npos == dash ? "" : spec.substr(dash + 1);
+
+    char *end_ptr = nullptr;
+    auto begin = std::strtoull(begin_str.c_str(), &end_ptr, 16);
+    auto ok = !begin_str.empty() && !*end_ptr;
+    auto end = begin + 1;
+    if (std::string::npos != dash) {
+      end = std::strtoull(end_str.c_str(), &end_ptr, 16);
+      ok = ok && !end_str.empty() && !*end_ptr && begin < end;
+    }
+    if (!ok) {
+      throw TErr(__LINE__, __FILE__,
+                 "Invalid address or range " + spec + " in -lift-functions");
+    }
+    gLiftRanges.emplace_back(static_cast<VA>(begin), static_cast<VA>(end));
+  }
+}
+
+// Returns true if `func` is selected by `-lift-functions`.
+static bool IsSelectedForLift(NativeFunctionPtr func) {
+  auto ea = func->get_start();
+  for (const auto &range : gLiftRanges) {
+    if (range.first <= ea && ea < range.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Lift the functions selected by `-lift-functions` into `M`, which is then
+// meant to be linked with the other partial modules of the same lift by
+// `MergeLiftedModules`. Everything that more than one partial module could
+// define is either only declared, emitted by the `-lift-data` module, or
+// made mergeable by the linker.
+static bool LiftPartialModule(NativeModulePtr natMod, llvm::Module *M) {
+  InitLiftRanges();
+  ArchDeferStubs(true);
+  gLiftingIntoShard = true;
+
+  {
+    PhaseTimer timer("declare_functions");
+    InitLiftedFunctions(natMod, M, llvm::GlobalValue::ExternalLinkage);
+    InitExternalData(natMod, M);
+    InitExternalCode(natMod, M);
+  }
+
+  if (LiftData) {
+    PhaseTimer timer("insert_data_sections");
+    if (LookupTableEnabled()) {
+      AddLookupTable(natMod, M);
+    }
+    InsertDataSections(natMod, M);
+    for (auto &dt : natMod->getData()) {
+      natMod->getDataSectionVar(dt.getBase(), M)->setLinkage(
+          llvm::GlobalValue::ExternalLinkage);
+    }
+  } else {
+    DeclareDataSections(natMod, M);
+  }
+
+  // Every partial module can trace, so let the linker merge the tracers.
+  if (AddTracer) {
+    ArchGetOrCreateRegStateTracer(M)->setLinkage(
+        llvm::GlobalValue::LinkOnceODRLinkage);
+  }
+
+  if (LiftCacheEnabled()) {
+    InitLiftCache(natMod, M);
+  }
+
+  if (1 < NumJobs) {
+    std::cerr << "WARNING: Partial modules are lifted with one job"
+              << std::endl;
+  }
+
+  FindPrivateReturnAddresses(natMod);
+  auto shared_blocks = FindSharedBlocks(natMod);
+  SharedBlocksGuard shared_blocks_guard(shared_blocks.get());
+
+  auto lift = [=] (NativeFunctionPtr f) {
+    if (!IsSelectedForLift(f)) {
+      return true;
+    }
+    ArchPreProcessFunction(natMod, f, M);
+    if (!LiftFunction(natMod, f, M)) {
+      std::cerr << "Could not insert function: " << f->get_name()
+                << " into the LLVM module" << std::endl;
+      return false;
+    }
+    return true;
+  };
+
+  PhaseTimer timer("lift_functions");
+  auto lifted = false;
+  if (natMod->is_streamed()) {
+    lifted = StreamProtoBufFunctions(natMod, lift);
+  } else {
+    lifted = true;
+    for (auto &func_info : natMod->get_funcs()) {
+      if (!lift(func_info.second)) {
+        lifted = false;
+        break;
+      }
+    }
+  }
+
+  ArchSaveDeferredStubs(M);
+  return lifted;
+}
+
+bool MergeLiftedModules(NativeModulePtr natMod, llvm::Module *M,
+                        const std::vector<std::string> &file_names) {
+  auto &C = M->getContext();
+  for (const auto &file_name : file_names) {
+    std::string error;
+    auto buff = ReadBitcodeFile(file_name, error);
+    if (!buff) {
+      std::cerr << "Could not read partial module " << file_name << ": "
+                << error << std::endl;
+      return false;
+    }
+
+    auto part = llvm::parseBitcodeFile(buff->getMemBufferRef(), C);
+    if (!part) {
+      std::cerr << "Could not parse partial module " << file_name << ": "
+                << part.getError().message() << std::endl;
+      return false;
+    }
+
+    if (llvm::Linker::linkModules(*M, std::move(part.get()))) {
+      std::cerr << "Could not link partial module " << file_name << std::endl;
+      return false;
+    }
+  }
+
+  // Check that one of the partial modules defined the data sections.
+  for (auto &dt : natMod->getData()) {
+    auto var = natMod->getDataSectionVar(dt.getBase(), M);
+    if (!var || var->isDeclaration()) {
+      std::cerr << "No partial module defines data section " << std::hex
+                << dt.getBase() << std::dec << "; was one lifted with "
+                << "-lift-data?" << std::endl;
+      return false;
+    }
+  }
+
+  ArchLoadDeferredStubs(M);
+  ArchAddDeferredStubs(M);
+  SetLiftedLinkage(natMod, M, llvm::GlobalValue::InternalLinkage);
+  InitProfile();
+  OrderFunctionsByProfile(M);
+  KeepBlockCounters(M);
+  AddFuzzGuardInit(M);
+  return true;
+}
+
+// Forgets the memoized instructions of a module once it has been lifted.
+struct MemoizedInstsGuard {
+  ~MemoizedInstsGuard(void) {
+    ClearMemoizedInstructions();
+  }
+};
+
+struct LiftShard {
+  std::vector<NativeFunctionPtr> funcs;
+  std::string bitcode;
+  std::exception_ptr error;
+  bool lifted;
+};
+
+// Lift the functions of `shard` into a new module with its own context, and
+// serialize that module into `shard.bitcode`. `shared` are the shared blocks
+// of the lifting thread.
+static void LiftShardFunctions(NativeModulePtr natMod, LiftShard &shard,
+                               const std::string &tracer_name,
+                               const SharedBlocks *shared) {
+  SharedBlocksGuard shared_blocks_guard(shared);
+  std::unique_ptr<llvm::LLVMContext> context(new llvm::LLVMContext);
+  ArchInitContext(context.get());
+  ArchDeferStubs(true);
+  gLiftingIntoShard = true;
+
+  std::unique_ptr<llvm::Module> M(CreateModule(context.get()));
+  MemoizedInstsGuard memo_guard;
+  ArchInitAttachDetach(M.get());
+  InitLiftedFunctions(natMod, M.get(), llvm::GlobalValue::ExternalLinkage);
+  InitSharedTails(M.get(), llvm::GlobalValue::ExternalLinkage);
+  InitExternalData(natMod, M.get());
+  InitExternalCode(natMod, M.get());
+  DeclareDataSections(natMod, M.get());
+
+  // The tracer is defined once, in the main module.
+  if (!tracer_name.empty()) {
+    M->getOrInsertFunction(tracer_name, LiftedFunctionType());
+  }
+
+  shard.lifted = true;
+  for (auto f : shard.funcs) {
+    auto inserted = InsertFunctionIntoModule(natMod, f, M.get());
+    f->release_blocks();
+    if (!inserted) {
+      std::cerr << "Could not insert function: " << f->get_name()
+                << " into the LLVM module" << std::endl;
+      shard.lifted = false;
+      break;
+    }
+  }
+
+  FinishAddressLineMap(M.get());
+  if (shard.lifted) {
+    llvm::raw_string_ostream os(shard.bitcode);
+    llvm::WriteBitcodeToFile(M.get(), os);
+    os.flush();
+  }
+}
+
+// Lift the functions of `natMod` using `NumJobs` threads, then link the
+// resulting module shards into `M`.
+static bool LiftFunctionsInParallel(NativeModulePtr natMod, llvm::Module *M) {
+  const auto &funcs = natMod->get_funcs();
+  std::vector<LiftShard> shards(std::min<size_t>(NumJobs, funcs.size()));
+  if (shards.empty()) {
+    return true;
+  }
+
+  auto i = 0U;
+  for (auto &func_info : funcs) {
+    shards[i++ % shards.size()].funcs.push_back(func_info.second);
+  }
+
+  std::string tracer_name;
+  if (AddTracer) {
+    tracer_name = ArchGetOrCreateRegStateTracer(M)->getName().str();
+  }
+
+  std::vector<std::thread> workers;
+  auto shared = gSharedBlocks;
+  for (auto &shard : shards) {
+    workers.emplace_back([natMod, &shard, &tracer_name, shared] () {
+      try {
+        LiftShardFunctions(natMod, shard, tracer_name, shared);
+      } catch (...) {
+        shard.error = std::current_exception();
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (auto &shard : shards) {
+    if (shard.error) {
+      std::rethrow_exception(shard.error);
+    } else if (!shard.lifted) {
+      return false;
+    }
+  }
+
+  // The data sections are defined in `M` with internal linkage; make them
+  // visible to the shards while they are being linked in.
+  SetLiftedLinkage(natMod, M, llvm::GlobalValue::ExternalLinkage);
+
+  auto &C = M->getContext();
+  for (auto &shard : shards) {
+    llvm::MemoryBufferRef buff(shard.bitcode, "shard");
+    auto shard_mod = llvm::parseBitcodeFile(buff, C);
+    if (!shard_mod) {
+      std::cerr << "Could not parse lifted module shard: "
+                << shard_mod.getError().message() << std::endl;
+      return false;
+    }
+    std::string().swap(shard.bitcode);
+
+    if (llvm::Linker::linkModules(*M, std::move(shard_mod.get()))) {
+      std::cerr << "Could not link lifted module shard" << std::endl;
+      return false;
+    }
+  }
+
+  ArchAddDeferredStubs(M);
+  SetLiftedLinkage(natMod, M, llvm::GlobalValue::InternalLinkage);
+  return true;
+}
+
+// Lift the functions of a streamed module one at a time, as they are read
+// from the CFG file.
+static bool LiftStreamedFunctionsIntoModule(NativeModulePtr natMod,
+                                            llvm::Module *M) {
+  return StreamProtoBufFunctions(natMod, [=] (NativeFunctionPtr f) {
+    ArchPreProcessFunction(natMod, f, M);
+    if (!LiftFunction(natMod, f, M)) {
+      std::cerr << "Could not insert function: " << f->get_name()
+                << " into the LLVM module" << std::endl;
+      return false;
+    }
+    return true;
+  });
+}
+
 bool LiftCodeIntoModule(NativeModulePtr natMod, llvm::Module *M) {
-  InitLiftedFunctions(natMod, M);
-  InitExternalData(natMod, M);
-  InitExternalCode(natMod, M);
-  InsertDataSections(natMod, M);
-  return LiftFunctionsIntoModule(natMod, M);
+  InitOutlinedFamilies();
+  InitProfile();
+  MemoizedInstsGuard memo_guard;
+
+  if (IsPartialLift()) {
+    auto lifted = LiftPartialModule(natMod, M);
+    FinishAddressLineMap(M);
+    return lifted;
+  }
+
+  {
+    PhaseTimer timer("declare_functions");
+    InitLiftedFunctions(natMod, M, llvm::GlobalValue::InternalLinkage);
+    InitExternalData(natMod, M);
+    InitExternalCode(natMod, M);
+    if (LookupTableEnabled()) {
+      AddLookupTable(natMod, M);
+    }
+  }
+  {
+    PhaseTimer timer("insert_data_sections");
+    InsertDataSections(natMod, M);
+  }
+
+  auto streamed = natMod->is_streamed();
+  if (LiftCacheEnabled()) {
+    if (1 < NumJobs && !streamed) {
+      std::cerr << "WARNING: The lift cache is not used with more than one "
+                << "job" << std::endl;
+    } else {
+      InitLiftCache(natMod, M);
+    }
+  }
+
+  FindPrivateReturnAddresses(natMod);
+  auto shared_blocks = FindSharedBlocks(natMod);
+  SharedBlocksGuard shared_blocks_guard(shared_blocks.get());
+
+  auto lifted = false;
+  if (streamed) {
+    if (1 < NumJobs) {
+      std::cerr << "WARNING: Streamed CFGs are lifted with one job"
+                << std::endl;
+    }
+    PhaseTimer timer("lift_functions");
+    lifted = LiftStreamedFunctionsIntoModule(natMod, M);
+
+  } else {
+    {
+      PhaseTimer timer("preprocess_functions");
+      for (auto &func_info : natMod->get_funcs()) {
+        ArchPreProcessFunction(natMod, func_info.second, M);
+      }
+    }
+
+    InitSharedTails(M, llvm::GlobalValue::InternalLinkage);
+    if (LiftSharedTails(natMod, M)) {
+      PhaseTimer timer("lift_functions");
+      if (1 < NumJobs) {
+        lifted = LiftFunctionsInParallel(natMod, M);
+      } else {
+        lifted = LiftFunctionsIntoModule(natMod, M);
+      }
+    }
+  }
+
+  if (!gLiftCacheContext.empty()) {
+    std::cerr << "Lift cache: " << gLiftCacheHits << " hits, "
+              << gLiftCacheMisses << " misses" << std::endl;
+  }
+
+  OrderFunctionsByProfile(M);
+  KeepBlockCounters(M);
+  AddFuzzGuardInit(M);
+  FinishAddressLineMap(M);
+  return lifted;
 }
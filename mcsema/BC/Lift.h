@@ -31,6 +31,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MCSEMA_BC_LIFT_H_
 
 #include <set>
+#include <string>
+#include <vector>
 
 #include "mcsema/CFG/CFG.h"
 
@@ -40,4 +42,31 @@ void RenameLiftedFunctions(NativeModulePtr mod, llvm::Module *M,
 
 bool LiftCodeIntoModule(NativeModulePtr, llvm::Module *);
 
+// Write a map from the native address of every lifted function in `M` to its
+// name in `M` and its original symbol name, one function per line. Profilers
+// and `tools/perfmap` use it to tie lifted code back to the native binary.
+bool WriteSymbolMap(NativeModulePtr mod, llvm::Module *M,
+                    const std::string &path);
+
+// Returns true if the functions of a module are lifted on more than one
+// thread, with `-jobs`.
+bool LiftsFunctionsInParallel(void);
+
+// Returns true if only some functions are lifted, with `-lift-functions`.
+// The resulting module is partial, and is combined with the other partial
+// modules of the same lift by `MergeLiftedModules`.
+bool IsPartialLift(void);
+
+// Link the partial modules in `file_names` into `M`, add the stubs that
+// they deferred, and make the lifted functions and data sections internal.
+bool MergeLiftedModules(NativeModulePtr mod, llvm::Module *M,
+                        const std::vector<std::string> &file_names);
+
+// Returns true if the whole lifted module should be verified, i.e. with
+// `-verify=module`.
+bool ShouldVerifyModule(void);
+
+// Returns true if lifted functions are cached across runs with `-cache-dir`.
+bool LiftCacheEnabled(void);
+
 #endif  // MCSEMA_BC_LIFT_H_
@@ -0,0 +1,335 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CallingConv.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+
+#include <llvm/MC/MCInst.h>
+
+#include <llvm/Transforms/Utils/Local.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Register.h"
+#include "mcsema/BC/Liveness.h"
+#include "mcsema/BC/Util.h"
+#include "mcsema/CFG/CFG.h"
+
+namespace {
+
+// A general purpose register, and its sub-registers. Writing the full
+// register, or its 32-bit sub-register, overwrites the whole register;
+// writing any of the others leaves part of it in place.
+struct RegisterFamily {
+  MCSemaRegs full_regs[2];
+  MCSemaRegs partial_regs[3];
+};
+
+// The stack pointer is left out; it is always live.
+static const RegisterFamily kFamilies[] = {
+  {{llvm::X86::RAX, llvm::X86::EAX},
+   {llvm::X86::AX, llvm::X86::AL, llvm::X86::AH}},
+  {{llvm::X86::RBX, llvm::X86::EBX},
+   {llvm::X86::BX, llvm::X86::BL, llvm::X86::BH}},
+  {{llvm::X86::RCX, llvm::X86::ECX},
+   {llvm::X86::CX, llvm::X86::CL, llvm::X86::CH}},
+  {{llvm::X86::RDX, llvm::X86::EDX},
+   {llvm::X86::DX, llvm::X86::DL, llvm::X86::DH}},
+  {{llvm::X86::RSI, llvm::X86::ESI},
+   {llvm::X86::SI, llvm::X86::SIL, llvm::X86::NoRegister}},
+  {{llvm::X86::RDI, llvm::X86::EDI},
+   {llvm::X86::DI, llvm::X86::DIL, llvm::X86::NoRegister}},
+  {{llvm::X86::RBP, llvm::X86::EBP},
+   {llvm::X86::BP, llvm::X86::BPL, llvm::X86::NoRegister}},
+  {{llvm::X86::R8, llvm::X86::R8D},
+   {llvm::X86::R8W, llvm::X86::R8B, llvm::X86::NoRegister}},
+  {{llvm::X86::R9, llvm::X86::R9D},
+   {llvm::X86::R9W, llvm::X86::R9B, llvm::X86::NoRegister}},
+  {{llvm::X86::R10, llvm::X86::R10D},
+   {llvm::X86::R10W, llvm::X86::R10B, llvm::X86::NoRegister}},
+  {{llvm::X86::R11, llvm::X86::R11D},
+   {llvm::X86::R11W, llvm::X86::R11B, llvm::X86::NoRegister}},
+  {{llvm::X86::R12, llvm::X86::R12D},
+   {llvm::X86::R12W, llvm::X86::R12B, llvm::X86::NoRegister}},
+  {{llvm::X86::R13, llvm::X86::R13D},
+   {llvm::X86::R13W, llvm::X86::R13B, llvm::X86::NoRegister}},
+  {{llvm::X86::R14, llvm::X86::R14D},
+   {llvm::X86::R14W, llvm::X86::R14B, llvm::X86::NoRegister}},
+  {{llvm::X86::R15, llvm::X86::R15D},
+   {llvm::X86::R15W, llvm::X86::R15B, llvm::X86::NoRegister}}
+};
+
+static const unsigned kNumFamilies = sizeof(kFamilies) / sizeof(kFamilies[0]);
+static const uint32_t kAllRegs = (1U << kNumFamilies) - 1;
+
+// The bit of a register's family in a register mask, and whether writing the
+// register overwrites the whole family.
+struct RegisterBit {
+  uint32_t bit;
+  bool is_full;
+};
+
+static const std::unordered_map<unsigned, RegisterBit> &RegisterBits(void) {
+  static const auto bits = [] {
+    std::unordered_map<unsigned, RegisterBit> reg_bits;
+    for (unsigned i = 0; i < kNumFamilies; ++i) {
+      for (auto reg : kFamilies[i].full_regs) {
+        reg_bits[reg] = {1U << i, true};
+      }
+      for (auto reg : kFamilies[i].partial_regs) {
+        if (llvm::X86::NoRegister != reg) {
+          reg_bits[reg] = {1U << i, false};
+        }
+      }
+    }
+    return reg_bits;
+  }();
+  return bits;
+}
+
+static uint32_t RegisterMask(std::initializer_list<MCSemaRegs> regs) {
+  const auto &reg_bits = RegisterBits();
+  uint32_t mask = 0;
+  for (auto reg : regs) {
+    mask |= reg_bits.at(reg).bit;
+  }
+  return mask;
+}
+
+// The registers that the caller of a lifted function can observe once it
+// returns: the return value and callee-saved registers.
+static uint32_t ExitRegisters(void) {
+  if (Pointer64 != ArchAddressSize()) {
+    return RegisterMask({llvm::X86::RAX, llvm::X86::RDX, llvm::X86::RBX,
+                         llvm::X86::RSI, llvm::X86::RDI, llvm::X86::RBP});
+
+  } else if (llvm::CallingConv::X86_64_Win64 == ArchCallingConv()) {
+    return RegisterMask({llvm::X86::RAX, llvm::X86::RBX, llvm::X86::RBP,
+                         llvm::X86::RSI, llvm::X86::RDI, llvm::X86::R12,
+                         llvm::X86::R13, llvm::X86::R14, llvm::X86::R15});
+
+  } else {
+    return RegisterMask({llvm::X86::RAX, llvm::X86::RDX, llvm::X86::RBX,
+                         llvm::X86::RBP, llvm::X86::R12, llvm::X86::R13,
+                         llvm::X86::R14, llvm::X86::R15});
+  }
+}
+
+// Returns the registers that are live before `inst`, given the registers
+// that are live after it.
+static uint32_t LiveBefore(NativeInstPtr inst, uint32_t live,
+                           uint32_t exit_regs) {
+  const auto &mcinst = inst->get_inst();
+  auto opcode = mcinst.getOpcode();
+
+  std::vector<unsigned> uses;
+  std::vector<unsigned> defs;
+  if (!ArchInstructionRegisters(mcinst, uses, defs)) {
+    return kAllRegs;
+
+  } else if (ArchInstructionIsReturn(opcode)) {
+    return exit_regs;
+
+  } else if (inst->has_call_tgt() || inst->has_ext_call_target() ||
+             ArchInstructionObservesPC(opcode, false)) {
+    return kAllRegs;
+  }
+
+  const auto &reg_bits = RegisterBits();
+  for (auto reg : defs) {
+    auto bit_it = reg_bits.find(reg);
+    if (bit_it != reg_bits.end() && bit_it->second.is_full) {
+      live &= ~bit_it->second.bit;
+    }
+  }
+  for (auto reg : uses) {
+    auto bit_it = reg_bits.find(reg);
+    if (bit_it != reg_bits.end()) {
+      live |= bit_it->second.bit;
+    }
+  }
+  return live;
+}
+
+// Returns the registers that are live at the end of `block`, given the
+// registers that are live on entry to the blocks of the function.
+static uint32_t LiveOut(NativeBlockPtr block,
+                        const std::map<VA, uint32_t> &live_in) {
+  const auto &follows = block->get_follows();
+  if (follows.empty()) {
+    return kAllRegs;
+  }
+
+  uint32_t live = 0;
+  for (auto succ_va : follows) {
+    auto live_it = live_in.find(succ_va);
+    if (live_it == live_in.end()) {
+      return kAllRegs;
+    }
+    live |= live_it->second;
+  }
+  return live;
+}
+
+}  // namespace
+
+RegisterLiveness::RegisterLiveness(NativeFunctionPtr func, bool follows_abi) {
+  const auto &blocks = func->get_blocks();
+  auto exit_regs = follows_abi ? ExitRegisters() : kAllRegs;
+
+  std::map<VA, uint32_t> live_in;
+  for (const auto &block_info : blocks) {
+    live_in[block_info.first] = 0;
+  }
+
+  // Iterate to a fixed point. Blocks are visited in reverse, which roughly
+  // follows the flow of liveness.
+  for (auto changed = true; changed; ) {
+    changed = false;
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+      auto live = LiveOut(it->second, live_in);
+      const auto &insts = it->second->get_insts();
+      for (auto inst_it = insts.rbegin(); inst_it != insts.rend(); ++inst_it) {
+        live = LiveBefore(*inst_it, live, exit_regs);
+      }
+      auto &old_live = live_in[it->first];
+      if (live != old_live) {
+        old_live = live;
+        changed = true;
+      }
+    }
+  }
+
+  for (const auto &block_info : blocks) {
+    auto live = LiveOut(block_info.second, live_in);
+    const auto &insts = block_info.second->get_insts();
+    for (auto inst_it = insts.rbegin(); inst_it != insts.rend(); ++inst_it) {
+      if (auto dead = kAllRegs & ~live) {
+        dead_after[*inst_it] = dead;
+      }
+      live = LiveBefore(*inst_it, live, exit_regs);
+    }
+  }
+}
+
+uint32_t RegisterLiveness::get_dead_after(NativeInstPtr inst) const {
+  auto dead_it = dead_after.find(inst);
+  return dead_it != dead_after.end() ? dead_it->second : 0;
+}
+
+void RemoveDeadRegisterStores(TranslationContext &ctx, llvm::BasicBlock *block,
+                              llvm::Instruction *prev) {
+  auto dead = ctx.liveness->get_dead_after(ctx.natI);
+  if (!dead) {
+    return;
+  }
+
+  // The read and write variables of the dead registers.
+  std::unordered_map<llvm::Value *, uint32_t> vars;
+  auto add_var = [&] (MCSemaRegs reg, uint32_t bit) {
+    if (llvm::X86::NoRegister != reg && reg < ctx.regs->write.size()) {
+      if (auto write_var = ctx.regs->write[reg]) {
+        vars[write_var] = bit;
+      }
+      if (auto read_var = ctx.regs->read[reg]) {
+        vars[read_var] = bit;
+      }
+    }
+  };
+  for (unsigned i = 0; i < kNumFamilies; ++i) {
+    if (dead & (1U << i)) {
+      for (auto reg : kFamilies[i].full_regs) {
+        add_var(reg, 1U << i);
+      }
+      for (auto reg : kFamilies[i].partial_regs) {
+        add_var(reg, 1U << i);
+      }
+    }
+  }
+
+  // Give up if the lifted code calls something that may read the register
+  // state, or uses the register variables as anything but the address of a
+  // load or store.
+  std::vector<llvm::Instruction *> lifted;
+  auto it = prev ? ++llvm::BasicBlock::iterator(prev) : block->begin();
+  for (; it != block->end(); ++it) {
+    auto inst = &*it;
+    auto call = llvm::dyn_cast<llvm::CallInst>(inst);
+    if ((call && IsStateSyncPoint(call)) ||
+        llvm::isa<llvm::InvokeInst>(inst)) {
+      return;
+    }
+    for (auto &op : inst->operands()) {
+      if (!vars.count(op.get())) {
+        continue;
+      }
+      auto is_address =
+          (llvm::isa<llvm::LoadInst>(inst) &&
+           llvm::LoadInst::getPointerOperandIndex() == op.getOperandNo()) ||
+          (llvm::isa<llvm::StoreInst>(inst) &&
+           llvm::StoreInst::getPointerOperandIndex() == op.getOperandNo());
+      if (!is_address) {
+        return;
+      }
+    }
+    lifted.push_back(inst);
+  }
+
+  // Keep the stores whose registers are read back by the lifted code.
+  uint32_t read = 0;
+  std::vector<llvm::StoreInst *> dead_stores;
+  for (auto inst_it = lifted.rbegin(); inst_it != lifted.rend(); ++inst_it) {
+    if (auto load = llvm::dyn_cast<llvm::LoadInst>(*inst_it)) {
+      auto var_it = vars.find(load->getPointerOperand());
+      if (var_it != vars.end()) {
+        read |= var_it->second;
+      }
+    } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(*inst_it)) {
+      auto var_it = vars.find(store->getPointerOperand());
+      if (var_it != vars.end() && !(read & var_it->second) &&
+          !store->isVolatile()) {
+        dead_stores.push_back(store);
+      }
+    }
+  }
+
+  for (auto store : dead_stores) {
+    auto val = store->getValueOperand();
+    store->eraseFromParent();
+    llvm::RecursivelyDeleteTriviallyDeadInstructions(val);
+  }
+}
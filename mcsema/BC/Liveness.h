@@ -0,0 +1,73 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_LIVENESS_H_
+#define MCSEMA_BC_LIVENESS_H_
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class BasicBlock;
+class Instruction;
+
+}  // namespace llvm
+
+// The general purpose registers that are dead after each instruction of a
+// native function, i.e. that are overwritten on every path from the
+// instruction before they are read. Calls, indirect branches, returns and
+// instructions with side effects are treated as reading every register. If
+// `follows_abi` is set then returns only read the return and callee-saved
+// registers of the calling convention.
+class RegisterLiveness {
+ public:
+  RegisterLiveness(NativeFunctionPtr func, bool follows_abi);
+
+  // Returns a mask of the registers that are dead after `inst`, where each
+  // bit stands for a register and all of its sub-registers.
+  uint32_t get_dead_after(NativeInstPtr inst) const;
+
+ private:
+  std::unordered_map<const NativeInst *, uint32_t> dead_after;
+};
+
+// Remove the stores to registers that are dead after `ctx.natI` from the IR
+// that lifting it appended to `block` after `prev`. `prev` is the last
+// instruction of `block` before lifting, or `nullptr` if `block` was empty.
+// Nothing is removed if the instruction reads the register back, or if its
+// IR calls out of the lifted function.
+void RemoveDeadRegisterStores(TranslationContext &ctx, llvm::BasicBlock *block,
+                              llvm::Instruction *prev);
+
+#endif  // MCSEMA_BC_LIVENESS_H_
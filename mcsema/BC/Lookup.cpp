@@ -0,0 +1,293 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/Support/CommandLine.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/BC/Lookup.h"
+#include "mcsema/BC/Util.h"
+#include "mcsema/CFG/CFG.h"
+#include "mcsema/cfgToLLVM/TransExcn.h"
+
+static llvm::cl::opt<bool> AddLookupTableOpt(
+    "add-lookup-table",
+    llvm::cl::desc(
+        "Add a hash table that maps the native addresses of lifted functions "
+        "to the lifted functions, and the `__mcsema_lookup` function that "
+        "searches it. Indirect calls and jumps use it to call their targets "
+        "directly, instead of leaving lifted code."),
+    llvm::cl::init(false));
+
+namespace {
+
+static const char * const kLookupFuncName = "__mcsema_lookup";
+
+// Multiplier of the displacement of a bucket, before it is mixed into the
+// hash of a key.
+static const uint64_t kDisplacementMul = 0x9E3779B97F4A7C15ULL;
+
+// How many displacements are tried for a bucket before the table is grown.
+static const uint32_t kMaxDisplacement = 1U << 16;
+
+// The finalizer of MurmurHash3.
+static uint64_t Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static llvm::Value *Mix(llvm::IRBuilder<> &ir, llvm::Value *x) {
+  auto i64 = x->getType();
+  x = ir.CreateXor(x, ir.CreateLShr(x, 33));
+  x = ir.CreateMul(x, llvm::ConstantInt::get(i64, 0xff51afd7ed558ccdULL));
+  x = ir.CreateXor(x, ir.CreateLShr(x, 33));
+  x = ir.CreateMul(x, llvm::ConstantInt::get(i64, 0xc4ceb9fe1a85ec53ULL));
+  return ir.CreateXor(x, ir.CreateLShr(x, 33));
+}
+
+// A hash-and-displace perfect hash table. Every key is first hashed into a
+// bucket, and the displacement of that bucket is then mixed into the hash
+// of the key to find its slot. The displacements are chosen so that no two
+// keys share a slot, so a lookup is a single probe.
+struct PerfectHash {
+  unsigned bucket_bits;
+  unsigned slot_bits;
+  std::vector<uint32_t> displacements;
+  std::vector<uint64_t> slots;  // Zero if unused.
+
+  uint64_t Bucket(uint64_t key) const {
+    return Mix(key) >> (64 - bucket_bits);
+  }
+
+  uint64_t Slot(uint64_t key, uint32_t displacement) const {
+    return Mix(key ^ (displacement * kDisplacementMul)) &
+           ((1ULL << slot_bits) - 1);
+  }
+
+  bool Build(const std::vector<uint64_t> &keys);
+};
+
+bool PerfectHash::Build(const std::vector<uint64_t> &keys) {
+  std::vector<std::vector<uint64_t>> buckets(1ULL << bucket_bits);
+  for (auto key : keys) {
+    buckets[Bucket(key)].push_back(key);
+  }
+
+  // Place the biggest buckets first, while most slots are still free.
+  std::vector<size_t> order(buckets.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&] (size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  displacements.assign(buckets.size(), 0);
+  slots.assign(1ULL << slot_bits, 0);
+  std::vector<bool> used(slots.size(), false);
+  std::vector<uint64_t> placed;
+
+  for (auto b : order) {
+    const auto &bucket = buckets[b];
+    if (bucket.empty()) {
+      break;
+    }
+
+    auto found = false;
+    for (uint32_t d = 0; d < kMaxDisplacement && !found; ++d) {
+      placed.clear();
+      found = true;
+      for (auto key : bucket) {
+        auto slot = Slot(key, d);
+        if (used[slot] ||
+            std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+          found = false;
+          break;
+        }
+        placed.push_back(slot);
+      }
+
+      if (found) {
+        displacements[b] = d;
+        for (size_t i = 0; i < bucket.size(); ++i) {
+          used[placed[i]] = true;
+          slots[placed[i]] = bucket[i];
+        }
+      }
+    }
+
+    if (!found) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static unsigned Log2Ceil(uint64_t val) {
+  unsigned bits = 0;
+  while ((1ULL << bits) < val) {
+    ++bits;
+  }
+  return bits;
+}
+
+}  // namespace
+
+bool LookupTableEnabled(void) {
+  return AddLookupTableOpt;
+}
+
+llvm::Function *GetLookupFunction(llvm::Module *M) {
+  auto F = M->getFunction(kLookupFuncName);
+  if (!F) {
+    auto &C = M->getContext();
+    auto addr_type = llvm::Type::getIntNTy(C, ArchAddressSize());
+    auto func_type = llvm::FunctionType::get(
+        LiftedFunctionType()->getPointerTo(), addr_type, false);
+    F = llvm::Function::Create(
+        func_type, llvm::GlobalValue::ExternalLinkage, kLookupFuncName, M);
+    F->setCallingConv(llvm::CallingConv::C);
+    F->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  return F;
+}
+
+void AddLookupTable(NativeModulePtr natMod, llvm::Module *M) {
+  std::vector<uint64_t> keys;
+  std::unordered_map<uint64_t, llvm::Function *> funcs;
+  for (const auto &func_info : natMod->get_funcs()) {
+    auto F = M->getFunction(func_info.second->get_name());
+    TASSERT(F != nullptr, "Missing lifted function " +
+                          func_info.second->get_name());
+    keys.push_back(func_info.first);
+    funcs[func_info.first] = F;
+  }
+
+  // Aim for an average of four keys per bucket, and keep at least a
+  // fifth of the slots free.
+  PerfectHash hash;
+  hash.bucket_bits = std::max(1U, Log2Ceil(keys.size() / 4));
+  hash.slot_bits = std::max(1U, Log2Ceil(keys.size() + keys.size() / 4));
+  while (!hash.Build(keys)) {
+    ++hash.slot_bits;
+  }
+
+  auto &C = M->getContext();
+  auto i32 = llvm::Type::getInt32Ty(C);
+  auto i64 = llvm::Type::getInt64Ty(C);
+  auto func_ptr_type = LiftedFunctionType()->getPointerTo();
+  auto null_func = llvm::ConstantPointerNull::get(func_ptr_type);
+
+  std::vector<llvm::Constant *> slot_funcs;
+  for (auto key : hash.slots) {
+    slot_funcs.push_back(key ? llvm::cast<llvm::Constant>(funcs[key]) :
+                               null_func);
+  }
+
+  auto displacements = new llvm::GlobalVariable(
+      *M, llvm::ArrayType::get(i32, hash.displacements.size()), true,
+      llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantDataArray::get(C, hash.displacements),
+      "__mcsema_lookup_displacements");
+
+  auto keys_var = new llvm::GlobalVariable(
+      *M, llvm::ArrayType::get(i64, hash.slots.size()), true,
+      llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantDataArray::get(C, hash.slots), "__mcsema_lookup_keys");
+
+  auto funcs_type = llvm::ArrayType::get(func_ptr_type, slot_funcs.size());
+  auto funcs_var = new llvm::GlobalVariable(
+      *M, funcs_type, true, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantArray::get(funcs_type, slot_funcs),
+      "__mcsema_lookup_funcs");
+
+  // The last address that each thread found in the table.
+  auto last_key = new llvm::GlobalVariable(
+      *M, i64, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantInt::get(i64, 0), "__mcsema_lookup_last_key", nullptr,
+      llvm::GlobalValue::GeneralDynamicTLSModel);
+  auto last_func = new llvm::GlobalVariable(
+      *M, func_ptr_type, false, llvm::GlobalValue::InternalLinkage,
+      null_func, "__mcsema_lookup_last_func", nullptr,
+      llvm::GlobalValue::GeneralDynamicTLSModel);
+
+  auto F = GetLookupFunction(M);
+  auto entry = llvm::BasicBlock::Create(C, "entry", F);
+  auto cached = llvm::BasicBlock::Create(C, "cached", F);
+  auto probe = llvm::BasicBlock::Create(C, "probe", F);
+  auto found = llvm::BasicBlock::Create(C, "found", F);
+  auto missing = llvm::BasicBlock::Create(C, "missing", F);
+
+  llvm::IRBuilder<> ir(entry);
+  auto key = ir.CreateZExt(&*F->arg_begin(), i64);
+  ir.CreateCondBr(ir.CreateICmpEQ(key, ir.CreateLoad(last_key)),
+                  cached, probe);
+
+  ir.SetInsertPoint(cached);
+  ir.CreateRet(ir.CreateLoad(last_func));
+
+  auto zero = llvm::ConstantInt::get(i64, 0);
+  ir.SetInsertPoint(probe);
+  auto bucket = ir.CreateLShr(Mix(ir, key), 64 - hash.bucket_bits);
+  llvm::Value *displacement = ir.CreateLoad(
+      ir.CreateInBoundsGEP(displacements, {zero, bucket}));
+  displacement = ir.CreateMul(
+      ir.CreateZExt(displacement, i64),
+      llvm::ConstantInt::get(i64, kDisplacementMul));
+  auto slot = ir.CreateAnd(
+      Mix(ir, ir.CreateXor(key, displacement)),
+      llvm::ConstantInt::get(i64, (1ULL << hash.slot_bits) - 1));
+  auto slot_key = ir.CreateLoad(ir.CreateInBoundsGEP(keys_var, {zero, slot}));
+  ir.CreateCondBr(ir.CreateICmpEQ(key, slot_key), found, missing);
+
+  ir.SetInsertPoint(found);
+  auto func = ir.CreateLoad(ir.CreateInBoundsGEP(funcs_var, {zero, slot}));
+  ir.CreateStore(key, last_key);
+  ir.CreateStore(func, last_func);
+  ir.CreateRet(func);
+
+  ir.SetInsertPoint(missing);
+  ir.CreateRet(null_func);
+}
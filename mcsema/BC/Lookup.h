@@ -0,0 +1,56 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_LOOKUP_H_
+#define MCSEMA_BC_LOOKUP_H_
+
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class Function;
+class Module;
+
+}  // namespace llvm
+
+// Returns true if indirect calls and jumps should look up their targets with
+// `__mcsema_lookup` before leaving lifted code.
+bool LookupTableEnabled(void);
+
+// Returns the declaration of `__mcsema_lookup` in `M`. The function maps the
+// native address of a lifted function to the lifted function, or returns a
+// null pointer if there is no lifted function at that address.
+llvm::Function *GetLookupFunction(llvm::Module *M);
+
+// Define `__mcsema_lookup` in `M`, along with a perfect hash table of the
+// entry addresses of all lifted functions of `natMod`.
+void AddLookupTable(NativeModulePtr natMod, llvm::Module *M);
+
+#endif  // MCSEMA_BC_LOOKUP_H_
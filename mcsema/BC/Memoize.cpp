@@ -0,0 +1,282 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/Statistic.h>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/Arch/Register.h"
+#include "mcsema/BC/Memoize.h"
+#include "mcsema/BC/Outline.h"
+#include "mcsema/CFG/CFG.h"
+
+#define DEBUG_TYPE "mcsema-memoize"
+
+STATISTIC(NumMemoizedInsts, "Number of distinct instructions memoized");
+STATISTIC(NumClonedInsts, "Number of instructions cloned from memoized IR");
+
+namespace {
+
+// The inputs of memoized IR are the state pointer and the register variables
+// of the function that it is cloned into. Slot `0` is the state pointer, and
+// the read and write variables of register `r` are in slots `1 + 2 * r` and
+// `2 + 2 * r`.
+static const unsigned kStateSlot = 0;
+
+// The IR of a memoized instruction. The instructions aren't in any block,
+// and their inputs are replaced by placeholder variables.
+struct MemoizedInst {
+  ~MemoizedInst(void) {
+    for (auto inst : insts) {
+      inst->dropAllReferences();
+    }
+    for (auto inst : insts) {
+      delete inst;
+    }
+  }
+
+  std::vector<llvm::Instruction *> insts;
+  std::vector<std::pair<llvm::GlobalVariable *, unsigned>> inputs;
+};
+
+// The memoized instructions of the module that the current thread is
+// lifting into, keyed by `InstructionSemanticsKey`. Instructions that were
+// lifted, but can't be memoized, map to `nullptr`.
+static thread_local llvm::Module *gMemoModule = nullptr;
+static thread_local std::unordered_map<
+    std::string, std::unique_ptr<MemoizedInst>> gMemoizedInsts;
+
+// Placeholders for the inputs of memoized IR, keyed by slot and type. They
+// are defined in their own module so that they never end up in lifted code.
+static thread_local llvm::Module *gPlaceholderModule = nullptr;
+static thread_local std::map<std::pair<unsigned, llvm::Type *>,
+                             llvm::GlobalVariable *> gPlaceholders;
+
+static llvm::GlobalVariable *GetPlaceholder(llvm::PointerType *type,
+                                            unsigned slot) {
+  auto &placeholder = gPlaceholders[{slot, type}];
+  if (!placeholder) {
+    if (!gPlaceholderModule) {
+      gPlaceholderModule = new llvm::Module(
+          "mcsema_memoize_placeholders", type->getContext());
+    }
+    placeholder = new llvm::GlobalVariable(
+        *gPlaceholderModule, type->getElementType(), false,
+        llvm::GlobalValue::ExternalLinkage, nullptr, "",
+        nullptr, llvm::GlobalValue::NotThreadLocal,
+        type->getAddressSpace());
+  }
+  return placeholder;
+}
+
+// Returns the value of `F` that goes into `slot`.
+static llvm::Value *GetSlotValue(TranslationContext &ctx, unsigned slot) {
+  if (kStateSlot == slot) {
+    return &*ctx.F->arg_begin();
+  }
+  auto reg = (slot - 1) / 2;
+  return ArchGetRegisterVar(ctx.F, reg, !(slot % 2));
+}
+
+// Returns the slots of the state pointer and the register variables of
+// `ctx.F`.
+static std::unordered_map<llvm::Value *, unsigned> GetSlots(
+    TranslationContext &ctx) {
+  std::unordered_map<llvm::Value *, unsigned> slots;
+  slots[&*ctx.F->arg_begin()] = kStateSlot;
+  for (unsigned reg = 0; reg < ctx.regs->read.size(); ++reg) {
+    if (auto read_var = ctx.regs->read[reg]) {
+      slots.emplace(read_var, 1 + 2 * reg);
+    }
+    if (auto write_var = ctx.regs->write[reg]) {
+      slots.emplace(write_var, 2 + 2 * reg);
+    }
+  }
+  return slots;
+}
+
+// Copy the IR in `lifted`, replacing its inputs with placeholders. Returns
+// `nullptr` if some of the IR can't be cloned into another function.
+static MemoizedInst *CreateMemoizedInst(
+    TranslationContext &ctx, const std::vector<llvm::Instruction *> &lifted) {
+  std::unique_ptr<MemoizedInst> memo(new MemoizedInst);
+  auto slots = GetSlots(ctx);
+  llvm::ValueToValueMapTy vmap;
+
+  for (auto inst : lifted) {
+    if (llvm::isa<llvm::TerminatorInst>(inst) ||
+        llvm::isa<llvm::PHINode>(inst) || llvm::isa<llvm::AllocaInst>(inst)) {
+      return nullptr;
+    }
+
+    for (auto &op : inst->operands()) {
+      auto val = op.get();
+      if (vmap.count(val) || llvm::isa<llvm::MetadataAsValue>(val) ||
+          llvm::isa<llvm::InlineAsm>(val)) {
+        continue;
+      }
+
+      if (auto const_val = llvm::dyn_cast<llvm::Constant>(val)) {
+        if (llvm::isa<llvm::BlockAddress>(const_val)) {
+          return nullptr;
+        }
+        continue;
+      }
+
+      // Values computed by earlier instructions, or block labels, can't be
+      // found in another function.
+      auto slot_it = slots.find(val);
+      auto ptr_type = llvm::dyn_cast<llvm::PointerType>(val->getType());
+      if (slot_it == slots.end() || !ptr_type) {
+        return nullptr;
+      }
+
+      auto placeholder = GetPlaceholder(ptr_type, slot_it->second);
+      vmap[val] = placeholder;
+      memo->inputs.emplace_back(placeholder, slot_it->second);
+    }
+
+    auto clone = inst->clone();
+    memo->insts.push_back(clone);
+    vmap[inst] = clone;
+  }
+
+  for (auto clone : memo->insts) {
+    llvm::RemapInstruction(
+        clone, vmap,
+        llvm::RF_NoModuleLevelChanges | llvm::RF_IgnoreMissingEntries);
+  }
+  return memo.release();
+}
+
+}  // namespace
+
+bool CanMemoizeInstruction(NativeInstPtr inst) {
+  const auto &mcinst = inst->get_inst();
+
+  // x87 instructions are lifted against the current renaming of the x87
+  // stack, so the same instruction can be lifted differently each time.
+  auto family = ArchGetInstructionFamily(mcinst);
+  return HasOperandOnlySemantics(inst) &&
+         !(family && !strcmp(family, "FPU")) &&
+         !ArchInstructionObservesPC(mcinst.getOpcode(), false);
+}
+
+bool CloneMemoizedInstruction(TranslationContext &ctx,
+                              llvm::BasicBlock *block) {
+  if (ctx.M != gMemoModule) {
+    return false;
+  }
+
+  auto memo_it = gMemoizedInsts.find(InstructionSemanticsKey(ctx.natI));
+  if (memo_it == gMemoizedInsts.end() || !memo_it->second) {
+    return false;
+  }
+
+  auto memo = memo_it->second.get();
+  llvm::ValueToValueMapTy vmap;
+  for (const auto &input : memo->inputs) {
+    auto val = GetSlotValue(ctx, input.second);
+    if (!val || val->getType() != input.first->getType()) {
+      return false;
+    }
+    vmap[input.first] = val;
+  }
+
+  // The memoized IR expects the register variables to be in their canonical
+  // form.
+  ArchSyncRegisterVars(block);
+
+  for (auto inst : memo->insts) {
+    auto clone = inst->clone();
+    block->getInstList().push_back(clone);
+    vmap[inst] = clone;
+    llvm::RemapInstruction(
+        clone, vmap,
+        llvm::RF_NoModuleLevelChanges | llvm::RF_IgnoreMissingEntries);
+  }
+
+  ++NumClonedInsts;
+  return true;
+}
+
+void MemoizeInstruction(TranslationContext &ctx, llvm::BasicBlock *block,
+                        llvm::Instruction *prev) {
+  if (ctx.M != gMemoModule) {
+    ClearMemoizedInstructions();
+    gMemoModule = ctx.M;
+  }
+
+  auto key = InstructionSemanticsKey(ctx.natI);
+  if (key.empty() || gMemoizedInsts.count(key)) {
+    return;
+  }
+
+  std::vector<llvm::Instruction *> lifted;
+  auto it = prev ? ++llvm::BasicBlock::iterator(prev) : block->begin();
+  for (; it != block->end(); ++it) {
+    lifted.push_back(&*it);
+  }
+
+  auto memo = CreateMemoizedInst(ctx, lifted);
+  gMemoizedInsts[key].reset(memo);
+  if (memo) {
+    ++NumMemoizedInsts;
+  }
+}
+
+void ClearMemoizedInstructions(void) {
+  gMemoizedInsts.clear();
+  gMemoModule = nullptr;
+
+  gPlaceholders.clear();
+  delete gPlaceholderModule;
+  gPlaceholderModule = nullptr;
+}
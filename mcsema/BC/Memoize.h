@@ -0,0 +1,74 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_MEMOIZE_H_
+#define MCSEMA_BC_MEMOIZE_H_
+
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class BasicBlock;
+class Instruction;
+
+}  // namespace llvm
+
+// Returns true if the IR of `inst` only depends on its opcode, prefix and
+// operands, so that it can be memoized.
+bool CanMemoizeInstruction(NativeInstPtr inst);
+
+// Lift the instruction `ctx.natI` into `block` by cloning the IR of an
+// identical instruction that was lifted before, i.e. one with the same
+// opcode, prefix and operands. The clone uses the register variables of
+// `ctx.F` instead of those of the function that the original was lifted
+// into.
+//
+// Returns false, without changing `block`, if no identical instruction has
+// been memoized. The instruction should then be lifted normally, and passed
+// to `MemoizeInstruction`.
+bool CloneMemoizedInstruction(TranslationContext &ctx,
+                              llvm::BasicBlock *block);
+
+// Remember the IR that lifting `ctx.natI` appended to `block` after `prev`,
+// so that later instances of the same instruction can be cloned from it.
+// `prev` is the last instruction of `block` before lifting, or `nullptr` if
+// `block` was empty. The register variables must have been in their
+// canonical form before lifting, and lifting must not have added any blocks.
+// Nothing is remembered if the IR refers to values of `ctx.F` other than its
+// register variables.
+void MemoizeInstruction(TranslationContext &ctx, llvm::BasicBlock *block,
+                        llvm::Instruction *prev);
+
+// Forget the instructions memoized by the current thread. This must be done
+// before the module that they were lifted into is destroyed.
+void ClearMemoizedInstructions(void);
+
+#endif  // MCSEMA_BC_MEMOIZE_H_
@@ -0,0 +1,87 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/Pass.h>
+
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/Scalar.h>
+
+#include "mcsema/BC/Optimize.h"
+
+void OptimizeModule(llvm::Module *M, unsigned level) {
+  llvm::TimePassesIsEnabled = true;
+
+  llvm::legacy::FunctionPassManager func_passes(M);
+
+  // The register variables (`-promote-registers`) and the stack slots made
+  // by the semantics are `alloca`s, which SROA turns into SSA values.
+  func_passes.add(llvm::createSROAPass());
+  func_passes.add(llvm::createEarlyCSEPass());
+  func_passes.add(llvm::createInstructionCombiningPass());
+  func_passes.add(llvm::createCFGSimplificationPass());
+
+  if (2 <= level) {
+    // Every lifted instruction writes to the program counter, and the flags
+    // and registers are often rewritten before they are read. GVN forwards
+    // the stored values to the loads of the state structure, and DSE then
+    // removes the stores that are overwritten.
+    func_passes.add(llvm::createGVNPass());
+    func_passes.add(llvm::createDeadStoreEliminationPass());
+    func_passes.add(llvm::createInstructionCombiningPass());
+    func_passes.add(llvm::createAggressiveDCEPass());
+    func_passes.add(llvm::createCFGSimplificationPass());
+  }
+
+  if (3 <= level) {
+    func_passes.add(llvm::createJumpThreadingPass());
+    func_passes.add(llvm::createCorrelatedValuePropagationPass());
+    func_passes.add(llvm::createLICMPass());
+    func_passes.add(llvm::createGVNPass());
+    func_passes.add(llvm::createDeadStoreEliminationPass());
+    func_passes.add(llvm::createInstructionCombiningPass());
+    func_passes.add(llvm::createCFGSimplificationPass());
+  }
+
+  func_passes.doInitialization();
+  for (auto &F : *M) {
+    func_passes.run(F);
+  }
+  func_passes.doFinalization();
+
+  llvm::legacy::PassManager module_passes;
+  module_passes.add(llvm::createGlobalDCEPass());
+  if (2 <= level) {
+    module_passes.add(llvm::createConstantMergePass());
+  }
+  module_passes.run(*M);
+}
@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/MC/MCInst.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/Arch/Register.h"
+#include "mcsema/BC/Outline.h"
+#include "mcsema/BC/Util.h"
+#include "mcsema/CFG/CFG.h"
+
+namespace {
+
+static const char * const kOutlinedPrefix = "__mcsema_outlined_";
+
+// Lift `inst` into a new helper function named `name`. Returns `nullptr`
+// if the semantics of `inst` don't fit into a single-entry, single-exit
+// helper.
+static llvm::Function *CreateOutlinedFunction(
+    TranslationContext &ctx, InstructionLifter *lifter,
+    const std::string &name) {
+  auto M = ctx.M;
+  auto &C = M->getContext();
+
+  // Every function that uses the same instruction defines the same helper,
+  // so let the linker merge the copies from shards and the lift cache.
+  auto F = llvm::Function::Create(
+      LiftedFunctionType(), llvm::GlobalValue::LinkOnceODRLinkage, name, M);
+  ArchSetCallingConv(M, F);
+  F->addFnAttr(llvm::Attribute::NoInline);
+
+  auto entry = llvm::BasicBlock::Create(C, "entry", F);
+  ArchAllocRegisterVars(entry);
+
+  auto body = llvm::BasicBlock::Create(C, "body", F);
+  llvm::BranchInst::Create(body, entry);
+
+  TranslationContext helper_ctx = ctx;
+  helper_ctx.F = F;
+  helper_ctx.regs = GetRegisterTable(F);
+  helper_ctx.unannotated_blocks.clear();
+
+  auto block = body;
+  auto itr = ArchLiftInstruction(helper_ctx, block, lifter);
+  if (ContinueBlock == itr && !block->getTerminator()) {
+    ArchSyncRegisterVars(block);
+  }
+  FreeRegisterTable(F);
+
+  if (ContinueBlock != itr || block->getTerminator()) {
+    F->eraseFromParent();
+    return nullptr;
+  }
+
+  llvm::ReturnInst::Create(C, block);
+  return F;
+}
+
+}  // namespace
+
+bool HasOperandOnlySemantics(NativeInstPtr inst) {
+  return !inst->terminator() &&
+         !inst->has_reference(NativeInst::IMMRef) &&
+         !inst->has_reference(NativeInst::MEMRef) &&
+         !inst->has_external_ref() &&
+         !inst->has_rip_relative() &&
+         !inst->has_jump_table() &&
+         !inst->has_jump_index_table() &&
+         !inst->has_call_tgt() &&
+         !inst->has_system_call_number() &&
+         !inst->has_local_noreturn();
+}
+
+std::string InstructionSemanticsKey(NativeInstPtr inst) {
+  const auto &mcinst = inst->get_inst();
+  std::stringstream ss;
+  ss << ArchInstructionName(mcinst.getOpcode()) << "_p"
+     << static_cast<int>(inst->get_prefix());
+
+  for (unsigned i = 0; i < mcinst.getNumOperands(); ++i) {
+    const auto &op = mcinst.getOperand(i);
+    if (op.isReg()) {
+      ss << "_r" << op.getReg();
+    } else if (op.isImm()) {
+      ss << "_i" << std::hex << static_cast<uint64_t>(op.getImm()) << std::dec;
+    } else if (op.isFPImm()) {
+      auto val = op.getFPImm();
+      uint64_t bits = 0;
+      memcpy(&bits, &val, sizeof(bits));
+      ss << "_f" << std::hex << bits << std::dec;
+    } else {
+      return "";
+    }
+  }
+  return ss.str();
+}
+
+bool IsOutlinedSemantics(const llvm::Function *F) {
+  return !F->isDeclaration() && F->getName().startswith(kOutlinedPrefix);
+}
+
+bool LiftOutlinedInstruction(TranslationContext &ctx, llvm::BasicBlock *block,
+                             InstructionLifter *lifter) {
+  if (!HasOperandOnlySemantics(ctx.natI)) {
+    return false;
+  }
+
+  auto key = InstructionSemanticsKey(ctx.natI);
+  if (key.empty()) {
+    return false;
+  }
+
+  auto name = kOutlinedPrefix + key;
+
+  auto F = ctx.M->getFunction(name);
+  if (!F) {
+    F = CreateOutlinedFunction(ctx, lifter, name);
+  }
+
+  if (!F || F->isDeclaration()) {
+    return false;
+  }
+
+  // The helper expects the register state to be in its canonical form.
+  ArchSyncRegisterVars(block);
+
+  std::vector<llvm::Value *> args;
+  for (auto &arg : ctx.F->args()) {
+    args.push_back(&arg);
+  }
+  auto call = llvm::CallInst::Create(F, args, "", block);
+  ArchSetCallingConv(ctx.M, call);
+  return true;
+}
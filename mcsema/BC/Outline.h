@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_OUTLINE_H_
+#define MCSEMA_BC_OUTLINE_H_
+
+#include <string>
+
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class BasicBlock;
+class Function;
+
+}  // namespace llvm
+
+// Returns true if the semantics of `inst` only depend on its opcode, prefix
+// and operands.
+bool HasOperandOnlySemantics(NativeInstPtr inst);
+
+// Returns a string that encodes the opcode, prefix and operands of `inst`, or
+// an empty string if one of its operands can't be encoded.
+std::string InstructionSemanticsKey(NativeInstPtr inst);
+
+// Returns true if `F` is a helper function that holds the outlined semantics
+// of an instruction.
+bool IsOutlinedSemantics(const llvm::Function *F);
+
+// Lift the instruction `ctx.natI` into a helper function that is shared by
+// every instance of the same instruction, and call the helper from `block`.
+// Helpers are keyed by the opcode, prefix and operands of the instruction,
+// because the semantics bake the operands into the code that they emit.
+//
+// Returns false, without changing `block`, if the instruction can't be
+// outlined, e.g. because it refers to code or data, or ends the block. The
+// instruction should then be lifted inline.
+bool LiftOutlinedInstruction(TranslationContext &ctx, llvm::BasicBlock *block,
+                             InstructionLifter *lifter);
+
+#endif  // MCSEMA_BC_OUTLINE_H_
@@ -0,0 +1,666 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+
+#include <llvm/Bitcode/ReaderWriter.h>
+
+#include <llvm/CodeGen/ParallelCG.h>
+
+#include <llvm/IR/Module.h>
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/ToolOutputFile.h>
+
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <llvm/Transforms/Utils/SplitModule.h>
+
+#ifdef MCSEMA_HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+#include "mcsema/BC/Output.h"
+
+static llvm::cl::opt<unsigned> SplitOutput(
+    "split-output",
+    llvm::cl::desc(
+        "Split the lifted module into this many bitcode files, named "
+        "<output>.<n>.bc, and write a manifest of the functions that each "
+        "file defines to <output>."),
+    llvm::cl::init(0));
+
+static llvm::cl::opt<bool> EmitObj(
+    "emit-obj",
+    llvm::cl::desc("Generate an object file instead of bitcode."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> EmitAsm(
+    "emit-asm",
+    llvm::cl::desc("Generate an assembly file instead of bitcode."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<unsigned> CodeGenJobs(
+    "codegen-jobs",
+    llvm::cl::desc(
+        "Number of threads that generate code with -emit-obj or -emit-asm. "
+        "Each thread generates code for one part of the module, and the "
+        "parts are combined into the output file. Zero uses one thread per "
+        "core."),
+    llvm::cl::init(1));
+
+static llvm::cl::opt<bool> ThinLTOSummary(
+    "thinlto-summary",
+    llvm::cl::desc(
+        "Write a ThinLTO function summary index into the bitcode, so that "
+        "lifted code can be linked with native code using ThinLTO. Lifted "
+        "functions and data sections keep their names, and are made hidden "
+        "instead of internal."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<int> CompressOutput(
+    "compress-output",
+    llvm::cl::desc(
+        "Compress the bitcode with zstd at this level (1-19) as it is "
+        "written. Chunks of the bitcode are compressed in parallel, into "
+        "independent zstd frames, and are written out in order by a "
+        "background thread. `zstd -d` decompresses the output, and -merge "
+        "reads compressed partial modules directly. Zero means no "
+        "compression."),
+    llvm::cl::init(0));
+
+static llvm::cl::opt<unsigned> CompressJobs(
+    "compress-jobs",
+    llvm::cl::desc(
+        "Number of threads that compress the output with -compress-output. "
+        "Zero uses one thread per core."),
+    llvm::cl::init(0));
+
+namespace {
+
+// Every zstd frame starts with these bytes.
+static const char kZstdMagic[] = {'\x28', '\xb5', '\x2f', '\xfd'};
+
+#ifdef MCSEMA_HAVE_ZSTD
+
+// Bytes of bitcode that are compressed into each zstd frame.
+static const size_t kCompressChunkSize = 4 << 20;
+
+// A stream that compresses everything written to it with zstd, and writes
+// the result to `out`. The stream is cut into chunks that are compressed by
+// a pool of threads, and a writer thread writes the compressed chunks to
+// `out` in order. Writes to the stream only block while too many chunks are
+// waiting to be compressed or written.
+class CompressedOutputStream : public llvm::raw_ostream {
+ public:
+  CompressedOutputStream(llvm::raw_ostream &out_, int level_,
+                         unsigned num_workers);
+  ~CompressedOutputStream(void) override;
+
+  // Compress and write out the rest of the stream, and wait for the
+  // threads to finish. Returns false if a chunk couldn't be compressed.
+  bool finish(void);
+
+ private:
+  CompressedOutputStream(void) = delete;
+
+  struct Chunk {
+    std::vector<char> data;
+    std::vector<char> compressed;
+    bool taken;
+    bool done;
+    bool ok;
+  };
+
+  void write_impl(const char *ptr, size_t size) override;
+  uint64_t current_pos(void) const override;
+
+  void SubmitChunk(void);
+  void CompressChunks(void);
+  void WriteChunks(void);
+
+  llvm::raw_ostream &out;
+  const int level;
+  uint64_t pos;
+  std::vector<char> pending;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::unique_ptr<Chunk>> chunks;
+  size_t max_chunks;
+  bool finished;
+  bool closed;
+  bool ok;
+
+  std::vector<std::thread> workers;
+  std::thread writer;
+};
+
+CompressedOutputStream::CompressedOutputStream(llvm::raw_ostream &out_,
+                                               int level_,
+                                               unsigned num_workers)
+    : out(out_),
+      level(level_),
+      pos(0),
+      max_chunks(2 * num_workers + 1),
+      finished(false),
+      closed(false),
+      ok(true) {
+  pending.reserve(kCompressChunkSize);
+  for (auto i = 0U; i < num_workers; ++i) {
+    workers.emplace_back(&CompressedOutputStream::CompressChunks, this);
+  }
+  writer = std::thread(&CompressedOutputStream::WriteChunks, this);
+}
+
+CompressedOutputStream::~CompressedOutputStream(void) {
+  finish();
+}
+
+bool CompressedOutputStream::finish(void) {
+  if (!closed) {
+    closed = true;
+    flush();
+    if (!pending.empty()) {
+      SubmitChunk();
+    }
+    {
+      std::lock_guard<std::mutex> locker(lock);
+      finished = true;
+    }
+    cv.notify_all();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    writer.join();
+    out.flush();
+  }
+  return ok;
+}
+
+void CompressedOutputStream::write_impl(const char *ptr, size_t size) {
+  pos += size;
+  while (size) {
+    auto num_bytes = std::min(size, kCompressChunkSize - pending.size());
+    pending.insert(pending.end(), ptr, ptr + num_bytes);
+    ptr += num_bytes;
+    size -= num_bytes;
+    if (kCompressChunkSize == pending.size()) {
+      SubmitChunk();
+    }
+  }
+}
+
+uint64_t CompressedOutputStream::current_pos(void) const {
+  return pos;
+}
+
+void CompressedOutputStream::SubmitChunk(void) {
+  std::unique_ptr<Chunk> chunk(new Chunk);
+  chunk->data.swap(pending);
+  chunk->taken = false;
+  chunk->done = false;
+  chunk->ok = true;
+  pending.reserve(kCompressChunkSize);
+
+  std::unique_lock<std::mutex> locker(lock);
+  cv.wait(locker, [this] (void) { return chunks.size() < max_chunks; });
+  chunks.push_back(std::move(chunk));
+  locker.unlock();
+  cv.notify_all();
+}
+
+void CompressedOutputStream::CompressChunks(void) {
+  std::unique_lock<std::mutex> locker(lock);
+  while (true) {
+    Chunk *chunk = nullptr;
+    cv.wait(locker, [this, &chunk] (void) {
+      for (const auto &c : chunks) {
+        if (!c->taken) {
+          chunk = c.get();
+          return true;
+        }
+      }
+      return finished;
+    });
+    if (!chunk) {
+      return;
+    }
+    chunk->taken = true;
+    locker.unlock();
+
+    chunk->compressed.resize(ZSTD_compressBound(chunk->data.size()));
+    auto size = ZSTD_compress(chunk->compressed.data(),
+                              chunk->compressed.size(), chunk->data.data(),
+                              chunk->data.size(), level);
+    if (ZSTD_isError(size)) {
+      std::cerr << "Could not compress the output: "
+                << ZSTD_getErrorName(size) << std::endl;
+      chunk->ok = false;
+    } else {
+      chunk->compressed.resize(size);
+    }
+    std::vector<char>().swap(chunk->data);
+
+    locker.lock();
+    chunk->done = true;
+    cv.notify_all();
+  }
+}
+
+void CompressedOutputStream::WriteChunks(void) {
+  std::unique_lock<std::mutex> locker(lock);
+  while (true) {
+    cv.wait(locker, [this] (void) {
+      return (!chunks.empty() && chunks.front()->done) ||
+             (finished && chunks.empty());
+    });
+    if (chunks.empty()) {
+      return;
+    }
+    auto chunk = std::move(chunks.front());
+    chunks.pop_front();
+    locker.unlock();
+    cv.notify_all();
+
+    if (chunk->ok) {
+      out.write(chunk->compressed.data(), chunk->compressed.size());
+    }
+
+    locker.lock();
+    ok = ok && chunk->ok;
+  }
+}
+
+// Returns the number of threads that compress the output.
+static unsigned NumCompressJobs(void) {
+  if (CompressJobs) {
+    return CompressJobs;
+  }
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+#endif  // MCSEMA_HAVE_ZSTD
+
+// Make the local functions and variables of `M` hidden instead. ThinLTO
+// renames the locals that it imports into other modules, which would
+// change the names of lifted functions and data sections.
+static void ExternalizeLocals(llvm::Module *M) {
+  auto externalize = [] (llvm::GlobalValue &GV) {
+    if (GV.hasLocalLinkage() && !GV.isDeclaration() && GV.hasName()) {
+      GV.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      GV.setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+  };
+  for (auto &F : *M) {
+    externalize(F);
+  }
+  for (auto &GV : M->globals()) {
+    externalize(GV);
+  }
+  for (auto &GA : M->aliases()) {
+    externalize(GA);
+  }
+}
+
+// Bitcode files index the bodies of their functions from the module-level
+// value symbol table, so consumers that use `getLazyBitcodeModule` only read
+// the bodies of the functions that they materialize.
+static bool WriteBitcode(const llvm::Module *M, const std::string &path) {
+  std::error_code ec;
+  llvm::tool_output_file out(path.c_str(), ec, llvm::sys::fs::F_None);
+  if (ec) {
+    std::cerr << "Could not open " << path << ": " << ec.message()
+              << std::endl;
+    return false;
+  }
+
+#ifdef MCSEMA_HAVE_ZSTD
+  if (CompressOutput) {
+    CompressedOutputStream zos(out.os(), CompressOutput, NumCompressJobs());
+    llvm::WriteBitcodeToFile(M, zos, false, ThinLTOSummary);
+    if (!zos.finish()) {
+      return false;
+    }
+    out.keep();
+    return true;
+  }
+#endif
+
+  llvm::WriteBitcodeToFile(M, out.os(), false, ThinLTOSummary);
+  out.keep();
+  return true;
+}
+
+// Split `M` into `SplitOutput` groups of functions and data, and write each
+// group to its own bitcode file. Functions and variables are assigned to
+// groups by the hash of their names, and internal ones are made hidden so
+// that the groups can reference each other. Linking all of the files back
+// together (e.g. with `llvm-link`) gives the whole module again.
+//
+// The manifest in `path` lists every file with a `part <file name>` line,
+// followed by a `function <name>` or `variable <name>` line for each
+// function or variable defined in that file. File names are relative to the
+// directory of the manifest.
+static bool WriteSplitModule(std::unique_ptr<llvm::Module> M,
+                             const std::string &path) {
+  if ("-" == path) {
+    std::cerr << "-split-output needs an output file name" << std::endl;
+    return false;
+  }
+
+  std::stringstream manifest;
+  auto ok = true;
+  auto part = 0U;
+  llvm::SplitModule(
+      std::move(M), SplitOutput,
+      [&] (std::unique_ptr<llvm::Module> MPart) {
+        std::stringstream ss;
+        ss << path << "." << part++ << ".bc";
+        auto part_path = ss.str();
+
+        manifest << "part " << llvm::sys::path::filename(part_path).str()
+                 << std::endl;
+        for (const auto &F : *MPart) {
+          if (!F.isDeclaration()) {
+            manifest << "function " << F.getName().str() << std::endl;
+          }
+        }
+        for (const auto &GV : MPart->globals()) {
+          if (!GV.isDeclaration()) {
+            manifest << "variable " << GV.getName().str() << std::endl;
+          }
+        }
+
+        ok = WriteBitcode(MPart.get(), part_path) && ok;
+      });
+
+  std::ofstream out(path, std::ios::out | std::ios::trunc);
+  out << manifest.str();
+  if (!out) {
+    std::cerr << "Could not write the manifest " << path << std::endl;
+    return false;
+  }
+  return ok;
+}
+
+// Returns the number of parts that code is generated for in parallel.
+static unsigned NumCodeGenParts(void) {
+  if (CodeGenJobs) {
+    return CodeGenJobs;
+  }
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+// Combine the relocatable objects in `part_paths` into the single
+// relocatable object `path`, with `ld -r`.
+static bool LinkObjects(const std::vector<std::string> &part_paths,
+                        const std::string &path) {
+  auto ld = llvm::sys::findProgramByName("ld");
+  if (!ld) {
+    std::cerr << "Could not find ld to combine the object files" << std::endl;
+    return false;
+  }
+
+  std::vector<const char *> args = {"ld", "-r", "-o", path.c_str()};
+  for (const auto &part_path : part_paths) {
+    args.push_back(part_path.c_str());
+  }
+  args.push_back(nullptr);
+
+  std::string errstr;
+  if (llvm::sys::ExecuteAndWait(ld.get(), args.data(), nullptr, nullptr, 0, 0,
+                                &errstr)) {
+    std::cerr << "Could not combine the object files into " << path;
+    if (!errstr.empty()) {
+      std::cerr << ": " << errstr;
+    }
+    std::cerr << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Append the assembly files in `part_paths` to `os`.
+static bool ConcatenateFiles(const std::vector<std::string> &part_paths,
+                             llvm::raw_ostream &os) {
+  for (const auto &part_path : part_paths) {
+    std::ifstream part(part_path, std::ios::in | std::ios::binary);
+    std::stringstream ss;
+    ss << part.rdbuf();
+    if (!part) {
+      std::cerr << "Could not read " << part_path << std::endl;
+      return false;
+    }
+    os << ss.str();
+  }
+  return true;
+}
+
+// Generate an object or assembly file for `M`, in-process. With more than
+// one codegen job, `M` is split like it is with `-split-output`, code is
+// generated for every part on its own thread, and then the parts are
+// combined.
+static bool WriteCode(std::unique_ptr<llvm::Module> M,
+                      const std::string &path) {
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllAsmPrinters();
+
+  std::string errstr;
+  if (!llvm::TargetRegistry::lookupTarget(M->getTargetTriple(), errstr)) {
+    std::cerr << "Can't find target for " << M->getTargetTriple() << ": "
+              << errstr << std::endl;
+    return false;
+  }
+
+  auto file_type = EmitObj ? llvm::TargetMachine::CGFT_ObjectFile :
+                             llvm::TargetMachine::CGFT_AssemblyFile;
+  auto open_flags = EmitObj ? llvm::sys::fs::F_None : llvm::sys::fs::F_Text;
+  llvm::TargetOptions options;
+
+  auto num_parts = NumCodeGenParts();
+  if (1 == num_parts) {
+    std::error_code ec;
+    llvm::tool_output_file out(path.c_str(), ec, open_flags);
+    if (ec) {
+      std::cerr << "Could not open " << path << ": " << ec.message()
+                << std::endl;
+      return false;
+    }
+    llvm::raw_pwrite_stream *os = &(out.os());
+    llvm::splitCodeGen(std::move(M), os, "", "", options,
+                       llvm::Reloc::Default, llvm::CodeModel::Default,
+                       llvm::CodeGenOpt::Default, file_type);
+    out.keep();
+    return true;
+  }
+
+  if (EmitObj && "-" == path) {
+    std::cerr << "-emit-obj with more than one codegen job needs an output "
+              << "file name" << std::endl;
+    return false;
+  }
+
+  // Generate the code of each part into a temporary file.
+  std::vector<std::string> part_paths;
+  std::vector<std::unique_ptr<llvm::raw_fd_ostream>> part_files;
+  std::vector<llvm::raw_pwrite_stream *> part_streams;
+  auto cleanup = [&part_files, &part_paths] (void) {
+    part_files.clear();
+    for (const auto &part_path : part_paths) {
+      llvm::sys::fs::remove(part_path);
+    }
+  };
+
+  for (auto i = 0U; i < num_parts; ++i) {
+    int fd = -1;
+    llvm::SmallString<128> part_path;
+    auto ec = llvm::sys::fs::createTemporaryFile(
+        "mcsema-part", EmitObj ? "o" : "s", fd, part_path);
+    if (ec) {
+      std::cerr << "Could not create a temporary file: " << ec.message()
+                << std::endl;
+      cleanup();
+      return false;
+    }
+    part_paths.push_back(part_path.str());
+    part_files.emplace_back(new llvm::raw_fd_ostream(fd, true));
+    part_streams.push_back(part_files.back().get());
+  }
+
+  llvm::splitCodeGen(std::move(M), part_streams, "", "", options,
+                     llvm::Reloc::Default, llvm::CodeModel::Default,
+                     llvm::CodeGenOpt::Default, file_type);
+  part_files.clear();
+
+  auto ok = false;
+  if (EmitObj) {
+    ok = LinkObjects(part_paths, path);
+
+  } else {
+    std::error_code ec;
+    llvm::tool_output_file out(path.c_str(), ec, open_flags);
+    if (ec) {
+      std::cerr << "Could not open " << path << ": " << ec.message()
+                << std::endl;
+    } else if (ConcatenateFiles(part_paths, out.os())) {
+      out.keep();
+      ok = true;
+    }
+  }
+
+  cleanup();
+  return ok;
+}
+
+}  // namespace
+
+bool WriteLiftedModule(std::unique_ptr<llvm::Module> M,
+                       const std::string &path) {
+  if (EmitObj && EmitAsm) {
+    std::cerr << "Only one of -emit-obj and -emit-asm can be used"
+              << std::endl;
+    return false;
+  }
+
+#ifndef MCSEMA_HAVE_ZSTD
+  if (CompressOutput) {
+    std::cerr << "-compress-output needs mcsema-lift to be built with zstd"
+              << std::endl;
+    return false;
+  }
+#endif
+
+  if (EmitObj || EmitAsm) {
+    if (SplitOutput || ThinLTOSummary || CompressOutput) {
+      std::cerr << "-split-output, -thinlto-summary and -compress-output "
+                << "can't be used with -emit-obj or -emit-asm" << std::endl;
+      return false;
+    }
+    return WriteCode(std::move(M), path);
+  }
+
+  if (ThinLTOSummary) {
+    ExternalizeLocals(M.get());
+  }
+
+  if (SplitOutput) {
+    return WriteSplitModule(std::move(M), path);
+  }
+  return WriteBitcode(M.get(), path);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ReadBitcodeFile(const std::string &path,
+                                                    std::string &error) {
+  auto buff = llvm::MemoryBuffer::getFile(path);
+  if (!buff) {
+    error = buff.getError().message();
+    return nullptr;
+  }
+
+  auto bytes = buff.get()->getBuffer();
+  if (bytes.size() < sizeof(kZstdMagic) ||
+      memcmp(bytes.data(), kZstdMagic, sizeof(kZstdMagic))) {
+    return std::move(buff.get());
+  }
+
+#ifdef MCSEMA_HAVE_ZSTD
+  std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream *)> stream(
+      ZSTD_createDStream(), ZSTD_freeDStream);
+  ZSTD_initDStream(stream.get());
+
+  // The output is a sequence of frames, one per compressed chunk.
+  std::vector<char> data;
+  std::vector<char> out_buff(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer in = {bytes.data(), bytes.size(), 0};
+  for (size_t ret = 1; in.pos < in.size || ret; ) {
+    ZSTD_outBuffer out = {out_buff.data(), out_buff.size(), 0};
+    ret = ZSTD_decompressStream(stream.get(), &out, &in);
+    if (ZSTD_isError(ret)) {
+      error = ZSTD_getErrorName(ret);
+      return nullptr;
+    }
+    if (ret && in.pos == in.size && !out.pos) {
+      error = "truncated zstd frame";
+      return nullptr;
+    }
+    data.insert(data.end(), out_buff.data(), out_buff.data() + out.pos);
+    if (!ret && in.pos < in.size) {
+      ZSTD_initDStream(stream.get());
+    }
+  }
+  return llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(data.data(), data.size()), path);
+#else
+  error = "it is compressed with zstd, and mcsema-lift was built without zstd";
+  return nullptr;
+#endif
+}
@@ -0,0 +1,58 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_OUTPUT_H_
+#define MCSEMA_BC_OUTPUT_H_
+
+#include <memory>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+class Module;
+}  // namespace llvm
+
+// Write the lifted module `M` to `path`. With `-split-output=<N>`, the
+// module is split into `N` bitcode files, `<path>.<i>.bc`, and `path` is a
+// manifest that says which file defines each function. With `-emit-obj` or
+// `-emit-asm`, code is generated for the module instead. With
+// `-thinlto-summary`, the bitcode includes a ThinLTO summary index. With
+// `-compress-output`, bitcode files are compressed with zstd as they are
+// written.
+bool WriteLiftedModule(std::unique_ptr<llvm::Module> M,
+                       const std::string &path);
+
+// Read the bitcode file `path`, and decompress it if it was written with
+// `-compress-output`. Returns `nullptr`, with the reason in `error`, if the
+// file can't be read.
+std::unique_ptr<llvm::MemoryBuffer> ReadBitcodeFile(const std::string &path,
+                                                    std::string &error);
+
+#endif  // MCSEMA_BC_OUTPUT_H_
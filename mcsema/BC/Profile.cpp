@@ -0,0 +1,309 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/Support/CommandLine.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/BC/Profile.h"
+#include "mcsema/CFG/CFG.h"
+#include "mcsema/cfgToLLVM/TransExcn.h"
+
+static llvm::cl::opt<std::string> ProfilePath(
+    "profile",
+    llvm::cl::desc(
+        "Execution profile to lift with, e.g. from -add-block-counters or "
+        "from converted perf samples. Each line is a hex native address and "
+        "a decimal count; the counts of all addresses inside a block are "
+        "added up. Used for branch weights, function entry counts, hot and "
+        "cold functions, and the order of functions in the module."),
+    llvm::cl::value_desc("<file>"),
+    llvm::cl::init(""));
+
+namespace {
+
+// Blocks with the highest counts that together account for this fraction of
+// all counts are hot.
+static const double kHotFraction = 0.9;
+
+// Chains of lifter-created blocks are followed this far when looking for the
+// native block that a branch goes to.
+static const unsigned kMaxForwardedBlocks = 8;
+
+static std::once_flag gProfileOnce;
+static std::map<VA, uint64_t> gCounts;
+static uint64_t gHotCount = std::numeric_limits<uint64_t>::max();
+static uint64_t gDigest = 0;
+
+static void LoadProfile(void) {
+  if (ProfilePath.empty()) {
+    return;
+  }
+
+  std::ifstream in(ProfilePath);
+  if (!in) {
+    throw TErr(__LINE__, __FILE__, "Could not open profile " + ProfilePath);
+  }
+
+  std::string line;
+  for (unsigned line_num = 1; std::getline(in, line); ++line_num) {
+    auto comment = line.find('#');
+    if (std::string::npos != comment) {
+      line.resize(comment);
+    }
+
+    std::stringstream ss(line);
+    std::string va_str;
+    if (!(ss >> va_str)) {
+      continue;
+    }
+
+    VA va = 0;
+    uint64_t count = 0;
+    try {
+      va = std::stoull(va_str, nullptr, 16);
+    } catch (const std::exception &) {
+      ss.setstate(std::ios::failbit);
+    }
+    if (!(ss >> count)) {
+      std::stringstream err;
+      err << "Malformed line " << line_num << " in profile " << ProfilePath;
+      throw TErr(__LINE__, __FILE__, err.str());
+    }
+    gCounts[va] += count;
+  }
+
+  // FNV-1a over the merged counts.
+  gDigest = 14695981039346656037ULL;
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+  for (const auto &entry : gCounts) {
+    gDigest = (gDigest ^ entry.first) * 1099511628211ULL;
+    gDigest = (gDigest ^ entry.second) * 1099511628211ULL;
+    counts.push_back(entry.second);
+    total += entry.second;
+  }
+
+  std::sort(counts.begin(), counts.end(), std::greater<uint64_t>());
+  uint64_t covered = 0;
+  for (auto count : counts) {
+    if (!count || covered >= total * kHotFraction) {
+      break;
+    }
+    covered += count;
+    gHotCount = count;
+  }
+
+  std::cerr << "Loaded " << gCounts.size() << " profile counts from "
+            << ProfilePath << std::endl;
+}
+
+// Finds the count of the native block that `B` is, or that `B` goes to.
+static bool GetSuccessorCount(
+    llvm::BasicBlock *B,
+    const std::unordered_map<llvm::BasicBlock *, uint64_t> &counts,
+    uint64_t &count) {
+  for (unsigned i = 0; B && i <= kMaxForwardedBlocks; ++i) {
+    auto it = counts.find(B);
+    if (it != counts.end()) {
+      count = it->second;
+      return true;
+    }
+    B = B->getSingleSuccessor();
+  }
+  count = 0;
+  return false;
+}
+
+static void AddBranchWeights(
+    llvm::Function *F,
+    const std::unordered_map<llvm::BasicBlock *, uint64_t> &counts) {
+  llvm::MDBuilder mdb(F->getContext());
+  for (auto &B : *F) {
+    auto term = B.getTerminator();
+    if (!term) {
+      continue;
+    }
+    auto br = llvm::dyn_cast<llvm::BranchInst>(term);
+    if (!(br && br->isConditional()) && !llvm::isa<llvm::SwitchInst>(term)) {
+      continue;
+    }
+
+    std::vector<uint64_t> succ_counts;
+    auto known = false;
+    uint64_t max_count = 0;
+    for (unsigned i = 0; i < term->getNumSuccessors(); ++i) {
+      uint64_t count = 0;
+      known = GetSuccessorCount(term->getSuccessor(i), counts, count) || known;
+      succ_counts.push_back(count);
+      max_count = std::max(max_count, count);
+    }
+    if (!known) {
+      continue;
+    }
+
+    // Branch weights are 32 bits; scale the counts down to fit.
+    unsigned shift = 0;
+    while ((max_count >> shift) >= std::numeric_limits<uint32_t>::max()) {
+      ++shift;
+    }
+    std::vector<uint32_t> weights;
+    for (auto count : succ_counts) {
+      weights.push_back(static_cast<uint32_t>(count >> shift) + 1);
+    }
+    term->setMetadata(llvm::LLVMContext::MD_prof,
+                      mdb.createBranchWeights(weights));
+  }
+}
+
+}  // namespace
+
+bool ProfileEnabled(void) {
+  return !ProfilePath.empty();
+}
+
+void InitProfile(void) {
+  std::call_once(gProfileOnce, LoadProfile);
+}
+
+uint64_t ProfileDigest(void) {
+  return gDigest;
+}
+
+uint64_t ProfileBlockCount(NativeBlockPtr block) {
+  VA begin = block->get_base();
+  VA end = begin + 1;
+  const auto &insts = block->get_insts();
+  if (!insts.empty()) {
+    end = insts.back()->get_loc() + insts.back()->get_len();
+  }
+
+  uint64_t count = 0;
+  for (auto it = gCounts.lower_bound(begin);
+       it != gCounts.end() && it->first < end; ++it) {
+    count += it->second;
+  }
+  return count;
+}
+
+bool ProfileCountIsHot(uint64_t count) {
+  return count && count >= gHotCount;
+}
+
+void ApplyProfile(NativeFunctionPtr func, llvm::Function *F,
+                  const std::unordered_map<VA, llvm::BasicBlock *> &va_to_bb) {
+  if (!ProfileEnabled()) {
+    return;
+  }
+
+  std::unordered_map<llvm::BasicBlock *, uint64_t> counts;
+  uint64_t max_count = 0;
+  for (const auto &block : func->get_blocks()) {
+    auto bb_it = va_to_bb.find(block.first);
+    if (bb_it != va_to_bb.end()) {
+      auto count = ProfileBlockCount(block.second);
+      counts[bb_it->second] = count;
+      max_count = std::max(max_count, count);
+    }
+  }
+
+  AddBranchWeights(F, counts);
+
+  auto entry_it = va_to_bb.find(func->get_start());
+  if (entry_it != va_to_bb.end()) {
+    F->setEntryCount(counts[entry_it->second]);
+  }
+
+  auto is_elf = llvm::Triple::Linux == SystemOS(F->getParent());
+  if (!max_count) {
+    F->addFnAttr(llvm::Attribute::Cold);
+    F->addFnAttr(llvm::Attribute::OptimizeForSize);
+    if (is_elf) {
+      F->setSection(".text.unlikely");
+    }
+  } else if (max_count >= gHotCount && is_elf) {
+    F->setSection(".text.hot");
+  }
+}
+
+void OrderFunctionsByProfile(llvm::Module *M) {
+  if (!ProfileEnabled()) {
+    return;
+  }
+
+  std::vector<std::pair<uint64_t, llvm::Function *>> hot;
+  std::vector<llvm::Function *> cold;
+  for (auto &F : *M) {
+    auto entry_count = F.getEntryCount();
+    if (F.isDeclaration() || !entry_count) {
+      continue;
+    }
+    if (F.hasFnAttribute(llvm::Attribute::Cold)) {
+      cold.push_back(&F);
+    } else {
+      hot.push_back({entry_count.getValue(), &F});
+    }
+  }
+
+  std::stable_sort(hot.begin(), hot.end(),
+                   [] (const std::pair<uint64_t, llvm::Function *> &a,
+                       const std::pair<uint64_t, llvm::Function *> &b) {
+                     return a.first > b.first;
+                   });
+
+  auto &funcs = M->getFunctionList();
+  for (auto it = hot.rbegin(); it != hot.rend(); ++it) {
+    funcs.splice(funcs.begin(), funcs, it->second->getIterator());
+  }
+  for (auto F : cold) {
+    funcs.splice(funcs.end(), funcs, F->getIterator());
+  }
+}
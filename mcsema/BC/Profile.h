@@ -0,0 +1,78 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_PROFILE_H_
+#define MCSEMA_BC_PROFILE_H_
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "mcsema/CFG/CFG.h"
+
+namespace llvm {
+
+class BasicBlock;
+class Function;
+class Module;
+
+}  // namespace llvm
+
+// Returns true if an execution profile was given with `-profile`.
+bool ProfileEnabled(void);
+
+// Reads the profile given with `-profile`, if any. Only the first call does
+// anything. Throws a `TErr` if the profile can't be read.
+void InitProfile(void);
+
+// Returns a digest of the profile, for keying lifted functions in the lift
+// cache.
+uint64_t ProfileDigest(void);
+
+// Returns the execution count of `block`, i.e. the sum of the counts of the
+// addresses inside it.
+uint64_t ProfileBlockCount(NativeBlockPtr block);
+
+// Returns true if `count` is one of the highest block counts, that together
+// account for most of the counts in the profile.
+bool ProfileCountIsHot(uint64_t count);
+
+// Attaches branch weights to the conditional branches and switches of the
+// lifted function `F`, and sets its entry count, based on the execution
+// counts of the native blocks of `func`. Functions that never ran are marked
+// `cold`, and on ELF targets, hot and cold functions are put into the
+// `.text.hot` and `.text.unlikely` sections.
+void ApplyProfile(NativeFunctionPtr func, llvm::Function *F,
+                  const std::unordered_map<VA, llvm::BasicBlock *> &va_to_bb);
+
+// Moves the lifted functions of `M` with a profile into order of decreasing
+// entry count, with the cold functions last.
+void OrderFunctionsByProfile(llvm::Module *M);
+
+#endif  // MCSEMA_BC_PROFILE_H_
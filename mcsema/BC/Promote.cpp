@@ -0,0 +1,192 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+
+#include "mcsema/Arch/Register.h"
+#include "mcsema/BC/Promote.h"
+#include "mcsema/BC/Util.h"
+
+namespace {
+
+struct PromotedReg {
+  llvm::GetElementPtrInst *state_var;
+  llvm::AllocaInst *local_var;
+  bool is_written;
+};
+
+// Find out if the register variable `var` is read or written. Returns false
+// if the address of the register escapes, or is used in a way that can't be
+// moved to an `alloca`.
+static bool GetRegAccesses(llvm::Value *var, bool &is_read, bool &is_written) {
+  std::vector<llvm::Value *> work_list = {var};
+  while (!work_list.empty()) {
+    auto val = work_list.back();
+    work_list.pop_back();
+
+    for (auto user : val->users()) {
+      if (llvm::isa<llvm::BitCastInst>(user) ||
+          llvm::isa<llvm::GetElementPtrInst>(user)) {
+        work_list.push_back(user);
+
+      } else if (auto load = llvm::dyn_cast<llvm::LoadInst>(user)) {
+        if (load->isVolatile()) {
+          return false;
+        }
+        is_read = true;
+
+      } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+        if (store->isVolatile() || store->getValueOperand() == val) {
+          return false;
+        }
+        is_written = true;
+
+      } else {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void PromoteRegisterVars(llvm::Function *F, const RegisterTable *regs) {
+  auto state_ptr = &*F->arg_begin();
+  auto &entry = F->getEntryBlock();
+
+  std::unordered_set<llvm::Value *> reg_vars;
+  for (auto var : regs->write) {
+    auto gep = llvm::dyn_cast_or_null<llvm::GetElementPtrInst>(var);
+    if (gep && gep->getPointerOperand() == state_ptr) {
+      reg_vars.insert(gep);
+    }
+  }
+
+  // Some semantics (e.g. external calls) access the state structure directly,
+  // rather than through the register variables. Those fields have to stay
+  // in the state structure. Calls see the state structure after it has been
+  // synchronized, so they can take the state pointer.
+  std::unordered_set<int64_t> direct_fields;
+  for (auto user : state_ptr->users()) {
+    if (reg_vars.count(user)) {
+      continue;
+    } else if (auto gep = llvm::dyn_cast<llvm::GetElementPtrInst>(user)) {
+      auto field = GetStateFieldIndex(gep);
+      if (0 > field) {
+        return;
+      }
+      direct_fields.insert(field);
+    } else if (!llvm::isa<llvm::CallInst>(user)) {
+      return;
+    }
+  }
+
+  std::vector<PromotedReg> promoted;
+  auto alloca_pt = &*entry.getFirstInsertionPt();
+  auto copy_in_pt = entry.getTerminator();
+  for (auto var : regs->write) {
+    if (!reg_vars.erase(var)) {
+      continue;
+    }
+
+    auto gep = llvm::cast<llvm::GetElementPtrInst>(var);
+    auto field = GetStateFieldIndex(gep);
+    if (0 > field || direct_fields.count(field)) {
+      continue;
+    }
+
+    auto is_read = false;
+    auto is_written = false;
+    if (!GetRegAccesses(gep, is_read, is_written) ||
+        (!is_read && !is_written)) {
+      continue;
+    }
+
+    auto local_var = new llvm::AllocaInst(
+        gep->getResultElementType(), gep->getName() + "_local", alloca_pt);
+    gep->replaceAllUsesWith(local_var);
+
+    auto val = new llvm::LoadInst(gep, "", copy_in_pt);
+    new llvm::StoreInst(val, local_var, copy_in_pt);
+
+    promoted.push_back({gep, local_var, is_written});
+  }
+
+  if (promoted.empty()) {
+    return;
+  }
+
+  std::vector<llvm::Instruction *> sync_points;
+  for (auto &B : *F) {
+    for (auto &I : B) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&I);
+      if ((call && IsStateSyncPoint(call)) || llvm::isa<llvm::ReturnInst>(&I)) {
+        sync_points.push_back(&I);
+      }
+    }
+  }
+
+  for (auto inst : sync_points) {
+
+    // A guaranteed tail call has to be followed by the return. The registers
+    // are spilled before the call, and the callee leaves them in the state
+    // structure for our caller.
+    auto call = llvm::dyn_cast<llvm::CallInst>(inst);
+    auto prev_call = llvm::dyn_cast_or_null<llvm::CallInst>(
+        inst->getPrevNode());
+    if (llvm::isa<llvm::ReturnInst>(inst) && prev_call &&
+        prev_call->isMustTailCall()) {
+      continue;
+    }
+
+    // Spill the registers that the function changes.
+    for (const auto &reg : promoted) {
+      if (reg.is_written) {
+        auto val = new llvm::LoadInst(reg.local_var, "", inst);
+        new llvm::StoreInst(val, reg.state_var, inst);
+      }
+    }
+
+    // Reload every register after a call, in case the callee changed it.
+    if (call && !call->isMustTailCall()) {
+      auto reload_pt = inst->getNextNode();
+      for (const auto &reg : promoted) {
+        auto val = new llvm::LoadInst(reg.state_var, "", reload_pt);
+        new llvm::StoreInst(val, reg.local_var, reload_pt);
+      }
+    }
+  }
+}
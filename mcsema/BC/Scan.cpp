@@ -0,0 +1,215 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/BC/Scan.h"
+
+namespace {
+
+// Seconds to lift one instruction of each opcode, from `LoadOpcodeCosts`.
+static std::unordered_map<unsigned, double> gOpcodeCosts;
+
+// Seconds to lift an instruction whose opcode has no cost of its own.
+static double gDefaultCost = 0;
+
+struct UnsupportedInst {
+  VA addr;
+  unsigned opcode;
+  std::string func_name;
+};
+
+struct FunctionCost {
+  std::string name;
+  VA addr;
+  size_t num_blocks;
+  size_t num_insts;
+  double cost;
+};
+
+// Finds the number after `"key": ` in `line`.
+static bool GetNumber(const std::string &line, const char *key,
+                      double &number) {
+  auto pos = line.find(std::string("\"") + key + "\": ");
+  if (std::string::npos == pos) {
+    return false;
+  }
+  try {
+    number = std::stod(line.substr(pos + strlen(key) + 4));
+  } catch (const std::exception &) {
+    return false;
+  }
+  return true;
+}
+
+static void ScanFunction(NativeFunctionPtr func,
+                         std::unordered_map<unsigned, uint64_t> &histogram,
+                         std::vector<UnsupportedInst> &unsupported,
+                         std::vector<FunctionCost> &costs) {
+  FunctionCost func_cost = {func->get_name(), func->get_start(), 0, 0, 0};
+  for (const auto &block_info : func->get_blocks()) {
+    ++func_cost.num_blocks;
+    for (auto inst : block_info.second->get_insts()) {
+      auto opcode = inst->get_inst().getOpcode();
+      ++histogram[opcode];
+      ++func_cost.num_insts;
+
+      if (!ArchHasInstructionLifter(opcode)) {
+        unsupported.push_back({inst->get_loc(), opcode, func->get_name()});
+      } else if (gOpcodeCosts.empty()) {
+        func_cost.cost += 1;
+      } else {
+        auto cost_it = gOpcodeCosts.find(opcode);
+        func_cost.cost += cost_it != gOpcodeCosts.end() ? cost_it->second :
+                                                          gDefaultCost;
+      }
+    }
+  }
+  costs.push_back(func_cost);
+}
+
+}  // namespace
+
+bool LoadOpcodeCosts(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Could not open opcode costs " << path << std::endl;
+    return false;
+  }
+
+  // `WriteLiftStats` puts each opcode on a line of its own.
+  double total_seconds = 0;
+  double total_count = 0;
+  for (std::string line; std::getline(in, line); ) {
+    double opcode = 0;
+    double count = 0;
+    double seconds = 0;
+    if (GetNumber(line, "opcode", opcode) &&
+        GetNumber(line, "count", count) &&
+        GetNumber(line, "lift_seconds", seconds) && count) {
+      gOpcodeCosts[static_cast<unsigned>(opcode)] = seconds / count;
+      total_seconds += seconds;
+      total_count += count;
+    }
+  }
+
+  if (total_count) {
+    gDefaultCost = total_seconds / total_count;
+  }
+  std::cerr << "Loaded lift costs of " << gOpcodeCosts.size()
+            << " opcodes from " << path << std::endl;
+  return true;
+}
+
+bool ScanModule(NativeModulePtr mod, std::ostream &os) {
+  std::unordered_map<unsigned, uint64_t> histogram;
+  std::vector<UnsupportedInst> unsupported;
+  std::vector<FunctionCost> costs;
+
+  auto scan = [&] (NativeFunctionPtr func) {
+    ScanFunction(func, histogram, unsupported, costs);
+    return true;
+  };
+
+  auto read = true;
+  if (mod->is_streamed()) {
+    read = StreamProtoBufFunctions(mod, scan);
+  } else {
+    for (auto &func_info : mod->get_funcs()) {
+      scan(func_info.second);
+    }
+  }
+
+  std::sort(unsupported.begin(), unsupported.end(),
+            [] (const UnsupportedInst &a, const UnsupportedInst &b) {
+              return a.addr < b.addr;
+            });
+
+  std::vector<std::pair<unsigned, uint64_t>> opcodes(histogram.begin(),
+                                                     histogram.end());
+  std::sort(opcodes.begin(), opcodes.end(),
+            [] (const std::pair<unsigned, uint64_t> &a,
+                const std::pair<unsigned, uint64_t> &b) {
+              return a.second > b.second ||
+                     (a.second == b.second && a.first < b.first);
+            });
+
+  std::sort(costs.begin(), costs.end(),
+            [] (const FunctionCost &a, const FunctionCost &b) {
+              return a.cost > b.cost;
+            });
+
+  os << "Unsupported instructions: " << unsupported.size() << std::endl;
+  for (const auto &inst : unsupported) {
+    os << "  " << std::hex << inst.addr << std::dec << " "
+       << ArchInstructionName(inst.opcode) << " (opcode " << inst.opcode
+       << ") in " << inst.func_name << std::endl;
+  }
+
+  os << std::endl << "Opcodes:" << std::endl;
+  for (const auto &opcode_count : opcodes) {
+    os << "  " << std::setw(10) << opcode_count.second << " "
+       << ArchInstructionName(opcode_count.first);
+    if (!ArchHasInstructionLifter(opcode_count.first)) {
+      os << " (unsupported)";
+    }
+    os << std::endl;
+  }
+
+  auto unit = gOpcodeCosts.empty() ? "instructions" : "seconds";
+  double total_cost = 0;
+  for (const auto &func_cost : costs) {
+    total_cost += func_cost.cost;
+  }
+
+  os << std::endl << "Estimated lift cost: " << total_cost << " " << unit
+     << std::endl;
+  for (const auto &func_cost : costs) {
+    os << "  " << std::setw(12) << func_cost.cost << " " << func_cost.name
+       << " (" << std::hex << func_cost.addr << std::dec << ", "
+       << func_cost.num_blocks << " blocks, " << func_cost.num_insts
+       << " instructions)" << std::endl;
+  }
+
+  if (!read) {
+    std::cerr << "Could not read every function of the CFG" << std::endl;
+  }
+  return read && unsupported.empty();
+}
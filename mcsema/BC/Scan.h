@@ -0,0 +1,53 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_SCAN_H_
+#define MCSEMA_BC_SCAN_H_
+
+#include <ostream>
+#include <string>
+
+#include "mcsema/CFG/CFG.h"
+
+// Reads the lift time of each opcode from the "opcodes" of a `-stats-json`
+// file, to estimate lift costs with in `ScanModule`. Returns false if the
+// file can't be read.
+bool LoadOpcodeCosts(const std::string &path);
+
+// Checks every instruction of `mod` against the instruction lifters, without
+// lifting anything, and writes a report to `os`: the instructions that have
+// no lifter, with their addresses, a histogram of the opcodes, and the
+// estimated lift cost of each function. The cost is in seconds if opcode
+// costs were loaded, and in instructions otherwise. Functions of streamed
+// modules are read one at a time. Returns false if the CFG can't be read or
+// if an instruction has no lifter.
+bool ScanModule(NativeModulePtr mod, std::ostream &os);
+
+#endif  // MCSEMA_BC_SCAN_H_
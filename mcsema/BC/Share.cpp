@@ -0,0 +1,235 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include "mcsema/BC/Share.h"
+
+namespace {
+
+using BlockCopies = std::vector<std::pair<NativeFunctionPtr, NativeBlockPtr>>;
+
+static bool SameReference(NativeInstPtr a, NativeInstPtr b,
+                          NativeInst::CFGOpType op) {
+  if (a->has_reference(op) != b->has_reference(op)) {
+    return false;
+  }
+  return !a->has_reference(op) ||
+         (a->get_reference(op) == b->get_reference(op) &&
+          a->get_ref_type(op) == b->get_ref_type(op) &&
+          a->get_reloc_offset(op) == b->get_reloc_offset(op));
+}
+
+// Returns true if `a` and `b` are copies of the same native instruction,
+// and were given the same targets and references by the disassembler.
+static bool SameInst(NativeInstPtr a, NativeInstPtr b) {
+  if (a->get_loc() != b->get_loc() || a->get_len() != b->get_len() ||
+      a->get_opcode() != b->get_opcode() ||
+      a->get_prefix() != b->get_prefix() ||
+      a->get_tr() != b->get_tr() || a->get_fa() != b->get_fa() ||
+      a->has_call_tgt() != b->has_call_tgt() ||
+      a->get_ext_call_target() != b->get_ext_call_target() ||
+      a->get_ext_data_ref() != b->get_ext_data_ref() ||
+      a->get_system_call_number() != b->get_system_call_number() ||
+      a->has_local_noreturn() != b->has_local_noreturn() ||
+      a->has_rip_relative() != b->has_rip_relative() ||
+      a->offset_table != b->offset_table) {
+    return false;
+  }
+  if (a->has_call_tgt() && a->get_call_tgt(0) != b->get_call_tgt(0)) {
+    return false;
+  }
+  if (a->has_rip_relative() && a->get_rip_relative() != b->get_rip_relative()) {
+    return false;
+  }
+  return SameReference(a, b, NativeInst::IMMRef) &&
+         SameReference(a, b, NativeInst::MEMRef);
+}
+
+// Returns true if every copy of a block is the same. Blocks with jump tables
+// are never shared, because the tables are lowered against the blocks of the
+// function that contains them.
+static bool SameBlocks(const BlockCopies &copies) {
+  auto first = copies.front().second;
+  for (auto inst : first->get_insts()) {
+    if (inst->has_jump_table() || inst->has_jump_index_table()) {
+      return false;
+    }
+  }
+
+  for (const auto &copy : copies) {
+    auto block = copy.second;
+    if (block == first) {
+      continue;
+    }
+    const auto &insts = block->get_insts();
+    const auto &first_insts = first->get_insts();
+    if (insts.size() != first_insts.size() ||
+        block->get_follows() != first->get_follows()) {
+      return false;
+    }
+    for (size_t i = 0; i < insts.size(); ++i) {
+      if (!SameInst(insts[i], first_insts[i])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+SharedBlocks::SharedBlocks(NativeModulePtr mod)
+    : num_duplicate_insts(0) {
+  std::map<VA, BlockCopies> copies;
+  for (const auto &func_info : mod->get_funcs()) {
+    for (const auto &block_info : func_info.second->get_blocks()) {
+      copies[block_info.first].emplace_back(func_info.second,
+                                            block_info.second);
+    }
+  }
+
+  // The first copy of a block is the one in the function with the lowest
+  // address, so that the same copy is lifted on every run.
+  std::set<VA> candidates;
+  for (auto &copy_info : copies) {
+    auto &block_copies = copy_info.second;
+    if (2 > block_copies.size() || mod->get_funcs().count(copy_info.first)) {
+      continue;
+    }
+    std::sort(block_copies.begin(), block_copies.end(),
+              [] (const BlockCopies::value_type &a,
+                  const BlockCopies::value_type &b) {
+                return a.first->get_start() < b.first->get_start();
+              });
+    if (SameBlocks(block_copies)) {
+      candidates.insert(copy_info.first);
+    }
+  }
+
+  // Drop the blocks that can reach a block that isn't shared.
+  std::unordered_map<VA, std::vector<VA>> preds;
+  std::vector<VA> work_list;
+  for (auto va : candidates) {
+    for (auto succ : copies[va].front().second->get_follows()) {
+      preds[succ].push_back(va);
+      if (!candidates.count(succ)) {
+        work_list.push_back(va);
+      }
+    }
+  }
+  while (!work_list.empty()) {
+    auto va = work_list.back();
+    work_list.pop_back();
+    if (candidates.erase(va)) {
+      for (auto pred : preds[va]) {
+        work_list.push_back(pred);
+      }
+    }
+  }
+
+  // A shared block starts its own tail if it is entered from a block that
+  // isn't shared, or from more than one shared block. Every other shared
+  // block belongs to the tail of its only predecessor.
+  std::unordered_set<VA> entered;
+  std::unordered_map<VA, std::set<VA>> shared_preds;
+  for (const auto &copy_info : copies) {
+    auto is_candidate = candidates.count(copy_info.first);
+    for (const auto &copy : copy_info.second) {
+      for (auto succ : copy.second->get_follows()) {
+        if (!candidates.count(succ)) {
+          continue;
+        } else if (is_candidate) {
+          shared_preds[succ].insert(copy_info.first);
+        } else {
+          entered.insert(succ);
+        }
+      }
+    }
+  }
+
+  auto is_head = [&] (VA va) {
+    return entered.count(va) || 1 != shared_preds[va].size();
+  };
+
+  for (auto head : candidates) {
+    if (!is_head(head)) {
+      continue;
+    }
+
+    SharedTail tail;
+    tail.head = head;
+    tail.donor = copies[head].front().first;
+    std::stringstream ss;
+    ss << "tail_" << std::hex << head;
+    tail.name = ss.str();
+
+    std::vector<VA> to_visit = {head};
+    shared.insert(head);
+    while (!to_visit.empty()) {
+      auto va = to_visit.back();
+      to_visit.pop_back();
+      auto block = tail.donor->block_from_base(va);
+      tail.blocks.push_back(block);
+      num_duplicate_insts += (copies[va].size() - 1) *
+                             block->get_insts().size();
+      for (auto succ : block->get_follows()) {
+        if (candidates.count(succ) && !is_head(succ) &&
+            shared.insert(succ).second) {
+          to_visit.push_back(succ);
+        }
+      }
+    }
+
+    tail_index[head] = tails.size();
+    tails.push_back(std::move(tail));
+  }
+}
+
+const std::vector<SharedTail> &SharedBlocks::get_tails(void) const {
+  return tails;
+}
+
+const SharedTail *SharedBlocks::get_tail(VA va) const {
+  auto it = tail_index.find(va);
+  return it == tail_index.end() ? nullptr : &(tails[it->second]);
+}
+
+bool SharedBlocks::is_shared(VA va) const {
+  return 0 != shared.count(va);
+}
+
+size_t SharedBlocks::get_num_duplicate_insts(void) const {
+  return num_duplicate_insts;
+}
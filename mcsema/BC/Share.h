@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_SHARE_H_
+#define MCSEMA_BC_SHARE_H_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "mcsema/CFG/CFG.h"
+
+// A group of native blocks that appear, with the same instructions and
+// successors, in more than one function, e.g. a shared epilogue or a
+// cold-split path. It is lifted once, into its own function, and every
+// branch to its head block becomes a tail call to that function.
+struct SharedTail {
+  VA head;
+
+  // The function whose copies of `blocks` are lifted. The blocks are only
+  // valid until `donor` releases its blocks.
+  NativeFunctionPtr donor;
+
+  // The head block first, then the blocks that are only reached through it.
+  std::vector<NativeBlockPtr> blocks;
+
+  std::string name;
+};
+
+// Finds the blocks that are shared between the functions of a module. A
+// block is only shared if all of its successors are shared too, so that a
+// shared tail never branches back into one of the functions that use it,
+// and only tail-calls other shared tails.
+class SharedBlocks {
+ public:
+  explicit SharedBlocks(NativeModulePtr mod);
+
+  const std::vector<SharedTail> &get_tails(void) const;
+
+  // Returns the shared tail whose head block is at `va`, or `nullptr`.
+  const SharedTail *get_tail(VA va) const;
+
+  // Returns true if the block at `va` is lifted into a shared tail rather
+  // than into the functions that contain it.
+  bool is_shared(VA va) const;
+
+  // The number of instructions that would have been lifted more than once.
+  size_t get_num_duplicate_insts(void) const;
+
+ private:
+  std::vector<SharedTail> tails;
+  std::unordered_map<VA, size_t> tail_index;
+  std::unordered_set<VA> shared;
+  size_t num_duplicate_insts;
+};
+
+#endif  // MCSEMA_BC_SHARE_H_
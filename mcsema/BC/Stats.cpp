@@ -0,0 +1,361 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+# include <sys/resource.h>
+# include <unistd.h>
+#endif
+
+#include <llvm/Support/Timer.h>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
+#include "mcsema/BC/Stats.h"
+
+namespace {
+
+struct PhaseStats {
+  std::string name;
+  double wall_seconds;
+  double cpu_seconds;
+  uint64_t rss_start;
+  uint64_t rss_end;
+};
+
+struct FunctionStats {
+  std::string name;
+  uint64_t lift_nanos;
+  size_t num_insts;
+  size_t num_blocks;
+};
+
+struct DataSectionStats {
+  std::string name;
+  uint64_t num_bytes;
+  size_t num_fields;
+};
+
+struct OpcodeStats {
+  uint64_t count;
+  uint64_t lift_nanos;
+};
+
+static bool gCollectStats = false;
+static uint64_t gMemoryLimit = 0;
+
+static std::mutex gStatsLock;
+static std::vector<PhaseStats> gPhases;
+static std::vector<FunctionStats> gFunctions;
+static std::vector<DataSectionStats> gDataSections;
+static std::unordered_map<unsigned, OpcodeStats> gOpcodes;
+
+// Opcode lift times of the function that the current thread is lifting.
+static thread_local std::unordered_map<unsigned, OpcodeStats> gThreadOpcodes;
+
+static std::string EscapeJSON(const std::string &str) {
+  std::stringstream ss;
+  for (auto c : str) {
+    switch (c) {
+      case '"': ss << "\\\""; break;
+      case '\\': ss << "\\\\"; break;
+      case '\n': ss << "\\n"; break;
+      case '\t': ss << "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          ss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+             << static_cast<unsigned>(c) << std::dec;
+        } else {
+          ss << c;
+        }
+        break;
+    }
+  }
+  return ss.str();
+}
+
+static double ToSeconds(uint64_t nanos) {
+  return static_cast<double>(nanos) / 1e9;
+}
+
+// Returns the peak resident set size of this process, in bytes, or zero if
+// it isn't known.
+static uint64_t PeakRSS(void) {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return 0;
+  }
+# ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+# else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+# endif
+#endif
+}
+
+static double ToMiB(uint64_t num_bytes) {
+  return static_cast<double>(num_bytes) / (1024.0 * 1024.0);
+}
+
+}  // namespace
+
+uint64_t CurrentRSS(void) {
+#if defined(__linux__)
+  std::ifstream statm("/proc/self/statm");
+  uint64_t num_pages = 0;
+  uint64_t num_resident_pages = 0;
+  if (!(statm >> num_pages >> num_resident_pages)) {
+    return 0;
+  }
+  return num_resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+  return PeakRSS();
+#endif
+}
+
+void SetMemoryLimit(uint64_t num_bytes) {
+  gMemoryLimit = num_bytes;
+}
+
+void CheckMemoryLimit(const std::string &what) {
+  if (!gMemoryLimit) {
+    return;
+  }
+  auto rss = CurrentRSS();
+  if (rss > gMemoryLimit) {
+    std::cerr
+        << "ERROR: Using " << ToMiB(rss) << " MiB, which is over the memory "
+        << "limit of " << ToMiB(gMemoryLimit) << " MiB, while " << what
+        << std::endl;
+    std::abort();
+  }
+}
+
+void EnableLiftStats(void) {
+  gCollectStats = true;
+}
+
+bool LiftStatsEnabled(void) {
+  return gCollectStats;
+}
+
+PhaseTimer::PhaseTimer(const char *name_)
+    : name(name_),
+      enabled(gCollectStats),
+      wall_start(0),
+      cpu_start(0),
+      rss_start(0) {
+  CheckMemoryLimit(std::string("starting phase ") + name);
+  if (enabled) {
+    rss_start = CurrentRSS();
+    auto now = llvm::TimeRecord::getCurrentTime(true);
+    wall_start = now.getWallTime();
+    cpu_start = now.getProcessTime();
+  }
+}
+
+PhaseTimer::~PhaseTimer(void) {
+  Stop();
+}
+
+void PhaseTimer::Stop(void) {
+  if (!name) {
+    return;
+  }
+  if (enabled) {
+    auto now = llvm::TimeRecord::getCurrentTime(false);
+    auto rss_end = CurrentRSS();
+    std::lock_guard<std::mutex> locker(gStatsLock);
+    gPhases.push_back({name, now.getWallTime() - wall_start,
+                       now.getProcessTime() - cpu_start, rss_start, rss_end});
+    enabled = false;
+  }
+  CheckMemoryLimit(std::string("finishing phase ") + name);
+  name = nullptr;
+}
+
+uint64_t LiftStatsNow(void) {
+  if (!gCollectStats) {
+    return 0;
+  }
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void RecordOpcodeLift(unsigned opcode, uint64_t start) {
+  if (gCollectStats) {
+    gThreadOpcodes[opcode].lift_nanos += LiftStatsNow() - start;
+  }
+}
+
+void RecordFunctionLift(const std::string &name, uint64_t start,
+                        size_t num_insts, size_t num_blocks) {
+  if (!gCollectStats) {
+    return;
+  }
+
+  auto lift_nanos = LiftStatsNow() - start;
+  std::lock_guard<std::mutex> locker(gStatsLock);
+  gFunctions.push_back({name, lift_nanos, num_insts, num_blocks});
+  for (const auto &opcode_stats : gThreadOpcodes) {
+    gOpcodes[opcode_stats.first].lift_nanos += opcode_stats.second.lift_nanos;
+  }
+  gThreadOpcodes.clear();
+}
+
+void RecordDataSection(const std::string &name, uint64_t num_bytes,
+                       size_t num_fields) {
+  if (gCollectStats) {
+    std::lock_guard<std::mutex> locker(gStatsLock);
+    gDataSections.push_back({name, num_bytes, num_fields});
+  }
+}
+
+bool WriteLiftStats(const std::string &path, size_t top_n) {
+  std::lock_guard<std::mutex> locker(gStatsLock);
+
+  // Report the slowest functions and opcodes first.
+  std::vector<FunctionStats> funcs(gFunctions);
+  std::sort(funcs.begin(), funcs.end(),
+            [] (const FunctionStats &a, const FunctionStats &b) {
+              return a.lift_nanos > b.lift_nanos;
+            });
+
+  // The number of instructions per opcode comes from the hit counters of
+  // the dispatch table.
+  std::vector<std::pair<unsigned, OpcodeStats>> opcodes;
+  for (const auto &hits : ArchGetInstructionLifterHits()) {
+    auto it = gOpcodes.find(hits.first);
+    auto lift_nanos = it != gOpcodes.end() ? it->second.lift_nanos : 0;
+    opcodes.push_back({hits.first, {hits.second, lift_nanos}});
+  }
+  std::sort(opcodes.begin(), opcodes.end(),
+            [] (const std::pair<unsigned, OpcodeStats> &a,
+                const std::pair<unsigned, OpcodeStats> &b) {
+              return a.second.lift_nanos > b.second.lift_nanos;
+            });
+
+  std::ofstream os(path);
+  os << std::setprecision(9) << "{" << std::endl;
+
+  os << "  \"phases\": [";
+  auto sep = "";
+  for (const auto &phase : gPhases) {
+    os << sep << std::endl
+       << "    {\"name\": \"" << EscapeJSON(phase.name) << "\", "
+       << "\"wall_seconds\": " << phase.wall_seconds << ", "
+       << "\"cpu_seconds\": " << phase.cpu_seconds << ", "
+       << "\"rss_start_bytes\": " << phase.rss_start << ", "
+       << "\"rss_end_bytes\": " << phase.rss_end << "}";
+    sep = ",";
+  }
+  os << std::endl << "  ]," << std::endl;
+
+  os << "  \"functions\": [";
+  sep = "";
+  for (const auto &func : funcs) {
+    os << sep << std::endl
+       << "    {\"name\": \"" << EscapeJSON(func.name) << "\", "
+       << "\"lift_seconds\": " << ToSeconds(func.lift_nanos) << ", "
+       << "\"ir_instructions\": " << func.num_insts << ", "
+       << "\"ir_blocks\": " << func.num_blocks << "}";
+    sep = ",";
+  }
+  os << std::endl << "  ]," << std::endl;
+
+  // The functions and data sections that take up the most IR.
+  std::stable_sort(funcs.begin(), funcs.end(),
+                   [] (const FunctionStats &a, const FunctionStats &b) {
+                     return a.num_insts > b.num_insts;
+                   });
+  funcs.resize(std::min(funcs.size(), top_n));
+
+  os << "  \"largest_functions\": [";
+  sep = "";
+  for (const auto &func : funcs) {
+    os << sep << std::endl
+       << "    {\"name\": \"" << EscapeJSON(func.name) << "\", "
+       << "\"ir_instructions\": " << func.num_insts << ", "
+       << "\"ir_blocks\": " << func.num_blocks << "}";
+    sep = ",";
+  }
+  os << std::endl << "  ]," << std::endl;
+
+  std::vector<DataSectionStats> sections(gDataSections);
+  std::stable_sort(sections.begin(), sections.end(),
+                   [] (const DataSectionStats &a, const DataSectionStats &b) {
+                     return a.num_fields > b.num_fields;
+                   });
+  sections.resize(std::min(sections.size(), top_n));
+
+  os << "  \"largest_data_sections\": [";
+  sep = "";
+  for (const auto &section : sections) {
+    os << sep << std::endl
+       << "    {\"name\": \"" << EscapeJSON(section.name) << "\", "
+       << "\"bytes\": " << section.num_bytes << ", "
+       << "\"constants\": " << section.num_fields << "}";
+    sep = ",";
+  }
+  os << std::endl << "  ]," << std::endl;
+
+  os << "  \"opcodes\": [";
+  sep = "";
+  for (const auto &opcode_stats : opcodes) {
+    os << sep << std::endl
+       << "    {\"opcode\": " << opcode_stats.first << ", "
+       << "\"name\": \"" << EscapeJSON(ArchInstructionName(opcode_stats.first))
+       << "\", \"count\": " << opcode_stats.second.count << ", "
+       << "\"lift_seconds\": " << ToSeconds(opcode_stats.second.lift_nanos)
+       << "}";
+    sep = ",";
+  }
+  os << std::endl << "  ]," << std::endl;
+
+  os << "  \"peak_rss_bytes\": " << PeakRSS() << std::endl
+     << "}" << std::endl;
+
+  return os.good();
+}
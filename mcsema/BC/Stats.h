@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_STATS_H_
+#define MCSEMA_BC_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Start collecting the statistics that are reported by `WriteLiftStats`.
+void EnableLiftStats(void);
+
+bool LiftStatsEnabled(void);
+
+// Returns the current resident set size of this process, in bytes, or zero
+// if it isn't known.
+uint64_t CurrentRSS(void);
+
+// Set a soft limit on the resident set size of this process, in bytes.
+// Zero means no limit.
+void SetMemoryLimit(uint64_t num_bytes);
+
+// Abort with a diagnostic that names `what`, e.g. "lifting function sub_0",
+// if the resident set size is over the limit. The limit is also
+// checked at the start and end of every phase.
+void CheckMemoryLimit(const std::string &what);
+
+// Records the wall and CPU time spent between its construction and its
+// destruction, or the first call to `Stop`, as the lifting phase `name`,
+// along with the resident set size at both ends.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(const char *name_);
+  ~PhaseTimer(void);
+
+  void Stop(void);
+
+ private:
+  PhaseTimer(void) = delete;
+  PhaseTimer(const PhaseTimer &) = delete;
+
+  const char *name;
+  bool enabled;
+  double wall_start;
+  double cpu_start;
+  uint64_t rss_start;
+};
+
+// Returns a timestamp, in nanoseconds, for `RecordOpcodeLift` and
+// `RecordFunctionLift`. Returns zero if statistics aren't being collected.
+uint64_t LiftStatsNow(void);
+
+// Record that an instruction with opcode `opcode` was lifted starting at
+// `start`. The record is kept by the current thread until the next call
+// to `RecordFunctionLift`.
+void RecordOpcodeLift(unsigned opcode, uint64_t start);
+
+// Record that the function `name` was lifted starting at `start`, into
+// `num_insts` IR instructions in `num_blocks` basic blocks.
+void RecordFunctionLift(const std::string &name, uint64_t start,
+                        size_t num_insts, size_t num_blocks);
+
+// Record that the data section `name` was lifted into an initializer of
+// `num_bytes` bytes, made of `num_fields` constants.
+void RecordDataSection(const std::string &name, uint64_t num_bytes,
+                       size_t num_fields);
+
+// Write the collected statistics to `path` as a JSON object. The `top_n`
+// biggest functions and data sections are also listed on their own.
+bool WriteLiftStats(const std::string &path, size_t top_n);
+
+#endif  // MCSEMA_BC_STATS_H_
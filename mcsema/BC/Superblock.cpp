@@ -0,0 +1,132 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <unordered_map>
+#include <vector>
+
+#include "mcsema/Arch/Arch.h"
+#include "mcsema/BC/Profile.h"
+#include "mcsema/BC/Superblock.h"
+
+namespace {
+
+// Successors with more instructions than this aren't duplicated.
+static const size_t kMaxDuplicatedInsts = 12;
+
+// At most this many duplicated blocks are lifted into one superblock.
+static const size_t kMaxDuplicatedBlocks = 4;
+
+// Returns true if `block` always continues at its only successor, either by
+// falling through or with a direct jump.
+static bool HasOneSuccessor(NativeBlockPtr block) {
+  if (1 != block->get_follows().size()) {
+    return false;
+  }
+  const auto &insts = block->get_insts();
+  if (insts.empty()) {
+    return false;
+  }
+  auto last = insts.back();
+  if (last->has_jump_table()) {
+    return false;
+  }
+  auto opcode = last->get_inst().getOpcode();
+  return ArchInstructionIsDirectJump(opcode) ||
+         ArchInstructionFallsThrough(opcode);
+}
+
+}  // namespace
+
+SuperblockPlan::SuperblockPlan(NativeFunctionPtr func, VA entry_va,
+                               const std::vector<NativeBlockPtr> &blocks) {
+  std::unordered_map<VA, NativeBlockPtr> va_to_block;
+  std::unordered_map<VA, size_t> num_preds;
+  for (auto block : blocks) {
+    va_to_block[block->get_base()] = block;
+  }
+  for (auto block : blocks) {
+    for (auto succ_va : block->get_follows()) {
+      num_preds[succ_va]++;
+    }
+  }
+
+  for (auto block : blocks) {
+    if (!HasOneSuccessor(block) ||
+        !ProfileCountIsHot(ProfileBlockCount(block))) {
+      continue;
+    }
+
+    auto succ_va = block->get_follows().front();
+    auto succ_it = va_to_block.find(succ_va);
+    if (succ_it == va_to_block.end() || succ_va == block->get_base()) {
+      continue;
+    }
+
+    auto succ = succ_it->second;
+    if (1 == num_preds[succ_va] && succ_va != entry_va) {
+      next[block->get_base()] = succ;
+      absorbed.insert(succ_va);
+    } else if (succ->get_insts().size() <= kMaxDuplicatedInsts &&
+               ProfileBlockCount(succ)) {
+      next[block->get_base()] = succ;
+    }
+  }
+}
+
+NativeBlockPtr SuperblockPlan::get_next(NativeBlockPtr block,
+                                        const std::vector<VA> &trace) const {
+  auto next_it = next.find(block->get_base());
+  if (next_it == next.end()) {
+    return nullptr;
+  }
+
+  // An absorbed block's only predecessor is already in the superblock, so
+  // it can't be in there yet itself.
+  auto succ = next_it->second;
+  auto succ_va = succ->get_base();
+  if (absorbed.count(succ_va)) {
+    return succ;
+  }
+
+  size_t num_duplicated = 0;
+  for (auto va : trace) {
+    if (va == succ_va) {
+      return nullptr;
+    }
+    if (va != trace.front() && !absorbed.count(va)) {
+      ++num_duplicated;
+    }
+  }
+  return num_duplicated < kMaxDuplicatedBlocks ? succ : nullptr;
+}
+
+bool SuperblockPlan::is_absorbed(VA va) const {
+  return absorbed.count(va);
+}
@@ -0,0 +1,70 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_BC_SUPERBLOCK_H_
+#define MCSEMA_BC_SUPERBLOCK_H_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "mcsema/CFG/CFG.h"
+
+// Chooses the superblocks of a function along its hot paths in the
+// `-profile`. A superblock is a lifted block that continues past the end of
+// a native block into its only successor, instead of branching to it, so
+// that the register values stay in SSA form across the native block split.
+//
+// A hot block that falls through or jumps directly to a single successor
+// continues into it if the successor has no other predecessors, in which
+// case the successor isn't lifted on its own, or if the successor is hot and
+// short enough to duplicate into the superblock.
+class SuperblockPlan {
+ public:
+  SuperblockPlan(NativeFunctionPtr func, VA entry_va,
+                 const std::vector<NativeBlockPtr> &blocks);
+
+  // Returns the block to lift right after `block`, into the same lifted
+  // block, or `nullptr` if the superblock ends with `block`. `trace` holds
+  // the addresses of the blocks lifted into the superblock so far, starting
+  // with its head.
+  NativeBlockPtr get_next(NativeBlockPtr block,
+                          const std::vector<VA> &trace) const;
+
+  // Returns true if the block at `va` is only ever lifted into the
+  // superblock of its predecessor.
+  bool is_absorbed(VA va) const;
+
+ private:
+  std::unordered_map<VA, NativeBlockPtr> next;
+  std::unordered_set<VA> absorbed;
+};
+
+#endif  // MCSEMA_BC_SUPERBLOCK_H_
@@ -1,17 +1,49 @@
 /* Copyright 2017 Peter Goodman (peter@trailofbits.com), all rights reserved. */
 
+#include <memory>
+#include <unordered_map>
+
+#include <llvm/ADT/ArrayRef.h>
+
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 
+#include <llvm/Support/CommandLine.h>
+
 #include "mcsema/Arch/Arch.h"
+#include "mcsema/Arch/Dispatch.h"
 #include "mcsema/Arch/Register.h"
+#include "mcsema/BC/Fuzz.h"
 #include "mcsema/BC/Util.h"
 
 #include "mcsema/cfgToLLVM/TransExcn.h"
 
-llvm::LLVMContext *gContext = nullptr;
+thread_local llvm::LLVMContext *gContext = nullptr;
+
+static llvm::cl::opt<bool> AddAliasMetadata(
+    "tbaa",
+    llvm::cl::desc(
+        "Tag register and memory accesses with TBAA metadata, so that the "
+        "optimizer knows that guest memory accesses don't clobber the "
+        "register state, and that different registers don't alias."),
+    llvm::cl::init(true));
+
+namespace {
+
+static thread_local std::unordered_map<
+    llvm::Function *, std::unique_ptr<RegisterTable>> gRegTables;
+
+// Register accesses come in long runs against the same function, so remember
+// the last table that was looked up.
+static thread_local llvm::Function *gLastRegTableFunc = nullptr;
+static thread_local RegisterTable *gLastRegTable = nullptr;
+
+}  // namespace
 
 llvm::Module *CreateModule(llvm::LLVMContext *context) {
   if (!gContext) {
@@ -31,7 +63,7 @@ llvm::ConstantInt *CreateConstantInt(int width, uint64_t val) {
 
 // Return the type of a lifted function.
 llvm::FunctionType *LiftedFunctionType(void) {
-  static llvm::FunctionType *func_type = nullptr;
+  static thread_local llvm::FunctionType *func_type = nullptr;
   if (!func_type) {
     auto state_type = ArchRegStateStructType();
     auto state_ptr_type = llvm::PointerType::get(state_type, 0);
@@ -43,8 +75,84 @@ llvm::FunctionType *LiftedFunctionType(void) {
   return func_type;
 }
 
+bool AliasMetadataEnabled(void) {
+  return AddAliasMetadata;
+}
+
+// The type nodes are uniqued by the `llvm::LLVMContext`. Every register
+// family, and guest memory, get sibling type nodes under one root, so that
+// none of them alias.
+static llvm::MDNode *CreateTBAATag(llvm::LLVMContext &C,
+                                   const std::string &name) {
+  llvm::MDBuilder mdb(C);
+  auto root = mdb.createTBAARoot("mcsema");
+  auto type = mdb.createTBAAScalarTypeNode(name, root);
+  return mdb.createTBAAStructTagNode(type, type, 0);
+}
+
+// Returns the tag for accesses to `reg`. Sub-registers share the tag of the
+// register that they are part of.
+static llvm::MDNode *GetRegisterTBAA(llvm::Function *F, MCSemaRegs reg) {
+  auto table = GetRegisterTable(F);
+  if (!table || reg >= table->read.size()) {
+    return nullptr;
+  }
+  if (table->tbaa.empty()) {
+    table->tbaa.resize(table->read.size(), nullptr);
+  }
+  if (!table->tbaa[reg]) {
+    auto root_reg = reg;
+    for (auto parent = ArchRegisterParent(root_reg); parent != root_reg;
+         parent = ArchRegisterParent(root_reg)) {
+      root_reg = parent;
+    }
+    table->tbaa[reg] = CreateTBAATag(
+        F->getContext(), "RegState::" + ArchRegisterName(root_reg));
+  }
+  return table->tbaa[reg];
+}
+
+static llvm::MDNode *GetMemoryTBAA(llvm::Function *F) {
+  auto table = GetRegisterTable(F);
+  if (!table) {
+    return CreateTBAATag(F->getContext(), "memory");
+  }
+  if (!table->memory_tbaa) {
+    table->memory_tbaa = CreateTBAATag(F->getContext(), "memory");
+  }
+  return table->memory_tbaa;
+}
+
+static void AddMemoryTBAA(llvm::BasicBlock *b, llvm::Instruction *inst) {
+  if (AddAliasMetadata) {
+    inst->setMetadata(llvm::LLVMContext::MD_tbaa,
+                      GetMemoryTBAA(b->getParent()));
+  }
+}
+
+static void AddRegisterTBAA(llvm::BasicBlock *b, MCSemaRegs reg,
+                            llvm::Instruction *inst) {
+  if (AddAliasMetadata) {
+    if (auto tag = GetRegisterTBAA(b->getParent(), reg)) {
+      inst->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    }
+  }
+}
+
+// Checks an access through `addr` to a `ptr_ty` pointer. See
+// `ArchFitStackFrameAccess`.
+static void FitStackFrameAccess(llvm::BasicBlock *b, llvm::Value *addr,
+                                llvm::Type *ptr_ty) {
+  auto elem_ty = ptr_ty->getPointerElementType();
+  if (elem_ty->isSized()) {
+    llvm::DataLayout DL(b->getParent()->getParent());
+    ArchFitStackFrameAccess(b, addr, DL.getTypeStoreSize(elem_ty));
+  }
+}
+
 llvm::Value *INTERNAL_M_READ(unsigned width, unsigned addrspace,
                              llvm::BasicBlock *b, llvm::Value *addr) {
+  ArchFitStackFrameAccess(b, addr, width / 8);
   llvm::Value *readLoc = addr;
   llvm::LLVMContext &C = b->getContext();
 
@@ -63,11 +171,14 @@ llvm::Value *INTERNAL_M_READ(unsigned width, unsigned addrspace,
   }
 
   auto is_volatile = addrspace != 0;
-  return new llvm::LoadInst(readLoc, "", is_volatile, b);
+  auto load = new llvm::LoadInst(readLoc, "", is_volatile, b);
+  AddMemoryTBAA(b, load);
+  return load;
 }
 
 void INTERNAL_M_WRITE(int width, unsigned addrspace, llvm::BasicBlock *b,
                       llvm::Value *addr, llvm::Value *data) {
+  ArchFitStackFrameAccess(b, addr, width / 8);
   llvm::Value *writeLoc = addr;
   llvm::LLVMContext &C = b->getContext();
   auto writeLocTy = writeLoc->getType();
@@ -86,12 +197,13 @@ void INTERNAL_M_WRITE(int width, unsigned addrspace, llvm::BasicBlock *b,
   }
 
   auto is_volatile = addrspace != 0;
-  (void) new llvm::StoreInst(data, writeLoc, is_volatile, b);
+  AddMemoryTBAA(b, new llvm::StoreInst(data, writeLoc, is_volatile, b));
 }
 
 void M_WRITE_T(NativeInstPtr ip, llvm::BasicBlock *b, llvm::Value *addr,
                llvm::Value *data, llvm::Type *ptrtype) {
   //this is also straightforward
+  FitStackFrameAccess(b, addr, ptrtype);
   llvm::Value *writeLoc = addr;
   unsigned addrspace = ip->get_addr_space();
 
@@ -107,7 +219,7 @@ void M_WRITE_T(NativeInstPtr ip, llvm::BasicBlock *b, llvm::Value *addr,
     writeLoc = llvm::CastInst::CreatePointerCast(addr, ptrtype, "", b);
   }
 
-  (void) new llvm::StoreInst(data, writeLoc, b);
+  AddMemoryTBAA(b, new llvm::StoreInst(data, writeLoc, b));
 }
 
 llvm::Value *ADDR_TO_POINTER(
@@ -118,6 +230,7 @@ llvm::Value *ADDR_TO_POINTER(
 
 llvm::Value *ADDR_TO_POINTER_V(llvm::BasicBlock *b, llvm::Value *memAddr,
                                llvm::Type *ptrType) {
+  FitStackFrameAccess(b, memAddr, ptrType);
   if (memAddr->getType()->isPointerTy() == false) {
     // its an integer, make it a pointer
     return new llvm::IntToPtrInst(memAddr, ptrType, "", b);
@@ -130,38 +243,72 @@ llvm::Value *ADDR_TO_POINTER_V(llvm::BasicBlock *b, llvm::Value *memAddr,
   }
 }
 
-static llvm::Value *GetReadReg(llvm::Function *F, MCSemaRegs reg) {
-  std::stringstream ss;
-  ss << ArchRegisterName(reg) << "_read";
-  auto reg_name = ss.str();
+RegisterTable *CreateRegisterTable(llvm::Function *F) {
+  auto table = new RegisterTable;
+  table->read.resize(llvm::X86::MCSEMA_REGS_MAX, nullptr);
+  table->write.resize(llvm::X86::MCSEMA_REGS_MAX, nullptr);
+  gRegTables[F].reset(table);
+  gLastRegTableFunc = F;
+  gLastRegTable = table;
+  return table;
+}
 
-  for (llvm::Instruction &I : F->front()) {
-    if (I.getName().str() == reg_name) {
-      return &I;
+RegisterTable *GetRegisterTable(llvm::Function *F) {
+  if (F != gLastRegTableFunc) {
+    auto table_it = gRegTables.find(F);
+    if (table_it == gRegTables.end()) {
+      return nullptr;
     }
+    gLastRegTableFunc = F;
+    gLastRegTable = table_it->second.get();
   }
+  return gLastRegTable;
+}
 
-  std::cerr
-      << "Can't find variable " << reg_name << " for register number " << reg
-      << " in function " << F->getName().str() << std::endl;
-  return nullptr;
+void FreeRegisterTable(llvm::Function *F) {
+  if (F == gLastRegTableFunc) {
+    gLastRegTableFunc = nullptr;
+    gLastRegTable = nullptr;
+  }
+  gRegTables.erase(F);
 }
 
-static llvm::Value *GetWriteReg(llvm::Function *F, MCSemaRegs reg) {
-  std::stringstream ss;
-  ss << ArchRegisterName(reg) << "_write";
-  auto reg_name = ss.str();
+int64_t GetStateFieldIndex(llvm::GetElementPtrInst *gep) {
+  if (3 > gep->getNumOperands()) {
+    return -1;
+  }
+  auto base = llvm::dyn_cast<llvm::ConstantInt>(gep->getOperand(1));
+  auto field = llvm::dyn_cast<llvm::ConstantInt>(gep->getOperand(2));
+  if (!base || !field || !base->isZero()) {
+    return -1;
+  }
+  return static_cast<int64_t>(field->getZExtValue());
+}
 
-  for (llvm::Instruction &I : F->front()) {
-    if (I.getName().str() == reg_name) {
-      return &I;
-    }
+bool IsStateSyncPoint(llvm::CallInst *call) {
+  return !llvm::isa<llvm::IntrinsicInst>(call) &&
+         !call->doesNotAccessMemory() &&
+         !IsFuzzHook(call->getCalledFunction());
+}
+
+static llvm::Value *GetRegVar(llvm::Function *F, MCSemaRegs reg,
+                              bool is_write) {
+  auto var = ArchGetRegisterVar(F, reg, is_write);
+  if (!var) {
+    std::cerr
+        << "Can't find variable " << ArchRegisterName(reg)
+        << (is_write ? "_write" : "_read") << " for register number " << reg
+        << " in function " << F->getName().str() << std::endl;
   }
+  return var;
+}
 
-  std::cerr
-      << "Can't find variable " << reg_name << " for register number " << reg
-      << " in function " << F->getName().str() << std::endl;
-  return nullptr;
+static llvm::Value *GetReadReg(llvm::Function *F, MCSemaRegs reg) {
+  return GetRegVar(F, reg, false);
+}
+
+static llvm::Value *GetWriteReg(llvm::Function *F, MCSemaRegs reg) {
+  return GetRegVar(F, reg, true);
 }
 
 void GENERIC_MC_WRITEREG(llvm::BasicBlock *B, MCSemaRegs mc_reg,
@@ -186,7 +333,7 @@ void GENERIC_MC_WRITEREG(llvm::BasicBlock *B, MCSemaRegs mc_reg,
     }
   }
 
-  (void) new llvm::StoreInst(val, reg_ptr, "", B);
+  AddRegisterTBAA(B, mc_reg, new llvm::StoreInst(val, reg_ptr, B));
 }
 
 llvm::Value *GENERIC_MC_READREG(llvm::BasicBlock *B, MCSemaRegs mc_reg,
@@ -204,7 +351,10 @@ llvm::Value *GENERIC_MC_READREG(llvm::BasicBlock *B, MCSemaRegs mc_reg,
   llvm::DataLayout DL(M);
 
   auto val_ptr = GetReadReg(F, mc_reg);
-  llvm::Value *val = new llvm::LoadInst(val_ptr, "", B);
+  auto load = new llvm::LoadInst(val_ptr, "", B);
+  AddRegisterTBAA(B, mc_reg, load);
+
+  llvm::Value *val = load;
   auto val_ty = val->getType();
   auto val_size = DL.getTypeAllocSizeInBits(val_ty);
 
@@ -286,40 +436,63 @@ static llvm::Constant *GetPointerSizedValue(llvm::Module *M, llvm::Constant *v,
 
 
 static llvm::GlobalVariable *GetSectionForDataAddr(
-    const std::list<DataSection> &dataSecs, llvm::Module *M, VA data_addr,
+    NativeModulePtr natMod, llvm::Module *M, VA data_addr,
     VA &section_base) {
 
-  for (auto &dt : dataSecs) {
-    VA start = dt.getBase();
-    VA end = start + dt.getSize();
-
-    if (data_addr >= start && data_addr < end) {
-      std::stringstream ss;
-      ss << "data_" << std::hex << start;
-      section_base = start;
-      return M->getNamedGlobal(ss.str());
-    }
+  if (auto ds = natMod->findDataSection(data_addr)) {
+    section_base = ds->getBase();
+    return natMod->getDataSectionVar(section_base, M);
   }
   return nullptr;
 }
 
-static llvm::Constant *CreateConstantBlob(llvm::LLVMContext &ctx,
-                                    const std::vector<uint8_t> &blob) {
-  auto charTy = llvm::Type::getInt8Ty(ctx);
-  auto arrT = llvm::ArrayType::get(charTy, blob.size());
-  std::vector<llvm::Constant *> array_elements;
-  for (auto cur : blob) {
-    auto c = llvm::ConstantInt::get(charTy, cur);
-    array_elements.push_back(c);
+// Runs of at least this many zero bytes in a blob are emitted as
+// `zeroinitializer` arrays.
+static const size_t kMinZeroRunSize = 64;
+
+// Split the bytes of `blob` into items. Long runs of zeroes become `kZeroes`
+// items, so that they don't need one constant per byte.
+static void AddBlobItems(llvm::ArrayRef<uint8_t> blob,
+                         std::vector<DataSectionItem> &items) {
+  auto add_item = [&] (DataSectionItem::Kind kind, size_t begin,
+                       size_t end) {
+    DataSectionItem item = {};
+    item.kind = kind;
+    item.size = end - begin;
+    item.bytes = blob.slice(begin, end - begin);
+    items.push_back(std::move(item));
+  };
+
+  size_t data_begin = 0;
+  size_t i = 0;
+  while (i < blob.size()) {
+    if (blob[i]) {
+      ++i;
+      continue;
+    }
+
+    auto zeros_begin = i;
+    while (i < blob.size() && !blob[i]) {
+      ++i;
+    }
+
+    if ((i - zeros_begin) >= kMinZeroRunSize) {
+      if (data_begin < zeros_begin) {
+        add_item(DataSectionItem::kBytes, data_begin, zeros_begin);
+      }
+      add_item(DataSectionItem::kZeroes, zeros_begin, i);
+      data_begin = i;
+    }
+  }
+
+  if (data_begin < blob.size() || blob.empty()) {
+    add_item(DataSectionItem::kBytes, data_begin, blob.size());
   }
-  return llvm::ConstantArray::get(arrT, array_elements);
 }
 
-void dataSectionToTypesContents(const std::list<DataSection> &globaldata,
-                                const DataSection &ds, llvm::Module *M,
-                                std::vector<llvm::Constant *> &secContents,
-                                std::vector<llvm::Type *> &data_section_types,
-                                bool convert_to_callback) {
+void resolveDataSectionItems(NativeModulePtr natMod, const DataSection &ds,
+                             llvm::Module *M,
+                             std::vector<DataSectionItem> &items) {
   // find what elements will be needed for this data section
   // There are three main types:
   // Functions: pointer to a known function in the cfg
@@ -338,114 +511,143 @@ void dataSectionToTypesContents(const std::list<DataSection> &globaldata,
   //
   const std::list<DataSectionEntry> &ds_entries = ds.getEntries();
   for (auto &data_sec_entry : ds_entries) {
-    std::string sym_name;
+    DataSectionItem item = {};
+    if (!data_sec_entry.getSymbol(item.sym_name)) {
+      // add array
+      // this holds opaque data in a byte array
+      AddBlobItems(data_sec_entry.getBytes(), items);
+      continue;
+    }
 
-    if (data_sec_entry.getSymbol(sym_name)) {
+    const auto &sym_name = item.sym_name;
+    item.base = data_sec_entry.getBase();
+    item.size = data_sec_entry.getSize();
 
-      std::cout
-          << __FUNCTION__ << ": Found symbol: " << sym_name << " in "
-          << std::hex << data_sec_entry.getBase() << std::endl;
+    if (sym_name.find("ext_") == 0) {
 
-      if (sym_name.find("ext_") == 0) {
+      // TODO(pag): this is flaky!
+      auto ext_sym_name = sym_name.c_str() + 4 /* strlen("ext_") */;
+      item.kind = DataSectionItem::kExternal;
+      item.ext = M->getNamedValue(ext_sym_name);
+      TASSERT(item.ext != nullptr,
+              "Could not find external: " + std::string(ext_sym_name));
 
-        // TODO(pag): this is flaky!
-        auto ext_sym_name = sym_name.c_str() + 4 /* strlen("ext_") */;
+    } else if (sym_name.find("sub_") == 0) {
 
-        llvm::Constant *final_val = nullptr;
-        auto ext_v = M->getNamedValue(ext_sym_name);
+      // TODO(pag): This is so flaky.
+      auto sub_addr_str = sym_name.c_str() + 4 /* strlen("sub_") */;
+      item.kind = DataSectionItem::kFunction;
+      sscanf(sub_addr_str, "%lx", &(item.addr));
 
-        if (ext_v != nullptr && llvm::isa<llvm::Function>(ext_v)) {
-          final_val = GetPointerSizedValue(M, ext_v, data_sec_entry.getSize());
-          //cout << "External function" << sym_name << " has type: " << final_val->getType() << "\n";
-        } else if (ext_v != nullptr) {
-          final_val = GetPointerSizedValue(M, ext_v, data_sec_entry.getSize());
-          //cout << "External data" << sym_name << " has type: " << final_val->getType() << "\n";
-          // assume ext data
-        } else {
-          TASSERT(ext_v != nullptr,
-                  "Could not find external: " + std::string(ext_sym_name));
-          //cout << "External fail" << sym_name << " has type: " << final_val->getType() << "\n";
-        }
+    } else if (sym_name.find("data_") == 0) {
+
+      // TODO(pag): This is so flaky.
+      auto data_addr_str = sym_name.c_str() + 5 /* strlen("data_") */;
+      VA data_addr = 0;
+      sscanf(data_addr_str, "%lx", &data_addr);
+
+      // data symbol
+      // get the base of the data section for this symobol
+      // then compute the offset from base of data
+      VA section_base;
+      item.kind = DataSectionItem::kData;
+      item.section_var = GetSectionForDataAddr(natMod, M, data_addr,
+                                               section_base);
+      TASSERT(item.section_var != nullptr,
+              "Could not get data addr for:" + std::string(data_addr_str));
+      item.addr = data_addr - section_base;
+
+    } else {
+      item.kind = DataSectionItem::kUnknown;
+    }
+    items.push_back(std::move(item));
+  }
+}
+
+void dataSectionItemsToTypesContents(
+    llvm::Module *M, const std::vector<DataSectionItem> &items,
+    std::vector<llvm::Constant *> &secContents,
+    std::vector<llvm::Type *> &data_section_types,
+    bool convert_to_callback) {
+  auto &C = M->getContext();
+  for (auto &item : items) {
+    llvm::Constant *final_val = nullptr;
+    const auto &sym_name = item.sym_name;
 
-        secContents.push_back(final_val);
-        data_section_types.push_back(final_val->getType());
+    if (!sym_name.empty()) {
+      std::cout
+          << __FUNCTION__ << ": Found symbol: " << sym_name << " in "
+          << std::hex << item.base << std::endl;
+    }
 
-      } else if (sym_name.find("sub_") == 0) {
+    switch (item.kind) {
+      case DataSectionItem::kBytes:
+        final_val = llvm::ConstantDataArray::get(C, item.bytes);
+        break;
 
-        // TODO(pag): This is so flaky.
-        auto sub_addr_str = sym_name.c_str() + 4 /* strlen("sub_") */;
-        VA sub_addr = 0;
-        sscanf(sub_addr_str, "%lx", &sub_addr);
+      case DataSectionItem::kZeroes:
+        final_val = llvm::ConstantAggregateZero::get(
+            llvm::ArrayType::get(llvm::Type::getInt8Ty(C), item.size));
+        break;
+
+      case DataSectionItem::kExternal:
+        final_val = GetPointerSizedValue(M, item.ext, item.size);
+        break;
+
+      case DataSectionItem::kFunction: {
 
         // add function pointer to data section
         // to do this, create a callback driver for
         // it first (since it may be called externally)
-
         llvm::Function *func = nullptr;
-
         if (convert_to_callback) {
-          func = ArchAddCallbackDriver(M, sub_addr);
+          func = ArchAddCallbackDriver(M, item.addr);
           TASSERT(func != nullptr, "Could make callback for: " + sym_name);
         } else {
           func = M->getFunction(sym_name);
           TASSERT(func != nullptr, "Could not find function: " + sym_name);
         }
+        final_val = GetPointerSizedValue(M, func, item.size);
+        break;
+      }
 
-        auto final_val = GetPointerSizedValue(M, func, data_sec_entry.getSize());
-        secContents.push_back(final_val);
-        data_section_types.push_back(final_val->getType());
-
-      } else if (sym_name.find("data_") == 0) {
-
-        // TODO(pag): This is so flaky.
-        auto data_addr_str = sym_name.c_str() + 5 /* strlen("data_") */;
-        VA data_addr = 0;
-        sscanf(data_addr_str, "%lx", &data_addr);
-
-        // data symbol
-        // get the base of the data section for this symobol
-        // then compute the offset from base of data
-        // and store as integer value of (base+offset)
-        VA section_base;
-        auto g_ref = GetSectionForDataAddr(globaldata, M, data_addr,
-                                           section_base);
-        TASSERT(g_ref != nullptr,
-                "Could not get data addr for:" + std::string(data_addr_str));
+      case DataSectionItem::kData:
         // instead of referencing an element directly
         // we just convert the pointer to an integer
         // and add its offset from the base of data
         // to the new data section pointer
-        VA addr_diff = data_addr - section_base;
-        llvm::Constant *final_val = nullptr;
-        //cout << " Symbol name : " << string(func_addr_str) << " : "
-        //     << to_string<VA>(func_addr, hex) << " : "
-        //     << to_string<VA>(section_base, hex) << "\n";
-        //cout.flush();
         if (ArchPointerSize(M) == Pointer32) {
           auto int_val = llvm::ConstantExpr::getPtrToInt(
-              g_ref, llvm::Type::getInt32Ty(M->getContext()));
+              item.section_var, llvm::Type::getInt32Ty(C));
           final_val = llvm::ConstantExpr::getAdd(
-              int_val, CONST_V_INT<32>(M->getContext(), addr_diff));
+              int_val, CONST_V_INT<32>(C, item.addr));
         } else {
           auto int_val = llvm::ConstantExpr::getPtrToInt(
-              g_ref, llvm::Type::getInt64Ty(M->getContext()));
+              item.section_var, llvm::Type::getInt64Ty(C));
           final_val = llvm::ConstantExpr::getAdd(
-              int_val, CONST_V_INT<64>(M->getContext(), addr_diff));
+              int_val, CONST_V_INT<64>(C, item.addr));
         }
-        secContents.push_back(final_val);
-        data_section_types.push_back(final_val->getType());
+        break;
 
-      } else {
+      case DataSectionItem::kUnknown:
         std::cerr
             << __FUNCTION__ << ": Unknown data section entry symbol type "
             << sym_name << std::endl;
-      }
-    } else {
-      // add array
-      // this holds opaque data in a byte array
-      auto arr = CreateConstantBlob(M->getContext(), data_sec_entry.getBytes());
-      secContents.push_back(arr);
-      data_section_types.push_back(arr->getType());
-    }  // if dsec_itr
-  }  // for list
+        continue;
+    }
+
+    secContents.push_back(final_val);
+    data_section_types.push_back(final_val->getType());
+  }
+}
+
+void dataSectionToTypesContents(NativeModulePtr natMod,
+                                const DataSection &ds, llvm::Module *M,
+                                std::vector<llvm::Constant *> &secContents,
+                                std::vector<llvm::Type *> &data_section_types,
+                                bool convert_to_callback) {
+  std::vector<DataSectionItem> items;
+  resolveDataSectionItems(natMod, ds, M, items);
+  dataSectionItemsToTypesContents(M, items, secContents, data_section_types,
+                                  convert_to_callback);
 }
@@ -32,6 +32,10 @@
 #define MCSEMA_BC_UTIL_H_
 
 #include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
 
 #include "mcsema/Arch/Register.h"
 #include "mcsema/CFG/CFG.h"
@@ -39,13 +43,19 @@
 namespace llvm {
 
 class BasicBlock;
+class CallInst;
 class ConstantInt;
+class Function;
+class GetElementPtrInst;
+class GlobalValue;
+class GlobalVariable;
 class LLVMContext;
 class Module;
 
 }  // namespace llvm
 
-extern llvm::LLVMContext *gContext;
+// The context into which the current thread is lifting.
+extern thread_local llvm::LLVMContext *gContext;
 
 // Create a new module for the current arch/os pair.
 llvm::Module *CreateModule(llvm::LLVMContext *context);
@@ -56,6 +66,25 @@ llvm::ConstantInt *CreateConstantInt(int width, uint64_t val);
 // Return the type of a lifted function.
 llvm::FunctionType *LiftedFunctionType(void);
 
+// Create the register table of `F`, replacing any existing table.
+RegisterTable *CreateRegisterTable(llvm::Function *F);
+
+// Return the register table of `F`, or `nullptr` if its register variables
+// haven't been allocated.
+RegisterTable *GetRegisterTable(llvm::Function *F);
+
+// Release the register table of `F` once it's done being lifted.
+void FreeRegisterTable(llvm::Function *F);
+
+// Returns the index of the register state structure field that `gep` points
+// into, or `-1` if the field isn't a constant.
+int64_t GetStateFieldIndex(llvm::GetElementPtrInst *gep);
+
+// Returns true if the callee of `call` may observe or change the register
+// state structure. Intrinsics, calls that don't access memory, and the fuzzing
+// hooks don't.
+bool IsStateSyncPoint(llvm::CallInst *call);
+
 template <int width>
 inline static llvm::ConstantInt *CONST_V_INT(
     llvm::LLVMContext &, uint64_t val) {
@@ -89,6 +118,10 @@ enum StoreSpillType {
 #define aliasMCSemaScope(...) \
     reinterpret_cast<llvm::Instruction *>(__VA_ARGS__)
 
+// Returns true if register and memory accesses are tagged with TBAA metadata
+// that keeps the register state and guest memory from aliasing.
+bool AliasMetadataEnabled(void);
+
 void GENERIC_WRITEREG(llvm::BasicBlock *b, MCSemaRegs reg, llvm::Value *v);
 llvm::Value *GENERIC_READREG(llvm::BasicBlock *b, MCSemaRegs reg);
 
@@ -199,27 +232,66 @@ void F_CLEAR(llvm::BasicBlock *b, MCSemaRegs flag);
 
 llvm::Value *makeCallbackForLocalFunction(llvm::Module *M, VA local_target);
 
-void dataSectionToTypesContents(const std::list<DataSection> &globaldata,
+void dataSectionToTypesContents(NativeModulePtr natMod,
                                 const DataSection &ds, llvm::Module *M,
                                 std::vector<llvm::Constant *>& secContents,
                                 std::vector<llvm::Type *>& data_section_types,
                                 bool convert_to_callback);
 
+// An entry of a data section, with its symbol resolved, but with no constant
+// made for it yet.
+struct DataSectionItem {
+  enum Kind {
+    kBytes,  // `bytes`.
+    kZeroes,  // `size` zero bytes.
+    kExternal,  // A pointer to `ext`.
+    kFunction,  // A pointer to the lifted function at `addr`.
+    kData,  // A pointer to offset `addr` of `section_var`.
+    kUnknown  // A symbol that isn't understood, and is left out.
+  } kind;
+
+  // The address and symbol of the entry, if it is a symbol.
+  VA base;
+  std::string sym_name;
+
+  uint64_t size;
+  llvm::ArrayRef<uint8_t> bytes;
+  llvm::GlobalValue *ext;
+  VA addr;
+  llvm::GlobalVariable *section_var;
+};
+
+// Resolve the entries of `ds` against `natMod` and `M`, which are only read,
+// so that different sections can be resolved in parallel.
+void resolveDataSectionItems(NativeModulePtr natMod, const DataSection &ds,
+                             llvm::Module *M,
+                             std::vector<DataSectionItem> &items);
+
+// Make the contents of a data section from its resolved `items`. This
+// creates constants, and so must run on the thread that owns `M`.
+void dataSectionItemsToTypesContents(
+    llvm::Module *M, const std::vector<DataSectionItem> &items,
+    std::vector<llvm::Constant *> &secContents,
+    std::vector<llvm::Type *> &data_section_types,
+    bool convert_to_callback);
+
 
 #define OP(x) inst.getOperand(x)
 
-#define ADDR_NOREF(x) \
-    ArchPointerSize(block->getParent()->getParent()) == Pointer32 ? \
-    ADDR_NOREF_IMPL<32>(natM, block, x, ip, inst) :\
-    ADDR_NOREF_IMPL<64>(natM, block, x, ip, inst)
+// The lifters are templates over the address width, `addr_width`, of the
+// code that they lift. `X86InitInstructionDispatch` registers the 32- or
+// 64-bit instantiations.
+#define ADDR_NOREF(x) ADDR_NOREF_IMPL<addr_width>(natM, block, x, ip, inst)
 
 #define CREATE_BLOCK(nm, b) \
     auto block_ ## nm = llvm::BasicBlock::Create( \
         (b)->getContext(), #nm, (b)->getParent())
 
-#define MEM_REFERENCE(which) MEM_AS_DATA_REF(block, natM, inst, ip, which)
+#define MEM_REFERENCE(which) \
+    MEM_AS_DATA_REF<addr_width>(block, natM, inst, ip, which)
 
 #define GENERIC_TRANSLATION_MI(NAME, NOREFS, MEMREF, IMMREF, TWOREFS) \
+    template <int addr_width> \
     static InstTransResult translate_ ## NAME ( \
         TranslationContext &ctx, llvm::BasicBlock *&block) { \
       auto natM = ctx.natM; \
@@ -240,6 +312,7 @@ void dataSectionToTypesContents(const std::list<DataSection> &globaldata,
 
 
 #define GENERIC_TRANSLATION_REF(NAME, NOREFS, HASREF) \
+    template <int addr_width> \
     static InstTransResult translate_ ## NAME ( \
         TranslationContext &ctx, llvm::BasicBlock *&block) { \
       auto natM = ctx.natM; \
@@ -256,6 +329,7 @@ void dataSectionToTypesContents(const std::list<DataSection> &globaldata,
     }
 
 #define GENERIC_TRANSLATION(NAME, NOREFS) \
+    template <int addr_width> \
     static InstTransResult translate_ ## NAME ( \
         TranslationContext &ctx, llvm::BasicBlock *&block) { \
       InstTransResult ret;\
@@ -28,15 +28,37 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <set>
 #include <sstream>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/repeated_field.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 
 #include "CFG.pb.h"  // Auto-generated.
 
 #include "mcsema/Arch/Arch.h"
 #include "mcsema/CFG/CFG.h"
+#include "mcsema/CFG/CFGMap.h"
 
 #include "mcsema/cfgToLLVM/TransExcn.h"
 
@@ -349,12 +371,16 @@ NativeInst::NativeInst(VA v, uint8_t l, const llvm::MCInst &inst, Prefix k)
 DataSectionEntry::DataSectionEntry(uint64_t base, const std::vector<uint8_t> &b)
     : base(base),
       bytes(b),
-      is_symbol(false) {}
+      is_symbol(false),
+      view_data(nullptr),
+      view_size(0) {}
 
 DataSectionEntry::DataSectionEntry(uint64_t base, const std::string &sname)
     : base(base),
       sym_name(sname),
-      is_symbol(true) {
+      is_symbol(true),
+      view_data(nullptr),
+      view_size(0) {
 
   this->bytes.push_back(0x0);
   this->bytes.push_back(0x0);
@@ -367,18 +393,37 @@ DataSectionEntry::DataSectionEntry(uint64_t base, const std::string &sname,
     : base(base),
       bytes(symbol_size),
       sym_name(sname),
-      is_symbol(true) {}
+      is_symbol(true),
+      view_data(nullptr),
+      view_size(0) {}
+
+DataSectionEntry::DataSectionEntry(uint64_t base, const uint8_t *data,
+                                   uint64_t size,
+                                   std::shared_ptr<const void> backing)
+    : base(base),
+      is_symbol(false),
+      view_data(data),
+      view_size(size),
+      backing(backing) {}
 
 uint64_t DataSectionEntry::getBase(void) const {
   return this->base;
 }
 
 uint64_t DataSectionEntry::getSize(void) const {
-  return this->bytes.size();
+  if (this->view_data) {
+    return this->view_size;
+  } else {
+    return this->bytes.size();
+  }
 }
 
-const std::vector<uint8_t> &DataSectionEntry::getBytes(void) const {
-  return this->bytes;
+llvm::ArrayRef<uint8_t> DataSectionEntry::getBytes(void) const {
+  if (this->view_data) {
+    return llvm::makeArrayRef(this->view_data, this->view_size);
+  } else {
+    return this->bytes;
+  }
 }
 
 bool DataSectionEntry::getSymbol(std::string &sname) const {
@@ -394,6 +439,7 @@ DataSectionEntry::~DataSectionEntry(void) {}
 
 DataSection::DataSection(void)
     : base(NO_BASE),
+      size(0),
       read_only(false) {}
 
 DataSection::~DataSection(void) {}
@@ -416,24 +462,20 @@ const std::list<DataSectionEntry> &DataSection::getEntries(void) const {
 
 void DataSection::addEntry(const DataSectionEntry &dse) {
   this->entries.push_back(dse);
+  this->size += dse.getSize();
   if (this->base == NO_BASE || this->base > dse.getBase()) {
     this->base = dse.getBase();
   }
 }
 
 uint64_t DataSection::getSize(void) const {
-  uint64_t size_sum = 0;
-  for (std::list<DataSectionEntry>::const_iterator itr = entries.begin();
-      itr != entries.end(); itr++) {
-    size_sum += itr->getSize();
-  }
-  return size_sum;
+  return this->size;
 }
 
 std::vector<uint8_t> DataSection::getBytes(void) const {
   std::vector<uint8_t> all_bytes;
-  for (const auto entry : entries) {
-    const auto &vec = entry.getBytes();
+  for (const auto &entry : entries) {
+    auto vec = entry.getBytes();
     all_bytes.insert(all_bytes.end(), vec.begin(), vec.end());
   }
   return all_bytes;
@@ -496,7 +538,8 @@ NativeModule::NativeModule(
     const std::string &triple_)
     : funcs(funcs_),
       module_name(module_name_),
-      triple(triple_) {}
+      triple(triple_),
+      data_end(0) {}
 
 VA NativeFunction::get_start(void) {
   return this->funcEntryVA;
@@ -531,11 +574,11 @@ void NativeBlock::add_follow(VA f) {
   this->follows.push_back(f);
 }
 
-std::list<VA> &NativeBlock::get_follows(void) {
+std::vector<VA> &NativeBlock::get_follows(void) {
   return this->follows;
 }
 
-const std::list<NativeInstPtr> &NativeBlock::get_insts(void) {
+const std::vector<NativeInstPtr> &NativeBlock::get_insts(void) {
   return this->instructions;
 }
 
@@ -555,6 +598,58 @@ const std::string &NativeFunction::get_symbol_name(void) {
   return this->funcSymName;
 }
 
+NativeFunction::NativeFunction(VA b)
+    : funcEntryVA(b),
+      return_address_private(false) {}
+
+NativeFunction::NativeFunction(VA b, const std::string &sym)
+    : funcEntryVA(b),
+      funcSymName(sym),
+      return_address_private(false) {}
+
+NativeFunction::~NativeFunction(void) {}
+
+NativeArena &NativeFunction::get_arena(void) {
+  if (!arena) {
+    arena.reset(new NativeArena);
+  }
+  return *arena;
+}
+
+void NativeFunction::release_blocks(void) {
+  blocks.clear();
+  arena.reset();
+}
+
+const std::string &NativeFunction::get_fingerprint(void) const {
+  return fingerprint;
+}
+
+void NativeFunction::set_fingerprint(const std::string &fp) {
+  fingerprint = fp;
+}
+
+bool NativeFunction::return_address_is_private(void) const {
+  return return_address_private;
+}
+
+void NativeFunction::set_return_address_private(bool is_private) {
+  return_address_private = is_private;
+}
+
+NativeInstPtr NativeArena::new_inst(
+    VA v, uint8_t l, const llvm::MCInst &inst, NativeInst::Prefix k) {
+  return new (insts.Allocate()) NativeInst(v, l, inst, k);
+}
+
+NativeBlockPtr NativeArena::new_block(VA base) {
+  return new (blocks.Allocate()) NativeBlock(base);
+}
+
+NativeFunctionPtr NativeArena::new_func(VA entry, const std::string &sym) {
+  return new (funcs.Allocate()) NativeFunction(entry, sym);
+}
+
 std::string NativeBlock::get_name(void) {
   std::stringstream ss;
   ss << "block_" << std::hex << this->baseAddr;
@@ -566,12 +661,14 @@ void NativeModule::addDataSection(VA base, std::vector<uint8_t> &bytes) {
   DataSection ds;
   DataSectionEntry dse(base, bytes);
   ds.addEntry(dse);
-
-  this->data_sections.push_back(ds);
+  addDataSection(ds);
 }
 
 void NativeModule::addDataSection(const DataSection &d) {
   this->data_sections.push_back(d);
+  const auto &ds = this->data_sections.back();
+  this->data_index[ds.getBase()] = {&ds, nullptr};
+  this->data_end = std::max<VA>(this->data_end, ds.getBase() + ds.getSize());
 }
 
 void NativeModule::add_func(NativeFunctionPtr f) {
@@ -591,22 +688,82 @@ const std::list<DataSection> &NativeModule::getData(void) const {
   return this->data_sections;
 }
 
+const DataSection *NativeModule::findDataSection(VA addr) const {
+  auto it = this->data_index.upper_bound(addr);
+  if (it == this->data_index.begin()) {
+    return nullptr;
+  }
+  const auto ds = (--it)->second.section;
+  if (addr - ds->getBase() < ds->getSize()) {
+    return ds;
+  }
+  return nullptr;
+}
+
+VA NativeModule::getDataEnd(void) const {
+  return this->data_end;
+}
+
+void NativeModule::setDataSectionVar(VA base, llvm::GlobalVariable *var) {
+  this->data_index.at(base).var = var;
+}
+
+llvm::GlobalVariable *NativeModule::getDataSectionVar(
+    VA base, llvm::Module *M) const {
+  auto it = this->data_index.find(base);
+  if (it != this->data_index.end() && it->second.var &&
+      it->second.var->getParent() == M) {
+    return it->second.var;
+  }
+
+  // Module shards declare their own copies of the data sections.
+  std::stringstream ss;
+  ss << "data_" << std::hex << base;
+  return M->getNamedGlobal(ss.str());
+}
+
+bool NativeExternals::add_code(ExternalCodeRefPtr p) {
+  if (!code_index.emplace(p->getSymbolName(), p).second) {
+    return false;
+  }
+  code.push_back(p);
+  return true;
+}
+
+bool NativeExternals::add_data(ExternalDataRefPtr p) {
+  if (!data_index.emplace(p->getSymbolName(), p).second) {
+    return false;
+  }
+  data.push_back(p);
+  return true;
+}
+
+ExternalCodeRefPtr NativeExternals::find_code(const std::string &name) const {
+  auto it = code_index.find(name);
+  return it != code_index.end() ? it->second : nullptr;
+}
+
+ExternalDataRefPtr NativeExternals::find_data(const std::string &name) const {
+  auto it = data_index.find(name);
+  return it != data_index.end() ? it->second : nullptr;
+}
+
 //add an external reference
 void NativeModule::addExtCall(ExternalCodeRefPtr p) {
-  this->external_code_refs.push_back(p);
+  this->externals.add_code(p);
 }
 
 const std::list<ExternalCodeRefPtr> &NativeModule::getExtCalls(void) const {
-  return this->external_code_refs;
+  return this->externals.code;
 }
 
 //external data ref
 void NativeModule::addExtDataRef(ExternalDataRefPtr p) {
-  this->external_data_refs.push_back(p);
+  this->externals.add_data(p);
 }
 
 const std::list<ExternalDataRefPtr> &NativeModule::getExtDataRefs(void) const {
-  return this->external_data_refs;
+  return this->externals.data;
 }
 
 const std::vector<NativeEntrySymbol> &NativeModule::getEntryPoints(void) const {
@@ -617,6 +774,18 @@ void NativeModule::addEntryPoint(const NativeEntrySymbol &ep) {
   this->entries.push_back(ep);
 }
 
+bool NativeModule::is_streamed(void) const {
+  return nullptr != stream;
+}
+
+void NativeModule::release_cfg(void) {
+  funcs.clear();
+  if (stream) {
+    stream->funcs.clear();
+  }
+  arena.reset();
+}
+
 bool NativeModule::is64Bit(void) const {
   return 64 == ArchAddressSize();
 }
@@ -643,16 +812,6 @@ NativeInst::CFGRefType deserRefType(::Instruction::RefType k) {
   }
 }
 
-static ExternalCodeRefPtr getExternal(
-    const std::string &s, const std::list<ExternalCodeRefPtr> &extcode) {
-  for (auto e : extcode) {
-    if (s == e->getSymbolName()) {
-      return e;
-    }
-  }
-  return ExternalCodeRefPtr();
-}
-
 enum : size_t {
   kMaxNumInstrBytes = 16ULL  // 15 on x86 and amd64.
 };
@@ -733,18 +892,19 @@ static NativeInst::Prefix GetPrefix(const llvm::MCInst &inst) {
 }
 
 static NativeInstPtr DecodeInst(
-    uintptr_t addr, const std::vector<uint8_t> &bytes) {
+    uintptr_t addr, const uint8_t *bytes, size_t num_bytes, bool cacheable,
+    NativeArena &arena) {
 
   VA nextVA = addr;
   // Get the maximum number of bytes for decoding.
   uint8_t decodable_bytes[kMaxNumInstrBytes] = {};
-  std::copy(bytes.begin(), bytes.end(), decodable_bytes);
-  auto max_size = bytes.size();
+  auto max_size = std::min<size_t>(num_bytes, kMaxNumInstrBytes);
+  std::copy(bytes, bytes + max_size, decodable_bytes);
 
   // Try to decode the instruction.
   llvm::MCInst mcInst;
   auto num_decoded_bytes = ArchDecodeInstruction(
-      decodable_bytes, decodable_bytes + max_size, addr, mcInst);
+      decodable_bytes, decodable_bytes + max_size, addr, mcInst, cacheable);
 
   if (!num_decoded_bytes) {
     std::cerr
@@ -753,7 +913,7 @@ static NativeInstPtr DecodeInst(
     return nullptr;
   }
 
-  NativeInstPtr inst = new NativeInst(
+  NativeInstPtr inst = arena.new_inst(
       addr, num_decoded_bytes, mcInst, GetPrefix(mcInst));
 
   // Mark some operands as being RIP-relative.
@@ -841,15 +1001,24 @@ static NativeInstPtr DecodeInst(
 
 static NativeInstPtr DeserializeInst(
     const ::Instruction &inst,
-    const std::list<ExternalCodeRefPtr> &extcode) {
+    const NativeExternals &externals, NativeArena &arena) {
   VA addr = inst.inst_addr();
   auto tr_tgt = static_cast<VA>(inst.true_target());
   auto fa_tgt = static_cast<VA>(inst.false_target());
-  const auto &bytes_str = inst.inst_bytes();
-  std::vector<uint8_t> bytes(bytes_str.begin(), bytes_str.end());
+  const auto &bytes = inst.inst_bytes();
+
+  // Instructions with references or relocations may decode differently for
+  // the same bytes, so they are never taken from the decode cache.
+  auto cacheable = !inst.has_imm_reference() && !inst.has_mem_reference() &&
+                   !inst.has_imm_reloc_offset() &&
+                   !inst.has_mem_reloc_offset() &&
+                   !inst.has_ext_call_name() && !inst.has_ext_data_name() &&
+                   !inst.has_jump_table() && !inst.has_jump_index_table();
 
   //produce an MCInst from the instruction buffer using the ByteDecoder
-  NativeInstPtr ip = DecodeInst(addr, bytes);
+  NativeInstPtr ip = DecodeInst(
+      addr, reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(),
+      cacheable, arena);
   if (!ip) {
     std::cerr
         << "Unable to deserialize inst at " << std::hex << addr << std::endl;
@@ -865,7 +1034,7 @@ static NativeInstPtr DeserializeInst(
   }
 
   if (inst.has_ext_call_name()) {
-    ExternalCodeRefPtr p = getExternal(inst.ext_call_name(), extcode);
+    auto p = externals.find_code(inst.ext_call_name());
     if (!p) {
       std::cerr
           << "Unable to find external call " << inst.ext_call_name()
@@ -875,8 +1044,13 @@ static NativeInstPtr DeserializeInst(
     ip->set_ext_call_target(p);
   }
 
+  // Only the name of a data reference matters, so references to variables
+  // that aren't in the module's externals get their own.
   if (inst.has_ext_data_name()) {
-    ExternalDataRefPtr p(new ExternalDataRef(inst.ext_data_name()));
+    auto p = externals.find_data(inst.ext_data_name());
+    if (!p) {
+      p = new ExternalDataRef(inst.ext_data_name());
+    }
     ip->set_ext_data_ref(p);
   }
 
@@ -960,13 +1134,13 @@ static NativeInstPtr DeserializeInst(
 
 static NativeBlockPtr DeserializeBlock(
     const ::Block &block,
-    const std::list<ExternalCodeRefPtr> &extcode) {
+    const NativeExternals &externals, NativeArena &arena) {
 
   auto block_va = static_cast<VA>(block.base_address());
-  NativeBlockPtr natB = NativeBlockPtr(new NativeBlock(block_va));
+  NativeBlockPtr natB = arena.new_block(block_va);
 
   for (auto &inst : block.insts()) {
-    auto native_inst = DeserializeInst(inst, extcode);
+    auto native_inst = DeserializeInst(inst, externals, arena);
     if (!native_inst) {
       std::cerr
           << "Unable to deserialize block at " << std::hex
@@ -977,6 +1151,7 @@ static NativeBlockPtr DeserializeBlock(
   }
 
   /* add the follows */
+  natB->get_follows().reserve(block.block_follows_size());
   for (auto &succ : block.block_follows()) {
     natB->add_follow(succ);
   }
@@ -984,30 +1159,61 @@ static NativeBlockPtr DeserializeBlock(
   return natB;
 }
 
-static NativeFunctionPtr DeserializeNativeFunc(
-    const ::Function &func,
-    const std::list<ExternalCodeRefPtr> &extcode) {
+// The blocks and instructions are allocated in the function's own arena, so
+// that they can be freed as soon as the function has been lifted.
+static bool DeserializeNativeFuncBlocks(
+    const ::Function &func, NativeFunctionPtr nf,
+    const NativeExternals &externals) {
 
-  NativeFunction *nf = nullptr;
-  if (func.has_symbol_name() && !func.symbol_name().empty()) {
-    nf = new NativeFunction(func.entry_address(), func.symbol_name());
-  } else {
-    nf = new NativeFunction(func.entry_address());
-  }
+  auto &arena = nf->get_arena();
 
   //read all the blocks from this function
   for (auto &block : func.blocks()) {
-    auto native_block = DeserializeBlock(block, extcode);
+    auto native_block = DeserializeBlock(block, externals, arena);
     if (!native_block) {
       std::cerr
           << "Unable to deserialize function at " << std::hex
           << func.entry_address() << std::endl;
-      return nullptr;
+      return false;
     }
     nf->add_block(native_block);
   }
+  return true;
+}
+
+static bool gFingerprintFunctions = false;
+
+// Returns the hash of a serialized `::Function`.
+static std::string FingerprintFunction(const void *data, size_t size) {
+  llvm::MD5 hasher;
+  hasher.update(llvm::ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(data), size));
+  llvm::MD5::MD5Result result;
+  hasher.final(result);
+  llvm::SmallString<32> str;
+  llvm::MD5::stringifyResult(result, str);
+  return str.str();
+}
+
+static NativeFunctionPtr DeserializeNativeFunc(
+    const ::Function &func,
+    const NativeExternals &externals, NativeArena &arena) {
+
+  NativeFunctionPtr nf = arena.new_func(
+      func.entry_address(),
+      func.has_symbol_name() ? func.symbol_name() : "");
+
+  if (!DeserializeNativeFuncBlocks(func, nf, externals)) {
+    return nullptr;
+  }
+
+  if (gFingerprintFunctions) {
+    auto serialized = func.SerializeAsString();
+    nf->set_fingerprint(
+        FingerprintFunction(serialized.data(), serialized.size()));
+  }
 
-  return NativeFunctionPtr(nf);
+  return nf;
 }
 
 static ExternalCodeRef::CallingConvention DeserializeCallingConvention(
@@ -1053,6 +1259,7 @@ static ExternalCodeRefPtr DeserializeExternFunc(const ::ExternalFunction &f) {
   ExternalCodeRefPtr ext = ExternalCodeRefPtr(
       new ExternalCodeRef(symName, argCount, c, retTy));
   ext->setWeak(f.is_weak());
+  ext->setDirect(f.is_direct());
 
   return ext;
 }
@@ -1137,84 +1344,244 @@ static void DeserializeData(const ::Data &d, DataSection &ds) {
   }
 }
 
-NativeModulePtr ReadProtoBuf(const std::string &file_name) {
-  GOOGLE_PROTOBUF_VERIFY_VERSION;
+static MCSOffsetTablePtr DeserializeOffsetTable(
+    const ::OffsetTable &offset_table) {
+  std::vector<std::pair<VA, VA>> v;
+  for (auto j = 0; j < offset_table.table_offsets_size(); j++) {
+    v.push_back(
+        std::make_pair<VA, VA>(offset_table.table_offsets(j),
+            offset_table.destinations(j)));
+  }
 
-  NativeModulePtr m = nullptr;
-  ::Module proto;
+  return MCSOffsetTablePtr(
+      new MCSOffsetTable(v, 0, offset_table.start_addr()));
+}
+
+static NativeEntrySymbol DeserializeEntrySymbol(
+    const ::EntrySymbol &entry_symbol) {
+  NativeEntrySymbol native_es(
+      entry_symbol.entry_name(),
+      entry_symbol.entry_address());
+
+  if (entry_symbol.has_entry_extra()) {
+    const auto &ese = entry_symbol.entry_extra();
+    auto c = DeserializeCallingConvention(ese.entry_cconv());
+    native_es.setExtra(ese.entry_argc(), ese.does_return(), c);
+  }
+  return native_es;
+}
+
+void EnableFunctionFingerprints(void) {
+  gFingerprintFunctions = true;
+}
+
+namespace {
 
-  std::ifstream fstream(file_name, std::ios::binary);
-  if (!fstream.good()) {
+// Returns the path of a shard listed in the manifest `manifest_name`. Shard
+// paths are relative to the directory of the manifest.
+static std::string ShardPath(const std::string &manifest_name,
+                             const std::string &shard_name) {
+  if (llvm::sys::path::is_absolute(shard_name)) {
+    return shard_name;
+  }
+  llvm::SmallString<256> path(llvm::sys::path::parent_path(manifest_name));
+  llvm::sys::path::append(path, shard_name);
+  return path.str();
+}
+
+// Parse the module in `file_name`. Unlike `ParseFromIstream`, this isn't
+// subject to protobuf's default 64 MB message size limit.
+static bool ParseModuleFile(const std::string &file_name, ::Module &proto) {
+  auto file = llvm::MemoryBuffer::getFile(file_name, -1, false);
+  if (!file) {
     std::cerr << "Failed to open file " << file_name << std::endl;
-    return m;
+    return false;
+  }
+
+  auto size = file.get()->getBufferSize();
+  if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    std::cerr << "CFG file " << file_name << " is too big" << std::endl;
+    return false;
+  }
+
+  google::protobuf::io::CodedInputStream stream(
+      reinterpret_cast<const uint8_t *>(file.get()->getBufferStart()),
+      static_cast<int>(size));
+  stream.SetTotalBytesLimit(std::numeric_limits<int>::max(), -1);
+  if (!proto.ParseFromCodedStream(&stream)) {
+    std::cerr << "Failed to deserialize protobuf module " << file_name
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Parse the modules in `file_names`, and in all of the shards that they list,
+// into `protos`. Each round of files is parsed in parallel.
+static bool ParseModuleFiles(const std::vector<std::string> &file_names,
+                             std::list< ::Module> &protos) {
+  std::set<std::string> seen(file_names.begin(), file_names.end());
+  std::vector<std::string> round(file_names.begin(), file_names.end());
+
+  while (!round.empty()) {
+    std::vector< ::Module> parsed(round.size());
+    std::vector<char> ok(round.size(), 0);
+    std::atomic<size_t> next(0);
+
+    auto parse = [&] (void) {
+      for (auto i = next++; i < round.size(); i = next++) {
+        ok[i] = ParseModuleFile(round[i], parsed[i]);
+      }
+    };
+
+    auto num_threads = std::min<size_t>(
+        round.size(), std::max(1U, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; ++i) {
+      threads.emplace_back(parse);
+    }
+    parse();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    std::vector<std::string> next_round;
+    for (size_t i = 0; i < round.size(); ++i) {
+      if (!ok[i]) {
+        return false;
+      }
+      for (const auto &shard : parsed[i].shard_files()) {
+        auto shard_path = ShardPath(round[i], shard);
+        if (seen.insert(shard_path).second) {
+          next_round.push_back(shard_path);
+        }
+      }
+      protos.emplace_back();
+      protos.back().Swap(&(parsed[i]));
+    }
+    round.swap(next_round);
   }
+  return true;
+}
+
+// Free the elements of `field`. Unlike `Clear`, which keeps the cleared
+// elements around for reuse, this gives their memory back.
+template <typename T>
+static void ReleaseField(google::protobuf::RepeatedPtrField<T> *field) {
+  google::protobuf::RepeatedPtrField<T> empty;
+  field->Swap(&empty);
+}
 
-  //read the protobuf object in
-  if (!proto.ParseFromIstream(&fstream)) {
-    std::cerr << "Failed to deserialize protobuf module" << std::endl;
+// Returns true if `file_names` is a memory-mapped CFG container (see
+// `CFGMap.h`) instead of protobuf files.
+static bool IsCFGMapInput(const std::vector<std::string> &file_names);
+
+// Read the memory-mapped CFG container in `file_names`. If `stream_funcs` is
+// true, then the blocks of the functions are left in the file, like with
+// `ReadProtoBufHeader`.
+static NativeModulePtr ReadCFGMap(const std::vector<std::string> &file_names,
+                                  bool stream_funcs);
+
+}  // namespace
+
+NativeModulePtr ReadProtoBuf(const std::vector<std::string> &file_names) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  if (IsCFGMapInput(file_names)) {
+    return ReadCFGMap(file_names, false);
+  }
+
+  NativeModulePtr m = nullptr;
+
+  // The manifest and shards of a sharded CFG are all merged into one module.
+  std::list< ::Module> protos;
+  if (!ParseModuleFiles(file_names, protos)) {
     return m;
   }
 
+  std::unique_ptr<NativeArena> arena(new NativeArena);
   std::unordered_map<VA, NativeFunctionPtr> native_funcs;
-  std::list<ExternalCodeRefPtr> extern_funcs;
-  std::list<ExternalDataRefPtr> extern_data;
+  NativeExternals externals;
   std::list<DataSection> data_sections;
   std::list<MCSOffsetTablePtr> offset_tables;
+  std::vector<NativeEntrySymbol> entries;
+  std::string module_name;
+
+  std::set<VA> data_bases;
 
+  // Each part of the protobuf tree is freed as soon as it has been converted,
+  // so that the whole CFG is only ever held in one representation. The
+  // externals are indexed first, so that every instruction that refers to
+  // one is resolved with a single lookup.
   std::cerr << "Deserializing externs..." << std::endl;
-  for (const auto &external_func : proto.external_funcs()) {
-    extern_funcs.push_back(DeserializeExternFunc(external_func));
+  for (auto &proto : protos) {
+    for (const auto &external_func : proto.external_funcs()) {
+      if (!externals.find_code(external_func.symbol_name())) {
+        externals.add_code(DeserializeExternFunc(external_func));
+      }
+    }
+    ReleaseField(proto.mutable_external_funcs());
+
+    for (const auto &external_data_elem : proto.external_data()) {
+      if (!externals.find_data(external_data_elem.symbol_name())) {
+        externals.add_data(DeserializeExternData(external_data_elem));
+      }
+    }
+    ReleaseField(proto.mutable_external_data());
   }
 
   std::cerr << "Deserializing functions..." << std::endl;
-  for (const auto &internal_func : proto.internal_funcs()) {
-    auto natf = DeserializeNativeFunc(internal_func, extern_funcs);
-    if (!natf) {
-      std::cerr << "Unable to deserialize module." << std::endl;
-      return nullptr;
+  for (auto &proto : protos) {
+    for (auto &internal_func : *proto.mutable_internal_funcs()) {
+      auto ea = static_cast<VA>(internal_func.entry_address());
+      if (native_funcs.count(ea)) {
+        std::cerr << "Ignoring duplicate function at " << std::hex << ea
+                  << std::dec << std::endl;
+        continue;
+      }
+      auto natf = DeserializeNativeFunc(internal_func, externals, *arena);
+      if (!natf) {
+        std::cerr << "Unable to deserialize module." << std::endl;
+        return nullptr;
+      }
+      native_funcs[ea] = natf;
+      ReleaseField(internal_func.mutable_blocks());
     }
-    native_funcs[static_cast<VA>(internal_func.entry_address())] = natf;
+    ReleaseField(proto.mutable_internal_funcs());
   }
 
   std::cerr << "Deserializing data..." << std::endl;
-  for (auto &internal_data_elem : proto.internal_data()) {
-    DataSection ds;
-    DeserializeData(internal_data_elem, ds);
-    data_sections.push_back(ds);
-  }
+  for (auto &proto : protos) {
+    if (module_name.empty()) {
+      module_name = proto.module_name();
+    }
 
-  std::cerr << "Deserializing external data..." << std::endl;
-  for (const auto &exteral_data_elem : proto.external_data()) {
-    extern_data.push_back(DeserializeExternData(exteral_data_elem));
-  }
+    for (auto &internal_data_elem : proto.internal_data()) {
+      if (data_bases.insert(internal_data_elem.base_address()).second) {
+        DataSection ds;
+        DeserializeData(internal_data_elem, ds);
+        data_sections.push_back(std::move(ds));
+      }
+    }
+    ReleaseField(proto.mutable_internal_data());
 
-  for (const auto &offset_table : proto.offset_tables()) {
-    std::vector<std::pair<VA, VA>> v;
-    for (auto j = 0; j < offset_table.table_offsets_size(); j++) {
-      v.push_back(
-          std::make_pair<VA, VA>(offset_table.table_offsets(j),
-              offset_table.destinations(j)));
+    for (const auto &offset_table : proto.offset_tables()) {
+      offset_tables.push_back(DeserializeOffsetTable(offset_table));
     }
 
-    MCSOffsetTablePtr t(new MCSOffsetTable(v, 0, offset_table.start_addr()));
-    offset_tables.push_back(t);
+    for (const auto &entry_symbol : proto.entries()) {
+      entries.push_back(DeserializeEntrySymbol(entry_symbol));
+    }
   }
 
+  // The parsed protobuf modules aren't needed anymore.
+  protos.clear();
+
   std::cerr << "Creating module..." << std::endl;
   m = NativeModulePtr(
-      new NativeModule(proto.module_name(), native_funcs, ArchTriple()));
-
-  //populate the module with externals calls
-  std::cerr << "Adding external funcs..." << std::endl;
-  for (auto &extern_func_call : extern_funcs) {
-    m->addExtCall(extern_func_call);
-  }
-
-  //populate the module with externals data
-  std::cerr << "Adding external data..." << std::endl;
-  for (auto &extern_data_ref : extern_data) {
-    m->addExtDataRef(extern_data_ref);
-  }
+      new NativeModule(module_name, native_funcs, ArchTriple()));
+  m->arena = std::move(arena);
+  m->externals = std::move(externals);
 
   //populate the module with internal data
   std::cerr << "Adding internal data..." << std::endl;
@@ -1227,19 +1594,787 @@ NativeModulePtr ReadProtoBuf(const std::string &file_name) {
 
   // set entry points for the module
   std::cerr << "Adding entry points..." << std::endl;
-  for (const auto &entry_symbol : proto.entries()) {
-    NativeEntrySymbol native_es(
-        entry_symbol.entry_name(),
-        entry_symbol.entry_address());
-
-    if (entry_symbol.has_entry_extra()) {
-      const auto &ese = entry_symbol.entry_extra();
-      auto c = DeserializeCallingConvention(ese.entry_cconv());
-      native_es.setExtra(ese.entry_argc(), ese.does_return(), c);
+  for (const auto &entry_symbol : entries) {
+    m->addEntryPoint(entry_symbol);
+  }
+
+  std::cerr << "Returning modue..." << std::endl;
+  return m;
+}
+
+class CFGMapFile;
+
+// A memory-mapped CFG file, and the location of the serialized functions
+// within it.
+class CFGStream {
+ public:
+  struct FunctionRange {
+    NativeFunctionPtr func;
+    const uint8_t *data;
+    int size;
+  };
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> files;
+  std::vector<FunctionRange> funcs;
+
+  // Set if the functions are `CFGMapFunction` records of a memory-mapped CFG
+  // container, rather than serialized `::Function`s.
+  std::shared_ptr<CFGMapFile> map;
+};
+
+namespace {
+
+// A length-delimited field of a serialized message.
+struct MessageField {
+  int number;
+  const uint8_t *data;
+  int size;
+};
+
+// Find the length-delimited fields of the serialized message in `data`
+// without parsing them.
+static bool ScanMessageFields(const uint8_t *data, size_t size,
+                              std::vector<MessageField> &fields) {
+  using WireFormatLite = google::protobuf::internal::WireFormatLite;
+
+  if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+    std::cerr << "CFG file is too big to stream" << std::endl;
+    return false;
+  }
+
+  google::protobuf::io::CodedInputStream stream(data, static_cast<int>(size));
+  stream.SetTotalBytesLimit(std::numeric_limits<int>::max(), -1);
+
+  while (auto tag = stream.ReadTag()) {
+    if (WireFormatLite::WIRETYPE_LENGTH_DELIMITED !=
+        WireFormatLite::GetTagWireType(tag)) {
+      if (!WireFormatLite::SkipField(&stream, tag)) {
+        return false;
+      }
+      continue;
+    }
+
+    uint32_t field_size = 0;
+    if (!stream.ReadVarint32(&field_size)) {
+      return false;
+    }
+
+    auto field_data = data + stream.CurrentPosition();
+    if (!stream.Skip(static_cast<int>(field_size))) {
+      return false;
+    }
+
+    fields.push_back({WireFormatLite::GetTagFieldNumber(tag), field_data,
+                      static_cast<int>(field_size)});
+  }
+  return stream.ConsumedEntireMessage();
+}
+
+// Create a function that has the entry address and symbol name of the
+// serialized `::Function` in `data`, but none of its blocks.
+static NativeFunctionPtr ReadFunctionHeader(const uint8_t *data, int size,
+                                            NativeArena &arena) {
+  using WireFormatLite = google::protobuf::internal::WireFormatLite;
+
+  google::protobuf::io::CodedInputStream stream(data, size);
+  google::protobuf::uint64 entry_address = 0;
+  std::string symbol_name;
+  auto has_entry_address = false;
+
+  while (auto tag = stream.ReadTag()) {
+    switch (WireFormatLite::GetTagFieldNumber(tag)) {
+      case ::Function::kEntryAddressFieldNumber:
+        if (!stream.ReadVarint64(&entry_address)) {
+          return nullptr;
+        }
+        has_entry_address = true;
+        break;
+
+      case ::Function::kSymbolNameFieldNumber:
+        if (!WireFormatLite::ReadString(&stream, &symbol_name)) {
+          return nullptr;
+        }
+        break;
+
+      default:
+        if (!WireFormatLite::SkipField(&stream, tag)) {
+          return nullptr;
+        }
+        break;
+    }
+  }
+
+  if (!has_entry_address) {
+    return nullptr;
+  } else {
+    return arena.new_func(entry_address, symbol_name);
+  }
+}
+
+}  // namespace
+
+// A memory-mapped CFG container. The header and the tables are checked when
+// the file is opened, and every extent of the byte pool when it is used.
+class CFGMapFile {
+ public:
+  bool Open(const std::string &file_name) {
+    auto file = llvm::MemoryBuffer::getFile(file_name, -1, false);
+    if (!file) {
+      std::cerr << "Failed to open file " << file_name << std::endl;
+      return false;
+    }
+    buffer = std::move(file.get());
+    data = reinterpret_cast<const uint8_t *>(buffer->getBufferStart());
+    size = buffer->getBufferSize();
+
+    if (size < sizeof(CFGMapHeader) ||
+        memcmp(data, MCSEMA_CFG_MAP_MAGIC, sizeof(header->magic))) {
+      std::cerr << file_name << " is not a CFG map" << std::endl;
+      return false;
+    }
+
+    header = reinterpret_cast<const CFGMapHeader *>(data);
+    if (MCSEMA_CFG_MAP_VERSION != header->version) {
+      std::cerr << "Unsupported version " << header->version
+                << " of CFG map " << file_name << std::endl;
+      return false;
+    }
+
+    if (reinterpret_cast<uintptr_t>(data) % 8 ||
+        !CheckTable(header->bytes, 1) ||
+        !CheckTable(header->funcs, sizeof(CFGMapFunction)) ||
+        !CheckTable(header->blocks, sizeof(CFGMapBlock)) ||
+        !CheckTable(header->insts, sizeof(CFGMapInst)) ||
+        !CheckTable(header->follows, sizeof(uint64_t)) ||
+        !CheckTable(header->jump_tables, sizeof(CFGMapJumpTable)) ||
+        !CheckTable(header->jump_table_entries, sizeof(uint64_t)) ||
+        !CheckTable(header->jump_index_tables,
+                    sizeof(CFGMapJumpIndexTable)) ||
+        !CheckTable(header->data, sizeof(CFGMapData)) ||
+        !CheckTable(header->data_symbols, sizeof(CFGMapDataSymbol)) ||
+        !CheckTable(header->external_funcs, sizeof(CFGMapExternalFunction)) ||
+        !CheckTable(header->external_data, sizeof(CFGMapExternalData)) ||
+        !CheckTable(header->entries, sizeof(CFGMapEntrySymbol)) ||
+        !CheckTable(header->offset_tables, sizeof(CFGMapOffsetTable)) ||
+        !CheckTable(header->offset_table_entries,
+                    sizeof(CFGMapOffsetTableEntry))) {
+      std::cerr << "Malformed CFG map " << file_name << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Returns the records `[first, first + count)` of `table`.
+  template <typename T>
+  llvm::ArrayRef<T> Records(
+      const CFGMapTable &table, uint64_t first = 0,
+      uint64_t count = std::numeric_limits<uint64_t>::max()) const {
+    if (std::numeric_limits<uint64_t>::max() == count) {
+      count = table.count;
+    }
+    if (first > table.count || count > table.count - first) {
+      throw TErr(__LINE__, __FILE__, "CFG map record is out of bounds");
+    }
+    return llvm::makeArrayRef(
+        reinterpret_cast<const T *>(data + table.offset) + first, count);
+  }
+
+  const uint8_t *Bytes(const CFGMapBytes &bytes) const {
+    if (bytes.offset > header->bytes.count ||
+        bytes.size > header->bytes.count - bytes.offset) {
+      throw TErr(__LINE__, __FILE__, "CFG map bytes are out of bounds");
+    }
+    return data + header->bytes.offset + bytes.offset;
+  }
+
+  std::string String(const CFGMapBytes &bytes) const {
+    return std::string(reinterpret_cast<const char *>(Bytes(bytes)),
+                       bytes.size);
+  }
+
+  // The mapped file, which data sections refer to.
+  std::shared_ptr<llvm::MemoryBuffer> buffer;
+  const CFGMapHeader *header;
+
+ private:
+  bool CheckTable(const CFGMapTable &table, uint64_t record_size) const {
+    return !(table.offset % 8) && table.offset <= size &&
+           table.count <= (size - table.offset) / record_size;
+  }
+
+  const uint8_t *data;
+  uint64_t size;
+};
+
+namespace {
+
+static NativeInstPtr DeserializeMapInst(
+    const CFGMapFile &map, const CFGMapInst &inst,
+    const NativeExternals &externals, NativeArena &arena) {
+  VA addr = inst.inst_addr;
+  auto flags = inst.flags;
+
+  auto cacheable = !(flags & (kCFGMapHasImmReference | kCFGMapHasMemReference |
+                              kCFGMapHasImmRelocOffset |
+                              kCFGMapHasMemRelocOffset | kCFGMapHasJumpTable |
+                              kCFGMapHasJumpIndexTable)) &&
+                   !inst.ext_call_name.size && !inst.ext_data_name.size;
+
+  NativeInstPtr ip = DecodeInst(addr, map.Bytes(inst.inst_bytes),
+                                inst.inst_bytes.size, cacheable, arena);
+  if (!ip) {
+    std::cerr
+        << "Unable to deserialize inst at " << std::hex << addr << std::endl;
+    return nullptr;
+  }
+
+  if ((flags & kCFGMapHasTrueTarget) && inst.true_target) {
+    ip->set_tr(inst.true_target);
+  }
+
+  if ((flags & kCFGMapHasFalseTarget) && inst.false_target) {
+    ip->set_fa(inst.false_target);
+  }
+
+  if (inst.ext_call_name.size) {
+    auto name = map.String(inst.ext_call_name);
+    auto p = externals.find_code(name);
+    if (!p) {
+      std::cerr
+          << "Unable to find external call " << name << " for inst at "
+          << std::hex << addr << std::endl;
+      return nullptr;
+    }
+    ip->set_ext_call_target(p);
+  }
+
+  if (inst.ext_data_name.size) {
+    auto name = map.String(inst.ext_data_name);
+    auto p = externals.find_data(name);
+    if (!p) {
+      p = new ExternalDataRef(name);
+    }
+    ip->set_ext_data_ref(p);
+  }
+
+  if (flags & kCFGMapHasImmReference) {
+    NativeInst::CFGRefType rt;
+    if (flags & kCFGMapHasImmRefType) {
+      rt = deserRefType(static_cast< ::Instruction::RefType>(
+          inst.imm_ref_type));
+    }
+    ip->set_ref_reloc_type(
+        NativeInst::IMMRef, inst.imm_reference,
+        (flags & kCFGMapHasImmRelocOffset) ? inst.imm_reloc_offset : 0, rt);
+  }
+
+  if (flags & kCFGMapHasMemReference) {
+    NativeInst::CFGRefType rt;
+    if (flags & kCFGMapHasMemRefType) {
+      rt = deserRefType(static_cast< ::Instruction::RefType>(
+          inst.mem_ref_type));
+    }
+    ip->set_ref_reloc_type(
+        NativeInst::MEMRef, inst.mem_reference,
+        (flags & kCFGMapHasMemRelocOffset) ? inst.mem_reloc_offset : 0, rt);
+  }
+
+  const auto &header = *(map.header);
+  if (flags & kCFGMapHasJumpTable) {
+    const auto &jmp_tbl = map.Records<CFGMapJumpTable>(
+        header.jump_tables, inst.jump_table, 1)[0];
+    auto entries = map.Records<uint64_t>(
+        header.jump_table_entries, jmp_tbl.first_entry, jmp_tbl.num_entries);
+    std::vector<VA> table_entries(entries.begin(), entries.end());
+    auto jmp = new MCSJumpTable(table_entries, jmp_tbl.zero_offset,
+                                static_cast<VA>(jmp_tbl.offset_from_data));
+    ip->set_jump_table(MCSJumpTablePtr(jmp));
+  }
+
+  if (flags & kCFGMapHasJumpIndexTable) {
+    const auto &idx_tbl = map.Records<CFGMapJumpIndexTable>(
+        header.jump_index_tables, inst.jump_index_table, 1)[0];
+    auto tbl_data = map.Bytes(idx_tbl.table_entries);
+    std::vector<uint8_t> tbl_bytes(
+        tbl_data, tbl_data + idx_tbl.table_entries.size);
+    auto idx = new JumpIndexTable(tbl_bytes, idx_tbl.zero_offset);
+    ip->set_jump_index_table(JumpIndexTablePtr(idx));
+  }
+
+  if (flags & kCFGMapHasSystemCallNumber) {
+    ip->set_system_call_number(inst.system_call_number);
+  }
+
+  if (flags & kCFGMapLocalNoReturn) {
+    ip->set_local_noreturn();
+  }
+
+  if (flags & kCFGMapHasOffsetTable) {
+    ip->offset_table = inst.offset_table_addr;
+  }
+
+  return ip;
+}
+
+static bool DeserializeMapFuncBlocks(
+    const CFGMapFile &map, const CFGMapFunction &func, NativeFunctionPtr nf,
+    const NativeExternals &externals) {
+
+  auto &arena = nf->get_arena();
+  const auto &header = *(map.header);
+  for (const auto &block : map.Records<CFGMapBlock>(
+           header.blocks, func.first_block, func.num_blocks)) {
+    NativeBlockPtr natB = arena.new_block(block.base_address);
+    for (const auto &inst : map.Records<CFGMapInst>(
+             header.insts, block.first_inst, block.num_insts)) {
+      auto native_inst = DeserializeMapInst(map, inst, externals, arena);
+      if (!native_inst) {
+        std::cerr
+            << "Unable to deserialize function at " << std::hex
+            << func.entry_address << std::endl;
+        return false;
+      }
+      natB->add_inst(native_inst);
+    }
+
+    auto follows = map.Records<uint64_t>(
+        header.follows, block.first_follow, block.num_follows);
+    natB->get_follows().assign(follows.begin(), follows.end());
+    nf->add_block(natB);
+  }
+  return true;
+}
+
+// Returns the hash of the records of `func`, and of the bytes that they
+// refer to.
+static std::string FingerprintMapFunction(const CFGMapFile &map,
+                                          const CFGMapFunction &func) {
+  const auto &header = *(map.header);
+  llvm::MD5 hasher;
+  auto update = [&hasher] (const void *data, size_t size) {
+    hasher.update(llvm::ArrayRef<uint8_t>(
+        reinterpret_cast<const uint8_t *>(data), size));
+  };
+
+  update(&func.entry_address, sizeof(func.entry_address));
+  update(map.Bytes(func.symbol_name), func.symbol_name.size);
+  for (const auto &block : map.Records<CFGMapBlock>(
+           header.blocks, func.first_block, func.num_blocks)) {
+    update(&block.base_address, sizeof(block.base_address));
+    auto follows = map.Records<uint64_t>(
+        header.follows, block.first_follow, block.num_follows);
+    update(follows.data(), follows.size() * sizeof(uint64_t));
+
+    for (const auto &inst : map.Records<CFGMapInst>(
+             header.insts, block.first_inst, block.num_insts)) {
+      update(&inst, sizeof(inst));
+      update(map.Bytes(inst.inst_bytes), inst.inst_bytes.size);
+      update(map.Bytes(inst.ext_call_name), inst.ext_call_name.size);
+      update(map.Bytes(inst.ext_data_name), inst.ext_data_name.size);
+      if (inst.flags & kCFGMapHasJumpTable) {
+        const auto &jmp_tbl = map.Records<CFGMapJumpTable>(
+            header.jump_tables, inst.jump_table, 1)[0];
+        auto entries = map.Records<uint64_t>(
+            header.jump_table_entries, jmp_tbl.first_entry,
+            jmp_tbl.num_entries);
+        update(entries.data(), entries.size() * sizeof(uint64_t));
+      }
+      if (inst.flags & kCFGMapHasJumpIndexTable) {
+        const auto &idx_tbl = map.Records<CFGMapJumpIndexTable>(
+            header.jump_index_tables, inst.jump_index_table, 1)[0];
+        update(map.Bytes(idx_tbl.table_entries), idx_tbl.table_entries.size);
+      }
+    }
+  }
+
+  llvm::MD5::MD5Result result;
+  hasher.final(result);
+  llvm::SmallString<32> str;
+  llvm::MD5::stringifyResult(result, str);
+  return str.str();
+}
+
+// Split the contents of `d` into blobs and symbols, like `DeserializeData`.
+// The blobs refer to the bytes in the mapped file.
+static void DeserializeMapData(const std::shared_ptr<CFGMapFile> &map,
+                               const CFGMapData &d, DataSection &ds) {
+  auto bytes = map->Bytes(d.data);
+  uint64_t base_address = d.base_address;
+  uint64_t end_address = base_address + d.data.size;
+  uint64_t cur_pos = base_address;
+
+  ds.setReadOnly(0 != d.read_only);
+
+  auto add_blob = [&] (uint64_t begin, uint64_t end) {
+    ds.addEntry(DataSectionEntry(begin, bytes + (begin - base_address),
+                                 end - begin, map->buffer));
+  };
+
+  // assumes symbols are in-order
+  for (const auto &sym : map->Records<CFGMapDataSymbol>(
+           map->header->data_symbols, d.first_symbol, d.num_symbols)) {
+    DataSectionEntry dse_sym(sym.base_address, map->String(sym.symbol_name),
+                             sym.symbol_size);
+    if (sym.base_address > cur_pos) {
+      add_blob(cur_pos, std::min(sym.base_address, end_address));
+    } else if (sym.base_address < cur_pos) {
+      throw TErr(__LINE__, __FILE__, "Deserialized an out-of-order symbol!");
+    }
+    ds.addEntry(dse_sym);
+    cur_pos = sym.base_address + sym.symbol_size;
+  }
+
+  // there is a data blob after the last symbol
+  // or there are no symbols
+  if (cur_pos < end_address) {
+    add_blob(cur_pos, end_address);
+  }
+}
+
+static bool IsCFGMapFile(const std::string &file_name) {
+  char magic[sizeof(CFGMapHeader::magic)] = {};
+  std::ifstream file(file_name, std::ios::binary);
+  return file.read(magic, sizeof(magic)) &&
+         !memcmp(magic, MCSEMA_CFG_MAP_MAGIC, sizeof(magic));
+}
+
+static bool IsCFGMapInput(const std::vector<std::string> &file_names) {
+  for (const auto &file_name : file_names) {
+    if (IsCFGMapFile(file_name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static NativeModulePtr ReadCFGMap(const std::vector<std::string> &file_names,
+                                  bool stream_funcs) {
+  if (1 != file_names.size()) {
+    std::cerr << "A CFG map can't be combined with other CFG files"
+              << std::endl;
+    return nullptr;
+  }
+
+  auto map = std::make_shared<CFGMapFile>();
+  if (!map->Open(file_names[0])) {
+    return nullptr;
+  }
+  const auto &header = *(map->header);
+
+  std::cerr << "Deserializing externs..." << std::endl;
+  NativeExternals externals;
+  for (const auto &f : map->Records<CFGMapExternalFunction>(
+           header.external_funcs)) {
+    auto name = map->String(f.symbol_name);
+    if (externals.find_code(name)) {
+      continue;
+    }
+    auto retTy = ExternalCodeRef::VoidTy;
+    if (f.flags & kCFGMapNoReturn) {
+      retTy = ExternalCodeRef::NoReturn;
+    } else if (f.flags & kCFGMapHasReturn) {
+      retTy = ExternalCodeRef::IntTy;
+    }
+    auto ext = new ExternalCodeRef(
+        name, f.argument_count,
+        DeserializeCallingConvention(
+            static_cast< ::ExternalFunction::CallingConvention>(
+                f.calling_convention)),
+        retTy);
+    ext->setWeak(0 != (f.flags & kCFGMapIsWeak));
+    ext->setDirect(0 != (f.flags & kCFGMapIsDirect));
+    externals.add_code(ext);
+  }
+
+  for (const auto &ed : map->Records<CFGMapExternalData>(
+           header.external_data)) {
+    auto name = map->String(ed.symbol_name);
+    if (!externals.find_data(name)) {
+      auto ext = new ExternalDataRef(name, static_cast<size_t>(ed.data_size));
+      ext->setWeak(0 != ed.is_weak);
+      externals.add_data(ext);
+    }
+  }
+
+  std::cerr << "Deserializing functions..." << std::endl;
+  std::shared_ptr<CFGStream> stream;
+  if (stream_funcs) {
+    stream.reset(new CFGStream);
+    stream->map = map;
+  }
+
+  std::unique_ptr<NativeArena> arena(new NativeArena);
+  std::unordered_map<VA, NativeFunctionPtr> native_funcs;
+  for (const auto &func : map->Records<CFGMapFunction>(header.funcs)) {
+    if (native_funcs.count(func.entry_address)) {
+      std::cerr << "Ignoring duplicate function at " << std::hex
+                << func.entry_address << std::dec << std::endl;
+      continue;
+    }
+
+    auto natf = arena->new_func(func.entry_address,
+                                map->String(func.symbol_name));
+    if (gFingerprintFunctions) {
+      natf->set_fingerprint(FingerprintMapFunction(*map, func));
+    }
+
+    if (stream) {
+      stream->funcs.push_back({natf, reinterpret_cast<const uint8_t *>(&func),
+                               static_cast<int>(sizeof(func))});
+    } else if (!DeserializeMapFuncBlocks(*map, func, natf, externals)) {
+      std::cerr << "Unable to deserialize module." << std::endl;
+      return nullptr;
+    }
+    native_funcs[func.entry_address] = natf;
+  }
+
+  std::cerr << "Creating module..." << std::endl;
+  NativeModulePtr m = new NativeModule(map->String(header.module_name),
+                                       native_funcs, ArchTriple());
+  m->stream = stream;
+  m->arena = std::move(arena);
+  m->externals = std::move(externals);
+
+  std::cerr << "Adding internal data..." << std::endl;
+  std::set<VA> data_bases;
+  for (const auto &d : map->Records<CFGMapData>(header.data)) {
+    if (data_bases.insert(d.base_address).second) {
+      DataSection ds;
+      DeserializeMapData(map, d, ds);
+      m->addDataSection(ds);
+    }
+  }
+
+  std::cerr << "Adding Offset Tables..." << std::endl;
+  std::list<MCSOffsetTablePtr> offset_tables;
+  for (const auto &table : map->Records<CFGMapOffsetTable>(
+           header.offset_tables)) {
+    std::vector<std::pair<VA, VA>> v;
+    for (const auto &entry : map->Records<CFGMapOffsetTableEntry>(
+             header.offset_table_entries, table.first_entry,
+             table.num_entries)) {
+      v.push_back(std::make_pair(entry.table_offset, entry.destination));
+    }
+    offset_tables.push_back(
+        MCSOffsetTablePtr(new MCSOffsetTable(v, 0, table.start_addr)));
+  }
+  m->addOffsetTables(offset_tables);
+
+  std::cerr << "Adding entry points..." << std::endl;
+  for (const auto &entry : map->Records<CFGMapEntrySymbol>(header.entries)) {
+    NativeEntrySymbol native_es(map->String(entry.entry_name),
+                                entry.entry_address);
+    if (entry.has_extra) {
+      native_es.setExtra(
+          entry.entry_argc, 0 != entry.does_return,
+          DeserializeCallingConvention(
+              static_cast< ::ExternalFunction::CallingConvention>(
+                  entry.entry_cconv)));
     }
     m->addEntryPoint(native_es);
   }
 
-  std::cerr << "Returning modue..." << std::endl;
+  std::cerr << "Returning module..." << std::endl;
   return m;
 }
+
+}  // namespace
+
+NativeModulePtr ReadProtoBufHeader(const std::vector<std::string> &file_names) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  if (IsCFGMapInput(file_names)) {
+    return ReadCFGMap(file_names, true);
+  }
+
+  std::shared_ptr<CFGStream> stream(new CFGStream);
+
+  // Scan every file, and every shard listed by a manifest. The fields of all
+  // of them are merged into one module.
+  std::vector<MessageField> fields;
+  std::set<std::string> seen(file_names.begin(), file_names.end());
+  std::list<std::string> pending(file_names.begin(), file_names.end());
+  while (!pending.empty()) {
+    auto file_name = pending.front();
+    pending.pop_front();
+
+    auto file = llvm::MemoryBuffer::getFile(file_name, -1, false);
+    if (!file) {
+      std::cerr << "Failed to open file " << file_name << std::endl;
+      return nullptr;
+    }
+
+    auto data = reinterpret_cast<const uint8_t *>(
+        file.get()->getBufferStart());
+    auto first_field = fields.size();
+    if (!ScanMessageFields(data, file.get()->getBufferSize(), fields)) {
+      std::cerr << "Failed to scan protobuf module " << file_name << std::endl;
+      return nullptr;
+    }
+    stream->files.push_back(std::move(file.get()));
+
+    for (auto i = first_field; i < fields.size(); ++i) {
+      if (::Module::kShardFilesFieldNumber == fields[i].number) {
+        auto shard_path = ShardPath(
+            file_name,
+            std::string(reinterpret_cast<const char *>(fields[i].data),
+                        static_cast<size_t>(fields[i].size)));
+        if (seen.insert(shard_path).second) {
+          pending.push_back(shard_path);
+        }
+      }
+    }
+  }
+
+  // Externals need to be known before any function is deserialized.
+  std::cerr << "Deserializing externs..." << std::endl;
+  NativeExternals externals;
+  std::string module_name;
+  for (const auto &field : fields) {
+    if (::Module::kExternalFuncsFieldNumber == field.number) {
+      ::ExternalFunction external_func;
+      if (!external_func.ParseFromArray(field.data, field.size)) {
+        std::cerr << "Failed to deserialize external function" << std::endl;
+        return nullptr;
+      }
+      if (!externals.find_code(external_func.symbol_name())) {
+        externals.add_code(DeserializeExternFunc(external_func));
+      }
+
+    } else if (::Module::kModuleNameFieldNumber == field.number &&
+               module_name.empty()) {
+      module_name.assign(reinterpret_cast<const char *>(field.data),
+                         static_cast<size_t>(field.size));
+    }
+  }
+
+  std::cerr << "Deserializing function headers..." << std::endl;
+  std::unique_ptr<NativeArena> arena(new NativeArena);
+  std::unordered_map<VA, NativeFunctionPtr> native_funcs;
+  for (const auto &field : fields) {
+    if (::Module::kInternalFuncsFieldNumber == field.number) {
+      auto natf = ReadFunctionHeader(field.data, field.size, *arena);
+      if (!natf) {
+        std::cerr << "Unable to deserialize module." << std::endl;
+        return nullptr;
+      }
+      if (native_funcs.count(natf->get_start())) {
+        std::cerr << "Ignoring duplicate function at " << std::hex
+                  << natf->get_start() << std::dec << std::endl;
+        continue;
+      }
+      if (gFingerprintFunctions) {
+        natf->set_fingerprint(FingerprintFunction(
+            field.data, static_cast<size_t>(field.size)));
+      }
+      native_funcs[natf->get_start()] = natf;
+      stream->funcs.push_back({natf, field.data, field.size});
+    }
+  }
+
+  std::cerr << "Creating module..." << std::endl;
+  NativeModulePtr m = new NativeModule(module_name, native_funcs, ArchTriple());
+  m->stream = stream;
+  m->arena = std::move(arena);
+  m->externals = std::move(externals);
+
+  std::list<MCSOffsetTablePtr> offset_tables;
+  std::set<VA> data_bases;
+  for (const auto &field : fields) {
+    switch (field.number) {
+      case ::Module::kInternalDataFieldNumber: {
+        ::Data internal_data_elem;
+        if (!internal_data_elem.ParseFromArray(field.data, field.size)) {
+          std::cerr << "Failed to deserialize data section" << std::endl;
+          return nullptr;
+        }
+        if (data_bases.insert(internal_data_elem.base_address()).second) {
+          DataSection ds;
+          DeserializeData(internal_data_elem, ds);
+          m->addDataSection(ds);
+        }
+        break;
+      }
+
+      case ::Module::kExternalDataFieldNumber: {
+        ::ExternalData external_data_elem;
+        if (!external_data_elem.ParseFromArray(field.data, field.size)) {
+          std::cerr << "Failed to deserialize external data" << std::endl;
+          return nullptr;
+        }
+        if (!m->externals.find_data(external_data_elem.symbol_name())) {
+          m->addExtDataRef(DeserializeExternData(external_data_elem));
+        }
+        break;
+      }
+
+      case ::Module::kEntriesFieldNumber: {
+        ::EntrySymbol entry_symbol;
+        if (!entry_symbol.ParseFromArray(field.data, field.size)) {
+          std::cerr << "Failed to deserialize entry point" << std::endl;
+          return nullptr;
+        }
+        m->addEntryPoint(DeserializeEntrySymbol(entry_symbol));
+        break;
+      }
+
+      case ::Module::kOffsetTablesFieldNumber: {
+        ::OffsetTable offset_table;
+        if (!offset_table.ParseFromArray(field.data, field.size)) {
+          std::cerr << "Failed to deserialize offset table" << std::endl;
+          return nullptr;
+        }
+        offset_tables.push_back(DeserializeOffsetTable(offset_table));
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  m->addOffsetTables(offset_tables);
+
+  std::cerr << "Returning module header..." << std::endl;
+  return m;
+}
+
+bool StreamProtoBufFunctions(
+    NativeModulePtr m, const std::function<bool(NativeFunctionPtr)> &callback) {
+  TASSERT(m->is_streamed(), "Module is not backed by a CFG stream");
+
+  for (const auto &range : m->stream->funcs) {
+
+    if (m->stream->map) {
+      auto func = reinterpret_cast<const CFGMapFunction *>(range.data);
+      if (!DeserializeMapFuncBlocks(*(m->stream->map), *func, range.func,
+                                    m->externals)) {
+        std::cerr
+            << "Unable to deserialize function " << range.func->get_name()
+            << std::endl;
+        return false;
+      }
+
+    // The protobuf tree of the function is freed before the next function is
+    // read.
+    } else {
+      ::Function func;
+      if (!func.ParseFromArray(range.data, range.size) ||
+          !DeserializeNativeFuncBlocks(func, range.func, m->externals)) {
+        std::cerr
+            << "Unable to deserialize function " << range.func->get_name()
+            << std::endl;
+        return false;
+      }
+    }
+
+    // The blocks and instructions of the function are freed before the next
+    // function is read.
+    auto ret = callback(range.func);
+    range.func->release_blocks();
+    if (!ret) {
+      return false;
+    }
+  }
+  return true;
+}
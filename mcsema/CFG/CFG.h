@@ -34,18 +34,25 @@
 #include <map>
 #include <memory>
 #include <list>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <cstdio>
 #include <cstdint>
+#include <functional>
 #include <iostream>
 
+#include <llvm/ADT/ArrayRef.h>
 #include <llvm/ADT/Triple.h>
 #include <llvm/MC/MCInst.h>
+#include <llvm/Support/Allocator.h>
 
 #include "mcsema/CFG/Externals.h"
 
 namespace llvm {
+class GlobalVariable;
+class Module;
 class Target;
 }  // namespace llvm
 
@@ -227,17 +234,17 @@ class NativeBlock {
  private:
   //a list of instructions
   VA baseAddr;
-  std::list<NativeInstPtr> instructions;
-  std::list<VA> follows;
+  std::vector<NativeInstPtr> instructions;
+  std::vector<VA> follows;
 
  public:
   explicit NativeBlock(VA);
   void add_inst(NativeInstPtr);
   VA get_base(void);
   void add_follow(VA f);
-  std::list<VA> &get_follows(void);
+  std::vector<VA> &get_follows(void);
   std::string get_name(void);
-  const std::list<NativeInstPtr> &get_insts(void);
+  const std::vector<NativeInstPtr> &get_insts(void);
 
  private:
   NativeBlock(void) = delete;
@@ -245,14 +252,13 @@ class NativeBlock {
 
 typedef NativeBlock *NativeBlockPtr;
 
+class NativeArena;
+
 class NativeFunction {
  public:
-  explicit NativeFunction(VA b)
-      : funcEntryVA(b) {}
-
-  NativeFunction(VA b, const std::string &sym)
-      : funcEntryVA(b),
-        funcSymName(sym) {}
+  explicit NativeFunction(VA b);
+  NativeFunction(VA b, const std::string &sym);
+  ~NativeFunction(void);
 
   void add_block(NativeBlockPtr);
 
@@ -263,21 +269,62 @@ class NativeFunction {
   std::string get_name(void);
   const std::string &get_symbol_name(void);
 
+  // The arena that allocates the blocks and instructions of this function.
+  NativeArena &get_arena(void);
+
+  // Free the blocks and instructions of this function. Only the entry
+  // address, names, and fingerprint of the function are kept, which is all
+  // that is needed once it has been lifted.
+  void release_blocks(void);
+
+  // A hash of the serialized form of this function, or an empty string if
+  // fingerprints weren't enabled when the CFG was read.
+  const std::string &get_fingerprint(void) const;
+  void set_fingerprint(const std::string &fp);
+
+  // True if the function only reads its return address to return through
+  // it, so direct calls to it don't need to write it. This is only worked
+  // out with `-elide-return-addresses`.
+  bool return_address_is_private(void) const;
+  void set_return_address_private(bool is_private);
+
  private:
   NativeFunction(void) = delete;
 
   // Use a `std::map` to keep the blocks in their original order.
   std::map<VA, NativeBlockPtr> blocks;
+  std::unique_ptr<NativeArena> arena;
 
   //addr of function entry point
   VA funcEntryVA;
 
   std::string funcSymName;
+
+  std::string fingerprint;
+
+  bool return_address_private;
 };
 
 typedef NativeBlock *NativeBlockPtr;
 typedef NativeFunction *NativeFunctionPtr;
 
+// Bump allocator for the functions, blocks, and instructions of a CFG. The
+// objects are laid out contiguously, and are all destroyed at once, along
+// with the arena, instead of one at a time. A module's arena holds its
+// functions, and each function has an arena for its blocks and instructions.
+class NativeArena {
+ public:
+  NativeInstPtr new_inst(VA v, uint8_t l, const llvm::MCInst &inst,
+                         NativeInst::Prefix k);
+  NativeBlockPtr new_block(VA base);
+  NativeFunctionPtr new_func(VA entry, const std::string &sym);
+
+ private:
+  llvm::SpecificBumpPtrAllocator<NativeInst> insts;
+  llvm::SpecificBumpPtrAllocator<NativeBlock> blocks;
+  llvm::SpecificBumpPtrAllocator<NativeFunction> funcs;
+};
+
 class DataSectionEntry {
  public:
   DataSectionEntry(uint64_t base, const std::vector<uint8_t> &b);
@@ -285,11 +332,16 @@ class DataSectionEntry {
   DataSectionEntry(uint64_t base, const std::string &sname,
                    uint64_t symbol_size);
 
+  // Refer to the `size` bytes at `data` instead of copying them, e.g. in a
+  // memory-mapped CFG file. `backing` keeps the memory alive.
+  DataSectionEntry(uint64_t base, const uint8_t *data, uint64_t size,
+                   std::shared_ptr<const void> backing);
+
   uint64_t getBase(void) const;
 
   uint64_t getSize(void) const;
 
-  const std::vector<uint8_t> &getBytes(void) const;
+  llvm::ArrayRef<uint8_t> getBytes(void) const;
 
   bool getSymbol(std::string &sname) const;
 
@@ -301,6 +353,11 @@ class DataSectionEntry {
   bool is_symbol;
   std::string sym_name;
 
+  // Bytes that are used in place of `bytes`, if not null.
+  const uint8_t *view_data;
+  uint64_t view_size;
+  std::shared_ptr<const void> backing;
+
  private:
   DataSectionEntry(void) = delete;
 };
@@ -309,6 +366,7 @@ class DataSection {
  protected:
   std::list<DataSectionEntry> entries;
   uint64_t base;
+  uint64_t size;
   bool read_only;
 
  public:
@@ -352,6 +410,29 @@ class NativeEntrySymbol {
   NativeEntrySymbol(void) = delete;
 };
 
+class CFGStream;
+
+// The external functions and variables of a module, in the order in which
+// they were added, and indexed by their symbol names.
+class NativeExternals {
+ public:
+  // Add `p`, unless there already is an external function (or variable) with
+  // the same name. Returns true if `p` was added.
+  bool add_code(ExternalCodeRefPtr p);
+  bool add_data(ExternalDataRefPtr p);
+
+  // Returns the external function (or variable) named `name`, or `nullptr`.
+  ExternalCodeRefPtr find_code(const std::string &name) const;
+  ExternalDataRefPtr find_data(const std::string &name) const;
+
+  std::list<ExternalCodeRefPtr> code;
+  std::list<ExternalDataRefPtr> data;
+
+ private:
+  std::unordered_map<std::string, ExternalCodeRefPtr> code_index;
+  std::unordered_map<std::string, ExternalDataRefPtr> data_index;
+};
+
 class NativeModule {
  public:
   NativeModule(const std::string &module_name_,
@@ -369,6 +450,22 @@ class NativeModule {
 
   const std::list<DataSection> &getData(void) const;
 
+  // Returns the data section that contains `addr`, or `nullptr` if `addr`
+  // isn't in any data section.
+  const DataSection *findDataSection(VA addr) const;
+
+  // Returns the highest address just past the end of a data section. This
+  // isn't always the end of the section with the highest base, because
+  // sections can overlap.
+  VA getDataEnd(void) const;
+
+  // Remember `var` as the variable that holds the data section at `base` in
+  // the module that `var` belongs to.
+  void setDataSectionVar(VA base, llvm::GlobalVariable *var);
+
+  // Returns the variable that holds the data section at `base` in `M`.
+  llvm::GlobalVariable *getDataSectionVar(VA base, llvm::Module *M) const;
+
   //add an external reference
   void addExtCall(ExternalCodeRefPtr p);
 
@@ -387,8 +484,26 @@ class NativeModule {
 
   void addOffsetTables(const std::list<MCSOffsetTablePtr> &tables);
 
+  // Returns true if the blocks of this module's functions are still in the
+  // CFG file, and must be read with `StreamProtoBufFunctions`.
+  bool is_streamed(void) const;
+
+  // Free all functions, blocks, and instructions of this module. Nothing
+  // that refers to the CFG can be used after this.
+  void release_cfg(void);
+
   std::vector<NativeEntrySymbol> entries;
 
+  // Serialized functions of a module read by `ReadProtoBufHeader`.
+  std::shared_ptr<CFGStream> stream;
+
+  // Owns the functions of this module.
+  std::unique_ptr<NativeArena> arena;
+
+  // The externals that the functions of this module refer to. Instructions
+  // are resolved against these by name when they are deserialized.
+  NativeExternals externals;
+
  private:
   NativeModule(void) = delete;
 
@@ -397,11 +512,24 @@ class NativeModule {
   const llvm::Triple triple;
 
   std::list<DataSection> data_sections;
-  std::list<ExternalCodeRefPtr> external_code_refs;
-  std::list<ExternalDataRefPtr> external_data_refs;
+
+  struct DataSectionInfo {
+    const DataSection *section;
+    llvm::GlobalVariable *var;
+  };
+
+  // The data sections, keyed by their base address.
+  std::map<VA, DataSectionInfo> data_index;
+
+  // The highest end of a data section.
+  VA data_end;
 
  public:
   std::unordered_map<VA, MCSOffsetTablePtr> offset_tables;
+
+  // The bases of the data sections that were made from jump tables and jump
+  // index tables, keyed by the contents of the tables.
+  std::unordered_map<std::string, VA> table_sections;
 };
 
 typedef NativeModule *NativeModulePtr;
@@ -413,4 +541,23 @@ enum ModuleInputFormat {
   ProtoBuff
 };
 
-NativeModulePtr ReadProtoBuf(const std::string &file_name);
+// Read the CFG files `file_names` into one module. A file can be a whole
+// module, a manifest of a sharded CFG, or a shard; the shards listed by a
+// manifest are read too. Shards are parsed in parallel.
+NativeModulePtr ReadProtoBuf(const std::vector<std::string> &file_names);
+
+// Make `ReadProtoBuf` and `ReadProtoBufHeader` compute a fingerprint of
+// every function that they read.
+void EnableFunctionFingerprints(void);
+
+// Read everything in the CFG files `file_names` (and the shards they list)
+// except the blocks of their functions. The functions are created empty, and
+// their blocks are read one function at a time by `StreamProtoBufFunctions`.
+NativeModulePtr ReadProtoBufHeader(const std::vector<std::string> &file_names);
+
+// Deserialize the blocks of each of the functions of `m`, in file order, and
+// pass the function to `callback`. The blocks are released once `callback`
+// returns. Returns false if a function can't be read, or if `callback`
+// returns false.
+bool StreamProtoBufFunctions(
+    NativeModulePtr m, const std::function<bool(NativeFunctionPtr)> &callback);
@@ -0,0 +1,227 @@
+/*
+ Copyright (c) 2017, Trail of Bits
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification,
+ are permitted provided that the following conditions are met:
+
+ Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+
+ Redistributions in binary form must reproduce the above copyright notice, this
+ list of conditions and the following disclaimer in the documentation and/or
+ other materials provided with the distribution.
+
+ Neither the name of the {organization} nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MCSEMA_CFG_CFGMAP_H_
+#define MCSEMA_CFG_CFGMAP_H_
+
+#include <cstdint>
+
+// Layout of the memory-mapped CFG container, an alternative to the protobuf
+// `CFG.proto` format. The lifter maps the file and walks its records in
+// place; instruction and data bytes are never copied out of the mapping.
+//
+// The file starts with a `CFGMapHeader`, which locates a table of fixed-size
+// records for each kind of object. Records refer to each other by index, and
+// to variable-sized bytes (names, instruction bytes, data contents) by a
+// `CFGMapBytes` extent in the byte pool. All integers are little-endian, and
+// every table starts at a multiple of 8 bytes. The writer is
+// `tools/mcsema_disass/ida/cfg_map.py`, which also converts `.cfg` files.
+
+#define MCSEMA_CFG_MAP_MAGIC "MCSCFGM1"
+#define MCSEMA_CFG_MAP_VERSION 1
+
+// An extent of the byte pool.
+struct CFGMapBytes {
+  uint64_t offset;
+  uint64_t size;
+};
+
+// A table of `count` records that starts `offset` bytes into the file.
+struct CFGMapTable {
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct CFGMapHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  CFGMapBytes module_name;
+
+  CFGMapTable bytes;  // Byte pool; `count` is its size.
+  CFGMapTable funcs;  // `CFGMapFunction`.
+  CFGMapTable blocks;  // `CFGMapBlock`.
+  CFGMapTable insts;  // `CFGMapInst`.
+  CFGMapTable follows;  // `uint64_t` block addresses.
+  CFGMapTable jump_tables;  // `CFGMapJumpTable`.
+  CFGMapTable jump_table_entries;  // `uint64_t` table entries.
+  CFGMapTable jump_index_tables;  // `CFGMapJumpIndexTable`.
+  CFGMapTable data;  // `CFGMapData`.
+  CFGMapTable data_symbols;  // `CFGMapDataSymbol`.
+  CFGMapTable external_funcs;  // `CFGMapExternalFunction`.
+  CFGMapTable external_data;  // `CFGMapExternalData`.
+  CFGMapTable entries;  // `CFGMapEntrySymbol`.
+  CFGMapTable offset_tables;  // `CFGMapOffsetTable`.
+  CFGMapTable offset_table_entries;  // `CFGMapOffsetTableEntry`.
+};
+
+struct CFGMapFunction {
+  uint64_t entry_address;
+  CFGMapBytes symbol_name;  // Empty if the function has no symbol.
+  uint32_t first_block;
+  uint32_t num_blocks;
+};
+
+struct CFGMapBlock {
+  uint64_t base_address;
+  uint32_t first_inst;
+  uint32_t num_insts;
+  uint32_t first_follow;
+  uint32_t num_follows;
+};
+
+// Which of the optional `CFGMapInst` fields are present.
+enum : uint32_t {
+  kCFGMapHasTrueTarget = 1 << 0,
+  kCFGMapHasFalseTarget = 1 << 1,
+  kCFGMapHasImmReference = 1 << 2,
+  kCFGMapHasImmRelocOffset = 1 << 3,
+  kCFGMapHasImmRefType = 1 << 4,
+  kCFGMapHasMemReference = 1 << 5,
+  kCFGMapHasMemRelocOffset = 1 << 6,
+  kCFGMapHasMemRefType = 1 << 7,
+  kCFGMapHasSystemCallNumber = 1 << 8,
+  kCFGMapLocalNoReturn = 1 << 9,
+  kCFGMapHasOffsetTable = 1 << 10,
+  kCFGMapHasJumpTable = 1 << 11,
+  kCFGMapHasJumpIndexTable = 1 << 12,
+};
+
+struct CFGMapInst {
+  uint64_t inst_addr;
+  uint64_t true_target;
+  uint64_t false_target;
+  uint64_t imm_reference;
+  uint64_t imm_reloc_offset;
+  uint64_t mem_reference;
+  uint64_t mem_reloc_offset;
+  uint64_t offset_table_addr;
+  CFGMapBytes inst_bytes;
+  CFGMapBytes ext_call_name;  // Empty if there is no external call.
+  CFGMapBytes ext_data_name;  // Empty if there is no external data ref.
+  uint32_t flags;
+  uint32_t jump_table;  // Index into `jump_tables`.
+  uint32_t jump_index_table;  // Index into `jump_index_tables`.
+  int32_t system_call_number;
+  uint8_t imm_ref_type;  // `Instruction::RefType`.
+  uint8_t mem_ref_type;
+  uint8_t reserved[6];
+};
+
+struct CFGMapJumpTable {
+  uint64_t first_entry;
+  uint64_t num_entries;
+  int64_t offset_from_data;  // -1 if the table isn't in a data section.
+  int32_t zero_offset;
+  uint32_t reserved;
+};
+
+struct CFGMapJumpIndexTable {
+  CFGMapBytes table_entries;
+  int32_t zero_offset;
+  uint32_t reserved;
+};
+
+struct CFGMapData {
+  uint64_t base_address;
+  CFGMapBytes data;
+  uint32_t first_symbol;
+  uint32_t num_symbols;
+  uint32_t read_only;
+  uint32_t reserved;
+};
+
+struct CFGMapDataSymbol {
+  uint64_t base_address;
+  CFGMapBytes symbol_name;
+  uint64_t symbol_size;
+};
+
+// Which of the `CFGMapExternalFunction` flags are set.
+enum : uint32_t {
+  kCFGMapHasReturn = 1 << 0,
+  kCFGMapNoReturn = 1 << 1,
+  kCFGMapIsWeak = 1 << 2,
+  kCFGMapIsDirect = 1 << 3,
+};
+
+struct CFGMapExternalFunction {
+  CFGMapBytes symbol_name;
+  uint32_t calling_convention;  // `ExternalFunction::CallingConvention`.
+  int32_t argument_count;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+struct CFGMapExternalData {
+  CFGMapBytes symbol_name;
+  uint64_t data_size;
+  uint32_t is_weak;
+  uint32_t reserved;
+};
+
+struct CFGMapEntrySymbol {
+  CFGMapBytes entry_name;
+  uint64_t entry_address;
+  uint32_t has_extra;
+  int32_t entry_argc;
+  uint32_t entry_cconv;  // `ExternalFunction::CallingConvention`.
+  uint32_t does_return;
+};
+
+struct CFGMapOffsetTable {
+  uint64_t start_addr;
+  uint64_t first_entry;
+  uint64_t num_entries;
+};
+
+struct CFGMapOffsetTableEntry {
+  uint64_t table_offset;
+  uint64_t destination;
+};
+
+static_assert(sizeof(CFGMapHeader) == 272, "Bad CFGMapHeader size");
+static_assert(sizeof(CFGMapFunction) == 32, "Bad CFGMapFunction size");
+static_assert(sizeof(CFGMapBlock) == 24, "Bad CFGMapBlock size");
+static_assert(sizeof(CFGMapInst) == 136, "Bad CFGMapInst size");
+static_assert(sizeof(CFGMapJumpTable) == 32, "Bad CFGMapJumpTable size");
+static_assert(sizeof(CFGMapJumpIndexTable) == 24,
+              "Bad CFGMapJumpIndexTable size");
+static_assert(sizeof(CFGMapData) == 40, "Bad CFGMapData size");
+static_assert(sizeof(CFGMapDataSymbol) == 32, "Bad CFGMapDataSymbol size");
+static_assert(sizeof(CFGMapExternalFunction) == 32,
+              "Bad CFGMapExternalFunction size");
+static_assert(sizeof(CFGMapExternalData) == 32, "Bad CFGMapExternalData size");
+static_assert(sizeof(CFGMapEntrySymbol) == 40, "Bad CFGMapEntrySymbol size");
+static_assert(sizeof(CFGMapOffsetTable) == 24, "Bad CFGMapOffsetTable size");
+static_assert(sizeof(CFGMapOffsetTableEntry) == 16,
+              "Bad CFGMapOffsetTableEntry size");
+
+#endif  // MCSEMA_CFG_CFGMAP_H_
@@ -120,13 +120,25 @@ class ExternalCodeRef : public ExternalRef {
     return this->funcSign;
   }
 
+  // Direct externals follow their calling convention and never call back
+  // into lifted code, so lifted code can call them without switching to the
+  // native register state.
+  bool isDirect(void) {
+    return this->direct;
+  }
+
+  void setDirect(bool d) {
+    this->direct = d;
+  }
+
   ExternalCodeRef(const std::string &fn, int d, CallingConvention c,
                   ReturnType r, const std::string &sign)
       : numArgs(d),
         conv(c),
         ret(r),
         ExternalRef(fn),
-        funcSign(sign) {}
+        funcSign(sign),
+        direct(false) {}
 
   ExternalCodeRef(const std::string &fn, int d, CallingConvention c,
                   ReturnType r)
@@ -134,28 +146,32 @@ class ExternalCodeRef : public ExternalRef {
         conv(c),
         ret(r),
         ExternalRef(fn),
-        funcSign("") {}
+        funcSign(""),
+        direct(false) {}
 
   ExternalCodeRef(const std::string &fn, int d, CallingConvention c)
       : numArgs(d),
         conv(c),
         ret(Unknown),
         ExternalRef(fn),
-        funcSign("") {}
+        funcSign(""),
+        direct(false) {}
 
   ExternalCodeRef(const std::string &fn, int d)
       : numArgs(d),
         conv(CallerCleanup),
         ret(Unknown),
         ExternalRef(fn),
-        funcSign("") {}
+        funcSign(""),
+        direct(false) {}
 
   ExternalCodeRef(const std::string &fn)
       : numArgs(-1),
         conv(CallerCleanup),
         ret(Unknown),
         ExternalRef(fn),
-        funcSign("") {}
+        funcSign(""),
+        direct(false) {}
 
  protected:
 
@@ -163,6 +179,7 @@ class ExternalCodeRef : public ExternalRef {
   CallingConvention conv;
   ReturnType ret;
   std::string funcSign;
+  bool direct;
 };
 
 typedef ExternalCodeRef *ExternalCodeRefPtr;
@@ -28,10 +28,17 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <string>
 #include <sstream>
 #include <system_error>
+#include <thread>
+#include <vector>
 
 #include <llvm/Bitcode/ReaderWriter.h>
 
@@ -40,12 +47,15 @@
 #include <llvm/IR/Verifier.h>
 
 #include <llvm/Support/CommandLine.h>
-#include <llvm/Support/FileSystem.h>
-#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/ManagedStatic.h>
 
 #include "mcsema/Arch/Arch.h"
 
 #include "mcsema/BC/Lift.h"
+#include "mcsema/BC/Optimize.h"
+#include "mcsema/BC/Output.h"
+#include "mcsema/BC/Scan.h"
+#include "mcsema/BC/Stats.h"
 #include "mcsema/BC/Util.h"
 
 static llvm::cl::opt<std::string> OutputFilename(
@@ -60,9 +70,64 @@ static llvm::cl::opt<std::string> OS("os", llvm::cl::desc("Operating system"),
                                      llvm::cl::value_desc("<os>"),
                                      llvm::cl::Optional);
 
-static llvm::cl::opt<std::string> InputFilename(
-    "cfg", llvm::cl::desc("Input CFG file"), llvm::cl::value_desc("<cfg>"),
-    llvm::cl::Optional);
+static llvm::cl::list<std::string> InputFilenames(
+    "cfg",
+    llvm::cl::desc(
+        "Input CFG file. Can be given more than once, e.g. for the manifest "
+        "and shards of a sharded CFG; the shards listed by a manifest are "
+        "read automatically."),
+    llvm::cl::value_desc("<cfg>"), llvm::cl::ZeroOrMore);
+
+static llvm::cl::opt<bool> StreamCFG(
+    "stream-cfg",
+    llvm::cl::desc(
+        "Read the functions of the CFG file one at a time, lifting each one "
+        "as soon as it is read. This reduces peak memory usage."),
+    llvm::cl::init(false));
+
+static llvm::cl::list<std::string> MergeInputs(
+    "merge",
+    llvm::cl::desc(
+        "Instead of lifting, link the partial modules produced with "
+        "-lift-functions into the output, and add the entry point drivers. "
+        "The CFG is only used for the names of the functions and the entry "
+        "points, so it is read as with -stream-cfg."),
+    llvm::cl::value_desc("<partial bitcode files>"), llvm::cl::CommaSeparated);
+
+static llvm::cl::opt<unsigned> OptLevel(
+    "O",
+    llvm::cl::desc(
+        "Optimization level. [-O0, -O1, -O2, or -O3] (default = '-O0'). "
+        "Optimizes the lifted module before it is written out."),
+    llvm::cl::Prefix, llvm::cl::ZeroOrMore, llvm::cl::init(0));
+
+static llvm::cl::opt<std::string> StatsFile(
+    "stats-json",
+    llvm::cl::desc(
+        "Write the time spent in each lifting phase, the lift time of each "
+        "function and opcode, and the peak memory usage, to a JSON file."),
+    llvm::cl::value_desc("<file>"), llvm::cl::init(""));
+
+static llvm::cl::opt<std::string> SymbolMapFile(
+    "symbol-map",
+    llvm::cl::desc(
+        "Write the native address, lifted name, and original symbol name of "
+        "every lifted function to a file, for tools/perfmap/perf_map.py."),
+    llvm::cl::value_desc("<file>"), llvm::cl::init(""));
+
+static llvm::cl::opt<unsigned> StatsTopN(
+    "stats-top",
+    llvm::cl::desc(
+        "How many of the biggest functions and data sections to list on "
+        "their own in the -stats-json file."),
+    llvm::cl::init(20));
+
+static llvm::cl::opt<unsigned> MemoryLimitMB(
+    "memory-limit-mb",
+    llvm::cl::desc(
+        "Abort, naming the function or phase being lifted, once the lifter's "
+        "resident set size goes over this many MiB. Zero means no limit."),
+    llvm::cl::init(0));
 
 static llvm::cl::list<std::string> EntryPoints(
     "entrypoint", llvm::cl::desc("Describe externally visible entry points"),
@@ -76,6 +141,40 @@ static llvm::cl::opt<bool> ListUnsupported("list-unsupported",
                                            llvm::cl::desc("List unsupported (not-yet-implemented) instructions for <arch>"),
                                            llvm::cl::Optional);
 
+static llvm::cl::opt<bool> Scan(
+    "scan",
+    llvm::cl::desc(
+        "Instead of lifting, check that every instruction of the CFG has a "
+        "lifter, and print the unsupported instructions, a histogram of the "
+        "opcodes, and the estimated lift cost of each function. Fails if "
+        "any instruction is unsupported."),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<std::string> ScanCosts(
+    "scan-costs",
+    llvm::cl::desc(
+        "A -stats-json file from an earlier lift, whose per-opcode lift "
+        "times are used for the -scan cost estimates. Without it, the cost "
+        "of a function is its number of instructions."),
+    llvm::cl::value_desc("<file>"), llvm::cl::init(""));
+
+static llvm::cl::opt<std::string> BatchFile(
+    "batch",
+    llvm::cl::desc(
+        "Lift every job listed in this file in one process, instead of a "
+        "single CFG. Each line is '<cfg>[,<cfg>...] <output> "
+        "<entrypoint>[,<entrypoint>...]'. Empty lines and lines that start "
+        "with '#' are ignored. All jobs use the same -arch, -os, and other "
+        "options."),
+    llvm::cl::value_desc("<file>"), llvm::cl::init(""));
+
+static llvm::cl::opt<unsigned> BatchJobs(
+    "batch-jobs",
+    llvm::cl::desc(
+        "Number of -batch jobs that are lifted at the same time, each with "
+        "its own LLVM context."),
+    llvm::cl::init(1));
+
 static void PrintVersion(void) {
   std::cout << "0.6" << std::endl;
 }
@@ -89,7 +188,240 @@ static VA FindSymbolInModule(NativeModulePtr mod, const std::string &sym_name) {
   return static_cast<VA>( -1);
 }
 
+struct LiftJob {
+  std::vector<std::string> cfg_files;
+  std::string output;
+  std::vector<std::string> entry_points;
+};
+
+static std::vector<std::string> SplitCommas(const std::string &str) {
+  std::vector<std::string> parts;
+  std::stringstream ss(str);
+  for (std::string part; std::getline(ss, part, ','); ) {
+    if (!part.empty()) {
+      parts.push_back(part);
+    }
+  }
+  return parts;
+}
+
+// Read the jobs listed in the `-batch` file.
+static bool ReadBatchFile(const std::string &path, std::vector<LiftJob> &jobs) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Could not open batch file " << path << std::endl;
+    return false;
+  }
+
+  auto line_num = 0U;
+  for (std::string line; std::getline(file, line); ) {
+    ++line_num;
+    std::stringstream ss(line);
+    std::string cfgs, output, entry_points, extra;
+    if (!(ss >> cfgs) || '#' == cfgs[0]) {
+      continue;
+    }
+    ss >> output >> entry_points;
+    LiftJob job = {SplitCommas(cfgs), output, SplitCommas(entry_points)};
+    if (job.cfg_files.empty() || output.empty() ||
+        job.entry_points.empty() || (ss >> extra)) {
+      std::cerr << path << ":" << line_num << ": expected '<cfg> <output> "
+                << "<entrypoints>'" << std::endl;
+      return false;
+    }
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+// Lift the CFG files of `job` into a new module in `context`, and write the
+// module to `job.output`.
+static bool RunLiftJob(llvm::LLVMContext *context, const LiftJob &job) {
+  auto M = CreateModule(context);
+  if (!M) {
+    return false;
+  }
+
+  //reproduce NativeModule from CFG input argument
+  NativeModulePtr mod = nullptr;
+  {
+    PhaseTimer timer("read_cfg");
+    auto merging = !MergeInputs.empty();
+    mod = (StreamCFG || merging) ? ReadProtoBufHeader(job.cfg_files) :
+                                   ReadProtoBuf(job.cfg_files);
+  }
+  if (!mod) {
+    std::cerr << "Unable to read module from CFG" << std::endl;
+    return false;
+  }
+  std::unique_ptr<NativeModule> mod_owner(mod);
+
+  //now, convert it to an LLVM module
+  ArchInitAttachDetach(M);
+
+  if (!MergeInputs.empty()) {
+    PhaseTimer timer("merge_modules");
+    std::vector<std::string> merge_files(MergeInputs.begin(),
+                                         MergeInputs.end());
+    if (!MergeLiftedModules(mod, M, merge_files)) {
+      std::cerr << "Failure to merge partial modules!" << std::endl;
+      return false;
+    }
+
+  } else if (!LiftCodeIntoModule(mod, M)) {
+    std::cerr << "Failure to convert to LLVM module!" << std::endl;
+    return false;
+  }
+
+  // Entry points are added, and functions renamed, once all partial
+  // modules are merged.
+  std::vector<std::string> entry_points;
+  if (!IsPartialLift()) {
+    entry_points = job.entry_points;
+  }
+
+  PhaseTimer entry_points_timer("add_entry_points");
+  std::set<VA> entry_point_pcs;
+  for (const auto &entry_point_name : entry_points) {
+    auto entry_pc = FindSymbolInModule(mod, entry_point_name);
+    if (entry_pc != static_cast<VA>( -1)) {
+      std::cerr << "Adding entry point: " << entry_point_name << std::endl
+                << entry_point_name << " is implemented by sub_" << std::hex
+                << entry_pc << std::endl;
+
+      if ( !ArchAddEntryPointDriver(M, entry_point_name, entry_pc)) {
+        return false;
+      }
+
+      entry_point_pcs.insert(entry_pc);
+    } else {
+      std::cerr << "Could not find entry point: " << entry_point_name
+                << "; aborting" << std::endl;
+      return false;
+    }
+  }
+
+  if (!IsPartialLift()) {
+    RenameLiftedFunctions(mod, M, entry_point_pcs);
+  }
+  entry_points_timer.Stop();
+
+  if (!SymbolMapFile.empty() && !WriteSymbolMap(mod, M, SymbolMapFile)) {
+    return false;
+  }
+
+  // The CFG isn't needed once everything is lifted.
+  mod->release_cfg();
+
+  // will abort if verification fails
+  if (ShouldVerifyModule()) {
+    PhaseTimer timer("verify_module");
+    if (llvm::verifyModule( *M, &llvm::errs())) {
+      std::cerr << "Could not verify module!" << std::endl;
+      return false;
+    }
+  }
+
+  if (OptLevel) {
+    std::cerr << "Optimizing module at -O" << OptLevel << std::endl;
+    PhaseTimer timer("optimize_module");
+    OptimizeModule(M, std::min(3U, OptLevel.getValue()));
+  }
+
+  PhaseTimer write_timer("write_bitcode");
+  if (!WriteLiftedModule(std::unique_ptr<llvm::Module>(M), job.output)) {
+    std::cerr << "Could not write the lifted module" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Check the instructions of the `-cfg` files against the lifters, without
+// lifting them.
+static bool RunScan(void) {
+  if (!ScanCosts.empty() && !LoadOpcodeCosts(ScanCosts)) {
+    return false;
+  }
+
+  std::vector<std::string> cfg_files(InputFilenames.begin(),
+                                     InputFilenames.end());
+  auto mod = ReadProtoBufHeader(cfg_files);
+  if (!mod) {
+    std::cerr << "Unable to read module from CFG" << std::endl;
+    return false;
+  }
+  std::unique_ptr<NativeModule> mod_owner(mod);
+  return ScanModule(mod, std::cout);
+}
+
+// Lift `job` into a new `LLVMContext`, on the calling thread.
+static bool RunBatchJob(const LiftJob &job) {
+  std::unique_ptr<llvm::LLVMContext> context(new llvm::LLVMContext);
+  ArchInitContext(context.get());
+
+  std::cerr << "Lifting " << job.cfg_files.front() << " into " << job.output
+            << std::endl;
+  try {
+    if (RunLiftJob(context.get(), job)) {
+      return true;
+    }
+  } catch (std::exception &e) {
+    std::cerr << "error: " << std::endl << e.what() << std::endl;
+  }
+  std::cerr << "Could not lift " << job.cfg_files.front() << " into "
+            << job.output << std::endl;
+  return false;
+}
+
+// Lift all of the jobs in the `-batch` file, `BatchJobs` of them at a time.
+// Architecture initialization is shared by all of the jobs.
+static bool RunBatch(void) {
+  std::vector<LiftJob> jobs;
+  if (!ReadBatchFile(BatchFile, jobs)) {
+    return false;
+  }
+
+  if (1 < BatchJobs && LiftsFunctionsInParallel()) {
+    std::cerr << "-jobs can't be used with more than one batch job"
+              << std::endl;
+    return false;
+  }
+
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> num_failed(0);
+  auto run_jobs = [&] (void) {
+    for (auto i = next++; i < jobs.size(); i = next++) {
+
+      // Every job runs on a new thread, because the per-thread lifting state
+      // (e.g. the register state type) belongs to a single `LLVMContext`.
+      std::thread worker([&jobs, &num_failed, i] (void) {
+        if (!RunBatchJob(jobs[i])) {
+          ++num_failed;
+        }
+      });
+      worker.join();
+    }
+  };
+
+  std::vector<std::thread> runners;
+  auto num_runners = std::min<size_t>(std::max(1U, BatchJobs.getValue()),
+                                      jobs.size());
+  for (size_t i = 0; i < num_runners; ++i) {
+    runners.emplace_back(run_jobs);
+  }
+  for (auto &runner : runners) {
+    runner.join();
+  }
+
+  std::cerr << "Lifted " << (jobs.size() - num_failed) << " of "
+            << jobs.size() << " batch jobs" << std::endl;
+  return !num_failed;
+}
+
 int main(int argc, char *argv[]) {
+  // Prints any statistics requested with `-stats` on exit.
+  llvm::llvm_shutdown_obj shutdown;
+
   llvm::cl::SetVersionPrinter(PrintVersion);
   llvm::cl::ParseCommandLineOptions(argc, argv, "CFG to LLVM");
 
@@ -105,7 +437,10 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if (!(ListSupported || ListUnsupported) && EntryPoints.empty()) {
+  auto batch = !BatchFile.empty();
+  if (!(ListSupported || ListUnsupported || IsPartialLift() || batch ||
+        Scan) &&
+      EntryPoints.empty()) {
     std::cerr
         << "-entrypoint must be specified" << std::endl;
         return EXIT_FAILURE;
@@ -118,78 +453,68 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
-  auto M = CreateModule(context);
-  if (!M) {
-    return EXIT_FAILURE;
-  }
-
-  auto triple = M->getTargetTriple();
-
   if (ListSupported || ListUnsupported) {
-    ListArchSupportedInstructions(triple, llvm::outs(), ListSupported, ListUnsupported);
+    ListArchSupportedInstructions(ArchTriple(), llvm::outs(), ListSupported, ListUnsupported);
     return EXIT_SUCCESS;
   }
 
-  if (InputFilename.empty() || OutputFilename.empty()) {
-    std::cerr
-        << "Must specify an input and output file." << std::endl;
-    return EXIT_FAILURE;
-  }
-
-  //reproduce NativeModule from CFG input argument
-  try {
-    auto mod = ReadProtoBuf(InputFilename);
-    if (!mod) {
-      std::cerr << "Unable to read module from CFG" << std::endl;
+  if (Scan) {
+    if (InputFilenames.empty()) {
+      std::cerr << "-scan needs a -cfg file" << std::endl;
       return EXIT_FAILURE;
     }
-
-    //now, convert it to an LLVM module
-    ArchInitAttachDetach(M);
-
-    if (!LiftCodeIntoModule(mod, M)) {
-      std::cerr << "Failure to convert to LLVM module!" << std::endl;
+    try {
+      return RunScan() ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (std::exception &e) {
+      std::cerr << "error: " << std::endl << e.what() << std::endl;
       return EXIT_FAILURE;
     }
+  }
 
-    std::set<VA> entry_point_pcs;
-    for (const auto &entry_point_name : EntryPoints) {
-      auto entry_pc = FindSymbolInModule(mod, entry_point_name);
-      if (entry_pc != static_cast<VA>( -1)) {
-        std::cerr << "Adding entry point: " << entry_point_name << std::endl
-                  << entry_point_name << " is implemented by sub_" << std::hex
-                  << entry_pc << std::endl;
-
-        if ( !ArchAddEntryPointDriver(M, entry_point_name, entry_pc)) {
-          return EXIT_FAILURE;
-        }
-
-        entry_point_pcs.insert(entry_pc);
-      } else {
-        std::cerr << "Could not find entry point: " << entry_point_name
-                  << "; aborting" << std::endl;
-        return EXIT_FAILURE;
-      }
+  if (batch) {
+    if (!InputFilenames.empty() || !EntryPoints.empty() ||
+        !MergeInputs.empty() || IsPartialLift() || !SymbolMapFile.empty()) {
+      std::cerr
+          << "-batch can't be used with -cfg, -entrypoint, -merge, "
+          << "-lift-functions, or -symbol-map" << std::endl;
+      return EXIT_FAILURE;
     }
+  } else if (InputFilenames.empty() || OutputFilename.empty()) {
+    std::cerr
+        << "Must specify an input and output file." << std::endl;
+    return EXIT_FAILURE;
+  }
 
-    RenameLiftedFunctions(mod, M, entry_point_pcs);
+  if (LiftCacheEnabled()) {
+    EnableFunctionFingerprints();
+  }
 
-    // will abort if verification fails
-    if (llvm::verifyModule( *M, &llvm::errs())) {
-      std::cerr << "Could not verify module!" << std::endl;
+  if (!StatsFile.empty()) {
+    EnableLiftStats();
+  }
+
+  SetMemoryLimit(static_cast<uint64_t>(MemoryLimitMB) << 20);
+
+  auto ok = false;
+  if (batch) {
+    ok = RunBatch();
+
+  } else {
+    LiftJob job;
+    job.cfg_files.assign(InputFilenames.begin(), InputFilenames.end());
+    job.output = OutputFilename;
+    job.entry_points.assign(EntryPoints.begin(), EntryPoints.end());
+    try {
+      ok = RunLiftJob(context, job);
+    } catch (std::exception &e) {
+      std::cerr << "error: " << std::endl << e.what() << std::endl;
       return EXIT_FAILURE;
     }
+  }
 
-    std::error_code ec;
-    llvm::tool_output_file Out(OutputFilename.c_str(), ec,
-                               llvm::sys::fs::F_None);
-    llvm::WriteBitcodeToFile(M, Out.os());
-    Out.keep();
-
-  } catch (std::exception &e) {
-    std::cerr << "error: " << std::endl << e.what() << std::endl;
-    return EXIT_FAILURE;
+  if (!StatsFile.empty() && !WriteLiftStats(StatsFile, StatsTopN)) {
+    std::cerr << "Could not write statistics to " << StatsFile << std::endl;
   }
 
-  return EXIT_SUCCESS;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -28,6 +28,8 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <map>
+#include <memory>
 #include <vector>
 #include <unordered_set>
 #include <sstream>
@@ -37,6 +39,7 @@
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Intrinsics.h>
@@ -79,26 +82,37 @@ static DataSection *tableToDataSection(VA new_base, const JumpIndexTable &jit) {
   return ds;
 }
 
+// Returns the bytes that make up the data section of a table. Tables with
+// the same bytes share one data section.
+static std::string tableKey(const MCSJumpTable &jt) {
+  const auto &entries = jt.getJumpTable();
+  std::string key = "j";
+  key.append(reinterpret_cast<const char *>(entries.data()),
+             entries.size() * sizeof(VA));
+  return key;
+}
+
+static std::string tableKey(const JumpIndexTable &jit) {
+  const auto &entries = jit.getJumpIndexTable();
+  std::string key = "i";
+  key.append(entries.begin(), entries.end());
+  return key;
+}
+
 template<typename T>
-static bool addTableDataSection(TranslationContext &ctx, VA &newVA,
-                                const T &table) {
-  auto natMod = ctx.natM;
-  auto M = ctx.M;
-
-  // ensure we make this the last data section
-  newVA = 0;
-  for (const auto &dt : natMod->getData()) {
-    uint64_t extent = dt.getBase() + dt.getSize();
-    if (newVA < extent) {
-      newVA = extent;
-    }
+static bool addTableDataSection(NativeModulePtr natMod, llvm::Module *M,
+                                VA &newVA, const T &table) {
+  auto &cached_va = natMod->table_sections[tableKey(table)];
+  if (cached_va) {
+    newVA = cached_va;
+    return true;
   }
 
-  // skip a few
-  newVA += 4;
+  // ensure we make this the last data section, and skip a few
+  newVA = natMod->getDataEnd() + 4;
 
   // create a new data section from the table
-  DataSection *ds = tableToDataSection(newVA, table);
+  std::unique_ptr<DataSection> ds(tableToDataSection(newVA, table));
 
   // add to global data section list
   natMod->addDataSection( *ds);
@@ -115,25 +129,27 @@ static bool addTableDataSection(TranslationContext &ctx, VA &newVA,
 
   std::vector<llvm::Type *> data_section_types;
   std::vector<llvm::Constant *> secContents;
-  dataSectionToTypesContents(natMod->getData(), *ds, M, secContents,
+  dataSectionToTypesContents(natMod, *ds, M, secContents,
                              data_section_types, false);
 
   st_opaque->setBody(data_section_types, true);
   auto cst = llvm::ConstantStruct::get(st_opaque, secContents);
   gv->setAlignment(4);
   gv->setInitializer(cst);
+  natMod->setDataSectionVar(newVA, gv);
 
+  cached_va = newVA;
   return true;
 
 }
-bool addJumpTableDataSection(TranslationContext &ctx, VA &newVA,
-                             const MCSJumpTable &table) {
-  return addTableDataSection<MCSJumpTable>(ctx, newVA, table);
+bool addJumpTableDataSection(NativeModulePtr natMod, llvm::Module *M,
+                             VA &newVA, const MCSJumpTable &table) {
+  return addTableDataSection<MCSJumpTable>(natMod, M, newVA, table);
 }
 
-bool addJumpIndexTableDataSection(TranslationContext &ctx, VA &newVA,
-                                  const JumpIndexTable &table) {
-  return addTableDataSection<JumpIndexTable>(ctx, newVA, table);
+bool addJumpIndexTableDataSection(NativeModulePtr natMod, llvm::Module *M,
+                                  VA &newVA, const JumpIndexTable &table) {
+  return addTableDataSection<JumpIndexTable>(natMod, M, newVA, table);
 }
 
 void doJumpTableViaData(llvm::BasicBlock *&block, llvm::Value *fptr,
@@ -160,7 +176,8 @@ void doJumpTableViaData(TranslationContext &ctx, llvm::BasicBlock *&block,
   auto &inst = ip->get_inst();
   auto natM = ctx.natM;
 
-  llvm::Value *addr = MEM_REFERENCE(0);
+  auto addr = 64 == bitness ? MEM_AS_DATA_REF<64>(block, natM, inst, ip, 0)
+                            : MEM_AS_DATA_REF<32>(block, natM, inst, ip, 0);
   //doJumpTableViaData(block, addr, bitness);
 
   llvm::errs() << __FUNCTION__ << ": Doing jump table via data\n";
@@ -250,6 +267,100 @@ void doJumpTableViaSwitch(TranslationContext &ctx, llvm::BasicBlock *&block,
   }
 }
 
+// Dense tables may have at most this many slots per distinct case, so that
+// sparse tables don't become mostly holes.
+static const uint64_t kMaxSlotsPerCase = 4;
+
+// Tables are never larger than this many slots.
+static const uint64_t kMaxSlots = 1 << 16;
+
+// Try to dispatch on `val` with an `indirectbr` through a dense table of
+// block addresses, indexed by `val` relative to the smallest case. The cases
+// are usually code addresses that are all aligned, so the alignment shared
+// by the cases is shifted out of the index. Values that aren't cases go to
+// `default_block`. Returns false, without changing `block`, if the table
+// would be too sparse.
+static bool doJumpTableViaIndirectBr(
+    llvm::BasicBlock *block, llvm::Value *val,
+    const std::map<VA, llvm::BasicBlock *> &cases,
+    llvm::BasicBlock *default_block) {
+  if (cases.size() < 2) {
+    return false;
+  }
+
+  auto min_case = cases.begin()->first;
+  auto max_case = cases.rbegin()->first;
+  uint64_t diffs = 0;
+  for (const auto &entry : cases) {
+    diffs |= entry.first - min_case;
+  }
+
+  unsigned shift = 0;
+  while (!((diffs >> shift) & 1)) {
+    ++shift;
+  }
+
+  auto num_slots = ((max_case - min_case) >> shift) + 1;
+  if (num_slots > kMaxSlots || num_slots > kMaxSlotsPerCase * cases.size()) {
+    return false;
+  }
+
+  auto F = block->getParent();
+  auto M = F->getParent();
+  auto &C = M->getContext();
+  auto width = val->getType()->getIntegerBitWidth();
+
+  auto default_addr = llvm::BlockAddress::get(F, default_block);
+  std::vector<llvm::Constant *> slots(num_slots, default_addr);
+  for (const auto &entry : cases) {
+    slots[(entry.first - min_case) >> shift] =
+        llvm::BlockAddress::get(F, entry.second);
+  }
+
+  auto table_type = llvm::ArrayType::get(default_addr->getType(), num_slots);
+  auto table = new llvm::GlobalVariable(
+      *M, table_type, true, llvm::GlobalValue::PrivateLinkage,
+      llvm::ConstantArray::get(table_type, slots),
+      F->getName() + "_jump_table");
+
+  // An out-of-range or misaligned value goes to the default block.
+  auto offset = llvm::BinaryOperator::CreateSub(
+      val, CONST_V(block, width, min_case), "", block);
+  auto in_range = new llvm::ICmpInst(
+      *block, llvm::ICmpInst::ICMP_ULT, offset,
+      CONST_V(block, width, ((num_slots - 1) << shift) + 1));
+  llvm::Value *is_case = in_range;
+  if (shift) {
+    auto low_bits = llvm::BinaryOperator::CreateAnd(
+        offset, CONST_V(block, width, (1ULL << shift) - 1), "", block);
+    auto is_aligned = new llvm::ICmpInst(
+        *block, llvm::ICmpInst::ICMP_EQ, low_bits, CONST_V(block, width, 0));
+    is_case = llvm::BinaryOperator::CreateAnd(in_range, is_aligned, "", block);
+  }
+
+  auto dispatch_block = llvm::BasicBlock::Create(C, "", F);
+  llvm::BranchInst::Create(dispatch_block, default_block, is_case, block);
+
+  auto index = llvm::BinaryOperator::CreateLShr(
+      offset, CONST_V(block, width, shift), "", dispatch_block);
+  llvm::Value *indices[] = {CONST_V<32>(dispatch_block, 0), index};
+  auto slot = llvm::GetElementPtrInst::CreateInBounds(
+      table, indices, "", dispatch_block);
+  auto target = new llvm::LoadInst(slot, "", dispatch_block);
+
+  std::unordered_set<llvm::BasicBlock *> dests;
+  auto br = llvm::IndirectBrInst::Create(target, cases.size() + 1,
+                                         dispatch_block);
+  br->addDestination(default_block);
+  dests.insert(default_block);
+  for (const auto &entry : cases) {
+    if (dests.insert(entry.second).second) {
+      br->addDestination(entry.second);
+    }
+  }
+  return true;
+}
+
 template<int bitness>
 static void doJumpTableViaSwitchReg(TranslationContext &ctx,
                                     llvm::BasicBlock *&block,
@@ -271,6 +382,17 @@ static void doJumpTableViaSwitchReg(TranslationContext &ctx,
   const std::vector<VA> &jmpblocks = jmpptr->getJumpTable();
   std::unordered_set<VA> uniq_blocks(jmpblocks.begin(), jmpblocks.end());
 
+  std::map<VA, llvm::BasicBlock *> cases;
+  for (auto blockVA : uniq_blocks) {
+    auto toBlock = ctx.va_to_bb[blockVA];
+    TASSERT(toBlock != NULL, "Could not find block!");
+    cases[blockVA] = toBlock;
+  }
+
+  if (doJumpTableViaIndirectBr(block, regVal, cases, default_block)) {
+    return;
+  }
+
   // create a switch inst
   auto theSwitch = llvm::SwitchInst::Create(regVal, default_block,
                                             uniq_blocks.size(), block);
@@ -312,6 +434,17 @@ void doJumpOffsetTableViaSwitchReg(TranslationContext &ctx,
   switch_val = llvm::BinaryOperator::CreateAnd(switch_val,
                                                CONST_V<64>(block, 0xFFFFFFFF),
                                                "", block);
+
+  std::map<VA, llvm::BasicBlock *> cases;
+  for (const auto &entry : uniq_blocks) {
+    auto toBlock = ctx.va_to_bb[entry.second];
+    TASSERT(toBlock != NULL, "Could not find block!");
+    cases[entry.first] = toBlock;
+  }
+
+  if (doJumpTableViaIndirectBr(block, switch_val, cases, default_block)) {
+    return;
+  }
   // create a switch inst
   auto theSwitch = llvm::SwitchInst::Create(switch_val, default_block,
                                             uniq_blocks.size(), block);
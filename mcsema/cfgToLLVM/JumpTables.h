@@ -132,10 +132,10 @@ class JumpIndexTable : public Table<uint8_t> {
 typedef MCSJumpTable *MCSJumpTablePtr;
 typedef JumpIndexTable *JumpIndexTablePtr;
 
-bool addJumpTableDataSection(TranslationContext &ctx, VA &newVA,
-                             const MCSJumpTable &table);
+bool addJumpTableDataSection(NativeModulePtr natMod, llvm::Module *M,
+                             VA &newVA, const MCSJumpTable &table);
 
-bool addJumpIndexTableDataSection(TranslationContext &ctx,
+bool addJumpIndexTableDataSection(NativeModulePtr natMod, llvm::Module *M,
                                   VA &newVA, const JumpIndexTable &table);
 
 // check for the format:
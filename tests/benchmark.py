@@ -0,0 +1,466 @@
+#!/usr/bin/env python
+"""Benchmark mcsema-lift on synthetic CFGs.
+
+Generates CFG modules of increasing size from a fixed set of parameters
+(function count, blocks per function, control flow shape, instruction mix,
+jump table density, and data section size), lifts each one with
+`-stats-json`, and reports the time spent reading the CFG, lifting, and
+writing bitcode. Results can be
+saved with `--output` and compared against a previous run with `--compare`,
+so that lifter throughput regressions and superlinear scaling show up
+between commits.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+MY_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.append(os.path.join(MY_DIR, "..", "generated"))
+
+import CFG_pb2
+
+# Encodings of register-only instructions that are lifted by each of the
+# `*_populateDispatchMap` families. They all decode the same way in 32- and
+# 64-bit mode.
+FAMILIES = {
+    "ADD": ["01c8", "83c001"],  # add eax, ecx; add eax, 1
+    "SUB": ["29c8", "83e801"],  # sub eax, ecx; sub eax, 1
+    "MOV": ["89c8", "b801000000"],  # mov eax, ecx; mov eax, 1
+    "bitops": ["21c8", "09c8", "31c8"],  # and, or, xor eax, ecx
+    "CMPTEST": ["39c8", "85c0"],  # cmp eax, ecx; test eax, eax
+    "ShiftRoll": ["c1e003", "d1e8"],  # shl eax, 3; shr eax, 1
+    "MULDIV": ["0fafc1", "f7e1"],  # imul eax, ecx; mul ecx
+    "INCDECNEG": ["ffc0", "f7d8"],  # inc eax; neg eax
+    "CMOV": ["0f44c1"],  # cmove eax, ecx
+    "SETcc": ["0f94c0"],  # sete al
+    "Stack": ["50", "59"],  # push eax; pop ecx
+    "Exchanges": ["87c8"],  # xchg eax, ecx
+    "SSE": ["660fefc1", "0f28c1", "f20f58c1"],  # pxor; movaps; addsd
+    "Misc": ["90", "99"],  # nop; cdq
+}
+
+# `mov eax, [disp32]`, where the displacement refers to the data section.
+DATA_REF = "8b0425"
+DATA_REF_LEN = len(DATA_REF) // 2 + 4
+
+DEFAULT_MIX = "ADD=3,SUB=2,MOV=4,bitops=2,CMPTEST=2,ShiftRoll=1,MULDIV=1," \
+              "INCDECNEG=1,CMOV=1,SETcc=1,Stack=2,Exchanges=1,Misc=1,data=2"
+
+CODE_BASE = 0x400000
+DATA_BASE = 0x20000000
+TABLE_GAP = 0x1000
+
+# Phases reported by `-stats-json`, grouped by what the benchmark times.
+PHASE_GROUPS = {
+    "read_cfg": ["read_cfg"],
+    "lift": ["declare_functions", "insert_data_sections",
+             "preprocess_functions", "lift_functions"],
+    "write_bitcode": ["write_bitcode"],
+}
+
+
+def parse_mix(mix):
+    weights = []
+    for item in mix.split(","):
+        name, _, weight = item.partition("=")
+        if name != "data" and name not in FAMILIES:
+            raise ValueError("Unknown instruction family: {}".format(name))
+        weights.append((name, float(weight or 1)))
+    return weights
+
+
+def choose(rng, weights):
+    total = sum(w for _, w in weights)
+    pick = rng.uniform(0, total)
+    for name, weight in weights:
+        pick -= weight
+        if pick <= 0:
+            return name
+    return weights[-1][0]
+
+
+class Generator(object):
+    def __init__(self, args, num_funcs, num_blocks):
+        self.args = args
+        self.num_funcs = num_funcs
+        self.num_blocks = num_blocks
+        self.rng = random.Random(args.seed)
+        self.weights = parse_mix(args.mix)
+        if not args.data_size:
+            self.weights = [(n, w) for n, w in self.weights if n != "data"]
+        self.ptr_size = 8 if args.arch == "amd64" else 4
+        self.table_base = DATA_BASE + args.data_size + TABLE_GAP
+        self.tables = []
+        self.tables_size = 0
+        self.num_insts = 0
+
+    def plan_function(self):
+        """Choose the instructions, terminator and branch targets of each
+        block. A `jcc` falls through to the next block when not taken."""
+        n = self.num_blocks
+        blocks = []
+        for b in range(n):
+            body = [choose(self.rng, self.weights) for _ in range(self.args.insts)]
+            if b == n - 1:
+                term, targets = "ret", []
+            elif self.args.shape == "obfuscated":
+                # Opaque predicates and jumps all over the function.
+                if self.rng.random() < 0.7:
+                    term, targets = "jcc", [self.rng.randrange(n)]
+                else:
+                    term, targets = "jmp", [self.rng.randrange(1, n)]
+            elif self.args.shape == "virtualized":
+                # A dispatcher that jumps through a table to every handler,
+                # and handlers that jump back to it or leave.
+                if b == 0:
+                    term, targets = "jmptbl", list(range(1, n - 1))
+                elif self.rng.random() < 0.1:
+                    term, targets = "jcc", [n - 1]
+                else:
+                    term, targets = "jmp", [0]
+            elif self.rng.random() < self.args.jump_table_density:
+                term = "jmptbl"
+                targets = list(range(b + 1, min(b + 1 + self.args.jump_table_size, n)))
+            elif self.args.calls and self.rng.random() < 0.1:
+                body.append("call")
+                term, targets = "jcc", [min(b + 2, n - 1)]
+            else:
+                term = self.rng.choice(["jcc", "jcc", "jmp"])
+                targets = [min(b + 2, n - 1)] if term == "jcc" else [b + 1]
+            blocks.append((body, term, targets))
+        return blocks
+
+    def inst_bytes(self, family):
+        if family == "data":
+            return DATA_REF_LEN
+        elif family == "call":
+            return 5
+        return self.rng.choice(FAMILIES[family])
+
+    def emit_function(self, F, ea, plan):
+        # Choose the encodings first, so that block addresses are known before
+        # any branches are emitted.
+        layout = []
+        block_eas = []
+        for body, term, targets in plan:
+            block_eas.append(ea)
+            encodings = [self.inst_bytes(f) for f in body]
+            ea += sum(e if isinstance(e, int) else len(e) // 2 for e in encodings)
+            ea += {"ret": 1, "jmp": 5, "jcc": 6, "jmptbl": 7}[term]
+            layout.append((body, encodings, term, targets))
+
+        for b, (body, encodings, term, targets) in enumerate(layout):
+            B = F.blocks.add()
+            B.base_address = block_eas[b]
+            inst_ea = block_eas[b]
+            for family, enc in zip(body, encodings):
+                I = B.insts.add()
+                I.inst_addr = inst_ea
+                if family == "data":
+                    offset = self.rng.randrange(0, max(1, self.args.data_size - 4)) & ~3
+                    I.inst_bytes = bytes(bytearray.fromhex(DATA_REF)) + \
+                                   struct.pack("<I", DATA_BASE + offset)
+                    I.mem_reference = DATA_BASE + offset
+                    I.mem_reloc_offset = 3
+                    I.mem_ref_type = CFG_pb2.Instruction.DataRef
+                elif family == "call":
+                    target = CODE_BASE + self.rng.randrange(self.num_funcs) * \
+                             self.func_stride
+                    I.inst_bytes = b"\xe8" + struct.pack("<i", target - (inst_ea + 5))
+                else:
+                    I.inst_bytes = bytes(bytearray.fromhex(enc))
+                I.inst_len = len(I.inst_bytes)
+                inst_ea += I.inst_len
+                self.num_insts += 1
+
+            I = B.insts.add()
+            I.inst_addr = inst_ea
+            if term == "ret":
+                I.inst_bytes = b"\xc3"
+            elif term == "jmp":
+                dest = block_eas[targets[0]]
+                I.inst_bytes = b"\xe9" + struct.pack("<i", dest - (inst_ea + 5))
+                I.true_target = dest
+                B.block_follows.append(dest)
+            elif term == "jcc":
+                dest = block_eas[targets[0]]
+                I.inst_bytes = b"\x0f\x84" + struct.pack("<i", dest - (inst_ea + 6))
+                I.true_target = dest
+                I.false_target = block_eas[b + 1]
+                B.block_follows.extend(sorted(set([dest, block_eas[b + 1]])))
+            else:
+                # jmp [eax * ptr_size + table]
+                table_ea = self.table_base + self.tables_size
+                entries = [block_eas[t] for t in targets]
+                scale = {4: b"\x85", 8: b"\xc5"}[self.ptr_size]
+                I.inst_bytes = b"\xff\x24" + scale + struct.pack("<I", table_ea)
+                I.jump_table.zero_offset = 0
+                I.jump_table.table_entries.extend(entries)
+                B.block_follows.extend(sorted(set(entries)))
+                fmt = "<Q" if self.ptr_size == 8 else "<I"
+                self.tables.append(b"".join(struct.pack(fmt, e) for e in entries))
+                self.tables_size += len(self.tables[-1])
+            I.inst_len = len(I.inst_bytes)
+            self.num_insts += 1
+        return ea
+
+    def generate(self):
+        M = CFG_pb2.Module()
+        M.module_name = "benchmark"
+
+        plans = [self.plan_function() for _ in range(self.num_funcs)]
+
+        # Every function gets the same amount of address space, so that calls
+        # can target functions that haven't been emitted yet.
+        max_size = self.num_blocks * (self.args.insts + 2) * 8
+        self.func_stride = (max_size + 15) & ~15
+
+        for i, plan in enumerate(plans):
+            F = M.internal_funcs.add()
+            F.entry_address = CODE_BASE + i * self.func_stride
+            end = self.emit_function(F, F.entry_address, plan)
+            assert end - F.entry_address <= self.func_stride
+
+        if self.args.data_size:
+            D = M.internal_data.add()
+            D.base_address = DATA_BASE
+            # Mix runs of zeros in with the data, as real .data/.bss sections do.
+            data = bytearray(self.args.data_size)
+            for i in range(0, self.args.data_size, 256):
+                if self.rng.random() < 0.5:
+                    for j in range(i, min(i + 256, self.args.data_size)):
+                        data[j] = self.rng.randrange(256)
+            D.data = bytes(data)
+            D.read_only = False
+
+        if self.tables:
+            D = M.internal_data.add()
+            D.base_address = self.table_base
+            D.data = b"".join(self.tables)
+            D.read_only = True
+
+        E = M.entries.add()
+        E.entry_name = "bench_entry"
+        E.entry_address = CODE_BASE
+
+        return M
+
+
+def run_lifter(args, cfg_file, work_dir):
+    bc_file = os.path.join(work_dir, "bench.bc")
+    stats_file = os.path.join(work_dir, "stats.json")
+    cmd = [args.lift,
+           "-arch", args.arch,
+           "-os", "linux",
+           "-cfg", cfg_file,
+           "-entrypoint", "bench_entry",
+           "-ignore-unsupported",
+           "-output", bc_file,
+           "-stats-json=" + stats_file]
+    cmd.extend(args.lift_args)
+
+    start = time.time()
+    with open(os.devnull, "w") as devnull:
+        subprocess.check_call(cmd, stdout=devnull, stderr=devnull)
+    total = time.time() - start
+
+    with open(stats_file) as f:
+        stats = json.load(f)
+
+    phases = dict((group, 0.0) for group in PHASE_GROUPS)
+    for phase in stats["phases"]:
+        for group, names in PHASE_GROUPS.items():
+            if phase["name"] in names:
+                phases[group] += phase["wall_seconds"]
+    phases["total"] = total
+    return phases, stats.get("peak_rss_bytes", 0)
+
+
+def benchmark(args, work_dir):
+    results = []
+    sizes = [(f, b) for b in args.blocks for f in args.functions]
+    for num_funcs, num_blocks in sizes:
+        gen = Generator(args, num_funcs, num_blocks)
+        cfg_file = os.path.join(work_dir, "bench_{}_{}.cfg".format(
+            num_funcs, num_blocks))
+        with open(cfg_file, "wb") as f:
+            f.write(gen.generate().SerializeToString())
+
+        # Keep the fastest of each phase; the slower runs are noise.
+        best = None
+        peak_rss = 0
+        for _ in range(args.repeat):
+            phases, rss = run_lifter(args, cfg_file, work_dir)
+            peak_rss = max(peak_rss, rss)
+            if best is None:
+                best = phases
+            else:
+                best = dict((k, min(best[k], phases[k])) for k in best)
+
+        result = {
+            "functions": num_funcs,
+            "blocks": num_blocks,
+            "instructions": gen.num_insts,
+            "cfg_bytes": os.path.getsize(cfg_file),
+            "phases": best,
+            "peak_rss_bytes": peak_rss,
+        }
+        results.append(result)
+        print("{:>8} funcs {:>8} blocks {:>10} insts  read {:8.3f}s  "
+              "lift {:8.3f}s  write {:8.3f}s  total {:8.3f}s  {:8.1f} insts/ms  "
+              "{:6d} MiB".format(
+                  num_funcs, num_blocks, gen.num_insts, best["read_cfg"], best["lift"],
+                  best["write_bitcode"], best["total"],
+                  gen.num_insts / max(best["lift"], 1e-9) / 1000.0,
+                  peak_rss // (1024 * 1024)))
+    return results
+
+
+def check_scaling(args, results):
+    """Warn when the lift time per instruction grows with the module size."""
+    ok = True
+    for prev, cur in zip(results, results[1:]):
+        for group in ("read_cfg", "lift", "write_bitcode"):
+            prev_rate = prev["phases"][group] / max(prev["instructions"], 1)
+            cur_rate = cur["phases"][group] / max(cur["instructions"], 1)
+            if prev["phases"][group] < 0.01 or not prev_rate:
+                continue
+            growth = cur_rate / prev_rate
+            if growth > args.scaling_threshold:
+                print("WARNING: {} time per instruction grew {:.2f}x from {}x{} "
+                      "to {}x{} functions x blocks".format(
+                          group, growth, prev["functions"], prev["blocks"],
+                          cur["functions"], cur["blocks"]))
+                ok = False
+    return ok
+
+
+def compare(args, results):
+    """Compare `results` against a previous run saved with `--output`."""
+    with open(args.compare) as f:
+        baseline = json.load(f)
+
+    # Results saved before `--blocks` took a list all have the same size.
+    old_blocks = baseline["config"].get("blocks")
+    if isinstance(old_blocks, list):
+        old_blocks = old_blocks[0]
+    old_results = dict(((r["functions"], r.get("blocks", old_blocks)), r)
+                       for r in baseline["results"])
+    ok = True
+    for result in results:
+        old = old_results.get((result["functions"], result["blocks"]))
+        if not old:
+            continue
+        for group in ("read_cfg", "lift", "write_bitcode", "total"):
+            old_time = old["phases"][group]
+            new_time = result["phases"][group]
+            if old_time < 0.01:
+                continue
+            ratio = new_time / old_time
+            marker = ""
+            if ratio > 1.0 + args.regression_threshold:
+                marker = "  REGRESSION"
+                ok = False
+            print("{:>8} funcs {:>8} blocks {:>14}: {:8.3f}s -> {:8.3f}s "
+                  "({:+.1f}%){}".format(
+                result["functions"], result["blocks"], group, old_time, new_time,
+                (ratio - 1.0) * 100.0, marker))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument(
+        "--lift", default=os.path.join(MY_DIR, "..", "build", "mcsema-lift"),
+        help="Path to mcsema-lift.")
+    parser.add_argument("--arch", default="amd64", choices=["x86", "amd64"])
+    parser.add_argument(
+        "--functions", default="100,1000,10000",
+        type=lambda s: [int(n) for n in s.split(",")],
+        help="Comma-separated function counts of the generated modules.")
+    parser.add_argument(
+        "--blocks", default="8",
+        type=lambda s: [int(n) for n in s.split(",")],
+        help="Comma-separated numbers of basic blocks per function. Every "
+             "function count is generated with every block count.")
+    parser.add_argument(
+        "--shape", default="linear",
+        choices=["linear", "obfuscated", "virtualized"],
+        help="Control flow of the functions. 'linear' branches to nearby "
+             "blocks. 'obfuscated' has opaque predicates and jumps to random "
+             "blocks. 'virtualized' is a dispatcher with one jump table over "
+             "every handler block, as in VM-based obfuscators.")
+    parser.add_argument("--insts", type=int, default=8,
+                        help="Instructions per basic block, excluding the "
+                             "terminator.")
+    parser.add_argument("--mix", default=DEFAULT_MIX,
+                        help="Relative weights of each instruction family, "
+                             "as family=weight pairs. The 'data' family "
+                             "loads from the data section.")
+    parser.add_argument("--jump-table-density", type=float, default=0.05,
+                        help="Fraction of blocks that end in a jump table.")
+    parser.add_argument("--jump-table-size", type=int, default=4,
+                        help="Maximum number of entries in each jump table.")
+    parser.add_argument("--data-size", type=int, default=64 * 1024,
+                        help="Size of the data section, in bytes.")
+    parser.add_argument("--no-calls", dest="calls", action="store_false",
+                        help="Don't generate calls between functions.")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="Lift each module this many times, and keep the "
+                             "fastest time of each phase.")
+    parser.add_argument("--lift-args", default=[], nargs=argparse.REMAINDER,
+                        help="Extra arguments passed to mcsema-lift.")
+    parser.add_argument("--output", help="Save the results to this file.")
+    parser.add_argument("--compare",
+                        help="Compare against results saved with --output.")
+    parser.add_argument("--regression-threshold", type=float, default=0.1,
+                        help="Fractional slowdown reported as a regression.")
+    parser.add_argument("--scaling-threshold", type=float, default=1.5,
+                        help="Growth in time per instruction, between "
+                             "consecutive module sizes, reported as "
+                             "superlinear.")
+    parser.add_argument("--keep", action="store_true",
+                        help="Keep the generated CFGs and bitcode.")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.lift):
+        parser.error("Could not find mcsema-lift at {}".format(args.lift))
+
+    work_dir = tempfile.mkdtemp(prefix="mcsema-bench-")
+    try:
+        results = benchmark(args, work_dir)
+    finally:
+        if args.keep:
+            print("Kept generated files in {}".format(work_dir))
+        else:
+            shutil.rmtree(work_dir)
+
+    ok = check_scaling(args, results)
+
+    if args.output:
+        config = dict(vars(args))
+        config.pop("compare", None)
+        config.pop("output", None)
+        with open(args.output, "w") as f:
+            json.dump({"config": config, "results": results}, f, indent=2,
+                      sort_keys=True)
+
+    if args.compare:
+        ok = compare(args, results) and ok
+
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
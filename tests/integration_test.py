@@ -8,6 +8,7 @@ import shutil
 import platform
 import json
 import base64
+import struct
 
 DEBUG = False
 
@@ -242,6 +243,566 @@ class LinuxTest(unittest.TestCase):
                 "-llzma"]
         self._runAMD64Test("xz", buildargs=libs)
 
+class LiftedCodeTest(unittest.TestCase):
+    """ Base class of the tests that lift small, synthetic CFGs, and check
+        the bitcode, or what the lifted code computes. The bitcode is only
+        checked if llvm-dis-3.8 is installed, and the lifted code is only run
+        on Linux, with clang-3.8.
+    """
+
+    CODE_BASE = 0x400000
+
+    # Opcodes of branches and calls with a rel32 operand.
+    JMP = b"\xe9"
+    CALL = b"\xe8"
+    RET = b"\xc3"
+
+    def setUp(self):
+        self.test_dir = tempfile.mkdtemp()
+        self.my_dir = os.path.dirname(__file__)
+        self.mcsema_lift = os.path.realpath(
+            os.path.join(self.my_dir, "..", "build", "mcsema-lift"))
+        self.mcsema_gencode = os.path.realpath(
+            os.path.join(self.my_dir, "..", "generated"))
+        sys.path.append(self.mcsema_gencode)
+
+        self.on_test_os = platform.system().lower() == "linux"
+        self.clang = self._findTool("clang-3.8")
+        self.llvm_dis = self._findTool("llvm-dis-3.8")
+
+    def tearDown(self):
+        if not DEBUG:
+            shutil.rmtree(self.test_dir)
+
+    def _findTool(self, name):
+        try:
+            return subprocess.check_output(["which", name]).strip()
+        except (OSError, subprocess.CalledProcessError):
+            return None
+
+    def _module(self):
+        import CFG_pb2
+
+        M = CFG_pb2.Module()
+        M.module_name = self.id().split(".")[-1]
+        return M
+
+    def _addEntry(self, M, name, ea):
+        E = M.entries.add()
+        E.entry_name = name
+        E.entry_address = ea
+
+    def _addFunction(self, M, ea, blocks):
+        """ Adds a function that starts at `ea` to `M`, and returns it.
+            `blocks` is a list of `(label, insts)`, laid out one after the
+            other, unless the label is an address. An instruction is either
+            its bytes, or `(opcode, target)` for a branch or call with a rel32
+            operand, where `target` is a label or an address. A block falls
+            through to the next one, unless it ends with a JMP or RET.
+        """
+        addrs = {}
+        end = ea
+        for label, insts in blocks:
+            if isinstance(label, int):
+                end = label
+            addrs[label] = end
+            for inst in insts:
+                if isinstance(inst, bytes):
+                    end += len(inst)
+                else:
+                    end += len(inst[0]) + 4
+
+        F = M.internal_funcs.add()
+        F.entry_address = ea
+        for i, (label, insts) in enumerate(blocks):
+            B = F.blocks.add()
+            B.base_address = addrs[label]
+            follows = []
+            va = addrs[label]
+            for inst in insts:
+                opcode = inst
+                if not isinstance(inst, bytes):
+                    opcode, target = inst
+                    target = addrs.get(target, target)
+                    inst = opcode + struct.pack(
+                        "<i", target - (va + len(opcode) + 4))
+                    if opcode != self.CALL:
+                        follows.append(target)
+
+                I = B.insts.add()
+                I.inst_addr = va
+                I.inst_bytes = inst
+                I.inst_len = len(inst)
+                va += len(inst)
+
+            if opcode not in (self.JMP, self.RET) and i + 1 < len(blocks):
+                follows.append(addrs[blocks[i + 1][0]])
+            B.block_follows.extend(follows)
+        return F
+
+    def _lift(self, M, arch, extra_args=None):
+        """ Lifts `M`, with a driver for each of its entry points. Returns
+            the lifter's exit code and the bitcode file. """
+        name = "{}_{}".format(M.module_name, arch)
+        cfg_file = os.path.join(self.test_dir, name + ".cfg")
+        bc_file = os.path.join(self.test_dir, name + ".bc")
+        with open(cfg_file, "wb") as f:
+            f.write(M.SerializeToString())
+
+        args = [self.mcsema_lift,
+                "-arch", arch,
+                "-os", "linux",
+                "-cfg", cfg_file,
+                "-output", bc_file]
+        for E in M.entries:
+            args.extend(["-entrypoint", E.entry_name])
+        if extra_args:
+            args.extend(extra_args)
+
+        with open(os.devnull, "w") as devnull:
+            if DEBUG:
+                sys.stderr.write("executing: {}\n".format(" ".join(args)))
+            po = subprocess.Popen(args, stdout=devnull, stderr=devnull)
+            po.wait()
+        return po.returncode, bc_file
+
+    def _checkLift(self, M, arch, extra_args=None):
+        returncode, bc_file = self._lift(M, arch, extra_args)
+        self.assertEqual(returncode, 0)
+        self.assertTrue(os.path.exists(bc_file))
+        self.assertGreater(os.path.getsize(bc_file), 0)
+        return bc_file
+
+    def _disassemble(self, bc_file):
+        """ Returns the textual IR of `bc_file`, or `None` if there is no
+            llvm-dis-3.8. """
+        if not self.llvm_dis:
+            return None
+        ll_file = os.path.splitext(bc_file)[0] + ".ll"
+        subprocess.check_call([self.llvm_dis, "-o", ll_file, bc_file])
+        with open(ll_file, "r") as f:
+            return f.read()
+
+    def _execute(self, M, arch, bc_file):
+        """ Builds `bc_file` into a program that calls every entry point of
+            `M`, and runs it. Returns the process ID of the program and the
+            values that the entry points returned, or `None` if the lifted
+            code can't be run here. """
+        if not self.on_test_os or not self.clang:
+            return None
+
+        generated_asm = {
+                "amd64": "ELF_64_linux.S",
+                "x86": "ELF_32_linux.S",}
+        flags = {
+                "amd64": "-m64",
+                "x86": "-m32", }
+
+        main_file = os.path.join(self.test_dir, "main.c")
+        with open(main_file, "w") as f:
+            f.write("#include <stdio.h>\n")
+            for E in M.entries:
+                f.write("extern int {}(void);\n".format(E.entry_name))
+            f.write("int main(void) {\n")
+            for E in M.entries:
+                f.write("  printf(\"%d\\n\", {}());\n".format(E.entry_name))
+            f.write("  return 0;\n}\n")
+
+        exe_file = os.path.splitext(bc_file)[0] + ".exe"
+        subprocess.check_call([self.clang,
+                               "-O3",
+                               flags[arch],
+                               "-o", exe_file,
+                               os.path.join(self.mcsema_gencode,
+                                            generated_asm[arch]),
+                               main_file,
+                               bc_file])
+
+        po = subprocess.Popen([exe_file], stdout=subprocess.PIPE)
+        out, _ = po.communicate()
+        self.assertEqual(po.returncode, 0)
+        return po.pid, [int(line) for line in out.split()]
+
+    def _checkRun(self, M, arch, bc_file, expected):
+        """ Checks that the entry points of `M` return `expected`, if the
+            lifted code can be run here. """
+        result = self._execute(M, arch, bc_file)
+        if result is not None:
+            self.assertEqual(result[1], expected)
+
+class DeadFlagsTest(LiftedCodeTest):
+    """ Lift code whose flags are read in a later block, with and without
+        -eliminate-dead-flags.
+    """
+
+    def testFlagsReadInLaterBlock(self):
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("head", [b"\xb8\x05\x00\x00\x00",  # mov eax, 5
+                      b"\xb9\x06\x00\x00\x00",  # mov ecx, 6
+                      b"\x39\xc8",              # cmp eax, ecx
+                      (self.JMP, "tail")]),
+
+            # INC leaves CF alone, so ADC adds the borrow of the CMP.
+            ("tail", [b"\xff\xc1",              # inc ecx
+                      b"\x11\xc8",              # adc eax, ecx
+                      self.RET])])
+        self._addEntry(M, "dead_flags_entry", self.CODE_BASE)
+
+        for arch in ["x86", "amd64"]:
+            for args in [[], ["-eliminate-dead-flags=false"]]:
+                bc_file = self._checkLift(M, arch, args)
+                self._checkRun(M, arch, bc_file, [13])
+
+class RepMovsTest(LiftedCodeTest):
+    """ Lift REP MOVSB between overlapping buffers on the stack. """
+
+    def _copyModule(self, arch, src_disp, dst_disp):
+        """ Copies 6 of the bytes 01..08 on the stack, from `src_disp` to
+            `dst_disp`, and returns the last four bytes. """
+        rex_w = b"\x48" if arch == "amd64" else b""
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("entry", [rex_w + b"\x83\xec\x10",                  # sub rsp, 16
+                       b"\xc7\x04\x24\x01\x02\x03\x04",          # mov dword [rsp], 0x04030201
+                       b"\xc7\x44\x24\x04\x05\x06\x07\x08",      # mov dword [rsp+4], 0x08070605
+                       rex_w + b"\x8d\x74\x24" + chr(src_disp),  # lea rsi, [rsp+src_disp]
+                       rex_w + b"\x8d\x7c\x24" + chr(dst_disp),  # lea rdi, [rsp+dst_disp]
+                       b"\xb9\x06\x00\x00\x00",                  # mov ecx, 6
+                       b"\xfc",                                  # cld
+                       b"\xf3\xa4",                              # rep movsb
+                       b"\x8b\x44\x24\x04",                      # mov eax, [rsp+4]
+                       rex_w + b"\x83\xc4\x10",                  # add rsp, 16
+                       self.RET])])
+        self._addEntry(M, "rep_movs_entry", self.CODE_BASE)
+        return M
+
+    def testDestinationInsideSource(self):
+        # Copying forward replicates the first byte.
+        for arch in ["x86", "amd64"]:
+            M = self._copyModule(arch, 0, 1)
+            bc_file = self._checkLift(M, arch)
+            ir = self._disassemble(bc_file)
+            if ir is not None:
+                self.assertIn("@llvm.memmove", ir)
+            self._checkRun(M, arch, bc_file, [0x08010101])
+
+    def testDestinationBelowSource(self):
+        for arch in ["x86", "amd64"]:
+            M = self._copyModule(arch, 1, 0)
+            bc_file = self._checkLift(M, arch)
+            self._checkRun(M, arch, bc_file, [0x08070706])
+
+class X87StackTest(LiftedCodeTest):
+    """ Lift x87 code that pushes, exchanges and pops the register stack,
+        across a block boundary.
+    """
+
+    def testPushExchangePop(self):
+        for arch in ["x86", "amd64"]:
+            rex_w = b"\x48" if arch == "amd64" else b""
+            M = self._module()
+            self._addFunction(M, self.CODE_BASE, [
+                ("head", [rex_w + b"\x83\xec\x10",              # sub rsp, 16
+                          b"\xc7\x04\x24\x03\x00\x00\x00",      # mov dword [rsp], 3
+                          b"\xc7\x44\x24\x04\x14\x00\x00\x00",  # mov dword [rsp+4], 20
+                          b"\xdb\x04\x24",                      # fild dword [rsp]
+                          b"\xdb\x44\x24\x04",                  # fild dword [rsp+4]
+                          (self.JMP, "tail")]),
+                ("tail", [b"\xd9\xc9",                          # fxch st1
+                          b"\xd9\xe8",                          # fld1
+                          b"\xb9\x01\x00\x00\x00",              # mov ecx, 1
+                          b"\xde\xc1",                          # faddp st1, st0
+                          b"\xdb\x5c\x24\x08",                  # fistp dword [rsp+8]
+                          b"\xdb\x5c\x24\x0c",                  # fistp dword [rsp+12]
+                          b"\x8b\x44\x24\x0c",                  # mov eax, [rsp+12]
+                          b"\x2b\x44\x24\x08",                  # sub eax, [rsp+8]
+                          rex_w + b"\x83\xc4\x10",              # add rsp, 16
+                          self.RET])])
+            self._addEntry(M, "x87_entry", self.CODE_BASE)
+
+            # The breakpoints see the register state between instructions,
+            # with the ST registers in stack order.
+            for args in [[], ["-add-breakpoints"]]:
+                bc_file = self._checkLift(M, arch, args)
+                self._checkRun(M, arch, bc_file, [16])
+
+class DeadRegsTest(LiftedCodeTest):
+    """ Lift code with -eliminate-dead-regs, where the registers that a
+        function writes are read by its caller.
+    """
+
+    def testRegistersReadAfterReturn(self):
+        helper = self.CODE_BASE + 0x100
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("entry", [(self.CALL, helper),
+                       b"\x01\xd1",                 # add ecx, edx
+                       b"\x89\xc8",                 # mov eax, ecx
+                       self.RET])])
+        self._addFunction(M, helper, [
+            ("helper", [b"\xb9\x28\x00\x00\x00",    # mov ecx, 40
+                        b"\xba\x02\x00\x00\x00",    # mov edx, 2
+                        b"\xb8\x07\x00\x00\x00",    # mov eax, 7
+                        self.RET])])
+        self._addEntry(M, "dead_regs_entry", self.CODE_BASE)
+
+        for arch in ["x86", "amd64"]:
+            bc_file = self._checkLift(M, arch, ["-eliminate-dead-regs"])
+            self._checkRun(M, arch, bc_file, [42])
+
+class StackFrameTest(LiftedCodeTest):
+    """ Lift functions with a frame pointer prologue with
+        -recover-stack-frames.
+    """
+
+    PROLOGUE = [b"\x55",                    # push rbp
+                b"\x48\x89\xe5",            # mov rbp, rsp
+                b"\x48\x83\xec\x10"]        # sub rsp, 16
+
+    EPILOGUE = [b"\xc9",                    # leave
+                LiftedCodeTest.RET]
+
+    def _frameModule(self, body):
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("entry", self.PROLOGUE + body + self.EPILOGUE)])
+        self._addEntry(M, "stack_frame_entry", self.CODE_BASE)
+        return M
+
+    def testAccessesInFrame(self):
+        M = self._frameModule([
+            b"\xc7\x45\xfc\x05\x00\x00\x00",    # mov dword [rbp-4], 5
+            b"\x8b\x45\xfc"])                   # mov eax, [rbp-4]
+        bc_file = self._checkLift(M, "amd64", ["-recover-stack-frames"])
+        ir = self._disassemble(bc_file)
+        if ir is not None:
+            self.assertIn("%stack_frame = alloca [16 x i8]", ir)
+        self._checkRun(M, "amd64", bc_file, [5])
+
+    def testAccessAboveFrame(self):
+        # The 8-byte read at [rbp-4] also reads the saved frame pointer, so
+        # the frame stays on the native stack, and the read sees the dword
+        # written before it.
+        M = self._frameModule([
+            b"\xc7\x45\xfc\x05\x00\x00\x00",    # mov dword [rbp-4], 5
+            b"\xc7\x45\xf8\x07\x00\x00\x00",    # mov dword [rbp-8], 7
+            b"\x48\x8b\x55\xfc",                # mov rdx, [rbp-4]
+            b"\x89\xd0",                        # mov eax, edx
+            b"\x48\xc1\xea\x20",                # shr rdx, 32
+            b"\x2b\x55\x00",                    # sub edx, [rbp]
+            b"\x01\xd0",                        # add eax, edx
+            b"\x03\x45\xf8"])                   # add eax, [rbp-8]
+        bc_file = self._checkLift(M, "amd64", ["-recover-stack-frames"])
+        ir = self._disassemble(bc_file)
+        if ir is not None:
+            self.assertNotIn("%stack_frame = alloca", ir)
+        self._checkRun(M, "amd64", bc_file, [12])
+
+class FusedIdiomsTest(LiftedCodeTest):
+    """ Lift instruction pairs that -fuse-idioms lifts as a unit. """
+
+    JLE = b"\x0f\x8e"
+    JBE = b"\x0f\x86"
+    JL = b"\x0f\x8c"
+    JE = b"\x0f\x84"
+
+    def _checkFused(self, blocks, expected):
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, blocks)
+        self._addEntry(M, "fused_entry", self.CODE_BASE)
+        for arch in ["x86", "amd64"]:
+            for args in [["-fuse-idioms"], []]:
+                bc_file = self._checkLift(M, arch, args)
+                self._checkRun(M, arch, bc_file, [expected])
+
+    def testTestAndBranch(self):
+        # TEST of a negative value: JLE is taken, because SF != OF, but JBE
+        # isn't, because CF and ZF are clear.
+        self._checkFused([
+            ("head", [b"\xb8\x00\x00\x00\x00",      # mov eax, 0
+                      b"\xb9\x00\x00\x00\x80",      # mov ecx, 0x80000000
+                      b"\x85\xc9",                  # test ecx, ecx
+                      (self.JLE, "signed")]),
+            ("not_signed", [b"\xb8\x64\x00\x00\x00",    # mov eax, 100
+                            self.RET]),
+            ("signed", [b"\x85\xc9",                # test ecx, ecx
+                        (self.JBE, "unsigned")]),
+            ("not_unsigned", [b"\x83\xc0\x01",      # add eax, 1
+                              self.RET]),
+            ("unsigned", [b"\xb8\xc8\x00\x00\x00",  # mov eax, 200
+                          self.RET])], 1)
+
+    def testZeroingXorSetsFlags(self):
+        # xor eax, eax replaces the flags of the CMP: JL isn't taken, and JE
+        # is.
+        self._checkFused([
+            ("head", [b"\xb9\x03\x00\x00\x00",      # mov ecx, 3
+                      b"\x83\xf9\x05",              # cmp ecx, 5
+                      b"\x31\xc0",                  # xor eax, eax
+                      (self.JL, "less")]),
+            ("not_less", [(self.JE, "equal")]),
+            ("not_equal", [b"\xb8\x64\x00\x00\x00",     # mov eax, 100
+                           self.RET]),
+            ("less", [b"\xb8\xc8\x00\x00\x00",      # mov eax, 200
+                      self.RET]),
+            ("equal", [b"\x83\xc0\x07",             # add eax, 7
+                       self.RET])], 7)
+
+    def testPushPop(self):
+        self._checkFused([
+            ("entry", [b"\xb9\x2a\x00\x00\x00",     # mov ecx, 42
+                       b"\x51",                     # push rcx
+                       b"\x58",                     # pop rax
+                       self.RET])], 42)
+
+class ElideReturnAddressTest(LiftedCodeTest):
+    """ Lift direct calls with -elide-return-addresses. """
+
+    def testCallsToLeafFunction(self):
+        helper = self.CODE_BASE + 0x100
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("entry", [b"\xb8\x02\x00\x00\x00",     # mov eax, 2
+                       (self.CALL, helper),
+                       (self.CALL, helper),
+                       self.RET])])
+        self._addFunction(M, helper, [
+            ("helper", [b"\x83\xc0\x28",            # add eax, 40
+                        self.RET])])
+        self._addEntry(M, "elide_entry", self.CODE_BASE)
+
+        for arch in ["x86", "amd64"]:
+            bc_file = self._checkLift(M, arch, ["-elide-return-addresses"])
+            self._checkRun(M, arch, bc_file, [82])
+
+class ShareBlocksTest(LiftedCodeTest):
+    """ Lift two functions that jump to the same epilogue, with
+        -share-blocks.
+    """
+
+    def testSharedTail(self):
+        tail = self.CODE_BASE + 0x100
+        tail_insts = [b"\x83\xc0\x01",              # add eax, 1
+                      self.RET]
+
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("head", [b"\xb8\x0a\x00\x00\x00",      # mov eax, 10
+                      (self.JMP, tail)]),
+            (tail, tail_insts)])
+        self._addFunction(M, self.CODE_BASE + 0x80, [
+            ("head", [b"\xb8\x14\x00\x00\x00",      # mov eax, 20
+                      (self.JMP, tail)]),
+            (tail, tail_insts)])
+        self._addEntry(M, "share_entry_1", self.CODE_BASE)
+        self._addEntry(M, "share_entry_2", self.CODE_BASE + 0x80)
+
+        for arch in ["x86", "amd64"]:
+            bc_file = self._checkLift(M, arch, ["-share-blocks"])
+            ir = self._disassemble(bc_file)
+            if ir is not None:
+                self.assertIn("@tail_{:x}(".format(tail), ir)
+            self._checkRun(M, arch, bc_file, [11, 21])
+
+class SyscallTest(LiftedCodeTest):
+    """ Lift Linux system calls whose number is in the CFG. """
+
+    def testGetpid(self):
+        syscalls = {
+            "amd64": (39, b"\x0f\x05", "syscall"),
+            "x86": (20, b"\xcd\x80", "int $$0x80")}
+
+        for arch, (number, insn, asm) in syscalls.items():
+            M = self._module()
+            F = self._addFunction(M, self.CODE_BASE, [
+                ("entry", [b"\xb8" + struct.pack("<I", number),  # mov eax, N
+                           insn,
+                           self.RET])])
+            F.blocks[0].insts[1].system_call_number = number
+            self._addEntry(M, "getpid_entry", self.CODE_BASE)
+
+            bc_file = self._checkLift(M, arch)
+            ir = self._disassemble(bc_file)
+            if ir is not None:
+                self.assertIn("asm sideeffect \"{}\"".format(asm), ir)
+                self.assertNotIn("@syscall(", ir)
+
+            result = self._execute(M, arch, bc_file)
+            if result is not None:
+                pid, values = result
+                self.assertEqual(values, [pid])
+
+class SuperblockTest(LiftedCodeTest):
+    """ Lift synthetic CFGs with -form-superblocks, where a hot block that
+        is merged with its only successor stops being lifted early.
+    """
+
+    DATA_BASE = 0x600000
+
+    def _superblockModule(self, body):
+        """ Returns a CFG with one function, whose entry block runs `body`
+            and jumps to a block that returns. The second block has no other
+            predecessors, so it is merged into the first. """
+        M = self._module()
+        self._addFunction(M, self.CODE_BASE, [
+            ("head", body + [(self.JMP, "tail")]),
+            ("tail", [b"\x01\xc8",                  # add eax, ecx
+                      self.RET])])
+
+        D = M.internal_data.add()
+        D.base_address = self.DATA_BASE
+        D.data = b"\0" * 16
+        D.read_only = False
+
+        self._addEntry(M, "superblock_entry", self.CODE_BASE)
+        return M
+
+    def _liftSuperblocks(self, M, arch, extra_args):
+        """ Lifts `M` with a profile in which all blocks are hot. """
+        profile_file = os.path.join(self.test_dir, "superblock.profile")
+        with open(profile_file, "w") as f:
+            for B in M.internal_funcs[0].blocks:
+                f.write("{:x} 1000\n".format(B.base_address))
+
+        args = ["-profile", profile_file,
+                "-form-superblocks",
+                "-verify=functions"]
+        args.extend(extra_args)
+        return self._lift(M, arch, args)
+
+    def _checkLifts(self, M):
+        for arch in ["x86", "amd64"]:
+            returncode, bc_file = self._liftSuperblocks(
+                M, arch, ["-ignore-unsupported"])
+            self.assertEqual(returncode, 0)
+            self.assertTrue(os.path.exists(bc_file))
+            self.assertGreater(os.path.getsize(bc_file), 0)
+
+    def testUnsupportedInMergedBlock(self):
+        M = self._superblockModule([b"\xb8\x01\x00\x00\x00",  # mov eax, 1
+                                    b"\x0f\xae\xe8",          # lfence
+                                    b"\x83\xc0\x01"])         # add eax, 1
+        self._checkLifts(M)
+
+        # Without -ignore-unsupported the lift fails, but doesn't crash.
+        for arch in ["x86", "amd64"]:
+            returncode, _ = self._liftSuperblocks(M, arch, [])
+            self.assertGreater(returncode, 0)
+
+    def testEndBlockInMergedBlock(self):
+        import CFG_pb2
+
+        # neg dword [DATA_BASE]; add eax, 1
+        M = self._superblockModule([
+            b"\xf7\x1c\x25" + struct.pack("<I", self.DATA_BASE),
+            b"\x83\xc0\x01"])
+        I = M.internal_funcs[0].blocks[0].insts[0]
+        I.mem_reference = self.DATA_BASE
+        I.mem_reloc_offset = 3
+        I.mem_ref_type = CFG_pb2.Instruction.DataRef
+        self._checkLifts(M)
+
 if __name__ == '__main__':
     unittest.main(verbosity=2)
 
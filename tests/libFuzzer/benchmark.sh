@@ -0,0 +1,52 @@
+#!/bin/sh
+
+# Compare the fuzzing speed of the source build of `fuzzme.cc` against the
+# lifted bitcode with `driver.cc`, and with the snapshot-based
+# `persistent_driver.cc`. Run `buildFuzzer.sh` first.
+#
+# Usage: ./benchmark.sh fuzzme.bc [runs]
+
+set -e
+
+if [ $# -lt 1 ]; then
+  echo "Usage: $0 fuzzme.bc [runs]"
+  exit 1
+fi
+
+BITCODE=$1
+RUNS=${2:-1000000}
+DIR=$(cd "$(dirname "$0")" && pwd)
+STUBS=${DIR}/../../generated/ELF_64_linux.S
+SNAPSHOT=${DIR}/../../tools/snapshot/Snapshot.cc
+CXX=${CXX:-clang++-3.8}
+FLAGS="-O3 -fsanitize=address -fsanitize-coverage=edge"
+WORK=$(mktemp -d)
+trap 'rm -rf "${WORK}"' EXIT
+
+${CXX} ${FLAGS} -DSOURCE_FUZZ -o ${WORK}/source ${DIR}/fuzzme.cc ${DIR}/Fuzzer*.o
+${CXX} ${FLAGS} -o ${WORK}/lifted ${DIR}/driver.cc ${BITCODE} ${STUBS} \
+    ${DIR}/Fuzzer*.o
+${CXX} ${FLAGS} -o ${WORK}/persistent ${DIR}/persistent_driver.cc \
+    ${SNAPSHOT} ${BITCODE} ${STUBS} ${DIR}/Fuzzer*.o
+${CXX} -O3 -DPERSISTENT_BENCHMARK -o ${WORK}/loop \
+    ${DIR}/persistent_driver.cc ${SNAPSHOT} ${BITCODE} ${STUBS}
+
+# Every fuzzer starts from the same non-crashing seed, so that they explore
+# the same inputs.
+mkdir ${WORK}/corpus
+printf 'abcd' > ${WORK}/corpus/seed
+
+for FUZZER in source lifted persistent; do
+  START=$(date +%s.%N)
+  if ! ${WORK}/${FUZZER} -runs=${RUNS} -seed=1 ${WORK}/corpus \
+      > ${WORK}/${FUZZER}.log 2>&1; then
+    echo "${FUZZER}: found a crash before ${RUNS} runs; try fewer runs"
+    continue
+  fi
+  END=$(date +%s.%N)
+  echo "${FUZZER}: ${RUNS} runs, exec/s:" \
+       $(echo "${RUNS} / (${END} - ${START})" | bc)
+done
+
+# The lifted code alone, without libFuzzer.
+${WORK}/loop abcd ${RUNS}
@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../mcsema/Arch/X86/Runtime/Snapshot.h"
+
+extern int vulnerable(const char *input);
+
+// The lifted state right after the first call into lifted code. Every input
+// starts from this state, no matter where the previous one left the lifted
+// registers and stack.
+static struct McsemaSnapshot *gSnapshot = NULL;
+
+static void RestoreLiftedState(void) {
+  if (gSnapshot) {
+    __mcsema_snapshot_restore(gSnapshot);
+    return;
+  }
+
+  // The first call gives this thread its lifted stack.
+  vulnerable("");
+  gSnapshot = __mcsema_snapshot_create();
+  if (!gSnapshot) {
+    fprintf(stderr, "Unable to snapshot the lifted state\n");
+    abort();
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  RestoreLiftedState();
+  vulnerable((const char *)(data));
+  return 0;
+}
+
+#ifdef PERSISTENT_BENCHMARK
+// Run one input over and over, and report the iteration rate, without the
+// mutation and coverage bookkeeping of libFuzzer.
+int main(int argc, const char *argv[]) {
+  if (argc < 2) {
+    printf("Usage:\n");
+    printf("%s: <text> [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  long iterations = 3 > argc ? 1000000 : atol(argv[2]);
+  size_t size = strlen(argv[1]) + 1;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < iterations; ++i) {
+    LLVMFuzzerTestOneInput((const uint8_t *) argv[1], size);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) +
+                   (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%ld iterations in %f seconds, exec/s: %.0f\n", iterations, seconds,
+         iterations / seconds);
+  return 0;
+}
+#endif
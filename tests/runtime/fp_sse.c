@@ -0,0 +1,58 @@
+/* Floating point loops over arrays of floats and doubles, which compile to
+ * scalar and packed SSE code. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SIZE 4096
+
+static float xs[SIZE];
+static float ys[SIZE];
+static double ds[SIZE];
+
+static float saxpy_dot(float a) {
+  float dot = 0.0f;
+  for (int i = 0; i < SIZE; ++i) {
+    ys[i] = a * xs[i] + ys[i];
+    dot += xs[i] * ys[i];
+  }
+  return dot;
+}
+
+static double horner(double x) {
+  double y = 0.0;
+  for (int i = 0; i < 16; ++i) {
+    y = y * x + 1.0 / (i + 1);
+  }
+  return y;
+}
+
+static double smooth(void) {
+  double total = 0.0;
+  for (int i = 1; i < SIZE - 1; ++i) {
+    ds[i] = (ds[i - 1] + 2.0 * ds[i] + ds[i + 1]) * 0.25;
+    total += ds[i] > 0.5 ? ds[i] : -ds[i];
+  }
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 1 < argc ? atoi(argv[1]) : 10000;
+  for (int i = 0; i < SIZE; ++i) {
+    xs[i] = (float) (i % 17) / 17.0f;
+    ys[i] = (float) (i % 13) / 13.0f;
+    ds[i] = (double) (i % 29) / 29.0;
+  }
+
+  double checksum = 0.0;
+  for (int i = 0; i < iterations; ++i) {
+    checksum += saxpy_dot(0.001f * (float) (i % 7));
+    checksum += horner((double) (i % 100) / 100.0);
+    checksum += smooth();
+    for (int j = 0; j < SIZE; ++j) {
+      ys[j] *= 0.5f;
+    }
+  }
+  printf("%.6e\n", checksum);
+  return 0;
+}
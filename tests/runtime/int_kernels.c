@@ -0,0 +1,83 @@
+/* Integer kernels: a sieve, CRC-32, and a small integer matrix multiply. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIEVE_SIZE 100000
+#define MATRIX_SIZE 48
+
+static unsigned char sieve[SIEVE_SIZE];
+static uint32_t crc_table[256];
+static int32_t a[MATRIX_SIZE][MATRIX_SIZE];
+static int32_t b[MATRIX_SIZE][MATRIX_SIZE];
+static int32_t c[MATRIX_SIZE][MATRIX_SIZE];
+
+static uint32_t count_primes(void) {
+  uint32_t count = 0;
+  memset(sieve, 1, sizeof(sieve));
+  for (uint32_t i = 2; i < SIEVE_SIZE; ++i) {
+    if (sieve[i]) {
+      ++count;
+      for (uint32_t j = i * 2; j < SIEVE_SIZE; j += i) {
+        sieve[j] = 0;
+      }
+    }
+  }
+  return count;
+}
+
+static void init_crc(void) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; ++j) {
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1)));
+    }
+    crc_table[i] = crc;
+  }
+}
+
+static uint32_t crc32(const unsigned char *data, size_t size) {
+  uint32_t crc = 0xFFFFFFFFU;
+  for (size_t i = 0; i < size; ++i) {
+    crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static uint32_t matrix_multiply(uint32_t seed) {
+  for (int i = 0; i < MATRIX_SIZE; ++i) {
+    for (int j = 0; j < MATRIX_SIZE; ++j) {
+      seed = seed * 1103515245U + 12345U;
+      a[i][j] = (int32_t) (seed >> 16) % 100;
+      seed = seed * 1103515245U + 12345U;
+      b[i][j] = (int32_t) (seed >> 16) % 100;
+    }
+  }
+  uint32_t sum = 0;
+  for (int i = 0; i < MATRIX_SIZE; ++i) {
+    for (int j = 0; j < MATRIX_SIZE; ++j) {
+      int32_t total = 0;
+      for (int k = 0; k < MATRIX_SIZE; ++k) {
+        total += a[i][k] * b[k][j];
+      }
+      c[i][j] = total;
+      sum = sum * 31 + (uint32_t) total;
+    }
+  }
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 1 < argc ? atoi(argv[1]) : 200;
+  uint32_t checksum = 0;
+  init_crc();
+  for (int i = 0; i < iterations; ++i) {
+    checksum += count_primes();
+    checksum ^= crc32(sieve, sizeof(sieve));
+    checksum += matrix_multiply((uint32_t) i);
+  }
+  printf("%08x\n", checksum);
+  return 0;
+}
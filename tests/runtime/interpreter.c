@@ -0,0 +1,68 @@
+/* A bytecode interpreter dispatched through a big switch, which is lifted
+ * through a jump table. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum Opcode {
+  kPush, kLoad, kStore, kAdd, kSub, kMul, kAnd, kXor, kShl, kShr, kDup,
+  kSwap, kDrop, kJumpIfNotZero, kDec, kHalt
+};
+
+static int32_t program[] = {
+  kPush, 0, kStore, 0,                  /* acc = 0 */
+  kPush, 100000, kStore, 1,             /* n = 100000 */
+  kLoad, 0, kLoad, 1, kAdd,             /* loop: acc += n */
+  kDup, kPush, 5, kShl, kXor,           /* acc ^= acc << 5 */
+  kDup, kPush, 3, kShr, kAdd,           /* acc += acc >> 3 */
+  kPush, 2654435761U, kMul,             /* acc *= golden */
+  kPush, 0x7FFFFFFF, kAnd, kStore, 0,
+  kLoad, 1, kDec, kDup, kStore, 1,      /* --n */
+  kJumpIfNotZero, 8,
+  kLoad, 0, kHalt
+};
+
+static int32_t run(int32_t seed) {
+  int32_t stack[64];
+  int32_t vars[4] = {0, 0, 0, 0};
+  int sp = 0;
+  int pc = 0;
+  for (;;) {
+    switch (program[pc++]) {
+      case kPush: stack[sp++] = program[pc++]; break;
+      case kLoad: stack[sp++] = vars[program[pc++]]; break;
+      case kStore: vars[program[pc++]] = stack[--sp]; break;
+      case kAdd: --sp; stack[sp - 1] += stack[sp]; break;
+      case kSub: --sp; stack[sp - 1] -= stack[sp]; break;
+      case kMul: --sp; stack[sp - 1] *= stack[sp]; break;
+      case kAnd: --sp; stack[sp - 1] &= stack[sp]; break;
+      case kXor: --sp; stack[sp - 1] ^= stack[sp]; break;
+      case kShl: --sp; stack[sp - 1] = (int32_t) ((uint32_t) stack[sp - 1] << stack[sp]); break;
+      case kShr: --sp; stack[sp - 1] = (int32_t) ((uint32_t) stack[sp - 1] >> stack[sp]); break;
+      case kDup: stack[sp] = stack[sp - 1]; ++sp; break;
+      case kSwap: { int32_t t = stack[sp - 1]; stack[sp - 1] = stack[sp - 2]; stack[sp - 2] = t; break; }
+      case kDrop: --sp; break;
+      case kJumpIfNotZero: {
+        int32_t target = program[pc++];
+        if (stack[--sp]) {
+          pc = target;
+        }
+        break;
+      }
+      case kDec: --stack[sp - 1]; break;
+      case kHalt: return stack[sp - 1] ^ seed;
+      default: return -1;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 1 < argc ? atoi(argv[1]) : 40;
+  uint32_t checksum = 0;
+  for (int i = 0; i < iterations; ++i) {
+    checksum = checksum * 31 + (uint32_t) run(i);
+  }
+  printf("%08x\n", checksum);
+  return 0;
+}
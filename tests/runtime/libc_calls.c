@@ -0,0 +1,44 @@
+/* Code that spends its time calling into libc, where every call leaves
+ * lifted code and comes back. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_ITEMS 2048
+
+static int32_t items[NUM_ITEMS];
+
+static int compare(const void *a, const void *b) {
+  int32_t x = *(const int32_t *) a;
+  int32_t y = *(const int32_t *) b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 1 < argc ? atoi(argv[1]) : 500;
+  uint32_t checksum = 0;
+  char buf[64];
+  char copy[64];
+  for (int i = 0; i < iterations; ++i) {
+    uint32_t seed = (uint32_t) i;
+    for (int j = 0; j < NUM_ITEMS; ++j) {
+      seed = seed * 1103515245U + 12345U;
+      items[j] = (int32_t) (seed >> 8);
+    }
+
+    /* `compare` is called back from native `qsort`. */
+    qsort(items, NUM_ITEMS, sizeof(items[0]), compare);
+    checksum += (uint32_t) items[NUM_ITEMS / 2];
+
+    for (int j = 0; j < NUM_ITEMS; j += 4) {
+      snprintf(buf, sizeof(buf), "%d:%x", items[j], j);
+      memcpy(copy, buf, strlen(buf) + 1);
+      checksum += (uint32_t) strtol(copy, NULL, 10);
+      checksum ^= (uint32_t) strlen(copy);
+    }
+  }
+  printf("%08x\n", checksum);
+  return 0;
+}
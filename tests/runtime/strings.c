@@ -0,0 +1,100 @@
+/* String processing: tokenizing, reversing, searching and hashing text that
+ * is built in memory. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEXT_SIZE 65536
+
+static char text[TEXT_SIZE + 1];
+static char scratch[TEXT_SIZE + 1];
+
+static const char *kWords[] = {
+  "lifted", "native", "binary", "mcsema", "bitcode", "register", "stack",
+  "memory", "branch", "switch", "return", "call"
+};
+
+static void build_text(uint32_t seed) {
+  size_t pos = 0;
+  while (pos < TEXT_SIZE - 16) {
+    seed = seed * 1103515245U + 12345U;
+    const char *word = kWords[(seed >> 16) % (sizeof(kWords) / sizeof(kWords[0]))];
+    while (*word) {
+      text[pos++] = *word++;
+    }
+    text[pos++] = (seed & 0x100) ? ' ' : ',';
+  }
+  text[pos] = '\0';
+}
+
+static size_t my_strlen(const char *s) {
+  const char *p = s;
+  while (*p) {
+    ++p;
+  }
+  return (size_t) (p - s);
+}
+
+static uint32_t count_tokens(const char *s) {
+  uint32_t count = 0;
+  int in_token = 0;
+  for (; *s; ++s) {
+    int is_sep = *s == ' ' || *s == ',';
+    if (!is_sep && !in_token) {
+      ++count;
+    }
+    in_token = !is_sep;
+  }
+  return count;
+}
+
+static void reverse_words(char *s) {
+  size_t len = my_strlen(s);
+  for (size_t i = 0, j = len - 1; i < j; ++i, --j) {
+    char t = s[i];
+    s[i] = s[j];
+    s[j] = t;
+  }
+}
+
+static uint32_t count_matches(const char *haystack, const char *needle) {
+  uint32_t count = 0;
+  for (const char *h = haystack; *h; ++h) {
+    const char *a = h;
+    const char *b = needle;
+    while (*a && *b && *a == *b) {
+      ++a;
+      ++b;
+    }
+    if (!*b) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+static uint32_t hash(const char *s) {
+  uint32_t h = 2166136261U;
+  for (; *s; ++s) {
+    h = (h ^ (unsigned char) *s) * 16777619U;
+  }
+  return h;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 1 < argc ? atoi(argv[1]) : 400;
+  uint32_t checksum = 0;
+  for (int i = 0; i < iterations; ++i) {
+    build_text((uint32_t) i);
+    checksum += count_tokens(text);
+    for (size_t j = 0; j <= TEXT_SIZE; ++j) {
+      scratch[j] = text[j];
+    }
+    reverse_words(scratch);
+    checksum += count_matches(scratch, "amesc");
+    checksum ^= hash(scratch);
+  }
+  printf("%08x\n", checksum);
+  return 0;
+}
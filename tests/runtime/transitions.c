@@ -0,0 +1,59 @@
+/* Counts the transitions between native and lifted code of a lifted
+ * program. Link this file into the lifted program along with the
+ * `--wrap` linker flags that `runtime_benchmark.py` passes, which send the
+ * calls of the lifted code into the attach and detach stubs through the
+ * counting wrappers below. The counts are written to the file named by
+ * `$MCSEMA_TRANSITIONS_FILE` when the program exits. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned long __mcsema_bench_attaches = 0;
+unsigned long __mcsema_bench_detaches = 0;
+
+/* The wrappers must not change any register or the stack, because the stubs
+ * use their own calling conventions. Only the flags are changed, and the
+ * stubs don't depend on them. */
+#ifdef __x86_64__
+# define COUNT(counter) "  lock inc QWORD PTR [rip + " #counter "]\n"
+#else
+# define COUNT(counter) "  lock inc DWORD PTR [" #counter "]\n"
+#endif
+
+#define WRAP(name, counter) \
+    __asm__( \
+        "  .intel_syntax noprefix\n" \
+        "  .text\n" \
+        "  .globl __wrap_" #name "\n" \
+        "  .type __wrap_" #name ",@function\n" \
+        "__wrap_" #name ":\n" \
+        COUNT(counter) \
+        "  jmp __real_" #name "\n" \
+        "  .att_syntax prefix\n")
+
+#ifdef __x86_64__
+WRAP(__mcsema_attach_call, __mcsema_bench_attaches);
+WRAP(__mcsema_detach_call, __mcsema_bench_detaches);
+WRAP(__mcsema_detach_call_value, __mcsema_bench_detaches);
+WRAP(__mcsema_detach_call_lean, __mcsema_bench_detaches);
+#else
+WRAP(__mcsema_attach_call_cdecl, __mcsema_bench_attaches);
+WRAP(__mcsema_detach_call_cdecl, __mcsema_bench_detaches);
+WRAP(__mcsema_detach_call_stdcall, __mcsema_bench_detaches);
+WRAP(__mcsema_detach_call_fastcall, __mcsema_bench_detaches);
+WRAP(__mcsema_detach_call_value, __mcsema_bench_detaches);
+#endif
+
+__attribute__((destructor))
+static void WriteTransitions(void) {
+  const char *path = getenv("MCSEMA_TRANSITIONS_FILE");
+  if (!path) {
+    return;
+  }
+  FILE *f = fopen(path, "w");
+  if (f) {
+    fprintf(f, "attaches %lu\ndetaches %lu\n", __mcsema_bench_attaches,
+            __mcsema_bench_detaches);
+    fclose(f);
+  }
+}
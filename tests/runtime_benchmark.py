@@ -0,0 +1,265 @@
+#!/usr/bin/env python
+"""Compare the run time of lifted programs against the native originals.
+
+Builds each CPU-bound program in `tests/runtime` natively, disassembles and
+lifts it for x86 and amd64, and rebuilds the lifted bitcode. Both versions
+are run with the same arguments, and their outputs must match. The report
+has the native and lifted run times, the slowdown of the lifted program, and
+how many times it crossed between lifted and native code. Results can be
+saved with `--output` and compared against a previous run with `--compare`,
+so that regressions in the quality of the lifted code show up between
+commits.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+MY_DIR = os.path.dirname(os.path.abspath(__file__))
+PROGRAMS_DIR = os.path.join(MY_DIR, "runtime")
+
+# Program name, arguments, and extra libraries.
+PROGRAMS = [
+    ("int_kernels", [], []),
+    ("strings", [], []),
+    ("interpreter", [], []),
+    ("fp_sse", [], ["-lm"]),
+    ("libc_calls", [], []),
+]
+
+ARCHS = {
+    "x86": {
+        "flag": "-m32",
+        "ida": "idal",
+        "stubs": "ELF_32_linux.S",
+        "wrap": ["__mcsema_attach_call_cdecl", "__mcsema_detach_call_cdecl",
+                 "__mcsema_detach_call_stdcall",
+                 "__mcsema_detach_call_fastcall",
+                 "__mcsema_detach_call_value"],
+    },
+    "amd64": {
+        "flag": "-m64",
+        "ida": "idal64",
+        "stubs": "ELF_64_linux.S",
+        "wrap": ["__mcsema_attach_call", "__mcsema_detach_call",
+                 "__mcsema_detach_call_value", "__mcsema_detach_call_lean"],
+    },
+}
+
+
+def run(cmd, **kwargs):
+    with open(os.devnull, "w") as devnull:
+        subprocess.check_call(cmd, stdout=devnull, stderr=devnull, **kwargs)
+
+
+def build(args, arch, name, libs, work_dir):
+    """Builds the native program, and lifts it. Returns the paths to both."""
+    config = ARCHS[arch]
+    src = os.path.join(PROGRAMS_DIR, name + ".c")
+    native = os.path.join(work_dir, "{}.{}.native".format(name, arch))
+    cfg = os.path.join(work_dir, "{}.{}.cfg".format(name, arch))
+    bitcode = os.path.join(work_dir, "{}.{}.bc".format(name, arch))
+    lifted = os.path.join(work_dir, "{}.{}.lifted".format(name, arch))
+
+    run([args.cc, config["flag"], "-O2", "-std=gnu99", "-o", native, src] +
+        libs)
+
+    run([args.disass,
+         "--disassembler", os.path.join(args.ida, config["ida"]),
+         "--arch", arch,
+         "--os", "linux",
+         "--entrypoint", "main",
+         "--binary", native,
+         "--output", cfg])
+
+    run([args.lift,
+         "-arch", arch,
+         "-os", "linux",
+         "-cfg", cfg,
+         "-entrypoint", "main",
+         "-output", bitcode] + args.lift_args)
+
+    wrap = ["-Wl,--wrap=" + sym for sym in config["wrap"]]
+    run([args.cc, config["flag"], "-O3", "-o", lifted,
+         os.path.join(args.generated, config["stubs"]), bitcode,
+         os.path.join(PROGRAMS_DIR, "transitions.c")] + wrap + libs)
+
+    return native, lifted
+
+
+def time_program(args, exe, progargs, work_dir):
+    """Runs `exe` `args.repeat` times. Returns the fastest run time, the
+    output, and the transition counts of the last run."""
+    counts_file = os.path.join(work_dir, "transitions.txt")
+    env = dict(os.environ)
+    env["MCSEMA_TRANSITIONS_FILE"] = counts_file
+    if os.path.exists(counts_file):
+        os.unlink(counts_file)
+
+    best = None
+    output = None
+    for _ in range(args.repeat):
+        start = time.time()
+        output = subprocess.check_output([exe] + progargs, env=env)
+        elapsed = time.time() - start
+        best = elapsed if best is None else min(best, elapsed)
+
+    counts = {}
+    if os.path.exists(counts_file):
+        with open(counts_file) as f:
+            for line in f:
+                key, val = line.split()
+                counts[key] = int(val)
+    return best, output, counts
+
+
+def benchmark(args, work_dir):
+    results = []
+    print("{:>12} {:>6} {:>10} {:>10} {:>9} {:>10} {:>10}".format(
+        "program", "arch", "native", "lifted", "slowdown", "attaches",
+        "detaches"))
+    for arch in args.arch:
+        for name, progargs, libs in PROGRAMS:
+            if args.programs and name not in args.programs:
+                continue
+            try:
+                native, lifted = build(args, arch, name, libs, work_dir)
+            except subprocess.CalledProcessError as e:
+                print("{:>12} {:>6}  could not build: {}".format(
+                    name, arch, " ".join(e.cmd)))
+                continue
+
+            native_time, native_output, _ = time_program(
+                args, native, progargs, work_dir)
+            try:
+                lifted_time, lifted_output, counts = time_program(
+                    args, lifted, progargs, work_dir)
+            except subprocess.CalledProcessError as e:
+                print("{:>12} {:>6}  lifted program failed with {}".format(
+                    name, arch, e.returncode))
+                continue
+
+            result = {
+                "program": name,
+                "arch": arch,
+                "native_seconds": native_time,
+                "lifted_seconds": lifted_time,
+                "slowdown": lifted_time / max(native_time, 1e-9),
+                "attaches": counts.get("attaches", 0),
+                "detaches": counts.get("detaches", 0),
+                "correct": native_output == lifted_output,
+            }
+            results.append(result)
+            print("{:>12} {:>6} {:9.3f}s {:9.3f}s {:8.2f}x {:>10} {:>10}{}".format(
+                name, arch, native_time, lifted_time, result["slowdown"],
+                result["attaches"], result["detaches"],
+                "" if result["correct"] else "  WRONG OUTPUT"))
+    return results
+
+
+def compare(args, results):
+    """Compare `results` against a previous run saved with `--output`."""
+    with open(args.compare) as f:
+        baseline = json.load(f)
+
+    old_results = dict(((r["program"], r["arch"]), r)
+                       for r in baseline["results"])
+    ok = True
+    for result in results:
+        old = old_results.get((result["program"], result["arch"]))
+        if not old:
+            continue
+        ratio = result["slowdown"] / max(old["slowdown"], 1e-9)
+        marker = ""
+        if ratio > 1.0 + args.regression_threshold:
+            marker = "  REGRESSION"
+            ok = False
+        print("{:>12} {:>6}: {:8.2f}x -> {:8.2f}x ({:+.1f}%), "
+              "{} -> {} transitions{}".format(
+                  result["program"], result["arch"], old["slowdown"],
+                  result["slowdown"], (ratio - 1.0) * 100.0,
+                  old["attaches"] + old["detaches"],
+                  result["attaches"] + result["detaches"], marker))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument(
+        "--lift", default=os.path.join(MY_DIR, "..", "build", "mcsema-lift"),
+        help="Path to mcsema-lift.")
+    parser.add_argument(
+        "--disass", default=os.path.join(MY_DIR, "..", "bin", "mcsema-disass"),
+        help="Path to mcsema-disass.")
+    parser.add_argument(
+        "--ida", default=os.path.expanduser(os.path.join("~", "ida-6.9")),
+        help="Directory that holds the IDA executables.")
+    parser.add_argument(
+        "--generated", default=os.path.join(MY_DIR, "..", "generated"),
+        help="Directory that holds the generated assembly stubs.")
+    parser.add_argument("--cc", default="clang-3.8")
+    parser.add_argument(
+        "--arch", default="x86,amd64",
+        type=lambda s: s.split(","),
+        help="Comma-separated architectures to lift for.")
+    parser.add_argument(
+        "--programs", default=None,
+        type=lambda s: s.split(","),
+        help="Comma-separated programs to run. Defaults to all of them.")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="Run each program this many times, and keep "
+                             "the fastest time.")
+    parser.add_argument("--lift-args", default=[], nargs=argparse.REMAINDER,
+                        help="Extra arguments passed to mcsema-lift.")
+    parser.add_argument("--output", help="Save the results to this file.")
+    parser.add_argument("--compare",
+                        help="Compare against results saved with --output.")
+    parser.add_argument("--regression-threshold", type=float, default=0.1,
+                        help="Fractional growth in slowdown reported as a "
+                             "regression.")
+    parser.add_argument("--keep", action="store_true",
+                        help="Keep the built programs and bitcode.")
+    args = parser.parse_args()
+
+    for arch in args.arch:
+        if arch not in ARCHS:
+            parser.error("Unknown architecture {}".format(arch))
+
+    for tool in (args.lift, args.disass):
+        if not os.path.exists(tool):
+            parser.error("Could not find {}".format(tool))
+
+    work_dir = tempfile.mkdtemp(prefix="mcsema-runtime-bench-")
+    try:
+        results = benchmark(args, work_dir)
+    finally:
+        if args.keep:
+            print("Kept built files in {}".format(work_dir))
+        else:
+            shutil.rmtree(work_dir)
+
+    ok = all(result["correct"] for result in results)
+
+    if args.output:
+        config = dict(vars(args))
+        config.pop("compare", None)
+        config.pop("output", None)
+        with open(args.output, "w") as f:
+            json.dump({"config": config, "results": results}, f, indent=2,
+                      sort_keys=True)
+
+    if args.compare:
+        ok = compare(args, results) and ok
+
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
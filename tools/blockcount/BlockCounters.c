@@ -0,0 +1,129 @@
+/* Copyright 2017 Trail of Bits, all rights reserved. */
+
+// Runtime for `mcsema-lift -add-block-counters`. Link this file into the
+// lifted program (Linux only).
+//
+// The lifted code counts how many times each block runs in the
+// `mcsema_block_counters` section. This file writes the non-zero counters out
+// when the program exits, when it is killed by `SIGINT`, `SIGTERM` or
+// `SIGHUP`, and whenever it receives `SIGUSR1`. The output file is
+// `$MCSEMA_BLOCK_COUNTS_FILE`, or `mcsema-block-counts.<pid>.txt` by default.
+// Every line is a hex native block address and a decimal count, which is
+// the format that `mcsema-lift -profile` reads.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../mcsema/Arch/X86/Runtime/BlockCounters.h"
+
+// Defined by the linker, if the lifted program has any counters.
+extern struct BlockCounter __start_mcsema_block_counters[]
+    __attribute__((weak));
+extern struct BlockCounter __stop_mcsema_block_counters[]
+    __attribute__((weak));
+
+static char gPath[4096];
+
+// Everything below may run in a signal handler, so it only uses
+// async-signal-safe functions.
+static void WriteAll(int fd, const char *data, size_t size) {
+  while (size) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return;
+    }
+    data += written;
+    size -= (size_t) written;
+  }
+}
+
+// Formats `val` in base `base` into the end of `buf`, and returns a pointer
+// to the first digit.
+static char *FormatNumber(char *buf_end, uint64_t val, unsigned base) {
+  static const char kDigits[] = "0123456789abcdef";
+  char *p = buf_end;
+  do {
+    *--p = kDigits[val % base];
+    val /= base;
+  } while (val);
+  return p;
+}
+
+static void DumpBlockCounts(void) {
+  if (!__start_mcsema_block_counters) {
+    return;
+  }
+
+  int fd = open(gPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (0 > fd) {
+    return;
+  }
+
+  char buf[1 << 16];
+  size_t used = 0;
+  struct BlockCounter *counter;
+  for (counter = __start_mcsema_block_counters;
+       counter < __stop_mcsema_block_counters; ++counter) {
+    uint64_t count = __atomic_load_n(&(counter->count), __ATOMIC_RELAXED);
+    if (!count) {
+      continue;
+    }
+
+    // A line is at most 16 hex digits, a space, 20 decimal digits and a
+    // newline.
+    if (sizeof(buf) - used < 64) {
+      WriteAll(fd, buf, used);
+      used = 0;
+    }
+
+    char num[32];
+    char *end = &(num[sizeof(num)]);
+    char *digits = FormatNumber(end, counter->va, 16);
+    memcpy(&(buf[used]), digits, (size_t) (end - digits));
+    used += (size_t) (end - digits);
+    buf[used++] = ' ';
+
+    digits = FormatNumber(end, count, 10);
+    memcpy(&(buf[used]), digits, (size_t) (end - digits));
+    used += (size_t) (end - digits);
+    buf[used++] = '\n';
+  }
+  WriteAll(fd, buf, used);
+  close(fd);
+}
+
+static void DumpOnSignal(int sig) {
+  DumpBlockCounts();
+  if (SIGUSR1 != sig) {
+    signal(sig, SIG_DFL);
+    raise(sig);
+  }
+}
+
+__attribute__((constructor))
+static void InitBlockCounters(void) {
+  const char *path = getenv("MCSEMA_BLOCK_COUNTS_FILE");
+  if (path) {
+    snprintf(gPath, sizeof(gPath), "%s", path);
+  } else {
+    snprintf(gPath, sizeof(gPath), "mcsema-block-counts.%d.txt",
+             (int) getpid());
+  }
+
+  atexit(DumpBlockCounts);
+  signal(SIGINT, DumpOnSignal);
+  signal(SIGTERM, DumpOnSignal);
+  signal(SIGHUP, DumpOnSignal);
+  signal(SIGUSR1, DumpOnSignal);
+}
@@ -2,6 +2,8 @@
 # Copyright 2017 Peter Goodman (peter@trailofbits.com), all rights reserved.
 
 import argparse
+import copy
+import multiprocessing
 import os
 import shutil
 import sys
@@ -13,6 +15,57 @@ import textwrap
 SUPPORTED_OS = ('linux', 'windows',)
 SUPPORTED_ARCH = ('x86', 'amd64',)
 
+def check_output(output):
+  """Returns 0 if the disassembler wrote a CFG to `output`."""
+  # in case IDA somehow says success, but no output was generated
+  if not os.path.isfile(output):
+    sys.stderr.write("Could not generate a CFG. Try using the --log_file option to see an error log.\n")
+    return 1
+
+  # The disassembler script probably threw an exception
+  if 0 == os.path.getsize(output):
+    sys.stderr.write("Generated an invalid (zero-sized) CFG. Please use the --log_file option to see an error log.\n")
+    # remove the zero-sized file
+    os.unlink(output)
+    return 1
+
+  return 0
+
+
+def disassemble(args, command_args, idb=None):
+  """Disassemble `args.binary` into `args.output`. If `idb` is the path to
+  an existing database of the binary, then it is opened instead of the
+  binary. With `args.idb_dir`, the database is kept there for next time."""
+  import ida.disass
+
+  workspace_dir = tempfile.mkdtemp()
+  temp_bin_path = os.path.join(workspace_dir, os.path.basename(args.binary))
+  shutil.copyfile(args.binary, temp_bin_path)
+
+  run_args = copy.copy(args)
+  run_args.binary = temp_bin_path
+  if idb:
+    run_args.binary = os.path.join(workspace_dir, os.path.basename(idb))
+    shutil.copyfile(idb, run_args.binary)
+
+  ret = 1
+  try:
+    ret = ida.disass.execute(run_args, command_args) or check_output(args.output)
+
+    # Keep the database that IDA saved next to the binary.
+    if not ret and not idb and getattr(args, "idb_dir", None):
+      import batch
+      name = batch.idb_name(args, args.binary)
+      saved = os.path.join(workspace_dir, name)
+      if os.path.isfile(saved):
+        shutil.copyfile(saved, os.path.join(args.idb_dir, name))
+
+  finally:
+    shutil.rmtree(workspace_dir)
+
+  return ret
+
+
 def main(args=None):
   arg_parser = argparse.ArgumentParser(
     formatter_class=argparse.RawDescriptionHelpFormatter,
@@ -20,7 +73,14 @@ def main(args=None):
     Additional arguments are passed to the disassembler script directly. These include:
     
       --std-defs <file>       Load additional external function definitions from <file>
-      --pie-mode              Change disassembler heuristics to work on position independent code"""))
+      --pie-mode              Change disassembler heuristics to work on position independent code
+      --incremental           Reuse the functions of the previous CFG written to --output that are unchanged
+      --shards <N>            Write the functions into <N> shard files next to --output
+      --cfg-map               Write a memory-mapped CFG container instead of a protobuf
+
+    With --batch, every binary in a manifest is disassembled, --jobs at a time. Each
+    line of the manifest is '<binary> [<output> [<entrypoint>]]'. --output is then the
+    default directory for the CFGs, and --log_file a directory for one log per binary."""))
 
   arg_parser.add_argument(
       '--disassembler',
@@ -44,25 +104,55 @@ def main(args=None):
 
   arg_parser.add_argument(
       '--output',
-      help='The output control flow graph recovered from this file',
-      required=True)
+      help='The output control flow graph recovered from this file')
 
   arg_parser.add_argument(
       '--binary',
-      help='Binary to recover control flow graph from',
-      required=True)
+      help='Binary to recover control flow graph from')
 
   arg_parser.add_argument(
       '--entrypoint',
-      help="The entrypoint where disassembly should begin",
-      required=True)
+      help="The entrypoint where disassembly should begin")
+
+  arg_parser.add_argument(
+      '--batch',
+      help='Manifest of binaries to disassemble, instead of --binary')
+
+  arg_parser.add_argument(
+      '--jobs',
+      type=int,
+      default=multiprocessing.cpu_count(),
+      help='How many binaries to disassemble at once with --batch')
+
+  arg_parser.add_argument(
+      '--idb-dir',
+      help='With --batch, reuse the IDA databases in this directory, and '
+           'keep new ones there. Databases next to the binaries are reused too.')
+
+  arg_parser.add_argument(
+      '--force',
+      action='store_true',
+      help='With --batch, also disassemble binaries whose CFG is up to date')
 
   args, command_args = arg_parser.parse_known_args()
 
-  if not os.path.isfile(args.binary):
-    arg_parser.error("{} passed to --binary is not a valid file.".format(
-        args.binary))
-    return 1
+  if args.batch:
+    if args.binary:
+      arg_parser.error("--binary can't be used with --batch.")
+    if not os.path.isfile(args.batch):
+      arg_parser.error("{} passed to --batch is not a valid file.".format(
+          args.batch))
+    if 1 > args.jobs:
+      arg_parser.error("--jobs must be at least 1.")
+  else:
+    for name in ('output', 'binary', 'entrypoint'):
+      if not getattr(args, name):
+        arg_parser.error("--{} is required.".format(name))
+
+    if not os.path.isfile(args.binary):
+      arg_parser.error("{} passed to --binary is not a valid file.".format(
+          args.binary))
+      return 1
 
   if args.arch not in SUPPORTED_ARCH:
     arg_parser.error("{} passed to --arch is not supported. Valid options are: {}".format(
@@ -73,9 +163,13 @@ def main(args=None):
     arg_parser.error("{} passed to --os is not supported. Valid options are: {}".format(
       args.os, SUPPORTED_OS))
 
-  args.binary = os.path.abspath(args.binary)
-  args.output = os.path.abspath(args.output)
-  args.log_file = os.path.abspath(args.log_file)
+  if 'ida' not in args.disassembler:
+    arg_parser.error("{} passed to --disassembler is not known.".format(
+        args.disassembler))
+
+  for name in ('binary', 'output', 'log_file', 'batch', 'idb_dir'):
+    if getattr(args, name):
+      setattr(args, name, os.path.abspath(getattr(args, name)))
 
   fixed_command_args = []
   # ensure that any paths in arguments to the disassembler
@@ -90,49 +184,11 @@ def main(args=None):
   os.chdir(disass_dir)
   sys.path.append(disass_dir)
 
-  workspace_dir = tempfile.mkdtemp()
-  temp_bin_path = os.path.join(workspace_dir, os.path.basename(args.binary))
-  shutil.copyfile(args.binary, temp_bin_path)
-  args.binary = temp_bin_path
-
-  ret = 1
-  try:
-    if 'ida' in args.disassembler:
-      import ida.disass
-      ret = ida.disass.execute(args, fixed_command_args)
-
-      # in case IDA somehow says success, but no output was generated
-      if not os.path.isfile(args.output):
-          sys.stderr.write("Could not generate a CFG. Try using the --log_file option to see an error log.\n")
-          ret = 1
-
-      # The disassembler script probably threw an exception
-      if 0 == os.path.getsize(args.output):
-          sys.stderr.write("Generated an invalid (zero-sized) CFG. Please use the --log_file option to see an error log.\n")
-          # remove the zero-sized file
-          os.unlink(args.output)
-          ret = 1
-
-      # in case IDA somehow says success, but no output was generated
-      if not os.path.isfile(args.output):
-          sys.stderr.write("Could not generate a CFG. Try using the --log_file option to see an error log.\n")
-          ret = 1
-
-      # The disassembler script probably threw an exception
-      if 0 == os.path.getsize(args.output):
-          sys.stderr.write("Generated an invalid (zero-sized) CFG. Please use the --log_file option to see an error log.\n")
-          # remove the zero-sized file
-          os.unlink(args.output)
-          ret = 1
+  if args.batch:
+    import batch
+    return batch.execute(args, fixed_command_args, disassemble)
 
-    else:
-      arg_parser.error("{} passed to --disassembler is not known.".format(
-          args.disassembler))
-
-  finally:
-    shutil.rmtree(workspace_dir)
-
-  return ret
+  return disassemble(args, fixed_command_args)
 
 
 if "__main__" == __name__:
@@ -0,0 +1,198 @@
+#!/usr/bin/env python
+# Copyright 2017 Trail of Bits, all rights reserved.
+
+"""Disassemble many binaries with a bounded pool of disassembler processes.
+
+The manifest lists one binary per line, optionally followed by the path of
+its CFG and by its entrypoint:
+
+    <binary> [<output> [<entrypoint>]]
+
+Blank lines and `#` comments are ignored, and relative paths are relative
+to the manifest. Without an output, the CFG is written into the `--output`
+directory as `<binary name>.cfg`. Without an entrypoint, `--entrypoint` is
+used. Binaries whose CFG is newer than the binary are skipped."""
+
+import argparse
+import copy
+import os
+import shutil
+import sys
+import tempfile
+import threading
+import time
+import traceback
+
+from multiprocessing.pool import ThreadPool
+
+
+class ManifestError(Exception):
+  pass
+
+
+class Job(object):
+  def __init__(self, binary, output, entrypoint):
+    self.binary = binary
+    self.output = output
+    self.entrypoint = entrypoint
+
+
+def read_manifest(args):
+  """Returns the jobs listed in the manifest `args.batch`."""
+  manifest_dir = os.path.dirname(args.batch)
+  jobs = []
+  outputs = {}
+  with open(args.batch) as f:
+    for line_num, line in enumerate(f, 1):
+      parts = line.split("#", 1)[0].split()
+      if not parts:
+        continue
+      if 3 < len(parts):
+        raise ManifestError("{}:{}: expected '<binary> [<output> "
+                            "[<entrypoint>]]'".format(args.batch, line_num))
+
+      binary = os.path.join(manifest_dir, parts[0])
+      if 1 < len(parts):
+        output = os.path.join(manifest_dir, parts[1])
+      elif args.output:
+        output = os.path.join(args.output,
+                              os.path.basename(binary) + ".cfg")
+      else:
+        raise ManifestError("{}:{}: no output for {}, and no --output "
+                            "directory".format(args.batch, line_num, binary))
+
+      entrypoint = parts[2] if 2 < len(parts) else args.entrypoint
+      if not entrypoint:
+        raise ManifestError("{}:{}: no entrypoint for {}, and no "
+                            "--entrypoint".format(args.batch, line_num,
+                                                  binary))
+
+      output = os.path.abspath(output)
+      if output in outputs:
+        raise ManifestError("{}:{}: {} is also written by line {}".format(
+            args.batch, line_num, output, outputs[output]))
+      outputs[output] = line_num
+
+      jobs.append(Job(os.path.abspath(binary), output, entrypoint))
+  return jobs
+
+
+def is_up_to_date(job):
+  return os.path.isfile(job.output) and \
+      os.path.getmtime(job.output) >= os.path.getmtime(job.binary)
+
+
+def idb_name(args, binary):
+  """IDA names the database after the binary, without its extension."""
+  ext = ".i64" if "amd64" == args.arch else ".idb"
+  return os.path.splitext(os.path.basename(binary))[0] + ext
+
+
+def find_idb(args, binary):
+  """Returns the path to an existing database of `binary`, or `None`."""
+  name = idb_name(args, binary)
+  dirs = [os.path.dirname(binary)]
+  if args.idb_dir:
+    dirs.insert(0, args.idb_dir)
+  for idb_dir in dirs:
+    path = os.path.join(idb_dir, name)
+    if os.path.isfile(path) and \
+        os.path.getmtime(path) >= os.path.getmtime(binary):
+      return path
+  return None
+
+
+class Batch(object):
+  def __init__(self, args, command_args, disassemble):
+    self.args = args
+    self.command_args = command_args
+    self.disassemble = disassemble
+    self.lock = threading.Lock()
+    self.num_done = 0
+    self.num_skipped = 0
+    self.num_failed = 0
+
+  def log(self, status, elapsed, job, extra=""):
+    with self.lock:
+      sys.stdout.write("{:<7} {:8.1f}s  {} -> {}{}\n".format(
+          status, elapsed, job.binary, job.output, extra))
+      sys.stdout.flush()
+
+  def run_job(self, job):
+    if not os.path.isfile(job.binary):
+      with self.lock:
+        self.num_failed += 1
+      self.log("MISSING", 0, job)
+      return
+
+    if not self.args.force and is_up_to_date(job):
+      with self.lock:
+        self.num_skipped += 1
+      self.log("SKIP", 0, job)
+      return
+
+    job_args = copy.copy(self.args)
+    job_args.binary = job.binary
+    job_args.output = job.output
+    job_args.entrypoint = job.entrypoint
+    if self.args.log_file != os.devnull:
+      job_args.log_file = os.path.join(
+          self.args.log_file, os.path.basename(job.output) + ".log")
+
+    out_dir = os.path.dirname(job.output)
+    if not os.path.isdir(out_dir):
+      try:
+        os.makedirs(out_dir)
+      except OSError:
+        pass  # Made by another worker.
+
+    idb = find_idb(self.args, job.binary)
+    start = time.time()
+    try:
+      ret = self.disassemble(job_args, self.command_args, idb=idb)
+    except Exception:
+      sys.stderr.write(traceback.format_exc())
+      ret = 1
+    elapsed = time.time() - start
+
+    with self.lock:
+      if ret:
+        self.num_failed += 1
+      else:
+        self.num_done += 1
+    self.log("FAILED" if ret else "OK", elapsed, job,
+             " (reused {})".format(idb) if idb else "")
+
+  def run(self, jobs):
+    start = time.time()
+    pool = ThreadPool(self.args.jobs)
+    try:
+      # `map_async` with a timeout keeps the pool interruptible.
+      pool.map_async(self.run_job, jobs, chunksize=1).get(1 << 30)
+    finally:
+      pool.terminate()
+      pool.join()
+
+    sys.stdout.write(
+        "Exported {} CFGs, skipped {}, failed {}, in {:.1f}s with {} "
+        "jobs\n".format(self.num_done, self.num_skipped, self.num_failed,
+                        time.time() - start, self.args.jobs))
+    return 1 if self.num_failed else 0
+
+
+def execute(args, command_args, disassemble):
+  """Disassemble every binary in the manifest `args.batch` with
+  `disassemble(args, command_args, idb=...)`, running `args.jobs` of them at
+  a time."""
+  try:
+    jobs = read_manifest(args)
+  except (IOError, ManifestError) as e:
+    sys.stderr.write("{}\n".format(e))
+    return 1
+
+  if args.log_file != os.devnull and not os.path.isdir(args.log_file):
+    os.makedirs(args.log_file)
+  if args.idb_dir and not os.path.isdir(args.idb_dir):
+    os.makedirs(args.idb_dir)
+
+  return Batch(args, command_args, disassemble).run(jobs)
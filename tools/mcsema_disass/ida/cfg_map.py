@@ -0,0 +1,315 @@
+#!/usr/bin/env python
+# Copyright 2017 Trail of Bits, all rights reserved.
+
+"""Write a CFG as a memory-mapped container instead of a protobuf.
+
+The layout of the container is described in `mcsema/CFG/CFGMap.h`. The
+lifter maps the file and uses it in place, so instruction and data bytes
+are never copied while the CFG is read. Run this file directly to convert
+an existing `.cfg` file (and the shards that it lists) into a container."""
+
+import os
+import struct
+import sys
+
+MAGIC = b"MCSCFGM1"
+VERSION = 1
+
+HEADER = struct.Struct("<8sII" + "QQ" * 16)
+FUNCTION = struct.Struct("<QQQII")
+BLOCK = struct.Struct("<QIIII")
+INST = struct.Struct("<8QQQQQQQIIIiBB6x")
+JUMP_TABLE = struct.Struct("<QQqiI")
+JUMP_INDEX_TABLE = struct.Struct("<QQiI")
+DATA = struct.Struct("<QQQIIII")
+DATA_SYMBOL = struct.Struct("<QQQQ")
+EXTERNAL_FUNCTION = struct.Struct("<QQIiII")
+EXTERNAL_DATA = struct.Struct("<QQQII")
+ENTRY_SYMBOL = struct.Struct("<QQQIiII")
+OFFSET_TABLE = struct.Struct("<QQQ")
+OFFSET_TABLE_ENTRY = struct.Struct("<QQ")
+U64 = struct.Struct("<Q")
+
+# Which of the optional instruction fields are present.
+HAS_TRUE_TARGET = 1 << 0
+HAS_FALSE_TARGET = 1 << 1
+HAS_IMM_REFERENCE = 1 << 2
+HAS_IMM_RELOC_OFFSET = 1 << 3
+HAS_IMM_REF_TYPE = 1 << 4
+HAS_MEM_REFERENCE = 1 << 5
+HAS_MEM_RELOC_OFFSET = 1 << 6
+HAS_MEM_REF_TYPE = 1 << 7
+HAS_SYSTEM_CALL_NUMBER = 1 << 8
+LOCAL_NORETURN = 1 << 9
+HAS_OFFSET_TABLE = 1 << 10
+HAS_JUMP_TABLE = 1 << 11
+HAS_JUMP_INDEX_TABLE = 1 << 12
+
+# External function flags.
+HAS_RETURN = 1 << 0
+NO_RETURN = 1 << 1
+IS_WEAK = 1 << 2
+IS_DIRECT = 1 << 3
+
+_MASK = (1 << 64) - 1
+
+
+def _u64(val):
+    return val & _MASK
+
+
+class _BytePool(object):
+    """Collects the variable-sized bytes that records refer to. Names are
+    stored once."""
+
+    def __init__(self):
+        self.chunks = []
+        self.size = 0
+        self.names = {}
+
+    def add(self, data):
+        if not data:
+            return (0, 0)
+        if not isinstance(data, bytes):
+            data = data.encode("utf-8")
+        offset = self.size
+        self.chunks.append(data)
+        self.size += len(data)
+        return (offset, len(data))
+
+    def add_name(self, name):
+        if name not in self.names:
+            self.names[name] = self.add(name)
+        return self.names[name]
+
+
+class _Table(object):
+    def __init__(self, record):
+        self.record = record
+        self.rows = []
+
+    def add(self, *vals):
+        self.rows.append(self.record.pack(*vals))
+        return len(self.rows) - 1
+
+    def __len__(self):
+        return len(self.rows)
+
+
+def _write_inst(I, tables, pool):
+    flags = 0
+    if I.HasField("true_target"):
+        flags |= HAS_TRUE_TARGET
+    if I.HasField("false_target"):
+        flags |= HAS_FALSE_TARGET
+    if I.HasField("imm_reference"):
+        flags |= HAS_IMM_REFERENCE
+    if I.HasField("imm_reloc_offset"):
+        flags |= HAS_IMM_RELOC_OFFSET
+    if I.HasField("imm_ref_type"):
+        flags |= HAS_IMM_REF_TYPE
+    if I.HasField("mem_reference"):
+        flags |= HAS_MEM_REFERENCE
+    if I.HasField("mem_reloc_offset"):
+        flags |= HAS_MEM_RELOC_OFFSET
+    if I.HasField("mem_ref_type"):
+        flags |= HAS_MEM_REF_TYPE
+    if I.HasField("system_call_number"):
+        flags |= HAS_SYSTEM_CALL_NUMBER
+    if I.HasField("local_noreturn") and I.local_noreturn:
+        flags |= LOCAL_NORETURN
+    if I.HasField("offset_table_addr"):
+        flags |= HAS_OFFSET_TABLE
+
+    jump_table = 0
+    if I.HasField("jump_table"):
+        flags |= HAS_JUMP_TABLE
+        J = I.jump_table
+        first_entry = len(tables["jump_table_entries"])
+        for entry in J.table_entries:
+            tables["jump_table_entries"].add(_u64(entry))
+        offset_from_data = -1
+        if J.HasField("offset_from_data"):
+            offset_from_data = J.offset_from_data
+        jump_table = tables["jump_tables"].add(
+            first_entry, len(J.table_entries), offset_from_data,
+            J.zero_offset, 0)
+
+    jump_index_table = 0
+    if I.HasField("jump_index_table"):
+        flags |= HAS_JUMP_INDEX_TABLE
+        T = I.jump_index_table
+        jump_index_table = tables["jump_index_tables"].add(
+            *(pool.add(T.table_entries) + (T.zero_offset, 0)))
+
+    ext_call = pool.add_name(I.ext_call_name) if I.HasField("ext_call_name") \
+        else (0, 0)
+    ext_data = pool.add_name(I.ext_data_name) if I.HasField("ext_data_name") \
+        else (0, 0)
+
+    tables["insts"].add(
+        _u64(I.inst_addr), _u64(I.true_target), _u64(I.false_target),
+        _u64(I.imm_reference), _u64(I.imm_reloc_offset),
+        _u64(I.mem_reference), _u64(I.mem_reloc_offset),
+        _u64(I.offset_table_addr),
+        *(pool.add(I.inst_bytes) + ext_call + ext_data +
+          (flags, jump_table, jump_index_table, I.system_call_number,
+           I.imm_ref_type, I.mem_ref_type)))
+
+
+def _write_function(F, tables, pool):
+    first_block = len(tables["blocks"])
+    for B in F.blocks:
+        first_inst = len(tables["insts"])
+        for I in B.insts:
+            _write_inst(I, tables, pool)
+        first_follow = len(tables["follows"])
+        for follow in B.block_follows:
+            tables["follows"].add(_u64(follow))
+        tables["blocks"].add(_u64(B.base_address), first_inst, len(B.insts),
+                             first_follow, len(B.block_follows))
+
+    name = pool.add_name(F.symbol_name) if F.HasField("symbol_name") \
+        else (0, 0)
+    tables["funcs"].add(_u64(F.entry_address), name[0], name[1], first_block,
+                        len(F.blocks))
+
+
+def write_cfg_map(M, outf):
+    """Write the `CFG_pb2.Module` `M` to the file `outf` as a memory-mapped
+    container."""
+    pool = _BytePool()
+    tables = {
+        "funcs": _Table(FUNCTION),
+        "blocks": _Table(BLOCK),
+        "insts": _Table(INST),
+        "follows": _Table(U64),
+        "jump_tables": _Table(JUMP_TABLE),
+        "jump_table_entries": _Table(U64),
+        "jump_index_tables": _Table(JUMP_INDEX_TABLE),
+        "data": _Table(DATA),
+        "data_symbols": _Table(DATA_SYMBOL),
+        "external_funcs": _Table(EXTERNAL_FUNCTION),
+        "external_data": _Table(EXTERNAL_DATA),
+        "entries": _Table(ENTRY_SYMBOL),
+        "offset_tables": _Table(OFFSET_TABLE),
+        "offset_table_entries": _Table(OFFSET_TABLE_ENTRY),
+    }
+
+    for F in M.internal_funcs:
+        _write_function(F, tables, pool)
+
+    for D in M.internal_data:
+        first_symbol = len(tables["data_symbols"])
+        for S in D.symbols:
+            tables["data_symbols"].add(
+                *((_u64(S.base_address),) + pool.add_name(S.symbol_name) +
+                  (S.symbol_size,)))
+        tables["data"].add(
+            *((_u64(D.base_address),) + pool.add(D.data) +
+              (first_symbol, len(D.symbols), int(D.read_only), 0)))
+
+    for E in M.external_funcs:
+        flags = 0
+        if E.has_return:
+            flags |= HAS_RETURN
+        if E.no_return:
+            flags |= NO_RETURN
+        if E.is_weak:
+            flags |= IS_WEAK
+        if E.is_direct:
+            flags |= IS_DIRECT
+        tables["external_funcs"].add(
+            *(pool.add_name(E.symbol_name) +
+              (E.calling_convention, E.argument_count, flags, 0)))
+
+    for E in M.external_data:
+        tables["external_data"].add(
+            *(pool.add_name(E.symbol_name) +
+              (E.data_size, int(E.is_weak), 0)))
+
+    for E in M.entries:
+        has_extra = E.HasField("entry_extra")
+        X = E.entry_extra
+        tables["entries"].add(
+            *(pool.add_name(E.entry_name) +
+              (_u64(E.entry_address), int(has_extra), X.entry_argc,
+               X.entry_cconv, int(X.does_return))))
+
+    for T in M.offset_tables:
+        first_entry = len(tables["offset_table_entries"])
+        for table_offset, dest in zip(T.table_offsets, T.destinations):
+            tables["offset_table_entries"].add(_u64(table_offset), _u64(dest))
+        tables["offset_tables"].add(_u64(T.start_addr), first_entry,
+                                    len(T.table_offsets))
+
+    module_name = pool.add(M.module_name)
+
+    # Lay out the tables after the header, then the byte pool.
+    order = ["funcs", "blocks", "insts", "follows", "jump_tables",
+             "jump_table_entries", "jump_index_tables", "data",
+             "data_symbols", "external_funcs", "external_data", "entries",
+             "offset_tables", "offset_table_entries"]
+    offset = HEADER.size
+    extents = {}
+    for name in order:
+        extents[name] = (offset, len(tables[name]))
+        offset += len(tables[name]) * tables[name].record.size
+        offset = (offset + 7) & ~7
+    bytes_offset = offset
+
+    header = [MAGIC, VERSION, 0, module_name[0], module_name[1],
+              bytes_offset, pool.size]
+    for name in order:
+        header.extend(extents[name])
+    outf.write(HEADER.pack(*header))
+
+    pos = HEADER.size
+    for name in order:
+        start = extents[name][0]
+        outf.write(b"\0" * (start - pos))
+        for row in tables[name].rows:
+            outf.write(row)
+        pos = start + len(tables[name]) * tables[name].record.size
+    outf.write(b"\0" * (bytes_offset - pos))
+    for chunk in pool.chunks:
+        outf.write(chunk)
+
+
+def read_module(CFG_pb2, cfg_path):
+    """Read the `.cfg` file at `cfg_path`, and the shards it lists, into one
+    module."""
+    M = CFG_pb2.Module()
+    with open(cfg_path, "rb") as f:
+        M.ParseFromString(f.read())
+
+    shard_files = list(M.shard_files)
+    del M.shard_files[:]
+    for shard_name in shard_files:
+        S = CFG_pb2.Module()
+        with open(os.path.join(os.path.dirname(cfg_path), shard_name),
+                  "rb") as f:
+            S.ParseFromString(f.read())
+        M.internal_funcs.extend(S.internal_funcs)
+    return M
+
+
+def main(args=None):
+    import argparse
+    arg_parser = argparse.ArgumentParser(description=__doc__)
+    arg_parser.add_argument("cfg", help="The .cfg file to convert.")
+    arg_parser.add_argument("output", help="Where to write the container.")
+    args = arg_parser.parse_args(args)
+
+    # `CFG_pb2.py` is copied next to this file when McSema is installed.
+    sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+    import CFG_pb2
+
+    M = read_module(CFG_pb2, args.cfg)
+    with open(args.output, "wb") as f:
+        write_cfg_map(M, f)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
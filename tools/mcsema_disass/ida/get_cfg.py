@@ -16,11 +16,14 @@ import sys
 from os import path
 import os
 import argparse
+import bisect
 import struct
 #import syslog
 import traceback
 
+import hashlib
 import itertools
+import json
 
 
 #hack for IDAPython to see google protobuf lib
@@ -35,6 +38,7 @@ tools_disass_dir = os.path.dirname(tools_disass_ida_dir)
 
 # Note: The bootstrap file will copy CFG_pb2.py into this dir!!
 import CFG_pb2
+import cfg_map
 
 _DEBUG = False
 _DEBUG_FILE = sys.stderr
@@ -151,17 +155,17 @@ def ReftypeString(rt):
         return "UNKNOWN!"
 
 def readByte(ea):
-    byte = readBytesSlowly(ea, ea+1)
+    byte = readBytes(ea, ea+1)
     byte = ord(byte) 
     return byte
 
 def readDword(ea):
-    bytestr = readBytesSlowly(ea, ea+4)
+    bytestr = readBytes(ea, ea+4)
     dword = struct.unpack("<L", bytestr)[0]
     return dword
 
 def readQword(ea):
-    bytestr = readBytesSlowly(ea, ea+8)
+    bytestr = readBytes(ea, ea+8)
     qword = struct.unpack("<Q", bytestr)[0]
     return qword
 
@@ -295,7 +299,25 @@ def readInstructionBytes(inst):
     insn_t = idautils.DecodeInstruction(inst)
     return [idc.Byte(b) for b in xrange(inst, inst+insn_t.size)]
         
+# Per-EA results of `isInternalCode`, `isExternalReference` and
+# `getFunctionName`. These are asked about the same addresses over and over
+# during one export, so they are memoized until the database changes (see
+# `clearCaches`).
+_INTERNAL_CODE_CACHE = {}
+_EXTERNAL_REF_CACHE = {}
+_FUNCTION_NAME_CACHE = {}
+
+def clearCaches():
+    _INTERNAL_CODE_CACHE.clear()
+    _EXTERNAL_REF_CACHE.clear()
+    _FUNCTION_NAME_CACHE.clear()
+
 def isInternalCode(ea):
+    if ea not in _INTERNAL_CODE_CACHE:
+        _INTERNAL_CODE_CACHE[ea] = _isInternalCode(ea)
+    return _INTERNAL_CODE_CACHE[ea]
+
+def _isInternalCode(ea):
 
     pf = idc.GetFlags(ea)
     if idc.isCode(pf) and not idc.isData(pf):
@@ -318,6 +340,11 @@ def isNotCode(ea):
     return not idc.isCode(pf)
 
 def isExternalReference(ea):
+    if ea not in _EXTERNAL_REF_CACHE:
+        _EXTERNAL_REF_CACHE[ea] = _isExternalReference(ea)
+    return _EXTERNAL_REF_CACHE[ea]
+
+def _isExternalReference(ea):
     # see if this is in an internal or external code ref
     DEBUG("Testing {0:x} for externality".format(ea))
     ext_types = [idc.SEG_XTRN]
@@ -346,7 +373,9 @@ def isExternalReference(ea):
     return False
 
 def getFunctionName(ea):
-    return idc.GetTrueNameEx(ea,ea)
+    if ea not in _FUNCTION_NAME_CACHE:
+        _FUNCTION_NAME_CACHE[ea] = idc.GetTrueNameEx(ea,ea)
+    return _FUNCTION_NAME_CACHE[ea]
     
 def addInst(block, addr, inst_bytes, true_target=None, false_target=None):
     # check if there is a lock prefix:
@@ -405,6 +434,54 @@ def isTrap(ea):
     insn_t = idautils.DecodeInstruction(ea)
     return insn_t.itype in TRAPS
 
+def isSystemCall(insn_t):
+    if insn_t.itype == idaapi.NN_syscall:
+        return True
+    op = insn_t.Operands[0]
+    return insn_t.itype == idaapi.NN_int and op.type == idc.o_imm and \
+           op.value == 0x80
+
+# IDA's x86 register numbers of AX (i.e. EAX and RAX), AL, and AH.
+EAX_REGS = (0, 16, 20)
+
+# Instructions that only write their first operand. System call numbers are
+# looked for through these.
+SYSCALL_SETUP_ITYPES = set([
+    idaapi.NN_mov, idaapi.NN_movzx, idaapi.NN_movsx, idaapi.NN_movsxd,
+    idaapi.NN_lea, idaapi.NN_xor, idaapi.NN_add, idaapi.NN_sub,
+    idaapi.NN_and, idaapi.NN_or, idaapi.NN_push, idaapi.NN_pop])
+
+MAX_SYSCALL_SETUP_INSTS = 8
+
+def getSystemCallNumber(ea):
+    """Returns the number of the system call made by the instruction at `ea`,
+    if one of the instructions just before it, in the same block, loads a
+    constant into EAX/RAX. Returns `None` otherwise."""
+    head = ea
+    for _ in xrange(MAX_SYSCALL_SETUP_INSTS):
+        # Don't look past the start of the block.
+        if len(list(idautils.CodeRefsTo(head, 0))):
+            return None
+        prev = idc.PrevHead(head)
+        if prev == idc.BADADDR or not idc.isCode(idc.GetFlags(prev)):
+            return None
+        insn_t = idautils.DecodeInstruction(prev)
+        if not insn_t or insn_t.itype not in SYSCALL_SETUP_ITYPES:
+            return None
+
+        dst, src = insn_t.Operands[0], insn_t.Operands[1]
+        if dst.type == idc.o_reg and dst.reg in EAX_REGS:
+            if insn_t.itype == idaapi.NN_mov and dst.reg == 0 and \
+               dst.dtyp in (idaapi.dt_dword, idaapi.dt_qword) and \
+               src.type == idc.o_imm and 0 <= src.value < 0x10000:
+                return src.value
+            if insn_t.itype == idaapi.NN_xor and dst.reg == 0 and \
+               src.type == idc.o_reg and src.reg == 0:
+                return 0
+            return None
+        head = prev
+    return None
+
 def findRelocOffset(ea, size):
     for i in xrange(ea,ea+size):
         if idc.GetFixupTgtOff(i) != -1:
@@ -757,6 +834,12 @@ def instructionHandler(M, B, inst, new_eas):
 
     I = addInst(B, inst, inst_bytes)
 
+    if isSystemCall(insn_t):
+        sysnum = getSystemCallNumber(inst)
+        if sysnum is not None:
+            DEBUG("System call {} at {:x}".format(sysnum, inst))
+            I.system_call_number = sysnum
+
     if isJmpTable(inst):
         DEBUG("Its a jump table")
         handleJmpTable(I, inst, new_eas)
@@ -837,6 +920,11 @@ def instructionHandler(M, B, inst, new_eas):
                 DEBUG("INTERNAL JMP: {0:x}".format(cref))
                 I.true_target = cref
 
+                # Tail calls are lifted as calls, so the target has to be
+                # recovered as a function.
+                if isStartOfFunction(cref) and cref not in RECOVERED_EAS:
+                    new_eas.add(cref)
+
     #true: jump to where we have a code-ref
     #false: continue as we were
     if isConditionalJump(inst):
@@ -900,10 +988,11 @@ def instructionHandler(M, B, inst, new_eas):
     return I, False
 
 WEAK_SYMS = set()
+DIRECT_SYMS = set()
 OS_NAME = ""
 
 def parseDefsFile(df):
-    global OS_NAME, WEAK_SYMS
+    global OS_NAME, WEAK_SYMS, DIRECT_SYMS
     emap = {}
     emap_data = {}
     is_linux = OS_NAME == "linux"
@@ -923,6 +1012,12 @@ def parseDefsFile(df):
         else:
             fname = args = conv = ret = sign = None
             line_args = l.split()
+
+            # Functions that follow their calling convention and never call
+            # back into lifted code can be called without detaching.
+            is_direct = len(line_args) > 4 and line_args[-1] == "DIRECT"
+            if is_direct:
+                line_args.pop()
             if len(line_args) == 2:
                 fname, conv = line_args
                 if conv == "MCSEMA":
@@ -951,11 +1046,15 @@ def parseDefsFile(df):
                 raise Exception("Unknown return type:"+ret)
 
             emap[fname] = (int(args), realconv, ret, sign)
+            if is_direct:
+                DIRECT_SYMS.add(fname)
 
             if is_linux:
                 imp_name = "__imp_{}".format(fname)
                 emap[imp_name] = emap[fname]
                 WEAK_SYMS.add(imp_name)
+                if is_direct:
+                    DIRECT_SYMS.add(imp_name)
 
     
     df.close()
@@ -975,6 +1074,7 @@ def processExternalFunction(M, fn):
     extfn.calling_convention = conv
     extfn.argument_count = args
     extfn.is_weak = is_weak
+    extfn.is_direct = fixExternalName(fn) in DIRECT_SYMS
     if ret == 'N':
         extfn.has_return = True
         extfn.no_return = False
@@ -1006,6 +1106,42 @@ def processExternals(M):
         else:
             DEBUG("UNKNOWN API: {0}".format(fixedn))
 
+# How many bytes `readBytes` asks IDA for at once.
+READ_CHUNK_SIZE = 0x10000
+
+# Below this size, `readBytes` stops splitting chunks that have unloaded
+# bytes in them, and reads them one byte at a time.
+MIN_READ_CHUNK_SIZE = 0x100
+
+def readBytes(start, end):
+    """Read the bytes in [start, end), using bulk reads where possible. Bytes
+    without a value (e.g. past the end of a segment's data on disk) read as
+    zeroes."""
+    chunks = []
+    ea = start
+    while ea < end:
+        size = min(READ_CHUNK_SIZE, end - ea)
+        chunks.append(readChunk(ea, size))
+        ea += size
+    return "".join(chunks)
+
+def readChunk(ea, size):
+    # `get_many_bytes` fails if any of the bytes doesn't have a value.
+    bytestr = idaapi.get_many_bytes(ea, size)
+    if bytestr is not None:
+        return bytestr
+
+    if not idc.hasValue(idc.GetFlags(ea)) and \
+       not idc.hasValue(idc.GetFlags(ea + size - 1)) and \
+       idaapi.nextthat(ea, ea + size, idc.hasValue) == idc.BADADDR:
+        return "\x00" * size
+
+    if size <= MIN_READ_CHUNK_SIZE:
+        return readBytesSlowly(ea, ea + size)
+
+    half = size / 2
+    return readChunk(ea, half) + readChunk(ea + half, size - half)
+
 def readBytesSlowly(start, end):
     bytestr = ""
     for i in xrange(start, end):
@@ -1406,72 +1542,141 @@ def createOffsetTable(M, table_start, table_entries):
 
     return jmp_refs
 
-def scanDataForRelocs(M, D, start, end, new_eas, seg_offset):
+# `scanDataForRelocs` reads this many bytes of a segment at a time.
+SCAN_WINDOW_SIZE = 0x100000
+
+def getPointerRanges():
+    """Returns the sorted, merged ranges that a pointer found by
+    `scanDataForRelocs` can point into: every segment of the database, where
+    internal code lives, and every data segment, some of which may have been
+    moved out of the database's segments."""
+    ranges = [(seg_ea, idc.SegEnd(seg_ea)) for seg_ea in idautils.Segments()]
+    ranges.extend(DATA_SEGMENTS.values())
+    ranges.sort()
+
+    merged = []
+    for (start, end) in ranges:
+        if merged and start <= merged[-1][1]:
+            merged[-1] = (merged[-1][0], max(merged[-1][1], end))
+        else:
+            merged.append((start, end))
+    return merged
+
+def findPointerCandidates(start, end, ranges):
+    """Yields, in order, the addresses in [start, end) whose pointer-sized
+    value (or, in 64-bit code, whose low dword) falls into one of `ranges`.
+    The bytes are read a window at a time and unpacked at every byte offset,
+    so that only the candidates have to be checked against the database."""
+    if not ranges:
+        return
+
+    ptr_size = getPointerSize()
+    fmt = "<{}Q" if 8 == ptr_size else "<{}L"
+    range_starts = [r[0] for r in ranges]
+    range_ends = [r[1] for r in ranges]
+    min_ea, max_ea = ranges[0][0], ranges[-1][1]
+
+    def isCandidate(val):
+        if val < min_ea or val >= max_ea:
+            return False
+        i = bisect.bisect_right(range_starts, val) - 1
+        return 0 <= i and val < range_ends[i]
+
+    window_ea = start
+    while window_ea < end:
+        window_end = min(end, window_ea + SCAN_WINDOW_SIZE)
+        size = window_end - window_ea
+        bytestr = readBytes(window_ea, window_end + ptr_size)
+
+        candidates = []
+        for offset in xrange(min(ptr_size, size)):
+            count = (size - offset + ptr_size - 1) / ptr_size
+            vals = struct.unpack_from(fmt.format(count), bytestr, offset)
+            for j, val in enumerate(vals):
+                if isCandidate(val) or \
+                   (8 == ptr_size and isCandidate(val & 0xffffffff)):
+                    candidates.append(window_ea + offset + j * ptr_size)
+
+        candidates.sort()
+        for ea in candidates:
+            yield ea
+        window_ea = window_end
+
+def scanForOffsetTables(M, start, end):
     i = start
     while i < end:
-        if PIE_MODE:
-            (is_table, ecount, entries) = checkIfOffsetTable(i)
-            if is_table:
-                DEBUG("FOUND AN OFFSET TABLE AT: {:08x}".format(i))
-                DEBUG("Table has {} destinations:".format(ecount))
-                for e in entries:
-                    DEBUG("\t{:08x}".format(e))
-                    # these may be the only references to certain
-                    # code islands. Make sure we recover them
-                    #if e not in RECOVERED_EAS:
-                    #    new_eas.add(e)
-
-                refs = createOffsetTable(M, i, entries)
-                for ref in refs:
-                    for e in set(entries):
-                        DEBUG("Adding Offset Table XREF {} => {}".format(ref, e))
-                        idc.AddCodeXref(ref, e, idc.XREF_USER|idc.fl_F)
-
-                i += (4 * ecount) - 1
-
+        (is_table, ecount, entries) = checkIfOffsetTable(i)
+        if is_table:
+            DEBUG("FOUND AN OFFSET TABLE AT: {:08x}".format(i))
+            DEBUG("Table has {} destinations:".format(ecount))
+            for e in entries:
+                DEBUG("\t{:08x}".format(e))
+                # these may be the only references to certain
+                # code islands. Make sure we recover them
+                #if e not in RECOVERED_EAS:
+                #    new_eas.add(e)
+
+            refs = createOffsetTable(M, i, entries)
+            for ref in refs:
+                for e in set(entries):
+                    DEBUG("Adding Offset Table XREF {} => {}".format(ref, e))
+                    idc.AddCodeXref(ref, e, idc.XREF_USER|idc.fl_F)
+
+            i += (4 * ecount) - 1
+
+        i += idc.ItemSize(i) or 1
+
+def scanForPointers(start, end):
+    """Make references out of the pointer-sized values in [start, end) that
+    IDA didn't recognize as pointers."""
+    ranges = getPointerRanges()
+    for i in findPointerCandidates(start, end, ranges):
+        # Skip the insides of items, including the words made by an earlier
+        # candidate, and the items that IDA already knows about.
+        if idc.ItemHead(i) != i or (idc.ItemSize(i) or 1) != 1:
+            continue
         more_dref = [d for d in idautils.DataRefsFrom(i)]
-        dref_size = idc.ItemSize(i) or 1
-        if len(more_dref) == 0 and dref_size == 1 and not PIE_MODE:
-            DEBUG("Testing address: {0:x}... ".format(i))
-
-            # try to read a qword first, then fall back on dword
-            inc_size = 1
-            if getBitness() == 64:
-                pword = readQword(i)
-                make_word = idc.MakeQword
-                inc_size = 8
-                if not isSaneReference(pword):
-                    pword = readDword(i)
-                    make_word = idc.MakeDword
-                    inc_size = 4
-            else:
-                make_word = idc.MakeDword
+        if len(more_dref) != 0:
+            continue
+
+        DEBUG("Testing address: {0:x}... ".format(i))
+
+        # try to read a qword first, then fall back on dword
+        if getBitness() == 64:
+            pword = readQword(i)
+            make_word = idc.MakeQword
+            if not isSaneReference(pword):
                 pword = readDword(i)
-                inc_size = 4
+                make_word = idc.MakeDword
+        else:
+            make_word = idc.MakeDword
+            pword = readDword(i)
 
-            # check for unmakred references
+        # check for unmakred references
 
-            #TODO(artem) possibly add check that do more reference sanity 
-            # checking, such as if pword falls in the middle of a string
-            if isInData(pword, pword+1):# and idc.ItemHead(pword) == pword:
-                if make_word(i):
-                    idc.add_dref(i, pword, idc.XREF_USER|idc.dr_O)
-                    DEBUG("making New Data Reference at: {0:x} => {1:x}".format(i, pword))
-                    dref_size = inc_size
-                else:
-                    DEBUG("WARNING: Could not make reference at {:x}".format(i))
-            # check if code and points to the beginning of an instruction
-            elif isInternalCode(pword) and idc.ItemHead(pword) == pword:
-                if make_word(i):
-                    idc.AddCodeXref(i, pword, idc.XREF_USER|idc.fl_F)
-                    DEBUG("making New Code Reference at: {0:x} => {1:x}".format(i, pword))
-                    dref_size = inc_size
-                else:
-                    DEBUG("WARNING: Could not make reference at {:x}".format(i))
+        #TODO(artem) possibly add check that do more reference sanity 
+        # checking, such as if pword falls in the middle of a string
+        if isInData(pword, pword+1):# and idc.ItemHead(pword) == pword:
+            if make_word(i):
+                idc.add_dref(i, pword, idc.XREF_USER|idc.dr_O)
+                DEBUG("making New Data Reference at: {0:x} => {1:x}".format(i, pword))
             else:
-                DEBUG("not code or data ref")
+                DEBUG("WARNING: Could not make reference at {:x}".format(i))
+        # check if code and points to the beginning of an instruction
+        elif isInternalCode(pword) and idc.ItemHead(pword) == pword:
+            if make_word(i):
+                idc.AddCodeXref(i, pword, idc.XREF_USER|idc.fl_F)
+                DEBUG("making New Code Reference at: {0:x} => {1:x}".format(i, pword))
+            else:
+                DEBUG("WARNING: Could not make reference at {:x}".format(i))
+        else:
+            DEBUG("not code or data ref")
 
-        i += dref_size
+def scanDataForRelocs(M, D, start, end, new_eas, seg_offset):
+    if PIE_MODE:
+        scanForOffsetTables(M, start, end)
+    else:
+        scanForPointers(start, end)
 
     def insertReference(M, D, ea, pointsto, seg_offset, new_eas, force_size=None):
         # do not make code references for mid-function code accessed via a JMP -- 
@@ -1493,8 +1698,8 @@ def scanDataForRelocs(M, D, start, end, new_eas, seg_offset):
         insertRelocatedSymbol(M, D, pointsto, ea, seg_offset, new_eas, reloc_size)
 
 
-    i = start
-    while i < end:
+    # Only the items can hold references, so skip over the undefined bytes.
+    for i in idautils.Heads(start, end):
         DEBUG("Checking address: {:x}".format(i))
         dref_size = idc.ItemSize(i) or 1
         if dref_size > getPointerSize():
@@ -1518,14 +1723,10 @@ def scanDataForRelocs(M, D, start, end, new_eas, seg_offset):
                         dref_size = 8
                     else:
                         DEBUG("WARNING: Failed at make qword at {:x}, ignoring ref".format(i))
-                        dref_size = 4
-                        i += dref_size
                         continue
 
                 else:
                     DEBUG("WARNING: could not make qword from 32-bit dref at {:x}, ignoring ref".format(i))
-                    dref_size = 4
-                    i += dref_size
                     continue
 
             more_cref = [c for c in idautils.CodeRefsFrom(i,0)]
@@ -1545,8 +1746,6 @@ def scanDataForRelocs(M, D, start, end, new_eas, seg_offset):
                     DEBUG("\t\tWARNING: Possible data ref problem");
                     insertReference(M, D, i, more_dref[0], seg_offset, new_eas)
 
-        i += dref_size
-
 def processRelocationsInData(M, D, start, end, new_eas, seg_offset):
 
     if start == 0:
@@ -1649,7 +1848,7 @@ def populateDataSegment(M, start, end, new_eas):
     else:
         D.read_only = False
 
-    D.data = readBytesSlowly(start, end)
+    D.data = readBytes(start, end)
 
     processRelocationsInData(M, D, start, end, new_eas, seg_offset)
 
@@ -1709,6 +1908,162 @@ def recoverFunction(M, F, fnea, new_eas):
     blockset = getFunctionBlocks(fnea)
     recoverFunctionFromSet(M, F, blockset, new_eas)
 
+# Version of the function hashes written by `--incremental`. Bump this
+# whenever the exporter changes what it writes into a `Function`, so that
+# stale functions aren't reused.
+FUNCTION_HASH_VERSION = 3
+
+# Options that change what the exporter writes into a `Function`. Functions
+# exported with different options are never reused.
+EXPORT_OPTIONS = {}
+
+# Serialized `Function`s and hash records of the previous incremental
+# export, keyed by entry address.
+PREV_FUNCTIONS = {}
+PREV_HASHES = {}
+
+# Hash records of the functions of the current incremental export.
+NEW_HASHES = {}
+
+INCREMENTAL = False
+REUSED_FUNCTIONS = 0
+
+def hashFunction(fnea, blocks):
+    """Hash everything that goes into the `Function` recovered from `fnea`:
+    the bytes of its blocks, and the references out of its instructions, along
+    with the names of what they refer to."""
+    h = hashlib.sha1()
+    h.update(getFunctionName(fnea) or "")
+    for block in blocks:
+        h.update("B{:x}:{:x}".format(block.startEA, block.endEA))
+        h.update(readBytes(block.startEA, block.endEA))
+        for succ in block.succs:
+            h.update("S{:x}".format(succ))
+        for head in idautils.Heads(block.startEA, block.endEA):
+            for ref in idautils.CodeRefsFrom(head, 0):
+                h.update("C{:x}:{}".format(ref, getFunctionName(ref) or ""))
+            for ref in idautils.DataRefsFrom(head):
+                h.update("D{:x}:{}".format(ref, getFunctionName(ref) or ""))
+            if head in ACCESSED_VIA_JMP:
+                h.update("J")
+    return h.hexdigest()
+
+def hashesPath(cfg_path):
+    return "{}.hashes".format(cfg_path)
+
+def loadPreviousExport(cfg_path):
+    """Load the functions of a previous `--incremental` export to `cfg_path`,
+    if there is one that used the same options."""
+    try:
+        with open(hashesPath(cfg_path), "r") as f:
+            hashes = json.load(f)
+        with open(cfg_path, "rb") as f:
+            M = CFG_pb2.Module()
+            M.ParseFromString(f.read())
+    except (IOError, ValueError) as e:
+        DEBUG("Not reusing a previous export: {}".format(e))
+        return
+
+    if hashes.get("version") != FUNCTION_HASH_VERSION or \
+       hashes.get("options") != EXPORT_OPTIONS:
+        DEBUG("Not reusing a previous export with different options")
+        return
+
+    for ea_str, record in hashes["functions"].items():
+        PREV_HASHES[int(ea_str, 16)] = record
+    for F in M.internal_funcs:
+        PREV_FUNCTIONS[F.entry_address] = F
+
+    for shard_name in M.shard_files:
+        shard = CFG_pb2.Module()
+        try:
+            with open(path.join(path.dirname(cfg_path), shard_name), "rb") as f:
+                shard.ParseFromString(f.read())
+        except IOError as e:
+            DEBUG("Not reusing the functions of shard {}: {}".format(
+                shard_name, e))
+            continue
+        for F in shard.internal_funcs:
+            PREV_FUNCTIONS[F.entry_address] = F
+    DEBUG("Loaded {} functions from the previous export".format(
+        len(PREV_FUNCTIONS)))
+
+def saveExportHashes(cfg_path):
+    functions = {}
+    for ea, record in NEW_HASHES.items():
+        functions["{:x}".format(ea)] = record
+    with open(hashesPath(cfg_path), "w") as f:
+        json.dump({"version": FUNCTION_HASH_VERSION,
+                   "options": EXPORT_OPTIONS,
+                   "functions": functions}, f)
+
+def writeShardedModule(M, outf, num_shards):
+    """Write `M` as a manifest to `outf`, and its functions into
+    `num_shards` shard files next to it, named `<output>.shard<N>`."""
+    funcs = list(M.internal_funcs)
+    del M.internal_funcs[:]
+
+    # Instructions dominate the size of a shard, so balance shards by them.
+    shards = [[0, []] for _ in range(num_shards)]
+    for F in sorted(funcs, key=functionSize, reverse=True):
+        shard = min(shards, key=lambda s: s[0])
+        shard[0] += functionSize(F)
+        shard[1].append(F)
+
+    for i, (_, shard_funcs) in enumerate(shards):
+        shard_name = "{}.shard{}".format(path.basename(outf.name), i)
+        S = CFG_pb2.Module()
+        S.module_name = M.module_name
+        S.internal_funcs.extend(shard_funcs)
+        with open(path.join(path.dirname(outf.name), shard_name), "wb") as f:
+            f.write(S.SerializeToString())
+        M.shard_files.append(shard_name)
+
+    outf.write(M.SerializeToString())
+
+def functionSize(F):
+    return sum(len(B.insts) for B in F.blocks)
+
+def recoverOrReuseFunction(M, F, fnea, new_eas):
+    """Like `recoverFunction`, but in an incremental export, copy the
+    `Function` from the previous export if `fnea` hasn't changed since."""
+    global EXTERNALS, REUSED_FUNCTIONS
+    if not INCREMENTAL:
+        recoverFunction(M, F, fnea, new_eas)
+        return
+
+    blockset = getFunctionBlocks(fnea)
+    fhash = hashFunction(fnea, blockset)
+    record = PREV_HASHES.get(fnea)
+
+    if record and record["hash"] == fhash and fnea in PREV_FUNCTIONS:
+        DEBUG("Reusing unchanged function {:x}".format(fnea))
+        F.CopyFrom(PREV_FUNCTIONS[fnea])
+        EXTERNALS.update(record["externals"])
+        REUSED_FUNCTIONS += 1
+
+    else:
+        # Collect what this function refers to separately, so that it can be
+        # replayed when the function is reused by the next export.
+        callees = set()
+        outer_externals = EXTERNALS
+        EXTERNALS = set()
+        try:
+            recoverFunctionFromSet(M, F, blockset, callees)
+        finally:
+            fn_externals = EXTERNALS
+            EXTERNALS = outer_externals
+            EXTERNALS.update(fn_externals)
+
+        record = {"hash": fhash,
+                  "callees": sorted(callees),
+                  "externals": sorted(fn_externals)}
+
+    NEW_HASHES[fnea] = record
+    for callee in record["callees"]:
+        if callee not in RECOVERED_EAS:
+            new_eas.add(callee)
+
 class Block:
     def __init__(self, startEA):
         self.startEA = startEA
@@ -1790,6 +2145,11 @@ def getFunctionBlocks(startea):
         bstart = to_recover.pop()
         # recover the block
         newb = recoverBlock(bstart)
+        # A jump to the start of another function is a tail call. It is lifted
+        # as a call to that function, so don't copy its blocks into this one.
+        if isUnconditionalJump(idc.PrevHead(newb.endEA)):
+            newb.succs = [f for f in newb.succs
+                          if f == startea or not isStartOfFunction(f)]
         # save to our recovered block list
         blocks[newb.startEA] = newb
         # add new workers
@@ -1856,7 +2216,8 @@ def preprocessBinary():
                             idaapi.del_cref(head, op.value, False)
 
 
-def recoverCfg(to_recover, outf, exports_are_apis=False):
+def recoverCfg(to_recover, outf, exports_are_apis=False, num_shards=1,
+               as_cfg_map=False):
     global EMAP
     M = CFG_pb2.Module()
     M.module_name = idc.GetInputFile()
@@ -1872,6 +2233,7 @@ def recoverCfg(to_recover, outf, exports_are_apis=False):
     new_eas = set()
 
     preprocessBinary()
+    clearCaches()
 
     processDataSegments(M, new_eas)
     
@@ -1907,7 +2269,7 @@ def recoverCfg(to_recover, outf, exports_are_apis=False):
         F = entryPointHandler(M, fea, fname, exports_are_apis)
 
         RECOVERED_EAS.add(fea)
-        recoverFunction(M, F, fea, new_eas)
+        recoverOrReuseFunction(M, F, fea, new_eas)
 
         recovered_fns += 1
 
@@ -1923,7 +2285,7 @@ def recoverCfg(to_recover, outf, exports_are_apis=False):
         DEBUG("Recovering: {0}".format(hex(cur_ea)))
         RECOVERED_EAS.add(cur_ea)
 
-        recoverFunction(M, F, cur_ea, new_eas)
+        recoverOrReuseFunction(M, F, cur_ea, new_eas)
 
         recovered_fns += 1
 
@@ -1934,9 +2296,18 @@ def recoverCfg(to_recover, outf, exports_are_apis=False):
     mypath = path.dirname(__file__)
     processExternals(M)
 
-    outf.write(M.SerializeToString())
+    if as_cfg_map:
+        cfg_map.write_cfg_map(M, outf)
+    elif num_shards > 1:
+        writeShardedModule(M, outf, num_shards)
+    else:
+        outf.write(M.SerializeToString())
     outf.close()
 
+    if INCREMENTAL:
+        saveExportHashes(outf.name)
+        DEBUG("Reused {0} unchanged functions.".format(REUSED_FUNCTIONS))
+
     DEBUG("Recovered {0} functions.".format(recovered_fns))
     DEBUG("Saving to: {0}".format(outf.name))
 
@@ -2143,6 +2514,7 @@ def mark_as_code(address):
         DEBUG("Marking {:x} as code".format(address))
         idc.MakeCode(address)
         idaapi.autoWait()
+        clearCaches()
 
 
 # Mark an address as being the beginning of a function.
@@ -2151,6 +2523,7 @@ def try_mark_as_function(address):
     DEBUG("Unable to convert code to function: {}".format(address))
     return False
   idaapi.autoWait()
+  clearCaches()
   return True
 
     
@@ -2173,7 +2546,7 @@ if __name__ == "__main__":
         required=True)
 
     parser.add_argument(
-        "--output", type=argparse.FileType('wb'), default=None,
+        "--output", default=None,
         help="The output control flow graph recovered from this file",
         required=True)
 
@@ -2203,6 +2576,15 @@ if __name__ == "__main__":
     parser.add_argument("--pie-mode", action="store_true", default=False,
         help="Assume all immediate values are constants (useful for ELFs built with -fPIE")
 
+    parser.add_argument("--shards", type=int, default=1,
+        help="Split the functions of the CFG into this many shard files next to the output, which then only holds the rest of the module and the list of shards")
+
+    parser.add_argument("--incremental", action="store_true", default=False,
+        help="Save a hash of every function next to the output CFG, and copy functions whose hash is unchanged from the previous CFG instead of recovering them again")
+
+    parser.add_argument("--cfg-map", action="store_true", default=False,
+        help="Write the CFG as a memory-mapped container that mcsema-lift reads without parsing, instead of a protobuf. Can't be used with --shards or --incremental")
+
     args = parser.parse_args(args=idc.ARGV[1:])
 
     if args.log_file != os.devnull:
@@ -2217,6 +2599,10 @@ if __name__ == "__main__":
             args.arch, getAvailableBitness()))
         idc.Exit(-1)
 
+    if args.cfg_map and (args.shards > 1 or args.incremental):
+        DEBUG("--cfg-map can't be used with --shards or --incremental")
+        idc.Exit(-1)
+
     if args.pie_mode:
         DEBUG("Using PIE mode.")
         PIE_MODE = True
@@ -2275,7 +2661,7 @@ if __name__ == "__main__":
 
         myname = idc.GetInputFile()
         mypath = path.dirname(__file__)
-        outpath = os.path.dirname(args.output.name)
+        outpath = os.path.dirname(args.output)
 
         if args.entrypoint:
             eps.extend(args.entrypoint)
@@ -2298,10 +2684,20 @@ if __name__ == "__main__":
             DEBUG("Output build .BAT: {0}".format(outbat))
             generateBatFile(outbat, eps)
 
-        outf = args.output
+        if args.incremental:
+            INCREMENTAL = True
+            EXPORT_OPTIONS.update({
+                "arch": args.arch,
+                "os": args.os,
+                "pie_mode": PIE_MODE,
+                "std_defs": [path.abspath(f) for f in args.std_defs]})
+            loadPreviousExport(args.output)
+
+        outf = open(args.output, "wb")
         DEBUG("CFG Output File file: {0}".format(outf.name))
 
-        recoverCfg(eps, outf, args.exports_are_apis)
+        recoverCfg(eps, outf, args.exports_are_apis, args.shards,
+                   args.cfg_map)
     except Exception as e:
         DEBUG(str(e))
         DEBUG(traceback.format_exc())
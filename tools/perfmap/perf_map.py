@@ -0,0 +1,175 @@
+#!/usr/bin/env python
+# Copyright 2017 Trail of Bits, all rights reserved.
+
+"""Tie samples in lifted code back to the native binary.
+
+Reads the `-symbol-map` file written by `mcsema-lift`, which maps the native
+address of every lifted function to its name in the lifted bitcode and its
+original symbol name.
+
+The `map` command combines it with the symbol table of the compiled lifted
+program to write a `perf-<pid>.map` file, where every lifted function is
+named after its original symbol and native address. The `symbolize` command
+rewrites the names of lifted functions in text, e.g. the output of
+`perf script` or `perf report --stdio`, in the same way."""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+
+ET_DYN = 3
+
+
+class SymbolMapError(Exception):
+  pass
+
+
+def read_symbol_map(path):
+  """Returns a dictionary mapping lifted function names to their native
+  address and symbol name."""
+  funcs = {}
+  with open(path) as f:
+    for line_num, line in enumerate(f, 1):
+      line = line.split("#", 1)[0].strip()
+      if not line:
+        continue
+      parts = line.split()
+      if len(parts) != 3:
+        raise SymbolMapError("{}:{}: expected '<native_va> <lifted_name> "
+                             "<native_symbol>'".format(path, line_num))
+      try:
+        va = int(parts[0], 16)
+      except ValueError:
+        raise SymbolMapError("{}:{}: bad native address {}".format(
+            path, line_num, parts[0]))
+      funcs[parts[1]] = (va, parts[2])
+  return funcs
+
+
+def native_name(va, symbol):
+  return "{} [native 0x{:x}]".format(symbol, va)
+
+
+def read_lifted_symbols(nm, binary):
+  """Yields the address, size, and name of every sized function symbol of
+  the compiled lifted program."""
+  output = subprocess.check_output(
+      [nm, "--defined-only", "--print-size", "--numeric-sort", binary])
+  for line in output.decode("ascii", "replace").splitlines():
+    parts = line.split()
+    if len(parts) != 4 or parts[2] not in "tTwW":
+      continue
+    yield int(parts[0], 16), int(parts[1], 16), parts[3]
+
+
+def is_position_independent(binary):
+  with open(binary, "rb") as f:
+    header = f.read(18)
+  if len(header) < 18 or header[:4] != b"\x7fELF":
+    return False
+  endian = "<" if header[5:6] == b"\x01" else ">"
+  e_type, = struct.unpack(endian + "H", header[16:18])
+  return e_type == ET_DYN
+
+
+def load_base(pid, binary):
+  """Returns the address where `binary` is loaded in process `pid`."""
+  binary = os.path.realpath(binary)
+  with open("/proc/{}/maps".format(pid)) as f:
+    for line in f:
+      parts = line.split()
+      if len(parts) < 6 or os.path.realpath(parts[5]) != binary:
+        continue
+      if int(parts[2], 16) == 0:
+        return int(parts[0].split("-")[0], 16)
+  raise SymbolMapError("{} is not loaded in process {}".format(binary, pid))
+
+
+def write_perf_map(args, funcs):
+  base = 0
+  if args.pid is not None and is_position_independent(args.binary):
+    base = load_base(args.pid, args.binary)
+
+  output = args.output
+  if output is None:
+    output = "-" if args.pid is None else "/tmp/perf-{}.map".format(args.pid)
+
+  out = sys.stdout if output == "-" else open(output, "w")
+  num_written = 0
+  try:
+    for addr, size, name in read_lifted_symbols(args.nm, args.binary):
+      if name not in funcs or not size:
+        continue
+      va, symbol = funcs[name]
+      out.write("{:x} {:x} {}\n".format(base + addr, size,
+                                        native_name(va, symbol)))
+      num_written += 1
+  finally:
+    if out is not sys.stdout:
+      out.close()
+
+  if not num_written:
+    sys.stderr.write("No lifted functions found in the symbol table of "
+                     "{}\n".format(args.binary))
+    return 1
+  return 0
+
+
+def symbolize(args, funcs):
+  names = sorted(funcs, key=len, reverse=True)
+  if not names:
+    return 0
+  pattern = re.compile(r"(?<![\w.$])({})(?![\w.$])".format(
+      "|".join(re.escape(name) for name in names)))
+
+  def replace(match):
+    return native_name(*funcs[match.group(1)])
+
+  for line in sys.stdin:
+    sys.stdout.write(pattern.sub(replace, line))
+  return 0
+
+
+def main(args=None):
+  arg_parser = argparse.ArgumentParser(description=__doc__)
+  arg_parser.add_argument(
+      "--symbols", required=True,
+      help="Symbol map written by `mcsema-lift -symbol-map`.")
+  commands = arg_parser.add_subparsers(dest="command")
+
+  map_parser = commands.add_parser(
+      "map", help="Write a perf map for the compiled lifted program.")
+  map_parser.add_argument("binary", help="The compiled lifted program.")
+  map_parser.add_argument(
+      "--pid", type=int,
+      help="Process running the lifted program. Position-independent "
+           "programs are relocated to where they are loaded in it, and the "
+           "map goes to /tmp/perf-<pid>.map by default.")
+  map_parser.add_argument(
+      "--output", help="Where to write the map. Defaults to stdout without "
+                       "--pid.")
+  map_parser.add_argument("--nm", default="nm", help="Path to nm.")
+
+  commands.add_parser(
+      "symbolize", help="Rename lifted functions in the text on stdin.")
+
+  args = arg_parser.parse_args(args)
+
+  try:
+    funcs = read_symbol_map(args.symbols)
+    if args.command == "map":
+      return write_perf_map(args, funcs)
+    elif args.command == "symbolize":
+      return symbolize(args, funcs)
+    arg_parser.error("Expected a command: map or symbolize")
+  except (IOError, OSError, subprocess.CalledProcessError,
+          SymbolMapError) as e:
+    sys.stderr.write("{}\n".format(e))
+    return 2
+
+
+if __name__ == "__main__":
+  sys.exit(main())
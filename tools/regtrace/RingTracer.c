@@ -0,0 +1,224 @@
+/* Copyright 2017 Trail of Bits, all rights reserved. */
+
+// Ring buffer backend for `mcsema-lift -add-reg-tracer
+// -reg-tracer-format=binary`. Link this file into the lifted program (Linux
+// only, needs `-lpthread`).
+//
+// Every thread that records a register state gets its own `mmap`ed ring
+// buffer. The lifted code only copies records into the buffer; a background
+// thread drains the buffers into one file per thread, named
+// `<prefix>.<tid>.bin`. The prefix is `$MCSEMA_TRACE_FILE`, or
+// `mcsema-trace` by default, and the per-thread buffer size can be set with
+// `$MCSEMA_TRACE_BUFFER_MB`. Nothing is dropped: a thread whose buffer is
+// full waits for the flusher to catch up.
+//
+// Use `decode_trace.py` to turn a trace file back into the text format
+// printed by `-reg-tracer-format=text`.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../mcsema/Arch/X86/Runtime/Trace.h"
+
+static const uint64_t kDefaultBufferSize = 64ULL << 20;
+
+struct ThreadTrace {
+  uint8_t *buffer;
+  uint64_t mapped_size;
+  uint64_t size;
+
+  // Only the owning thread advances `head`, and only the flusher advances
+  // `tail`; both only ever increase.
+  uint64_t head;
+  uint64_t tail;
+
+  int fd;
+  int finished;
+  struct ThreadTrace *next;
+};
+
+static __thread struct ThreadTrace *gThreadTrace = NULL;
+
+static pthread_mutex_t gTracesLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ThreadTrace *gTraces = NULL;
+
+static pthread_once_t gInitOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t gThreadKey;
+static pthread_t gFlusher;
+static int gExiting = 0;
+
+static void WriteAll(int fd, const uint8_t *data, uint64_t size) {
+  while (size) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      perror("mcsema trace write");
+      abort();
+    }
+    data += written;
+    size -= (uint64_t) written;
+  }
+}
+
+// Write everything that has been recorded into `trace` to its file. Called
+// with `gTracesLock` held.
+static void DrainTrace(struct ThreadTrace *trace) {
+  uint64_t head = __atomic_load_n(&(trace->head), __ATOMIC_ACQUIRE);
+  uint64_t tail = trace->tail;
+  while (tail < head) {
+    uint64_t offset = tail % trace->size;
+    uint64_t count = head - tail;
+    if (count > trace->size - offset) {
+      count = trace->size - offset;
+    }
+    WriteAll(trace->fd, &(trace->buffer[offset]), count);
+    tail += count;
+  }
+  __atomic_store_n(&(trace->tail), tail, __ATOMIC_RELEASE);
+}
+
+// Drain every buffer, and release the buffers of threads that have exited.
+// Returns non-zero if anything was written.
+static int DrainTraces(void) {
+  int wrote = 0;
+  pthread_mutex_lock(&gTracesLock);
+  struct ThreadTrace **link = &gTraces;
+  while (*link) {
+    struct ThreadTrace *trace = *link;
+    int finished = __atomic_load_n(&(trace->finished), __ATOMIC_ACQUIRE);
+    if (trace->tail != __atomic_load_n(&(trace->head), __ATOMIC_ACQUIRE)) {
+      DrainTrace(trace);
+      wrote = 1;
+    }
+    if (finished) {
+      *link = trace->next;
+      close(trace->fd);
+      munmap(trace->buffer, trace->mapped_size);
+      free(trace);
+    } else {
+      link = &(trace->next);
+    }
+  }
+  pthread_mutex_unlock(&gTracesLock);
+  return wrote;
+}
+
+static void *FlushThread(void *arg) {
+  (void) arg;
+  struct timespec pause = {0, 1000000};
+  while (!__atomic_load_n(&gExiting, __ATOMIC_ACQUIRE)) {
+    if (!DrainTraces()) {
+      nanosleep(&pause, NULL);
+    }
+  }
+  DrainTraces();
+  return NULL;
+}
+
+static void FinishThreadTrace(void *arg) {
+  struct ThreadTrace *trace = (struct ThreadTrace *) arg;
+  __atomic_store_n(&(trace->finished), 1, __ATOMIC_RELEASE);
+}
+
+static void StopTracing(void) {
+  __atomic_store_n(&gExiting, 1, __ATOMIC_RELEASE);
+  pthread_join(gFlusher, NULL);
+}
+
+static void InitTracing(void) {
+  if (pthread_key_create(&gThreadKey, FinishThreadTrace) ||
+      pthread_create(&gFlusher, NULL, FlushThread, NULL)) {
+    fprintf(stderr, "Unable to start the mcsema trace flusher\n");
+    abort();
+  }
+  atexit(StopTracing);
+}
+
+static struct ThreadTrace *CreateThreadTrace(uint32_t layout) {
+  pthread_once(&gInitOnce, InitTracing);
+
+  uint64_t size = kDefaultBufferSize;
+  const char *size_mb = getenv("MCSEMA_TRACE_BUFFER_MB");
+  if (size_mb && atoi(size_mb) > 0) {
+    size = ((uint64_t) atoi(size_mb)) << 20;
+  }
+
+  uint64_t record_size = MCSEMA_TRACE_NUM_WORDS(layout) * sizeof(uint64_t);
+  if (size < record_size) {
+    size = record_size;
+  }
+
+  struct ThreadTrace *trace = calloc(1, sizeof(struct ThreadTrace));
+  void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (!trace || MAP_FAILED == buffer) {
+    fprintf(stderr, "Unable to allocate a mcsema trace buffer\n");
+    abort();
+  }
+
+  uint64_t tid = (uint64_t) syscall(SYS_gettid);
+  const char *prefix = getenv("MCSEMA_TRACE_FILE");
+  char path[4096];
+  snprintf(path, sizeof(path), "%s.%llu.bin",
+           prefix ? prefix : "mcsema-trace", (unsigned long long) tid);
+
+  trace->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (0 > trace->fd) {
+    perror(path);
+    abort();
+  }
+
+  struct TraceHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MCSEMA_TRACE_MAGIC, sizeof(header.magic));
+  header.version = MCSEMA_TRACE_VERSION;
+  header.layout = layout;
+  header.thread_id = tid;
+  WriteAll(trace->fd, (const uint8_t *) &header, sizeof(header));
+
+  trace->buffer = (uint8_t *) buffer;
+  trace->mapped_size = size;
+  trace->size = size - (size % record_size);
+
+  pthread_mutex_lock(&gTracesLock);
+  trace->next = gTraces;
+  gTraces = trace;
+  pthread_mutex_unlock(&gTracesLock);
+
+  pthread_setspecific(gThreadKey, trace);
+  gThreadTrace = trace;
+  return trace;
+}
+
+void __mcsema_trace_record(const uint64_t *words, uint32_t layout) {
+  struct ThreadTrace *trace = gThreadTrace;
+  if (!trace) {
+    trace = CreateThreadTrace(layout);
+  }
+
+  uint64_t record_size = MCSEMA_TRACE_NUM_WORDS(layout) * sizeof(uint64_t);
+  uint64_t head = trace->head;
+  while (trace->size - (head - __atomic_load_n(&(trace->tail),
+                                               __ATOMIC_ACQUIRE)) <
+         record_size) {
+    sched_yield();
+  }
+
+  // The buffer size is a multiple of the record size, so records never wrap.
+  memcpy(&(trace->buffer[head % trace->size]), words, record_size);
+  __atomic_store_n(&(trace->head), head + record_size, __ATOMIC_RELEASE);
+}
@@ -4,14 +4,44 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
+#include "../../mcsema/Arch/X86/Runtime/Trace.h"
 
 KNOB<uintptr_t> gEntrypoint(
     KNOB_MODE_WRITEONCE, "pintool", "entrypoint", "0",
     "Entrypoint of lifted program. Usually address of `main`.");
 
+KNOB<std::string> gFormat(
+    KNOB_MODE_WRITEONCE, "pintool", "format", "text",
+    "Output format: `text` prints the `-add-reg-tracer` text format to "
+    "stdout, and `binary` writes the `-reg-tracer-format=binary` record "
+    "format to one file per thread.");
+
+KNOB<std::string> gOutput(
+    KNOB_MODE_WRITEONCE, "pintool", "o", "pin-trace",
+    "Prefix of the binary trace files. Each thread's trace is written to "
+    "`<prefix>.<tid>.bin`.");
+
+KNOB<BOOL> gFlags(
+    KNOB_MODE_WRITEONCE, "pintool", "flags", "0",
+    "Include the flags in binary records, like `-reg-tracer-flags`.");
+
+KNOB<BOOL> gXMM(
+    KNOB_MODE_WRITEONCE, "pintool", "xmm", "0",
+    "Include the XMM registers in binary records, like `-reg-tracer-xmm`.");
+
+KNOB<BOOL> gDelta(
+    KNOB_MODE_WRITEONCE, "pintool", "delta", "0",
+    "Only write the registers that changed since the previous record of "
+    "the same thread into binary records.");
+
+KNOB<UINT32> gBufferKB(
+    KNOB_MODE_WRITEONCE, "pintool", "buffer-kb", "1024",
+    "Size of each thread's binary output buffer, in KiB.");
+
 struct RegInfo final {
   const char *name;
   LEVEL_BASE::REG reg;
@@ -20,6 +50,8 @@ struct RegInfo final {
 static uintptr_t gLowAddr = 0;
 static uintptr_t gHighAddr = 0;
 
+// Registers are listed in the same order as the `-add-reg-tracer` output,
+// so that binary records line up with those of the lifted program.
 #ifdef __x86_64__
 
 static const struct RegInfo gGprs[] = {
@@ -30,8 +62,8 @@ static const struct RegInfo gGprs[] = {
   {"RDX", LEVEL_BASE::REG_RDX},
   {"RSI", LEVEL_BASE::REG_RSI},
   {"RDI", LEVEL_BASE::REG_RDI},
-  {"RBP", LEVEL_BASE::REG_RBP},
   {"RSP", LEVEL_BASE::REG_RSP},
+  {"RBP", LEVEL_BASE::REG_RBP},
   {"R8", LEVEL_BASE::REG_R8},
   {"R9", LEVEL_BASE::REG_R9},
   {"R10", LEVEL_BASE::REG_R10},
@@ -42,6 +74,9 @@ static const struct RegInfo gGprs[] = {
   {"R15", LEVEL_BASE::REG_R15},
 };
 
+static const uint32_t kLayout = MCSEMA_TRACE_64BIT;
+static const unsigned kNumXMMs = 16;
+
 #else
 
 static const struct RegInfo gGprs[] = {
@@ -52,19 +87,53 @@ static const struct RegInfo gGprs[] = {
   {"EDX", LEVEL_BASE::REG_EDX},
   {"ESI", LEVEL_BASE::REG_ESI},
   {"EDI", LEVEL_BASE::REG_EDI},
-  {"EBP", LEVEL_BASE::REG_EBP},
   {"ESP", LEVEL_BASE::REG_ESP},
+  {"EBP", LEVEL_BASE::REG_EBP},
 };
 
+static const uint32_t kLayout = 0;
+static const unsigned kNumXMMs = 8;
+
 #endif  // __x86_64__
 
+static const unsigned kNumGprs = sizeof(gGprs) / sizeof(gGprs[0]);
+
+// `EFLAGS` bits that the lifted tracer records. `MCSEMA_TRACE_*_BIT` are the
+// same bit positions as in `EFLAGS`.
+static const uint64_t kFlagsMask =
+    (1ULL << MCSEMA_TRACE_CF_BIT) | (1ULL << MCSEMA_TRACE_PF_BIT) |
+    (1ULL << MCSEMA_TRACE_AF_BIT) | (1ULL << MCSEMA_TRACE_ZF_BIT) |
+    (1ULL << MCSEMA_TRACE_SF_BIT) | (1ULL << MCSEMA_TRACE_DF_BIT) |
+    (1ULL << MCSEMA_TRACE_OF_BIT);
+
+static uint32_t gBinaryLayout = 0;
+static unsigned gNumWords = 0;
+
+// Set once the entrypoint has executed.
+static volatile bool gTracing = false;
+
+// Per-thread binary output.
+struct ThreadTrace final {
+  FILE *file;
+  uint8_t *buffer;
+  size_t used;
+  size_t size;
+  bool has_prev;
+  uint64_t prev[MCSEMA_TRACE_MAX_WORDS];
+};
+
+static TLS_KEY gThreadKey;
+
+static bool ShouldTrace(const CONTEXT *ctx) {
+  if (!gTracing) {
+    gTracing = gEntrypoint.Value() == PIN_GetContextReg(ctx, gGprs[0].reg);
+  }
+  return gTracing;
+}
+
 VOID PrintRegState(CONTEXT *ctx) {
-  static bool gPrinting = false;
-  if (!gPrinting) {
-    gPrinting = gEntrypoint.Value() == PIN_GetContextReg(ctx, gGprs[0].reg);
-    if (!gPrinting) {
-      return;
-    }
+  if (!ShouldTrace(ctx)) {
+    return;
   }
 
   std::stringstream ss;
@@ -82,10 +151,86 @@ VOID PrintRegState(CONTEXT *ctx) {
   printf("%s\n", ss.str().c_str());
 }
 
+static void FlushThreadTrace(ThreadTrace *trace) {
+  if (trace->used) {
+    fwrite(trace->buffer, 1, trace->used, trace->file);
+    trace->used = 0;
+  }
+}
+
+static void AppendWords(ThreadTrace *trace, const uint64_t *words,
+                        unsigned num_words) {
+  auto size = num_words * sizeof(uint64_t);
+  if (trace->used + size > trace->size) {
+    FlushThreadTrace(trace);
+  }
+  memcpy(&(trace->buffer[trace->used]), words, size);
+  trace->used += size;
+}
+
+VOID RecordRegState(const CONTEXT *ctx, THREADID tid) {
+  if (!ShouldTrace(ctx)) {
+    return;
+  }
+
+  auto trace = reinterpret_cast<ThreadTrace *>(
+      PIN_GetThreadData(gThreadKey, tid));
+  if (!trace) {
+    return;
+  }
+
+  uint64_t words[MCSEMA_TRACE_MAX_WORDS];
+  unsigned i = 0;
+  for (auto &gpr : gGprs) {
+    words[i++] = PIN_GetContextReg(ctx, gpr.reg);
+  }
+
+  if (gFlags.Value()) {
+    words[i++] = PIN_GetContextReg(ctx, LEVEL_BASE::REG_GFLAGS) & kFlagsMask;
+  }
+
+  if (gXMM.Value()) {
+    for (unsigned n = 0; n < kNumXMMs; ++n) {
+      PIN_REGISTER val;
+      PIN_GetContextRegval(
+          ctx, static_cast<REG>(LEVEL_BASE::REG_XMM0 + n),
+          reinterpret_cast<UINT8 *>(&val));
+      words[i++] = val.qword[0];
+      words[i++] = val.qword[1];
+    }
+  }
+
+  if (!gDelta.Value()) {
+    AppendWords(trace, words, gNumWords);
+    return;
+  }
+
+  // Pack the mask and the changed words into `delta`; the mask goes first.
+  uint64_t delta[MCSEMA_TRACE_MAX_WORDS + 1];
+  uint64_t mask = 0;
+  unsigned num_changed = 0;
+  for (i = 0; i < gNumWords; ++i) {
+    if (!trace->has_prev || words[i] != trace->prev[i]) {
+      mask |= 1ULL << i;
+      delta[++num_changed] = words[i];
+      trace->prev[i] = words[i];
+    }
+  }
+  delta[0] = mask;
+  trace->has_prev = true;
+  AppendWords(trace, delta, num_changed + 1);
+}
+
 VOID InstrumentInstruction(INS ins, VOID *) {
   if (INS_Address(ins) >= gLowAddr && INS_Address(ins) <= gHighAddr) {
-  INS_InsertCall(
-      ins, IPOINT_BEFORE, (AFUNPTR)PrintRegState, IARG_CONTEXT, IARG_END);
+    if (gBinaryLayout) {
+      INS_InsertCall(
+          ins, IPOINT_BEFORE, (AFUNPTR)RecordRegState, IARG_CONST_CONTEXT,
+          IARG_THREAD_ID, IARG_END);
+    } else {
+      INS_InsertCall(
+          ins, IPOINT_BEFORE, (AFUNPTR)PrintRegState, IARG_CONTEXT, IARG_END);
+    }
   }
 }
 
@@ -98,9 +243,85 @@ VOID FindEntrypoint(IMG img, void *) {
   }
 }
 
+VOID StartThread(THREADID tid, CONTEXT *, INT32, VOID *) {
+  auto os_tid = static_cast<unsigned long long>(PIN_GetTid());
+
+  std::stringstream ss;
+  ss << gOutput.Value() << "." << os_tid << ".bin";
+  auto path = ss.str();
+
+  auto trace = new ThreadTrace;
+  memset(trace, 0, sizeof(ThreadTrace));
+  trace->file = fopen(path.c_str(), "wb");
+  if (!trace->file) {
+    std::cerr << "Unable to open trace file " << path << std::endl;
+    PIN_ExitProcess(1);
+  }
+
+  trace->size = static_cast<size_t>(gBufferKB.Value()) << 10;
+  if (trace->size < (MCSEMA_TRACE_MAX_WORDS + 1) * sizeof(uint64_t)) {
+    trace->size = (MCSEMA_TRACE_MAX_WORDS + 1) * sizeof(uint64_t);
+  }
+  trace->buffer = new uint8_t[trace->size];
+
+  TraceHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MCSEMA_TRACE_MAGIC, sizeof(header.magic));
+  header.version = MCSEMA_TRACE_VERSION;
+  header.layout = gBinaryLayout;
+  header.thread_id = os_tid;
+  fwrite(&header, sizeof(header), 1, trace->file);
+
+  PIN_SetThreadData(gThreadKey, trace, tid);
+}
+
+static void FinishThreadTrace(ThreadTrace *trace) {
+  FlushThreadTrace(trace);
+  fclose(trace->file);
+  delete[] trace->buffer;
+  delete trace;
+}
+
+VOID FiniThread(THREADID tid, const CONTEXT *, INT32, VOID *) {
+  auto trace = reinterpret_cast<ThreadTrace *>(
+      PIN_GetThreadData(gThreadKey, tid));
+  if (trace) {
+    PIN_SetThreadData(gThreadKey, nullptr, tid);
+    FinishThreadTrace(trace);
+  }
+}
+
 int main(int argc, char *argv[]) {
   PIN_InitSymbols();
-  PIN_Init(argc, argv);
+  if (PIN_Init(argc, argv)) {
+    std::cerr << KNOB_BASE::StringKnobSummary() << std::endl;
+    return 1;
+  }
+
+  if ("binary" == gFormat.Value()) {
+    gNumWords = kNumGprs;
+    gBinaryLayout = kLayout;
+    if (gFlags.Value()) {
+      gBinaryLayout |= MCSEMA_TRACE_FLAGS;
+      gNumWords += 1;
+    }
+    if (gXMM.Value()) {
+      gBinaryLayout |= MCSEMA_TRACE_XMM;
+      gNumWords += 2 * kNumXMMs;
+    }
+    if (gDelta.Value()) {
+      gBinaryLayout |= MCSEMA_TRACE_DELTA;
+    }
+    gBinaryLayout |= gNumWords << MCSEMA_TRACE_NUM_WORDS_SHIFT;
+
+    gThreadKey = PIN_CreateThreadDataKey(nullptr);
+    PIN_AddThreadStartFunction(StartThread, nullptr);
+    PIN_AddThreadFiniFunction(FiniThread, nullptr);
+
+  } else if ("text" != gFormat.Value()) {
+    std::cerr << "Unknown trace format " << gFormat.Value() << std::endl;
+    return 1;
+  }
 
   for (IMG img = APP_ImgHead(); IMG_Valid(img); img = IMG_Next(img)) {
     FindEntrypoint(img, nullptr);
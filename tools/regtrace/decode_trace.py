@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+# Copyright 2017 Trail of Bits, all rights reserved.
+
+"""Print a binary register trace in the text format of `-add-reg-tracer`.
+
+The binary format is described in `mcsema/Arch/X86/Runtime/Trace.h`."""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"MCSTRACE"
+VERSION = 1
+
+TRACE_64BIT = 0x1
+TRACE_FLAGS = 0x2
+TRACE_XMM = 0x4
+TRACE_DELTA = 0x8
+NUM_WORDS_SHIFT = 8
+
+HEADER = struct.Struct("<8sIIQ")
+
+GPRS_64 = ("RIP", "RAX", "RBX", "RCX", "RDX", "RSI", "RDI", "RSP", "RBP",
+           "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15")
+
+GPRS_32 = ("EIP", "EAX", "EBX", "ECX", "EDX", "ESI", "EDI", "ESP", "EBP")
+
+FLAGS = (("CF", 0), ("PF", 2), ("AF", 4), ("ZF", 6), ("SF", 7), ("DF", 10),
+         ("OF", 11))
+
+
+class TraceFormatError(Exception):
+  pass
+
+
+def read_header(f):
+  data = f.read(HEADER.size)
+  if len(data) != HEADER.size:
+    raise TraceFormatError("Truncated trace header")
+  magic, version, layout, thread_id = HEADER.unpack(data)
+  if magic != MAGIC:
+    raise TraceFormatError("Not a mcsema register trace")
+  if version != VERSION:
+    raise TraceFormatError("Unsupported trace version {}".format(version))
+  return layout, thread_id
+
+
+def read_records(f, layout):
+  """Yields the words of every record in the trace. Delta-encoded records
+  are expanded into full records."""
+  num_words = layout >> NUM_WORDS_SHIFT
+  if layout & TRACE_DELTA:
+    for words in read_delta_records(f, num_words):
+      yield words
+    return
+
+  record = struct.Struct("<{}Q".format(num_words))
+  while True:
+    data = f.read(record.size)
+    if len(data) < record.size:
+      return
+    yield record.unpack(data)
+
+
+def read_delta_records(f, num_words):
+  word = struct.Struct("<Q")
+  words = [0] * num_words
+  while True:
+    data = f.read(word.size)
+    if len(data) < word.size:
+      return
+    mask, = word.unpack(data)
+    changed = [i for i in range(num_words) if mask & (1 << i)]
+    data = f.read(word.size * len(changed))
+    if len(data) < word.size * len(changed):
+      return
+    for i, val in zip(changed, struct.unpack("<{}Q".format(len(changed)),
+                                             data)):
+      words[i] = val
+    yield tuple(words)
+
+
+def format_record(words, layout):
+  """Formats a record the way the `printf`-based tracer does, followed by
+  the optional flags and XMM registers."""
+  if layout & TRACE_64BIT:
+    gprs, num_xmms = GPRS_64, 16
+  else:
+    gprs, num_xmms = GPRS_32, 8
+
+  parts = ["{}={:x}".format(name, val) for name, val in zip(gprs, words)]
+  i = len(gprs)
+
+  if layout & TRACE_FLAGS:
+    flags = words[i]
+    i += 1
+    parts.extend("{}={}".format(name, (flags >> bit) & 1)
+                 for name, bit in FLAGS)
+
+  if layout & TRACE_XMM:
+    for n in range(num_xmms):
+      lo, hi = words[i], words[i + 1]
+      i += 2
+      parts.append("XMM{}={:016x}{:016x}".format(n, hi, lo))
+
+  return " ".join(parts)
+
+
+def main(args=None):
+  arg_parser = argparse.ArgumentParser(description=__doc__)
+  arg_parser.add_argument("trace", help="Binary trace file to decode.")
+  arg_parser.add_argument(
+      "--output", default="-",
+      help="Where to write the text trace. Defaults to stdout.")
+  args = arg_parser.parse_args(args)
+
+  out = sys.stdout if args.output == "-" else open(args.output, "w")
+  try:
+    with open(args.trace, "rb") as f:
+      layout, _ = read_header(f)
+      for words in read_records(f, layout):
+        out.write(format_record(words, layout))
+        out.write("\n")
+  except TraceFormatError as e:
+    sys.stderr.write("{}: {}\n".format(args.trace, e))
+    return 1
+  finally:
+    if out is not sys.stdout:
+      out.close()
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
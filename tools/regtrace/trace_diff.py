@@ -0,0 +1,376 @@
+#!/usr/bin/env python
+# Copyright 2017 Trail of Bits, all rights reserved.
+
+"""Find the first point where a lifted register trace diverges from a
+native one.
+
+Both traces are streamed through memory maps, so their size is only
+limited by the address space. Each trace can be in the text format of
+`-add-reg-tracer` and the `regtrace` PIN tool, or in the binary format of
+`-reg-tracer-format=binary` and `-format binary`, possibly delta-encoded.
+
+Records are aligned by program counter. When the program counters don't
+match, the differ looks ahead in both traces for a record that brings them
+back in line, which skips over things like external call stubs and the
+iterations of `REP`-prefixed instructions. Registers that differ right after
+a skip over other code (e.g. registers clobbered by library code) are ignored
+until they agree again, or until both traces write them."""
+
+import argparse
+import collections
+import mmap
+import struct
+import sys
+
+import decode_trace
+
+
+class TraceReader(object):
+  """Iterates over the records of one trace. Records are dictionaries
+  mapping register names to values. The position in the trace can be saved
+  and restored, so that the differ can look ahead."""
+
+  def __init__(self, path):
+    self.path = path
+    self._file = open(path, "rb")
+    try:
+      self._data = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+    except ValueError:  # Empty file.
+      self._data = b""
+    self.index = 0
+
+  def close(self):
+    if isinstance(self._data, mmap.mmap):
+      self._data.close()
+    self._file.close()
+
+
+class TextTraceReader(TraceReader):
+  def __init__(self, path):
+    super(TextTraceReader, self).__init__(path)
+    self._offset = 0
+    self.pc_name = None
+
+  def save(self):
+    return self._offset, self.index
+
+  def restore(self, state):
+    self._offset, self.index = state
+
+  def next(self):
+    """Returns the next record, or `None` at the end of the trace. Lines that
+    aren't register states (e.g. the program's own output) are skipped."""
+    data = self._data
+    while self._offset < len(data):
+      end = data.find(b"\n", self._offset)
+      if end < 0:
+        end = len(data)
+      line = data[self._offset:end]
+      self._offset = end + 1
+
+      record = {}
+      for part in line.split():
+        name, sep, val = part.partition(b"=")
+        if not sep:
+          break
+        try:
+          record[name.decode("ascii")] = int(val, 16)
+        except ValueError:
+          break
+      else:
+        if not record:
+          continue
+        if self.pc_name is None:
+          self.pc_name = "RIP" if "RIP" in record else "EIP"
+        if self.pc_name in record:
+          self.index += 1
+          return record
+    return None
+
+
+class BinaryTraceReader(TraceReader):
+  def __init__(self, path):
+    super(BinaryTraceReader, self).__init__(path)
+    header = decode_trace.HEADER
+    if len(self._data) < header.size:
+      raise decode_trace.TraceFormatError("Truncated trace header")
+    magic, version, layout, _ = header.unpack_from(self._data, 0)
+    if magic != decode_trace.MAGIC:
+      raise decode_trace.TraceFormatError("Not a mcsema register trace")
+    if version != decode_trace.VERSION:
+      raise decode_trace.TraceFormatError(
+          "Unsupported trace version {}".format(version))
+
+    self._layout = layout
+    self._num_words = layout >> decode_trace.NUM_WORDS_SHIFT
+    self._record = struct.Struct("<{}Q".format(self._num_words))
+    self._word = struct.Struct("<Q")
+    self._offset = header.size
+    self._words = [0] * self._num_words
+
+    if layout & decode_trace.TRACE_64BIT:
+      self._gprs, self._num_xmms = decode_trace.GPRS_64, 16
+    else:
+      self._gprs, self._num_xmms = decode_trace.GPRS_32, 8
+    self.pc_name = self._gprs[0]
+
+  def save(self):
+    return self._offset, self.index, list(self._words)
+
+  def restore(self, state):
+    self._offset, self.index, words = state
+    self._words = list(words)
+
+  def _next_words(self):
+    data = self._data
+    if not self._layout & decode_trace.TRACE_DELTA:
+      if self._offset + self._record.size > len(data):
+        return None
+      words = self._record.unpack_from(data, self._offset)
+      self._offset += self._record.size
+      return words
+
+    if self._offset + self._word.size > len(data):
+      return None
+    mask, = self._word.unpack_from(data, self._offset)
+    changed = [i for i in range(self._num_words) if mask & (1 << i)]
+    size = self._word.size * (len(changed) + 1)
+    if self._offset + size > len(data):
+      return None
+    vals = struct.unpack_from("<{}Q".format(len(changed)), data,
+                              self._offset + self._word.size)
+    self._offset += size
+    for i, val in zip(changed, vals):
+      self._words[i] = val
+    return self._words
+
+  def next(self):
+    words = self._next_words()
+    if words is None:
+      return None
+
+    record = dict(zip(self._gprs, words))
+    i = len(self._gprs)
+    if self._layout & decode_trace.TRACE_FLAGS:
+      for name, bit in decode_trace.FLAGS:
+        record[name] = (words[i] >> bit) & 1
+      i += 1
+    if self._layout & decode_trace.TRACE_XMM:
+      for n in range(self._num_xmms):
+        record["XMM{}".format(n)] = words[i] | (words[i + 1] << 64)
+        i += 2
+
+    self.index += 1
+    return record
+
+
+def open_trace(path):
+  with open(path, "rb") as f:
+    is_binary = f.read(len(decode_trace.MAGIC)) == decode_trace.MAGIC
+  if is_binary:
+    return BinaryTraceReader(path)
+  return TextTraceReader(path)
+
+
+def format_record(record, diffs=()):
+  parts = []
+  for name in sorted(record, key=register_order):
+    text = "{}={:x}".format(name, record[name])
+    if name in diffs:
+      text = "*" + text
+    parts.append(text)
+  return " ".join(parts)
+
+
+_ORDER = dict((name, i) for i, name in enumerate(
+    decode_trace.GPRS_64 + decode_trace.GPRS_32 +
+    tuple(name for name, _ in decode_trace.FLAGS)))
+
+
+def register_order(name):
+  return _ORDER.get(name, len(_ORDER)), name
+
+
+def find_pc(trace, pc, max_skip):
+  """Looks for the next record of `trace` whose program counter is `pc`.
+  Returns the number of records to skip to get to it, or `None`. The
+  position of `trace` is left unchanged."""
+  state = trace.save()
+  try:
+    for skip in range(max_skip + 1):
+      record = trace.next()
+      if record is None:
+        return None
+      if record[trace.pc_name] == pc:
+        return skip
+    return None
+  finally:
+    trace.restore(state)
+
+
+class TraceDiffer(object):
+  def __init__(self, native, lifted, args):
+    self.native = native
+    self.lifted = lifted
+    self.ignore = set(args.ignore)
+    self.max_skip = args.max_skip
+    self.strict = args.strict
+    self.history = collections.deque(maxlen=args.context)
+    self.num_compared = 0
+    self.num_skipped = [0, 0]
+
+    # Registers that are ignored until they agree again, or until both traces
+    # write them.
+    self.tainted = set()
+    self.prev = (None, None)
+    self.last_pc = None
+
+  def resync(self, native_rec, lifted_rec):
+    """Skips records until the program counters of both traces match again.
+    Returns the new pair of records and whether anything other than repeats
+    of the previous instruction (e.g. `REP` iterations) was skipped, or
+    `None` if the traces can't be aligned."""
+    native_pc = native_rec[self.native.pc_name]
+    lifted_pc = lifted_rec[self.lifted.pc_name]
+
+    native_skip = find_pc(self.native, lifted_pc, self.max_skip)
+    lifted_skip = find_pc(self.lifted, native_pc, self.max_skip)
+    if native_skip is None and lifted_skip is None:
+      return None
+
+    if lifted_skip is None or (native_skip is not None and
+                               native_skip + 1 <= lifted_skip):
+      trace, skip, skipped = self.native, native_skip, native_rec
+      self.num_skipped[0] += native_skip + 1
+    else:
+      trace, skip, skipped = self.lifted, lifted_skip, lifted_rec
+      self.num_skipped[1] += lifted_skip + 1
+
+    only_repeats = True
+    for _ in range(skip + 1):
+      only_repeats = only_repeats and skipped[trace.pc_name] == self.last_pc
+      skipped = trace.next()
+
+    if trace is self.native:
+      native_rec = skipped
+    else:
+      lifted_rec = skipped
+
+    self.prev = (None, None)
+    return native_rec, lifted_rec, not only_repeats
+
+  def compare(self, native_rec, lifted_rec, after_skip):
+    names = (set(native_rec) & set(lifted_rec)) - self.ignore
+    diffs = set(name for name in names if native_rec[name] != lifted_rec[name])
+
+    if after_skip and not self.strict:
+      self.tainted |= diffs
+
+    prev_native, prev_lifted = self.prev
+    for name in list(self.tainted):
+      if name not in diffs:
+        self.tainted.discard(name)
+      elif (prev_native is not None and prev_lifted is not None and
+            prev_native.get(name) != native_rec[name] and
+            prev_lifted.get(name) != lifted_rec[name]):
+        self.tainted.discard(name)
+
+    self.prev = (native_rec, lifted_rec)
+    return diffs - self.tainted
+
+  def report(self, out, native_rec, lifted_rec, diffs, reason):
+    out.write("{}\n".format(reason))
+    out.write("Compared {} records; skipped {} native and {} lifted "
+              "records.\n\n".format(self.num_compared, self.num_skipped[0],
+                                    self.num_skipped[1]))
+
+    for n_idx, n_rec, l_idx, l_rec in self.history:
+      out.write("  native #{}: {}\n".format(n_idx, format_record(n_rec)))
+      out.write("  lifted #{}: {}\n".format(l_idx, format_record(l_rec)))
+
+    out.write("> native #{}: {}\n".format(
+        self.native.index, format_record(native_rec, diffs)))
+    out.write("> lifted #{}: {}\n".format(
+        self.lifted.index, format_record(lifted_rec, diffs)))
+
+    for trace, name in ((self.native, "native"), (self.lifted, "lifted")):
+      for _ in range(self.history.maxlen):
+        record = trace.next()
+        if record is None:
+          break
+        out.write("  {} #{}: {}\n".format(name, trace.index,
+                                          format_record(record)))
+
+  def run(self, out):
+    after_skip = False
+    while True:
+      native_rec = self.native.next()
+      lifted_rec = self.lifted.next()
+      if native_rec is None or lifted_rec is None:
+        out.write("No divergence in {} aligned records; skipped {} native "
+                  "and {} lifted records.\n".format(
+                      self.num_compared, self.num_skipped[0],
+                      self.num_skipped[1]))
+        if native_rec is not None or lifted_rec is not None:
+          which = "native" if native_rec is not None else "lifted"
+          out.write("The {} trace is longer.\n".format(which))
+        return 0
+
+      if native_rec[self.native.pc_name] != lifted_rec[self.lifted.pc_name]:
+        aligned = self.resync(native_rec, lifted_rec)
+        if aligned is None:
+          self.report(out, native_rec, lifted_rec, set(["RIP", "EIP"]),
+                      "Control flow diverges.")
+          return 1
+        native_rec, lifted_rec, after_skip = aligned
+
+      diffs = self.compare(native_rec, lifted_rec, after_skip)
+      if diffs:
+        self.report(out, native_rec, lifted_rec, diffs,
+                    "Registers diverge: {}".format(
+                        ", ".join(sorted(diffs, key=register_order))))
+        return 1
+
+      after_skip = False
+      self.num_compared += 1
+      self.last_pc = native_rec[self.native.pc_name]
+      self.history.append((self.native.index, native_rec,
+                           self.lifted.index, lifted_rec))
+
+
+def main(args=None):
+  arg_parser = argparse.ArgumentParser(description=__doc__)
+  arg_parser.add_argument("native", help="Trace of the native program.")
+  arg_parser.add_argument("lifted", help="Trace of the lifted program.")
+  arg_parser.add_argument(
+      "--ignore", action="append", default=[],
+      help="Register to leave out of the comparison. Can be repeated.")
+  arg_parser.add_argument(
+      "--max-skip", type=int, default=100000,
+      help="How many records to look ahead in either trace when the "
+           "program counters don't match.")
+  arg_parser.add_argument(
+      "--context", type=int, default=5,
+      help="How many records to print before and after the divergence.")
+  arg_parser.add_argument(
+      "--strict", action="store_true",
+      help="Don't ignore registers that differ right after skipped records.")
+  args = arg_parser.parse_args(args)
+  args.ignore = [name.upper() for name in args.ignore]
+
+  try:
+    native = open_trace(args.native)
+    lifted = open_trace(args.lifted)
+  except (IOError, decode_trace.TraceFormatError) as e:
+    sys.stderr.write("{}\n".format(e))
+    return 2
+
+  try:
+    return TraceDiffer(native, lifted, args).run(sys.stdout)
+  finally:
+    native.close()
+    lifted.close()
+
+
+if __name__ == "__main__":
+  sys.exit(main())
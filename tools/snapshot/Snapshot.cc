@@ -0,0 +1,80 @@
+/* Copyright 2017 Trail of Bits, all rights reserved. */
+
+// Snapshot and restore the lifted state of a thread. See
+// `mcsema/Arch/X86/Runtime/Snapshot.h`. Link this file, along with
+// `ELF_64_linux.S` or `ELF_64_linux_lazy_stack.S`, into the lifted program.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ONLY_STRUCT
+#include "../../mcsema/Arch/X86/Runtime/State.h"
+#include "../../mcsema/Arch/X86/Runtime/Snapshot.h"
+
+extern "C" RegState *__mcsema_debug_get_reg_state(void);
+extern "C" uint8_t *__mcsema_get_stack_top(void);
+
+struct McsemaSnapshot {
+  RegState state;
+
+  // The used part of the lifted stack is `[stack_top - stack_size,
+  // stack_top)`, and a copy of it follows this structure.
+  uint8_t *stack_top;
+  size_t stack_size;
+};
+
+static uint8_t *SavedStack(const McsemaSnapshot *snapshot) {
+  return reinterpret_cast<uint8_t *>(
+      const_cast<McsemaSnapshot *>(snapshot) + 1);
+}
+
+McsemaSnapshot *__mcsema_snapshot_create(void) {
+  auto state = __mcsema_debug_get_reg_state();
+  auto stack_top = __mcsema_get_stack_top();
+  auto stack_ptr = reinterpret_cast<uint8_t *>(state->RSP);
+  if (!stack_top || !stack_ptr) {
+    return nullptr;
+  }
+
+  if (stack_ptr > stack_top) {
+    fprintf(stderr, "Lifted stack pointer %p is above the top of the lifted "
+                    "stack %p; is the snapshot taken from lifted code?\n",
+            stack_ptr, stack_top);
+    abort();
+  }
+
+  size_t stack_size = static_cast<size_t>(stack_top - stack_ptr);
+  auto snapshot = reinterpret_cast<McsemaSnapshot *>(
+      malloc(sizeof(McsemaSnapshot) + stack_size));
+  if (!snapshot) {
+    fprintf(stderr, "Unable to allocate a lifted state snapshot\n");
+    abort();
+  }
+
+  memcpy(&(snapshot->state), state, sizeof(RegState));
+  snapshot->stack_top = stack_top;
+  snapshot->stack_size = stack_size;
+  memcpy(SavedStack(snapshot), stack_ptr, stack_size);
+  return snapshot;
+}
+
+void __mcsema_snapshot_restore(const McsemaSnapshot *snapshot) {
+  if (__mcsema_get_stack_top() != snapshot->stack_top) {
+    fprintf(stderr, "Lifted state snapshot restored on the wrong thread\n");
+    abort();
+  }
+  memcpy(__mcsema_debug_get_reg_state(), &(snapshot->state),
+         sizeof(RegState));
+  memcpy(snapshot->stack_top - snapshot->stack_size, SavedStack(snapshot),
+         snapshot->stack_size);
+}
+
+size_t __mcsema_snapshot_stack_size(const McsemaSnapshot *snapshot) {
+  return snapshot->stack_size;
+}
+
+void __mcsema_snapshot_free(McsemaSnapshot *snapshot) {
+  free(snapshot);
+}